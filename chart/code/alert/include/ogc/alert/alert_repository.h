@@ -22,6 +22,16 @@ public:
     virtual std::vector<AlertPtr> Query(const AlertQueryParams& params) = 0;
     virtual int Count(const AlertQueryParams& params) = 0;
     
+    /**
+     * @brief Keyset page of matching alerts, newest issue_time first.
+     *
+     * Resumes strictly after `after` when after.last_id is set. `skip` drops
+     * that many leading matches for offset-style paging. The page, size and
+     * time fields of params are honoured as filters only.
+     */
+    virtual AlertPage QueryPage(const AlertQueryParams& params, const PageCursor& after,
+                                int limit, int skip = 0);
+    
     virtual std::vector<AlertPtr> GetActiveAlerts(const std::string& user_id) = 0;
     virtual std::vector<AlertPtr> GetAlertsByType(AlertType type, const std::string& user_id) = 0;
     virtual std::vector<AlertPtr> GetAlertsByLevel(AlertLevel level, const std::string& user_id) = 0;
@@ -52,10 +62,32 @@ public:
     static std::unique_ptr<IConfigRepository> Create();
 };
 
+struct AlertRepositoryOptions {
+    int partition_span_seconds;
+    
+    AlertRepositoryOptions()
+        : partition_span_seconds(24 * 3600) {}
+};
+
+/**
+ * @brief In-memory alert store partitioned by issue time.
+ *
+ * Each partition covers partition_span_seconds and keeps its alerts ordered
+ * by (issue_time, alert_id) together with secondary indexes on user (vessel),
+ * type, level and status, which includes the acknowledgement state. Queries
+ * walk partitions newest first from an immutable snapshot of the partition
+ * list, pick the most selective index per partition and stop once the page is
+ * full, so they never scan the whole history. Scans take a partition's lock
+ * shared for one bounded chunk of keys at a time and resume below the last
+ * key, so concurrent queries do not serialise and ingest into the same
+ * partition waits for at most one chunk. DropPartitionsBefore() releases whole partitions, and the
+ * id lookup entries of their alerts, without touching the remaining ones.
+ */
 class OGC_ALERT_API AlertRepository : public IAlertRepository {
 public:
     AlertRepository();
     explicit AlertRepository(const std::string& db_path);
+    explicit AlertRepository(const AlertRepositoryOptions& options);
     ~AlertRepository();
     
     bool Save(const AlertPtr& alert) override;
@@ -65,6 +97,8 @@ public:
     
     std::vector<AlertPtr> Query(const AlertQueryParams& params) override;
     int Count(const AlertQueryParams& params) override;
+    AlertPage QueryPage(const AlertQueryParams& params, const PageCursor& after,
+                        int limit, int skip = 0) override;
     
     std::vector<AlertPtr> GetActiveAlerts(const std::string& user_id) override;
     std::vector<AlertPtr> GetAlertsByType(AlertType type, const std::string& user_id) override;
@@ -76,6 +110,13 @@ public:
     bool SaveAcknowledge(const AcknowledgeData& data) override;
     bool SaveFeedback(const FeedbackData& data) override;
     
+    /**
+     * @brief Drop every partition that ends at or before cutoff.
+     * @return Number of partitions dropped
+     */
+    int DropPartitionsBefore(const DateTime& cutoff);
+    int GetPartitionCount() const;
+    
 private:
     class Impl;
     std::unique_ptr<Impl> m_impl;
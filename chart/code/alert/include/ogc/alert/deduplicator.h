@@ -44,6 +44,17 @@ struct DuplicateGroup {
     int occurrence_count;
 };
 
+/**
+ * @brief Collapses repeated alerts from the same source and target.
+ *
+ * Alerts are indexed by identity (type, source, target), a grid cell of
+ * spatial_threshold degrees and a time bucket covering the time window. A new
+ * alert probes its own and the eight neighbouring cells in the adjacent time
+ * buckets, so a vessel drifting a few metres between cycles still joins its
+ * existing group; each group follows the position of its latest alert.
+ * Groups expire on a timing wheel driven by alert issue times. Lookup, update
+ * and expiry are O(1) amortised per alert.
+ */
 class OGC_ALERT_API AlertDeduplicator {
 public:
     AlertDeduplicator();
@@ -73,23 +84,18 @@ public:
     void EnableSuppress(bool enable, int interval_seconds = 300);
 
 private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+    
     DeduplicationConfig m_config;
     mutable std::mutex m_mutex;
     
-    std::map<AlertSignature, DuplicateGroup> m_duplicateGroups;
-    std::map<AlertSignature, DateTime> m_lastAlertTime;
-    
     size_t m_processedCount;
     size_t m_duplicateCount;
     size_t m_suppressedCount;
     
     AlertSignature ComputeSignature(const AlertPtr& alert) const;
-    bool IsInTimeWindow(const DateTime& current, const DateTime& previous) const;
-    bool IsInSpatialWindow(const Coordinate& a, const Coordinate& b) const;
     AlertPtr MergeAlerts(const std::vector<AlertPtr>& alerts) const;
-    bool ShouldSuppress(const AlertSignature& signature) const;
-    void UpdateGroup(const AlertSignature& signature, AlertPtr alert);
-    void CleanupExpiredGroups();
 };
 
 class OGC_ALERT_API AlertAggregator {
@@ -13,12 +13,6 @@ namespace alert {
 
 class IAlertRepository;
 
-struct PageCursor {
-    std::string last_id;
-    DateTime last_time;
-    bool has_more;
-};
-
 struct OptimizedQueryParams {
     std::string user_id;
     std::vector<AlertType> alert_types;
@@ -66,6 +60,11 @@ public:
     
     virtual std::vector<AlertPtr> SearchAlerts(const std::string& user_id, const std::string& keyword) = 0;
     
+    /**
+     * @brief Lists alerts newest first. The user, type, level and time
+     * filters apply to every page of all statuses, including pages read with
+     * use_cursor; GetAlertListByCursor() pages through active alerts only.
+     */
     virtual AlertListResult GetAlertListOptimized(const OptimizedQueryParams& params) = 0;
     virtual AlertListResult GetAlertListByCursor(const std::string& user_id, 
                                                   const PageCursor& cursor, 
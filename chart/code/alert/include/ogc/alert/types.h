@@ -246,17 +246,32 @@ struct OGC_ALERT_API AlertQueryParams {
     std::string user_id;
     std::vector<AlertType> alert_types;
     std::vector<AlertLevel> alert_levels;
+    std::vector<AlertStatus> statuses;
     DateTime start_time;
     DateTime end_time;
     int page;
     int page_size;
 };
 
+struct PageCursor {
+    std::string last_id;
+    DateTime last_time;
+    bool has_more;
+    
+    PageCursor() : has_more(false) {}
+};
+
+struct OGC_ALERT_API AlertPage {
+    std::vector<AlertPtr> alerts;
+    PageCursor next;
+};
+
 struct OGC_ALERT_API AlertListResult {
     std::vector<AlertPtr> alerts;
     int total_count;
     int page;
     int page_size;
+    PageCursor next_cursor;
 };
 
 struct OGC_ALERT_API AcknowledgeData {
@@ -3,6 +3,8 @@
 
 #include "types.h"
 #include "export.h"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -20,6 +22,9 @@ struct WebSocketConfig {
     bool enable_ssl;
     std::string cert_file;
     std::string key_file;
+    size_t max_send_queue_bytes;
+    int max_send_queue_messages;
+    size_t max_message_bytes;
     
     WebSocketConfig()
         : host("0.0.0.0")
@@ -27,7 +32,25 @@ struct WebSocketConfig {
         , max_connections(1000)
         , ping_interval_ms(30000)
         , ping_timeout_ms(5000)
-        , enable_ssl(false) {}
+        , enable_ssl(false)
+        , max_send_queue_bytes(4 * 1024 * 1024)
+        , max_send_queue_messages(1024)
+        , max_message_bytes(1024 * 1024) {}
+};
+
+struct WebSocketStats {
+    int active_sessions;
+    int64_t messages_queued;
+    int64_t bytes_sent;
+    int64_t evicted_sessions;
+    int64_t rejected_connections;
+    
+    WebSocketStats()
+        : active_sessions(0)
+        , messages_queued(0)
+        , bytes_sent(0)
+        , evicted_sessions(0)
+        , rejected_connections(0) {}
 };
 
 struct WebSocketSession {
@@ -81,6 +104,22 @@ public:
     static std::unique_ptr<IWebSocketService> Create();
 };
 
+/**
+ * @brief Non-blocking WebSocket push server.
+ *
+ * A single event-loop thread (epoll on Linux, poll elsewhere) accepts
+ * connections, performs the upgrade handshake and writes queued frames.
+ * Send calls from any thread only append a pre-framed, shared payload to
+ * each target session's bounded queue, so a broadcast is serialized once
+ * regardless of the number of clients. A session whose queue exceeds
+ * max_send_queue_bytes or max_send_queue_messages is evicted instead of
+ * stalling the others. Handlers are invoked on the event-loop thread.
+ * A handler may call Stop(); the loop then exits after the current event
+ * and the next Start(), Stop() or the destructor releases the sockets.
+ *
+ * Port 0 binds an ephemeral port; see GetListenPort(). TLS is not
+ * terminated here, so Start() fails when enable_ssl is set.
+ */
 class OGC_ALERT_API WebSocketService : public IWebSocketService {
 public:
     WebSocketService();
@@ -111,6 +150,15 @@ public:
     void UnsubscribeFromAlert(const std::string& session_id, AlertType alert_type) override;
     std::vector<AlertType> GetSubscriptions(const std::string& session_id) override;
     
+    /**
+     * @brief Send message to every session subscribed to alert_type.
+     * @return Number of sessions the message was queued for
+     */
+    int PublishAlert(AlertType alert_type, const std::string& message);
+    
+    int GetListenPort() const;
+    WebSocketStats GetStats() const;
+    
 private:
     class Impl;
     std::unique_ptr<Impl> m_impl;
@@ -1,179 +1,719 @@
 #include "ogc/alert/alert_repository.h"
 #include "ogc/base/log.h"
+#include "ogc/base/thread_safe.h"
 #include <map>
+#include <set>
 #include <mutex>
 #include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 
 namespace ogc {
 namespace alert {
 
-class AlertRepository::Impl {
-public:
-    Impl() {}
-    
-    bool Save(const AlertPtr& alert) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_alerts[alert->alert_id] = alert;
-        return true;
+namespace {
+
+const int kIdShards = 16;
+// Keys a scan examines per hold of a partition lock.
+const size_t kScanChunk = 256;
+
+typedef std::pair<int64_t, std::string> EntryKey;
+typedef std::set<EntryKey> KeySet;
+
+int64_t FloorDiv(int64_t value, int64_t divisor) {
+    int64_t q = value / divisor;
+    return (value % divisor != 0 && value < 0) ? q - 1 : q;
+}
+
+int64_t DaysFromCivil(int64_t y, int m, int d) {
+    y -= m <= 2 ? 1 : 0;
+    int64_t era = FloorDiv(y, 400);
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+int64_t ToEpochMs(const DateTime& dt) {
+    int64_t days = DaysFromCivil(dt.year, dt.month, dt.day);
+    int64_t seconds = days * 86400 + dt.hour * 3600 + dt.minute * 60 + dt.second;
+    return seconds * 1000 + dt.millisecond;
+}
+
+bool IsUnset(const DateTime& dt) {
+    return dt == DateTime();
+}
+
+struct Entry {
+    AlertPtr alert;
+    std::string user_id;
+    AlertType type;
+    AlertLevel level;
+    AlertStatus status;
+};
+
+// Scans take the lock shared one chunk of keys at a time, so a writer waits
+// for at most one chunk rather than a whole scan.
+struct Partition {
+    int64_t bucket;
+    base::ReadWriteLock lock;
+    std::map<EntryKey, Entry> entries;
+    std::unordered_map<std::string, int64_t> issueTimes;
+    std::unordered_map<std::string, KeySet> byUser;
+    std::map<int, KeySet> byType;
+    std::map<int, KeySet> byLevel;
+    std::map<int, KeySet> byStatus;
+
+    explicit Partition(int64_t b) : bucket(b) {}
+
+    void Insert(const EntryKey& key, const Entry& entry) {
+        entries[key] = entry;
+        issueTimes[key.second] = key.first;
+        byUser[entry.user_id].insert(key);
+        byType[static_cast<int>(entry.type)].insert(key);
+        byLevel[static_cast<int>(entry.level)].insert(key);
+        byStatus[static_cast<int>(entry.status)].insert(key);
     }
-    
-    bool Update(const AlertPtr& alert) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_alerts[alert->alert_id] = alert;
-        return true;
+
+    Entry* Find(const std::string& alert_id, EntryKey* key) {
+        auto it = issueTimes.find(alert_id);
+        if (it == issueTimes.end()) {
+            return nullptr;
+        }
+        EntryKey k(it->second, alert_id);
+        if (key) {
+            *key = k;
+        }
+        auto entryIt = entries.find(k);
+        return entryIt != entries.end() ? &entryIt->second : nullptr;
     }
-    
-    bool Delete(const std::string& alert_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return m_alerts.erase(alert_id) > 0;
+
+    bool Erase(const std::string& alert_id) {
+        EntryKey key;
+        Entry* entry = Find(alert_id, &key);
+        if (!entry) {
+            return false;
+        }
+        EraseKey(byUser, entry->user_id, key);
+        EraseKey(byType, static_cast<int>(entry->type), key);
+        EraseKey(byLevel, static_cast<int>(entry->level), key);
+        EraseKey(byStatus, static_cast<int>(entry->status), key);
+        entries.erase(key);
+        issueTimes.erase(alert_id);
+        return true;
     }
-    
-    AlertPtr FindById(const std::string& alert_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_alerts.find(alert_id);
-        if (it != m_alerts.end()) {
-            return it->second;
+
+    void SetStatus(const EntryKey& key, Entry& entry, AlertStatus status) {
+        if (entry.status == status) {
+            return;
         }
-        return nullptr;
+        EraseKey(byStatus, static_cast<int>(entry.status), key);
+        entry.status = status;
+        byStatus[static_cast<int>(status)].insert(key);
     }
-    
-    std::vector<AlertPtr> Query(const AlertQueryParams& params) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::vector<AlertPtr> result;
-        for (const auto& pair : m_alerts) {
-            const AlertPtr& alert = pair.second;
-            bool match = true;
-            
-            if (!params.user_id.empty() && alert->user_id != params.user_id) {
-                match = false;
-            }
-            
-            if (!params.alert_types.empty()) {
-                bool typeMatch = false;
-                for (AlertType type : params.alert_types) {
-                    if (alert->alert_type == type) {
-                        typeMatch = true;
-                        break;
-                    }
-                }
-                if (!typeMatch) match = false;
-            }
-            
-            if (!params.alert_levels.empty()) {
-                bool levelMatch = false;
-                for (AlertLevel level : params.alert_levels) {
-                    if (alert->alert_level == level) {
-                        levelMatch = true;
-                        break;
-                    }
-                }
-                if (!levelMatch) match = false;
+
+    template<typename Index, typename Value>
+    static void EraseKey(Index& index, const Value& value, const EntryKey& key) {
+        auto it = index.find(value);
+        if (it != index.end()) {
+            it->second.erase(key);
+            if (it->second.empty()) {
+                index.erase(it);
             }
-            
-            if (match) {
-                result.push_back(alert);
+        }
+    }
+};
+
+typedef std::shared_ptr<Partition> PartitionPtr;
+
+struct Directory {
+    std::map<int64_t, PartitionPtr> partitions;
+};
+
+typedef std::shared_ptr<const Directory> DirectoryPtr;
+
+struct IdShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, int64_t> buckets;
+};
+
+struct Filter {
+    std::string user_id;
+    std::vector<int> types;
+    std::vector<int> levels;
+    std::vector<int> statuses;
+    bool hasStart;
+    bool hasEnd;
+    int64_t startMs;
+    int64_t endMs;
+
+    Filter() : hasStart(false), hasEnd(false), startMs(0), endMs(0) {}
+
+    explicit Filter(const AlertQueryParams& params)
+        : user_id(params.user_id)
+        , hasStart(!IsUnset(params.start_time))
+        , hasEnd(!IsUnset(params.end_time))
+        , startMs(hasStart ? ToEpochMs(params.start_time) : 0)
+        , endMs(hasEnd ? ToEpochMs(params.end_time) : 0) {
+        for (AlertType type : params.alert_types) {
+            types.push_back(static_cast<int>(type));
+        }
+        for (AlertLevel level : params.alert_levels) {
+            levels.push_back(static_cast<int>(level));
+        }
+        for (AlertStatus status : params.statuses) {
+            statuses.push_back(static_cast<int>(status));
+        }
+    }
+
+    int ConstraintCount() const {
+        return (user_id.empty() ? 0 : 1) + (types.empty() ? 0 : 1) +
+               (levels.empty() ? 0 : 1) + (statuses.empty() ? 0 : 1);
+    }
+
+    bool Matches(const Entry& entry) const {
+        return (user_id.empty() || entry.user_id == user_id) &&
+               Contains(types, static_cast<int>(entry.type)) &&
+               Contains(levels, static_cast<int>(entry.level)) &&
+               Contains(statuses, static_cast<int>(entry.status));
+    }
+
+    static bool Contains(const std::vector<int>& values, int value) {
+        return values.empty() || std::find(values.begin(), values.end(), value) != values.end();
+    }
+};
+
+/**
+ * Picks the index sets whose union covers every candidate in the partition,
+ * choosing the constraint with the fewest keys. Returns false when no
+ * constraint applies and the partition must be scanned in full.
+ */
+bool SelectIndex(const Partition& partition, const Filter& filter, std::vector<const KeySet*>& sets) {
+    std::vector<const KeySet*> best;
+    size_t bestCost = std::numeric_limits<size_t>::max();
+
+    auto consider = [&](const std::vector<const KeySet*>& candidate) {
+        size_t cost = 0;
+        for (const KeySet* set : candidate) {
+            cost += set->size();
+        }
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = candidate;
+        }
+    };
+    auto collect = [](const std::map<int, KeySet>& index, const std::vector<int>& values) {
+        std::vector<const KeySet*> result;
+        for (int value : values) {
+            auto it = index.find(value);
+            if (it != index.end()) {
+                result.push_back(&it->second);
             }
         }
         return result;
+    };
+
+    if (!filter.user_id.empty()) {
+        std::vector<const KeySet*> candidate;
+        auto it = partition.byUser.find(filter.user_id);
+        if (it != partition.byUser.end()) {
+            candidate.push_back(&it->second);
+        }
+        consider(candidate);
     }
-    
-    int Count(const AlertQueryParams& params) {
-        return static_cast<int>(Query(params).size());
+    if (!filter.types.empty()) {
+        consider(collect(partition.byType, filter.types));
     }
-    
-    std::vector<AlertPtr> GetActiveAlerts(const std::string& user_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::vector<AlertPtr> result;
-        for (const auto& pair : m_alerts) {
-            const AlertPtr& alert = pair.second;
-            if (alert->status == AlertStatus::kActive) {
-                if (user_id.empty() || alert->user_id == user_id) {
-                    result.push_back(alert);
-                }
+    if (!filter.levels.empty()) {
+        consider(collect(partition.byLevel, filter.levels));
+    }
+    if (!filter.statuses.empty()) {
+        consider(collect(partition.byStatus, filter.statuses));
+    }
+
+    if (bestCost == std::numeric_limits<size_t>::max()) {
+        return false;
+    }
+    sets.swap(best);
+    return true;
+}
+
+typedef std::pair<EntryKey, AlertPtr> Hit;
+
+/**
+ * Appends up to limit keys below end in descending order and returns how
+ * many were available, capped at limit.
+ */
+template<typename Iterator, typename KeyOf>
+size_t TakeKeysBelow(Iterator begin, Iterator end, KeyOf keyOf, size_t limit,
+                     std::vector<EntryKey>& out) {
+    size_t taken = 0;
+    for (Iterator it = end; it != begin && taken < limit; ++taken) {
+        --it;
+        out.push_back(keyOf(*it));
+    }
+    return taken;
+}
+
+bool KeyAfter(const EntryKey& a, const EntryKey& b) {
+    return a > b;
+}
+
+}
+
+class AlertRepository::Impl {
+public:
+    explicit Impl(const AlertRepositoryOptions& options)
+        : m_spanMs(static_cast<int64_t>(std::max(1, options.partition_span_seconds)) * 1000)
+        , m_directory(std::make_shared<Directory>()) {
+        for (int i = 0; i < kIdShards; ++i) {
+            m_idShards.emplace_back(new IdShard());
+        }
+    }
+
+    bool Save(const AlertPtr& alert) {
+        Entry entry;
+        entry.alert = alert;
+        entry.user_id = alert->user_id;
+        entry.type = alert->alert_type;
+        entry.level = alert->alert_level;
+        entry.status = alert->status;
+        EntryKey key(ToEpochMs(alert->issue_time), alert->alert_id);
+        int64_t bucket = FloorDiv(key.first, m_spanMs);
+
+        IdShard& shard = ShardFor(alert->alert_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(alert->alert_id);
+        if (it != shard.buckets.end() && it->second != bucket) {
+            PartitionPtr previous = FindPartition(it->second);
+            if (previous) {
+                base::WriteLockGuard partitionLock(previous->lock);
+                previous->Erase(alert->alert_id);
             }
         }
+
+        PartitionPtr partition = GetOrCreatePartition(bucket);
+        {
+            base::WriteLockGuard partitionLock(partition->lock);
+            partition->Erase(alert->alert_id);
+            partition->Insert(key, entry);
+        }
+        shard.buckets[alert->alert_id] = bucket;
+        return true;
+    }
+
+    bool Delete(const std::string& alert_id) {
+        IdShard& shard = ShardFor(alert_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(alert_id);
+        if (it == shard.buckets.end()) {
+            return false;
+        }
+        PartitionPtr partition = FindPartition(it->second);
+        shard.buckets.erase(it);
+        if (!partition) {
+            return false;
+        }
+        base::WriteLockGuard partitionLock(partition->lock);
+        return partition->Erase(alert_id);
+    }
+
+    AlertPtr FindById(const std::string& alert_id) {
+        AlertPtr result;
+        WithEntry(alert_id, [&result](Partition&, const EntryKey&, Entry& entry) {
+            result = entry.alert;
+        });
         return result;
     }
-    
-    std::vector<AlertPtr> GetAlertsByType(AlertType type, const std::string& user_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<AlertPtr> Query(const AlertQueryParams& params) {
+        std::vector<Hit> hits = Collect(Filter(params), nullptr, std::numeric_limits<size_t>::max());
         std::vector<AlertPtr> result;
-        for (const auto& pair : m_alerts) {
-            const AlertPtr& alert = pair.second;
-            if (alert->alert_type == type) {
-                if (user_id.empty() || alert->user_id == user_id) {
-                    result.push_back(alert);
-                }
-            }
+        result.reserve(hits.size());
+        for (const auto& hit : hits) {
+            result.push_back(hit.second);
         }
         return result;
     }
-    
-    std::vector<AlertPtr> GetAlertsByLevel(AlertLevel level, const std::string& user_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::vector<AlertPtr> result;
-        for (const auto& pair : m_alerts) {
-            const AlertPtr& alert = pair.second;
-            if (alert->alert_level == level) {
-                if (user_id.empty() || alert->user_id == user_id) {
-                    result.push_back(alert);
+
+    AlertPage QueryPage(const AlertQueryParams& params, const PageCursor& after, int limit, int skip) {
+        AlertPage page;
+        if (limit <= 0) {
+            return page;
+        }
+        skip = std::max(0, skip);
+
+        EntryKey bound;
+        bool hasBound = !after.last_id.empty();
+        if (hasBound) {
+            bound = EntryKey(ToEpochMs(after.last_time), after.last_id);
+        }
+
+        size_t want = static_cast<size_t>(skip) + static_cast<size_t>(limit) + 1;
+        std::vector<Hit> hits = Collect(Filter(params), hasBound ? &bound : nullptr, want);
+
+        size_t begin = std::min(hits.size(), static_cast<size_t>(skip));
+        size_t end = std::min(hits.size(), begin + static_cast<size_t>(limit));
+        for (size_t i = begin; i < end; ++i) {
+            page.alerts.push_back(hits[i].second);
+        }
+        page.next.has_more = hits.size() > end;
+        if (end > begin) {
+            page.next.last_id = hits[end - 1].first.second;
+            page.next.last_time = hits[end - 1].second->issue_time;
+        } else {
+            page.next.last_id = after.last_id;
+            page.next.last_time = after.last_time;
+        }
+        return page;
+    }
+
+    int Count(const AlertQueryParams& params) {
+        Filter filter(params);
+        bool exactIndex = filter.ConstraintCount() <= 1;
+        DirectoryPtr directory = std::atomic_load(&m_directory);
+        size_t count = 0;
+        std::vector<Hit> hits;
+        for (const auto& pair : directory->partitions) {
+            int64_t first = pair.first * m_spanMs;
+            int64_t last = first + m_spanMs - 1;
+            if ((filter.hasStart && last < filter.startMs) || (filter.hasEnd && first > filter.endMs)) {
+                continue;
+            }
+            bool inside = (!filter.hasStart || first >= filter.startMs) && (!filter.hasEnd || last <= filter.endMs);
+
+            Partition& partition = *pair.second;
+            if (inside && exactIndex) {
+                base::ReadLockGuard lock(partition.lock);
+                std::vector<const KeySet*> sets;
+                if (!SelectIndex(partition, filter, sets)) {
+                    count += partition.entries.size();
+                } else {
+                    for (const KeySet* set : sets) {
+                        count += set->size();
+                    }
                 }
+                continue;
             }
+            hits.clear();
+            CollectPartition(partition, filter, nullptr, std::numeric_limits<size_t>::max(), hits);
+            count += hits.size();
         }
-        return result;
+        return static_cast<int>(count);
     }
-    
+
+    std::vector<AlertPtr> GetActiveAlerts(const std::string& user_id) {
+        AlertQueryParams params = MakeParams(user_id);
+        params.statuses.push_back(AlertStatus::kActive);
+        return Query(params);
+    }
+
+    std::vector<AlertPtr> GetAlertsByType(AlertType type, const std::string& user_id) {
+        AlertQueryParams params = MakeParams(user_id);
+        params.alert_types.push_back(type);
+        return Query(params);
+    }
+
+    std::vector<AlertPtr> GetAlertsByLevel(AlertLevel level, const std::string& user_id) {
+        AlertQueryParams params = MakeParams(user_id);
+        params.alert_levels.push_back(level);
+        return Query(params);
+    }
+
     bool UpdateStatus(const std::string& alert_id, AlertStatus status) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_alerts.find(alert_id);
-        if (it != m_alerts.end()) {
-            it->second->status = status;
-            return true;
-        }
-        return false;
+        return WithEntry(alert_id, [status](Partition& partition, const EntryKey& key, Entry& entry) {
+            partition.SetStatus(key, entry, status);
+            entry.alert->status = status;
+        });
     }
-    
+
     bool Acknowledge(const std::string& alert_id, const std::string& user_id, const std::string& action) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_alerts.find(alert_id);
-        if (it != m_alerts.end()) {
-            it->second->status = AlertStatus::kAcknowledged;
+        bool found = UpdateStatus(alert_id, AlertStatus::kAcknowledged);
+        if (found) {
             AcknowledgeData data;
             data.alert_id = alert_id;
             data.user_id = user_id;
             data.acknowledge_time = DateTime::Now();
             data.user_action = action;
-            m_acknowledges.push_back(data);
-            return true;
+            SaveAcknowledge(data);
         }
-        return false;
+        return found;
     }
-    
+
     bool SaveAcknowledge(const AcknowledgeData& data) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_recordMutex);
         m_acknowledges.push_back(data);
         return true;
     }
-    
+
     bool SaveFeedback(const FeedbackData& data) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_recordMutex);
         m_feedbacks.push_back(data);
         return true;
     }
-    
+
+    int DropPartitionsBefore(const DateTime& cutoff) {
+        int64_t firstKept = FloorDiv(ToEpochMs(cutoff), m_spanMs);
+        std::vector<PartitionPtr> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_directoryMutex);
+            DirectoryPtr current = std::atomic_load(&m_directory);
+            auto end = current->partitions.lower_bound(firstKept);
+            if (end == current->partitions.begin()) {
+                return 0;
+            }
+            std::shared_ptr<Directory> next = std::make_shared<Directory>();
+            next->partitions.insert(end, current->partitions.end());
+            for (auto it = current->partitions.begin(); it != end; ++it) {
+                dropped.push_back(it->second);
+            }
+            std::atomic_store(&m_directory, DirectoryPtr(next));
+        }
+
+        for (const auto& partition : dropped) {
+            PurgeIds(*partition);
+        }
+
+        LOG_INFO() << "Dropped " << static_cast<int>(dropped.size()) << " alert partitions";
+        return static_cast<int>(dropped.size());
+    }
+
+    int GetPartitionCount() const {
+        return static_cast<int>(std::atomic_load(&m_directory)->partitions.size());
+    }
+
 private:
-    std::map<std::string, AlertPtr> m_alerts;
+    static AlertQueryParams MakeParams(const std::string& user_id) {
+        AlertQueryParams params;
+        params.user_id = user_id;
+        params.page = 1;
+        params.page_size = 0;
+        return params;
+    }
+
+    IdShard& ShardFor(const std::string& alert_id) {
+        return *m_idShards[std::hash<std::string>()(alert_id) % kIdShards];
+    }
+
+    PartitionPtr FindPartition(int64_t bucket) const {
+        DirectoryPtr directory = std::atomic_load(&m_directory);
+        auto it = directory->partitions.find(bucket);
+        return it != directory->partitions.end() ? it->second : PartitionPtr();
+    }
+
+    PartitionPtr GetOrCreatePartition(int64_t bucket) {
+        PartitionPtr partition = FindPartition(bucket);
+        if (partition) {
+            return partition;
+        }
+
+        std::lock_guard<std::mutex> lock(m_directoryMutex);
+        DirectoryPtr current = std::atomic_load(&m_directory);
+        auto it = current->partitions.find(bucket);
+        if (it != current->partitions.end()) {
+            return it->second;
+        }
+        std::shared_ptr<Directory> next = std::make_shared<Directory>(*current);
+        partition = std::make_shared<Partition>(bucket);
+        next->partitions[bucket] = partition;
+        std::atomic_store(&m_directory, DirectoryPtr(next));
+        return partition;
+    }
+
+    /**
+     * Forgets the ids of a partition that has left the directory. An id
+     * whose bucket was recreated by a later Save is kept.
+     */
+    void PurgeIds(Partition& partition) {
+        std::vector<std::string> ids;
+        {
+            base::ReadLockGuard lock(partition.lock);
+            ids.reserve(partition.issueTimes.size());
+            for (const auto& pair : partition.issueTimes) {
+                ids.push_back(pair.first);
+            }
+        }
+        for (const auto& id : ids) {
+            IdShard& shard = ShardFor(id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.buckets.find(id);
+            if (it != shard.buckets.end() && it->second == partition.bucket && !FindPartition(partition.bucket)) {
+                shard.buckets.erase(it);
+            }
+        }
+    }
+
+    /**
+     * Runs fn on the entry for alert_id under its partition lock. Index
+     * entries left behind by dropped partitions are purged on the way.
+     */
+    bool WithEntry(const std::string& alert_id,
+                   const std::function<void(Partition&, const EntryKey&, Entry&)>& fn) {
+        IdShard& shard = ShardFor(alert_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(alert_id);
+        if (it == shard.buckets.end()) {
+            return false;
+        }
+        PartitionPtr partition = FindPartition(it->second);
+        if (!partition) {
+            shard.buckets.erase(it);
+            return false;
+        }
+        base::WriteLockGuard partitionLock(partition->lock);
+        EntryKey key;
+        Entry* entry = partition->Find(alert_id, &key);
+        if (!entry) {
+            return false;
+        }
+        fn(*partition, key, *entry);
+        return true;
+    }
+
+    std::vector<Hit> Collect(const Filter& filter, const EntryKey* bound, size_t want) {
+        std::vector<Hit> hits;
+        DirectoryPtr directory = std::atomic_load(&m_directory);
+        for (auto it = directory->partitions.rbegin(); it != directory->partitions.rend(); ++it) {
+            int64_t first = it->first * m_spanMs;
+            int64_t last = first + m_spanMs - 1;
+            if (filter.hasEnd && first > filter.endMs) {
+                continue;
+            }
+            if (bound && first > bound->first) {
+                continue;
+            }
+            if (filter.hasStart && last < filter.startMs) {
+                break;
+            }
+
+            CollectPartition(*it->second, filter, bound, want - hits.size(), hits);
+            if (hits.size() >= want) {
+                break;
+            }
+        }
+        return hits;
+    }
+
+    /**
+     * Appends up to want matches below bound, newest first. The partition
+     * lock is taken shared for one chunk of candidate keys at a time and the
+     * walk resumes below the last key, so ingest into the same partition is
+     * not held up for the length of the scan.
+     */
+    void CollectPartition(Partition& partition, const Filter& filter, const EntryKey* bound,
+                          size_t want, std::vector<Hit>& out) {
+        bool bounded = bound != nullptr;
+        EntryKey resume;
+        if (bound) {
+            resume = *bound;
+        }
+        if (filter.hasEnd && filter.endMs < std::numeric_limits<int64_t>::max()) {
+            EntryKey end(filter.endMs + 1, std::string());
+            if (!bounded || end < resume) {
+                resume = end;
+                bounded = true;
+            }
+        }
+
+        auto entryKey = [](const std::pair<const EntryKey, Entry>& item) -> const EntryKey& {
+            return item.first;
+        };
+        auto setKey = [](const EntryKey& key) -> const EntryKey& { return key; };
+
+        size_t taken = 0;
+        std::vector<EntryKey> keys;
+        while (taken < want) {
+            base::ReadLockGuard lock(partition.lock);
+            keys.clear();
+            size_t available = 0;
+            std::vector<const KeySet*> sets;
+            if (!SelectIndex(partition, filter, sets)) {
+                auto end = bounded ? partition.entries.lower_bound(resume) : partition.entries.end();
+                available = TakeKeysBelow(partition.entries.begin(), end, entryKey, kScanChunk, keys);
+            } else {
+                for (const KeySet* set : sets) {
+                    auto end = bounded ? set->lower_bound(resume) : set->end();
+                    available += TakeKeysBelow(set->begin(), end, setKey, kScanChunk, keys);
+                }
+                if (sets.size() > 1) {
+                    // Each set gave its newest chunk, so the newest chunk of
+                    // the union is among them.
+                    std::sort(keys.begin(), keys.end(), KeyAfter);
+                    if (keys.size() > kScanChunk) {
+                        keys.resize(kScanChunk);
+                    }
+                }
+            }
+
+            for (const EntryKey& key : keys) {
+                if (filter.hasStart && key.first < filter.startMs) {
+                    return;
+                }
+                auto entryIt = partition.entries.find(key);
+                if (entryIt != partition.entries.end() && filter.Matches(entryIt->second)) {
+                    out.push_back(Hit(key, entryIt->second.alert));
+                    if (++taken >= want) {
+                        return;
+                    }
+                }
+            }
+            if (available < kScanChunk || keys.empty()) {
+                return;
+            }
+            resume = keys.back();
+            bounded = true;
+        }
+    }
+
+    int64_t m_spanMs;
+    DirectoryPtr m_directory;
+    std::mutex m_directoryMutex;
+    std::vector<std::unique_ptr<IdShard>> m_idShards;
     std::vector<AcknowledgeData> m_acknowledges;
     std::vector<FeedbackData> m_feedbacks;
-    mutable std::mutex m_mutex;
+    std::mutex m_recordMutex;
 };
 
-AlertRepository::AlertRepository() 
-    : m_impl(std::make_unique<Impl>()) {
+AlertPage IAlertRepository::QueryPage(const AlertQueryParams& params, const PageCursor& after,
+                                      int limit, int skip) {
+    std::vector<AlertPtr> alerts = Query(params);
+    std::stable_sort(alerts.begin(), alerts.end(), [](const AlertPtr& a, const AlertPtr& b) {
+        int64_t ta = ToEpochMs(a->issue_time);
+        int64_t tb = ToEpochMs(b->issue_time);
+        return ta != tb ? ta > tb : a->alert_id > b->alert_id;
+    });
+
+    size_t begin = 0;
+    if (!after.last_id.empty()) {
+        EntryKey bound(ToEpochMs(after.last_time), after.last_id);
+        while (begin < alerts.size() &&
+               EntryKey(ToEpochMs(alerts[begin]->issue_time), alerts[begin]->alert_id) >= bound) {
+            begin++;
+        }
+    }
+    begin = std::min(alerts.size(), begin + static_cast<size_t>(std::max(0, skip)));
+    size_t end = std::min(alerts.size(), begin + static_cast<size_t>(std::max(0, limit)));
+
+    AlertPage page;
+    page.alerts.assign(alerts.begin() + begin, alerts.begin() + end);
+    page.next.has_more = end < alerts.size();
+    page.next.last_id = end > begin ? alerts[end - 1]->alert_id : after.last_id;
+    page.next.last_time = end > begin ? alerts[end - 1]->issue_time : after.last_time;
+    return page;
+}
+
+AlertRepository::AlertRepository()
+    : m_impl(new Impl(AlertRepositoryOptions())) {
 }
 
-AlertRepository::AlertRepository(const std::string& db_path) 
-    : m_impl(std::make_unique<Impl>()) {
+AlertRepository::AlertRepository(const std::string& db_path)
+    : m_impl(new Impl(AlertRepositoryOptions())) {
+}
+
+AlertRepository::AlertRepository(const AlertRepositoryOptions& options)
+    : m_impl(new Impl(options)) {
 }
 
 AlertRepository::~AlertRepository() {
@@ -184,7 +724,7 @@ bool AlertRepository::Save(const AlertPtr& alert) {
 }
 
 bool AlertRepository::Update(const AlertPtr& alert) {
-    return m_impl->Update(alert);
+    return m_impl->Save(alert);
 }
 
 bool AlertRepository::Delete(const std::string& alert_id) {
@@ -203,6 +743,11 @@ int AlertRepository::Count(const AlertQueryParams& params) {
     return m_impl->Count(params);
 }
 
+AlertPage AlertRepository::QueryPage(const AlertQueryParams& params, const PageCursor& after,
+                                     int limit, int skip) {
+    return m_impl->QueryPage(params, after, limit, skip);
+}
+
 std::vector<AlertPtr> AlertRepository::GetActiveAlerts(const std::string& user_id) {
     return m_impl->GetActiveAlerts(user_id);
 }
@@ -231,6 +776,14 @@ bool AlertRepository::SaveFeedback(const FeedbackData& data) {
     return m_impl->SaveFeedback(data);
 }
 
+int AlertRepository::DropPartitionsBefore(const DateTime& cutoff) {
+    return m_impl->DropPartitionsBefore(cutoff);
+}
+
+int AlertRepository::GetPartitionCount() const {
+    return m_impl->GetPartitionCount();
+}
+
 std::unique_ptr<IAlertRepository> IAlertRepository::Create() {
     return std::unique_ptr<IAlertRepository>(new AlertRepository());
 }
@@ -2,10 +2,71 @@
 #include "ogc/alert/exception.h"
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <unordered_map>
 
 namespace ogc {
 namespace alert {
 
+namespace {
+
+const int64_t kWheelSlots = 256;
+
+int64_t FloorDiv(int64_t value, int64_t divisor) {
+    int64_t q = value / divisor;
+    return (value % divisor != 0 && value < 0) ? q - 1 : q;
+}
+
+int64_t DaysFromCivil(int64_t y, int m, int d) {
+    y -= m <= 2 ? 1 : 0;
+    int64_t era = FloorDiv(y, 400);
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+int64_t ToEpochSeconds(const DateTime& dt) {
+    return DaysFromCivil(dt.year, dt.month, dt.day) * 86400 +
+           dt.hour * 3600 + dt.minute * 60 + dt.second;
+}
+
+struct CellKey {
+    size_t identity;
+    int64_t x;
+    int64_t y;
+    int64_t bucket;
+    
+    bool operator==(const CellKey& other) const {
+        return identity == other.identity && x == other.x &&
+               y == other.y && bucket == other.bucket;
+    }
+};
+
+struct CellKeyHash {
+    size_t operator()(const CellKey& key) const {
+        uint64_t h = key.identity;
+        h = (h ^ static_cast<uint64_t>(key.x)) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ static_cast<uint64_t>(key.y)) * 0xC2B2AE3D27D4EB4FULL;
+        h = (h ^ static_cast<uint64_t>(key.bucket)) * 0x165667B19E3779F9ULL;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+size_t HashIdentity(const AlertSignature& signature) {
+    std::hash<std::string> hasher;
+    size_t h = static_cast<size_t>(signature.type);
+    h ^= hasher(signature.source_id) + 0x9E3779B9 + (h << 6) + (h >> 2);
+    h ^= hasher(signature.target_id) + 0x9E3779B9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+bool SameIdentity(const AlertSignature& a, const AlertSignature& b) {
+    return a.type == b.type && a.source_id == b.source_id && a.target_id == b.target_id;
+}
+
+}
+
 bool AlertSignature::operator<(const AlertSignature& other) const {
     if (static_cast<int>(type) != static_cast<int>(other.type)) {
         return static_cast<int>(type) < static_cast<int>(other.type);
@@ -30,8 +91,238 @@ bool AlertSignature::operator==(const AlertSignature& other) const {
            std::abs(position.longitude - other.position.longitude) < 1e-6;
 }
 
+/**
+ * Groups live in a hash map by id. The cell index maps each (identity, cell,
+ * bucket) key to the groups whose latest alert falls there; a group is
+ * re-indexed whenever it moves. The wheel holds one entry per group and
+ * reschedules it on firing when the group has been refreshed in between.
+ */
+struct AlertDeduplicator::Impl {
+    struct Entry {
+        DuplicateGroup group;
+        size_t identity;
+        CellKey cell;
+        int64_t last_seen;
+        int64_t last_emitted;
+    };
+    
+    typedef std::unordered_map<uint64_t, Entry> EntryMap;
+    typedef std::unordered_map<CellKey, std::vector<uint64_t>, CellKeyHash> CellIndex;
+    
+    EntryMap m_entries;
+    CellIndex m_cells;
+    uint64_t m_nextId;
+    
+    double m_cellSize;
+    int64_t m_bucketSeconds;
+    int64_t m_horizonSeconds;
+    
+    std::vector<std::vector<uint64_t>> m_wheel;
+    int64_t m_slotSeconds;
+    int64_t m_cursor;
+    bool m_started;
+    
+    Impl()
+        : m_nextId(1)
+        , m_cellSize(1.0)
+        , m_bucketSeconds(1)
+        , m_horizonSeconds(2)
+        , m_wheel(kWheelSlots)
+        , m_slotSeconds(1)
+        , m_cursor(0)
+        , m_started(false) {
+    }
+    
+    void Configure(const DeduplicationConfig& config) {
+        m_cellSize = std::max(config.spatial_threshold, 1e-9);
+        int64_t window = std::max(config.time_window_seconds, 1);
+        if (config.suppress_repeated && config.suppress_interval_seconds > window) {
+            window = config.suppress_interval_seconds;
+        }
+        m_bucketSeconds = window;
+        m_horizonSeconds = window * 2;
+        m_slotSeconds = std::max<int64_t>(1, (m_horizonSeconds + kWheelSlots - 1) / kWheelSlots);
+        
+        m_cells.clear();
+        for (auto& slot : m_wheel) {
+            slot.clear();
+        }
+        m_started = false;
+        for (auto& pair : m_entries) {
+            pair.second.cell = MakeCell(pair.second.identity,
+                                        pair.second.group.signature.position,
+                                        pair.second.last_seen);
+            m_cells[pair.second.cell].push_back(pair.first);
+        }
+        for (auto& pair : m_entries) {
+            Schedule(pair.first, pair.second.last_seen + m_horizonSeconds);
+        }
+    }
+    
+    void Clear() {
+        m_entries.clear();
+        m_cells.clear();
+        for (auto& slot : m_wheel) {
+            slot.clear();
+        }
+        m_started = false;
+    }
+    
+    CellKey MakeCell(size_t identity, const Coordinate& position, int64_t seconds) const {
+        CellKey key;
+        key.identity = identity;
+        key.x = static_cast<int64_t>(std::floor(position.longitude / m_cellSize));
+        key.y = static_cast<int64_t>(std::floor(position.latitude / m_cellSize));
+        key.bucket = FloorDiv(seconds, m_bucketSeconds);
+        return key;
+    }
+    
+    /**
+     * Returns the id of the nearest group with the same identity within
+     * threshold degrees and one bucket width in time, or 0.
+     */
+    uint64_t FindNearest(const AlertSignature& signature, size_t identity,
+                       int64_t seconds, double threshold) const {
+        CellKey center = MakeCell(identity, signature.position, seconds);
+        uint64_t best = 0;
+        double bestDistance = 0.0;
+        CellKey probe = center;
+        for (int64_t db = -1; db <= 1; ++db) {
+            probe.bucket = center.bucket + db;
+            for (int64_t dx = -1; dx <= 1; ++dx) {
+                probe.x = center.x + dx;
+                for (int64_t dy = -1; dy <= 1; ++dy) {
+                    probe.y = center.y + dy;
+                    auto cell = m_cells.find(probe);
+                    if (cell == m_cells.end()) {
+                        continue;
+                    }
+                    for (uint64_t id : cell->second) {
+                        const Entry& entry = m_entries.find(id)->second;
+                        if (!SameIdentity(entry.group.signature, signature) ||
+                            std::abs(seconds - entry.last_seen) > m_bucketSeconds) {
+                            continue;
+                        }
+                        double lon = entry.group.signature.position.longitude - signature.position.longitude;
+                        double lat = entry.group.signature.position.latitude - signature.position.latitude;
+                        double distance = std::sqrt(lon * lon + lat * lat);
+                        if (distance <= threshold && (best == 0 || distance < bestDistance)) {
+                            best = id;
+                            bestDistance = distance;
+                        }
+                    }
+                }
+            }
+        }
+        return best;
+    }
+    
+    uint64_t Insert(const AlertSignature& signature, size_t identity,
+                    const AlertPtr& alert, int64_t seconds) {
+        uint64_t id = m_nextId++;
+        Entry& entry = m_entries[id];
+        entry.group.signature = signature;
+        entry.group.alerts.push_back(alert);
+        entry.group.representative = alert;
+        entry.group.first_occurrence = alert->issue_time;
+        entry.group.last_occurrence = alert->issue_time;
+        entry.group.occurrence_count = 1;
+        entry.identity = identity;
+        entry.cell = MakeCell(identity, signature.position, seconds);
+        entry.last_seen = seconds;
+        entry.last_emitted = seconds;
+        m_cells[entry.cell].push_back(id);
+        Schedule(id, seconds + m_horizonSeconds);
+        return id;
+    }
+    
+    void Move(uint64_t id, Entry& entry, const Coordinate& position, int64_t seconds) {
+        entry.group.signature.position = position;
+        entry.last_seen = std::max(entry.last_seen, seconds);
+        CellKey cell = MakeCell(entry.identity, position, entry.last_seen);
+        if (cell == entry.cell) {
+            return;
+        }
+        Unindex(id, entry.cell);
+        entry.cell = cell;
+        m_cells[cell].push_back(id);
+    }
+    
+    void Unindex(uint64_t id, const CellKey& cell) {
+        auto it = m_cells.find(cell);
+        if (it == m_cells.end()) {
+            return;
+        }
+        std::vector<uint64_t>& ids = it->second;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] == id) {
+                ids[i] = ids.back();
+                ids.pop_back();
+                break;
+            }
+        }
+        if (ids.empty()) {
+            m_cells.erase(it);
+        }
+    }
+    
+    void Schedule(uint64_t id, int64_t expiry) {
+        int64_t tick = FloorDiv(expiry, m_slotSeconds);
+        if (m_started && tick <= m_cursor) {
+            tick = m_cursor + 1;
+        }
+        int64_t slot = tick % kWheelSlots;
+        if (slot < 0) {
+            slot += kWheelSlots;
+        }
+        m_wheel[static_cast<size_t>(slot)].push_back(id);
+    }
+    
+    /**
+     * Moves the wheel to now, visiting each slot at most once. Entries that
+     * were refreshed since they were scheduled go back on the wheel.
+     */
+    void Advance(int64_t now) {
+        int64_t tick = FloorDiv(now, m_slotSeconds);
+        if (!m_started) {
+            m_cursor = tick;
+            m_started = true;
+            return;
+        }
+        if (tick <= m_cursor) {
+            return;
+        }
+        int64_t steps = std::min(tick - m_cursor, kWheelSlots);
+        int64_t from = m_cursor;
+        m_cursor = tick;
+        std::vector<uint64_t> due;
+        for (int64_t step = 1; step <= steps; ++step) {
+            int64_t slot = (from + step) % kWheelSlots;
+            if (slot < 0) {
+                slot += kWheelSlots;
+            }
+            due.clear();
+            due.swap(m_wheel[static_cast<size_t>(slot)]);
+            for (uint64_t id : due) {
+                auto it = m_entries.find(id);
+                if (it == m_entries.end()) {
+                    continue;
+                }
+                int64_t expiry = it->second.last_seen + m_horizonSeconds;
+                if (expiry <= now) {
+                    Unindex(id, it->second.cell);
+                    m_entries.erase(it);
+                } else {
+                    Schedule(id, expiry);
+                }
+            }
+        }
+    }
+};
+
 AlertDeduplicator::AlertDeduplicator()
-    : m_processedCount(0)
+    : m_impl(new Impl())
+    , m_processedCount(0)
     , m_duplicateCount(0)
     , m_suppressedCount(0) {
     m_config.enabled = true;
@@ -41,13 +332,16 @@ AlertDeduplicator::AlertDeduplicator()
     m_config.max_duplicate_count = 10;
     m_config.suppress_repeated = true;
     m_config.suppress_interval_seconds = 60;
+    m_impl->Configure(m_config);
 }
 
 AlertDeduplicator::AlertDeduplicator(const DeduplicationConfig& config)
-    : m_config(config)
+    : m_impl(new Impl())
+    , m_config(config)
     , m_processedCount(0)
     , m_duplicateCount(0)
     , m_suppressedCount(0) {
+    m_impl->Configure(m_config);
 }
 
 AlertDeduplicator::~AlertDeduplicator() {
@@ -56,6 +350,7 @@ AlertDeduplicator::~AlertDeduplicator() {
 void AlertDeduplicator::SetConfig(const DeduplicationConfig& config) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_config = config;
+    m_impl->Configure(m_config);
 }
 
 DeduplicationConfig AlertDeduplicator::GetConfig() const {
@@ -72,33 +367,46 @@ AlertPtr AlertDeduplicator::Process(AlertPtr alert) {
     }
     
     AlertSignature signature = ComputeSignature(alert);
+    size_t identity = HashIdentity(signature);
+    int64_t seconds = ToEpochSeconds(alert->issue_time);
     
-    CleanupExpiredGroups();
+    m_impl->Advance(seconds);
     
-    if (ShouldSuppress(signature)) {
+    uint64_t id = m_impl->FindNearest(signature, identity, seconds, m_config.spatial_threshold);
+    if (id == 0) {
+        m_impl->Insert(signature, identity, alert, seconds);
+        m_processedCount++;
+        return alert;
+    }
+    
+    Impl::Entry& entry = m_impl->m_entries.find(id)->second;
+    if (m_config.suppress_repeated &&
+        ToEpochSeconds(DateTime::Now()) - entry.last_emitted < m_config.suppress_interval_seconds) {
         m_suppressedCount++;
         return nullptr;
     }
     
-    auto it = m_duplicateGroups.find(signature);
-    if (it != m_duplicateGroups.end()) {
-        if (IsInTimeWindow(alert->issue_time, it->second.last_occurrence)) {
-            m_duplicateCount++;
-            
-            if (m_config.merge_similar) {
-                UpdateGroup(signature, alert);
-                return it->second.representative;
-            }
-            
-            return nullptr;
-        }
-    }
+    bool duplicate = seconds - entry.last_seen <= m_config.time_window_seconds;
     
-    UpdateGroup(signature, alert);
-    m_processedCount++;
+    DuplicateGroup& group = entry.group;
+    group.alerts.push_back(alert);
+    group.last_occurrence = alert->issue_time;
+    group.occurrence_count++;
+    if (group.alerts.size() > static_cast<size_t>(std::max(m_config.max_duplicate_count, 1))) {
+        group.alerts.erase(group.alerts.begin());
+    }
+    if (m_config.merge_similar) {
+        group.representative = MergeAlerts(group.alerts);
+    }
+    m_impl->Move(id, entry, alert->position, seconds);
     
-    m_lastAlertTime[signature] = alert->issue_time;
+    if (duplicate) {
+        m_duplicateCount++;
+        return m_config.merge_similar ? group.representative : nullptr;
+    }
     
+    entry.last_emitted = seconds;
+    m_processedCount++;
     return alert;
 }
 
@@ -124,13 +432,14 @@ bool AlertDeduplicator::IsDuplicate(const AlertPtr& alert) const {
     }
     
     AlertSignature signature = ComputeSignature(alert);
-    auto it = m_duplicateGroups.find(signature);
-    
-    if (it == m_duplicateGroups.end()) {
+    int64_t seconds = ToEpochSeconds(alert->issue_time);
+    uint64_t id = m_impl->FindNearest(signature, HashIdentity(signature), seconds,
+                                      m_config.spatial_threshold);
+    if (id == 0) {
         return false;
     }
     
-    return IsInTimeWindow(alert->issue_time, it->second.last_occurrence);
+    return seconds - m_impl->m_entries.find(id)->second.last_seen <= m_config.time_window_seconds;
 }
 
 bool AlertDeduplicator::IsSuppressed(const AlertPtr& alert) const {
@@ -141,17 +450,25 @@ bool AlertDeduplicator::IsSuppressed(const AlertPtr& alert) const {
     }
     
     AlertSignature signature = ComputeSignature(alert);
-    return ShouldSuppress(signature);
+    uint64_t id = m_impl->FindNearest(signature, HashIdentity(signature),
+                                      ToEpochSeconds(alert->issue_time),
+                                      m_config.spatial_threshold);
+    if (id == 0) {
+        return false;
+    }
+    
+    int64_t lastEmitted = m_impl->m_entries.find(id)->second.last_emitted;
+    return ToEpochSeconds(DateTime::Now()) - lastEmitted < m_config.suppress_interval_seconds;
 }
 
 std::vector<DuplicateGroup> AlertDeduplicator::GetDuplicateGroups() const {
     std::lock_guard<std::mutex> lock(m_mutex);
     
     std::vector<DuplicateGroup> groups;
-    groups.reserve(m_duplicateGroups.size());
+    groups.reserve(m_impl->m_entries.size());
     
-    for (const auto& pair : m_duplicateGroups) {
-        groups.push_back(pair.second);
+    for (const auto& pair : m_impl->m_entries) {
+        groups.push_back(pair.second.group);
     }
     
     return groups;
@@ -159,8 +476,7 @@ std::vector<DuplicateGroup> AlertDeduplicator::GetDuplicateGroups() const {
 
 void AlertDeduplicator::ClearHistory() {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_duplicateGroups.clear();
-    m_lastAlertTime.clear();
+    m_impl->Clear();
 }
 
 size_t AlertDeduplicator::GetProcessedCount() const {
@@ -184,11 +500,13 @@ void AlertDeduplicator::ResetStatistics() {
 void AlertDeduplicator::SetTimeWindow(int seconds) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_config.time_window_seconds = seconds;
+    m_impl->Configure(m_config);
 }
 
 void AlertDeduplicator::SetSpatialThreshold(double threshold) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_config.spatial_threshold = threshold;
+    m_impl->Configure(m_config);
 }
 
 void AlertDeduplicator::EnableMerge(bool enable) {
@@ -200,6 +518,7 @@ void AlertDeduplicator::EnableSuppress(bool enable, int interval_seconds) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_config.suppress_repeated = enable;
     m_config.suppress_interval_seconds = interval_seconds;
+    m_impl->Configure(m_config);
 }
 
 AlertSignature AlertDeduplicator::ComputeSignature(const AlertPtr& alert) const {
@@ -231,18 +550,6 @@ AlertSignature AlertDeduplicator::ComputeSignature(const AlertPtr& alert) const
     return signature;
 }
 
-bool AlertDeduplicator::IsInTimeWindow(const DateTime& current, const DateTime& previous) const {
-    int64_t diff = current.ToTimestamp() - previous.ToTimestamp();
-    return diff <= m_config.time_window_seconds;
-}
-
-bool AlertDeduplicator::IsInSpatialWindow(const Coordinate& a, const Coordinate& b) const {
-    double dx = a.longitude - b.longitude;
-    double dy = a.latitude - b.latitude;
-    double distance = std::sqrt(dx * dx + dy * dy);
-    return distance <= m_config.spatial_threshold;
-}
-
 AlertPtr AlertDeduplicator::MergeAlerts(const std::vector<AlertPtr>& alerts) const {
     if (alerts.empty()) {
         return nullptr;
@@ -266,63 +573,6 @@ AlertPtr AlertDeduplicator::MergeAlerts(const std::vector<AlertPtr>& alerts) con
     return merged;
 }
 
-bool AlertDeduplicator::ShouldSuppress(const AlertSignature& signature) const {
-    if (!m_config.suppress_repeated) {
-        return false;
-    }
-    
-    auto it = m_lastAlertTime.find(signature);
-    if (it == m_lastAlertTime.end()) {
-        return false;
-    }
-    
-    DateTime now = DateTime::Now();
-    int64_t diff = now.ToTimestamp() - it->second.ToTimestamp();
-    
-    return diff < m_config.suppress_interval_seconds;
-}
-
-void AlertDeduplicator::UpdateGroup(const AlertSignature& signature, AlertPtr alert) {
-    auto it = m_duplicateGroups.find(signature);
-    
-    if (it == m_duplicateGroups.end()) {
-        DuplicateGroup group;
-        group.signature = signature;
-        group.alerts.push_back(alert);
-        group.representative = alert;
-        group.first_occurrence = alert->issue_time;
-        group.last_occurrence = alert->issue_time;
-        group.occurrence_count = 1;
-        m_duplicateGroups[signature] = group;
-    } else {
-        it->second.alerts.push_back(alert);
-        it->second.last_occurrence = alert->issue_time;
-        it->second.occurrence_count++;
-        
-        if (it->second.alerts.size() > static_cast<size_t>(m_config.max_duplicate_count)) {
-            it->second.alerts.erase(it->second.alerts.begin());
-        }
-        
-        if (m_config.merge_similar) {
-            it->second.representative = MergeAlerts(it->second.alerts);
-        }
-    }
-}
-
-void AlertDeduplicator::CleanupExpiredGroups() {
-    DateTime now = DateTime::Now();
-    int64_t expiry_seconds = m_config.time_window_seconds * 2;
-    
-    for (auto it = m_duplicateGroups.begin(); it != m_duplicateGroups.end(); ) {
-        int64_t diff = now.ToTimestamp() - it->second.last_occurrence.ToTimestamp();
-        if (diff > expiry_seconds) {
-            it = m_duplicateGroups.erase(it);
-        } else {
-            ++it;
-        }
-    }
-}
-
 AlertAggregator::AlertAggregator() {
     m_config.strategy = AggregationStrategy::kCombined;
     m_config.time_window_seconds = 300;
@@ -26,19 +26,15 @@ public:
         auto startTime = std::chrono::high_resolution_clock::now();
         
         AlertListResult result;
+        result.total_count = 0;
+        result.page = params.page;
+        result.page_size = params.page_size;
         if (m_repository) {
-            auto alerts = m_repository->Query(params);
-            result.total_count = static_cast<int>(alerts.size());
-            
-            int start = (params.page - 1) * params.page_size;
-            int end = std::min(start + params.page_size, static_cast<int>(alerts.size()));
-            
-            for (int i = start; i < end; ++i) {
-                result.alerts.push_back(alerts[i]);
-            }
-            
-            result.page = params.page;
-            result.page_size = params.page_size;
+            result.total_count = m_repository->Count(params);
+            int skip = std::max(0, params.page - 1) * params.page_size;
+            AlertPage page = m_repository->QueryPage(params, PageCursor(), params.page_size, skip);
+            result.alerts.swap(page.alerts);
+            result.next_cursor = page.next;
         }
         
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -110,11 +106,21 @@ public:
     }
     
     int GetActiveAlertCount(const std::string& user_id) {
-        return static_cast<int>(GetActiveAlerts(user_id).size());
+        if (!m_repository) {
+            return 0;
+        }
+        AlertQueryParams params = MakeParams(user_id);
+        params.statuses.push_back(AlertStatus::kActive);
+        return m_repository->Count(params);
     }
     
     int GetAlertCountByType(const std::string& user_id, AlertType type) {
-        return static_cast<int>(GetAlertsByType(user_id, type).size());
+        if (!m_repository) {
+            return 0;
+        }
+        AlertQueryParams params = MakeParams(user_id);
+        params.alert_types.push_back(type);
+        return m_repository->Count(params);
     }
     
     std::vector<AlertPtr> SearchAlerts(const std::string& user_id, const std::string& keyword) {
@@ -132,20 +138,19 @@ public:
     AlertListResult GetAlertListOptimized(const OptimizedQueryParams& params) {
         auto startTime = std::chrono::high_resolution_clock::now();
         
-        AlertListResult result;
+        AlertQueryParams queryParams;
+        queryParams.user_id = params.user_id;
+        queryParams.alert_types = params.alert_types;
+        queryParams.alert_levels = params.alert_levels;
+        queryParams.start_time = params.start_time;
+        queryParams.end_time = params.end_time;
+        queryParams.page = 1;
+        queryParams.page_size = params.limit;
         
-        if (params.use_cursor && !params.cursor.last_id.empty()) {
-            result = GetAlertListByCursorInternal(params.user_id, params.cursor, params.limit);
+        AlertListResult result;
+        if (params.use_cursor) {
+            result = QueryByCursor(queryParams, params.cursor, params.limit);
         } else {
-            AlertQueryParams queryParams;
-            queryParams.user_id = params.user_id;
-            queryParams.alert_types = params.alert_types;
-            queryParams.alert_levels = params.alert_levels;
-            queryParams.start_time = params.start_time;
-            queryParams.end_time = params.end_time;
-            queryParams.page = 1;
-            queryParams.page_size = params.limit;
-            
             result = GetAlertList(queryParams);
         }
         
@@ -165,17 +170,8 @@ public:
     
     PageCursor GetFirstPageCursor(const std::string& user_id) {
         PageCursor cursor;
-        cursor.last_id = "";
         cursor.last_time = DateTime::Now();
-        cursor.has_more = true;
-        
-        auto alerts = GetActiveAlerts(user_id);
-        if (!alerts.empty()) {
-            cursor.has_more = alerts.size() > 1;
-        } else {
-            cursor.has_more = false;
-        }
-        
+        cursor.has_more = GetActiveAlertCount(user_id) > 0;
         return cursor;
     }
     
@@ -260,38 +256,33 @@ public:
     }
     
 private:
+    static AlertQueryParams MakeParams(const std::string& user_id) {
+        AlertQueryParams params;
+        params.user_id = user_id;
+        params.page = 1;
+        params.page_size = 0;
+        return params;
+    }
+    
     AlertListResult GetAlertListByCursorInternal(const std::string& user_id, 
                                                   const PageCursor& cursor, 
                                                   int limit) {
+        AlertQueryParams params = MakeParams(user_id);
+        params.statuses.push_back(AlertStatus::kActive);
+        return QueryByCursor(params, cursor, limit);
+    }
+    
+    AlertListResult QueryByCursor(const AlertQueryParams& params, const PageCursor& cursor, int limit) {
         AlertListResult result;
-        
-        auto allAlerts = GetActiveAlerts(user_id);
-        
-        std::sort(allAlerts.begin(), allAlerts.end(), 
-            [](const AlertPtr& a, const AlertPtr& b) {
-                return a->issue_time > b->issue_time;
-            });
-        
-        size_t startIndex = 0;
-        if (!cursor.last_id.empty()) {
-            for (size_t i = 0; i < allAlerts.size(); ++i) {
-                if (allAlerts[i]->alert_id == cursor.last_id) {
-                    startIndex = i + 1;
-                    break;
-                }
-            }
-        }
-        
-        size_t endIndex = std::min(startIndex + static_cast<size_t>(limit), allAlerts.size());
-        
-        for (size_t i = startIndex; i < endIndex; ++i) {
-            result.alerts.push_back(allAlerts[i]);
-        }
-        
-        result.total_count = static_cast<int>(allAlerts.size());
+        result.total_count = 0;
         result.page = 0;
         result.page_size = limit;
-        
+        if (m_repository) {
+            AlertPage page = m_repository->QueryPage(params, cursor, limit);
+            result.alerts.swap(page.alerts);
+            result.next_cursor = page.next;
+            result.total_count = m_repository->Count(params);
+        }
         return result;
     }
     
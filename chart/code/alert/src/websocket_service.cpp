@@ -2,9 +2,34 @@
 #include "ogc/base/log.h"
 #include <map>
 #include <set>
+#include <deque>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
 #include <algorithm>
 #include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#endif
 
 using ogc::base::LogLevel;
 using ogc::base::LogHelper;
@@ -12,212 +37,1387 @@ using ogc::base::LogHelper;
 namespace ogc {
 namespace alert {
 
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+const SocketHandle kInvalidSocket = -1;
+#endif
+
+#if defined(MSG_NOSIGNAL)
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+const int kSessionShards = 16;
+const size_t kMaxHandshakeBytes = 8192;
+const size_t kReadChunk = 16384;
+const int kMaxReadsPerEvent = 4;
+const int kAcceptBackoffMs = 100;
+
+const uint8_t kOpContinuation = 0x0;
+const uint8_t kOpText = 0x1;
+const uint8_t kOpBinary = 0x2;
+const uint8_t kOpClose = 0x8;
+const uint8_t kOpPing = 0x9;
+const uint8_t kOpPong = 0xA;
+
+typedef std::shared_ptr<const std::string> FramePtr;
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CloseSocket(SocketHandle fd) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+bool SetNonBlocking(SocketHandle fd) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool WouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// accept() failed for lack of descriptors or memory; the connection stays
+// queued, so the listener keeps polling readable until something is freed.
+bool OutOfResources() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEMFILE || error == WSAENOBUFS;
+#else
+    return errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM;
+#endif
+}
+
+uint32_t RotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+std::string Sha1(const std::string& input) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string msg = input;
+    uint64_t bitLength = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while (msg.size() % 64 != 56) {
+        msg.push_back(static_cast<char>(0));
+    }
+    for (int i = 7; i >= 0; --i) {
+        msg.push_back(static_cast<char>((bitLength >> (i * 8)) & 0xFF));
+    }
+
+    for (size_t offset = 0; offset < msg.size(); offset += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data() + offset + i * 4);
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string digest(20, '\0');
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<char>((h[i] >> 24) & 0xFF);
+        digest[i * 4 + 1] = static_cast<char>((h[i] >> 16) & 0xFF);
+        digest[i * 4 + 2] = static_cast<char>((h[i] >> 8) & 0xFF);
+        digest[i * 4 + 3] = static_cast<char>(h[i] & 0xFF);
+    }
+    return digest;
+}
+
+std::string Base64Encode(const std::string& input) {
+    static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string output;
+    output.reserve((input.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < input.size(); i += 3) {
+        uint32_t n = (static_cast<uint8_t>(input[i]) << 16) |
+                     (static_cast<uint8_t>(input[i + 1]) << 8) |
+                     static_cast<uint8_t>(input[i + 2]);
+        output.push_back(table[(n >> 18) & 0x3F]);
+        output.push_back(table[(n >> 12) & 0x3F]);
+        output.push_back(table[(n >> 6) & 0x3F]);
+        output.push_back(table[n & 0x3F]);
+    }
+    if (i < input.size()) {
+        uint32_t n = static_cast<uint8_t>(input[i]) << 16;
+        if (i + 1 < input.size()) {
+            n |= static_cast<uint8_t>(input[i + 1]) << 8;
+        }
+        output.push_back(table[(n >> 18) & 0x3F]);
+        output.push_back(table[(n >> 12) & 0x3F]);
+        output.push_back(i + 1 < input.size() ? table[(n >> 6) & 0x3F] : '=');
+        output.push_back('=');
+    }
+    return output;
+}
+
+std::string ComputeAcceptKey(const std::string& key) {
+    return Base64Encode(Sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+FramePtr MakeFrame(uint8_t opcode, const std::string& payload) {
+    std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+    frame->reserve(payload.size() + 10);
+    frame->push_back(static_cast<char>(0x80 | opcode));
+    uint64_t length = payload.size();
+    if (length < 126) {
+        frame->push_back(static_cast<char>(length));
+    } else if (length <= 0xFFFF) {
+        frame->push_back(static_cast<char>(126));
+        frame->push_back(static_cast<char>((length >> 8) & 0xFF));
+        frame->push_back(static_cast<char>(length & 0xFF));
+    } else {
+        frame->push_back(static_cast<char>(127));
+        for (int i = 7; i >= 0; --i) {
+            frame->push_back(static_cast<char>((length >> (i * 8)) & 0xFF));
+        }
+    }
+    frame->append(payload);
+    return frame;
+}
+
+FramePtr MakeCloseFrame(uint16_t code) {
+    std::string payload;
+    payload.push_back(static_cast<char>((code >> 8) & 0xFF));
+    payload.push_back(static_cast<char>(code & 0xFF));
+    return MakeFrame(kOpClose, payload);
+}
+
+std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](char c) {
+        return static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+    });
+    return value;
+}
+
+std::string Trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(begin, end - begin + 1);
+}
+
+struct PollEvent {
+    SocketHandle fd;
+    bool readable;
+    bool writable;
+};
+
+/**
+ * Readiness notification over epoll where available and poll() elsewhere.
+ * Add/Modify/Remove/Wait run on the event-loop thread; Wake may be called
+ * from any thread to interrupt Wait.
+ */
+class Poller {
+public:
+#if defined(__linux__)
+    Poller() : m_epoll(-1), m_wake(-1) {}
+#elif !defined(_WIN32)
+    Poller() { m_wake[0] = m_wake[1] = -1; }
+#else
+    Poller() {}
+#endif
+
+    ~Poller() {
+        Close();
+    }
+
+    bool Open() {
+#if defined(__linux__)
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_epoll < 0 || m_wake < 0) {
+            Close();
+            return false;
+        }
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = m_wake;
+        return epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &ev) == 0;
+#elif !defined(_WIN32)
+        if (pipe(m_wake) != 0) {
+            return false;
+        }
+        SetNonBlocking(m_wake[0]);
+        SetNonBlocking(m_wake[1]);
+        return true;
+#else
+        return true;
+#endif
+    }
+
+    void Close() {
+#if defined(__linux__)
+        if (m_epoll >= 0) {
+            close(m_epoll);
+            m_epoll = -1;
+        }
+        if (m_wake >= 0) {
+            close(m_wake);
+            m_wake = -1;
+        }
+#elif !defined(_WIN32)
+        for (int i = 0; i < 2; ++i) {
+            if (m_wake[i] >= 0) {
+                close(m_wake[i]);
+                m_wake[i] = -1;
+            }
+        }
+        m_fds.clear();
+#else
+        m_fds.clear();
+#endif
+    }
+
+    bool Add(SocketHandle fd, bool wantWrite) {
+#if defined(__linux__)
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = fd;
+        return epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) == 0;
+#else
+        m_fds[fd] = wantWrite;
+        return true;
+#endif
+    }
+
+    void Modify(SocketHandle fd, bool wantWrite) {
+#if defined(__linux__)
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev);
+#else
+        m_fds[fd] = wantWrite;
+#endif
+    }
+
+    void Remove(SocketHandle fd) {
+#if defined(__linux__)
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+#else
+        m_fds.erase(fd);
+#endif
+    }
+
+    void Wake() {
+#if defined(__linux__)
+        uint64_t one = 1;
+        ssize_t written = write(m_wake, &one, sizeof(one));
+        (void)written;
+#elif !defined(_WIN32)
+        char byte = 1;
+        ssize_t written = write(m_wake[1], &byte, 1);
+        (void)written;
+#endif
+    }
+
+    void Wait(int timeoutMs, std::vector<PollEvent>& events) {
+        events.clear();
+#if defined(__linux__)
+        epoll_event ready[256];
+        int count = epoll_wait(m_epoll, ready, 256, timeoutMs);
+        for (int i = 0; i < count; ++i) {
+            if (ready[i].data.fd == m_wake) {
+                uint64_t value;
+                ssize_t drained = read(m_wake, &value, sizeof(value));
+                (void)drained;
+                continue;
+            }
+            PollEvent event;
+            event.fd = ready[i].data.fd;
+            event.readable = (ready[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+            event.writable = (ready[i].events & EPOLLOUT) != 0;
+            events.push_back(event);
+        }
+#else
+        m_pollfds.clear();
+#ifndef _WIN32
+        pollfd wake;
+        wake.fd = m_wake[0];
+        wake.events = POLLIN;
+        wake.revents = 0;
+        m_pollfds.push_back(wake);
+#else
+        // No portable wake handle for WSAPoll; bound the latency instead.
+        timeoutMs = std::min(timeoutMs, 10);
+#endif
+        for (const auto& entry : m_fds) {
+            pollfd pfd;
+            pfd.fd = entry.first;
+            pfd.events = static_cast<short>(POLLIN | (entry.second ? POLLOUT : 0));
+            pfd.revents = 0;
+            m_pollfds.push_back(pfd);
+        }
+#ifdef _WIN32
+        if (m_pollfds.empty()) {
+            Sleep(timeoutMs);
+            return;
+        }
+        int count = WSAPoll(m_pollfds.data(), static_cast<ULONG>(m_pollfds.size()), timeoutMs);
+#else
+        int count = poll(m_pollfds.data(), m_pollfds.size(), timeoutMs);
+#endif
+        if (count <= 0) {
+            return;
+        }
+        for (const auto& pfd : m_pollfds) {
+            if (pfd.revents == 0) {
+                continue;
+            }
+#ifndef _WIN32
+            if (pfd.fd == m_wake[0]) {
+                char buffer[64];
+                while (read(m_wake[0], buffer, sizeof(buffer)) > 0) {
+                }
+                continue;
+            }
+#endif
+            PollEvent event;
+            event.fd = pfd.fd;
+            event.readable = (pfd.revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+            event.writable = (pfd.revents & POLLOUT) != 0;
+            events.push_back(event);
+        }
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    int m_epoll;
+    int m_wake;
+#else
+#ifndef _WIN32
+    int m_wake[2];
+#endif
+    std::map<SocketHandle, bool> m_fds;
+    std::vector<pollfd> m_pollfds;
+#endif
+};
+
+/**
+ * One accepted socket. Fields under mutex may be touched by any sending
+ * thread; the rest belong to the event-loop thread.
+ */
+struct Connection {
+    SocketHandle fd;
+
+    std::mutex mutex;
+    WebSocketSession info;
+    std::set<AlertType> subscriptions;
+    std::deque<FramePtr> queue;
+    size_t queueBytes;
+    size_t frontOffset;
+    bool flushScheduled;
+    bool closing;
+    bool evicted;
+
+    std::string readBuffer;
+    std::string fragment;
+    uint8_t fragmentOpcode;
+    bool handshakeDone;
+    bool wantWrite;
+    bool tornDown;
+    int64_t acceptedMs;
+    int64_t lastReceiveMs;
+    int64_t lastPingMs;
+
+    explicit Connection(SocketHandle socket)
+        : fd(socket)
+        , queueBytes(0)
+        , frontOffset(0)
+        , flushScheduled(false)
+        , closing(false)
+        , evicted(false)
+        , fragmentOpcode(0)
+        , handshakeDone(false)
+        , wantWrite(false)
+        , tornDown(false)
+        , acceptedMs(0)
+        , lastReceiveMs(0)
+        , lastPingMs(0) {
+        info.authenticated = false;
+    }
+};
+
+typedef std::shared_ptr<Connection> ConnectionPtr;
+
+struct SessionShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, ConnectionPtr> sessions;
+};
+
+struct UserShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::set<std::string>> sessions;
+};
+
+size_t ShardIndex(const std::string& key) {
+    return std::hash<std::string>()(key) % kSessionShards;
+}
+
+}
+
 class WebSocketService::Impl {
 public:
-    Impl() : m_running(false) {}
-    
+    Impl()
+        : m_running(false)
+        , m_loopId(std::thread::id())
+        , m_listen(kInvalidSocket)
+        , m_listenPort(0)
+        , m_acceptResumeMs(0)
+        , m_messagesQueued(0)
+        , m_bytesSent(0)
+        , m_evicted(0)
+        , m_rejected(0) {
+        for (int i = 0; i < kSessionShards; ++i) {
+            m_sessionShards.emplace_back(new SessionShard());
+            m_userShards.emplace_back(new UserShard());
+        }
+    }
+
     ~Impl() {
         Stop();
     }
-    
+
     bool Start(const WebSocketConfig& config) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        if (OnLoopThread()) {
+            LOG_ERROR() << "WebSocket service cannot be restarted from its own handler";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_lifecycleMutex);
         if (m_running) {
             LOG_WARNING() << "WebSocket service already running";
             return false;
         }
-        
+        // Finishes a stop requested from a handler.
+        StopLocked();
+        if (config.enable_ssl) {
+            LOG_ERROR() << "WebSocket service does not terminate TLS; run it behind a TLS proxy";
+            return false;
+        }
+
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            LOG_ERROR() << "WSAStartup failed";
+            return false;
+        }
+#endif
+
         m_config = config;
+        m_acceptResumeMs = 0;
+        if (!OpenListener() || !m_poller.Open() || !m_poller.Add(m_listen, false)) {
+            LOG_ERROR() << "WebSocket service failed to listen on " << config.host << ":" << config.port;
+            CloseListener();
+            m_poller.Close();
+#ifdef _WIN32
+            WSACleanup();
+#endif
+            return false;
+        }
+
         m_running = true;
-        
-        LOG_INFO() << "WebSocket service started on " << config.host << ":" << config.port;
+        m_loop = std::thread(&Impl::Run, this);
+
+        LOG_INFO() << "WebSocket service started on " << config.host << ":" << m_listenPort;
         return true;
     }
-    
+
     void Stop() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (!m_running) {
+        // Handlers run on the loop thread, which cannot join itself: it is
+        // only told to exit, and the next Start, Stop or the destructor
+        // finishes the shutdown.
+        if (OnLoopThread()) {
+            m_running = false;
             return;
         }
-        
-        m_sessions.clear();
-        m_userSessions.clear();
-        m_sessionSubscriptions.clear();
+        std::lock_guard<std::mutex> lock(m_lifecycleMutex);
+        StopLocked();
+    }
+
+    void StopLocked() {
+        if (!m_loop.joinable()) {
+            return;
+        }
+
         m_running = false;
-        
+        m_poller.Wake();
+        m_loop.join();
+        m_loopId = std::thread::id();
+
+        CloseListener();
+        m_poller.Close();
+        {
+            std::lock_guard<std::mutex> pendingLock(m_pendingMutex);
+            m_pending.clear();
+        }
+        for (auto& shard : m_userShards) {
+            std::lock_guard<std::mutex> shardLock(shard->mutex);
+            shard->sessions.clear();
+        }
+#ifdef _WIN32
+        WSACleanup();
+#endif
+
         LOG_INFO() << "WebSocket service stopped";
     }
-    
+
     bool IsRunning() const {
-        std::lock_guard<std::mutex> lock(m_mutex);
         return m_running;
     }
-    
+
     void SetMessageHandler(WebSocketMessageHandler handler) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_handlerMutex);
         m_messageHandler = handler;
     }
-    
+
     void SetConnectHandler(WebSocketConnectHandler handler) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_handlerMutex);
         m_connectHandler = handler;
     }
-    
+
     void SetDisconnectHandler(WebSocketDisconnectHandler handler) {
-        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> lock(m_handlerMutex);
         m_disconnectHandler = handler;
     }
-    
+
     bool SendToSession(const std::string& session_id, const std::string& message) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessions.find(session_id);
-        if (it == m_sessions.end()) {
-            LOG_WARNING() << "Session not found: " << session_id;
+        ConnectionPtr conn = FindSession(session_id);
+        if (!conn) {
+            LOG_DEBUG() << "Session not found: " << session_id;
             return false;
         }
-        
-        LOG_DEBUG() << "Message sent to session " << session_id << ": " << message.substr(0, 100);
-        return true;
+
+        bool queued = Enqueue(conn, MakeFrame(kOpText, message), false);
+        m_poller.Wake();
+        return queued;
     }
-    
+
     bool SendToUser(const std::string& user_id, const std::string& message) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_userSessions.find(user_id);
-        if (it == m_userSessions.end() || it->second.empty()) {
-            LOG_WARNING() << "No sessions for user: " << user_id;
+        std::set<std::string> sessionIds;
+        {
+            UserShard& shard = *m_userShards[ShardIndex(user_id)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.sessions.find(user_id);
+            if (it != shard.sessions.end()) {
+                sessionIds = it->second;
+            }
+        }
+        if (sessionIds.empty()) {
+            LOG_DEBUG() << "No sessions for user: " << user_id;
             return false;
         }
-        
-        for (const auto& sessionId : it->second) {
-            LOG_DEBUG() << "Message sent to user " << user_id << " session " << sessionId;
+
+        FramePtr frame = MakeFrame(kOpText, message);
+        int queued = 0;
+        for (const auto& sessionId : sessionIds) {
+            ConnectionPtr conn = FindSession(sessionId);
+            if (conn && Enqueue(conn, frame, false)) {
+                queued++;
+            }
         }
-        return true;
-    }
-    
-    void Broadcast(const std::string& message) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        LOG_DEBUG() << "Broadcasting message to " << static_cast<int>(m_sessions.size()) << " sessions";
+        m_poller.Wake();
+        return queued > 0;
     }
-    
-    void BroadcastExcept(const std::string& message, const std::vector<std::string>& exclude_sessions) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        int count = 0;
-        for (const auto& pair : m_sessions) {
-            if (std::find(exclude_sessions.begin(), exclude_sessions.end(), pair.first) == exclude_sessions.end()) {
-                count++;
+
+    int Broadcast(const std::string& message, const std::unordered_set<std::string>* exclude,
+                  const AlertType* alertType) {
+        FramePtr frame = MakeFrame(kOpText, message);
+        std::vector<ConnectionPtr> targets;
+        int queued = 0;
+        for (auto& shard : m_sessionShards) {
+            targets.clear();
+            {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                targets.reserve(shard->sessions.size());
+                for (const auto& pair : shard->sessions) {
+                    if (!exclude || exclude->find(pair.first) == exclude->end()) {
+                        targets.push_back(pair.second);
+                    }
+                }
+            }
+            for (const auto& conn : targets) {
+                if (alertType) {
+                    std::lock_guard<std::mutex> lock(conn->mutex);
+                    if (conn->subscriptions.find(*alertType) == conn->subscriptions.end()) {
+                        continue;
+                    }
+                }
+                if (Enqueue(conn, frame, false)) {
+                    queued++;
+                }
             }
         }
-        LOG_DEBUG() << "Broadcasting message to " << count << " sessions (excluding " << static_cast<int>(exclude_sessions.size()) << ")";
+        m_poller.Wake();
+        return queued;
     }
-    
+
     std::vector<WebSocketSession> GetActiveSessions() {
-        std::lock_guard<std::mutex> lock(m_mutex);
         std::vector<WebSocketSession> result;
-        for (const auto& pair : m_sessions) {
-            result.push_back(pair.second);
+        for (auto& shard : m_sessionShards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            for (const auto& pair : shard->sessions) {
+                std::lock_guard<std::mutex> connLock(pair.second->mutex);
+                result.push_back(pair.second->info);
+            }
         }
         return result;
     }
-    
+
     WebSocketSession GetSession(const std::string& session_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessions.find(session_id);
-        if (it != m_sessions.end()) {
-            return it->second;
+        ConnectionPtr conn = FindSession(session_id);
+        if (conn) {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            return conn->info;
         }
         return WebSocketSession();
     }
-    
+
     int GetSessionCount() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return static_cast<int>(m_sessions.size());
+        size_t count = 0;
+        for (auto& shard : m_sessionShards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            count += shard->sessions.size();
+        }
+        return static_cast<int>(count);
     }
-    
+
     bool CloseSession(const std::string& session_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessions.find(session_id);
-        if (it == m_sessions.end()) {
+        ConnectionPtr conn = UnregisterSession(session_id);
+        if (!conn) {
             return false;
         }
-        
-        std::string userId = it->second.user_id;
-        m_sessions.erase(it);
-        
-        if (!userId.empty()) {
-            auto userIt = m_userSessions.find(userId);
-            if (userIt != m_userSessions.end()) {
-                userIt->second.erase(session_id);
-                if (userIt->second.empty()) {
-                    m_userSessions.erase(userIt);
-                }
-            }
-        }
-        
-        m_sessionSubscriptions.erase(session_id);
-        
-        if (m_disconnectHandler) {
-            m_disconnectHandler(session_id);
-        }
-        
+
+        Enqueue(conn, MakeCloseFrame(1000), true, true);
+        m_poller.Wake();
+
         LOG_INFO() << "Session closed: " << session_id;
         return true;
     }
-    
+
     bool AuthenticateSession(const std::string& session_id, const std::string& user_id, const std::string& token) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessions.find(session_id);
-        if (it == m_sessions.end()) {
+        (void)token;
+        ConnectionPtr conn = FindSession(session_id);
+        if (!conn) {
             return false;
         }
-        
-        it->second.user_id = user_id;
-        it->second.authenticated = true;
-        
-        m_userSessions[user_id].insert(session_id);
-        
+
+        std::string previousUser;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            previousUser = conn->info.user_id;
+            conn->info.user_id = user_id;
+            conn->info.authenticated = true;
+        }
+        if (!previousUser.empty() && previousUser != user_id) {
+            RemoveUserSession(previousUser, session_id);
+        }
+        {
+            UserShard& shard = *m_userShards[ShardIndex(user_id)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.sessions[user_id].insert(session_id);
+        }
+
         LOG_INFO() << "Session authenticated: " << session_id << " for user " << user_id;
         return true;
     }
-    
+
     bool IsSessionAuthenticated(const std::string& session_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessions.find(session_id);
-        return it != m_sessions.end() && it->second.authenticated;
+        ConnectionPtr conn = FindSession(session_id);
+        if (!conn) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        return conn->info.authenticated;
     }
-    
+
     void SubscribeToAlert(const std::string& session_id, AlertType alert_type) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_sessionSubscriptions[session_id].insert(alert_type);
-        LOG_INFO() << "Session " << session_id << " subscribed to alert type " << static_cast<int>(alert_type);
+        ConnectionPtr conn = FindSession(session_id);
+        if (!conn) {
+            LOG_WARNING() << "Session not found: " << session_id;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->subscriptions.insert(alert_type);
+        LOG_DEBUG() << "Session " << session_id << " subscribed to alert type " << static_cast<int>(alert_type);
     }
-    
+
     void UnsubscribeFromAlert(const std::string& session_id, AlertType alert_type) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_sessionSubscriptions.find(session_id);
-        if (it != m_sessionSubscriptions.end()) {
-            it->second.erase(alert_type);
+        ConnectionPtr conn = FindSession(session_id);
+        if (!conn) {
+            return;
         }
-        LOG_INFO() << "Session " << session_id << " unsubscribed from alert type " << static_cast<int>(alert_type);
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->subscriptions.erase(alert_type);
+        LOG_DEBUG() << "Session " << session_id << " unsubscribed from alert type " << static_cast<int>(alert_type);
     }
-    
+
     std::vector<AlertType> GetSubscriptions(const std::string& session_id) {
-        std::lock_guard<std::mutex> lock(m_mutex);
         std::vector<AlertType> result;
-        auto it = m_sessionSubscriptions.find(session_id);
-        if (it != m_sessionSubscriptions.end()) {
-            for (const auto& type : it->second) {
-                result.push_back(type);
-            }
+        ConnectionPtr conn = FindSession(session_id);
+        if (conn) {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            result.assign(conn->subscriptions.begin(), conn->subscriptions.end());
         }
         return result;
     }
-    
+
+    int GetListenPort() const {
+        return m_listenPort;
+    }
+
+    WebSocketStats GetStats() {
+        WebSocketStats stats;
+        stats.active_sessions = GetSessionCount();
+        stats.messages_queued = m_messagesQueued;
+        stats.bytes_sent = m_bytesSent;
+        stats.evicted_sessions = m_evicted;
+        stats.rejected_connections = m_rejected;
+        return stats;
+    }
+
+private:
+    bool OpenListener() {
+        m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listen == kInvalidSocket) {
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(m_config.port));
+        if (m_config.host.empty() || m_config.host == "0.0.0.0") {
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        } else if (m_config.host == "localhost") {
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        } else if (inet_pton(AF_INET, m_config.host.c_str(), &addr.sin_addr) != 1) {
+            return false;
+        }
+
+        if (bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(m_listen, SOMAXCONN) != 0 || !SetNonBlocking(m_listen)) {
+            return false;
+        }
+
+        socklen_t length = sizeof(addr);
+        if (getsockname(m_listen, reinterpret_cast<sockaddr*>(&addr), &length) == 0) {
+            m_listenPort = ntohs(addr.sin_port);
+        }
+        return true;
+    }
+
+    void CloseListener() {
+        if (m_listen != kInvalidSocket) {
+            CloseSocket(m_listen);
+            m_listen = kInvalidSocket;
+        }
+    }
+
+    ConnectionPtr FindSession(const std::string& session_id) {
+        SessionShard& shard = *m_sessionShards[ShardIndex(session_id)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(session_id);
+        return it != shard.sessions.end() ? it->second : ConnectionPtr();
+    }
+
+    ConnectionPtr UnregisterSession(const std::string& session_id) {
+        ConnectionPtr conn;
+        {
+            SessionShard& shard = *m_sessionShards[ShardIndex(session_id)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.sessions.find(session_id);
+            if (it == shard.sessions.end()) {
+                return conn;
+            }
+            conn = it->second;
+            shard.sessions.erase(it);
+        }
+
+        std::string userId;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            userId = conn->info.user_id;
+        }
+        if (!userId.empty()) {
+            RemoveUserSession(userId, session_id);
+        }
+        return conn;
+    }
+
+    void RemoveUserSession(const std::string& user_id, const std::string& session_id) {
+        UserShard& shard = *m_userShards[ShardIndex(user_id)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(user_id);
+        if (it != shard.sessions.end()) {
+            it->second.erase(session_id);
+            if (it->second.empty()) {
+                shard.sessions.erase(it);
+            }
+        }
+    }
+
+    /**
+     * Appends a frame to the session queue and schedules a flush on the
+     * event loop. Exceeding the queue bounds evicts the session; control
+     * frames bypass the bounds, and closeAfter shuts the socket once the
+     * queue drains. Callers wake the loop once per batch.
+     */
+    bool Enqueue(const ConnectionPtr& conn, const FramePtr& frame, bool control, bool closeAfter = false) {
+        bool schedule = false;
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            if (conn->evicted || (conn->closing && !control)) {
+                return false;
+            }
+            if (!control &&
+                (conn->queueBytes + frame->size() > m_config.max_send_queue_bytes ||
+                 static_cast<int>(conn->queue.size()) >= m_config.max_send_queue_messages)) {
+                conn->evicted = true;
+                conn->closing = true;
+                conn->queue.clear();
+                conn->queueBytes = 0;
+                conn->frontOffset = 0;
+                m_evicted++;
+                LOG_WARNING() << "Evicting slow WebSocket consumer " << conn->info.session_id;
+            } else {
+                conn->queue.push_back(frame);
+                conn->queueBytes += frame->size();
+                if (closeAfter) {
+                    conn->closing = true;
+                }
+                m_messagesQueued++;
+                queued = true;
+            }
+            schedule = !conn->flushScheduled;
+            conn->flushScheduled = true;
+        }
+        if (schedule) {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            m_pending.push_back(conn);
+        }
+        return queued;
+    }
+
+    bool OnLoopThread() const {
+        return std::this_thread::get_id() == m_loopId.load();
+    }
+
+    void Run() {
+        m_loopId = std::this_thread::get_id();
+        std::vector<PollEvent> events;
+        std::vector<ConnectionPtr> pending;
+        int sweepInterval = std::max(10, std::min(1000, m_config.ping_interval_ms));
+        int64_t lastSweep = NowMs();
+
+        while (m_running) {
+            int timeout = sweepInterval;
+            if (m_acceptResumeMs > 0) {
+                timeout = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(timeout, m_acceptResumeMs - NowMs())));
+            }
+            m_poller.Wait(timeout, events);
+            if (m_acceptResumeMs > 0 && NowMs() >= m_acceptResumeMs) {
+                m_acceptResumeMs = 0;
+                m_poller.Add(m_listen, false);
+            }
+            for (const auto& event : events) {
+                if (event.fd == m_listen) {
+                    AcceptConnections();
+                    continue;
+                }
+                auto it = m_connections.find(event.fd);
+                if (it == m_connections.end()) {
+                    continue;
+                }
+                ConnectionPtr conn = it->second;
+                if (event.readable) {
+                    HandleRead(conn);
+                }
+                if (event.writable && !conn->tornDown) {
+                    Flush(conn);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex);
+                pending.swap(m_pending);
+            }
+            for (const auto& conn : pending) {
+                if (!conn->tornDown) {
+                    Flush(conn);
+                }
+            }
+            pending.clear();
+
+            int64_t now = NowMs();
+            if (now - lastSweep >= sweepInterval) {
+                Sweep(now);
+                lastSweep = now;
+            }
+        }
+
+        std::vector<ConnectionPtr> remaining;
+        for (const auto& pair : m_connections) {
+            remaining.push_back(pair.second);
+        }
+        for (const auto& conn : remaining) {
+            Flush(conn);
+            Teardown(conn);
+        }
+    }
+
+    void AcceptConnections() {
+        while (true) {
+            sockaddr_in addr;
+            socklen_t length = sizeof(addr);
+            SocketHandle fd = accept(m_listen, reinterpret_cast<sockaddr*>(&addr), &length);
+            if (fd == kInvalidSocket) {
+                if (OutOfResources()) {
+                    // Stop watching the listener for a while instead of
+                    // spinning on a connection that cannot be accepted.
+                    LOG_WARNING() << "WebSocket accept out of resources; pausing for " << kAcceptBackoffMs << " ms";
+                    m_poller.Remove(m_listen);
+                    m_acceptResumeMs = NowMs() + kAcceptBackoffMs;
+                }
+                return;
+            }
+            if (static_cast<int>(m_connections.size()) >= m_config.max_connections) {
+                CloseSocket(fd);
+                m_rejected++;
+                continue;
+            }
+
+            SetNonBlocking(fd);
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#if defined(SO_NOSIGPIPE)
+            int noSigPipe = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+            ConnectionPtr conn = std::make_shared<Connection>(fd);
+            char host[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+            conn->info.remote_address = std::string(host) + ":" + std::to_string(ntohs(addr.sin_port));
+            conn->acceptedMs = NowMs();
+            conn->lastReceiveMs = conn->acceptedMs;
+
+            if (!m_poller.Add(fd, false)) {
+                CloseSocket(fd);
+                continue;
+            }
+            m_connections[fd] = conn;
+        }
+    }
+
+    void HandleRead(const ConnectionPtr& conn) {
+        char buffer[kReadChunk];
+        for (int i = 0; i < kMaxReadsPerEvent; ++i) {
+            int received = static_cast<int>(recv(conn->fd, buffer, sizeof(buffer), 0));
+            if (received > 0) {
+                conn->readBuffer.append(buffer, received);
+                conn->lastReceiveMs = NowMs();
+                if (received < static_cast<int>(sizeof(buffer))) {
+                    break;
+                }
+            } else if (received < 0 && WouldBlock()) {
+                break;
+            } else {
+                Teardown(conn);
+                return;
+            }
+        }
+
+        {
+            // Once a close is queued, input is ignored until the socket is torn down.
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            if (conn->closing) {
+                conn->readBuffer.clear();
+                return;
+            }
+        }
+        if (!conn->handshakeDone && !HandleHandshake(conn)) {
+            return;
+        }
+        ParseFrames(conn);
+    }
+
+    bool HandleHandshake(const ConnectionPtr& conn) {
+        size_t headerEnd = conn->readBuffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (conn->readBuffer.size() > kMaxHandshakeBytes) {
+                Teardown(conn);
+            }
+            return false;
+        }
+
+        std::string request = conn->readBuffer.substr(0, headerEnd);
+        conn->readBuffer.erase(0, headerEnd + 4);
+
+        std::string key;
+        bool upgrade = false;
+        size_t lineStart = request.find("\r\n");
+        bool isGet = request.compare(0, 4, "GET ") == 0;
+        while (lineStart != std::string::npos) {
+            lineStart += 2;
+            size_t lineEnd = request.find("\r\n", lineStart);
+            std::string line = request.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string name = ToLower(Trim(line.substr(0, colon)));
+                std::string value = Trim(line.substr(colon + 1));
+                if (name == "sec-websocket-key") {
+                    key = value;
+                } else if (name == "upgrade") {
+                    upgrade = ToLower(value) == "websocket";
+                }
+            }
+            lineStart = lineEnd;
+        }
+
+        if (!isGet || !upgrade || key.empty()) {
+            Enqueue(conn, std::make_shared<std::string>("HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n"), true, true);
+            return false;
+        }
+
+        std::string response =
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: " + ComputeAcceptKey(key) + "\r\n\r\n";
+
+        WebSocketSession session;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            conn->info.session_id = GenerateSessionId();
+            conn->info.connected_at = DateTime::Now();
+            session = conn->info;
+        }
+        Enqueue(conn, std::make_shared<std::string>(response), true);
+        conn->handshakeDone = true;
+        {
+            SessionShard& shard = *m_sessionShards[ShardIndex(session.session_id)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.sessions[session.session_id] = conn;
+        }
+
+        WebSocketConnectHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_connectHandler;
+        }
+        if (handler) {
+            handler(session);
+        }
+
+        LOG_INFO() << "New session connected: " << session.session_id << " from " << session.remote_address;
+        return true;
+    }
+
+    void ParseFrames(const ConnectionPtr& conn) {
+        const std::string& buffer = conn->readBuffer;
+        size_t pos = 0;
+        while (true) {
+            size_t available = buffer.size() - pos;
+            if (available < 2) {
+                break;
+            }
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer.data() + pos);
+            bool fin = (p[0] & 0x80) != 0;
+            uint8_t opcode = p[0] & 0x0F;
+            bool masked = (p[1] & 0x80) != 0;
+            uint64_t length = p[1] & 0x7F;
+            size_t header = 2;
+            if (length == 126) {
+                if (available < 4) {
+                    break;
+                }
+                length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+                header = 4;
+            } else if (length == 127) {
+                if (available < 10) {
+                    break;
+                }
+                length = 0;
+                for (int i = 0; i < 8; ++i) {
+                    length = (length << 8) | p[2 + i];
+                }
+                header = 10;
+            }
+
+            if (!masked) {
+                CloseWithError(conn, 1002);
+                return;
+            }
+            if (length > m_config.max_message_bytes ||
+                conn->fragment.size() + length > m_config.max_message_bytes) {
+                CloseWithError(conn, 1009);
+                return;
+            }
+            if (available < header + 4 + length) {
+                break;
+            }
+
+            const unsigned char* mask = p + header;
+            std::string payload(reinterpret_cast<const char*>(p + header + 4), static_cast<size_t>(length));
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+            }
+            pos += header + 4 + static_cast<size_t>(length);
+
+            if (!HandleFrame(conn, fin, opcode, payload)) {
+                conn->readBuffer.clear();
+                return;
+            }
+        }
+        conn->readBuffer.erase(0, pos);
+    }
+
+    bool HandleFrame(const ConnectionPtr& conn, bool fin, uint8_t opcode, std::string& payload) {
+        switch (opcode) {
+            case kOpPing:
+                Enqueue(conn, MakeFrame(kOpPong, payload), true);
+                return true;
+            case kOpPong:
+                return true;
+            case kOpClose:
+                UnregisterSession(conn->info.session_id);
+                Enqueue(conn, MakeFrame(kOpClose, payload.substr(0, 2)), true, true);
+                return false;
+            case kOpText:
+            case kOpBinary:
+                if (!fin) {
+                    conn->fragment.swap(payload);
+                    conn->fragmentOpcode = opcode;
+                    return true;
+                }
+                Dispatch(conn, opcode, payload);
+                return true;
+            case kOpContinuation:
+                if (conn->fragmentOpcode == 0) {
+                    CloseWithError(conn, 1002);
+                    return false;
+                }
+                conn->fragment.append(payload);
+                if (fin) {
+                    std::string message;
+                    message.swap(conn->fragment);
+                    uint8_t messageOpcode = conn->fragmentOpcode;
+                    conn->fragmentOpcode = 0;
+                    Dispatch(conn, messageOpcode, message);
+                }
+                return true;
+            default:
+                CloseWithError(conn, 1002);
+                return false;
+        }
+    }
+
+    void Dispatch(const ConnectionPtr& conn, uint8_t opcode, std::string& payload) {
+        WebSocketMessageHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_messageHandler;
+        }
+        if (!handler) {
+            return;
+        }
+
+        WebSocketMessage message;
+        message.session_id = conn->info.session_id;
+        message.type = opcode == kOpBinary ? "binary" : "text";
+        message.payload.swap(payload);
+        message.timestamp = DateTime::Now();
+        handler(message);
+    }
+
+    void CloseWithError(const ConnectionPtr& conn, uint16_t code) {
+        UnregisterSession(conn->info.session_id);
+        Enqueue(conn, MakeCloseFrame(code), true, true);
+        conn->readBuffer.clear();
+    }
+
+    void Flush(const ConnectionPtr& conn) {
+        bool closeNow = false;
+        {
+            std::unique_lock<std::mutex> lock(conn->mutex);
+            if (conn->evicted) {
+                lock.unlock();
+                Teardown(conn);
+                return;
+            }
+            while (!conn->queue.empty()) {
+                const std::string& data = *conn->queue.front();
+                int sent = static_cast<int>(send(conn->fd, data.data() + conn->frontOffset,
+                                                 data.size() - conn->frontOffset, kSendFlags));
+                if (sent > 0) {
+                    m_bytesSent += sent;
+                    conn->frontOffset += sent;
+                    if (conn->frontOffset == data.size()) {
+                        conn->queueBytes -= data.size();
+                        conn->frontOffset = 0;
+                        conn->queue.pop_front();
+                    }
+                } else if (sent < 0 && WouldBlock()) {
+                    if (!conn->wantWrite) {
+                        conn->wantWrite = true;
+                        m_poller.Modify(conn->fd, true);
+                    }
+                    return;
+                } else {
+                    lock.unlock();
+                    Teardown(conn);
+                    return;
+                }
+            }
+            conn->flushScheduled = false;
+            closeNow = conn->closing;
+        }
+
+        if (conn->wantWrite) {
+            conn->wantWrite = false;
+            m_poller.Modify(conn->fd, false);
+        }
+        if (closeNow) {
+            Teardown(conn);
+        }
+    }
+
+    void Sweep(int64_t now) {
+        std::vector<ConnectionPtr> connections;
+        connections.reserve(m_connections.size());
+        for (const auto& pair : m_connections) {
+            connections.push_back(pair.second);
+        }
+
+        static const FramePtr ping = MakeFrame(kOpPing, std::string());
+        bool queued = false;
+        for (const auto& conn : connections) {
+            if (!conn->handshakeDone) {
+                if (now - conn->acceptedMs > m_config.ping_timeout_ms) {
+                    Teardown(conn);
+                }
+                continue;
+            }
+            int64_t idle = now - conn->lastReceiveMs;
+            if (idle > static_cast<int64_t>(m_config.ping_interval_ms) + m_config.ping_timeout_ms) {
+                LOG_INFO() << "Session timed out: " << conn->info.session_id;
+                Teardown(conn);
+            } else if (idle >= m_config.ping_interval_ms && now - conn->lastPingMs >= m_config.ping_interval_ms) {
+                conn->lastPingMs = now;
+                queued = Enqueue(conn, ping, true) || queued;
+            }
+        }
+        if (queued) {
+            std::vector<ConnectionPtr> pending;
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex);
+                pending.swap(m_pending);
+            }
+            for (const auto& conn : pending) {
+                if (!conn->tornDown) {
+                    Flush(conn);
+                }
+            }
+        }
+    }
+
+    void Teardown(const ConnectionPtr& conn) {
+        if (conn->tornDown) {
+            return;
+        }
+        conn->tornDown = true;
+        m_poller.Remove(conn->fd);
+        CloseSocket(conn->fd);
+        m_connections.erase(conn->fd);
+
+        if (!conn->handshakeDone) {
+            return;
+        }
+
+        std::string sessionId = conn->info.session_id;
+        UnregisterSession(sessionId);
+
+        WebSocketDisconnectHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_disconnectHandler;
+        }
+        if (handler) {
+            handler(sessionId);
+        }
+        LOG_DEBUG() << "Session disconnected: " << sessionId;
+    }
+
     std::string GenerateSessionId() {
         static std::random_device rd;
         static std::mt19937 gen(rd());
         static std::uniform_int_distribution<> dis(0, 15);
         static const char* hex = "0123456789abcdef";
-        
+
         std::string id;
         id.reserve(32);
         for (int i = 0; i < 32; ++i) {
@@ -225,38 +1425,37 @@ public:
         }
         return id;
     }
-    
-    void SimulateConnect(const std::string& remote_address) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        WebSocketSession session;
-        session.session_id = GenerateSessionId();
-        session.remote_address = remote_address;
-        session.connected_at = DateTime::Now();
-        session.authenticated = false;
-        
-        m_sessions[session.session_id] = session;
-        
-        if (m_connectHandler) {
-            m_connectHandler(session);
-        }
-        
-        LOG_INFO() << "New session connected: " << session.session_id << " from " << remote_address;
-    }
-    
-private:
+
     WebSocketConfig m_config;
-    std::map<std::string, WebSocketSession> m_sessions;
-    std::map<std::string, std::set<std::string>> m_userSessions;
-    std::map<std::string, std::set<AlertType>> m_sessionSubscriptions;
+    std::atomic<bool> m_running;
+    std::mutex m_lifecycleMutex;
+    std::thread m_loop;
+    std::atomic<std::thread::id> m_loopId;
+    Poller m_poller;
+    SocketHandle m_listen;
+    int m_listenPort;
+    int64_t m_acceptResumeMs;   // loop thread only; 0 while the listener is polled
+
+    std::vector<std::unique_ptr<SessionShard>> m_sessionShards;
+    std::vector<std::unique_ptr<UserShard>> m_userShards;
+    std::unordered_map<SocketHandle, ConnectionPtr> m_connections;
+
+    std::mutex m_pendingMutex;
+    std::vector<ConnectionPtr> m_pending;
+
+    std::mutex m_handlerMutex;
     WebSocketMessageHandler m_messageHandler;
     WebSocketConnectHandler m_connectHandler;
     WebSocketDisconnectHandler m_disconnectHandler;
-    bool m_running;
-    mutable std::mutex m_mutex;
+
+    std::atomic<int64_t> m_messagesQueued;
+    std::atomic<int64_t> m_bytesSent;
+    std::atomic<int64_t> m_evicted;
+    std::atomic<int64_t> m_rejected;
 };
 
 WebSocketService::WebSocketService()
-    : m_impl(std::make_unique<Impl>()) {
+    : m_impl(new Impl()) {
 }
 
 WebSocketService::~WebSocketService() {
@@ -295,11 +1494,12 @@ bool WebSocketService::SendToUser(const std::string& user_id, const std::string&
 }
 
 void WebSocketService::Broadcast(const std::string& message) {
-    m_impl->Broadcast(message);
+    m_impl->Broadcast(message, nullptr, nullptr);
 }
 
 void WebSocketService::BroadcastExcept(const std::string& message, const std::vector<std::string>& exclude_sessions) {
-    m_impl->BroadcastExcept(message, exclude_sessions);
+    std::unordered_set<std::string> exclude(exclude_sessions.begin(), exclude_sessions.end());
+    m_impl->Broadcast(message, &exclude, nullptr);
 }
 
 std::vector<WebSocketSession> WebSocketService::GetActiveSessions() {
@@ -338,6 +1538,18 @@ std::vector<AlertType> WebSocketService::GetSubscriptions(const std::string& ses
     return m_impl->GetSubscriptions(session_id);
 }
 
+int WebSocketService::PublishAlert(AlertType alert_type, const std::string& message) {
+    return m_impl->Broadcast(message, nullptr, &alert_type);
+}
+
+int WebSocketService::GetListenPort() const {
+    return m_impl->GetListenPort();
+}
+
+WebSocketStats WebSocketService::GetStats() const {
+    return m_impl->GetStats();
+}
+
 std::unique_ptr<IWebSocketService> IWebSocketService::Create() {
     return std::unique_ptr<IWebSocketService>(new WebSocketService());
 }
@@ -13,6 +13,21 @@
 #include "ogc/alert/query_service.h"
 #include "ogc/alert/alert_repository.h"
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 namespace ogc {
 namespace alert {
@@ -80,6 +95,69 @@ TEST_F(DeduplicatorTest, IsDuplicate) {
     EXPECT_TRUE(m_deduplicator->IsDuplicate(alert2));
 }
 
+static AlertPtr MakeDriftAlert(const std::string& id, const std::string& user,
+                               std::time_t issued, double lon, double lat) {
+    auto alert = std::make_shared<Alert>();
+    alert->alert_id = id;
+    alert->alert_type = AlertType::kDepth;
+    alert->alert_level = AlertLevel::kLevel2;
+    alert->user_id = user;
+    alert->issue_time = DateTime::FromTimestamp(issued);
+    alert->position = Coordinate(lon, lat);
+    return alert;
+}
+
+static DeduplicationConfig MakeDriftConfig() {
+    DeduplicationConfig config;
+    config.enabled = true;
+    config.time_window_seconds = 60;
+    config.spatial_threshold = 0.001;
+    config.merge_similar = false;
+    config.max_duplicate_count = 5;
+    config.suppress_repeated = false;
+    config.suppress_interval_seconds = 0;
+    return config;
+}
+
+TEST_F(DeduplicatorTest, DriftingVesselCollapsesIntoOneGroup) {
+    AlertDeduplicator deduplicator(MakeDriftConfig());
+    std::time_t base = 1700000000;
+    
+    int emitted = 0;
+    for (int i = 0; i < 50; ++i) {
+        double lon = 121.4995 + i * 0.0002;
+        if (deduplicator.Process(MakeDriftAlert("DRIFT_" + std::to_string(i), "USER_001",
+                                                base + i * 10, lon, 31.2395))) {
+            emitted++;
+        }
+    }
+    EXPECT_EQ(emitted, 1);
+    EXPECT_EQ(deduplicator.GetDuplicateCount(), 49u);
+    
+    auto other = MakeDriftAlert("OTHER", "USER_002", base + 500, 121.5093, 31.2395);
+    EXPECT_FALSE(deduplicator.IsDuplicate(other));
+    EXPECT_TRUE(deduplicator.Process(other) != nullptr);
+    
+    auto far = MakeDriftAlert("FAR", "USER_001", base + 500, 121.6, 31.2395);
+    EXPECT_TRUE(deduplicator.Process(far) != nullptr);
+    EXPECT_EQ(deduplicator.GetDuplicateGroups().size(), 3u);
+}
+
+TEST_F(DeduplicatorTest, GroupsExpireAfterWindow) {
+    AlertDeduplicator deduplicator(MakeDriftConfig());
+    std::time_t base = 1700000000;
+    
+    deduplicator.Process(MakeDriftAlert("OLD", "USER_001", base, 121.5, 31.24));
+    EXPECT_EQ(deduplicator.GetDuplicateGroups().size(), 1u);
+    
+    deduplicator.Process(MakeDriftAlert("NEW", "USER_002", base + 600, 121.5, 31.24));
+    auto groups = deduplicator.GetDuplicateGroups();
+    ASSERT_EQ(groups.size(), 1u);
+    EXPECT_EQ(groups[0].signature.source_id, "USER_002");
+    
+    EXPECT_TRUE(deduplicator.Process(MakeDriftAlert("AGAIN", "USER_001", base + 610, 121.5, 31.24)) != nullptr);
+}
+
 class ThresholdManagerTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -228,6 +306,318 @@ TEST_F(WebSocketServiceTest, StartStopService) {
     EXPECT_FALSE(m_service->IsRunning());
 }
 
+#ifndef _WIN32
+
+class LoopbackClient {
+public:
+    LoopbackClient() : m_fd(-1) {}
+    ~LoopbackClient() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+    
+    bool Connect(int port, int receive_buffer = 0) {
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (receive_buffer > 0) {
+            setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+        }
+        timeval timeout;
+        timeout.tv_sec = 2;
+        timeout.tv_usec = 0;
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+    
+    std::string Handshake() {
+        std::string request =
+            "GET /alerts HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n";
+        send(m_fd, request.data(), request.size(), 0);
+        
+        std::string response;
+        char c;
+        while (response.find("\r\n\r\n") == std::string::npos && recv(m_fd, &c, 1, 0) == 1) {
+            response.push_back(c);
+        }
+        return response;
+    }
+    
+    void SendText(const std::string& text) {
+        const unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+        std::string frame;
+        frame.push_back(static_cast<char>(0x81));
+        frame.push_back(static_cast<char>(0x80 | text.size()));
+        frame.append(reinterpret_cast<const char*>(mask), 4);
+        for (size_t i = 0; i < text.size(); ++i) {
+            frame.push_back(static_cast<char>(text[i] ^ mask[i % 4]));
+        }
+        send(m_fd, frame.data(), frame.size(), 0);
+    }
+    
+    bool ReadFrame(int& opcode, std::string& payload) {
+        unsigned char header[2];
+        if (!ReadExact(header, 2)) {
+            return false;
+        }
+        opcode = header[0] & 0x0F;
+        uint64_t length = header[1] & 0x7F;
+        if (length == 126 || length == 127) {
+            unsigned char extended[8];
+            size_t bytes = length == 126 ? 2 : 8;
+            if (!ReadExact(extended, bytes)) {
+                return false;
+            }
+            length = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                length = (length << 8) | extended[i];
+            }
+        }
+        payload.resize(static_cast<size_t>(length));
+        return length == 0 || ReadExact(&payload[0], payload.size());
+    }
+    
+private:
+    bool ReadExact(void* buffer, size_t size) {
+        char* out = static_cast<char*>(buffer);
+        while (size > 0) {
+            ssize_t n = recv(m_fd, out, size, 0);
+            if (n <= 0) {
+                return false;
+            }
+            out += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    int m_fd;
+};
+
+bool WaitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 200; ++i) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+TEST_F(WebSocketServiceTest, LoopbackHandshakeAndBroadcast) {
+    WebSocketConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    ASSERT_TRUE(m_service->Start(config));
+    ASSERT_GT(m_service->GetListenPort(), 0);
+    
+    LoopbackClient clients[3];
+    for (auto& client : clients) {
+        ASSERT_TRUE(client.Connect(m_service->GetListenPort()));
+        std::string response = client.Handshake();
+        EXPECT_NE(response.find("101 Switching Protocols"), std::string::npos);
+        EXPECT_NE(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo="), std::string::npos);
+    }
+    ASSERT_TRUE(WaitFor([this]() { return m_service->GetSessionCount() == 3; }));
+    
+    m_service->Broadcast("{\"alert\":\"depth\"}");
+    for (auto& client : clients) {
+        int opcode = 0;
+        std::string payload;
+        ASSERT_TRUE(client.ReadFrame(opcode, payload));
+        EXPECT_EQ(opcode, 1);
+        EXPECT_EQ(payload, "{\"alert\":\"depth\"}");
+    }
+    
+    std::string large(70000, 'x');
+    m_service->Broadcast(large);
+    int opcode = 0;
+    std::string payload;
+    ASSERT_TRUE(clients[0].ReadFrame(opcode, payload));
+    EXPECT_EQ(payload.size(), large.size());
+    
+    m_service->Stop();
+    EXPECT_EQ(m_service->GetSessionCount(), 0);
+}
+
+TEST_F(WebSocketServiceTest, LoopbackMessagesAndTargetedSends) {
+    WebSocketConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    
+    std::mutex mutex;
+    std::vector<std::string> received;
+    std::string connectedId;
+    m_service->SetConnectHandler([&](const WebSocketSession& session) {
+        std::lock_guard<std::mutex> lock(mutex);
+        connectedId = session.session_id;
+    });
+    m_service->SetMessageHandler([&](const WebSocketMessage& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(message.payload);
+    });
+    std::atomic<int> disconnects(0);
+    m_service->SetDisconnectHandler([&](const std::string&) { disconnects++; });
+    ASSERT_TRUE(m_service->Start(config));
+    
+    LoopbackClient client;
+    ASSERT_TRUE(client.Connect(m_service->GetListenPort()));
+    client.Handshake();
+    ASSERT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !connectedId.empty();
+    }));
+    
+    client.SendText("ack ALERT_001");
+    ASSERT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received.size() == 1;
+    }));
+    EXPECT_EQ(received[0], "ack ALERT_001");
+    
+    std::string sessionId;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sessionId = connectedId;
+    }
+    EXPECT_TRUE(m_service->AuthenticateSession(sessionId, "USER_001", "token"));
+    EXPECT_TRUE(m_service->IsSessionAuthenticated(sessionId));
+    EXPECT_TRUE(m_service->SendToUser("USER_001", "to user"));
+    EXPECT_FALSE(m_service->SendToUser("USER_002", "nobody"));
+    
+    m_service->SubscribeToAlert(sessionId, AlertType::kDepth);
+    EXPECT_EQ(m_service->PublishAlert(AlertType::kWeather, "weather"), 0);
+    EXPECT_EQ(m_service->PublishAlert(AlertType::kDepth, "depth"), 1);
+    
+    int opcode = 0;
+    std::string payload;
+    ASSERT_TRUE(client.ReadFrame(opcode, payload));
+    EXPECT_EQ(payload, "to user");
+    ASSERT_TRUE(client.ReadFrame(opcode, payload));
+    EXPECT_EQ(payload, "depth");
+    
+    EXPECT_TRUE(m_service->CloseSession(sessionId));
+    ASSERT_TRUE(client.ReadFrame(opcode, payload));
+    EXPECT_EQ(opcode, 8);
+    EXPECT_TRUE(WaitFor([&]() { return disconnects.load() == 1; }));
+    EXPECT_EQ(m_service->GetSessionCount(), 0);
+    
+    m_service->Stop();
+}
+
+TEST_F(WebSocketServiceTest, SlowConsumerIsEvicted) {
+    WebSocketConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.max_send_queue_bytes = 256 * 1024;
+    ASSERT_TRUE(m_service->Start(config));
+    
+    LoopbackClient slow;
+    ASSERT_TRUE(slow.Connect(m_service->GetListenPort(), 4096));
+    slow.Handshake();
+    ASSERT_TRUE(WaitFor([this]() { return m_service->GetSessionCount() == 1; }));
+    
+    std::string chunk(16 * 1024, 'a');
+    for (int i = 0; i < 4000 && m_service->GetStats().evicted_sessions == 0; ++i) {
+        m_service->Broadcast(chunk);
+    }
+    
+    EXPECT_EQ(m_service->GetStats().evicted_sessions, 1);
+    EXPECT_TRUE(WaitFor([this]() { return m_service->GetSessionCount() == 0; }));
+    
+    LoopbackClient fresh;
+    ASSERT_TRUE(fresh.Connect(m_service->GetListenPort()));
+    fresh.Handshake();
+    ASSERT_TRUE(WaitFor([this]() { return m_service->GetSessionCount() == 1; }));
+    m_service->Broadcast("still serving");
+    int opcode = 0;
+    std::string payload;
+    ASSERT_TRUE(fresh.ReadFrame(opcode, payload));
+    EXPECT_EQ(payload, "still serving");
+    
+    m_service->Stop();
+}
+
+TEST_F(WebSocketServiceTest, HandlerCanStopTheService) {
+    WebSocketConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    m_service->SetConnectHandler([this](const WebSocketSession&) {
+        m_service->Stop();
+    });
+    ASSERT_TRUE(m_service->Start(config));
+    
+    LoopbackClient client;
+    ASSERT_TRUE(client.Connect(m_service->GetListenPort()));
+    client.Handshake();
+    ASSERT_TRUE(WaitFor([this]() { return !m_service->IsRunning(); }));
+    
+    // The stop requested on the loop thread is completed here.
+    m_service->SetConnectHandler(nullptr);
+    ASSERT_TRUE(m_service->Start(config));
+    LoopbackClient again;
+    ASSERT_TRUE(again.Connect(m_service->GetListenPort()));
+    EXPECT_NE(again.Handshake().find("101 Switching Protocols"), std::string::npos);
+    m_service->Stop();
+    EXPECT_FALSE(m_service->IsRunning());
+}
+
+TEST_F(WebSocketServiceTest, AcceptBacksOffWhenOutOfDescriptors) {
+    WebSocketConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    ASSERT_TRUE(m_service->Start(config));
+    
+    rlimit original;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &original), 0);
+    rlimit limited = original;
+    limited.rlim_cur = std::min<rlim_t>(original.rlim_cur, 1024);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limited), 0);
+    
+    std::vector<int> filler;
+    for (int fd = dup(0); fd >= 0; fd = dup(0)) {
+        filler.push_back(fd);
+    }
+    ASSERT_FALSE(filler.empty());
+    close(filler.back());
+    filler.pop_back();
+    
+    // The connection completes in the backlog but cannot be accepted.
+    LoopbackClient client;
+    ASSERT_TRUE(client.Connect(m_service->GetListenPort()));
+    rusage before;
+    getrusage(RUSAGE_SELF, &before);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    rusage after;
+    getrusage(RUSAGE_SELF, &after);
+    
+    for (int fd : filler) {
+        close(fd);
+    }
+    setrlimit(RLIMIT_NOFILE, &original);
+    
+    auto cpuMs = [](const rusage& usage) {
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+    };
+    EXPECT_LT(cpuMs(after) - cpuMs(before), 150);
+    
+    EXPECT_NE(client.Handshake().find("101 Switching Protocols"), std::string::npos);
+    m_service->Stop();
+}
+
+#endif
+
 class FeedbackServiceTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -267,6 +657,59 @@ TEST_F(QueryServiceOptimizedTest, CreateService) {
     ASSERT_NE(m_service, nullptr);
 }
 
+TEST_F(QueryServiceOptimizedTest, CursorPagesDoNotOverlap) {
+    for (int i = 0; i < 12; ++i) {
+        auto alert = std::make_shared<Alert>();
+        alert->alert_id = "CURSOR_" + std::to_string(i);
+        alert->user_id = "USER_001";
+        alert->alert_type = AlertType::kDepth;
+        alert->issue_time = DateTime::FromTimestamp(1700000000 + i * 30);
+        m_repository->Save(alert);
+    }
+    auto weather = std::make_shared<Alert>();
+    weather->alert_id = "CURSOR_WEATHER";
+    weather->user_id = "USER_001";
+    weather->alert_type = AlertType::kWeather;
+    weather->issue_time = DateTime::FromTimestamp(1700000000 - 100);
+    m_repository->Save(weather);
+    m_repository->UpdateStatus("CURSOR_2", AlertStatus::kAcknowledged);
+    
+    // Filters hold on every page, and statuses are not filtered.
+    OptimizedQueryParams params;
+    params.user_id = "USER_001";
+    params.alert_types.push_back(AlertType::kDepth);
+    params.limit = 5;
+    params.use_cursor = true;
+    
+    AlertListResult first = m_service->GetAlertListOptimized(params);
+    ASSERT_EQ(first.alerts.size(), 5u);
+    EXPECT_EQ(first.total_count, 12);
+    EXPECT_TRUE(first.next_cursor.has_more);
+    
+    params.cursor = first.next_cursor;
+    AlertListResult second = m_service->GetAlertListOptimized(params);
+    ASSERT_EQ(second.alerts.size(), 5u);
+    EXPECT_EQ(second.alerts.front()->alert_id, "CURSOR_6");
+    
+    params.cursor = second.next_cursor;
+    AlertListResult third = m_service->GetAlertListOptimized(params);
+    ASSERT_EQ(third.alerts.size(), 2u);
+    EXPECT_EQ(third.alerts.front()->alert_id, "CURSOR_1");
+    EXPECT_FALSE(third.next_cursor.has_more);
+    
+    // Only the active-alert cursor leaves out the acknowledged alert.
+    AlertListResult active = m_service->GetAlertListByCursor("USER_001", second.next_cursor, 2);
+    ASSERT_EQ(active.alerts.size(), 2u);
+    EXPECT_EQ(active.alerts.front()->alert_id, "CURSOR_1");
+    AlertListResult activeFirst = m_service->GetAlertListByCursor("USER_001", PageCursor(), 20);
+    EXPECT_EQ(activeFirst.alerts.size(), 12u);
+    
+    AlertListResult offsetPage = m_service->GetAlertHistory("USER_001", DateTime(), DateTime(), 2, 5);
+    ASSERT_EQ(offsetPage.alerts.size(), 5u);
+    EXPECT_EQ(offsetPage.alerts.front()->alert_id, "CURSOR_6");
+    EXPECT_EQ(m_service->GetActiveAlertCount("USER_001"), 12);
+}
+
 }
 }
 }
@@ -17,7 +17,9 @@
 #include "ogc/alert/deviation_alert_checker.h"
 #include "ogc/alert/speed_alert_checker.h"
 #include "ogc/alert/restricted_area_checker.h"
+#include <atomic>
 #include <memory>
+#include <thread>
 
 namespace ogc {
 namespace alert {
@@ -348,6 +350,153 @@ TEST_F(AlertRepositoryTest, AcknowledgeAlert) {
     EXPECT_EQ(found->status, AlertStatus::kAcknowledged);
 }
 
+static AlertPtr MakeTimedAlert(const std::string& id, const std::string& user_id,
+                               AlertType type, std::time_t issued) {
+    auto alert = std::make_shared<Alert>();
+    alert->alert_id = id;
+    alert->user_id = user_id;
+    alert->alert_type = type;
+    alert->alert_level = AlertLevel::kLevel2;
+    alert->issue_time = DateTime::FromTimestamp(issued);
+    return alert;
+}
+
+TEST_F(AlertRepositoryTest, KeysetPaginationNewestFirst) {
+    const std::time_t base = 1700000000;
+    for (int i = 0; i < 25; ++i) {
+        m_repository->Save(MakeTimedAlert("PAGE_" + std::to_string(i), "USER_001",
+                                          AlertType::kDepth, base + i * 60));
+    }
+    m_repository->Save(MakeTimedAlert("OTHER", "USER_002", AlertType::kDepth, base));
+    
+    AlertQueryParams params;
+    params.user_id = "USER_001";
+    EXPECT_EQ(m_repository->Count(params), 25);
+    
+    PageCursor cursor;
+    std::vector<std::string> seen;
+    int pages = 0;
+    do {
+        AlertPage page = m_repository->QueryPage(params, cursor, 10);
+        for (const auto& alert : page.alerts) {
+            seen.push_back(alert->alert_id);
+        }
+        cursor = page.next;
+        pages++;
+    } while (cursor.has_more && pages < 10);
+    
+    ASSERT_EQ(pages, 3);
+    ASSERT_EQ(seen.size(), 25u);
+    EXPECT_EQ(seen.front(), "PAGE_24");
+    EXPECT_EQ(seen.back(), "PAGE_0");
+    
+    AlertPage skipped = m_repository->QueryPage(params, PageCursor(), 5, 20);
+    ASSERT_EQ(skipped.alerts.size(), 5u);
+    EXPECT_EQ(skipped.alerts.front()->alert_id, "PAGE_4");
+    EXPECT_FALSE(skipped.next.has_more);
+}
+
+TEST_F(AlertRepositoryTest, IndexesFollowStatusChanges) {
+    const std::time_t base = 1700000000;
+    m_repository->Save(MakeTimedAlert("ACK_1", "USER_001", AlertType::kDepth, base));
+    m_repository->Save(MakeTimedAlert("ACK_2", "USER_001", AlertType::kWeather, base + 1));
+    m_repository->Save(MakeTimedAlert("ACK_3", "USER_002", AlertType::kDepth, base + 2));
+    
+    EXPECT_TRUE(m_repository->Acknowledge("ACK_1", "USER_001", "ack"));
+    
+    EXPECT_EQ(m_repository->GetActiveAlerts("USER_001").size(), 1u);
+    AlertQueryParams params;
+    params.statuses.push_back(AlertStatus::kAcknowledged);
+    EXPECT_EQ(m_repository->Count(params), 1);
+    EXPECT_EQ(m_repository->GetAlertsByType(AlertType::kDepth, "").size(), 2u);
+    
+    params.statuses.clear();
+    params.user_id = "USER_001";
+    params.alert_types.push_back(AlertType::kDepth);
+    params.alert_types.push_back(AlertType::kWeather);
+    EXPECT_EQ(m_repository->Count(params), 2);
+    
+    auto moved = MakeTimedAlert("ACK_3", "USER_001", AlertType::kSpeed, base + 86400 * 3);
+    m_repository->Update(moved);
+    EXPECT_EQ(m_repository->GetAlertsByType(AlertType::kDepth, "").size(), 1u);
+    EXPECT_EQ(m_repository->FindById("ACK_3")->alert_type, AlertType::kSpeed);
+}
+
+TEST_F(AlertRepositoryTest, ScansAcrossChunksWhileIngesting) {
+    const std::time_t base = 1700000000;
+    const AlertType types[] = {AlertType::kDepth, AlertType::kWeather, AlertType::kSpeed};
+    for (int i = 0; i < 1200; ++i) {
+        m_repository->Save(MakeTimedAlert("SCAN_" + std::to_string(i), "USER_001",
+                                          types[i % 3], base + i));
+    }
+    
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+        for (int i = 0; !stop.load(); ++i) {
+            m_repository->Save(MakeTimedAlert("LIVE_" + std::to_string(i), "USER_001",
+                                              AlertType::kDepth, base + 5000 + i));
+        }
+    });
+    
+    AlertQueryParams params;
+    params.alert_types.push_back(AlertType::kDepth);
+    params.alert_types.push_back(AlertType::kWeather);
+    params.end_time = DateTime::FromTimestamp(base + 1099);
+    PageCursor cursor;
+    std::vector<std::string> seen;
+    int pages = 0;
+    do {
+        AlertPage page = m_repository->QueryPage(params, cursor, 70);
+        for (const auto& alert : page.alerts) {
+            seen.push_back(alert->alert_id);
+        }
+        cursor = page.next;
+        pages++;
+    } while (cursor.has_more && pages < 100);
+    stop.store(true);
+    writer.join();
+    
+    std::vector<std::string> expected;
+    for (int i = 1099; i >= 0; --i) {
+        if (i % 3 != 2) {
+            expected.push_back("SCAN_" + std::to_string(i));
+        }
+    }
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(m_repository->Count(params), static_cast<int>(expected.size()));
+}
+
+TEST_F(AlertRepositoryTest, TimeRangeAndPartitionDrop) {
+    AlertRepositoryOptions options;
+    options.partition_span_seconds = 3600;
+    AlertRepository repository(options);
+    
+    const std::time_t base = 1700006400;
+    for (int hour = 0; hour < 5; ++hour) {
+        for (int i = 0; i < 4; ++i) {
+            repository.Save(MakeTimedAlert("H" + std::to_string(hour) + "_" + std::to_string(i),
+                                           "USER_001", AlertType::kDepth, base + hour * 3600 + i * 600));
+        }
+    }
+    EXPECT_EQ(repository.GetPartitionCount(), 5);
+    
+    AlertQueryParams params;
+    params.start_time = DateTime::FromTimestamp(base + 3600 + 1200);
+    params.end_time = DateTime::FromTimestamp(base + 2 * 3600 + 600);
+    std::vector<AlertPtr> inRange = repository.Query(params);
+    ASSERT_EQ(inRange.size(), 4u);
+    EXPECT_EQ(inRange.front()->alert_id, "H2_1");
+    EXPECT_EQ(inRange.back()->alert_id, "H1_2");
+    EXPECT_EQ(repository.Count(params), 4);
+    
+    EXPECT_EQ(repository.DropPartitionsBefore(DateTime::FromTimestamp(base + 3 * 3600)), 3);
+    EXPECT_EQ(repository.GetPartitionCount(), 2);
+    EXPECT_EQ(repository.FindById("H0_0"), nullptr);
+    EXPECT_FALSE(repository.Delete("H1_0"));
+    EXPECT_NE(repository.FindById("H4_3"), nullptr);
+    EXPECT_EQ(repository.Count(AlertQueryParams()), 8);
+}
+
 class DepthAlertCheckerTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -2,6 +2,8 @@
 #define OGC_BASE_LOG_H
 
 #include "export.h"
+#include <atomic>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <mutex>
@@ -32,16 +34,37 @@ std::string FormatString(const char* format, Args... args) {
     return std::string(buffer);
 }
 
+/**
+ * @brief Process-wide logger with an asynchronous sink.
+ *
+ * The level lives in a relaxed atomic so the LOG_* macros can skip disabled
+ * statements before any argument is evaluated. Enabled messages are queued
+ * and written by a background thread, which also formats timestamps. When
+ * the bounded queue is full, messages below kWarning are dropped and counted;
+ * warnings and above wait for space. Fatal messages are flushed before Log
+ * returns.
+ */
 class OGC_BASE_API Logger {
 public:
     static Logger& Instance();
     
+    static bool IsEnabled(LogLevel level) {
+        return static_cast<int>(level) >= s_level.load(std::memory_order_relaxed);
+    }
+    
     void SetLevel(LogLevel level);
     LogLevel GetLevel() const;
     
     void SetLogFile(const std::string& filepath);
     void SetConsoleOutput(bool enable);
     
+    /**
+     * @brief Maximum number of queued messages; 0 writes synchronously.
+     */
+    void SetQueueCapacity(size_t capacity);
+    size_t GetQueueCapacity() const;
+    size_t GetDroppedCount() const;
+    
     void Trace(const std::string& message);
     void Debug(const std::string& message);
     void Info(const std::string& message);
@@ -53,6 +76,9 @@ public:
     void LogWithLocation(LogLevel level, const char* file, int line, 
                          const char* func, const std::string& message);
     
+    /**
+     * @brief Waits until every queued message has been written, then flushes.
+     */
     void Flush();
     void Close();
     
@@ -66,10 +92,17 @@ private:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
     
+    static std::atomic<int> s_level;
+    
     struct Impl;
     std::unique_ptr<Impl> impl_;
 };
 
+/**
+ * @brief Stream collector behind LOG_*(). Appends into a buffer owned by the
+ * calling thread and reused across statements; nested statements fall back
+ * to a buffer of their own.
+ */
 class OGC_BASE_API LogHelper {
 public:
     LogHelper(LogLevel level);
@@ -81,37 +114,46 @@ public:
     LogHelper& operator<<(double value);
     
 private:
+    LogHelper(const LogHelper&) = delete;
+    LogHelper& operator=(const LogHelper&) = delete;
+    
     LogLevel m_level;
-    std::string m_buffer;
+    std::string* m_buffer;
+    std::string m_ownBuffer;
+    bool m_borrowed;
+};
+
+struct LogVoidify {
+    void operator&(const LogHelper&) {}
 };
 
 }  
 }  
-#define LOG_TRACE() ogc::base::LogHelper(ogc::base::LogLevel::kTrace)
-#define LOG_DEBUG() ogc::base::LogHelper(ogc::base::LogLevel::kDebug)
-#define LOG_INFO() ogc::base::LogHelper(ogc::base::LogLevel::kInfo)
-#define LOG_WARNING() ogc::base::LogHelper(ogc::base::LogLevel::kWarning)
-#define LOG_ERROR() ogc::base::LogHelper(ogc::base::LogLevel::kError)
-#define LOG_FATAL() ogc::base::LogHelper(ogc::base::LogLevel::kFatal)
+#define OGC_LOG_STREAM(level) \
+    !ogc::base::Logger::IsEnabled(level) ? (void)0 : \
+    ogc::base::LogVoidify() & ogc::base::LogHelper(level)
+
+#define LOG_TRACE() OGC_LOG_STREAM(ogc::base::LogLevel::kTrace)
+#define LOG_DEBUG() OGC_LOG_STREAM(ogc::base::LogLevel::kDebug)
+#define LOG_INFO() OGC_LOG_STREAM(ogc::base::LogLevel::kInfo)
+#define LOG_WARNING() OGC_LOG_STREAM(ogc::base::LogLevel::kWarning)
+#define LOG_ERROR() OGC_LOG_STREAM(ogc::base::LogLevel::kError)
+#define LOG_FATAL() OGC_LOG_STREAM(ogc::base::LogLevel::kFatal)
+
+#define OGC_LOG_FMT(level, ...) do { \
+        if (ogc::base::Logger::IsEnabled(level)) { \
+            ogc::base::Logger::Instance().LogWithLocation( \
+                level, __FILE__, __LINE__, __func__, \
+                ogc::base::FormatString(__VA_ARGS__)); \
+        } \
+    } while (0)
 
-#define LOG_TRACE_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kTrace, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
-#define LOG_DEBUG_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kDebug, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
-#define LOG_INFO_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kInfo, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
-#define LOG_WARN_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kWarning, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
-#define LOG_ERROR_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kError, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
-#define LOG_FATAL_FMT(...) ogc::base::Logger::Instance().LogWithLocation( \
-    ogc::base::LogLevel::kFatal, __FILE__, __LINE__, __func__, \
-    ogc::base::FormatString(__VA_ARGS__))
+#define LOG_TRACE_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kTrace, __VA_ARGS__)
+#define LOG_DEBUG_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kDebug, __VA_ARGS__)
+#define LOG_INFO_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kInfo, __VA_ARGS__)
+#define LOG_WARN_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kWarning, __VA_ARGS__)
+#define LOG_ERROR_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kError, __VA_ARGS__)
+#define LOG_FATAL_FMT(...) OGC_LOG_FMT(ogc::base::LogLevel::kFatal, __VA_ARGS__)
 
 
 #endif  
@@ -218,6 +218,8 @@ private:
     std::chrono::steady_clock::time_point m_frameStartTime;
     std::chrono::steady_clock::time_point m_passStartTime;
     std::string m_currentPassName;
+    // Tracer names for passes seen so far, so a pass interns its name once.
+    std::map<std::string, const char*> m_passTraceNames;
     size_t m_maxHistorySize;
 };
 
@@ -8,6 +8,7 @@
 #include <functional>
 #include <condition_variable>
 #include <thread>
+#include <utility>
 
 namespace ogc {
 namespace base {
@@ -79,13 +80,13 @@ public:
     }
     
     template<typename Func>
-    auto WithLock(Func&& func) -> decltype(func(m_value)) {
+    auto WithLock(Func&& func) -> decltype(func(std::declval<T&>())) {
         std::lock_guard<std::mutex> lock(m_mutex);
         return func(m_value);
     }
     
     template<typename Func>
-    auto WithLock(Func&& func) const -> decltype(func(m_value)) {
+    auto WithLock(Func&& func) const -> decltype(func(std::declval<T&>())) {
         std::lock_guard<std::mutex> lock(m_mutex);
         return func(m_value);
     }
@@ -0,0 +1,201 @@
+#ifndef OGC_BASE_TRACE_H
+#define OGC_BASE_TRACE_H
+
+#include "export.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ogc {
+namespace base {
+
+/**
+ * @brief A completed span. name and category point at static strings.
+ */
+struct TraceEvent {
+    const char* name = nullptr;
+    const char* category = nullptr;
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    uint32_t threadId = 0;
+};
+
+/**
+ * @brief Aggregated view of a histogram at the time it was read.
+ *
+ * Bucket i holds values in [2^(i-1), 2^i); bucket 0 holds zero.
+ */
+struct OGC_BASE_API HistogramSnapshot {
+    static const size_t kBucketCount = 64;
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets;
+
+    double GetMean() const;
+    /** Upper bound of the bucket containing the given percentile (0-100). */
+    uint64_t GetPercentile(double percentile) const;
+};
+
+/**
+ * @brief Monotonic counter sharded across cache lines.
+ *
+ * Each shard is aligned to its own 64-byte line, including on the heap.
+ *
+ * Add is a single relaxed atomic add on the calling thread's shard; the
+ * shards are only summed when the value is read.
+ */
+class OGC_BASE_API TraceCounter {
+public:
+    TraceCounter();
+
+    // Plain new only guarantees alignof(max_align_t) before C++17.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
+    void Add(int64_t delta = 1);
+    int64_t GetValue() const;
+    void Reset();
+
+private:
+    static const size_t kShardCount = 16;
+
+    struct alignas(64) Shard {
+        std::atomic<int64_t> value;
+    };
+
+    Shard m_shards[kShardCount];
+};
+
+/**
+ * @brief Log2-bucketed histogram with the same sharding as TraceCounter.
+ */
+class OGC_BASE_API TraceHistogram {
+public:
+    TraceHistogram();
+
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
+    void Record(uint64_t value);
+    HistogramSnapshot GetSnapshot() const;
+    void Reset();
+
+private:
+    static const size_t kShardCount = 8;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[HistogramSnapshot::kBucketCount];
+    };
+
+    Shard m_shards[kShardCount];
+};
+
+/**
+ * @brief Process-wide span recorder with per-thread ring buffers.
+ *
+ * Each thread writes spans into its own fixed-size ring without locks or
+ * allocation; the oldest spans are overwritten when the ring is full.
+ * Readers copy every ring on demand, so recording stays cheap enough to be
+ * left on in production. Span names and categories must be string literals
+ * or otherwise outlive the tracer; use Intern() for dynamic names.
+ */
+class OGC_BASE_API Tracer {
+public:
+    static Tracer& Instance();
+
+    void SetEnabled(bool enable);
+    bool IsEnabled() const {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Spans kept per thread. Applies to threads that record their
+     * first span after the call; rounded up to a power of two.
+     */
+    void SetBufferCapacity(size_t capacity);
+    size_t GetBufferCapacity() const;
+
+    /**
+     * @brief Rings currently allocated. Rings of exited threads are freed
+     * or reused once read; their newest spans, up to one buffer capacity
+     * in total, stay visible until Clear().
+     */
+    size_t GetBufferCount() const;
+
+    void RecordSpan(const char* name, const char* category, uint64_t startNs, uint64_t endNs);
+
+    TraceCounter& GetCounter(const char* name);
+    TraceHistogram& GetHistogram(const char* name);
+
+    /** Returns a stable pointer for a dynamic span name. */
+    const char* Intern(const std::string& name);
+
+    std::vector<TraceEvent> GetEvents() const;
+    std::map<std::string, int64_t> GetCounterValues() const;
+    std::map<std::string, HistogramSnapshot> GetHistogramSnapshots() const;
+
+    /** Spans as complete ("X") events and counters as "C" events. */
+    std::string ExportChromeTrace() const;
+    bool WriteChromeTrace(const std::string& filepath) const;
+
+    /** Drops recorded spans and resets counters and histograms. */
+    void Clear();
+
+    static uint64_t NowNs();
+
+private:
+    Tracer();
+    ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+    std::atomic<bool> m_enabled;
+};
+
+/**
+ * @brief Records a span covering its own lifetime on the calling thread.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* category = "ogc")
+        : m_name(name)
+        , m_category(category)
+        , m_startNs(Tracer::Instance().IsEnabled() ? Tracer::NowNs() : 0) {
+    }
+
+    ~TraceScope() {
+        if (m_startNs != 0) {
+            Tracer::Instance().RecordSpan(m_name, m_category, m_startNs, Tracer::NowNs());
+        }
+    }
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    const char* m_name;
+    const char* m_category;
+    uint64_t m_startNs;
+};
+
+}
+}
+
+#define OGC_TRACE_CONCAT_INNER(a, b) a##b
+#define OGC_TRACE_CONCAT(a, b) OGC_TRACE_CONCAT_INNER(a, b)
+#define OGC_TRACE_SCOPE(name) \
+    ogc::base::TraceScope OGC_TRACE_CONCAT(ogcTraceScope_, __LINE__)(name)
+#define OGC_TRACE_SCOPE_CAT(name, category) \
+    ogc::base::TraceScope OGC_TRACE_CONCAT(ogcTraceScope_, __LINE__)(name, category)
+
+#endif
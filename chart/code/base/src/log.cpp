@@ -3,73 +3,186 @@
 #include <iomanip>
 #include <sstream>
 #include <ctime>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
 
 namespace ogc {
 namespace base {
 
+namespace {
+
+struct LogRecord {
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    const char* file;
+    int line;
+    std::string message;
+};
+
+}
+
+std::atomic<int> Logger::s_level(static_cast<int>(LogLevel::kInfo));
+
+/**
+ * Producers append to queue under queueMutex and only wake the writer when
+ * it is idle. The writer takes the whole queue at once and writes it under
+ * sinkMutex, which also guards the console and file settings.
+ */
 struct Logger::Impl {
-    LogLevel level = LogLevel::kInfo;
     std::ofstream file;
     std::string filepath;
     bool consoleOutput = true;
-    std::mutex mutex;
+    std::mutex sinkMutex;
+    
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::condition_variable spaceReady;
+    std::condition_variable drained;
+    std::deque<LogRecord> queue;
+    size_t capacity = 8192;
+    size_t dropped = 0;
+    size_t droppedReported = 0;
+    bool writing = false;
+    bool stopping = false;
+    bool writerWaiting = false;
+    std::thread writer;
+    
+    ~Impl();
     
-    void WriteLog(LogLevel level, const std::string& message);
-    void WriteLogWithLocation(LogLevel level, const char* file, int line,
-                              const char* func, const std::string& message);
-    std::string GetTimestamp() const;
+    void Enqueue(LogLevel level, const char* file, int line, const std::string& message);
+    void WaitDrained();
+    void WriterLoop();
+    void WriteRecords(std::deque<LogRecord>& records, size_t droppedSince);
+    void WriteRecord(const LogRecord& record);
+    static std::string FormatTimestamp(std::chrono::system_clock::time_point time);
 };
 
-void Logger::Impl::WriteLog(LogLevel level, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex);
-    
-    std::ostringstream oss;
-    oss << "[" << GetTimestamp() << "] "
-        << "[" << Logger::LevelToString(level) << "] "
-        << message << std::endl;
+Logger::Impl::~Impl() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void Logger::Impl::Enqueue(LogLevel level, const char* file, int line, const std::string& message) {
+    LogRecord record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.file = file;
+    record.line = line;
     
-    std::string logLine = oss.str();
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (capacity == 0 || stopping) {
+        lock.unlock();
+        record.message = message;
+        std::lock_guard<std::mutex> sinkLock(sinkMutex);
+        WriteRecord(record);
+        return;
+    }
     
-    if (consoleOutput) {
-        if (level >= LogLevel::kError) {
-            std::cerr << logLine;
-        } else {
-            std::cout << logLine;
+    if (queue.size() >= capacity) {
+        if (level < LogLevel::kWarning) {
+            ++dropped;
+            return;
         }
+        spaceReady.wait(lock, [this]() {
+            return queue.size() < capacity || capacity == 0 || stopping;
+        });
     }
     
-    if (file.is_open()) {
-        file << logLine;
+    record.message = message;
+    queue.push_back(std::move(record));
+    if (!writer.joinable()) {
+        writer = std::thread([this]() { WriterLoop(); });
+    } else if (writerWaiting) {
+        queueReady.notify_one();
     }
 }
 
-void Logger::Impl::WriteLogWithLocation(LogLevel level, const char* file, int line,
-                                        const char* func, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex);
-    
+void Logger::Impl::WaitDrained() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    drained.wait(lock, [this]() { return queue.empty() && !writing; });
+}
+
+void Logger::Impl::WriterLoop() {
+    std::deque<LogRecord> batch;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        writerWaiting = true;
+        queueReady.wait(lock, [this]() { return !queue.empty() || stopping; });
+        writerWaiting = false;
+        if (queue.empty() && stopping) {
+            break;
+        }
+        
+        batch.swap(queue);
+        size_t droppedSince = dropped - droppedReported;
+        droppedReported = dropped;
+        writing = true;
+        lock.unlock();
+        spaceReady.notify_all();
+        
+        WriteRecords(batch, droppedSince);
+        batch.clear();
+        
+        lock.lock();
+        writing = false;
+        if (queue.empty()) {
+            drained.notify_all();
+        }
+    }
+    drained.notify_all();
+}
+
+void Logger::Impl::WriteRecords(std::deque<LogRecord>& records, size_t droppedSince) {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    if (droppedSince > 0) {
+        LogRecord notice;
+        notice.level = LogLevel::kWarning;
+        notice.time = std::chrono::system_clock::now();
+        notice.file = nullptr;
+        notice.line = 0;
+        notice.message = "Log queue full, dropped " + std::to_string(droppedSince) + " messages";
+        WriteRecord(notice);
+    }
+    for (const auto& record : records) {
+        WriteRecord(record);
+    }
+}
+
+void Logger::Impl::WriteRecord(const LogRecord& record) {
     std::ostringstream oss;
-    oss << "[" << GetTimestamp() << "] "
-        << "[" << std::setw(7) << Logger::LevelToString(level) << "] "
-        << "[" << file << ":" << line << "] "
-        << message << std::endl;
+    oss << "[" << FormatTimestamp(record.time) << "] ";
+    if (record.file) {
+        oss << "[" << std::setw(7) << Logger::LevelToString(record.level) << "] "
+            << "[" << record.file << ":" << record.line << "] ";
+    } else {
+        oss << "[" << Logger::LevelToString(record.level) << "] ";
+    }
+    oss << record.message << std::endl;
     
     std::string logLine = oss.str();
     
     if (consoleOutput) {
-        if (level >= LogLevel::kError) {
+        if (record.level >= LogLevel::kError) {
             std::cerr << logLine;
         } else {
             std::cout << logLine;
         }
     }
     
-    if (this->file.is_open()) {
-        this->file << logLine;
+    if (file.is_open()) {
+        file << logLine;
     }
 }
 
-std::string Logger::Impl::GetTimestamp() const {
-    auto now = std::chrono::system_clock::now();
+std::string Logger::Impl::FormatTimestamp(std::chrono::system_clock::time_point now) {
     auto time = std::chrono::system_clock::to_time_t(now);
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()) % 1000;
@@ -85,7 +198,7 @@ Logger& Logger::Instance() {
     return instance;
 }
 
-Logger::Logger() : impl_(std::make_unique<Impl>()) {
+Logger::Logger() : impl_(new Impl()) {
 }
 
 Logger::~Logger() {
@@ -93,15 +206,16 @@ Logger::~Logger() {
 }
 
 void Logger::SetLevel(LogLevel level) {
-    impl_->level = level;
+    s_level.store(static_cast<int>(level), std::memory_order_relaxed);
 }
 
 LogLevel Logger::GetLevel() const {
-    return impl_->level;
+    return static_cast<LogLevel>(s_level.load(std::memory_order_relaxed));
 }
 
 void Logger::SetLogFile(const std::string& filepath) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->WaitDrained();
+    std::lock_guard<std::mutex> lock(impl_->sinkMutex);
     if (impl_->file.is_open()) {
         impl_->file.close();
     }
@@ -110,9 +224,27 @@ void Logger::SetLogFile(const std::string& filepath) {
 }
 
 void Logger::SetConsoleOutput(bool enable) {
+    impl_->WaitDrained();
+    std::lock_guard<std::mutex> lock(impl_->sinkMutex);
     impl_->consoleOutput = enable;
 }
 
+void Logger::SetQueueCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    impl_->capacity = capacity;
+    impl_->spaceReady.notify_all();
+}
+
+size_t Logger::GetQueueCapacity() const {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    return impl_->capacity;
+}
+
+size_t Logger::GetDroppedCount() const {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    return impl_->dropped;
+}
+
 void Logger::Trace(const std::string& message) {
     Log(LogLevel::kTrace, message);
 }
@@ -138,22 +270,30 @@ void Logger::Fatal(const std::string& message) {
 }
 
 void Logger::Log(LogLevel level, const std::string& message) {
-    if (level < impl_->level) {
+    if (!IsEnabled(level)) {
         return;
     }
-    impl_->WriteLog(level, message);
+    impl_->Enqueue(level, nullptr, 0, message);
+    if (level >= LogLevel::kFatal) {
+        Flush();
+    }
 }
 
 void Logger::LogWithLocation(LogLevel level, const char* file, int line, 
                              const char* func, const std::string& message) {
-    if (level < impl_->level) {
+    (void)func;
+    if (!IsEnabled(level)) {
         return;
     }
-    impl_->WriteLogWithLocation(level, file, line, func, message);
+    impl_->Enqueue(level, file, line, message);
+    if (level >= LogLevel::kFatal) {
+        Flush();
+    }
 }
 
 void Logger::Flush() {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->WaitDrained();
+    std::lock_guard<std::mutex> lock(impl_->sinkMutex);
     if (impl_->file.is_open()) {
         impl_->file.flush();
     }
@@ -163,7 +303,8 @@ void Logger::Flush() {
 }
 
 void Logger::Close() {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->WaitDrained();
+    std::lock_guard<std::mutex> lock(impl_->sinkMutex);
     if (impl_->file.is_open()) {
         impl_->file.close();
     }
@@ -192,31 +333,59 @@ LogLevel Logger::StringToLevel(const std::string& str) {
     return LogLevel::kNone;
 }
 
-LogHelper::LogHelper(LogLevel level) : m_level(level) {}
+namespace {
+
+struct ThreadLogBuffer {
+    std::string text;
+    bool inUse = false;
+};
+
+ThreadLogBuffer& LocalLogBuffer() {
+    static thread_local ThreadLogBuffer buffer;
+    return buffer;
+}
+
+}
+
+LogHelper::LogHelper(LogLevel level)
+    : m_level(level)
+    , m_buffer(&m_ownBuffer)
+    , m_borrowed(false) {
+    ThreadLogBuffer& local = LocalLogBuffer();
+    if (!local.inUse) {
+        local.inUse = true;
+        local.text.clear();
+        m_buffer = &local.text;
+        m_borrowed = true;
+    }
+}
 
 LogHelper::~LogHelper() {
-    Logger::Instance().Log(m_level, m_buffer);
+    Logger::Instance().Log(m_level, *m_buffer);
+    if (m_borrowed) {
+        LocalLogBuffer().inUse = false;
+    }
 }
 
 LogHelper& LogHelper::operator<<(const std::string& msg) {
-    m_buffer += msg;
+    *m_buffer += msg;
     return *this;
 }
 
 LogHelper& LogHelper::operator<<(const char* msg) {
-    m_buffer += msg;
+    *m_buffer += msg;
     return *this;
 }
 
 LogHelper& LogHelper::operator<<(int value) {
-    m_buffer += std::to_string(value);
+    *m_buffer += std::to_string(value);
     return *this;
 }
 
 LogHelper& LogHelper::operator<<(double value) {
-    m_buffer += std::to_string(value);
+    *m_buffer += std::to_string(value);
     return *this;
 }
 
 }  
-}  
+}
@@ -1,9 +1,19 @@
 #include "ogc/base/performance_metrics.h"
+#include "ogc/base/trace.h"
 #include <algorithm>
 
 namespace ogc {
 namespace base {
 
+namespace {
+
+uint64_t ToTraceNs(std::chrono::steady_clock::time_point time) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        time.time_since_epoch()).count());
+}
+
+}
+
 void FpsMetrics::UpdateFps(double deltaTimeMs) {
     if (deltaTimeMs > 0) {
         currentFps = 1000.0 / deltaTimeMs;
@@ -93,6 +103,11 @@ void PerformanceMetricsCollector::EndFrame() {
     if (frameTimeMs > 16.67) {
         m_metrics.fps.droppedFrames++;
     }
+    
+    Tracer& tracer = Tracer::Instance();
+    if (tracer.IsEnabled()) {
+        tracer.RecordSpan("Frame", "render", ToTraceNs(m_frameStartTime), ToTraceNs(endTime));
+    }
 }
 
 void PerformanceMetricsCollector::BeginRenderPass(const std::string& passName) {
@@ -110,6 +125,15 @@ void PerformanceMetricsCollector::EndRenderPass() {
     pass.passTimeMs = passTimeMs;
     
     m_metrics.renderPasses.push_back(pass);
+    
+    Tracer& tracer = Tracer::Instance();
+    if (tracer.IsEnabled()) {
+        const char*& traceName = m_passTraceNames[m_currentPassName];
+        if (!traceName) {
+            traceName = tracer.Intern(m_currentPassName);
+        }
+        tracer.RecordSpan(traceName, "render", ToTraceNs(m_passStartTime), ToTraceNs(endTime));
+    }
     m_currentPassName.clear();
 }
 
@@ -0,0 +1,541 @@
+#include "ogc/base/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <set>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace ogc {
+namespace base {
+
+namespace {
+
+// Drained rings kept for reuse by threads that start later.
+const size_t kMaxSpareBuffers = 4;
+
+const size_t kCacheLineSize = 64;
+
+void* AllocateAligned(size_t size) {
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size, kCacheLineSize);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kCacheLineSize, size) != 0) {
+        ptr = nullptr;
+    }
+#endif
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void FreeAligned(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+size_t ShardIndex() {
+    static std::atomic<size_t> nextShard(0);
+    static thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+
+size_t BucketIndex(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long bit = 0;
+    _BitScanReverse64(&bit, value);
+    size_t index = static_cast<size_t>(bit) + 1;
+#elif defined(__GNUC__) || defined(__clang__)
+    size_t index = 64 - static_cast<size_t>(__builtin_clzll(value));
+#else
+    size_t index = 0;
+    while (value != 0) {
+        value >>= 1;
+        ++index;
+    }
+#endif
+    return std::min(index, HistogramSnapshot::kBucketCount - 1);
+}
+
+void AppendEscaped(std::string& out, const char* text) {
+    for (const char* p = text ? text : ""; *p; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += static_cast<char>(c);
+                }
+                break;
+        }
+    }
+}
+
+void AppendMicros(std::string& out, uint64_t ns) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llu.%03u",
+             static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+    out += buffer;
+}
+
+/**
+ * One slot of a thread's ring. seq is a per-slot sequence lock: 0 while the
+ * owner is writing, otherwise the ring index + 1 of the span it holds.
+ */
+struct Slot {
+    std::atomic<uint64_t> seq;
+    std::atomic<const char*> name;
+    std::atomic<const char*> category;
+    std::atomic<uint64_t> startNs;
+    std::atomic<uint64_t> durationNs;
+
+    Slot() : seq(0), name(nullptr), category(nullptr), startNs(0), durationNs(0) {}
+};
+
+struct ThreadBuffer {
+    std::unique_ptr<Slot[]> slots;
+    uint64_t capacity;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> clearedAt;
+    std::atomic<bool> retired;
+    uint32_t threadId;
+
+    ThreadBuffer(uint64_t size, uint32_t id)
+        : slots(new Slot[size])
+        , capacity(size)
+        , head(0)
+        , clearedAt(0)
+        , retired(false)
+        , threadId(id) {
+    }
+};
+
+struct ThreadHandle {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadHandle() {
+        if (buffer) {
+            buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+void AppendEvents(const ThreadBuffer& buffer, std::vector<TraceEvent>& events) {
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+    uint64_t first = head > buffer.capacity ? head - buffer.capacity : 0;
+    first = std::max(first, buffer.clearedAt.load(std::memory_order_relaxed));
+    for (uint64_t index = first; index < head; ++index) {
+        const Slot& slot = buffer.slots[index & (buffer.capacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        TraceEvent event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.category = slot.category.load(std::memory_order_relaxed);
+        event.startNs = slot.startNs.load(std::memory_order_relaxed);
+        event.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+        event.threadId = buffer.threadId;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+        events.push_back(event);
+    }
+}
+
+bool StartsEarlier(const TraceEvent& a, const TraceEvent& b) {
+    return a.startNs < b.startNs;
+}
+
+}
+
+double HistogramSnapshot::GetMean() const {
+    return count > 0 ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+}
+
+uint64_t HistogramSnapshot::GetPercentile(double percentile) const {
+    if (count == 0 || buckets.empty()) {
+        return 0;
+    }
+    double clamped = std::max(0.0, std::min(percentile, 100.0));
+    uint64_t target = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(count) + 0.5);
+    target = std::max<uint64_t>(target, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            if (i == 0) {
+                return 0;
+            }
+            uint64_t upper = i >= 64 ? UINT64_MAX : ((static_cast<uint64_t>(1) << i) - 1);
+            return std::min(upper, max);
+        }
+    }
+    return max;
+}
+
+TraceCounter::TraceCounter() {
+    Reset();
+}
+
+void* TraceCounter::operator new(size_t size) {
+    return AllocateAligned(size);
+}
+
+void TraceCounter::operator delete(void* ptr) {
+    FreeAligned(ptr);
+}
+
+void TraceCounter::Add(int64_t delta) {
+    m_shards[ShardIndex() % kShardCount].value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+int64_t TraceCounter::GetValue() const {
+    int64_t total = 0;
+    for (size_t i = 0; i < kShardCount; ++i) {
+        total += m_shards[i].value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void TraceCounter::Reset() {
+    for (size_t i = 0; i < kShardCount; ++i) {
+        m_shards[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+TraceHistogram::TraceHistogram() {
+    Reset();
+}
+
+void* TraceHistogram::operator new(size_t size) {
+    return AllocateAligned(size);
+}
+
+void TraceHistogram::operator delete(void* ptr) {
+    FreeAligned(ptr);
+}
+
+void TraceHistogram::Record(uint64_t value) {
+    Shard& shard = m_shards[ShardIndex() % kShardCount];
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t current = shard.max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !shard.max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot TraceHistogram::GetSnapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(HistogramSnapshot::kBucketCount, 0);
+    for (size_t s = 0; s < kShardCount; ++s) {
+        const Shard& shard = m_shards[s];
+        snapshot.count += shard.count.load(std::memory_order_relaxed);
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+        for (size_t b = 0; b < HistogramSnapshot::kBucketCount; ++b) {
+            snapshot.buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+void TraceHistogram::Reset() {
+    for (size_t s = 0; s < kShardCount; ++s) {
+        Shard& shard = m_shards[s];
+        shard.count.store(0, std::memory_order_relaxed);
+        shard.sum.store(0, std::memory_order_relaxed);
+        shard.max.store(0, std::memory_order_relaxed);
+        for (size_t b = 0; b < HistogramSnapshot::kBucketCount; ++b) {
+            shard.buckets[b].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+struct Tracer::Impl {
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<std::shared_ptr<ThreadBuffer>> spares;
+    // Spans of exited threads, newest capacity of them across all threads.
+    std::vector<TraceEvent> retiredEvents;
+    std::map<std::string, std::unique_ptr<TraceCounter>> counters;
+    std::map<std::string, std::unique_ptr<TraceHistogram>> histograms;
+    std::set<std::string> names;
+    uint64_t capacity;
+    uint32_t nextThreadId;
+
+    Impl() : capacity(4096), nextThreadId(1) {}
+
+    ThreadBuffer* LocalBuffer() {
+        static thread_local ThreadHandle handle;
+        if (!handle.buffer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ReclaimLocked();
+            if (!spares.empty()) {
+                handle.buffer = spares.back();
+                spares.pop_back();
+                ThreadBuffer& buffer = *handle.buffer;
+                for (uint64_t i = 0; i < buffer.capacity; ++i) {
+                    buffer.slots[i].seq.store(0, std::memory_order_relaxed);
+                }
+                buffer.head.store(0, std::memory_order_relaxed);
+                buffer.clearedAt.store(0, std::memory_order_relaxed);
+                buffer.retired.store(false, std::memory_order_relaxed);
+                buffer.threadId = nextThreadId++;
+            } else {
+                handle.buffer = std::make_shared<ThreadBuffer>(capacity, nextThreadId++);
+            }
+            buffers.push_back(handle.buffer);
+        }
+        return handle.buffer.get();
+    }
+
+    /**
+     * Moves the spans of exited threads into retiredEvents and frees their
+     * rings, keeping a few of the current capacity as spares. A ring is only
+     * touched once no reader holds it either.
+     */
+    void ReclaimLocked() {
+        size_t kept = 0;
+        bool drained = false;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            std::shared_ptr<ThreadBuffer>& buffer = buffers[i];
+            if (!buffer->retired.load(std::memory_order_acquire) || buffer.use_count() != 1) {
+                buffers[kept++].swap(buffer);
+                continue;
+            }
+            AppendEvents(*buffer, retiredEvents);
+            drained = true;
+            if (buffer->capacity == capacity && spares.size() < kMaxSpareBuffers) {
+                spares.push_back(buffer);
+            }
+            buffer.reset();
+        }
+        buffers.resize(kept);
+        if (drained && retiredEvents.size() > capacity) {
+            std::sort(retiredEvents.begin(), retiredEvents.end(), StartsEarlier);
+            retiredEvents.erase(retiredEvents.begin(),
+                                retiredEvents.end() - static_cast<std::ptrdiff_t>(capacity));
+        }
+    }
+};
+
+Tracer& Tracer::Instance() {
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer()
+    : m_impl(new Impl())
+    , m_enabled(true) {
+}
+
+Tracer::~Tracer() {
+}
+
+void Tracer::SetEnabled(bool enable) {
+    m_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Tracer::SetBufferCapacity(size_t capacity) {
+    uint64_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    m_impl->capacity = size;
+    m_impl->spares.clear();
+}
+
+size_t Tracer::GetBufferCapacity() const {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return static_cast<size_t>(m_impl->capacity);
+}
+
+size_t Tracer::GetBufferCount() const {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    m_impl->ReclaimLocked();
+    return m_impl->buffers.size() + m_impl->spares.size();
+}
+
+void Tracer::RecordSpan(const char* name, const char* category, uint64_t startNs, uint64_t endNs) {
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadBuffer* buffer = m_impl->LocalBuffer();
+    uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    Slot& slot = buffer->slots[index & (buffer->capacity - 1)];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs > startNs ? endNs - startNs : 0, std::memory_order_relaxed);
+    slot.seq.store(index + 1, std::memory_order_release);
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+TraceCounter& Tracer::GetCounter(const char* name) {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    std::unique_ptr<TraceCounter>& counter = m_impl->counters[name];
+    if (!counter) {
+        counter.reset(new TraceCounter());
+    }
+    return *counter;
+}
+
+TraceHistogram& Tracer::GetHistogram(const char* name) {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    std::unique_ptr<TraceHistogram>& histogram = m_impl->histograms[name];
+    if (!histogram) {
+        histogram.reset(new TraceHistogram());
+    }
+    return *histogram;
+}
+
+const char* Tracer::Intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    return m_impl->names.insert(name).first->c_str();
+}
+
+std::vector<TraceEvent> Tracer::GetEvents() const {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->mutex);
+        m_impl->ReclaimLocked();
+        buffers = m_impl->buffers;
+        events = m_impl->retiredEvents;
+    }
+
+    for (const auto& buffer : buffers) {
+        AppendEvents(*buffer, events);
+    }
+
+    std::sort(events.begin(), events.end(), StartsEarlier);
+    return events;
+}
+
+std::map<std::string, int64_t> Tracer::GetCounterValues() const {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    std::map<std::string, int64_t> values;
+    for (const auto& pair : m_impl->counters) {
+        values[pair.first] = pair.second->GetValue();
+    }
+    return values;
+}
+
+std::map<std::string, HistogramSnapshot> Tracer::GetHistogramSnapshots() const {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    std::map<std::string, HistogramSnapshot> snapshots;
+    for (const auto& pair : m_impl->histograms) {
+        snapshots[pair.first] = pair.second->GetSnapshot();
+    }
+    return snapshots;
+}
+
+std::string Tracer::ExportChromeTrace() const {
+    std::vector<TraceEvent> events = GetEvents();
+    std::map<std::string, int64_t> counters = GetCounterValues();
+
+    uint64_t origin = events.empty() ? NowNs() : events.front().startNs;
+    uint64_t end = origin;
+    for (const auto& event : events) {
+        end = std::max(end, event.startNs + event.durationNs);
+    }
+
+    std::string json;
+    json.reserve(events.size() * 96 + 64);
+    json += "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& event : events) {
+        json += first ? "\n" : ",\n";
+        first = false;
+        json += "{\"name\":\"";
+        AppendEscaped(json, event.name);
+        json += "\",\"cat\":\"";
+        AppendEscaped(json, event.category);
+        json += "\",\"ph\":\"X\",\"ts\":";
+        AppendMicros(json, event.startNs - origin);
+        json += ",\"dur\":";
+        AppendMicros(json, event.durationNs);
+        json += ",\"pid\":1,\"tid\":";
+        json += std::to_string(event.threadId);
+        json += "}";
+    }
+    for (const auto& pair : counters) {
+        json += first ? "\n" : ",\n";
+        first = false;
+        json += "{\"name\":\"";
+        AppendEscaped(json, pair.first.c_str());
+        json += "\",\"ph\":\"C\",\"ts\":";
+        AppendMicros(json, end - origin);
+        json += ",\"pid\":1,\"args\":{\"value\":";
+        json += std::to_string(pair.second);
+        json += "}}";
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return json;
+}
+
+bool Tracer::WriteChromeTrace(const std::string& filepath) const {
+    std::ofstream file(filepath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string json = ExportChromeTrace();
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    return file.good();
+}
+
+void Tracer::Clear() {
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    m_impl->ReclaimLocked();
+    m_impl->retiredEvents.clear();
+    for (const auto& buffer : m_impl->buffers) {
+        buffer->clearedAt.store(buffer->head.load(std::memory_order_acquire),
+                                std::memory_order_relaxed);
+    }
+    for (auto& pair : m_impl->counters) {
+        pair.second->Reset();
+    }
+    for (auto& pair : m_impl->histograms) {
+        pair.second->Reset();
+    }
+}
+
+uint64_t Tracer::NowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+}
@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 #include <ogc/base/log.h>
+#include <cstdio>
+#include <fstream>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace ogc::base;
 
@@ -116,3 +121,113 @@ TEST_F(LogTest, LogHelperDouble) {
     Logger::Instance().SetLevel(LogLevel::kInfo);
     LOG_INFO() << "Double value: " << 3.14;
 }
+
+namespace {
+
+int CountingArgument(int* calls) {
+    ++*calls;
+    return *calls;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path.c_str());
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+}
+
+TEST_F(LogTest, DisabledStatementSkipsArguments) {
+    Logger::Instance().SetLevel(LogLevel::kWarning);
+    int calls = 0;
+    LOG_DEBUG() << "Skipped " << CountingArgument(&calls);
+    LOG_INFO_FMT("Skipped %d", CountingArgument(&calls));
+    EXPECT_EQ(calls, 0);
+    
+    Logger::Instance().SetConsoleOutput(false);
+    LOG_WARNING() << "Evaluated " << CountingArgument(&calls);
+    EXPECT_EQ(calls, 1);
+    Logger::Instance().SetConsoleOutput(true);
+}
+
+TEST_F(LogTest, NestedStatementsKeepSeparateBuffers) {
+    Logger::Instance().SetConsoleOutput(false);
+    Logger::Instance().SetLogFile("test_log_nested.txt");
+    Logger::Instance().SetLevel(LogLevel::kInfo);
+    
+    struct Nested {
+        static std::string Describe() {
+            LOG_INFO() << "inner statement";
+            return "outer value";
+        }
+    };
+    LOG_INFO() << "outer statement: " << Nested::Describe();
+    Logger::Instance().Flush();
+    
+    std::string content = ReadFile("test_log_nested.txt");
+    EXPECT_NE(content.find("inner statement"), std::string::npos);
+    EXPECT_NE(content.find("outer statement: outer value"), std::string::npos);
+    Logger::Instance().SetConsoleOutput(true);
+}
+
+TEST_F(LogTest, AsyncSinkPreservesOrderAfterFlush) {
+    std::remove("test_log_async.txt");
+    Logger::Instance().SetConsoleOutput(false);
+    Logger::Instance().SetLogFile("test_log_async.txt");
+    Logger::Instance().SetLevel(LogLevel::kInfo);
+    
+    for (int i = 0; i < 100; ++i) {
+        LOG_INFO() << "async message " << i;
+    }
+    Logger::Instance().Flush();
+    
+    std::string content = ReadFile("test_log_async.txt");
+    size_t first = content.find("async message 0\n");
+    size_t last = content.find("async message 99\n");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(last, std::string::npos);
+    EXPECT_LT(first, last);
+    Logger::Instance().SetConsoleOutput(true);
+}
+
+TEST_F(LogTest, FullQueueDropsOnlyLowLevels) {
+    std::remove("test_log_bounded.txt");
+    Logger::Instance().SetConsoleOutput(false);
+    Logger::Instance().SetLogFile("test_log_bounded.txt");
+    Logger::Instance().SetLevel(LogLevel::kInfo);
+    Logger::Instance().SetQueueCapacity(4);
+    size_t droppedBefore = Logger::Instance().GetDroppedCount();
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 250; ++i) {
+                LOG_INFO() << "bounded info";
+                if (i % 50 == 0) {
+                    LOG_ERROR() << "bounded error " << t << " " << i;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Logger::Instance().Flush();
+    Logger::Instance().SetQueueCapacity(8192);
+    
+    std::string content = ReadFile("test_log_bounded.txt");
+    size_t written = 0;
+    size_t errors = 0;
+    for (size_t pos = content.find("bounded info"); pos != std::string::npos;
+         pos = content.find("bounded info", pos + 1)) {
+        ++written;
+    }
+    for (size_t pos = content.find("bounded error"); pos != std::string::npos;
+         pos = content.find("bounded error", pos + 1)) {
+        ++errors;
+    }
+    EXPECT_EQ(errors, 20u);
+    EXPECT_EQ(written + (Logger::Instance().GetDroppedCount() - droppedBefore), 1000u);
+    Logger::Instance().SetConsoleOutput(true);
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include <ogc/base/trace.h>
+#include <ogc/base/performance_metrics.h>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace ogc::base;
+
+class TracerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Tracer::Instance().SetEnabled(true);
+        Tracer::Instance().Clear();
+    }
+
+    void TearDown() override {
+        Tracer::Instance().SetEnabled(true);
+        Tracer::Instance().SetBufferCapacity(4096);
+        Tracer::Instance().Clear();
+    }
+
+    static size_t CountNamed(const std::vector<TraceEvent>& events, const char* name) {
+        size_t count = 0;
+        for (const auto& event : events) {
+            if (std::string(event.name) == name) {
+                ++count;
+            }
+        }
+        return count;
+    }
+};
+
+TEST_F(TracerTest, ScopeRecordsSpan) {
+    {
+        OGC_TRACE_SCOPE("ScopeRecordsSpan");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    auto events = Tracer::Instance().GetEvents();
+    ASSERT_EQ(CountNamed(events, "ScopeRecordsSpan"), 1u);
+    for (const auto& event : events) {
+        if (std::string(event.name) == "ScopeRecordsSpan") {
+            EXPECT_STREQ(event.category, "ogc");
+            EXPECT_GE(event.durationNs, 1000000u);
+        }
+    }
+}
+
+TEST_F(TracerTest, DisabledTracerRecordsNothing) {
+    Tracer::Instance().SetEnabled(false);
+    {
+        OGC_TRACE_SCOPE("Disabled");
+    }
+    Tracer::Instance().SetEnabled(true);
+
+    EXPECT_EQ(CountNamed(Tracer::Instance().GetEvents(), "Disabled"), 0u);
+}
+
+TEST_F(TracerTest, ThreadsRecordIntoSeparateBuffers) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 100; ++i) {
+                OGC_TRACE_SCOPE_CAT("Worker", "tile");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto events = Tracer::Instance().GetEvents();
+    EXPECT_EQ(CountNamed(events, "Worker"), 400u);
+
+    std::set<uint32_t> threadIds;
+    for (const auto& event : events) {
+        threadIds.insert(event.threadId);
+    }
+    EXPECT_GE(threadIds.size(), 4u);
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_LE(events[i - 1].startNs, events[i].startNs);
+    }
+}
+
+TEST_F(TracerTest, RingKeepsNewestSpans) {
+    Tracer::Instance().SetBufferCapacity(6);
+    EXPECT_EQ(Tracer::Instance().GetBufferCapacity(), 8u);
+
+    std::thread writer([]() {
+        for (uint64_t i = 1; i <= 20; ++i) {
+            Tracer::Instance().RecordSpan("Ring", "test", i * 1000, i * 1000 + 10);
+        }
+    });
+    writer.join();
+
+    auto events = Tracer::Instance().GetEvents();
+    ASSERT_EQ(CountNamed(events, "Ring"), 8u);
+    EXPECT_EQ(events.front().startNs, 13000u);
+    EXPECT_EQ(events.back().startNs, 20000u);
+}
+
+TEST_F(TracerTest, ExitedThreadsReleaseTheirRings) {
+    Tracer::Instance().SetBufferCapacity(8);
+    for (uint64_t t = 1; t <= 64; ++t) {
+        std::thread worker([t]() {
+            Tracer::Instance().RecordSpan("Exited", "test", t * 1000, t * 1000 + 10);
+        });
+        worker.join();
+    }
+
+    EXPECT_LE(Tracer::Instance().GetBufferCount(), 8u);
+    auto events = Tracer::Instance().GetEvents();
+    ASSERT_EQ(CountNamed(events, "Exited"), 8u);
+    EXPECT_EQ(events.front().startNs, 57000u);
+    EXPECT_EQ(events.back().startNs, 64000u);
+
+    std::set<uint32_t> threadIds;
+    for (const auto& event : events) {
+        threadIds.insert(event.threadId);
+    }
+    EXPECT_EQ(threadIds.size(), 8u);
+}
+
+TEST_F(TracerTest, CountersAggregateAcrossThreads) {
+    TraceCounter& counter = Tracer::Instance().GetCounter("test.requests");
+    EXPECT_EQ(&counter, &Tracer::Instance().GetCounter("test.requests"));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&counter) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&Tracer::Instance().GetHistogram("test.latency")) % 64, 0u);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < 1000; ++i) {
+                counter.Add();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(counter.GetValue(), 8000);
+    EXPECT_EQ(Tracer::Instance().GetCounterValues()["test.requests"], 8000);
+}
+
+TEST_F(TracerTest, HistogramPercentiles) {
+    TraceHistogram& histogram = Tracer::Instance().GetHistogram("test.latency");
+    for (uint64_t i = 1; i <= 100; ++i) {
+        histogram.Record(i);
+    }
+
+    HistogramSnapshot snapshot = histogram.GetSnapshot();
+    EXPECT_EQ(snapshot.count, 100u);
+    EXPECT_EQ(snapshot.sum, 5050u);
+    EXPECT_EQ(snapshot.max, 100u);
+    EXPECT_DOUBLE_EQ(snapshot.GetMean(), 50.5);
+    EXPECT_EQ(snapshot.GetPercentile(50), 63u);
+    EXPECT_EQ(snapshot.GetPercentile(100), 100u);
+    EXPECT_EQ(snapshot.GetPercentile(1), 1u);
+}
+
+TEST_F(TracerTest, ExportChromeTrace) {
+    Tracer::Instance().RecordSpan("Export \"quoted\"", "test", 1000, 3500);
+    Tracer::Instance().GetCounter("test.exported").Add(3);
+
+    std::string json = Tracer::Instance().ExportChromeTrace();
+    EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+    EXPECT_NE(json.find("\"name\":\"Export \\\"quoted\\\"\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\",\"ts\":0.000,\"dur\":2.500"), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"test.exported\",\"ph\":\"C\""), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"value\":3}"), std::string::npos);
+}
+
+TEST_F(TracerTest, CollectorEmitsFrameAndPassSpans) {
+    PerformanceMetricsCollector collector;
+    collector.BeginFrame();
+    collector.BeginRenderPass("Labels");
+    collector.EndRenderPass();
+    collector.EndFrame();
+
+    auto events = Tracer::Instance().GetEvents();
+    EXPECT_EQ(CountNamed(events, "Frame"), 1u);
+    EXPECT_EQ(CountNamed(events, "Labels"), 1u);
+}
+
+TEST_F(TracerTest, SpanOverhead) {
+    const int iterations = 100000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        OGC_TRACE_SCOPE("Overhead");
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto perSpanNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations;
+    EXPECT_LT(perSpanNs, 2000);
+}
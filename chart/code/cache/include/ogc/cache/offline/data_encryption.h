@@ -83,6 +83,31 @@ public:
                                          const EncryptionKey& key,
                                          EncryptionAlgorithm algorithm) = 0;
     
+    /**
+     * @brief Encrypts a buffer in place with the active key and algorithm.
+     * On success it holds the nonce, the ciphertext and the tag or MAC.
+     */
+    virtual bool EncryptInPlace(std::vector<uint8_t>& data) = 0;
+    
+    /**
+     * @brief Reverses EncryptInPlace. A buffer that fails authentication is
+     * cleared.
+     */
+    virtual bool DecryptInPlace(std::vector<uint8_t>& data) = 0;
+    
+    /**
+     * @brief Encrypts or decrypts every buffer in place, spread over
+     * threadCount threads (0 uses the hardware concurrency).
+     */
+    virtual bool EncryptBatch(std::vector<std::vector<uint8_t>>& items,
+                              int threadCount = 0) = 0;
+    virtual bool DecryptBatch(std::vector<std::vector<uint8_t>>& items,
+                              int threadCount = 0) = 0;
+    
+    /**
+     * @brief Streams the file through the cipher in fixed-size chunks, so
+     * large offline bundles never have to fit in memory.
+     */
     virtual bool EncryptFile(const std::string& inputPath,
                              const std::string& outputPath) = 0;
     virtual bool DecryptFile(const std::string& inputPath,
@@ -3,6 +3,7 @@
 
 #include "ogc/cache/export.h"
 #include "ogc/cache/tile/tile_key.h"
+#include "ogc/cache/offline/tile_source.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -41,17 +42,30 @@ struct DownloadProgress {
     int totalTiles;
     int downloadedTiles;
     int failedTiles;
+    int skippedTiles;
+    uint64_t bytesDownloaded;
     double progress;
+    double tilesPerSecond;
+    double bytesPerSecond;
+    double etaSeconds;
     std::string status;
     std::string currentTile;
     std::string errorMessage;
     
     DownloadProgress()
         : totalTiles(0), downloadedTiles(0), failedTiles(0)
-        , progress(0.0)
+        , skippedTiles(0), bytesDownloaded(0)
+        , progress(0.0), tilesPerSecond(0.0), bytesPerSecond(0.0)
+        , etaSeconds(0.0)
     {}
 };
 
+struct DownloadedTile {
+    TileKey key;
+    std::vector<uint8_t> data;
+    std::string contentHash;
+};
+
 struct StorageInfo {
     size_t totalSpace;
     size_t usedSpace;
@@ -114,6 +128,20 @@ public:
     virtual void ResumeDownload(const std::string& regionId) = 0;
     virtual void CancelDownload(const std::string& regionId) = 0;
     
+    /**
+     * @brief Waits for a background download and its completion callback;
+     * true when none is running. Completion callbacks may start, cancel or
+     * delete the region but must not shut the manager down.
+     */
+    virtual bool WaitForDownload(const std::string& regionId, int timeoutMs = -1) = 0;
+    
+    /**
+     * @brief Source used by StartDownload. Without one, StartDownload only
+     * reports the tile count and completes immediately.
+     */
+    virtual void SetTileSource(TileSourcePtr source) = 0;
+    virtual TileSourcePtr GetTileSource() const = 0;
+    
     virtual bool IsDownloading(const std::string& regionId) const = 0;
     virtual double GetDownloadProgress(const std::string& regionId) const = 0;
     
@@ -121,6 +149,12 @@ public:
                            const TileKey& key,
                            const std::vector<uint8_t>& data) = 0;
     
+    /**
+     * @brief Stores several tiles and saves the region metadata once.
+     */
+    virtual bool StoreTiles(const std::string& regionId,
+                            const std::vector<DownloadedTile>& tiles) = 0;
+    
     virtual bool HasTile(const std::string& regionId, const TileKey& key) const = 0;
     virtual std::vector<uint8_t> GetTile(const std::string& regionId,
                                          const TileKey& key) const = 0;
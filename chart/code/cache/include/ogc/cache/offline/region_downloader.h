@@ -0,0 +1,114 @@
+#ifndef OGC_CACHE_OFFLINE_REGION_DOWNLOADER_H
+#define OGC_CACHE_OFFLINE_REGION_DOWNLOADER_H
+
+#include "ogc/cache/export.h"
+#include "ogc/cache/offline/offline_storage_manager.h"
+#include "ogc/cache/offline/tile_source.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ogc {
+namespace cache {
+
+struct TileRange {
+    int z;
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+
+    TileRange() : z(0), minX(0), maxX(-1), minY(0), maxY(-1) {}
+
+    uint64_t GetCount() const {
+        if (maxX < minX || maxY < minY) {
+            return 0;
+        }
+        return static_cast<uint64_t>(maxX - minX + 1) * static_cast<uint64_t>(maxY - minY + 1);
+    }
+};
+
+/**
+ * @brief Web Mercator tile ranges covering a bounding box, one per zoom level.
+ * Latitudes are clamped to the Mercator limit and indices to the tile grid.
+ */
+OGC_CACHE_API std::vector<TileRange> ComputeTileRanges(double minLon, double maxLon,
+                                                       double minLat, double maxLat,
+                                                       int minZoom, int maxZoom);
+
+struct DownloadOptions {
+    int maxConcurrent;
+    int timeoutSeconds;
+    int retryCount;
+    size_t writeBatchSize;
+    int progressIntervalMs;
+
+    DownloadOptions()
+        : maxConcurrent(4), timeoutSeconds(30), retryCount(3)
+        , writeBatchSize(64), progressIntervalMs(250)
+    {}
+};
+
+/**
+ * @brief Downloads one offline region from a tile source.
+ *
+ * A pool of maxConcurrent fetch threads claims tiles from the region's
+ * ranges and hands them over a bounded queue to a single writer, which
+ * stores them in batches and appends each batch to a resume journal
+ * ("z/x/y hash" per line). Tiles that are stored are skipped; when the
+ * source can report a content hash, a journalled tile whose hash has
+ * changed is fetched again. A journalled tile that is no longer stored is
+ * always fetched again. Stopping keeps the journal, so a
+ * later download of the same region continues where this one stopped.
+ *
+ * Progress and completion callbacks run on the writer thread and must not
+ * wait for this download. The completion callback runs after the download
+ * is marked finished and may restart, stop or destroy it.
+ */
+class OGC_CACHE_API RegionDownloader {
+public:
+    using TileBatchWriter = std::function<bool(const std::vector<DownloadedTile>&)>;
+    using TilePresence = std::function<bool(const TileKey&)>;
+
+    RegionDownloader(const OfflineRegion& region,
+                     TileSourcePtr source,
+                     const std::string& journalPath,
+                     const DownloadOptions& options,
+                     TilePresence hasTile,
+                     TileBatchWriter writeBatch);
+    ~RegionDownloader();
+
+    /**
+     * @brief Reports the initial progress synchronously, then downloads in
+     * the background.
+     */
+    void Start(OfflineStorageManager::ProgressCallback progressCallback,
+               OfflineStorageManager::CompletionCallback completionCallback);
+
+    /**
+     * @brief Stops claiming tiles, stores the tiles already fetched and waits
+     * for the threads. The completion callback is not called.
+     */
+    void Stop();
+
+    /**
+     * @brief Waits until the download finishes; a negative timeout waits forever.
+     */
+    bool Wait(int timeoutMs = -1);
+
+    bool IsRunning() const;
+    DownloadProgress GetProgress() const;
+
+private:
+    RegionDownloader(const RegionDownloader&) = delete;
+    RegionDownloader& operator=(const RegionDownloader&) = delete;
+
+    struct Impl;
+    std::shared_ptr<Impl> m_impl;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef OGC_CACHE_OFFLINE_TILE_BLOB_STORE_H
+#define OGC_CACHE_OFFLINE_TILE_BLOB_STORE_H
+
+#include "ogc/cache/export.h"
+#include "ogc/cache/tile/tile_key.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace ogc {
+namespace cache {
+
+struct TileBlobStoreStats {
+    size_t tileCount;
+    size_t blobCount;
+    uint64_t logicalBytes;
+    uint64_t liveBytes;
+    uint64_t fileBytes;
+    int segmentCount;
+
+    TileBlobStoreStats()
+        : tileCount(0), blobCount(0)
+        , logicalBytes(0), liveBytes(0), fileBytes(0)
+        , segmentCount(0)
+    {}
+};
+
+/**
+ * @brief Content-addressed tile storage shared by all offline regions.
+ *
+ * Each distinct tile content is stored once as a blob appended to a segment
+ * file, and a reference-counted index maps (region, z, x, y) to blobs, so
+ * identical sea, land or blank tiles cost one copy however many regions and
+ * zoom levels use them. Index changes are appended to a log that is
+ * replayed on Open.
+ *
+ * Blobs whose last reference goes away leave dead bytes in their segment.
+ * Compact copies the live blobs of mostly dead segments into the current
+ * segment and deletes the old files. Readers only take the index lock for
+ * the lookup, so they keep running while compaction moves blobs; a reader
+ * still using a retired segment keeps the file until it is done.
+ */
+class OGC_CACHE_API TileBlobStore {
+public:
+    static const uint64_t kDefaultSegmentSize = 64ULL * 1024 * 1024;
+
+    explicit TileBlobStore(const std::string& path,
+                           uint64_t segmentSize = kDefaultSegmentSize);
+    ~TileBlobStore();
+
+    bool Open();
+    void Close();
+    bool IsOpen() const;
+
+    bool Put(const std::string& regionId, const TileKey& key,
+             const std::vector<uint8_t>& data);
+    bool Has(const std::string& regionId, const TileKey& key) const;
+    bool Get(const std::string& regionId, const TileKey& key,
+             std::vector<uint8_t>& data) const;
+    bool Remove(const std::string& regionId, const TileKey& key);
+    void RemoveRegion(const std::string& regionId);
+    void Clear();
+
+    /**
+     * @brief Writes buffered index records to disk.
+     */
+    bool Flush();
+
+    /**
+     * @brief Like Flush, but also waits until the current segment and the
+     * index log are on stable storage. Use before deleting a copy of the data.
+     */
+    bool Sync();
+
+    size_t GetTileCount(const std::string& regionId) const;
+    uint64_t GetRegionBytes(const std::string& regionId) const;
+
+    /**
+     * @brief Rewrites the live blobs of segments whose live share is below
+     * maxLiveRatio. With a non-zero maxBytes it stops after moving about
+     * that many bytes, so the work can be spread over several calls.
+     */
+    bool Compact(double maxLiveRatio = 0.5, uint64_t maxBytes = 0);
+
+    /**
+     * @brief Checks every live blob against its stored header and hash.
+     */
+    bool Validate() const;
+
+    TileBlobStoreStats GetStats() const;
+    std::string GetPath() const;
+
+private:
+    TileBlobStore(const TileBlobStore&);
+    TileBlobStore& operator=(const TileBlobStore&);
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}
+}
+
+#endif
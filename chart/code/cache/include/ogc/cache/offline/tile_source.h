@@ -0,0 +1,74 @@
+#ifndef OGC_CACHE_OFFLINE_TILE_SOURCE_H
+#define OGC_CACHE_OFFLINE_TILE_SOURCE_H
+
+#include "ogc/cache/export.h"
+#include "ogc/cache/tile/tile_key.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace ogc {
+namespace cache {
+
+struct TileFetchResult {
+    std::vector<uint8_t> data;
+    std::string contentHash;
+    std::string error;
+};
+
+/**
+ * @brief Upstream that offline downloads fetch tiles from.
+ *
+ * Implementations are called concurrently from the download pool and must
+ * be thread-safe. contentHash is optional; when a source can report it
+ * without transferring the tile (an ETag or a manifest), GetTileHash lets
+ * the downloader skip tiles that are already stored unchanged.
+ */
+class OGC_CACHE_API TileSource {
+public:
+    virtual ~TileSource();
+
+    virtual bool FetchTile(const TileKey& key, int timeoutSeconds, TileFetchResult& result) = 0;
+
+    /**
+     * @brief Returns false when the hash is not known without fetching.
+     */
+    virtual bool GetTileHash(const TileKey& key, std::string& hash);
+
+    virtual std::string GetName() const = 0;
+};
+
+typedef std::shared_ptr<TileSource> TileSourcePtr;
+
+/**
+ * @brief Tile source reading from a local directory tree.
+ *
+ * The path template expands {z}, {x} and {y}, for example
+ * "/data/charts/{z}/{x}/{y}.png". Missing files are reported as failures.
+ */
+class OGC_CACHE_API FileTileSource : public TileSource {
+public:
+    explicit FileTileSource(const std::string& pathTemplate);
+
+    bool FetchTile(const TileKey& key, int timeoutSeconds, TileFetchResult& result) override;
+    bool GetTileHash(const TileKey& key, std::string& hash) override;
+    std::string GetName() const override;
+
+    std::string GetTilePath(const TileKey& key) const;
+
+    static TileSourcePtr Create(const std::string& pathTemplate);
+
+private:
+    std::string m_pathTemplate;
+};
+
+/**
+ * @brief 64-bit FNV-1a of the tile bytes as 16 hex digits.
+ */
+OGC_CACHE_API std::string ComputeTileHash(const std::vector<uint8_t>& data);
+
+}
+}
+
+#endif
@@ -8,6 +8,17 @@
 namespace ogc {
 namespace cache {
 
+/**
+ * @brief Stacks tile caches, fastest first.
+ *
+ * Each level does its own locking; lookups only read an immutable snapshot
+ * of the level list, so a hit in the first level never waits for another
+ * level. With write-back enabled (the default) PutTile writes the first level
+ * directly and hands the lower-level writes, as well as promotions of tiles
+ * found further down, to a background queue. The queue coalesces writes to
+ * the same tile, blocks writers once it holds GetWriteQueueDepth() tiles and
+ * is drained by Flush() and on destruction.
+ */
 class OGC_CACHE_API MultiLevelTileCache : public TileCache {
 public:
     MultiLevelTileCache();
@@ -54,6 +65,10 @@ public:
     void SetWriteBack(bool writeBack);
     bool IsWriteBack() const;
     
+    void SetWriteQueueDepth(size_t depth);
+    size_t GetWriteQueueDepth() const;
+    size_t GetPendingWriteCount() const;
+    
     static std::shared_ptr<MultiLevelTileCache> Create();
     static std::shared_ptr<MultiLevelTileCache> Create(const std::vector<TileCachePtr>& caches);
     
@@ -61,8 +76,7 @@ private:
     struct Impl;
     std::unique_ptr<Impl> impl_;
     
-    void PromoteTile(const TileKey& key, const TileData& tile, size_t fromLevel) const;
-    void WriteToHigherLevels(const TileKey& key, const TileData& tile, size_t startLevel) const;
+    void PromoteTile(const TileKey& key, const TileData& tile, size_t fromLevel, uint64_t generation) const;
 };
 
 typedef std::shared_ptr<MultiLevelTileCache> MultiLevelTileCachePtr;
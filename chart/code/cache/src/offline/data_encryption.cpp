@@ -1,12 +1,31 @@
 #include "ogc/cache/offline/data_encryption.h"
 #include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
 #include <cmath>
+#include <cstdio>
 #include <random>
 #include <cstring>
 #include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef OGC_CACHE_HAVE_OPENSSL
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#endif
+
+#ifdef _WIN32
+#define seekFunc _fseeki64
+#define tellFunc _ftelli64
+#else
+#define seekFunc fseeko
+#define tellFunc ftello
+#endif
 
 namespace ogc {
 namespace cache {
@@ -16,11 +35,498 @@ static const double A = 6378245.0;
 static const double EE = 0.00669342162296594323;
 static const double X_PI = PI * 3000.0 / 180.0;
 
+namespace {
+
+// Sealed layout per algorithm:
+//   GCM: 12-byte nonce | ciphertext | 16-byte tag
+//   CTR: 16-byte IV    | ciphertext | 32-byte HMAC-SHA256 over IV and ciphertext
+//   CBC: 16-byte IV    | PKCS#7 padded ciphertext (not authenticated)
+const size_t kGcmNonceSize = 12;
+const size_t kGcmTagSize = 16;
+const size_t kBlockSize = 16;
+const size_t kMacSize = 32;
+const size_t kKeySize = 32;
+const size_t kStreamChunkSize = 1 << 20;
+
+size_t HeaderSize(EncryptionAlgorithm algorithm) {
+    return algorithm == EncryptionAlgorithm::kAES256_GCM ? kGcmNonceSize : kBlockSize;
+}
+
+size_t TrailerSize(EncryptionAlgorithm algorithm) {
+    switch (algorithm) {
+        case EncryptionAlgorithm::kAES256_GCM:
+            return kGcmTagSize;
+        case EncryptionAlgorithm::kAES256_CTR:
+            return kMacSize;
+        default:
+            return 0;
+    }
+}
+
+size_t SealedSize(EncryptionAlgorithm algorithm, size_t plainSize) {
+    if (algorithm == EncryptionAlgorithm::kAES256_CBC) {
+        return kBlockSize + (plainSize / kBlockSize + 1) * kBlockSize;
+    }
+    return HeaderSize(algorithm) + plainSize + TrailerSize(algorithm);
+}
+
+bool FillRandom(uint8_t* buffer, size_t size) {
+#ifdef OGC_CACHE_HAVE_OPENSSL
+    return RAND_bytes(buffer, static_cast<int>(size)) == 1;
+#else
+    std::random_device rd;
+    std::uniform_int_distribution<int> dis(0, 255);
+    for (size_t i = 0; i < size; ++i) {
+        buffer[i] = static_cast<uint8_t>(dis(rd));
+    }
+    return true;
+#endif
+}
+
+#ifdef OGC_CACHE_HAVE_OPENSSL
+
+const EVP_CIPHER* CipherFor(EncryptionAlgorithm algorithm) {
+    switch (algorithm) {
+        case EncryptionAlgorithm::kAES256_GCM:
+            return EVP_aes_256_gcm();
+        case EncryptionAlgorithm::kAES256_CTR:
+            return EVP_aes_256_ctr();
+        default:
+            return EVP_aes_256_cbc();
+    }
+}
+
+// OpenSSL selects the AES-NI/PCLMULQDQ (or ARMv8 crypto) code at runtime.
+// Each thread keeps one context per direction and only re-expands the key
+// when it changes, so sealing many tiles with one key costs a nonce reset.
+class CipherContext {
+public:
+    CipherContext()
+        : m_ctx(EVP_CIPHER_CTX_new()), m_cipher(nullptr), m_encrypt(false), m_keyed(false) {
+        memset(m_key, 0, sizeof(m_key));
+    }
+    
+    ~CipherContext() {
+        EVP_CIPHER_CTX_free(m_ctx);
+        OPENSSL_cleanse(m_key, sizeof(m_key));
+    }
+    
+    EVP_CIPHER_CTX* Get() const {
+        return m_ctx;
+    }
+    
+    bool Begin(const EVP_CIPHER* cipher, bool encrypt, const uint8_t* key, const uint8_t* iv) {
+        if (!m_ctx) {
+            return false;
+        }
+        if (m_keyed && cipher == m_cipher && encrypt == m_encrypt &&
+            CRYPTO_memcmp(key, m_key, kKeySize) == 0) {
+            return EVP_CipherInit_ex(m_ctx, nullptr, nullptr, nullptr, iv, -1) == 1;
+        }
+        m_keyed = false;
+        if (EVP_CipherInit_ex(m_ctx, cipher, nullptr, key, iv, encrypt ? 1 : 0) != 1) {
+            return false;
+        }
+        memcpy(m_key, key, kKeySize);
+        m_cipher = cipher;
+        m_encrypt = encrypt;
+        m_keyed = true;
+        return true;
+    }
+    
+private:
+    CipherContext(const CipherContext&);
+    CipherContext& operator=(const CipherContext&);
+    
+    EVP_CIPHER_CTX* m_ctx;
+    const EVP_CIPHER* m_cipher;
+    bool m_encrypt;
+    bool m_keyed;
+    uint8_t m_key[kKeySize];
+};
+
+CipherContext& ThreadContext(bool encrypt) {
+    static thread_local CipherContext encryptContext;
+    static thread_local CipherContext decryptContext;
+    return encrypt ? encryptContext : decryptContext;
+}
+
+// Incremental HMAC-SHA256 for streamed CTR files.
+class StreamMac {
+public:
+    explicit StreamMac(const uint8_t* key)
+        : m_ctx(EVP_MD_CTX_new())
+        , m_key(EVP_PKEY_new_raw_private_key(EVP_PKEY_HMAC, nullptr, key, kKeySize))
+        , m_ok(m_ctx && m_key &&
+               EVP_DigestSignInit(m_ctx, nullptr, EVP_sha256(), nullptr, m_key) == 1) {
+    }
+    
+    ~StreamMac() {
+        EVP_MD_CTX_free(m_ctx);
+        EVP_PKEY_free(m_key);
+    }
+    
+    void Update(const uint8_t* data, size_t size) {
+        m_ok = m_ok && EVP_DigestSignUpdate(m_ctx, data, size) == 1;
+    }
+    
+    bool Final(uint8_t* mac) {
+        size_t size = kMacSize;
+        return m_ok && EVP_DigestSignFinal(m_ctx, mac, &size) == 1 && size == kMacSize;
+    }
+    
+private:
+    StreamMac(const StreamMac&);
+    StreamMac& operator=(const StreamMac&);
+    
+    EVP_MD_CTX* m_ctx;
+    EVP_PKEY* m_key;
+    bool m_ok;
+};
+
+// CTR mode encrypts and authenticates with separate subkeys derived from the
+// stored key.
+struct CtrKeys {
+    uint8_t enc[kKeySize];
+    uint8_t mac[kKeySize];
+    
+    CtrKeys() {}
+    ~CtrKeys() {
+        OPENSSL_cleanse(enc, sizeof(enc));
+        OPENSSL_cleanse(mac, sizeof(mac));
+    }
+    
+    bool Derive(const uint8_t* key) {
+        static const char kEncLabel[] = "ogc-cache aes-256-ctr encryption";
+        static const char kMacLabel[] = "ogc-cache aes-256-ctr authentication";
+        unsigned int size = 0;
+        return HMAC(EVP_sha256(), key, kKeySize,
+                    reinterpret_cast<const uint8_t*>(kEncLabel), sizeof(kEncLabel) - 1,
+                    enc, &size) != nullptr &&
+               HMAC(EVP_sha256(), key, kKeySize,
+                    reinterpret_cast<const uint8_t*>(kMacLabel), sizeof(kMacLabel) - 1,
+                    mac, &size) != nullptr;
+    }
+};
+
+// EVP works on int lengths. Whole tiles go through in one call, which keeps
+// exact in-place operation valid for CBC as well.
+bool CipherUpdate(EVP_CIPHER_CTX* ctx, uint8_t* out, const uint8_t* in,
+                  size_t size, size_t* written) {
+    const size_t kMaxUpdate = 0x7FFFFFF0;
+    *written = 0;
+    while (size > 0) {
+        size_t chunk = std::min(size, kMaxUpdate);
+        int len = 0;
+        if (EVP_CipherUpdate(ctx, out + *written, &len, in, static_cast<int>(chunk)) != 1) {
+            return false;
+        }
+        *written += static_cast<size_t>(len);
+        in += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+// Writes the sealed form of plain into record, which must hold
+// SealedSize(algorithm, size) bytes. plain may alias record + header.
+bool SealRecord(const EncryptionKey& key, EncryptionAlgorithm algorithm,
+                uint8_t* record, const uint8_t* plain, size_t size) {
+    size_t header = HeaderSize(algorithm);
+    if (!FillRandom(record, header)) {
+        return false;
+    }
+    
+    CipherContext& context = ThreadContext(true);
+    EVP_CIPHER_CTX* ctx = context.Get();
+    CtrKeys ctrKeys;
+    const uint8_t* cipherKey = key.key.data();
+    if (algorithm == EncryptionAlgorithm::kAES256_CTR) {
+        if (!ctrKeys.Derive(cipherKey)) {
+            return false;
+        }
+        cipherKey = ctrKeys.enc;
+    }
+    
+    size_t written = 0;
+    int finalLen = 0;
+    if (!context.Begin(CipherFor(algorithm), true, cipherKey, record) ||
+        !CipherUpdate(ctx, record + header, plain, size, &written) ||
+        EVP_CipherFinal_ex(ctx, record + header + written, &finalLen) != 1) {
+        return false;
+    }
+    size_t cipherSize = written + static_cast<size_t>(finalLen);
+    
+    if (algorithm == EncryptionAlgorithm::kAES256_GCM) {
+        return EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, static_cast<int>(kGcmTagSize),
+                                   record + header + cipherSize) == 1;
+    }
+    if (algorithm == EncryptionAlgorithm::kAES256_CTR) {
+        unsigned int macSize = 0;
+        return HMAC(EVP_sha256(), ctrKeys.mac, kKeySize, record, header + cipherSize,
+                    record + header + cipherSize, &macSize) != nullptr;
+    }
+    return true;
+}
+
+// Authenticates and decrypts a sealed record into out, which must hold
+// size bytes. out may alias record + header.
+bool OpenRecord(const EncryptionKey& key, EncryptionAlgorithm algorithm,
+                const uint8_t* record, size_t size, uint8_t* out, size_t* outSize) {
+    size_t header = HeaderSize(algorithm);
+    size_t trailer = TrailerSize(algorithm);
+    if (size < header + trailer) {
+        return false;
+    }
+    size_t cipherSize = size - header - trailer;
+    if (algorithm == EncryptionAlgorithm::kAES256_CBC &&
+        (cipherSize == 0 || cipherSize % kBlockSize != 0)) {
+        return false;
+    }
+    
+    CipherContext& context = ThreadContext(false);
+    EVP_CIPHER_CTX* ctx = context.Get();
+    CtrKeys ctrKeys;
+    const uint8_t* cipherKey = key.key.data();
+    if (algorithm == EncryptionAlgorithm::kAES256_CTR) {
+        uint8_t mac[kMacSize];
+        unsigned int macSize = 0;
+        if (!ctrKeys.Derive(cipherKey) ||
+            HMAC(EVP_sha256(), ctrKeys.mac, kKeySize, record, header + cipherSize,
+                 mac, &macSize) == nullptr ||
+            CRYPTO_memcmp(mac, record + header + cipherSize, kMacSize) != 0) {
+            return false;
+        }
+        cipherKey = ctrKeys.enc;
+    }
+    
+    if (!context.Begin(CipherFor(algorithm), false, cipherKey, record)) {
+        return false;
+    }
+    if (algorithm == EncryptionAlgorithm::kAES256_GCM) {
+        uint8_t tag[kGcmTagSize];
+        memcpy(tag, record + header + cipherSize, kGcmTagSize);
+        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+                                static_cast<int>(kGcmTagSize), tag) != 1) {
+            return false;
+        }
+    }
+    
+    size_t written = 0;
+    int finalLen = 0;
+    if (!CipherUpdate(ctx, out, record + header, cipherSize, &written) ||
+        EVP_CipherFinal_ex(ctx, out + written, &finalLen) != 1) {
+        return false;
+    }
+    *outSize = written + static_cast<size_t>(finalLen);
+    return true;
+}
+
+bool SealStream(const EncryptionKey& key, EncryptionAlgorithm algorithm,
+                FILE* input, FILE* output) {
+    uint8_t header[kBlockSize];
+    size_t headerSize = HeaderSize(algorithm);
+    if (!FillRandom(header, headerSize) ||
+        fwrite(header, 1, headerSize, output) != headerSize) {
+        return false;
+    }
+    
+    CipherContext& context = ThreadContext(true);
+    EVP_CIPHER_CTX* ctx = context.Get();
+    CtrKeys ctrKeys;
+    const uint8_t* cipherKey = key.key.data();
+    std::unique_ptr<StreamMac> mac;
+    if (algorithm == EncryptionAlgorithm::kAES256_CTR) {
+        if (!ctrKeys.Derive(cipherKey)) {
+            return false;
+        }
+        cipherKey = ctrKeys.enc;
+        mac.reset(new StreamMac(ctrKeys.mac));
+        mac->Update(header, headerSize);
+    }
+    if (!context.Begin(CipherFor(algorithm), true, cipherKey, header)) {
+        return false;
+    }
+    
+    std::vector<uint8_t> in(kStreamChunkSize);
+    std::vector<uint8_t> out(kStreamChunkSize + kBlockSize);
+    size_t read = 0;
+    while ((read = fread(in.data(), 1, in.size(), input)) > 0) {
+        size_t written = 0;
+        if (!CipherUpdate(ctx, out.data(), in.data(), read, &written) ||
+            fwrite(out.data(), 1, written, output) != written) {
+            return false;
+        }
+        if (mac) {
+            mac->Update(out.data(), written);
+        }
+    }
+    if (ferror(input)) {
+        return false;
+    }
+    
+    int finalLen = 0;
+    if (EVP_CipherFinal_ex(ctx, out.data(), &finalLen) != 1 ||
+        fwrite(out.data(), 1, static_cast<size_t>(finalLen), output) !=
+            static_cast<size_t>(finalLen)) {
+        return false;
+    }
+    
+    uint8_t trailer[kMacSize];
+    if (algorithm == EncryptionAlgorithm::kAES256_GCM) {
+        if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG,
+                                static_cast<int>(kGcmTagSize), trailer) != 1) {
+            return false;
+        }
+    } else if (mac) {
+        mac->Update(out.data(), static_cast<size_t>(finalLen));
+        if (!mac->Final(trailer)) {
+            return false;
+        }
+    }
+    size_t trailerSize = TrailerSize(algorithm);
+    return fwrite(trailer, 1, trailerSize, output) == trailerSize;
+}
+
+bool OpenStream(const EncryptionKey& key, EncryptionAlgorithm algorithm,
+                FILE* input, FILE* output) {
+    if (seekFunc(input, 0, SEEK_END) != 0) {
+        return false;
+    }
+    int64_t fileSize = tellFunc(input);
+    size_t headerSize = HeaderSize(algorithm);
+    size_t trailerSize = TrailerSize(algorithm);
+    if (fileSize < static_cast<int64_t>(headerSize + trailerSize)) {
+        return false;
+    }
+    uint64_t cipherSize = static_cast<uint64_t>(fileSize) - headerSize - trailerSize;
+    if (algorithm == EncryptionAlgorithm::kAES256_CBC &&
+        (cipherSize == 0 || cipherSize % kBlockSize != 0)) {
+        return false;
+    }
+    
+    uint8_t header[kBlockSize];
+    uint8_t trailer[kMacSize];
+    if (seekFunc(input, static_cast<int64_t>(headerSize + cipherSize), SEEK_SET) != 0 ||
+        fread(trailer, 1, trailerSize, input) != trailerSize ||
+        seekFunc(input, 0, SEEK_SET) != 0 ||
+        fread(header, 1, headerSize, input) != headerSize) {
+        return false;
+    }
+    
+    CipherContext& context = ThreadContext(false);
+    EVP_CIPHER_CTX* ctx = context.Get();
+    CtrKeys ctrKeys;
+    const uint8_t* cipherKey = key.key.data();
+    std::unique_ptr<StreamMac> mac;
+    if (algorithm == EncryptionAlgorithm::kAES256_CTR) {
+        if (!ctrKeys.Derive(cipherKey)) {
+            return false;
+        }
+        cipherKey = ctrKeys.enc;
+        mac.reset(new StreamMac(ctrKeys.mac));
+        mac->Update(header, headerSize);
+    }
+    if (!context.Begin(CipherFor(algorithm), false, cipherKey, header)) {
+        return false;
+    }
+    if (algorithm == EncryptionAlgorithm::kAES256_GCM &&
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG,
+                            static_cast<int>(kGcmTagSize), trailer) != 1) {
+        return false;
+    }
+    
+    std::vector<uint8_t> in(kStreamChunkSize);
+    std::vector<uint8_t> out(kStreamChunkSize + kBlockSize);
+    uint64_t remaining = cipherSize;
+    while (remaining > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+        size_t written = 0;
+        if (fread(in.data(), 1, chunk, input) != chunk) {
+            return false;
+        }
+        if (mac) {
+            mac->Update(in.data(), chunk);
+        }
+        if (!CipherUpdate(ctx, out.data(), in.data(), chunk, &written) ||
+            fwrite(out.data(), 1, written, output) != written) {
+            return false;
+        }
+        remaining -= chunk;
+    }
+    
+    int finalLen = 0;
+    if (EVP_CipherFinal_ex(ctx, out.data(), &finalLen) != 1 ||
+        fwrite(out.data(), 1, static_cast<size_t>(finalLen), output) !=
+            static_cast<size_t>(finalLen)) {
+        return false;
+    }
+    if (mac) {
+        uint8_t computed[kMacSize];
+        return mac->Final(computed) && CRYPTO_memcmp(computed, trailer, kMacSize) == 0;
+    }
+    return true;
+}
+
+#else
+
+bool SealRecord(const EncryptionKey&, EncryptionAlgorithm, uint8_t*, const uint8_t*, size_t) {
+    return false;
+}
+
+bool OpenRecord(const EncryptionKey&, EncryptionAlgorithm, const uint8_t*, size_t,
+                uint8_t*, size_t*) {
+    return false;
+}
+
+bool SealStream(const EncryptionKey&, EncryptionAlgorithm, FILE*, FILE*) {
+    return false;
+}
+
+bool OpenStream(const EncryptionKey&, EncryptionAlgorithm, FILE*, FILE*) {
+    return false;
+}
+
+#endif
+
+bool SealInPlace(std::vector<uint8_t>& data, const EncryptionKey& key,
+                 EncryptionAlgorithm algorithm) {
+    size_t size = data.size();
+    if (size == 0 || !key.IsValid()) {
+        return false;
+    }
+    size_t header = HeaderSize(algorithm);
+    data.resize(SealedSize(algorithm, size));
+    memmove(data.data() + header, data.data(), size);
+    if (!SealRecord(key, algorithm, data.data(), data.data() + header, size)) {
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool OpenInPlace(std::vector<uint8_t>& data, const EncryptionKey& key,
+                 EncryptionAlgorithm algorithm) {
+    size_t header = HeaderSize(algorithm);
+    size_t size = 0;
+    if (data.size() < header || !key.IsValid() ||
+        !OpenRecord(key, algorithm, data.data(), data.size(), data.data() + header, &size)) {
+        data.clear();
+        return false;
+    }
+    memmove(data.data(), data.data() + header, size);
+    data.resize(size);
+    return true;
+}
+
+}
+
 class DataEncryptionImpl : public DataEncryption {
 public:
     DataEncryptionImpl()
         : m_initialized(false)
-        , m_algorithm(EncryptionAlgorithm::kAES256_CBC)
+        , m_algorithm(EncryptionAlgorithm::kAES256_GCM)
+        , m_activeKey(std::make_shared<EncryptionKey>())
         , m_coordTransformEnabled(false)
         , m_defaultTransformType(CoordinateTransformType::kWGS84)
     {
@@ -36,7 +542,7 @@ public:
         }
         
         m_keyStoragePath = keyStoragePath;
-        m_activeKey = GenerateKey();
+        SetActiveKey(GenerateKey());
         
         m_initialized = true;
         return true;
@@ -44,7 +550,10 @@ public:
     
     void Shutdown() override {
         m_initialized = false;
-        m_activeKey = EncryptionKey();
+        {
+            std::lock_guard<std::mutex> lock(m_keyMutex);
+            m_activeKey = std::make_shared<EncryptionKey>();
+        }
         m_storedKeys.clear();
     }
     
@@ -56,20 +565,11 @@ public:
     EncryptionKey GenerateKey(const std::string& keyId) override {
         EncryptionKey key;
         key.keyId = keyId;
-        key.key.resize(32);
-        key.iv.resize(16);
-        
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<int> dis(0, 255);
-        
-        for (size_t i = 0; i < key.key.size(); ++i) {
-            key.key[i] = static_cast<uint8_t>(dis(gen));
-        }
+        key.key.resize(kKeySize);
+        key.iv.resize(kBlockSize);
         
-        for (size_t i = 0; i < key.iv.size(); ++i) {
-            key.iv[i] = static_cast<uint8_t>(dis(gen));
-        }
+        FillRandom(key.key.data(), key.key.size());
+        FillRandom(key.iv.data(), key.iv.size());
         
         key.createdAt = std::chrono::system_clock::now();
         key.expiresAt = key.createdAt + std::chrono::hours(24 * 365);
@@ -82,12 +582,14 @@ public:
             return false;
         }
         
-        m_activeKey = key;
+        std::lock_guard<std::mutex> lock(m_keyMutex);
+        m_activeKey = std::make_shared<EncryptionKey>(key);
         return true;
     }
     
     EncryptionKey GetActiveKey() const override {
-        return m_activeKey;
+        std::lock_guard<std::mutex> lock(m_keyMutex);
+        return *m_activeKey;
     }
     
     bool StoreKey(const EncryptionKey& key, const std::string& password) override {
@@ -121,12 +623,15 @@ public:
     }
     
     std::vector<uint8_t> Encrypt(const std::vector<uint8_t>& data) override {
-        return Encrypt(data, m_activeKey, m_algorithm);
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        return Encrypt(data, *key, algorithm);
     }
     
     std::vector<uint8_t> Encrypt(const std::vector<uint8_t>& data,
                                   const EncryptionKey& key) override {
-        return Encrypt(data, key, m_algorithm);
+        return Encrypt(data, key, GetAlgorithm());
     }
     
     std::vector<uint8_t> Encrypt(const std::vector<uint8_t>& data,
@@ -136,135 +641,74 @@ public:
             return std::vector<uint8_t>();
         }
         
-        std::vector<uint8_t> result;
-        
-        size_t blockSize = 16;
-        size_t paddingSize = blockSize - (data.size() % blockSize);
-        
-        result.reserve(data.size() + paddingSize + 16);
-        
-        for (size_t i = 0; i < 16; ++i) {
-            result.push_back(key.iv[i % key.iv.size()]);
-        }
-        
-        for (size_t i = 0; i < data.size(); ++i) {
-            uint8_t dataByte = data[i];
-            uint8_t keyByte = key.key[i % key.key.size()];
-            uint8_t ivByte = key.iv[i % key.iv.size()];
-            
-            uint8_t encrypted = dataByte ^ keyByte ^ ivByte;
-            result.push_back(encrypted);
-        }
-        
-        for (size_t i = 0; i < paddingSize; ++i) {
-            uint8_t paddingByte = static_cast<uint8_t>(paddingSize);
-            uint8_t keyByte = key.key[(data.size() + i) % key.key.size()];
-            uint8_t ivByte = key.iv[(data.size() + i) % key.iv.size()];
-            
-            uint8_t encrypted = paddingByte ^ keyByte ^ ivByte;
-            result.push_back(encrypted);
+        std::vector<uint8_t> result(SealedSize(algorithm, data.size()));
+        if (!SealRecord(key, algorithm, result.data(), data.data(), data.size())) {
+            return std::vector<uint8_t>();
         }
-        
         return result;
     }
     
     std::vector<uint8_t> Decrypt(const std::vector<uint8_t>& encryptedData) override {
-        return Decrypt(encryptedData, m_activeKey, m_algorithm);
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        return Decrypt(encryptedData, *key, algorithm);
     }
     
     std::vector<uint8_t> Decrypt(const std::vector<uint8_t>& encryptedData,
                                   const EncryptionKey& key) override {
-        return Decrypt(encryptedData, key, m_algorithm);
+        return Decrypt(encryptedData, key, GetAlgorithm());
     }
     
     std::vector<uint8_t> Decrypt(const std::vector<uint8_t>& encryptedData,
                                   const EncryptionKey& key,
                                   EncryptionAlgorithm algorithm) override {
-        if (!m_initialized || !key.IsValid() || encryptedData.size() < 32) {
+        if (!m_initialized || !key.IsValid() || encryptedData.empty()) {
             return std::vector<uint8_t>();
         }
         
-        std::vector<uint8_t> result;
-        
-        size_t dataSize = encryptedData.size() - 16;
-        result.reserve(dataSize);
-        
-        for (size_t i = 16; i < encryptedData.size(); ++i) {
-            uint8_t encryptedByte = encryptedData[i];
-            uint8_t keyByte = key.key[(i - 16) % key.key.size()];
-            uint8_t ivByte = key.iv[(i - 16) % key.iv.size()];
-            
-            uint8_t decrypted = encryptedByte ^ keyByte ^ ivByte;
-            result.push_back(decrypted);
-        }
-        
-        if (!result.empty()) {
-            uint8_t padding = result.back();
-            if (padding > 0 && padding <= 16 && result.size() >= static_cast<size_t>(padding)) {
-                bool validPadding = true;
-                for (size_t i = result.size() - padding; i < result.size(); ++i) {
-                    if (result[i] != padding) {
-                        validPadding = false;
-                        break;
-                    }
-                }
-                if (validPadding) {
-                    result.resize(result.size() - padding);
-                }
-            }
+        std::vector<uint8_t> result(encryptedData.size());
+        size_t size = 0;
+        if (!OpenRecord(key, algorithm, encryptedData.data(), encryptedData.size(),
+                        result.data(), &size)) {
+            return std::vector<uint8_t>();
         }
-        
+        result.resize(size);
         return result;
     }
     
+    bool EncryptInPlace(std::vector<uint8_t>& data) override {
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        return m_initialized && SealInPlace(data, *key, algorithm);
+    }
+    
+    bool DecryptInPlace(std::vector<uint8_t>& data) override {
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        return m_initialized && OpenInPlace(data, *key, algorithm);
+    }
+    
+    bool EncryptBatch(std::vector<std::vector<uint8_t>>& items,
+                      int threadCount) override {
+        return RunBatch(items, threadCount, SealInPlace);
+    }
+    
+    bool DecryptBatch(std::vector<std::vector<uint8_t>>& items,
+                      int threadCount) override {
+        return RunBatch(items, threadCount, OpenInPlace);
+    }
+    
     bool EncryptFile(const std::string& inputPath,
                      const std::string& outputPath) override {
-        std::ifstream inputFile(inputPath, std::ios::binary);
-        if (!inputFile) {
-            return false;
-        }
-        
-        std::vector<uint8_t> data((std::istreambuf_iterator<char>(inputFile)),
-                                  std::istreambuf_iterator<char>());
-        inputFile.close();
-        
-        std::vector<uint8_t> encrypted = Encrypt(data);
-        if (encrypted.empty() && !data.empty()) {
-            return false;
-        }
-        
-        std::ofstream outputFile(outputPath, std::ios::binary);
-        if (!outputFile) {
-            return false;
-        }
-        
-        outputFile.write(reinterpret_cast<const char*>(encrypted.data()), encrypted.size());
-        return true;
+        return RunFile(inputPath, outputPath, SealStream);
     }
     
     bool DecryptFile(const std::string& inputPath,
                      const std::string& outputPath) override {
-        std::ifstream inputFile(inputPath, std::ios::binary);
-        if (!inputFile) {
-            return false;
-        }
-        
-        std::vector<uint8_t> data((std::istreambuf_iterator<char>(inputFile)),
-                                  std::istreambuf_iterator<char>());
-        inputFile.close();
-        
-        std::vector<uint8_t> decrypted = Decrypt(data);
-        if (decrypted.empty() && !data.empty()) {
-            return false;
-        }
-        
-        std::ofstream outputFile(outputPath, std::ios::binary);
-        if (!outputFile) {
-            return false;
-        }
-        
-        outputFile.write(reinterpret_cast<const char*>(decrypted.data()), decrypted.size());
-        return true;
+        return RunFile(inputPath, outputPath, OpenStream);
     }
     
     std::string EncryptString(const std::string& text) override {
@@ -280,10 +724,12 @@ public:
     }
     
     void SetAlgorithm(EncryptionAlgorithm algorithm) override {
+        std::lock_guard<std::mutex> lock(m_keyMutex);
         m_algorithm = algorithm;
     }
     
     EncryptionAlgorithm GetAlgorithm() const override {
+        std::lock_guard<std::mutex> lock(m_keyMutex);
         return m_algorithm;
     }
     
@@ -418,14 +864,7 @@ public:
     
     std::vector<uint8_t> GenerateSalt() override {
         std::vector<uint8_t> salt(16);
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<int> dis(0, 255);
-        
-        for (size_t i = 0; i < salt.size(); ++i) {
-            salt[i] = static_cast<uint8_t>(dis(gen));
-        }
-        
+        FillRandom(salt.data(), salt.size());
         return salt;
     }
     
@@ -438,14 +877,90 @@ public:
     }
     
 private:
+    typedef bool (*BufferOperation)(std::vector<uint8_t>&, const EncryptionKey&,
+                                    EncryptionAlgorithm);
+    typedef bool (*StreamOperation)(const EncryptionKey&, EncryptionAlgorithm,
+                                    FILE*, FILE*);
+    
     bool m_initialized;
     EncryptionAlgorithm m_algorithm;
-    EncryptionKey m_activeKey;
+    std::shared_ptr<const EncryptionKey> m_activeKey;
+    mutable std::mutex m_keyMutex;
     std::map<std::string, EncryptionKey> m_storedKeys;
     std::string m_keyStoragePath;
     bool m_coordTransformEnabled;
     CoordinateTransformType m_defaultTransformType;
     
+    void Snapshot(std::shared_ptr<const EncryptionKey>& key,
+                  EncryptionAlgorithm& algorithm) const {
+        std::lock_guard<std::mutex> lock(m_keyMutex);
+        key = m_activeKey;
+        algorithm = m_algorithm;
+    }
+    
+    bool RunBatch(std::vector<std::vector<uint8_t>>& items, int threadCount,
+                  BufferOperation operation) {
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        if (!m_initialized || !key->IsValid()) {
+            return false;
+        }
+        
+        size_t workers = threadCount > 0 ? static_cast<size_t>(threadCount)
+                                         : std::thread::hardware_concurrency();
+        workers = std::max<size_t>(1, std::min(workers, items.size()));
+        
+        std::atomic<size_t> next(0);
+        std::atomic<bool> ok(true);
+        auto work = [&]() {
+            for (size_t i = next++; i < items.size(); i = next++) {
+                if (!operation(items[i], *key, algorithm)) {
+                    ok = false;
+                }
+            }
+        };
+        
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; ++i) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return ok;
+    }
+    
+    bool RunFile(const std::string& inputPath, const std::string& outputPath,
+                 StreamOperation operation) {
+        std::shared_ptr<const EncryptionKey> key;
+        EncryptionAlgorithm algorithm;
+        Snapshot(key, algorithm);
+        if (!m_initialized || !key->IsValid()) {
+            return false;
+        }
+        
+        FILE* input = fopen(inputPath.c_str(), "rb");
+        if (!input) {
+            return false;
+        }
+        FILE* output = fopen(outputPath.c_str(), "wb");
+        if (!output) {
+            fclose(input);
+            return false;
+        }
+        
+        bool ok = operation(*key, algorithm, input, output);
+        fclose(input);
+        ok = fclose(output) == 0 && ok;
+        if (!ok) {
+            // Nothing that failed authentication is left behind.
+            std::remove(outputPath.c_str());
+        }
+        return ok;
+    }
+    
     std::string GenerateKeyId() {
         auto now = std::chrono::system_clock::now();
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
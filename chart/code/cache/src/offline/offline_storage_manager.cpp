@@ -1,18 +1,19 @@
 #include "ogc/cache/offline/offline_storage_manager.h"
+#include "ogc/cache/offline/region_downloader.h"
+#include "ogc/cache/offline/tile_blob_store.h"
 #include <algorithm>
-#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <iterator>
 #include <ctime>
 #include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <sys/stat.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
 #ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -135,6 +136,46 @@ size_t GetDirectorySize(const std::string& path) {
     return size;
 }
 
+std::vector<std::string> ListDirectory(const std::string& path) {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    std::string searchPath = path + "\\*";
+    HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
+    
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (strcmp(findData.cFileName, ".") != 0 && 
+                strcmp(findData.cFileName, "..") != 0) {
+                names.push_back(findData.cFileName);
+            }
+        } while (FindNextFileA(hFind, &findData));
+        FindClose(hFind);
+    }
+#else
+    DIR* dir = opendir(path.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    return names;
+}
+
+bool ParseTileCoordinate(const std::string& text, int& value) {
+    if (text.empty() || text.size() > 9 ||
+        text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoi(text);
+    return true;
+}
+
 void DeleteDirectoryRecursive(const std::string& path) {
 #ifdef _WIN32
     WIN32_FIND_DATAA findData;
@@ -216,7 +257,14 @@ public:
             return false;
         }
         
+        m_store.reset(new TileBlobStore(m_tilesPath));
+        if (!m_store->Open()) {
+            m_store.reset();
+            return false;
+        }
+        
         LoadRegions();
+        ImportLegacyTiles();
         m_initialized = true;
         return true;
     }
@@ -226,7 +274,21 @@ public:
             return;
         }
         
+        std::map<std::string, std::shared_ptr<RegionDownloader>> downloads;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            downloads.swap(m_downloads);
+        }
+        for (auto& pair : downloads) {
+            pair.second->Stop();
+        }
+        
+        // Completion callbacks still use this manager; they must not shut it down.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_completionDone.wait(lock, [this]() { return m_completing.empty(); });
         m_regions.clear();
+        m_downloadCallbacks.clear();
+        m_store->Close();
         m_initialized = false;
     }
     
@@ -252,8 +314,11 @@ public:
         region.isDownloading = false;
         region.downloadProgress = 0.0;
         
-        m_regions[id] = region;
-        SaveRegion(region);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_regions[id] = region;
+            SaveRegion(region);
+        }
         
         if (m_regionChangedCallback) {
             m_regionChangedCallback(region);
@@ -263,13 +328,16 @@ public:
     }
     
     bool DeleteRegion(const std::string& regionId) override {
+        StopDownload(regionId);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it == m_regions.end()) {
             return false;
         }
         
-        std::string regionPath = JoinPath(m_tilesPath, regionId);
-        DeleteDirectoryRecursive(regionPath);
+        m_store->RemoveRegion(regionId);
+        m_store->Flush();
         
         std::string metaPath = JoinPath(m_regionsPath, regionId + ".json");
 #ifdef _WIN32
@@ -277,31 +345,39 @@ public:
 #else
         unlink(metaPath.c_str());
 #endif
+        std::remove(GetJournalPath(regionId).c_str());
         
         m_regions.erase(it);
+        m_downloadCallbacks.erase(regionId);
         return true;
     }
     
     bool UpdateRegion(const std::string& regionId,
                       const OfflineRegion& updates) override {
-        auto it = m_regions.find(regionId);
-        if (it == m_regions.end()) {
-            return false;
+        OfflineRegion region;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_regions.find(regionId);
+            if (it == m_regions.end()) {
+                return false;
+            }
+            
+            it->second.name = updates.name;
+            it->second.updatedAt = FormatTime();
+            
+            SaveRegion(it->second);
+            region = it->second;
         }
         
-        it->second.name = updates.name;
-        it->second.updatedAt = FormatTime();
-        
-        SaveRegion(it->second);
-        
         if (m_regionChangedCallback) {
-            m_regionChangedCallback(it->second);
+            m_regionChangedCallback(region);
         }
         
         return true;
     }
     
     OfflineRegion GetRegion(const std::string& regionId) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it != m_regions.end()) {
             return it->second;
@@ -311,6 +387,7 @@ public:
     
     std::vector<OfflineRegion> GetAllRegions() const override {
         std::vector<OfflineRegion> result;
+        std::lock_guard<std::mutex> lock(m_mutex);
         for (const auto& pair : m_regions) {
             result.push_back(pair.second);
         }
@@ -318,48 +395,123 @@ public:
     }
     
     bool HasRegion(const std::string& regionId) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         return m_regions.find(regionId) != m_regions.end();
     }
     
     size_t GetRegionCount() const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         return m_regions.size();
     }
     
     void StartDownload(const std::string& regionId,
                        ProgressCallback progressCallback,
                        CompletionCallback completionCallback) override {
-        auto it = m_regions.find(regionId);
-        if (it == m_regions.end()) {
+        StopDownload(regionId);
+        
+        OfflineRegion region;
+        TileSourcePtr source;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_regions.find(regionId);
+            if (it != m_regions.end()) {
+                it->second.isDownloading = true;
+                it->second.downloadProgress = 0.0;
+                region = it->second;
+                source = m_tileSource;
+                m_downloadCallbacks[regionId] = std::make_pair(progressCallback, completionCallback);
+            }
+        }
+        if (region.id.empty()) {
             if (completionCallback) {
                 completionCallback(StorageError::kRegionNotFound);
             }
             return;
         }
         
-        it->second.isDownloading = true;
-        it->second.downloadProgress = 0.0;
-        
-        DownloadProgress progress;
-        progress.regionId = regionId;
-        progress.totalTiles = CalculateTileCount(
-            it->second.minLon, it->second.maxLon,
-            it->second.minLat, it->second.maxLat,
-            it->second.minZoom, it->second.maxZoom);
-        progress.downloadedTiles = 0;
-        progress.failedTiles = 0;
-        progress.progress = 0.0;
-        progress.status = "Started";
-        
-        if (progressCallback) {
-            progressCallback(progress);
+        if (!source) {
+            DownloadProgress progress;
+            progress.regionId = regionId;
+            progress.totalTiles = CalculateTileCount(
+                region.minLon, region.maxLon,
+                region.minLat, region.maxLat,
+                region.minZoom, region.maxZoom);
+            progress.status = "No tile source";
+            
+            if (progressCallback) {
+                progressCallback(progress);
+            }
+            
+            if (completionCallback) {
+                completionCallback(StorageError::kNone);
+            }
+            return;
         }
         
-        if (completionCallback) {
-            completionCallback(StorageError::kNone);
-        }
+        DownloadOptions options;
+        options.maxConcurrent = m_maxConcurrentDownloads;
+        options.timeoutSeconds = m_downloadTimeout;
+        options.retryCount = m_retryCount;
+        
+        std::shared_ptr<RegionDownloader> downloader = std::make_shared<RegionDownloader>(
+            region, source, GetJournalPath(regionId), options,
+            [this, regionId](const TileKey& key) { return HasTile(regionId, key); },
+            [this, regionId](const std::vector<DownloadedTile>& tiles) {
+                return StoreTiles(regionId, tiles);
+            });
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_downloads[regionId] = downloader;
+        }
+        std::weak_ptr<RegionDownloader> weakDownloader = downloader;
+        
+        downloader->Start(
+            [this, regionId, progressCallback](const DownloadProgress& progress) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto it = m_regions.find(regionId);
+                    if (it != m_regions.end()) {
+                        it->second.downloadProgress = progress.progress;
+                    }
+                }
+                if (progressCallback) {
+                    progressCallback(progress);
+                }
+            },
+            [this, regionId, completionCallback, weakDownloader](StorageError error) {
+                // The finished downloader is dropped before the callback, which
+                // may start this region again, and released outside the lock.
+                std::shared_ptr<RegionDownloader> finished;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto it = m_regions.find(regionId);
+                    if (it != m_regions.end()) {
+                        it->second.isDownloading = false;
+                    }
+                    auto download = m_downloads.find(regionId);
+                    if (download != m_downloads.end() &&
+                        download->second == weakDownloader.lock()) {
+                        finished.swap(download->second);
+                        m_downloads.erase(download);
+                    }
+                    ++m_completing[regionId];
+                }
+                finished.reset();
+                if (completionCallback) {
+                    completionCallback(error);
+                }
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_completing[regionId] == 0) {
+                    m_completing.erase(regionId);
+                }
+                m_completionDone.notify_all();
+            });
     }
     
     void PauseDownload(const std::string& regionId) override {
+        StopDownload(regionId);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it != m_regions.end()) {
             it->second.isDownloading = false;
@@ -367,26 +519,79 @@ public:
     }
     
     void ResumeDownload(const std::string& regionId) override {
-        auto it = m_regions.find(regionId);
-        if (it != m_regions.end()) {
+        ProgressCallback progressCallback;
+        CompletionCallback completionCallback;
+        bool restart = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_regions.find(regionId);
+            if (it == m_regions.end()) {
+                return;
+            }
             it->second.isDownloading = true;
+            
+            auto callbacks = m_downloadCallbacks.find(regionId);
+            if (m_tileSource && callbacks != m_downloadCallbacks.end()) {
+                progressCallback = callbacks->second.first;
+                completionCallback = callbacks->second.second;
+                restart = true;
+            }
+        }
+        
+        if (restart) {
+            StartDownload(regionId, progressCallback, completionCallback);
         }
     }
     
     void CancelDownload(const std::string& regionId) override {
+        StopDownload(regionId);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it != m_regions.end()) {
             it->second.isDownloading = false;
             it->second.downloadProgress = 0.0;
         }
+        m_downloadCallbacks.erase(regionId);
+    }
+    
+    bool WaitForDownload(const std::string& regionId, int timeoutMs) override {
+        std::shared_ptr<RegionDownloader> downloader;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto it = m_downloads.find(regionId);
+            if (it == m_downloads.end()) {
+                // Finished, but its completion callback may still be running.
+                auto idle = [this, &regionId]() { return m_completing.count(regionId) == 0; };
+                if (timeoutMs < 0) {
+                    m_completionDone.wait(lock, idle);
+                    return true;
+                }
+                return m_completionDone.wait_for(lock, std::chrono::milliseconds(timeoutMs), idle);
+            }
+            downloader = it->second;
+        }
+        return downloader->Wait(timeoutMs);
+    }
+    
+    void SetTileSource(TileSourcePtr source) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tileSource = source;
+    }
+    
+    TileSourcePtr GetTileSource() const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tileSource;
     }
     
     bool IsDownloading(const std::string& regionId) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         return it != m_regions.end() && it->second.isDownloading;
     }
     
     double GetDownloadProgress(const std::string& regionId) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it != m_regions.end()) {
             return it->second.downloadProgress;
@@ -397,66 +602,60 @@ public:
     bool StoreTile(const std::string& regionId,
                    const TileKey& key,
                    const std::vector<uint8_t>& data) override {
+        std::vector<DownloadedTile> tiles(1);
+        tiles[0].key = key;
+        tiles[0].data = data;
+        return StoreTiles(regionId, tiles);
+    }
+    
+    bool StoreTiles(const std::string& regionId,
+                    const std::vector<DownloadedTile>& tiles) override {
         if (!m_initialized || !HasRegion(regionId)) {
             return false;
         }
         
-        std::string tilePath = GetTilePath(regionId, key);
-        std::string dirPath = tilePath.substr(0, tilePath.find_last_of("/\\"));
-        
-        CreateDirectory(dirPath);
-        
-        std::ofstream file(tilePath, std::ios::binary);
-        if (!file) {
-            return false;
+        bool ok = true;
+        for (const auto& tile : tiles) {
+            if (!m_store->Put(regionId, tile.key, tile.data)) {
+                ok = false;
+            }
         }
+        ok = m_store->Flush() && ok;
         
-        file.write(reinterpret_cast<const char*>(data.data()), data.size());
-        
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_regions.find(regionId);
         if (it != m_regions.end()) {
-            it->second.dataSize += data.size();
-            it->second.tileCount++;
-            SaveRegion(it->second);
+            UpdateRegionUsage(it->second);
         }
         
-        return true;
+        return ok;
     }
     
     bool HasTile(const std::string& regionId, const TileKey& key) const override {
-        std::string tilePath = GetTilePath(regionId, key);
-        
-        struct stat statBuf;
-        return stat(tilePath.c_str(), &statBuf) == 0;
+        return m_initialized && m_store->Has(regionId, key);
     }
     
     std::vector<uint8_t> GetTile(const std::string& regionId,
                                  const TileKey& key) const override {
         std::vector<uint8_t> data;
-        std::string tilePath = GetTilePath(regionId, key);
-        
-        std::ifstream file(tilePath, std::ios::binary | std::ios::ate);
-        if (!file) {
-            return data;
+        if (m_initialized) {
+            m_store->Get(regionId, key, data);
         }
-        
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        
-        data.resize(size);
-        file.read(reinterpret_cast<char*>(data.data()), size);
-        
         return data;
     }
     
     bool DeleteTile(const std::string& regionId, const TileKey& key) override {
-        std::string tilePath = GetTilePath(regionId, key);
+        if (!m_initialized || !m_store->Remove(regionId, key)) {
+            return false;
+        }
+        m_store->Flush();
         
-#ifdef _WIN32
-        return _unlink(tilePath.c_str()) == 0;
-#else
-        return unlink(tilePath.c_str()) == 0;
-#endif
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_regions.find(regionId);
+        if (it != m_regions.end()) {
+            UpdateRegionUsage(it->second);
+        }
+        return true;
     }
     
     StorageInfo GetStorageInfo() const override {
@@ -466,6 +665,8 @@ public:
         info.freeSpace = GetFreeSpace();
         info.cacheSize = GetDirectorySize(m_cachePath);
         info.offlineDataSize = GetDirectorySize(m_tilesPath);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
         info.regionCount = static_cast<int>(m_regions.size());
         info.tileCount = 0;
         
@@ -525,19 +726,27 @@ public:
     }
     
     void ClearAllOfflineData() override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_initialized) {
+            m_store->Clear();
+        }
         for (auto& pair : m_regions) {
-            std::string regionPath = JoinPath(m_tilesPath, pair.first);
-            DeleteDirectoryRecursive(regionPath);
             pair.second.dataSize = 0;
             pair.second.tileCount = 0;
+            SaveRegion(pair.second);
+            std::remove(GetJournalPath(pair.first).c_str());
         }
     }
     
     bool CompactStorage() override {
-        return true;
+        return m_initialized && m_store->Compact();
     }
     
     bool ValidateStorage() override {
+        if (m_initialized && !m_store->Validate()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
         for (const auto& pair : m_regions) {
             std::string metaPath = JoinPath(m_regionsPath, pair.first + ".json");
             
@@ -596,14 +805,86 @@ private:
     int m_retryCount;
     size_t m_storageLimit;
     
+    mutable std::mutex m_mutex;
     std::map<std::string, OfflineRegion> m_regions;
+    std::map<std::string, std::shared_ptr<RegionDownloader>> m_downloads;
+    std::map<std::string, int> m_completing;
+    std::condition_variable m_completionDone;
+    std::map<std::string, std::pair<ProgressCallback, CompletionCallback>> m_downloadCallbacks;
+    TileSourcePtr m_tileSource;
     RegionCallback m_regionChangedCallback;
+    std::unique_ptr<TileBlobStore> m_store;
+    
+    void StopDownload(const std::string& regionId) {
+        std::shared_ptr<RegionDownloader> downloader;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_downloads.find(regionId);
+            if (it == m_downloads.end()) {
+                return;
+            }
+            downloader = it->second;
+            m_downloads.erase(it);
+        }
+        downloader->Stop();
+    }
     
-    std::string GetTilePath(const std::string& regionId, const TileKey& key) const {
-        std::stringstream ss;
-        ss << m_tilesPath << "/" << regionId << "/" 
-           << key.z << "/" << key.x << "/" << key.y << ".tile";
-        return ss.str();
+    void UpdateRegionUsage(OfflineRegion& region) {
+        region.tileCount = m_store->GetTileCount(region.id);
+        region.dataSize = m_store->GetRegionBytes(region.id);
+        SaveRegion(region);
+    }
+    
+    std::string GetJournalPath(const std::string& regionId) const {
+        return JoinPath(m_regionsPath, regionId + ".journal");
+    }
+    
+    // Moves tiles written by older versions as tiles/<region>/z/x/y.tile
+    // files into the blob store.
+    void ImportLegacyTiles() {
+        for (auto& pair : m_regions) {
+            std::string regionPath = JoinPath(m_tilesPath, pair.first);
+            struct stat statBuf;
+            if (statFunc(regionPath.c_str(), &statBuf) != 0 ||
+                !(statBuf.st_mode & S_IFDIR)) {
+                continue;
+            }
+            
+            bool ok = true;
+            for (const auto& zName : ListDirectory(regionPath)) {
+                std::string zPath = JoinPath(regionPath, zName);
+                for (const auto& xName : ListDirectory(zPath)) {
+                    std::string xPath = JoinPath(zPath, xName);
+                    for (const auto& yName : ListDirectory(xPath)) {
+                        TileKey key;
+                        size_t dot = yName.rfind(".tile");
+                        if (dot == std::string::npos || dot + 5 != yName.size() ||
+                            !ParseTileCoordinate(zName, key.z) ||
+                            !ParseTileCoordinate(xName, key.x) ||
+                            !ParseTileCoordinate(yName.substr(0, dot), key.y)) {
+                            continue;
+                        }
+                        std::ifstream file(JoinPath(xPath, yName), std::ios::binary);
+                        if (!file) {
+                            ok = false;
+                            continue;
+                        }
+                        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                                  std::istreambuf_iterator<char>());
+                        if (!m_store->Put(pair.first, key, data)) {
+                            ok = false;
+                        }
+                    }
+                }
+            }
+            
+            // The legacy files are the only other copy, so the imported
+            // blobs must be on disk before they go.
+            if (ok && m_store->Sync()) {
+                DeleteDirectoryRecursive(regionPath);
+            }
+            UpdateRegionUsage(pair.second);
+        }
     }
     
     void LoadRegions() {
@@ -711,23 +992,13 @@ size_t OfflineStorageManager::CalculateRegionSize(double minLon, double maxLon,
 int OfflineStorageManager::CalculateTileCount(double minLon, double maxLon,
                                                double minLat, double maxLat,
                                                int minZoom, int maxZoom) {
-    long long totalTiles = 0;
+    uint64_t totalTiles = 0;
     
-    for (int z = minZoom; z <= maxZoom; ++z) {
-        long long minTileX = static_cast<long long>(std::floor((minLon + 180.0) / 360.0 * (1 << z)));
-        long long maxTileX = static_cast<long long>(std::floor((maxLon + 180.0) / 360.0 * (1 << z)));
-        long long minTileY = static_cast<long long>(std::floor((1.0 - std::log(std::tan(maxLat * M_PI / 180.0) + 
-                              1.0 / std::cos(maxLat * M_PI / 180.0)) / M_PI) / 2.0 * (1 << z)));
-        long long maxTileY = static_cast<long long>(std::floor((1.0 - std::log(std::tan(minLat * M_PI / 180.0) + 
-                              1.0 / std::cos(minLat * M_PI / 180.0)) / M_PI) / 2.0 * (1 << z)));
-        
-        long long tilesX = maxTileX - minTileX + 1;
-        long long tilesY = maxTileY - minTileY + 1;
-        
-        totalTiles += tilesX * tilesY;
+    for (const auto& range : ComputeTileRanges(minLon, maxLon, minLat, maxLat, minZoom, maxZoom)) {
+        totalTiles += range.GetCount();
     }
     
-    return static_cast<int>(totalTiles);
+    return static_cast<int>(std::min<uint64_t>(totalTiles, 0x7FFFFFFF));
 }
 
 }
@@ -0,0 +1,437 @@
+#include "ogc/cache/offline/region_downloader.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace ogc {
+namespace cache {
+
+namespace {
+
+const double kMaxMercatorLat = 85.0511287798066;
+
+int LonToTileX(double lon, int n) {
+    double x = std::floor((lon + 180.0) / 360.0 * n);
+    return static_cast<int>(std::max(0.0, std::min(x, static_cast<double>(n - 1))));
+}
+
+int LatToTileY(double lat, int n) {
+    double clamped = std::max(-kMaxMercatorLat, std::min(lat, kMaxMercatorLat));
+    double rad = clamped * M_PI / 180.0;
+    double y = std::floor((1.0 - std::log(std::tan(rad) + 1.0 / std::cos(rad)) / M_PI) / 2.0 * n);
+    return static_cast<int>(std::max(0.0, std::min(y, static_cast<double>(n - 1))));
+}
+
+typedef std::chrono::steady_clock Clock;
+
+}
+
+std::vector<TileRange> ComputeTileRanges(double minLon, double maxLon,
+                                         double minLat, double maxLat,
+                                         int minZoom, int maxZoom) {
+    std::vector<TileRange> ranges;
+    for (int z = std::max(0, minZoom); z <= std::min(maxZoom, 30); ++z) {
+        int n = 1 << z;
+        TileRange range;
+        range.z = z;
+        range.minX = LonToTileX(std::min(minLon, maxLon), n);
+        range.maxX = LonToTileX(std::max(minLon, maxLon), n);
+        range.minY = LatToTileY(std::max(minLat, maxLat), n);
+        range.maxY = LatToTileY(std::min(minLat, maxLat), n);
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+struct RegionDownloader::Impl {
+    OfflineRegion region;
+    TileSourcePtr source;
+    std::string journalPath;
+    DownloadOptions options;
+    TilePresence hasTile;
+    TileBatchWriter writeBatch;
+
+    OfflineStorageManager::ProgressCallback progressCallback;
+    OfflineStorageManager::CompletionCallback completionCallback;
+
+    std::vector<TileRange> ranges;
+    std::vector<uint64_t> rangeEnds;
+    uint64_t totalTiles;
+    std::atomic<uint64_t> nextTile;
+
+    std::unordered_map<uint64_t, std::string> journal;
+
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> skipped;
+    std::atomic<uint64_t> failed;
+    uint64_t downloaded;
+    uint64_t bytes;
+    Clock::time_point startTime;
+    Clock::time_point lastReport;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueNotEmpty;
+    std::condition_variable queueNotFull;
+    std::deque<DownloadedTile> queue;
+    size_t queueCapacity;
+    int activeFetchers;
+    std::string lastError;
+    std::string status;
+
+    std::mutex finishMutex;
+    std::condition_variable finishedCondition;
+    bool finished;
+
+    std::vector<std::thread> fetchers;
+    std::thread writer;
+
+    Impl()
+        : totalTiles(0), nextTile(0), stopRequested(false), running(false)
+        , skipped(0), failed(0), downloaded(0), bytes(0)
+        , queueCapacity(0), activeFetchers(0), finished(true) {
+    }
+
+    // The writer holds the last reference when a callback drops the downloader.
+    ~Impl() {
+        Join();
+    }
+
+    void LoadJournal() {
+        journal.clear();
+        std::ifstream file(journalPath);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t space = line.find(' ');
+            std::string keyText = line.substr(0, space);
+            if (std::count(keyText.begin(), keyText.end(), '/') != 2) {
+                continue;
+            }
+            TileKey key = TileKey::FromString(keyText);
+            journal[key.ToIndex()] = space == std::string::npos ? std::string() : line.substr(space + 1);
+        }
+    }
+
+    bool ClaimTile(TileKey& key) {
+        uint64_t index = nextTile.fetch_add(1);
+        if (index >= totalTiles) {
+            return false;
+        }
+        size_t r = static_cast<size_t>(std::upper_bound(rangeEnds.begin(), rangeEnds.end(), index) -
+                                       rangeEnds.begin());
+        const TileRange& range = ranges[r];
+        uint64_t offset = index - (r == 0 ? 0 : rangeEnds[r - 1]);
+        uint64_t height = static_cast<uint64_t>(range.maxY - range.minY + 1);
+        key.z = range.z;
+        key.x = range.minX + static_cast<int>(offset / height);
+        key.y = range.minY + static_cast<int>(offset % height);
+        return true;
+    }
+
+    bool ShouldSkip(const TileKey& key) {
+        auto it = journal.find(key.ToIndex());
+        if (it == journal.end()) {
+            return hasTile && hasTile(key);
+        }
+        // The journal outlives the cache: the tile may since have been evicted or cleared.
+        if (hasTile && !hasTile(key)) {
+            return false;
+        }
+        std::string remoteHash;
+        if (!it->second.empty() && source->GetTileHash(key, remoteHash)) {
+            return remoteHash == it->second;
+        }
+        return true;
+    }
+
+    void FetchLoop() {
+        TileKey key;
+        while (!stopRequested.load() && ClaimTile(key)) {
+            if (ShouldSkip(key)) {
+                skipped.fetch_add(1);
+                continue;
+            }
+
+            TileFetchResult result;
+            bool ok = false;
+            for (int attempt = 0; attempt <= options.retryCount && !stopRequested.load(); ++attempt) {
+                result = TileFetchResult();
+                if (source->FetchTile(key, options.timeoutSeconds, result)) {
+                    ok = true;
+                    break;
+                }
+            }
+            if (!ok) {
+                failed.fetch_add(1);
+                std::lock_guard<std::mutex> lock(queueMutex);
+                lastError = result.error.empty() ? "Failed to fetch tile " + key.ToString() : result.error;
+                continue;
+            }
+
+            DownloadedTile tile;
+            tile.key = key;
+            tile.data.swap(result.data);
+            tile.contentHash = result.contentHash.empty() ? ComputeTileHash(tile.data) : result.contentHash;
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueNotFull.wait(lock, [this]() { return queue.size() < queueCapacity; });
+            queue.push_back(std::move(tile));
+            queueNotEmpty.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (--activeFetchers == 0) {
+            queueNotEmpty.notify_one();
+        }
+    }
+
+    void WriteLoop() {
+        std::ofstream journalFile(journalPath, std::ios::app);
+        std::vector<DownloadedTile> batch;
+        std::string lines;
+
+        while (true) {
+            bool done = false;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueNotEmpty.wait(lock, [this]() { return !queue.empty() || activeFetchers == 0; });
+                size_t count = std::min(queue.size(), std::max<size_t>(1, options.writeBatchSize));
+                batch.clear();
+                for (size_t i = 0; i < count; ++i) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                done = queue.empty() && activeFetchers == 0;
+            }
+            queueNotFull.notify_all();
+
+            if (!batch.empty()) {
+                if (writeBatch && writeBatch(batch)) {
+                    lines.clear();
+                    uint64_t batchBytes = 0;
+                    for (const auto& tile : batch) {
+                        lines += tile.key.ToString() + " " + tile.contentHash + "\n";
+                        batchBytes += tile.data.size();
+                    }
+                    journalFile << lines;
+                    journalFile.flush();
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    downloaded += batch.size();
+                    bytes += batchBytes;
+                } else {
+                    failed.fetch_add(batch.size());
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    lastError = "Failed to store downloaded tiles";
+                }
+            }
+
+            if (done) {
+                break;
+            }
+            ReportProgress(false);
+        }
+
+        Finish();
+    }
+
+    void Finish() {
+        StorageError error = StorageError::kNone;
+        bool stopped = stopRequested.load();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (stopped) {
+                status = "Paused";
+            } else if (failed.load() > 0) {
+                status = "Failed";
+                error = StorageError::kDownloadFailed;
+            } else {
+                status = "Completed";
+            }
+        }
+        running.store(false);
+        ReportProgress(true);
+        OfflineStorageManager::CompletionCallback callback;
+        if (!stopped) {
+            callback = completionCallback;
+        }
+        {
+            std::lock_guard<std::mutex> lock(finishMutex);
+            finished = true;
+            finishedCondition.notify_all();
+        }
+        // May restart, stop or destroy this download; nothing is touched after it.
+        if (callback) {
+            callback(error);
+        }
+    }
+
+    DownloadProgress Snapshot() const {
+        DownloadProgress progress;
+        progress.regionId = region.id;
+        progress.totalTiles = static_cast<int>(totalTiles);
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        uint64_t skippedTiles = skipped.load();
+        uint64_t failedTiles = failed.load();
+        progress.downloadedTiles = static_cast<int>(downloaded + skippedTiles);
+        progress.skippedTiles = static_cast<int>(skippedTiles);
+        progress.failedTiles = static_cast<int>(failedTiles);
+        progress.bytesDownloaded = bytes;
+        progress.status = status;
+        progress.errorMessage = lastError;
+
+        uint64_t processed = downloaded + skippedTiles + failedTiles;
+        progress.progress = totalTiles > 0 ? static_cast<double>(processed) / totalTiles : 1.0;
+
+        double elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+        if (elapsed > 0.0) {
+            progress.tilesPerSecond = downloaded / elapsed;
+            progress.bytesPerSecond = bytes / elapsed;
+            double processedPerSecond = processed / elapsed;
+            if (processedPerSecond > 0.0 && processed < totalTiles) {
+                progress.etaSeconds = (totalTiles - processed) / processedPerSecond;
+            }
+        }
+        return progress;
+    }
+
+    void ReportProgress(bool force) {
+        if (!progressCallback) {
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        if (!force && now - lastReport < std::chrono::milliseconds(options.progressIntervalMs)) {
+            return;
+        }
+        lastReport = now;
+        progressCallback(Snapshot());
+    }
+
+    void Join() {
+        for (auto& thread : fetchers) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        fetchers.clear();
+        if (writer.joinable()) {
+            if (writer.get_id() == std::this_thread::get_id()) {
+                writer.detach();
+            } else {
+                writer.join();
+            }
+        }
+    }
+};
+
+RegionDownloader::RegionDownloader(const OfflineRegion& region,
+                                   TileSourcePtr source,
+                                   const std::string& journalPath,
+                                   const DownloadOptions& options,
+                                   TilePresence hasTile,
+                                   TileBatchWriter writeBatch)
+    : m_impl(new Impl()) {
+    m_impl->region = region;
+    m_impl->source = source;
+    m_impl->journalPath = journalPath;
+    m_impl->options = options;
+    m_impl->options.maxConcurrent = std::max(1, options.maxConcurrent);
+    m_impl->options.retryCount = std::max(0, options.retryCount);
+    m_impl->hasTile = hasTile;
+    m_impl->writeBatch = writeBatch;
+    m_impl->ranges = ComputeTileRanges(region.minLon, region.maxLon,
+                                       region.minLat, region.maxLat,
+                                       region.minZoom, region.maxZoom);
+    for (const auto& range : m_impl->ranges) {
+        m_impl->totalTiles += range.GetCount();
+        m_impl->rangeEnds.push_back(m_impl->totalTiles);
+    }
+}
+
+RegionDownloader::~RegionDownloader() {
+    Stop();
+}
+
+void RegionDownloader::Start(OfflineStorageManager::ProgressCallback progressCallback,
+                             OfflineStorageManager::CompletionCallback completionCallback) {
+    Stop();
+
+    Impl& impl = *m_impl;
+    impl.progressCallback = progressCallback;
+    impl.completionCallback = completionCallback;
+    impl.LoadJournal();
+    impl.nextTile.store(0);
+    impl.stopRequested.store(false);
+    impl.skipped.store(0);
+    impl.failed.store(0);
+    impl.downloaded = 0;
+    impl.bytes = 0;
+    impl.lastError.clear();
+    impl.status = "Started";
+    impl.queue.clear();
+    impl.queueCapacity = static_cast<size_t>(impl.options.maxConcurrent) * 4;
+    impl.activeFetchers = impl.options.maxConcurrent;
+    impl.startTime = Clock::now();
+    impl.lastReport = impl.startTime;
+    {
+        std::lock_guard<std::mutex> lock(impl.finishMutex);
+        impl.finished = false;
+    }
+    impl.running.store(true);
+
+    if (impl.progressCallback) {
+        impl.progressCallback(impl.Snapshot());
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl.queueMutex);
+        impl.status = "Downloading";
+    }
+
+    for (int i = 0; i < impl.options.maxConcurrent; ++i) {
+        impl.fetchers.emplace_back([&impl]() { impl.FetchLoop(); });
+    }
+    std::shared_ptr<Impl> self = m_impl;
+    impl.writer = std::thread([self]() { self->WriteLoop(); });
+}
+
+void RegionDownloader::Stop() {
+    m_impl->stopRequested.store(true);
+    m_impl->queueNotFull.notify_all();
+    m_impl->Join();
+}
+
+bool RegionDownloader::Wait(int timeoutMs) {
+    {
+        std::unique_lock<std::mutex> lock(m_impl->finishMutex);
+        if (timeoutMs < 0) {
+            m_impl->finishedCondition.wait(lock, [this]() { return m_impl->finished; });
+        } else if (!m_impl->finishedCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                                       [this]() { return m_impl->finished; })) {
+            return false;
+        }
+    }
+    m_impl->Join();
+    return true;
+}
+
+bool RegionDownloader::IsRunning() const {
+    return m_impl->running.load();
+}
+
+DownloadProgress RegionDownloader::GetProgress() const {
+    return m_impl->Snapshot();
+}
+
+}
+}
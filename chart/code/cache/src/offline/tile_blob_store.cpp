@@ -0,0 +1,911 @@
+#include "ogc/cache/offline/tile_blob_store.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define mkdirFunc(path) _mkdir(path)
+#define syncFunc(file) _commit(_fileno(file))
+#define seekFunc _fseeki64
+#define statFunc _stat64
+typedef struct _stat64 StatBuf;
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#define mkdirFunc(path) mkdir(path, 0755)
+#define syncFunc(file) fsync(fileno(file))
+#define seekFunc fseeko
+#define statFunc stat
+typedef struct stat StatBuf;
+#endif
+
+namespace ogc {
+namespace cache {
+
+namespace {
+
+const uint32_t kBlobMagic = 0x31425454;  // "TTB1"
+const size_t kHeaderSize = 16;
+
+uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t LoadLE64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+void StoreLE(uint8_t* p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+uint64_t LoadLE(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// 64-bit content hash. Equal hashes are confirmed by comparing bytes before
+// a blob is shared, so this only has to spread well.
+uint64_t HashBytes(const uint8_t* data, size_t size) {
+    const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = 0x84222325CBF29CE4ULL ^ (static_cast<uint64_t>(size) * kMul);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        h ^= Mix(LoadLE64(data + i));
+        h = ((h << 27) | (h >> 37)) * kMul + 0x52DCE729;
+    }
+    uint64_t tail = 0;
+    for (size_t k = size; k > i; --k) {
+        tail = (tail << 8) | data[k - 1];
+    }
+    h ^= Mix(tail ^ size);
+    return Mix(h);
+}
+
+bool IsValidRegionId(const std::string& regionId) {
+    if (regionId.empty()) {
+        return false;
+    }
+    for (char c : regionId) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string JoinPath(const std::string& a, const std::string& b) {
+    if (a.empty()) return b;
+    if (a.back() == '/' || a.back() == '\\') {
+        return a + b;
+    }
+    return a + "/" + b;
+}
+
+struct Segment {
+    uint32_t id;
+    std::string path;
+    uint64_t size;
+    uint64_t liveBytes;
+    bool retired;
+    std::mutex readMutex;
+    FILE* reader;
+
+    Segment(uint32_t segmentId, const std::string& filePath, uint64_t fileSize)
+        : id(segmentId), path(filePath), size(fileSize), liveBytes(0)
+        , retired(false), reader(nullptr) {}
+
+    ~Segment() {
+        if (reader) {
+            fclose(reader);
+        }
+        if (retired) {
+            std::remove(path.c_str());
+        }
+    }
+
+    bool Read(uint64_t offset, uint8_t* buffer, size_t size) {
+        std::lock_guard<std::mutex> lock(readMutex);
+        if (!reader) {
+            reader = fopen(path.c_str(), "rb");
+            if (!reader) {
+                return false;
+            }
+        }
+        if (seekFunc(reader, static_cast<int64_t>(offset), SEEK_SET) != 0) {
+            return false;
+        }
+        return size == 0 || fread(buffer, 1, size, reader) == size;
+    }
+};
+
+typedef std::shared_ptr<Segment> SegmentPtr;
+
+struct Blob {
+    uint64_t hash;
+    uint32_t size;
+    uint32_t refs;
+    SegmentPtr segment;
+    uint64_t offset;
+
+    Blob() : hash(0), size(0), refs(0), offset(0) {}
+};
+
+struct RegionIndex {
+    std::unordered_map<uint64_t, uint64_t> tiles;
+    uint64_t bytes;
+
+    RegionIndex() : bytes(0) {}
+};
+
+bool ReadBlob(const SegmentPtr& segment, uint64_t offset, uint32_t size,
+              std::vector<uint8_t>& data) {
+    data.resize(size);
+    return segment->Read(offset, data.data(), size);
+}
+
+}
+
+struct TileBlobStore::Impl {
+    std::string path;
+    uint64_t segmentSize;
+    std::atomic<bool> open;
+
+    // writeMutex serialises writers, compaction moves and the log, and is
+    // always taken before indexMutex. Readers only take indexMutex.
+    std::mutex writeMutex;
+    mutable std::mutex indexMutex;
+
+    std::unordered_map<uint64_t, Blob> blobs;
+    std::unordered_multimap<uint64_t, uint64_t> byHash;
+    std::map<std::string, RegionIndex> regions;
+    std::map<uint32_t, SegmentPtr> segments;
+    uint64_t nextBlobId;
+    uint32_t nextSegmentId;
+
+    SegmentPtr active;
+    FILE* writer;
+    FILE* log;
+
+    Impl(const std::string& storePath, uint64_t maxSegmentSize)
+        : path(storePath), segmentSize(maxSegmentSize), open(false)
+        , nextBlobId(1), nextSegmentId(1), writer(nullptr), log(nullptr) {}
+
+    std::string SegmentPath(uint32_t id) const {
+        char name[32];
+        snprintf(name, sizeof(name), "blobs_%06u.seg", id);
+        return JoinPath(path, name);
+    }
+
+    std::string LogPath() const {
+        return JoinPath(path, "index.log");
+    }
+
+    void LogLocked(const std::string& line) {
+        if (log) {
+            fputs(line.c_str(), log);
+            fputc('\n', log);
+        }
+    }
+
+    // Callers hold indexMutex.
+    void ReleaseLocked(uint64_t blobId) {
+        auto it = blobs.find(blobId);
+        if (it == blobs.end() || --it->second.refs > 0) {
+            return;
+        }
+        it->second.segment->liveBytes -= it->second.size;
+        auto range = byHash.equal_range(it->second.hash);
+        for (auto h = range.first; h != range.second; ++h) {
+            if (h->second == blobId) {
+                byHash.erase(h);
+                break;
+            }
+        }
+        blobs.erase(it);
+    }
+
+    void SealActiveLocked() {
+        if (writer) {
+            fflush(writer);
+            syncFunc(writer);
+            fclose(writer);
+            writer = nullptr;
+        }
+        active.reset();
+    }
+
+    // Makes the current segment and the log durable. Callers hold writeMutex.
+    bool SyncLocked() {
+        bool ok = true;
+        if (writer) {
+            ok = fflush(writer) == 0 && syncFunc(writer) == 0 && ok;
+        }
+        if (log) {
+            ok = fflush(log) == 0 && syncFunc(log) == 0 && ok;
+        }
+        return ok;
+    }
+
+    // Deletes segments that no longer hold live blobs. Their blobs may have
+    // just been copied elsewhere, so the copies and the M records pointing
+    // at them reach disk before the old files go away. Callers hold
+    // writeMutex.
+    bool RetireLocked(const std::vector<SegmentPtr>& dead) {
+        if (dead.empty()) {
+            return true;
+        }
+        if (!SyncLocked()) {
+            return false;
+        }
+        for (const SegmentPtr& segment : dead) {
+            segment->retired = true;
+        }
+        return true;
+    }
+
+    // Appends a blob record to the current segment, starting a new one when
+    // it would grow past segmentSize. Callers hold writeMutex.
+    bool AppendLocked(const uint8_t* data, uint32_t size, uint64_t hash,
+                      SegmentPtr* segment, uint64_t* offset) {
+        if (active && active->size > 0 && active->size + kHeaderSize + size > segmentSize) {
+            SealActiveLocked();
+        }
+        if (!active) {
+            uint32_t id = nextSegmentId++;
+            writer = fopen(SegmentPath(id).c_str(), "wb");
+            if (!writer) {
+                return false;
+            }
+            active = std::make_shared<Segment>(id, SegmentPath(id), 0);
+            {
+                std::lock_guard<std::mutex> lock(indexMutex);
+                segments[id] = active;
+            }
+            LogLocked("S " + std::to_string(id));
+        }
+        uint8_t header[kHeaderSize];
+        StoreLE(header, kBlobMagic, 4);
+        StoreLE(header + 4, size, 4);
+        StoreLE(header + 8, hash, 8);
+        if (fwrite(header, 1, kHeaderSize, writer) != kHeaderSize ||
+            (size > 0 && fwrite(data, 1, size, writer) != size) ||
+            fflush(writer) != 0) {
+            return false;
+        }
+        *segment = active;
+        *offset = active->size + kHeaderSize;
+        std::lock_guard<std::mutex> lock(indexMutex);
+        active->size += kHeaderSize + size;
+        return true;
+    }
+
+    // Rewrites the log as the minimal set of records for the current state.
+    // Callers hold writeMutex.
+    bool WriteCheckpointLocked() {
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(indexMutex);
+            text += "N " + std::to_string(nextBlobId) + " " +
+                    std::to_string(nextSegmentId) + "\n";
+            for (const auto& pair : segments) {
+                text += "S " + std::to_string(pair.first) + "\n";
+            }
+            for (const auto& pair : blobs) {
+                const Blob& blob = pair.second;
+                text += "B " + std::to_string(pair.first) + " " +
+                        std::to_string(blob.segment->id) + " " +
+                        std::to_string(blob.offset) + " " +
+                        std::to_string(blob.size) + " " +
+                        std::to_string(blob.hash) + "\n";
+            }
+            for (const auto& region : regions) {
+                for (const auto& tile : region.second.tiles) {
+                    TileKey key = TileKey::FromIndex(tile.first);
+                    text += "P " + region.first + " " + std::to_string(key.z) + " " +
+                            std::to_string(key.x) + " " + std::to_string(key.y) + " " +
+                            std::to_string(tile.second) + "\n";
+                }
+            }
+        }
+        if (log) {
+            fclose(log);
+            log = nullptr;
+        }
+        std::string tmpPath = LogPath() + ".tmp";
+        FILE* file = fopen(tmpPath.c_str(), "wb");
+        bool ok = file && fwrite(text.data(), 1, text.size(), file) == text.size();
+        if (file) {
+            ok = fclose(file) == 0 && ok;
+        }
+        if (ok) {
+#ifdef _WIN32
+            std::remove(LogPath().c_str());
+#endif
+            ok = std::rename(tmpPath.c_str(), LogPath().c_str()) == 0;
+        }
+        log = fopen(LogPath().c_str(), "ab");
+        return ok && log != nullptr;
+    }
+
+    void Replay() {
+        std::ifstream file(LogPath());
+        std::set<uint32_t> segmentIds;
+        std::map<uint64_t, Blob> loaded;
+        std::map<uint64_t, uint32_t> blobSegments;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream in(line);
+            char type = 0;
+            in >> type;
+            if (type == 'N') {
+                uint64_t blobId = 0;
+                uint32_t segmentId = 0;
+                if (!(in >> blobId >> segmentId)) continue;
+                nextBlobId = std::max(nextBlobId, blobId);
+                nextSegmentId = std::max(nextSegmentId, segmentId);
+            } else if (type == 'S' || type == 'X') {
+                uint32_t id = 0;
+                if (!(in >> id)) continue;
+                if (type == 'S') {
+                    segmentIds.insert(id);
+                    nextSegmentId = std::max(nextSegmentId, id + 1);
+                } else {
+                    segmentIds.erase(id);
+                }
+            } else if (type == 'B') {
+                uint64_t id = 0, offset = 0, hash = 0;
+                uint32_t segment = 0, size = 0;
+                if (!(in >> id >> segment >> offset >> size >> hash)) continue;
+                Blob blob;
+                blob.hash = hash;
+                blob.size = size;
+                blob.offset = offset;
+                loaded[id] = blob;
+                blobSegments[id] = segment;
+                nextBlobId = std::max(nextBlobId, id + 1);
+            } else if (type == 'M') {
+                uint64_t id = 0, offset = 0;
+                uint32_t segment = 0;
+                if (!(in >> id >> segment >> offset)) continue;
+                auto it = loaded.find(id);
+                if (it != loaded.end()) {
+                    it->second.offset = offset;
+                    blobSegments[id] = segment;
+                }
+            } else if (type == 'P' || type == 'D') {
+                std::string region;
+                TileKey key;
+                uint64_t id = 0;
+                if (!(in >> region >> key.z >> key.x >> key.y)) continue;
+                if (type == 'P') {
+                    if (!(in >> id)) continue;
+                    regions[region].tiles[key.ToIndex()] = id;
+                } else {
+                    auto it = regions.find(region);
+                    if (it != regions.end()) {
+                        it->second.tiles.erase(key.ToIndex());
+                    }
+                }
+            } else if (type == 'R') {
+                std::string region;
+                if (in >> region) {
+                    regions.erase(region);
+                }
+            }
+        }
+
+        for (uint32_t id : segmentIds) {
+            StatBuf statBuf;
+            std::string segmentPath = SegmentPath(id);
+            if (statFunc(segmentPath.c_str(), &statBuf) == 0) {
+                segments[id] = std::make_shared<Segment>(
+                    id, segmentPath, static_cast<uint64_t>(statBuf.st_size));
+            }
+        }
+
+        // Mappings to blobs that were never fully written are dropped.
+        for (auto region = regions.begin(); region != regions.end(); ) {
+            RegionIndex& index = region->second;
+            index.bytes = 0;
+            for (auto tile = index.tiles.begin(); tile != index.tiles.end(); ) {
+                auto blob = loaded.find(tile->second);
+                bool valid = false;
+                if (blob != loaded.end()) {
+                    auto segment = segments.find(blobSegments[tile->second]);
+                    valid = segment != segments.end() &&
+                            blob->second.offset + blob->second.size <= segment->second->size;
+                    if (valid && !blob->second.segment) {
+                        blob->second.segment = segment->second;
+                    }
+                }
+                if (!valid) {
+                    tile = index.tiles.erase(tile);
+                    continue;
+                }
+                ++blob->second.refs;
+                index.bytes += blob->second.size;
+                ++tile;
+            }
+            if (index.tiles.empty()) {
+                region = regions.erase(region);
+            } else {
+                ++region;
+            }
+        }
+
+        for (auto& pair : loaded) {
+            Blob& blob = pair.second;
+            if (blob.refs == 0) {
+                continue;
+            }
+            blob.segment->liveBytes += blob.size;
+            byHash.insert(std::make_pair(blob.hash, pair.first));
+            blobs[pair.first] = blob;
+        }
+
+        for (auto it = segments.begin(); it != segments.end(); ) {
+            if (it->second->liveBytes == 0) {
+                it->second->retired = true;
+                it = segments.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+TileBlobStore::TileBlobStore(const std::string& path, uint64_t segmentSize)
+    : impl_(new Impl(path, segmentSize > 0 ? segmentSize : kDefaultSegmentSize)) {
+}
+
+TileBlobStore::~TileBlobStore() {
+    Close();
+}
+
+bool TileBlobStore::Open() {
+    if (impl_->open) {
+        return true;
+    }
+    if (mkdirFunc(impl_->path.c_str()) != 0 && errno != EEXIST) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(impl_->writeMutex);
+    impl_->Replay();
+    // Each session appends to a fresh segment and starts from a compact log.
+    if (!impl_->WriteCheckpointLocked()) {
+        return false;
+    }
+    impl_->open = true;
+    return true;
+}
+
+void TileBlobStore::Close() {
+    if (!impl_->open) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(impl_->writeMutex);
+    impl_->open = false;
+    impl_->SealActiveLocked();
+    if (impl_->log) {
+        fclose(impl_->log);
+        impl_->log = nullptr;
+    }
+    std::lock_guard<std::mutex> indexLock(impl_->indexMutex);
+    impl_->blobs.clear();
+    impl_->byHash.clear();
+    impl_->regions.clear();
+    impl_->segments.clear();
+    impl_->nextBlobId = 1;
+    impl_->nextSegmentId = 1;
+}
+
+bool TileBlobStore::IsOpen() const {
+    return impl_->open;
+}
+
+bool TileBlobStore::Put(const std::string& regionId, const TileKey& key,
+                        const std::vector<uint8_t>& data) {
+    if (!impl_->open || !IsValidRegionId(regionId) || data.size() > 0xFFFFFFFFu) {
+        return false;
+    }
+    Impl& impl = *impl_;
+    std::lock_guard<std::mutex> lock(impl.writeMutex);
+    uint32_t size = static_cast<uint32_t>(data.size());
+    uint64_t hash = HashBytes(data.data(), data.size());
+
+    struct Candidate {
+        uint64_t id;
+        SegmentPtr segment;
+        uint64_t offset;
+    };
+    std::vector<Candidate> candidates;
+    {
+        std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+        auto range = impl.byHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            const Blob& blob = impl.blobs[it->second];
+            if (blob.size == size) {
+                Candidate candidate = {it->second, blob.segment, blob.offset};
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    // Writers hold writeMutex, so a candidate cannot be released or moved
+    // before the mapping below takes its reference.
+    uint64_t blobId = 0;
+    std::vector<uint8_t> existing;
+    for (const Candidate& candidate : candidates) {
+        if (ReadBlob(candidate.segment, candidate.offset, size, existing) && existing == data) {
+            blobId = candidate.id;
+            break;
+        }
+    }
+
+    Blob added;
+    if (blobId == 0) {
+        if (!impl.AppendLocked(data.data(), size, hash, &added.segment, &added.offset)) {
+            return false;
+        }
+        blobId = impl.nextBlobId++;
+        added.hash = hash;
+        added.size = size;
+        impl.LogLocked("B " + std::to_string(blobId) + " " +
+                       std::to_string(added.segment->id) + " " +
+                       std::to_string(added.offset) + " " + std::to_string(size) + " " +
+                       std::to_string(hash));
+    }
+    impl.LogLocked("P " + regionId + " " + std::to_string(key.z) + " " +
+                   std::to_string(key.x) + " " + std::to_string(key.y) + " " +
+                   std::to_string(blobId));
+
+    std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+    if (added.segment) {
+        added.segment->liveBytes += size;
+        impl.blobs[blobId] = added;
+        impl.byHash.insert(std::make_pair(hash, blobId));
+    }
+    RegionIndex& region = impl.regions[regionId];
+    uint64_t& mapped = region.tiles[key.ToIndex()];
+    if (mapped == blobId) {
+        return true;
+    }
+    if (mapped != 0) {
+        region.bytes -= impl.blobs[mapped].size;
+        impl.ReleaseLocked(mapped);
+    }
+    mapped = blobId;
+    ++impl.blobs[blobId].refs;
+    region.bytes += size;
+    return true;
+}
+
+bool TileBlobStore::Has(const std::string& regionId, const TileKey& key) const {
+    std::lock_guard<std::mutex> lock(impl_->indexMutex);
+    auto region = impl_->regions.find(regionId);
+    return region != impl_->regions.end() &&
+           region->second.tiles.count(key.ToIndex()) > 0;
+}
+
+bool TileBlobStore::Get(const std::string& regionId, const TileKey& key,
+                        std::vector<uint8_t>& data) const {
+    SegmentPtr segment;
+    uint64_t offset = 0;
+    uint32_t size = 0;
+    {
+        std::lock_guard<std::mutex> lock(impl_->indexMutex);
+        auto region = impl_->regions.find(regionId);
+        if (region == impl_->regions.end()) {
+            return false;
+        }
+        auto tile = region->second.tiles.find(key.ToIndex());
+        if (tile == region->second.tiles.end()) {
+            return false;
+        }
+        const Blob& blob = impl_->blobs[tile->second];
+        segment = blob.segment;
+        offset = blob.offset;
+        size = blob.size;
+    }
+    if (!ReadBlob(segment, offset, size, data)) {
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TileBlobStore::Remove(const std::string& regionId, const TileKey& key) {
+    if (!impl_->open) {
+        return false;
+    }
+    Impl& impl = *impl_;
+    std::lock_guard<std::mutex> lock(impl.writeMutex);
+    {
+        std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+        auto region = impl.regions.find(regionId);
+        if (region == impl.regions.end() || region->second.tiles.count(key.ToIndex()) == 0) {
+            return false;
+        }
+    }
+    impl.LogLocked("D " + regionId + " " + std::to_string(key.z) + " " +
+                   std::to_string(key.x) + " " + std::to_string(key.y));
+    std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+    RegionIndex& region = impl.regions[regionId];
+    auto tile = region.tiles.find(key.ToIndex());
+    region.bytes -= impl.blobs[tile->second].size;
+    impl.ReleaseLocked(tile->second);
+    region.tiles.erase(tile);
+    if (region.tiles.empty()) {
+        impl.regions.erase(regionId);
+    }
+    return true;
+}
+
+void TileBlobStore::RemoveRegion(const std::string& regionId) {
+    if (!impl_->open || !IsValidRegionId(regionId)) {
+        return;
+    }
+    Impl& impl = *impl_;
+    std::lock_guard<std::mutex> lock(impl.writeMutex);
+    impl.LogLocked("R " + regionId);
+    std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+    auto region = impl.regions.find(regionId);
+    if (region == impl.regions.end()) {
+        return;
+    }
+    for (const auto& tile : region->second.tiles) {
+        impl.ReleaseLocked(tile.second);
+    }
+    impl.regions.erase(region);
+}
+
+void TileBlobStore::Clear() {
+    if (!impl_->open) {
+        return;
+    }
+    Impl& impl = *impl_;
+    std::lock_guard<std::mutex> lock(impl.writeMutex);
+    impl.SealActiveLocked();
+    {
+        std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+        for (auto& pair : impl.segments) {
+            pair.second->retired = true;
+        }
+        impl.segments.clear();
+        impl.blobs.clear();
+        impl.byHash.clear();
+        impl.regions.clear();
+    }
+    impl.WriteCheckpointLocked();
+}
+
+bool TileBlobStore::Flush() {
+    std::lock_guard<std::mutex> lock(impl_->writeMutex);
+    bool ok = true;
+    if (impl_->writer) {
+        ok = fflush(impl_->writer) == 0 && ok;
+    }
+    if (impl_->log) {
+        ok = fflush(impl_->log) == 0 && ok;
+    }
+    return ok;
+}
+
+bool TileBlobStore::Sync() {
+    std::lock_guard<std::mutex> lock(impl_->writeMutex);
+    return impl_->SyncLocked();
+}
+
+size_t TileBlobStore::GetTileCount(const std::string& regionId) const {
+    std::lock_guard<std::mutex> lock(impl_->indexMutex);
+    auto region = impl_->regions.find(regionId);
+    return region == impl_->regions.end() ? 0 : region->second.tiles.size();
+}
+
+uint64_t TileBlobStore::GetRegionBytes(const std::string& regionId) const {
+    std::lock_guard<std::mutex> lock(impl_->indexMutex);
+    auto region = impl_->regions.find(regionId);
+    return region == impl_->regions.end() ? 0 : region->second.bytes;
+}
+
+bool TileBlobStore::Compact(double maxLiveRatio, uint64_t maxBytes) {
+    if (!impl_->open) {
+        return false;
+    }
+    Impl& impl = *impl_;
+    uint64_t moved = 0;
+    bool ok = true;
+    for (;;) {
+        SegmentPtr victim;
+        std::vector<uint64_t> ids;
+        {
+            std::lock_guard<std::mutex> lock(impl.writeMutex);
+            std::vector<SegmentPtr> dead;
+            {
+                std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+                // A mostly dead current segment is sealed so its blobs can
+                // move to a fresh one.
+                if (impl.active && impl.active->size > 0 &&
+                    impl.active->liveBytes < maxLiveRatio * impl.active->size) {
+                    impl.SealActiveLocked();
+                }
+                double best = maxLiveRatio;
+                for (auto it = impl.segments.begin(); it != impl.segments.end(); ) {
+                    Segment& segment = *it->second;
+                    if (it->second == impl.active) {
+                        ++it;
+                        continue;
+                    }
+                    if (segment.liveBytes == 0) {
+                        impl.LogLocked("X " + std::to_string(segment.id));
+                        dead.push_back(it->second);
+                        it = impl.segments.erase(it);
+                        continue;
+                    }
+                    double ratio = segment.size > 0
+                        ? static_cast<double>(segment.liveBytes) / segment.size : 1.0;
+                    if (ratio < best) {
+                        best = ratio;
+                        victim = it->second;
+                    }
+                    ++it;
+                }
+                if (victim) {
+                    for (const auto& pair : impl.blobs) {
+                        if (pair.second.segment == victim) {
+                            ids.push_back(pair.first);
+                        }
+                    }
+                }
+            }
+            if (!impl.RetireLocked(dead)) {
+                ok = false;
+                break;
+            }
+        }
+        if (!victim) {
+            break;
+        }
+
+        for (uint64_t id : ids) {
+            Blob blob;
+            {
+                std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+                auto it = impl.blobs.find(id);
+                if (it == impl.blobs.end() || it->second.segment != victim) {
+                    continue;
+                }
+                blob = it->second;
+            }
+            std::vector<uint8_t> data;
+            if (!ReadBlob(victim, blob.offset, blob.size, data)) {
+                ok = false;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(impl.writeMutex);
+            {
+                std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+                auto it = impl.blobs.find(id);
+                if (it == impl.blobs.end() || it->second.segment != victim) {
+                    continue;
+                }
+            }
+            SegmentPtr target;
+            uint64_t offset = 0;
+            if (!impl.AppendLocked(data.data(), blob.size, blob.hash, &target, &offset)) {
+                ok = false;
+                break;
+            }
+            impl.LogLocked("M " + std::to_string(id) + " " + std::to_string(target->id) +
+                           " " + std::to_string(offset));
+            std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+            Blob& current = impl.blobs[id];
+            current.segment = target;
+            current.offset = offset;
+            victim->liveBytes -= blob.size;
+            target->liveBytes += blob.size;
+            moved += blob.size;
+        }
+        if (!ok) {
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(impl.writeMutex);
+            std::vector<SegmentPtr> dead;
+            {
+                std::lock_guard<std::mutex> indexLock(impl.indexMutex);
+                if (victim->liveBytes == 0 && impl.segments.erase(victim->id) > 0) {
+                    impl.LogLocked("X " + std::to_string(victim->id));
+                    dead.push_back(victim);
+                }
+            }
+            if (!impl.RetireLocked(dead)) {
+                ok = false;
+                break;
+            }
+        }
+        if (maxBytes > 0 && moved >= maxBytes) {
+            return true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(impl.writeMutex);
+    return impl.WriteCheckpointLocked() && ok;
+}
+
+bool TileBlobStore::Validate() const {
+    std::vector<Blob> live;
+    {
+        std::lock_guard<std::mutex> lock(impl_->indexMutex);
+        live.reserve(impl_->blobs.size());
+        for (const auto& pair : impl_->blobs) {
+            live.push_back(pair.second);
+        }
+    }
+    std::vector<uint8_t> record;
+    for (const Blob& blob : live) {
+        record.resize(kHeaderSize + blob.size);
+        if (blob.offset < kHeaderSize ||
+            !blob.segment->Read(blob.offset - kHeaderSize, record.data(), record.size())) {
+            return false;
+        }
+        if (LoadLE(record.data(), 4) != kBlobMagic ||
+            LoadLE(record.data() + 4, 4) != blob.size ||
+            LoadLE(record.data() + 8, 8) != blob.hash ||
+            HashBytes(record.data() + kHeaderSize, blob.size) != blob.hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TileBlobStoreStats TileBlobStore::GetStats() const {
+    TileBlobStoreStats stats;
+    std::lock_guard<std::mutex> lock(impl_->indexMutex);
+    for (const auto& region : impl_->regions) {
+        stats.tileCount += region.second.tiles.size();
+        stats.logicalBytes += region.second.bytes;
+    }
+    stats.blobCount = impl_->blobs.size();
+    for (const auto& pair : impl_->segments) {
+        stats.liveBytes += pair.second->liveBytes;
+        stats.fileBytes += pair.second->size;
+    }
+    stats.segmentCount = static_cast<int>(impl_->segments.size());
+    return stats;
+}
+
+std::string TileBlobStore::GetPath() const {
+    return impl_->path;
+}
+
+}
+}
@@ -0,0 +1,98 @@
+#include "ogc/cache/offline/tile_source.h"
+#include <cstdio>
+#include <fstream>
+
+namespace ogc {
+namespace cache {
+
+namespace {
+
+void ReplaceAll(std::string& text, const std::string& token, const std::string& value) {
+    size_t pos = 0;
+    while ((pos = text.find(token, pos)) != std::string::npos) {
+        text.replace(pos, token.size(), value);
+        pos += value.size();
+    }
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    if (size < 0) {
+        return false;
+    }
+    file.seekg(0, std::ios::beg);
+    data.resize(static_cast<size_t>(size));
+    if (size > 0 && !file.read(reinterpret_cast<char*>(data.data()), size)) {
+        return false;
+    }
+    return true;
+}
+
+}
+
+TileSource::~TileSource() {
+}
+
+bool TileSource::GetTileHash(const TileKey& key, std::string& hash) {
+    (void)key;
+    (void)hash;
+    return false;
+}
+
+FileTileSource::FileTileSource(const std::string& pathTemplate)
+    : m_pathTemplate(pathTemplate) {
+}
+
+bool FileTileSource::FetchTile(const TileKey& key, int timeoutSeconds, TileFetchResult& result) {
+    (void)timeoutSeconds;
+    std::string path = GetTilePath(key);
+    if (!ReadFile(path, result.data)) {
+        result.error = "Tile not found: " + path;
+        return false;
+    }
+    result.contentHash = ComputeTileHash(result.data);
+    return true;
+}
+
+bool FileTileSource::GetTileHash(const TileKey& key, std::string& hash) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(GetTilePath(key), data)) {
+        return false;
+    }
+    hash = ComputeTileHash(data);
+    return true;
+}
+
+std::string FileTileSource::GetName() const {
+    return "file:" + m_pathTemplate;
+}
+
+std::string FileTileSource::GetTilePath(const TileKey& key) const {
+    std::string path = m_pathTemplate;
+    ReplaceAll(path, "{z}", std::to_string(key.z));
+    ReplaceAll(path, "{x}", std::to_string(key.x));
+    ReplaceAll(path, "{y}", std::to_string(key.y));
+    return path;
+}
+
+TileSourcePtr FileTileSource::Create(const std::string& pathTemplate) {
+    return std::make_shared<FileTileSource>(pathTemplate);
+}
+
+std::string ComputeTileHash(const std::vector<uint8_t>& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint8_t byte : data) {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    }
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+}
+}
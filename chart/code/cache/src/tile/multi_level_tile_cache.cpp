@@ -1,145 +1,412 @@
 #include "ogc/cache/tile/multi_level_tile_cache.h"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace ogc {
 namespace cache {
 
+namespace {
+
+typedef std::vector<TileCachePtr> LevelList;
+typedef std::shared_ptr<const LevelList> LevelSnapshot;
+typedef std::shared_ptr<const std::vector<uint8_t>> SharedData;
+
+const size_t kDefaultWriteQueueDepth = 1024;
+const size_t kGenerationStripes = 64;
+
+struct PendingWrite {
+    TileKey key;
+    SharedData data;
+    size_t firstLevel;
+    size_t lastLevel;
+    bool promotion;
+    uint64_t generation;
+};
+
+}
+
 struct MultiLevelTileCache::Impl {
     std::string name;
-    bool enabled;
-    bool promoteOnHit;
-    bool writeThrough;
-    bool writeBack;
-    std::vector<TileCachePtr> caches;
-    mutable std::mutex mutex;
-    
+    std::atomic<bool> enabled;
+    std::atomic<bool> promoteOnHit;
+    std::atomic<bool> writeThrough;
+    std::atomic<bool> writeBack;
+
+    // Readers take the current level list with atomic_load; changes copy it.
+    LevelSnapshot levels;
+    std::mutex configMutex;
+
+    // Write-back queue, coalesced per tile in arrival order.
+    mutable std::mutex queueMutex;
+    std::condition_variable workCondition;
+    std::condition_variable spaceCondition;
+    std::condition_variable idleCondition;
+    std::unordered_map<uint64_t, PendingWrite> pending;
+    std::deque<uint64_t> order;
+    size_t maxDepth;
+    bool inFlight;
+    bool stopping;
+    std::thread worker;
+
+    // Held by the worker while it writes a tile, so RemoveTile and Clear
+    // cannot be overtaken by a write that was already dequeued.
+    std::mutex writerMutex;
+
+    // PutTile, RemoveTile and Clear bump the generation of the key's stripe.
+    // A promotion is written under the stripe lock only if the generation it
+    // read under is still current, so a copy taken from a lower level never
+    // lands on top of newer data.
+    std::mutex stripeMutex[kGenerationStripes];
+    std::atomic<uint64_t> generations[kGenerationStripes];
+
     Impl() : name("MultiLevelTileCache"), enabled(true), promoteOnHit(true),
-             writeThrough(true), writeBack(false) {}
+             writeThrough(true), writeBack(true),
+             levels(std::make_shared<LevelList>()),
+             maxDepth(kDefaultWriteQueueDepth), inFlight(false), stopping(false) {
+        for (auto& generation : generations) {
+            generation = 0;
+        }
+    }
+
+    static size_t Stripe(const TileKey& key) {
+        return static_cast<size_t>((key.ToIndex() * 0x9E3779B97F4A7C15ULL) >> 58) % kGenerationStripes;
+    }
+
+    uint64_t Generation(const TileKey& key) const {
+        return generations[Stripe(key)];
+    }
+
+    void Invalidate(const TileKey& key) {
+        size_t stripe = Stripe(key);
+        std::lock_guard<std::mutex> lock(stripeMutex[stripe]);
+        ++generations[stripe];
+    }
+
+    void InvalidateAll() {
+        for (size_t i = 0; i < kGenerationStripes; ++i) {
+            std::lock_guard<std::mutex> lock(stripeMutex[i]);
+            ++generations[i];
+        }
+    }
+
+    LevelSnapshot Levels() const {
+        return std::atomic_load(&levels);
+    }
+
+    template <typename Func>
+    void UpdateLevels(Func func) {
+        Drain();
+        std::lock_guard<std::mutex> lock(configMutex);
+        std::shared_ptr<LevelList> next = std::make_shared<LevelList>(*Levels());
+        func(*next);
+        std::atomic_store(&levels, LevelSnapshot(next));
+    }
+
+    void WriteLevels(const LevelList& caches, const PendingWrite& write) {
+        if (!write.promotion) {
+            PutLevels(caches, write);
+            return;
+        }
+        size_t stripe = Stripe(write.key);
+        std::lock_guard<std::mutex> lock(stripeMutex[stripe]);
+        if (generations[stripe] == write.generation) {
+            PutLevels(caches, write);
+        }
+    }
+
+    static void PutLevels(const LevelList& caches, const PendingWrite& write) {
+        size_t last = std::min(write.lastLevel + 1, caches.size());
+        for (size_t i = write.firstLevel; i < last; ++i) {
+            const auto& cache = caches[i];
+            if (!cache || !cache->IsEnabled()) {
+                continue;
+            }
+            if (write.promotion && cache->HasTile(write.key)) {
+                continue;
+            }
+            cache->PutTile(write.key, *write.data);
+        }
+    }
+
+    // Returns false when a promotion is dropped because the queue is full.
+    bool Enqueue(const TileKey& key, const SharedData& data,
+                 size_t firstLevel, size_t lastLevel, bool promotion, uint64_t generation) {
+        uint64_t index = key.ToIndex();
+        std::unique_lock<std::mutex> lock(queueMutex);
+        for (;;) {
+            auto it = pending.find(index);
+            if (it != pending.end()) {
+                PendingWrite& write = it->second;
+                // A promotion never replaces newer data from PutTile, and a
+                // PutTile replacing a promotion keeps to its own levels: it
+                // wrote the first level itself, and an unchecked copy there
+                // could land after a later PutTile.
+                if (promotion && !write.promotion) {
+                    return true;
+                }
+                if (!promotion && write.promotion) {
+                    write.firstLevel = firstLevel;
+                    write.lastLevel = lastLevel;
+                }
+                write.data = data;
+                write.promotion = promotion;
+                write.generation = generation;
+                write.firstLevel = std::min(write.firstLevel, firstLevel);
+                write.lastLevel = std::max(write.lastLevel, lastLevel);
+                return true;
+            }
+            if (pending.size() < maxDepth || stopping) {
+                break;
+            }
+            if (promotion) {
+                return false;
+            }
+            spaceCondition.wait(lock);
+        }
+
+        PendingWrite write;
+        write.key = key;
+        write.data = data;
+        write.firstLevel = firstLevel;
+        write.lastLevel = lastLevel;
+        write.promotion = promotion;
+        write.generation = generation;
+        pending[index] = write;
+        order.push_back(index);
+        if (!worker.joinable()) {
+            worker = std::thread(&Impl::Run, this);
+        }
+        workCondition.notify_one();
+        return true;
+    }
+
+    bool FindPending(const TileKey& key, SharedData& data) const {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        auto it = pending.find(key.ToIndex());
+        if (it == pending.end()) {
+            return false;
+        }
+        data = it->second.data;
+        return true;
+    }
+
+    void Cancel(const TileKey& key) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (pending.erase(key.ToIndex()) > 0) {
+            order.erase(std::find(order.begin(), order.end(), key.ToIndex()));
+            spaceCondition.notify_all();
+            if (pending.empty() && !inFlight) {
+                idleCondition.notify_all();
+            }
+        }
+    }
+
+    void CancelAll() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pending.clear();
+        order.clear();
+        spaceCondition.notify_all();
+        if (!inFlight) {
+            idleCondition.notify_all();
+        }
+    }
+
+    void Drain() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        idleCondition.wait(lock, [this]() { return order.empty() && !inFlight; });
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        for (;;) {
+            workCondition.wait(lock, [this]() { return stopping || !order.empty(); });
+            if (order.empty()) {
+                return;
+            }
+            uint64_t index = order.front();
+            order.pop_front();
+            PendingWrite write = pending[index];
+            pending.erase(index);
+            inFlight = true;
+            std::unique_lock<std::mutex> writerLock(writerMutex);
+            lock.unlock();
+            spaceCondition.notify_all();
+
+            WriteLevels(*Levels(), write);
+
+            writerLock.unlock();
+            lock.lock();
+            inFlight = false;
+            if (order.empty()) {
+                idleCondition.notify_all();
+            }
+        }
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        workCondition.notify_all();
+        spaceCondition.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
 };
 
 MultiLevelTileCache::MultiLevelTileCache() : impl_(new Impl()) {}
 
 MultiLevelTileCache::MultiLevelTileCache(const std::vector<TileCachePtr>& caches)
     : impl_(new Impl()) {
-    impl_->caches = caches;
+    impl_->levels = std::make_shared<LevelList>(caches);
 }
 
-MultiLevelTileCache::~MultiLevelTileCache() = default;
+MultiLevelTileCache::~MultiLevelTileCache() {
+    // The worker only exits once the queue is empty, so every accepted
+    // write reaches its level before the levels are flushed.
+    impl_->Stop();
+    for (const auto& cache : *impl_->Levels()) {
+        if (cache) {
+            cache->Flush();
+        }
+    }
+}
 
 void MultiLevelTileCache::AddCache(const TileCachePtr& cache, int priority) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     if (!cache) {
         return;
     }
-    
-    if (priority < 0 || static_cast<size_t>(priority) >= impl_->caches.size()) {
-        impl_->caches.push_back(cache);
-    } else {
-        impl_->caches.insert(impl_->caches.begin() + priority, cache);
-    }
+
+    impl_->UpdateLevels([&](LevelList& caches) {
+        if (priority < 0 || static_cast<size_t>(priority) >= caches.size()) {
+            caches.push_back(cache);
+        } else {
+            caches.insert(caches.begin() + priority, cache);
+        }
+    });
 }
 
 void MultiLevelTileCache::RemoveCache(size_t index) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    if (index < impl_->caches.size()) {
-        impl_->caches.erase(impl_->caches.begin() + index);
-    }
+    impl_->UpdateLevels([&](LevelList& caches) {
+        if (index < caches.size()) {
+            caches.erase(caches.begin() + index);
+        }
+    });
 }
 
 void MultiLevelTileCache::RemoveCache(const std::string& name) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    impl_->caches.erase(
-        std::remove_if(impl_->caches.begin(), impl_->caches.end(),
-            [&name](const TileCachePtr& cache) {
-                return cache && cache->GetName() == name;
-            }),
-        impl_->caches.end());
+    impl_->UpdateLevels([&](LevelList& caches) {
+        caches.erase(
+            std::remove_if(caches.begin(), caches.end(),
+                [&name](const TileCachePtr& cache) {
+                    return cache && cache->GetName() == name;
+                }),
+            caches.end());
+    });
 }
 
 void MultiLevelTileCache::ClearCaches() {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    impl_->caches.clear();
+    impl_->UpdateLevels([](LevelList& caches) {
+        caches.clear();
+    });
 }
 
 size_t MultiLevelTileCache::GetCacheCount() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    return impl_->caches.size();
+    return impl_->Levels()->size();
 }
 
 TileCachePtr MultiLevelTileCache::GetCache(size_t index) const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    if (index < impl_->caches.size()) {
-        return impl_->caches[index];
+    LevelSnapshot caches = impl_->Levels();
+
+    if (index < caches->size()) {
+        return (*caches)[index];
     }
-    
+
     return nullptr;
 }
 
 TileCachePtr MultiLevelTileCache::GetCache(const std::string& name) const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    for (const auto& cache : impl_->caches) {
+    LevelSnapshot caches = impl_->Levels();
+
+    for (const auto& cache : *caches) {
         if (cache && cache->GetName() == name) {
             return cache;
         }
     }
-    
+
     return nullptr;
 }
 
 std::vector<TileCachePtr> MultiLevelTileCache::GetCaches() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    return impl_->caches;
+    return *impl_->Levels();
 }
 
 bool MultiLevelTileCache::HasTile(const TileKey& key) const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     if (!impl_->enabled) {
         return false;
     }
-    
-    for (const auto& cache : impl_->caches) {
+
+    LevelSnapshot caches = impl_->Levels();
+    for (size_t i = 0; i < caches->size(); ++i) {
+        const auto& cache = (*caches)[i];
         if (cache && cache->IsEnabled() && cache->HasTile(key)) {
             return true;
         }
+        if (i == 0) {
+            SharedData data;
+            if (impl_->FindPending(key, data)) {
+                return true;
+            }
+        }
     }
-    
+
     return false;
 }
 
 TileData MultiLevelTileCache::GetTile(const TileKey& key) const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     TileData result;
-    
+
     if (!impl_->enabled) {
         return result;
     }
-    
-    for (size_t i = 0; i < impl_->caches.size(); ++i) {
-        const auto& cache = impl_->caches[i];
-        if (!cache || !cache->IsEnabled()) {
-            continue;
-        }
-        
-        if (cache->HasTile(key)) {
+
+    // Taken before any level is read, so a PutTile racing with this lookup
+    // invalidates the promotion below.
+    uint64_t generation = impl_->Generation(key);
+    LevelSnapshot caches = impl_->Levels();
+    for (size_t i = 0; i < caches->size(); ++i) {
+        const auto& cache = (*caches)[i];
+        if (cache && cache->IsEnabled()) {
             result = cache->GetTile(key);
             if (result.IsValid()) {
                 if (impl_->promoteOnHit && i > 0) {
-                    PromoteTile(key, result, i);
+                    PromoteTile(key, result, i, generation);
                 }
                 return result;
             }
         }
+
+        // Tiles still waiting in the write-back queue are served from there
+        // once the first level has missed.
+        SharedData data;
+        if (i == 0 && impl_->FindPending(key, data)) {
+            result = TileData();
+            result.key = key;
+            result.data = *data;
+            result.size = static_cast<int64_t>(data->size());
+            result.valid = true;
+            return result;
+        }
     }
-    
-    return result;
+
+    return TileData();
 }
 
 bool MultiLevelTileCache::PutTile(const TileKey& key, const TileData& tile) {
@@ -147,49 +414,64 @@ bool MultiLevelTileCache::PutTile(const TileKey& key, const TileData& tile) {
 }
 
 bool MultiLevelTileCache::PutTile(const TileKey& key, const std::vector<uint8_t>& data) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    if (!impl_->enabled || data.empty() || impl_->caches.empty()) {
+    LevelSnapshot caches = impl_->Levels();
+
+    if (!impl_->enabled || data.empty() || caches->empty()) {
         return false;
     }
-    
+
     bool success = false;
-    
-    if (impl_->writeThrough) {
-        for (const auto& cache : impl_->caches) {
-            if (cache && cache->IsEnabled()) {
-                if (cache->PutTile(key, data)) {
-                    success = true;
-                }
-            }
-        }
-    } else {
-        if (impl_->caches[0] && impl_->caches[0]->IsEnabled()) {
-            success = impl_->caches[0]->PutTile(key, data);
+    impl_->Invalidate(key);
+    const auto& first = (*caches)[0];
+    if (first && first->IsEnabled()) {
+        success = first->PutTile(key, data);
+    }
+
+    if (!impl_->writeThrough || caches->size() < 2) {
+        return success;
+    }
+
+    if (impl_->writeBack) {
+        impl_->Enqueue(key, std::make_shared<std::vector<uint8_t>>(data),
+                       1, caches->size() - 1, false, 0);
+        return true;
+    }
+
+    for (size_t i = 1; i < caches->size(); ++i) {
+        const auto& cache = (*caches)[i];
+        if (cache && cache->IsEnabled() && cache->PutTile(key, data)) {
+            success = true;
         }
     }
-    
+
     return success;
 }
 
 bool MultiLevelTileCache::RemoveTile(const TileKey& key) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     bool removed = false;
-    
-    for (const auto& cache : impl_->caches) {
+    {
+        SharedData data;
+        removed = impl_->FindPending(key, data);
+    }
+    impl_->Invalidate(key);
+    impl_->Cancel(key);
+
+    std::lock_guard<std::mutex> writerLock(impl_->writerMutex);
+    for (const auto& cache : *impl_->Levels()) {
         if (cache && cache->RemoveTile(key)) {
             removed = true;
         }
     }
-    
+
     return removed;
 }
 
 void MultiLevelTileCache::Clear() {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    for (const auto& cache : impl_->caches) {
+    impl_->InvalidateAll();
+    impl_->CancelAll();
+
+    std::lock_guard<std::mutex> writerLock(impl_->writerMutex);
+    for (const auto& cache : *impl_->Levels()) {
         if (cache) {
             cache->Clear();
         }
@@ -197,53 +479,47 @@ void MultiLevelTileCache::Clear() {
 }
 
 size_t MultiLevelTileCache::GetTileCount() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     size_t count = 0;
-    for (const auto& cache : impl_->caches) {
+    for (const auto& cache : *impl_->Levels()) {
         if (cache) {
             count += cache->GetTileCount();
         }
     }
-    
+
     return count;
 }
 
 size_t MultiLevelTileCache::GetSize() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     size_t size = 0;
-    for (const auto& cache : impl_->caches) {
+    for (const auto& cache : *impl_->Levels()) {
         if (cache) {
             size += cache->GetSize();
         }
     }
-    
+
     return size;
 }
 
 size_t MultiLevelTileCache::GetMaxSize() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
     size_t maxSize = 0;
-    for (const auto& cache : impl_->caches) {
+    for (const auto& cache : *impl_->Levels()) {
         if (cache) {
             maxSize += cache->GetMaxSize();
         }
     }
-    
+
     return maxSize;
 }
 
 void MultiLevelTileCache::SetMaxSize(size_t maxSize) {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    if (impl_->caches.empty()) {
+    LevelSnapshot caches = impl_->Levels();
+
+    if (caches->empty()) {
         return;
     }
-    
-    size_t perCacheSize = maxSize / impl_->caches.size();
-    for (const auto& cache : impl_->caches) {
+
+    size_t perCacheSize = maxSize / caches->size();
+    for (const auto& cache : *caches) {
         if (cache) {
             cache->SetMaxSize(perCacheSize);
         }
@@ -251,15 +527,15 @@ void MultiLevelTileCache::SetMaxSize(size_t maxSize) {
 }
 
 bool MultiLevelTileCache::IsFull() const {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    for (const auto& cache : impl_->caches) {
+    LevelSnapshot caches = impl_->Levels();
+
+    for (const auto& cache : *caches) {
         if (cache && !cache->IsFull()) {
             return false;
         }
     }
-    
-    return !impl_->caches.empty();
+
+    return !caches->empty();
 }
 
 std::string MultiLevelTileCache::GetName() const {
@@ -279,9 +555,9 @@ void MultiLevelTileCache::SetEnabled(bool enabled) {
 }
 
 void MultiLevelTileCache::Flush() {
-    std::lock_guard<std::mutex> lock(impl_->mutex);
-    
-    for (const auto& cache : impl_->caches) {
+    impl_->Drain();
+
+    for (const auto& cache : *impl_->Levels()) {
         if (cache) {
             cache->Flush();
         }
@@ -305,6 +581,9 @@ bool MultiLevelTileCache::IsWriteThrough() const {
 }
 
 void MultiLevelTileCache::SetWriteBack(bool writeBack) {
+    if (!writeBack) {
+        impl_->Drain();
+    }
     impl_->writeBack = writeBack;
 }
 
@@ -312,6 +591,22 @@ bool MultiLevelTileCache::IsWriteBack() const {
     return impl_->writeBack;
 }
 
+void MultiLevelTileCache::SetWriteQueueDepth(size_t depth) {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    impl_->maxDepth = std::max<size_t>(1, depth);
+    impl_->spaceCondition.notify_all();
+}
+
+size_t MultiLevelTileCache::GetWriteQueueDepth() const {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    return impl_->maxDepth;
+}
+
+size_t MultiLevelTileCache::GetPendingWriteCount() const {
+    std::lock_guard<std::mutex> lock(impl_->queueMutex);
+    return impl_->pending.size() + (impl_->inFlight ? 1 : 0);
+}
+
 std::shared_ptr<MultiLevelTileCache> MultiLevelTileCache::Create() {
     return std::make_shared<MultiLevelTileCache>();
 }
@@ -320,21 +615,20 @@ std::shared_ptr<MultiLevelTileCache> MultiLevelTileCache::Create(const std::vect
     return std::make_shared<MultiLevelTileCache>(caches);
 }
 
-void MultiLevelTileCache::PromoteTile(const TileKey& key, const TileData& tile, size_t fromLevel) const {
-    for (size_t i = 0; i < fromLevel; ++i) {
-        const auto& cache = impl_->caches[i];
-        if (cache && cache->IsEnabled() && !cache->HasTile(key)) {
-            cache->PutTile(key, tile);
-        }
-    }
-}
+void MultiLevelTileCache::PromoteTile(const TileKey& key, const TileData& tile, size_t fromLevel,
+                                      uint64_t generation) const {
+    PendingWrite write;
+    write.key = key;
+    write.data = std::make_shared<std::vector<uint8_t>>(tile.data);
+    write.firstLevel = 0;
+    write.lastLevel = fromLevel - 1;
+    write.promotion = true;
+    write.generation = generation;
 
-void MultiLevelTileCache::WriteToHigherLevels(const TileKey& key, const TileData& tile, size_t startLevel) const {
-    for (size_t i = startLevel; i > 0; --i) {
-        const auto& cache = impl_->caches[i - 1];
-        if (cache && cache->IsEnabled() && !cache->HasTile(key)) {
-            cache->PutTile(key, tile);
-        }
+    if (impl_->writeBack) {
+        impl_->Enqueue(key, write.data, write.firstLevel, write.lastLevel, true, generation);
+    } else {
+        impl_->WriteLevels(*impl_->Levels(), write);
     }
 }
 
@@ -437,3 +437,164 @@ TEST_F(DataEncryptionTest, DifferentKeysDifferentEncryption) {
     
     EXPECT_NE(encrypted1, encrypted2);
 }
+
+TEST_F(DataEncryptionTest, AllAlgorithmsRoundTrip) {
+    encryption->Initialize(m_testPath);
+    
+    const EncryptionAlgorithm algorithms[] = {
+        EncryptionAlgorithm::kAES256_GCM,
+        EncryptionAlgorithm::kAES256_CTR,
+        EncryptionAlgorithm::kAES256_CBC
+    };
+    const size_t sizes[] = {1, 15, 16, 17, 255, 4096};
+    
+    for (EncryptionAlgorithm algorithm : algorithms) {
+        encryption->SetAlgorithm(algorithm);
+        for (size_t size : sizes) {
+            std::vector<uint8_t> data(size);
+            for (size_t i = 0; i < size; ++i) {
+                data[i] = static_cast<uint8_t>(i * 13 + size);
+            }
+            
+            std::vector<uint8_t> encrypted = encryption->Encrypt(data);
+            ASSERT_FALSE(encrypted.empty());
+            EXPECT_GT(encrypted.size(), data.size());
+            EXPECT_EQ(encryption->Decrypt(encrypted), data);
+        }
+    }
+}
+
+TEST_F(DataEncryptionTest, GcmKnownAnswer) {
+    encryption->Initialize(m_testPath);
+    
+    EncryptionKey key;
+    key.key.assign(32, 0);
+    
+    // AES-256-GCM test case 14 from the GCM specification: zero key, zero
+    // nonce, one zero block.
+    const uint8_t expected[] = {
+        0xce, 0xa7, 0x40, 0x3d, 0x4d, 0x60, 0x6b, 0x6e,
+        0x07, 0x4e, 0xc5, 0xd3, 0xba, 0xf3, 0x9d, 0x18,
+        0xd0, 0xd1, 0xc8, 0xa7, 0x99, 0x99, 0x6b, 0xf0,
+        0x26, 0x5b, 0x98, 0xb5, 0xd4, 0x8a, 0xb9, 0x19
+    };
+    std::vector<uint8_t> sealed(12, 0);
+    sealed.insert(sealed.end(), expected, expected + sizeof(expected));
+    
+    std::vector<uint8_t> plain = encryption->Decrypt(sealed, key, EncryptionAlgorithm::kAES256_GCM);
+    EXPECT_EQ(plain, std::vector<uint8_t>(16, 0));
+}
+
+TEST_F(DataEncryptionTest, TamperedDataRejected) {
+    encryption->Initialize(m_testPath);
+    std::vector<uint8_t> data(100, 0x42);
+    
+    encryption->SetAlgorithm(EncryptionAlgorithm::kAES256_GCM);
+    std::vector<uint8_t> encrypted = encryption->Encrypt(data);
+    encrypted[20] ^= 0x01;
+    EXPECT_TRUE(encryption->Decrypt(encrypted).empty());
+    
+    encryption->SetAlgorithm(EncryptionAlgorithm::kAES256_CTR);
+    encrypted = encryption->Encrypt(data);
+    encrypted[encrypted.size() - 1] ^= 0x80;
+    EXPECT_TRUE(encryption->Decrypt(encrypted).empty());
+    
+    EncryptionKey other = encryption->GenerateKey();
+    encrypted = encryption->Encrypt(data);
+    EXPECT_TRUE(encryption->Decrypt(encrypted, other).empty());
+}
+
+TEST_F(DataEncryptionTest, FreshNoncePerMessage) {
+    encryption->Initialize(m_testPath);
+    
+    std::vector<uint8_t> data(64, 7);
+    EXPECT_NE(encryption->Encrypt(data), encryption->Encrypt(data));
+}
+
+TEST_F(DataEncryptionTest, EncryptInPlace) {
+    encryption->Initialize(m_testPath);
+    
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    std::vector<uint8_t> buffer = data;
+    
+    ASSERT_TRUE(encryption->EncryptInPlace(buffer));
+    EXPECT_EQ(buffer.size(), data.size() + 28);
+    EXPECT_EQ(encryption->Decrypt(buffer), data);
+    
+    ASSERT_TRUE(encryption->DecryptInPlace(buffer));
+    EXPECT_EQ(buffer, data);
+    
+    buffer[0] ^= 0xFF;
+    EXPECT_FALSE(encryption->DecryptInPlace(buffer));
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST_F(DataEncryptionTest, EncryptBatchInParallel) {
+    encryption->Initialize(m_testPath);
+    
+    std::vector<std::vector<uint8_t>> tiles(64);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        tiles[i].assign(2048 + i, static_cast<uint8_t>(i));
+    }
+    std::vector<std::vector<uint8_t>> items = tiles;
+    
+    ASSERT_TRUE(encryption->EncryptBatch(items, 4));
+    for (size_t i = 0; i < items.size(); ++i) {
+        EXPECT_NE(items[i], tiles[i]);
+    }
+    
+    ASSERT_TRUE(encryption->DecryptBatch(items, 4));
+    EXPECT_EQ(items, tiles);
+}
+
+TEST_F(DataEncryptionTest, EncryptFileStreams) {
+    encryption->Initialize(m_testPath);
+#ifdef _WIN32
+    _mkdir(m_testPath.c_str());
+#else
+    mkdir(m_testPath.c_str(), 0755);
+#endif
+    
+    std::string plainPath = m_testPath + "/bundle.bin";
+    std::string sealedPath = m_testPath + "/bundle.enc";
+    std::string openedPath = m_testPath + "/bundle.out";
+    
+    std::string content;
+    for (int i = 0; i < (3 << 20) + 5; ++i) {
+        content.push_back(static_cast<char>(i * 31));
+    }
+    {
+        std::ofstream file(plainPath, std::ios::binary);
+        file.write(content.data(), content.size());
+    }
+    
+    const EncryptionAlgorithm algorithms[] = {
+        EncryptionAlgorithm::kAES256_GCM,
+        EncryptionAlgorithm::kAES256_CTR,
+        EncryptionAlgorithm::kAES256_CBC
+    };
+    for (EncryptionAlgorithm algorithm : algorithms) {
+        encryption->SetAlgorithm(algorithm);
+        ASSERT_TRUE(encryption->EncryptFile(plainPath, sealedPath));
+        ASSERT_TRUE(encryption->DecryptFile(sealedPath, openedPath));
+        
+        std::ifstream file(openedPath, std::ios::binary);
+        std::string opened((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+        EXPECT_TRUE(opened == content);
+    }
+    
+    encryption->SetAlgorithm(EncryptionAlgorithm::kAES256_GCM);
+    ASSERT_TRUE(encryption->EncryptFile(plainPath, sealedPath));
+    {
+        std::fstream file(sealedPath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(1 << 20);
+        file.put('x');
+    }
+    EXPECT_FALSE(encryption->DecryptFile(sealedPath, openedPath));
+    std::ifstream opened(openedPath);
+    EXPECT_FALSE(opened.good());
+}
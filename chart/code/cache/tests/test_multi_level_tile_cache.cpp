@@ -2,11 +2,103 @@
 #include <ogc/cache/tile/multi_level_tile_cache.h>
 #include <ogc/cache/tile/memory_tile_cache.h>
 #include <ogc/cache/tile/tile_key.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <cstdint>
 
 using namespace ogc::cache;
 
+namespace {
+
+// Memory cache whose writes wait until the gate is opened, standing in for a
+// slow disk level.
+class GatedTileCache : public MemoryTileCache {
+public:
+    GatedTileCache() : MemoryTileCache(1024 * 1024), m_open(true), m_puts(0) {}
+    
+    void Close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_open = false;
+    }
+    
+    void Open() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_open = true;
+        m_condition.notify_all();
+    }
+    
+    int GetPutCount() const {
+        return m_puts;
+    }
+    
+    using MemoryTileCache::PutTile;
+    
+    bool PutTile(const TileKey& key, const std::vector<uint8_t>& data) override {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_open; });
+        }
+        ++m_puts;
+        return MemoryTileCache::PutTile(key, data);
+    }
+    
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_open;
+    std::atomic<int> m_puts;
+};
+
+// Memory cache that can hold a read after the lookup, so a write can slip in
+// between a lower-level hit and its promotion.
+class PausedReadTileCache : public MemoryTileCache {
+public:
+    PausedReadTileCache() : MemoryTileCache(1024 * 1024), m_paused(false), m_reading(false) {}
+    
+    void Pause() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paused = true;
+    }
+    
+    void Resume() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paused = false;
+        m_condition.notify_all();
+    }
+    
+    void WaitUntilReading() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_reading; });
+    }
+    
+    TileData GetTile(const TileKey& key) const override {
+        TileData tile = MemoryTileCache::GetTile(key);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_reading = true;
+        m_condition.notify_all();
+        m_condition.wait(lock, [this]() { return !m_paused; });
+        return tile;
+    }
+    
+private:
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_condition;
+    bool m_paused;
+    mutable bool m_reading;
+};
+
+void WaitForPending(MultiLevelTileCache& cache, size_t count) {
+    for (int i = 0; i < 500 && cache.GetPendingWriteCount() != count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+}
+
 class MultiLevelTileCacheTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -265,3 +357,191 @@ TEST_F(MultiLevelTileCacheTest, MultiLevelLookup) {
     TileData tile = multiCache->GetTile(key);
     EXPECT_TRUE(tile.IsValid());
 }
+
+class MultiLevelWriteBackTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        l1 = std::make_shared<MemoryTileCache>(1024 * 1024);
+        l2 = std::make_shared<GatedTileCache>();
+        cache = std::make_shared<MultiLevelTileCache>();
+        cache->AddCache(l1);
+        cache->AddCache(l2);
+    }
+    
+    void TearDown() override {
+        l2->Open();
+        cache.reset();
+    }
+    
+    std::vector<uint8_t> Data(uint8_t value, size_t size = 64) {
+        return std::vector<uint8_t>(size, value);
+    }
+    
+    std::shared_ptr<MemoryTileCache> l1;
+    std::shared_ptr<GatedTileCache> l2;
+    std::shared_ptr<MultiLevelTileCache> cache;
+};
+
+TEST_F(MultiLevelWriteBackTest, LowerLevelsWrittenInBackground) {
+    EXPECT_TRUE(cache->IsWriteBack());
+    
+    TileKey key(1, 2, 3);
+    EXPECT_TRUE(cache->PutTile(key, Data(1)));
+    EXPECT_TRUE(l1->HasTile(key));
+    
+    cache->Flush();
+    EXPECT_EQ(cache->GetPendingWriteCount(), 0u);
+    EXPECT_TRUE(l2->HasTile(key));
+}
+
+TEST_F(MultiLevelWriteBackTest, FirstLevelHitDoesNotWaitForLowerWrites) {
+    l2->Close();
+    TileKey key(1, 2, 3);
+    EXPECT_TRUE(cache->PutTile(key, Data(1)));
+    WaitForPending(*cache, 1);
+    
+    TileData tile = cache->GetTile(key);
+    EXPECT_TRUE(tile.IsValid());
+    EXPECT_FALSE(l2->HasTile(key));
+    
+    l2->Open();
+    cache->Flush();
+    EXPECT_TRUE(l2->HasTile(key));
+}
+
+TEST_F(MultiLevelWriteBackTest, WritesToSameTileCoalesce) {
+    l2->Close();
+    TileKey first(0, 0, 1);
+    TileKey second(1, 0, 1);
+    cache->PutTile(first, Data(1));
+    WaitForPending(*cache, 1);
+    
+    for (uint8_t i = 0; i < 5; ++i) {
+        cache->PutTile(second, Data(i));
+    }
+    EXPECT_EQ(cache->GetPendingWriteCount(), 2u);
+    
+    l2->Open();
+    cache->Flush();
+    EXPECT_EQ(l2->GetPutCount(), 2);
+    EXPECT_EQ(l2->GetTile(second).data, Data(4));
+}
+
+TEST_F(MultiLevelWriteBackTest, PendingTilesAreReadable) {
+    l2->Close();
+    cache->PutTile(TileKey(0, 0, 1), Data(1));
+    WaitForPending(*cache, 1);
+    
+    TileKey key(5, 5, 5);
+    cache->PutTile(key, Data(9));
+    l1->RemoveTile(key);
+    
+    EXPECT_TRUE(cache->HasTile(key));
+    EXPECT_EQ(cache->GetTile(key).data, Data(9));
+}
+
+TEST_F(MultiLevelWriteBackTest, QueueDepthIsBounded) {
+    cache->SetWriteQueueDepth(2);
+    EXPECT_EQ(cache->GetWriteQueueDepth(), 2u);
+    l2->Close();
+    
+    cache->PutTile(TileKey(0, 0, 1), Data(1));
+    WaitForPending(*cache, 1);
+    cache->PutTile(TileKey(1, 0, 1), Data(2));
+    cache->PutTile(TileKey(2, 0, 1), Data(3));
+    
+    std::atomic<bool> returned(false);
+    std::thread writer([&]() {
+        cache->PutTile(TileKey(3, 0, 1), Data(4));
+        returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(returned);
+    
+    l2->Open();
+    writer.join();
+    EXPECT_TRUE(returned);
+    cache->Flush();
+    EXPECT_TRUE(l2->HasTile(TileKey(3, 0, 1)));
+}
+
+TEST_F(MultiLevelWriteBackTest, RemoveCancelsPendingWrite) {
+    l2->Close();
+    cache->PutTile(TileKey(0, 0, 1), Data(1));
+    WaitForPending(*cache, 1);
+    
+    TileKey key(7, 7, 7);
+    cache->PutTile(key, Data(7));
+    
+    std::thread remover([&]() {
+        EXPECT_TRUE(cache->RemoveTile(key));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    l2->Open();
+    remover.join();
+    
+    cache->Flush();
+    EXPECT_FALSE(cache->HasTile(key));
+    EXPECT_FALSE(l2->HasTile(key));
+}
+
+TEST_F(MultiLevelWriteBackTest, PromotionGoesThroughQueue) {
+    TileKey key(4, 4, 4);
+    l2->PutTile(key, Data(4));
+    
+    TileData tile = cache->GetTile(key);
+    EXPECT_TRUE(tile.IsValid());
+    
+    cache->Flush();
+    EXPECT_TRUE(l1->HasTile(key));
+}
+
+TEST_F(MultiLevelWriteBackTest, DestructorDrainsQueue) {
+    for (int i = 0; i < 100; ++i) {
+        cache->PutTile(TileKey(i, 0, 8), Data(static_cast<uint8_t>(i)));
+    }
+    cache.reset();
+    
+    EXPECT_EQ(l2->GetTileCount(), 100u);
+}
+
+TEST_F(MultiLevelWriteBackTest, SynchronousWhenWriteBackDisabled) {
+    cache->SetWriteBack(false);
+    
+    TileKey key(1, 1, 1);
+    EXPECT_TRUE(cache->PutTile(key, Data(1)));
+    EXPECT_TRUE(l2->HasTile(key));
+    EXPECT_EQ(cache->GetPendingWriteCount(), 0u);
+}
+
+TEST(MultiLevelPromotionTest, StalePromotionIsDropped) {
+    for (bool writeBack : {true, false}) {
+        auto l1 = std::make_shared<MemoryTileCache>(1024 * 1024);
+        auto l2 = std::make_shared<PausedReadTileCache>();
+        MultiLevelTileCache cache;
+        cache.AddCache(l1);
+        cache.AddCache(l2);
+        cache.SetWriteBack(writeBack);
+        
+        TileKey key(3, 3, 3);
+        std::vector<uint8_t> stale(64, 1);
+        std::vector<uint8_t> fresh(64, 2);
+        l2->PutTile(key, stale);
+        
+        // The lookup hits the old copy in l2; a newer PutTile lands and is
+        // evicted from l1 before the promotion is written.
+        l2->Pause();
+        std::thread reader([&]() {
+            EXPECT_EQ(cache.GetTile(key).data, stale);
+        });
+        l2->WaitUntilReading();
+        cache.PutTile(key, fresh);
+        l1->RemoveTile(key);
+        l2->Resume();
+        reader.join();
+        cache.Flush();
+        
+        EXPECT_FALSE(l1->HasTile(key)) << "write-back " << writeBack;
+        EXPECT_EQ(cache.GetTile(key).data, fresh);
+    }
+}
@@ -416,6 +416,86 @@ TEST_F(OfflineStorageManagerTest, CompactStorage) {
     EXPECT_TRUE(manager->CompactStorage());
 }
 
+TEST_F(OfflineStorageManagerTest, IdenticalTilesStoredOnce) {
+    manager->Initialize();
+    
+    std::string regionId = manager->CreateRegion(
+        "TestRegion", -180, 180, -90, 90, 0, 5);
+    std::vector<uint8_t> sea(8192, 0x3C);
+    
+    std::vector<DownloadedTile> tiles;
+    for (int x = 0; x < 64; ++x) {
+        DownloadedTile tile;
+        tile.key = TileKey(x, 0, 6);
+        tile.data = sea;
+        tiles.push_back(tile);
+    }
+    EXPECT_TRUE(manager->StoreTiles(regionId, tiles));
+    
+    OfflineRegion region = manager->GetRegion(regionId);
+    EXPECT_EQ(region.tileCount, 64u);
+    EXPECT_EQ(region.dataSize, 64u * 8192);
+    EXPECT_LT(manager->GetStorageInfo().offlineDataSize, 4u * 8192);
+    EXPECT_EQ(manager->GetTile(regionId, TileKey(17, 0, 6)), sea);
+}
+
+TEST_F(OfflineStorageManagerTest, CompactStorageAfterDelete) {
+    manager->Initialize();
+    
+    std::string regionId = manager->CreateRegion(
+        "TestRegion", -180, 180, -90, 90, 0, 5);
+    for (int x = 0; x < 32; ++x) {
+        std::vector<uint8_t> data(2048, static_cast<uint8_t>(x));
+        EXPECT_TRUE(manager->StoreTile(regionId, TileKey(x, 0, 5), data));
+    }
+    for (int x = 0; x < 32; x += 2) {
+        EXPECT_TRUE(manager->DeleteTile(regionId, TileKey(x, 0, 5)));
+    }
+    EXPECT_EQ(manager->GetRegion(regionId).tileCount, 16u);
+    
+    size_t before = manager->GetStorageInfo().offlineDataSize;
+    EXPECT_TRUE(manager->CompactStorage());
+    EXPECT_LT(manager->GetStorageInfo().offlineDataSize, before);
+    EXPECT_TRUE(manager->ValidateStorage());
+    
+    std::vector<uint8_t> expected(2048, 7);
+    EXPECT_EQ(manager->GetTile(regionId, TileKey(7, 0, 5)), expected);
+    EXPECT_FALSE(manager->HasTile(regionId, TileKey(6, 0, 5)));
+}
+
+TEST_F(OfflineStorageManagerTest, ImportsLegacyTileFiles) {
+    manager->Initialize();
+    std::string regionId = manager->CreateRegion(
+        "TestRegion", -180, 180, -90, 90, 0, 5);
+    manager->Shutdown();
+    
+    std::string regionPath = m_testPath + "/tiles/" + regionId;
+#ifdef _WIN32
+    _mkdir(regionPath.c_str());
+    _mkdir((regionPath + "/3").c_str());
+    _mkdir((regionPath + "/3/2").c_str());
+#else
+    mkdir(regionPath.c_str(), 0755);
+    mkdir((regionPath + "/3").c_str(), 0755);
+    mkdir((regionPath + "/3/2").c_str(), 0755);
+#endif
+    {
+        std::ofstream file(regionPath + "/3/2/5.tile", std::ios::binary);
+        file << "legacy";
+    }
+    
+    ASSERT_TRUE(manager->Initialize());
+    std::string data;
+    for (uint8_t c : manager->GetTile(regionId, TileKey(2, 5, 3))) {
+        data += static_cast<char>(c);
+    }
+    EXPECT_EQ(data, "legacy");
+    EXPECT_EQ(manager->GetRegion(regionId).tileCount, 1u);
+    
+    struct stat statBuf;
+    EXPECT_NE(stat(regionPath.c_str(), &statBuf), 0);
+}
+
 TEST_F(OfflineStorageManagerTest, Reinitialize) {
     manager->Initialize();
     manager->Shutdown();
@@ -0,0 +1,342 @@
+#include <gtest/gtest.h>
+#include <ogc/cache/offline/region_downloader.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdirFunc(path) _mkdir(path)
+#else
+#include <unistd.h>
+#define mkdirFunc(path) mkdir(path, 0755)
+#endif
+
+using namespace ogc::cache;
+
+namespace {
+
+void MakeDirs(const std::string& path) {
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        mkdirFunc(path.substr(0, pos).c_str());
+    }
+    mkdirFunc(path.c_str());
+}
+
+void WriteTile(const std::string& root, const TileKey& key, const std::string& content) {
+    std::string dir = root + "/" + std::to_string(key.z) + "/" + std::to_string(key.x);
+    MakeDirs(dir);
+    std::ofstream file(dir + "/" + std::to_string(key.y) + ".png", std::ios::binary);
+    file << content;
+}
+
+class CountingTileSource : public TileSource {
+public:
+    explicit CountingTileSource(TileSourcePtr inner, int delayMs = 0)
+        : m_inner(inner), m_delayMs(delayMs), m_fetches(0) {}
+
+    bool FetchTile(const TileKey& key, int timeoutSeconds, TileFetchResult& result) override {
+        ++m_fetches;
+        if (m_delayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_delayMs));
+        }
+        return m_inner->FetchTile(key, timeoutSeconds, result);
+    }
+
+    bool GetTileHash(const TileKey& key, std::string& hash) override {
+        return m_inner->GetTileHash(key, hash);
+    }
+
+    std::string GetName() const override { return "counting"; }
+
+    int GetFetches() const { return m_fetches.load(); }
+
+private:
+    TileSourcePtr m_inner;
+    int m_delayMs;
+    std::atomic<int> m_fetches;
+};
+
+}
+
+class RegionDownloaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_root = "./test_region_downloader";
+        m_sourcePath = m_root + "/source";
+        m_journalPath = m_root + "/region.journal";
+        MakeDirs(m_sourcePath);
+        std::remove(m_journalPath.c_str());
+
+        m_region.id = "region";
+        m_region.minLon = 0.0;
+        m_region.maxLon = 20.0;
+        m_region.minLat = 0.0;
+        m_region.maxLat = 20.0;
+        m_region.minZoom = 0;
+        m_region.maxZoom = 6;
+
+        m_total = 0;
+        for (const auto& range : ComputeTileRanges(0.0, 20.0, 0.0, 20.0, 0, 6)) {
+            for (int x = range.minX; x <= range.maxX; ++x) {
+                for (int y = range.minY; y <= range.maxY; ++y) {
+                    WriteTile(m_sourcePath, TileKey(x, y, range.z), "tile " + TileKey(x, y, range.z).ToString());
+                    ++m_total;
+                }
+            }
+        }
+        m_source = std::make_shared<CountingTileSource>(
+            FileTileSource::Create(m_sourcePath + "/{z}/{x}/{y}.png"));
+    }
+
+    void TearDown() override {
+        std::remove(m_journalPath.c_str());
+    }
+
+    std::unique_ptr<RegionDownloader> MakeDownloader(TileSourcePtr source, const DownloadOptions& options) {
+        return std::unique_ptr<RegionDownloader>(new RegionDownloader(
+            m_region, source, m_journalPath, options,
+            [this](const TileKey& key) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_stored.count(key) > 0;
+            },
+            [this](const std::vector<DownloadedTile>& tiles) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_batches;
+                for (const auto& tile : tiles) {
+                    m_stored.insert(tile.key);
+                }
+                return true;
+            }));
+    }
+
+    std::string m_root;
+    std::string m_sourcePath;
+    std::string m_journalPath;
+    OfflineRegion m_region;
+    int m_total;
+    std::shared_ptr<CountingTileSource> m_source;
+
+    std::mutex m_mutex;
+    std::set<TileKey> m_stored;
+    int m_batches = 0;
+};
+
+TEST(TileRangeTest, ClampsToMercatorGrid) {
+    std::vector<TileRange> ranges = ComputeTileRanges(-180, 180, -90, 90, 0, 2);
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].GetCount(), 1u);
+    EXPECT_EQ(ranges[1].GetCount(), 4u);
+    EXPECT_EQ(ranges[2].GetCount(), 16u);
+    EXPECT_EQ(OfflineStorageManager::CalculateTileCount(-180, 180, -90, 90, 0, 2), 21);
+}
+
+TEST_F(RegionDownloaderTest, DownloadsAllTilesInBatches) {
+    DownloadOptions options;
+    options.writeBatchSize = 8;
+    auto downloader = MakeDownloader(m_source, options);
+
+    DownloadProgress last;
+    StorageError result = StorageError::kWriteFailed;
+    downloader->Start([&last](const DownloadProgress& p) { last = p; },
+                      [&result](StorageError e) { result = e; });
+    ASSERT_TRUE(downloader->Wait(10000));
+
+    EXPECT_EQ(result, StorageError::kNone);
+    EXPECT_EQ(static_cast<int>(m_stored.size()), m_total);
+    EXPECT_LE(m_batches, m_total);
+    EXPECT_EQ(last.status, "Completed");
+    EXPECT_EQ(last.totalTiles, m_total);
+    EXPECT_EQ(last.downloadedTiles, m_total);
+    EXPECT_DOUBLE_EQ(last.progress, 1.0);
+    EXPECT_GT(last.bytesDownloaded, 0u);
+}
+
+TEST_F(RegionDownloaderTest, ResumesFromJournal) {
+    auto first = MakeDownloader(m_source, DownloadOptions());
+    first->Start(nullptr, nullptr);
+    ASSERT_TRUE(first->Wait(10000));
+    EXPECT_EQ(m_source->GetFetches(), m_total);
+
+    int batches = m_batches;
+    auto second = MakeDownloader(m_source, DownloadOptions());
+    DownloadProgress last;
+    second->Start([&last](const DownloadProgress& p) { last = p; }, nullptr);
+    ASSERT_TRUE(second->Wait(10000));
+
+    EXPECT_EQ(m_source->GetFetches(), m_total);
+    EXPECT_EQ(last.skippedTiles, m_total);
+    EXPECT_EQ(m_batches, batches);
+}
+
+TEST_F(RegionDownloaderTest, RefetchesJournalledTilesNoLongerStored) {
+    auto first = MakeDownloader(m_source, DownloadOptions());
+    first->Start(nullptr, nullptr);
+    ASSERT_TRUE(first->Wait(10000));
+
+    // The store lost the tiles (evicted or cleared) but the journal still lists them.
+    m_stored.clear();
+    auto second = MakeDownloader(m_source, DownloadOptions());
+    DownloadProgress last;
+    second->Start([&last](const DownloadProgress& p) { last = p; }, nullptr);
+    ASSERT_TRUE(second->Wait(10000));
+
+    EXPECT_EQ(m_source->GetFetches(), 2 * m_total);
+    EXPECT_EQ(last.skippedTiles, 0);
+    EXPECT_EQ(static_cast<int>(m_stored.size()), m_total);
+}
+
+TEST_F(RegionDownloaderTest, RefetchesChangedTiles) {
+    auto first = MakeDownloader(m_source, DownloadOptions());
+    first->Start(nullptr, nullptr);
+    ASSERT_TRUE(first->Wait(10000));
+
+    WriteTile(m_sourcePath, TileKey(0, 0, 0), "updated world tile");
+    int batches = m_batches;
+    auto second = MakeDownloader(m_source, DownloadOptions());
+    second->Start(nullptr, nullptr);
+    ASSERT_TRUE(second->Wait(10000));
+
+    EXPECT_EQ(m_source->GetFetches(), m_total + 1);
+    EXPECT_EQ(m_batches, batches + 1);
+}
+
+TEST_F(RegionDownloaderTest, ReportsMissingTilesAsFailures) {
+    std::remove((m_sourcePath + "/0/0/0.png").c_str());
+
+    DownloadOptions options;
+    options.retryCount = 2;
+    auto downloader = MakeDownloader(m_source, options);
+
+    DownloadProgress last;
+    StorageError result = StorageError::kNone;
+    downloader->Start([&last](const DownloadProgress& p) { last = p; },
+                      [&result](StorageError e) { result = e; });
+    ASSERT_TRUE(downloader->Wait(10000));
+
+    EXPECT_EQ(result, StorageError::kDownloadFailed);
+    EXPECT_EQ(last.failedTiles, 1);
+    EXPECT_EQ(last.status, "Failed");
+    EXPECT_FALSE(last.errorMessage.empty());
+    EXPECT_EQ(m_source->GetFetches(), m_total - 1 + 3);
+}
+
+TEST_F(RegionDownloaderTest, StopKeepsProgressForResume) {
+    auto slow = std::make_shared<CountingTileSource>(
+        FileTileSource::Create(m_sourcePath + "/{z}/{x}/{y}.png"), 5);
+    DownloadOptions options;
+    options.maxConcurrent = 2;
+    options.writeBatchSize = 1;
+
+    bool completed = false;
+    auto first = MakeDownloader(slow, options);
+    first->Start(nullptr, [&completed](StorageError) { completed = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    first->Stop();
+    EXPECT_FALSE(first->IsRunning());
+    EXPECT_FALSE(completed);
+
+    size_t storedBeforeResume = m_stored.size();
+    EXPECT_LT(static_cast<int>(storedBeforeResume), m_total);
+
+    auto second = MakeDownloader(slow, options);
+    second->Start(nullptr, [&completed](StorageError) { completed = true; });
+    ASSERT_TRUE(second->Wait(10000));
+
+    EXPECT_TRUE(completed);
+    EXPECT_EQ(static_cast<int>(m_stored.size()), m_total);
+    EXPECT_EQ(slow->GetFetches(), m_total);
+}
+
+TEST_F(RegionDownloaderTest, ManagerDownloadsThroughTileSource) {
+    std::string storage = m_root + "/storage";
+    auto manager = OfflineStorageManager::Create(storage);
+    ASSERT_TRUE(manager->Initialize());
+    manager->SetTileSource(m_source);
+
+    std::string regionId = manager->CreateRegion("Test", 0.0, 20.0, 0.0, 20.0, 0, 6);
+    StorageError result = StorageError::kWriteFailed;
+    manager->StartDownload(regionId, nullptr, [&result](StorageError e) { result = e; });
+    ASSERT_TRUE(manager->WaitForDownload(regionId, 10000));
+
+    EXPECT_EQ(result, StorageError::kNone);
+    EXPECT_FALSE(manager->IsDownloading(regionId));
+    EXPECT_EQ(static_cast<int>(manager->GetRegion(regionId).tileCount), m_total);
+    EXPECT_TRUE(manager->HasTile(regionId, TileKey(0, 0, 0)));
+
+    EXPECT_TRUE(manager->DeleteRegion(regionId));
+}
+
+TEST_F(RegionDownloaderTest, CompletionCallbackCanRestartAndDeleteRegion) {
+    std::string storage = m_root + "/storage_restart";
+    auto manager = OfflineStorageManager::Create(storage);
+    ASSERT_TRUE(manager->Initialize());
+    manager->SetTileSource(m_source);
+    std::string regionId = manager->CreateRegion("Test", 0.0, 20.0, 0.0, 20.0, 0, 6);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    int completions = 0;
+    bool deleted = false;
+    bool done = false;
+    OfflineStorageManager* raw = manager.get();
+    OfflineStorageManager::CompletionCallback onComplete;
+    onComplete = [&](StorageError) {
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            count = ++completions;
+        }
+        if (count == 1) {
+            raw->StartDownload(regionId, nullptr, onComplete);
+            return;
+        }
+        bool result = raw->DeleteRegion(regionId);
+        std::lock_guard<std::mutex> lock(mutex);
+        deleted = result;
+        done = true;
+        condition.notify_all();
+    };
+    manager->StartDownload(regionId, nullptr, onComplete);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(condition.wait_for(lock, std::chrono::seconds(10), [&]() { return done; }));
+    }
+    EXPECT_EQ(completions, 2);
+    EXPECT_TRUE(deleted);
+    EXPECT_EQ(m_source->GetFetches(), m_total);
+    EXPECT_TRUE(manager->WaitForDownload(regionId, 10000));
+    EXPECT_EQ(manager->GetRegionCount(), 0u);
+}
+
+TEST_F(RegionDownloaderTest, ClearingOfflineDataDropsJournals) {
+    std::string storage = m_root + "/storage_clear";
+    auto manager = OfflineStorageManager::Create(storage);
+    ASSERT_TRUE(manager->Initialize());
+    manager->SetTileSource(m_source);
+
+    std::string regionId = manager->CreateRegion("Test", 0.0, 20.0, 0.0, 20.0, 0, 6);
+    manager->StartDownload(regionId, nullptr, nullptr);
+    ASSERT_TRUE(manager->WaitForDownload(regionId, 10000));
+
+    std::string journal = storage + "/regions/" + regionId + ".journal";
+    struct stat statBuf;
+    EXPECT_EQ(stat(journal.c_str(), &statBuf), 0);
+
+    manager->ClearAllOfflineData();
+    EXPECT_NE(stat(journal.c_str(), &statBuf), 0);
+
+    manager->StartDownload(regionId, nullptr, nullptr);
+    ASSERT_TRUE(manager->WaitForDownload(regionId, 10000));
+    EXPECT_EQ(m_source->GetFetches(), 2 * m_total);
+    EXPECT_TRUE(manager->HasTile(regionId, TileKey(0, 0, 0)));
+
+    EXPECT_TRUE(manager->DeleteRegion(regionId));
+    EXPECT_NE(stat(journal.c_str(), &statBuf), 0);
+}
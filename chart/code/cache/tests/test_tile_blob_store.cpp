@@ -0,0 +1,357 @@
+#include <gtest/gtest.h>
+#include <ogc/cache/offline/tile_blob_store.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+using namespace ogc::cache;
+
+namespace {
+
+void DeleteDirectoryRecursive(const std::string& path) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA findData;
+    std::string searchPath = path + "\\*";
+    HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
+
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (strcmp(findData.cFileName, ".") != 0 &&
+                strcmp(findData.cFileName, "..") != 0) {
+                _unlink((path + "\\" + findData.cFileName).c_str());
+            }
+        } while (FindNextFileA(hFind, &findData));
+        FindClose(hFind);
+    }
+    _rmdir(path.c_str());
+#else
+    DIR* dir = opendir(path.c_str());
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+#endif
+}
+
+std::vector<uint8_t> MakeTile(int seed, size_t size = 1024) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>((seed * 31 + i * 7) & 0xFF);
+    }
+    data[0] = static_cast<uint8_t>(seed);
+    data[1] = static_cast<uint8_t>(seed >> 8);
+    return data;
+}
+
+}
+
+class TileBlobStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_path = "./test_tile_blob_store";
+        DeleteDirectoryRecursive(m_path);
+    }
+
+    void TearDown() override {
+        DeleteDirectoryRecursive(m_path);
+    }
+
+    std::string m_path;
+};
+
+TEST_F(TileBlobStoreTest, PutAndGet) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+
+    std::vector<uint8_t> tile = MakeTile(1);
+    EXPECT_TRUE(store.Put("r1", TileKey(1, 2, 3), tile));
+    EXPECT_TRUE(store.Has("r1", TileKey(1, 2, 3)));
+    EXPECT_FALSE(store.Has("r1", TileKey(1, 2, 4)));
+    EXPECT_FALSE(store.Has("r2", TileKey(1, 2, 3)));
+
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(store.Get("r1", TileKey(1, 2, 3), data));
+    EXPECT_EQ(data, tile);
+    EXPECT_FALSE(store.Get("r1", TileKey(9, 9, 9), data));
+}
+
+TEST_F(TileBlobStoreTest, IdenticalTilesShareOneBlob) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+
+    std::vector<uint8_t> sea = MakeTile(7, 4096);
+    for (int x = 0; x < 50; ++x) {
+        EXPECT_TRUE(store.Put("r1", TileKey(x, 0, 10), sea));
+        EXPECT_TRUE(store.Put("r2", TileKey(x, 1, 10), sea));
+    }
+
+    TileBlobStoreStats stats = store.GetStats();
+    EXPECT_EQ(stats.tileCount, 100u);
+    EXPECT_EQ(stats.blobCount, 1u);
+    EXPECT_EQ(stats.logicalBytes, 100u * 4096);
+    EXPECT_EQ(stats.liveBytes, 4096u);
+    EXPECT_LT(stats.fileBytes, 2u * 4096);
+    EXPECT_EQ(store.GetTileCount("r1"), 50u);
+    EXPECT_EQ(store.GetRegionBytes("r2"), 50u * 4096);
+}
+
+TEST_F(TileBlobStoreTest, OverwriteReleasesPreviousBlob) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 1), MakeTile(1)));
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 1), MakeTile(2, 512)));
+
+    TileBlobStoreStats stats = store.GetStats();
+    EXPECT_EQ(stats.tileCount, 1u);
+    EXPECT_EQ(stats.blobCount, 1u);
+    EXPECT_EQ(stats.liveBytes, 512u);
+    EXPECT_EQ(store.GetRegionBytes("r1"), 512u);
+
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(store.Get("r1", TileKey(0, 0, 1), data));
+    EXPECT_EQ(data, MakeTile(2, 512));
+}
+
+TEST_F(TileBlobStoreTest, RemoveKeepsSharedBlobsAlive) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+
+    std::vector<uint8_t> land = MakeTile(3);
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 2), land));
+    EXPECT_TRUE(store.Put("r2", TileKey(0, 0, 2), land));
+
+    EXPECT_TRUE(store.Remove("r1", TileKey(0, 0, 2)));
+    EXPECT_FALSE(store.Remove("r1", TileKey(0, 0, 2)));
+    EXPECT_EQ(store.GetStats().blobCount, 1u);
+
+    std::vector<uint8_t> data;
+    EXPECT_TRUE(store.Get("r2", TileKey(0, 0, 2), data));
+    EXPECT_EQ(data, land);
+
+    store.RemoveRegion("r2");
+    EXPECT_FALSE(store.Has("r2", TileKey(0, 0, 2)));
+    EXPECT_EQ(store.GetStats().blobCount, 0u);
+    EXPECT_EQ(store.GetStats().liveBytes, 0u);
+}
+
+TEST_F(TileBlobStoreTest, ReopenReplaysIndex) {
+    {
+        TileBlobStore store(m_path);
+        ASSERT_TRUE(store.Open());
+        for (int i = 0; i < 20; ++i) {
+            EXPECT_TRUE(store.Put("r1", TileKey(i, i, 5), MakeTile(i % 5)));
+        }
+        EXPECT_TRUE(store.Remove("r1", TileKey(3, 3, 5)));
+        store.RemoveRegion("gone");
+        EXPECT_TRUE(store.Flush());
+        EXPECT_TRUE(store.Sync());
+    }
+
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+    EXPECT_EQ(store.GetTileCount("r1"), 19u);
+    EXPECT_EQ(store.GetStats().blobCount, 5u);
+    EXPECT_FALSE(store.Has("r1", TileKey(3, 3, 5)));
+
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 20; ++i) {
+        if (i == 3) continue;
+        ASSERT_TRUE(store.Get("r1", TileKey(i, i, 5), data));
+        EXPECT_EQ(data, MakeTile(i % 5));
+    }
+    EXPECT_TRUE(store.Validate());
+
+    EXPECT_TRUE(store.Put("r1", TileKey(3, 3, 5), MakeTile(3)));
+    EXPECT_EQ(store.GetStats().blobCount, 5u);
+}
+
+TEST_F(TileBlobStoreTest, CompactReclaimsDeadSpace) {
+    TileBlobStore store(m_path, 16 * 1024);
+    ASSERT_TRUE(store.Open());
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(store.Put("r1", TileKey(i, 0, 8), MakeTile(i)));
+    }
+    for (int i = 0; i < 100; ++i) {
+        if (i % 4 != 0) {
+            EXPECT_TRUE(store.Remove("r1", TileKey(i, 0, 8)));
+        }
+    }
+
+    TileBlobStoreStats before = store.GetStats();
+    EXPECT_EQ(before.liveBytes, 25u * 1024);
+    EXPECT_GT(before.fileBytes, 100u * 1024);
+
+    EXPECT_TRUE(store.Compact());
+
+    TileBlobStoreStats after = store.GetStats();
+    EXPECT_EQ(after.liveBytes, 25u * 1024);
+    EXPECT_LT(after.fileBytes, 30u * 1024);
+    EXPECT_LT(after.segmentCount, before.segmentCount);
+
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 100; i += 4) {
+        ASSERT_TRUE(store.Get("r1", TileKey(i, 0, 8), data));
+        EXPECT_EQ(data, MakeTile(i));
+    }
+    EXPECT_TRUE(store.Validate());
+
+    store.Close();
+    ASSERT_TRUE(store.Open());
+    EXPECT_EQ(store.GetTileCount("r1"), 25u);
+    for (int i = 0; i < 100; i += 4) {
+        ASSERT_TRUE(store.Get("r1", TileKey(i, 0, 8), data));
+        EXPECT_EQ(data, MakeTile(i));
+    }
+}
+
+TEST_F(TileBlobStoreTest, CompactWithBudgetMakesProgress) {
+    TileBlobStore store(m_path, 8 * 1024);
+    ASSERT_TRUE(store.Open());
+
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_TRUE(store.Put("r1", TileKey(i, 0, 8), MakeTile(i)));
+    }
+    for (int i = 0; i < 64; i += 2) {
+        EXPECT_TRUE(store.Remove("r1", TileKey(i, 0, 8)));
+    }
+
+    uint64_t fileBytes = store.GetStats().fileBytes;
+    EXPECT_TRUE(store.Compact(0.75, 4 * 1024));
+    EXPECT_LT(store.GetStats().fileBytes, fileBytes);
+
+    for (int round = 0; round < 20; ++round) {
+        EXPECT_TRUE(store.Compact(0.75, 4 * 1024));
+    }
+    EXPECT_LT(store.GetStats().fileBytes, 40u * 1024);
+
+    std::vector<uint8_t> data;
+    for (int i = 1; i < 64; i += 2) {
+        ASSERT_TRUE(store.Get("r1", TileKey(i, 0, 8), data));
+        EXPECT_EQ(data, MakeTile(i));
+    }
+}
+
+TEST_F(TileBlobStoreTest, CompactIsDurableWithoutFlush) {
+    TileBlobStore store(m_path, 8 * 1024);
+    ASSERT_TRUE(store.Open());
+
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_TRUE(store.Put("r1", TileKey(i, 0, 8), MakeTile(i)));
+    }
+    for (int i = 0; i < 64; i += 2) {
+        EXPECT_TRUE(store.Remove("r1", TileKey(i, 0, 8)));
+    }
+    int segments = store.GetStats().segmentCount;
+    EXPECT_TRUE(store.Compact(0.75, 4 * 1024));
+    EXPECT_LT(store.GetStats().segmentCount, segments);
+
+    // A second instance sees what a restart after a crash would see: the
+    // first one is neither flushed nor closed.
+    TileBlobStore reopened(m_path, 8 * 1024);
+    ASSERT_TRUE(reopened.Open());
+    EXPECT_EQ(reopened.GetTileCount("r1"), 32u);
+    std::vector<uint8_t> data;
+    for (int i = 1; i < 64; i += 2) {
+        ASSERT_TRUE(reopened.Get("r1", TileKey(i, 0, 8), data));
+        EXPECT_EQ(data, MakeTile(i));
+    }
+    EXPECT_TRUE(reopened.Validate());
+}
+
+TEST_F(TileBlobStoreTest, ReadersRunDuringCompaction) {
+    TileBlobStore store(m_path, 32 * 1024);
+    ASSERT_TRUE(store.Open());
+
+    for (int i = 0; i < 400; ++i) {
+        EXPECT_TRUE(store.Put("r1", TileKey(i, 0, 9), MakeTile(i)));
+    }
+    for (int i = 0; i < 400; ++i) {
+        if (i % 3 != 0) {
+            EXPECT_TRUE(store.Remove("r1", TileKey(i, 0, 9)));
+        }
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<int> mismatches(0);
+    std::atomic<int> reads(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            std::vector<uint8_t> data;
+            int i = t * 3;
+            while (!done || reads < 400) {
+                if (!store.Get("r1", TileKey(i, 0, 9), data) || data != MakeTile(i)) {
+                    ++mismatches;
+                }
+                ++reads;
+                i = (i + 3) % 399;
+            }
+        });
+    }
+
+    EXPECT_TRUE(store.Compact());
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_EQ(store.GetStats().liveBytes, 134u * 1024);
+    EXPECT_TRUE(store.Validate());
+}
+
+TEST_F(TileBlobStoreTest, ValidateDetectsCorruption) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 1), MakeTile(1)));
+    EXPECT_TRUE(store.Validate());
+    store.Close();
+
+    FILE* file = fopen((m_path + "/blobs_000001.seg").c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    fseek(file, 100, SEEK_SET);
+    fputc(0x5A, file);
+    fclose(file);
+
+    ASSERT_TRUE(store.Open());
+    EXPECT_FALSE(store.Validate());
+}
+
+TEST_F(TileBlobStoreTest, ClearRemovesEverything) {
+    TileBlobStore store(m_path);
+    ASSERT_TRUE(store.Open());
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 1), MakeTile(1)));
+    EXPECT_TRUE(store.Put("r2", TileKey(0, 0, 1), MakeTile(2)));
+
+    store.Clear();
+    TileBlobStoreStats stats = store.GetStats();
+    EXPECT_EQ(stats.tileCount, 0u);
+    EXPECT_EQ(stats.fileBytes, 0u);
+    EXPECT_FALSE(store.Has("r1", TileKey(0, 0, 1)));
+
+    EXPECT_TRUE(store.Put("r1", TileKey(0, 0, 1), MakeTile(1)));
+    store.Close();
+    ASSERT_TRUE(store.Open());
+    EXPECT_EQ(store.GetTileCount("r1"), 1u);
+    EXPECT_EQ(store.GetTileCount("r2"), 0u);
+}
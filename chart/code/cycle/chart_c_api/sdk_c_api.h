@@ -2228,6 +2228,103 @@ SDK_C_API void ogc_layer_set_spatial_filter_rect(ogc_layer_t* layer, double min_
  */
 SDK_C_API void ogc_layer_set_attribute_filter(ogc_layer_t* layer, const char* filter);
 
+/* 4.9 Batch Feature Access */
+/* C++:   ogc::CNLayer (GetNextFeatureRef / GetNextFeature) */
+/* Header: ogc/layer/layer.h */
+
+/**
+ * @brief Borrowed, non NUL-terminated view of string bytes.
+ * @note Valid until the next ogc_layer_cursor_next_batch() or
+ *       ogc_layer_cursor_destroy() call on the cursor that produced it.
+ */
+typedef struct ogc_string_view_t {
+    const char* data;  /**< Pointer to the first byte, NULL if the value is null */
+    size_t size;       /**< Number of bytes */
+} ogc_string_view_t;
+
+/**
+ * @brief Caller-provided output column for one attribute field.
+ *
+ * Any of the value arrays may be NULL; only the non-NULL ones are filled.
+ * Each non-NULL array must hold at least ogc_feature_batch_t::capacity entries.
+ */
+typedef struct ogc_field_column_t {
+    int field_index;                 /**< [in]  Field index in the layer's feature definition */
+    int64_t* int_values;             /**< [out] Values converted to 64-bit integer, 0 if not convertible */
+    double* real_values;             /**< [out] Values converted to double, 0.0 if not convertible */
+    ogc_string_view_t* str_values;   /**< [out] Borrowed string views */
+    unsigned char* null_flags;       /**< [out] 1 if the field is null or unset, otherwise 0 */
+} ogc_field_column_t;
+
+/**
+ * @brief Caller-provided buffers for one batch of features in columnar form.
+ *
+ * Coordinates of all features are written back to back into coords, with
+ * coord_dim doubles per coordinate. Feature i owns coordinates
+ * [coord_offsets[i], coord_offsets[i + 1]). When part_offsets is supplied,
+ * each part (point, line string or polygon ring) is recorded as well:
+ * feature i owns parts [feature_part_offsets[i], feature_part_offsets[i + 1])
+ * and part j owns coordinates [part_offsets[j], part_offsets[j + 1]).
+ *
+ * Any output pointer may be NULL to skip that column. The count fields are
+ * written by ogc_layer_cursor_next_batch().
+ */
+typedef struct ogc_feature_batch_t {
+    size_t capacity;                 /**< [in]  Maximum number of features per batch */
+    int64_t* fids;                   /**< [out] Feature IDs [capacity] */
+    unsigned char* geom_types;       /**< [out] ogc_geom_type_e per feature [capacity] */
+    double* coords;                  /**< [out] Interleaved coordinates [coord_capacity * coord_dim] */
+    size_t coord_capacity;           /**< [in]  Number of coordinates coords can hold */
+    int coord_dim;                   /**< [in]  2 for XY, 3 for XYZ (Z is 0 if absent) */
+    size_t* coord_offsets;           /**< [out] Coordinate offsets [capacity + 1] */
+    size_t* part_offsets;            /**< [out] Part coordinate offsets [part_capacity + 1] */
+    size_t part_capacity;            /**< [in]  Number of parts part_offsets can describe */
+    size_t* feature_part_offsets;    /**< [out] Part offsets per feature [capacity + 1] */
+    ogc_field_column_t* columns;     /**< [in/out] Selected attribute columns */
+    size_t column_count;             /**< [in]  Number of entries in columns */
+    size_t count;                    /**< [out] Number of features written */
+    size_t coord_count;              /**< [out] Number of coordinates written (or required, see below) */
+    size_t part_count;               /**< [out] Number of parts written (or required, see below) */
+} ogc_feature_batch_t;
+
+/**
+ * @brief Opaque type representing a batch read cursor over a layer.
+ */
+typedef struct ogc_feature_cursor_t ogc_feature_cursor_t;
+
+/**
+ * @brief Create a batch cursor and reset the layer's reading position.
+ * @param layer Pointer to the layer. The layer must outlive the cursor and
+ *              must not be modified while the cursor is in use.
+ * @return Pointer to newly created cursor, or NULL on failure.
+ */
+SDK_C_API ogc_feature_cursor_t* ogc_layer_cursor_create(ogc_layer_t* layer);
+
+/**
+ * @brief Destroy a batch cursor and release all borrowed views it handed out.
+ * @param cursor Pointer to the cursor.
+ */
+SDK_C_API void ogc_layer_cursor_destroy(ogc_feature_cursor_t* cursor);
+
+/**
+ * @brief Fill a batch with up to batch->capacity features.
+ *
+ * Features are taken by reference from layers that support it, so no feature
+ * or geometry is copied. Borrowed features may be reused by the layer for the
+ * next row, so their strings are copied into a buffer owned by the cursor;
+ * strings of features the cursor owns are returned as views into them. Either
+ * way they stay valid until the next call on this cursor.
+ *
+ * @param cursor Pointer to the cursor.
+ * @param batch Pointer to the caller-provided batch buffers.
+ * @return OGC_SUCCESS on success; batch->count is 0 once the layer is exhausted.
+ *         OGC_ERROR_OUT_OF_MEMORY if the next feature alone does not fit the
+ *         coordinate or part buffers; batch->coord_count and batch->part_count
+ *         then hold the required sizes and the feature is kept for the next call.
+ *         OGC_ERROR_INVALID_PARAM or OGC_ERROR_NULL_POINTER on bad arguments.
+ */
+SDK_C_API int ogc_layer_cursor_next_batch(ogc_feature_cursor_t* cursor, ogc_feature_batch_t* batch);
+
 /* ============================================================================
  * 5. Draw Module (ogc_draw)
  * ============================================================================
@@ -14,11 +14,16 @@
 #include <ogc/layer/datasource.h>
 #include <ogc/layer/driver_manager.h>
 #include <ogc/feature/feature.h>
+#include <ogc/geom/point.h>
+#include <ogc/geom/linestring.h>
+#include <ogc/geom/polygon.h>
 
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace ogc;
 
@@ -56,6 +61,245 @@ static ogc_geom_type_e ToCGeomType(GeomType type) {
     }
 }
 
+
+struct FeatureCursor {
+    struct StringFixup {
+        ogc_string_view_t* view;
+        size_t offset;
+    };
+
+    explicit FeatureCursor(CNLayer* l)
+        : layer(l), mode_known(false), borrowed(false), pending(nullptr) {}
+
+    CNLayer* layer;
+    bool mode_known;
+    bool borrowed;
+    CNFeature* pending;
+    std::unique_ptr<CNFeature> pending_owned;
+    std::vector<std::unique_ptr<CNFeature>> owned;
+    std::string arena;
+    std::vector<StringFixup> fixups;
+};
+
+static CNFeature* NextCursorFeature(FeatureCursor* cursor) {
+    if (cursor->pending) {
+        CNFeature* feature = cursor->pending;
+        cursor->pending = nullptr;
+        if (cursor->pending_owned) {
+            cursor->owned.push_back(std::move(cursor->pending_owned));
+        }
+        return feature;
+    }
+    if (!cursor->mode_known || cursor->borrowed) {
+        CNFeature* ref = cursor->layer->GetNextFeatureRef();
+        if (ref) {
+            cursor->mode_known = true;
+            cursor->borrowed = true;
+            return ref;
+        }
+        if (cursor->mode_known) {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<CNFeature> feature = cursor->layer->GetNextFeature();
+    if (!feature) {
+        return nullptr;
+    }
+    cursor->mode_known = true;
+    cursor->owned.push_back(std::move(feature));
+    return cursor->owned.back().get();
+}
+
+static void KeepPending(FeatureCursor* cursor, CNFeature* feature) {
+    cursor->pending = feature;
+    if (!cursor->owned.empty() && cursor->owned.back().get() == feature) {
+        cursor->pending_owned = std::move(cursor->owned.back());
+        cursor->owned.pop_back();
+    }
+}
+
+static void CountGeometry(const Geometry* geom, size_t& coords, size_t& parts) {
+    switch (geom->GetGeometryType()) {
+        case GeomType::kPoint:
+            if (!geom->IsEmpty()) {
+                coords += 1;
+                parts += 1;
+            }
+            break;
+        case GeomType::kPolygon: {
+            const Polygon* polygon = static_cast<const Polygon*>(geom);
+            size_t rings = polygon->GetNumRings();
+            for (size_t i = 0; i < rings; ++i) {
+                const LinearRing* ring = i == 0 ? polygon->GetExteriorRing()
+                                                : polygon->GetInteriorRingN(i - 1);
+                if (ring) {
+                    coords += ring->GetNumPoints();
+                    parts += 1;
+                }
+            }
+            break;
+        }
+        case GeomType::kMultiPoint:
+        case GeomType::kMultiLineString:
+        case GeomType::kMultiPolygon:
+        case GeomType::kGeometryCollection: {
+            size_t n = geom->GetNumGeometries();
+            for (size_t i = 0; i < n; ++i) {
+                const Geometry* child = geom->GetGeometryN(i);
+                if (child) {
+                    CountGeometry(child, coords, parts);
+                }
+            }
+            break;
+        }
+        default:
+            coords += geom->GetNumCoordinates();
+            parts += 1;
+            break;
+    }
+}
+
+static void WriteCoordinate(ogc_feature_batch_t* batch, size_t pos,
+                            double x, double y, double z) {
+    double* out = batch->coords + pos * static_cast<size_t>(batch->coord_dim);
+    out[0] = x;
+    out[1] = y;
+    if (batch->coord_dim == 3) {
+        out[2] = std::isnan(z) ? 0.0 : z;
+    }
+}
+
+static void BeginPart(ogc_feature_batch_t* batch, size_t& coord_pos, size_t& part_pos) {
+    if (batch->part_offsets) {
+        batch->part_offsets[part_pos] = coord_pos;
+    }
+    part_pos++;
+}
+
+static void WriteGeometry(const Geometry* geom, ogc_feature_batch_t* batch,
+                          size_t& coord_pos, size_t& part_pos) {
+    switch (geom->GetGeometryType()) {
+        case GeomType::kPoint: {
+            if (geom->IsEmpty()) {
+                break;
+            }
+            BeginPart(batch, coord_pos, part_pos);
+            if (batch->coords) {
+                Coordinate c = static_cast<const Point*>(geom)->GetCoordinate();
+                WriteCoordinate(batch, coord_pos, c.x, c.y, c.z);
+            }
+            coord_pos++;
+            break;
+        }
+        case GeomType::kLineString: {
+            BeginPart(batch, coord_pos, part_pos);
+            const double* data = nullptr;
+            size_t count = 0;
+            if (geom->GetCoordinateData(&data, &count)) {
+                size_t points = count / 4;
+                if (batch->coords) {
+                    for (size_t i = 0; i < points; ++i) {
+                        const double* c = data + i * 4;
+                        WriteCoordinate(batch, coord_pos + i, c[0], c[1], c[2]);
+                    }
+                }
+                coord_pos += points;
+            }
+            break;
+        }
+        case GeomType::kPolygon: {
+            const Polygon* polygon = static_cast<const Polygon*>(geom);
+            size_t rings = polygon->GetNumRings();
+            for (size_t i = 0; i < rings; ++i) {
+                const LinearRing* ring = i == 0 ? polygon->GetExteriorRing()
+                                                : polygon->GetInteriorRingN(i - 1);
+                if (ring) {
+                    WriteGeometry(ring, batch, coord_pos, part_pos);
+                }
+            }
+            break;
+        }
+        case GeomType::kMultiPoint:
+        case GeomType::kMultiLineString:
+        case GeomType::kMultiPolygon:
+        case GeomType::kGeometryCollection: {
+            size_t n = geom->GetNumGeometries();
+            for (size_t i = 0; i < n; ++i) {
+                const Geometry* child = geom->GetGeometryN(i);
+                if (child) {
+                    WriteGeometry(child, batch, coord_pos, part_pos);
+                }
+            }
+            break;
+        }
+        default: {
+            BeginPart(batch, coord_pos, part_pos);
+            CoordinateList coords = geom->GetCoordinates();
+            if (batch->coords) {
+                for (size_t i = 0; i < coords.size(); ++i) {
+                    WriteCoordinate(batch, coord_pos + i, coords[i].x, coords[i].y, coords[i].z);
+                }
+            }
+            coord_pos += coords.size();
+            break;
+        }
+    }
+}
+
+static void WriteColumns(FeatureCursor* cursor, const CNFeature* feature,
+                         ogc_feature_batch_t* batch, size_t row) {
+    for (size_t c = 0; c < batch->column_count; ++c) {
+        ogc_field_column_t& column = batch->columns[c];
+        const CNFieldValue& value = feature->GetField(
+            column.field_index >= 0 ? static_cast<size_t>(column.field_index) : feature->GetFieldCount());
+        bool is_null = value.IsNull() || value.IsUnset();
+        if (column.null_flags) {
+            column.null_flags[row] = is_null ? 1 : 0;
+        }
+        if (column.int_values) {
+            int64_t v = 0;
+            if (is_null || !value.ConvertToInteger64(v)) {
+                v = 0;
+            }
+            column.int_values[row] = v;
+        }
+        if (column.real_values) {
+            double v = 0.0;
+            if (is_null || !value.ConvertToReal(v)) {
+                v = 0.0;
+            }
+            column.real_values[row] = v;
+        }
+        if (column.str_values) {
+            ogc_string_view_t& view = column.str_values[row];
+            view.data = nullptr;
+            view.size = 0;
+            if (is_null) {
+                continue;
+            }
+            // A borrowed feature is only valid until the layer is asked for
+            // the next one, so its strings are copied into the arena.
+            size_t size = 0;
+            const char* data = value.GetStringData(&size);
+            if (data && !cursor->borrowed) {
+                view.data = data;
+                view.size = size;
+                continue;
+            }
+            std::string converted;
+            if (data) {
+                converted.assign(data, size);
+            } else if (!value.ConvertToString(converted)) {
+                continue;
+            }
+            FeatureCursor::StringFixup fixup = { &view, cursor->arena.size() };
+            cursor->arena.append(converted);
+            cursor->fixups.push_back(fixup);
+            view.size = converted.size();
+        }
+    }
+}
+
 }
 
 ogc_layer_t* ogc_layer_create(const char* name, ogc_geom_type_e geom_type) {
@@ -600,6 +844,103 @@ SDK_C_API const char* ogc_driver_manager_get_driver_name(const ogc_driver_manage
     }
     return "";
 }
+ogc_feature_cursor_t* ogc_layer_cursor_create(ogc_layer_t* layer) {
+    if (!layer) {
+        return nullptr;
+    }
+    CNLayer* l = reinterpret_cast<CNLayer*>(layer);
+    l->ResetReading();
+    return reinterpret_cast<ogc_feature_cursor_t*>(new FeatureCursor(l));
+}
+
+void ogc_layer_cursor_destroy(ogc_feature_cursor_t* cursor) {
+    delete reinterpret_cast<FeatureCursor*>(cursor);
+}
+
+int ogc_layer_cursor_next_batch(ogc_feature_cursor_t* cursor, ogc_feature_batch_t* batch) {
+    if (!cursor || !batch) {
+        return OGC_ERROR_NULL_POINTER;
+    }
+    if (batch->capacity == 0 || (batch->coord_dim != 2 && batch->coord_dim != 3) ||
+        (batch->column_count > 0 && !batch->columns)) {
+        return OGC_ERROR_INVALID_PARAM;
+    }
+
+    FeatureCursor* c = reinterpret_cast<FeatureCursor*>(cursor);
+    c->owned.clear();
+    c->arena.clear();
+    c->fixups.clear();
+
+    size_t count = 0;
+    size_t coord_pos = 0;
+    size_t part_pos = 0;
+    int result = OGC_SUCCESS;
+
+    while (count < batch->capacity) {
+        CNFeature* feature = NextCursorFeature(c);
+        if (!feature) {
+            break;
+        }
+
+        const Geometry* geom = feature->GetGeomFieldCount() > 0 ? feature->GetGeometryRef() : nullptr;
+        size_t geom_coords = 0;
+        size_t geom_parts = 0;
+        if (geom) {
+            CountGeometry(geom, geom_coords, geom_parts);
+        }
+        bool coords_fit = !batch->coords || coord_pos + geom_coords <= batch->coord_capacity;
+        bool parts_fit = !batch->part_offsets || part_pos + geom_parts <= batch->part_capacity;
+        if (!coords_fit || !parts_fit) {
+            KeepPending(c, feature);
+            if (count == 0) {
+                batch->coord_count = geom_coords;
+                batch->part_count = geom_parts;
+                result = OGC_ERROR_OUT_OF_MEMORY;
+            }
+            break;
+        }
+
+        if (batch->fids) {
+            batch->fids[count] = feature->GetFID();
+        }
+        if (batch->geom_types) {
+            batch->geom_types[count] = static_cast<unsigned char>(
+                geom ? ToCGeomType(geom->GetGeometryType()) : OGC_GEOM_TYPE_UNKNOWN);
+        }
+        if (batch->coord_offsets) {
+            batch->coord_offsets[count] = coord_pos;
+        }
+        if (batch->feature_part_offsets) {
+            batch->feature_part_offsets[count] = part_pos;
+        }
+        if (geom) {
+            WriteGeometry(geom, batch, coord_pos, part_pos);
+        }
+        WriteColumns(c, feature, batch, count);
+        count++;
+    }
+
+    if (batch->coord_offsets) {
+        batch->coord_offsets[count] = coord_pos;
+    }
+    if (batch->feature_part_offsets) {
+        batch->feature_part_offsets[count] = part_pos;
+    }
+    if (batch->part_offsets) {
+        batch->part_offsets[part_pos] = coord_pos;
+    }
+    for (size_t i = 0; i < c->fixups.size(); ++i) {
+        c->fixups[i].view->data = c->arena.data() + c->fixups[i].offset;
+    }
+
+    batch->count = count;
+    if (result == OGC_SUCCESS) {
+        batch->coord_count = coord_pos;
+        batch->part_count = part_pos;
+    }
+    return result;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,7 @@
 #include <chrono>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include "sdk_c_api.h"
 
@@ -514,6 +515,101 @@ void benchmark_route_operations(int num_routes, int waypoints_per_route) {
     printf("\n");
 }
 
+void benchmark_layer_batch_scan(int count, int points_per_line) {
+    printf("=== Layer Batch Scan Benchmark (%d features, %d points each) ===\n",
+           count, points_per_line);
+    
+    ogc_layer_t* layer = ogc_memory_layer_create("batch_scan_layer");
+    ogc_feature_defn_t* defn = ogc_layer_get_feature_defn(layer);
+    ogc_feature_defn_add_field_defn(defn, ogc_field_defn_create("name", OGC_FIELD_TYPE_STRING));
+    ogc_feature_defn_add_field_defn(defn, ogc_field_defn_create("depth", OGC_FIELD_TYPE_REAL));
+    
+    for (int i = 0; i < count; i++) {
+        ogc_feature_t* feature = ogc_feature_create(defn);
+        ogc_feature_set_fid(feature, i);
+        ogc_geometry_t* line = ogc_linestring_create();
+        for (int j = 0; j < points_per_line; j++) {
+            ogc_linestring_add_point(line, i * 0.001 + j * 0.0001, j * 0.0001);
+        }
+        ogc_feature_set_geometry(feature, line);
+        char name[32];
+        snprintf(name, sizeof(name), "contour_%d", i);
+        ogc_feature_set_field_string(feature, 0, name);
+        ogc_feature_set_field_real(feature, 1, i * 0.5);
+        ogc_memory_layer_add_feature(layer, feature);
+        ogc_feature_destroy(feature);
+    }
+    
+    BenchmarkTimer timer;
+    double sum_single = 0;
+    size_t name_bytes_single = 0;
+    ogc_layer_reset_reading(layer);
+    ogc_feature_t* f = nullptr;
+    while ((f = ogc_layer_get_next_feature(layer)) != nullptr) {
+        ogc_geometry_t* geom = ogc_feature_get_geometry(f);
+        size_t n = ogc_linestring_get_num_points(geom);
+        for (size_t j = 0; j < n; j++) {
+            ogc_coordinate_t c = ogc_linestring_get_point_n(geom, j);
+            sum_single += c.x + c.y;
+        }
+        name_bytes_single += strlen(ogc_feature_get_field_as_string(f, 0));
+        sum_single += ogc_feature_get_field_as_real(f, 1);
+        ogc_geometry_destroy(geom);
+        ogc_feature_destroy(f);
+    }
+    double single_time = timer.ElapsedMs();
+    
+    const size_t batch_size = 1024;
+    std::vector<int64_t> fids(batch_size);
+    std::vector<size_t> offsets(batch_size + 1);
+    std::vector<double> coords(batch_size * points_per_line * 2);
+    std::vector<ogc_string_view_t> names(batch_size);
+    std::vector<double> depths(batch_size);
+    
+    ogc_field_column_t columns[2];
+    memset(columns, 0, sizeof(columns));
+    columns[0].field_index = 0;
+    columns[0].str_values = names.data();
+    columns[1].field_index = 1;
+    columns[1].real_values = depths.data();
+    
+    ogc_feature_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.capacity = batch_size;
+    batch.fids = fids.data();
+    batch.coords = coords.data();
+    batch.coord_capacity = batch_size * points_per_line;
+    batch.coord_dim = 2;
+    batch.coord_offsets = offsets.data();
+    batch.columns = columns;
+    batch.column_count = 2;
+    
+    timer = BenchmarkTimer();
+    double sum_batch = 0;
+    size_t name_bytes_batch = 0;
+    ogc_feature_cursor_t* cursor = ogc_layer_cursor_create(layer);
+    while (ogc_layer_cursor_next_batch(cursor, &batch) == OGC_SUCCESS && batch.count > 0) {
+        for (size_t j = 0; j < batch.coord_count * 2; j++) {
+            sum_batch += coords[j];
+        }
+        for (size_t i = 0; i < batch.count; i++) {
+            name_bytes_batch += names[i].size;
+            sum_batch += depths[i];
+        }
+    }
+    ogc_layer_cursor_destroy(cursor);
+    double batch_time = timer.ElapsedMs();
+    
+    printf("Per-feature scan: %.2f ms (%.3f us/feature)\n", single_time, single_time * 1000 / count);
+    printf("Batch scan: %.2f ms (%.3f us/feature)\n", batch_time, batch_time * 1000 / count);
+    printf("Speedup: %.2fx\n", batch_time > 0 ? single_time / batch_time : 0.0);
+    printf("Checksums: %.2f / %.2f, name bytes: %zu / %zu\n",
+           sum_single, sum_batch, name_bytes_single, name_bytes_batch);
+    
+    ogc_layer_destroy(layer);
+    printf("\n");
+}
+
 int main(int argc, char* argv[]) {
     printf("OGC Chart SDK C API Performance Benchmark\n");
     printf("Version: %s\n\n", ogc_sdk_get_version());
@@ -530,6 +626,7 @@ int main(int argc, char* argv[]) {
     benchmark_feature_attributes(10000);
     benchmark_feature_collection(5000);
     benchmark_layer_operations(5000);
+    benchmark_layer_batch_scan(20000, 16);
     benchmark_layer_manager(10, 100);
     benchmark_tile_cache(1000);
     benchmark_route_operations(100, 20);
@@ -18,6 +18,38 @@ extern "C" {
 #include "sdk_c_api.h"
 }
 
+#include <ogc/layer/memory_layer.h>
+#include <ogc/feature/feature.h>
+
+namespace {
+
+// Lends one row object that is overwritten for every feature, the way the
+// streaming file and database layers do.
+class StreamingLayer : public ogc::CNMemoryLayer {
+public:
+    explicit StreamingLayer(const std::string& name)
+        : ogc::CNMemoryLayer(name, ogc::GeomType::kPoint) {}
+
+    ogc::CNFeature* GetNextFeatureRef() override {
+        ogc::CNFeature* next = ogc::CNMemoryLayer::GetNextFeatureRef();
+        if (!next) {
+            return nullptr;
+        }
+        if (!row_) {
+            row_.reset(next->Clone());
+        } else {
+            row_->SetFID(next->GetFID());
+            row_->SetField(0, next->GetField(0));
+        }
+        return row_.get();
+    }
+
+private:
+    std::unique_ptr<ogc::CNFeature> row_;
+};
+
+}
+
 class SdkCApiLayerTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -76,6 +108,152 @@ TEST_F(SdkCApiLayerTest, MemoryLayerAddFeature) {
     ogc_feature_defn_destroy(defn);
 }
 
+TEST_F(SdkCApiLayerTest, CursorNextBatch) {
+    ogc_layer_t* layer = ogc_memory_layer_create("test_layer");
+    ASSERT_NE(layer, nullptr);
+    ogc_feature_defn_t* defn = ogc_layer_get_feature_defn(layer);
+    ogc_feature_defn_add_field_defn(defn, ogc_field_defn_create("name", OGC_FIELD_TYPE_STRING));
+    
+    for (int i = 0; i < 5; i++) {
+        ogc_feature_t* feature = ogc_feature_create(defn);
+        ogc_feature_set_fid(feature, i);
+        ogc_geometry_t* line = ogc_linestring_create();
+        ogc_linestring_add_point(line, i, 0.0);
+        ogc_linestring_add_point(line, i, 1.0);
+        ogc_feature_set_geometry(feature, line);
+        ogc_feature_set_field_string(feature, 0, "buoy");
+        ogc_memory_layer_add_feature(layer, feature);
+        ogc_feature_destroy(feature);
+    }
+    
+    int64_t fids[2];
+    size_t offsets[3];
+    double coords[8];
+    ogc_string_view_t names[2];
+    ogc_field_column_t column;
+    memset(&column, 0, sizeof(column));
+    column.field_index = 0;
+    column.str_values = names;
+    
+    ogc_feature_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.capacity = 2;
+    batch.fids = fids;
+    batch.coords = coords;
+    batch.coord_capacity = 4;
+    batch.coord_dim = 2;
+    batch.coord_offsets = offsets;
+    batch.columns = &column;
+    batch.column_count = 1;
+    
+    ogc_feature_cursor_t* cursor = ogc_layer_cursor_create(layer);
+    ASSERT_NE(cursor, nullptr);
+    
+    size_t total = 0;
+    while (ogc_layer_cursor_next_batch(cursor, &batch) == OGC_SUCCESS && batch.count > 0) {
+        EXPECT_LE(batch.count, 2u);
+        EXPECT_EQ(offsets[batch.count], batch.count * 2);
+        for (size_t i = 0; i < batch.count; i++) {
+            EXPECT_EQ(fids[i], static_cast<int64_t>(total + i));
+            EXPECT_DOUBLE_EQ(coords[offsets[i] * 2], static_cast<double>(total + i));
+            ASSERT_EQ(names[i].size, 4u);
+            EXPECT_EQ(strncmp(names[i].data, "buoy", 4), 0);
+        }
+        total += batch.count;
+    }
+    EXPECT_EQ(total, 5u);
+    
+    ogc_layer_cursor_destroy(cursor);
+    ogc_layer_destroy(layer);
+}
+
+TEST_F(SdkCApiLayerTest, CursorCopiesStringsOfStreamingLayer) {
+    StreamingLayer streaming("streaming");
+    ogc_layer_t* layer = reinterpret_cast<ogc_layer_t*>(&streaming);
+    ogc_feature_defn_t* defn = ogc_layer_get_feature_defn(layer);
+    ogc_feature_defn_add_field_defn(defn, ogc_field_defn_create("name", OGC_FIELD_TYPE_STRING));
+    
+    const char* names[] = { "alpha", "bravo", "charl", "delta", "echoo" };
+    for (int i = 0; i < 5; i++) {
+        ogc_feature_t* feature = ogc_feature_create(defn);
+        ogc_feature_set_fid(feature, i);
+        ogc_feature_set_field_string(feature, 0, names[i]);
+        ogc_memory_layer_add_feature(layer, feature);
+        ogc_feature_destroy(feature);
+    }
+    
+    int64_t fids[4];
+    ogc_string_view_t values[4];
+    ogc_field_column_t column;
+    memset(&column, 0, sizeof(column));
+    column.field_index = 0;
+    column.str_values = values;
+    
+    ogc_feature_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.capacity = 4;
+    batch.fids = fids;
+    batch.coord_dim = 2;
+    batch.columns = &column;
+    batch.column_count = 1;
+    
+    ogc_feature_cursor_t* cursor = ogc_layer_cursor_create(layer);
+    ASSERT_NE(cursor, nullptr);
+    
+    size_t total = 0;
+    while (ogc_layer_cursor_next_batch(cursor, &batch) == OGC_SUCCESS && batch.count > 0) {
+        for (size_t i = 0; i < batch.count; i++) {
+            ASSERT_EQ(fids[i], static_cast<int64_t>(total + i));
+            ASSERT_EQ(values[i].size, 5u);
+            EXPECT_EQ(std::string(values[i].data, values[i].size), names[total + i]);
+        }
+        total += batch.count;
+    }
+    EXPECT_EQ(total, 5u);
+    
+    ogc_layer_cursor_destroy(cursor);
+}
+
+TEST_F(SdkCApiLayerTest, CursorBufferTooSmall) {
+    ogc_layer_t* layer = ogc_memory_layer_create("test_layer");
+    ASSERT_NE(layer, nullptr);
+    ogc_feature_t* feature = ogc_feature_create(ogc_layer_get_feature_defn(layer));
+    ogc_geometry_t* line = ogc_linestring_create();
+    ogc_linestring_add_point(line, 0.0, 0.0);
+    ogc_linestring_add_point(line, 1.0, 1.0);
+    ogc_linestring_add_point(line, 2.0, 2.0);
+    ogc_feature_set_geometry(feature, line);
+    ogc_memory_layer_add_feature(layer, feature);
+    ogc_feature_destroy(feature);
+    
+    double coords[4];
+    size_t offsets[2];
+    ogc_feature_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.capacity = 1;
+    batch.coords = coords;
+    batch.coord_capacity = 2;
+    batch.coord_dim = 2;
+    batch.coord_offsets = offsets;
+    
+    ogc_feature_cursor_t* cursor = ogc_layer_cursor_create(layer);
+    EXPECT_EQ(ogc_layer_cursor_next_batch(cursor, &batch), OGC_ERROR_OUT_OF_MEMORY);
+    EXPECT_EQ(batch.count, 0u);
+    EXPECT_EQ(batch.coord_count, 3u);
+    
+    double larger[6];
+    batch.coords = larger;
+    batch.coord_capacity = 3;
+    EXPECT_EQ(ogc_layer_cursor_next_batch(cursor, &batch), OGC_SUCCESS);
+    EXPECT_EQ(batch.count, 1u);
+    EXPECT_DOUBLE_EQ(larger[4], 2.0);
+    
+    EXPECT_EQ(ogc_layer_cursor_next_batch(nullptr, &batch), OGC_ERROR_NULL_POINTER);
+    
+    ogc_layer_cursor_destroy(cursor);
+    ogc_layer_destroy(layer);
+}
+
 TEST_F(SdkCApiLayerTest, LayerNullPointer) {
     EXPECT_EQ(ogc_layer_get_name(nullptr), nullptr);
 }
@@ -3,6 +3,7 @@
 #include "common.h"
 #include "result.h"
 #include "connection.h"
+#include "postgis_pipeline.h"
 #include <memory>
 #include <string>
 #include <functional>
@@ -11,10 +12,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <thread>
 
 namespace ogc {
 namespace db {
 
+class DbConnectionPool;
+class PooledConnectionGuard;
+
 using AsyncCallback = std::function<void(Result)>;
 using AsyncGeometryCallback = std::function<void(Result, GeometryPtr)>;
 using AsyncResultSetCallback = std::function<void(Result, DbResultSetPtr)>;
@@ -66,10 +71,10 @@ private:
     template<typename Func, typename Callback>
     struct TaskWithCallback : TaskBase {
         Func func;
-        Callback callback;
+        typename std::decay<Callback>::type callback;
         
         explicit TaskWithCallback(Func&& f, Callback&& cb) 
-            : func(std::move(f)), callback(std::move(cb)) {}
+            : func(std::move(f)), callback(std::forward<Callback>(cb)) {}
         
         void Execute() override {
             try {
@@ -127,10 +132,33 @@ void DbAsyncExecutor::ExecuteAsync(Func&& func, Callback&& callback) {
     m_condition.notify_one();
 }
 
+/**
+ * @brief Asynchronous front end for a DbConnection.
+ *
+ * By default each call runs the blocking connection method on a worker
+ * thread. For PostGIS connections EnablePipeline switches to libpq pipeline
+ * mode instead: queries are sent from one event loop over the single
+ * connection and complete as their results arrive, so many queries can be
+ * in flight without a thread or connection each. CreatePipelined takes the
+ * connection from a DbConnectionPool and returns it on Shutdown.
+ *
+ * While the pipeline is enabled every query must be a single statement, and
+ * ConnectAsync and InsertGeometryAsync fail with kNotSupported because they
+ * need the connection in blocking mode. DisconnectAsync stops the pipeline
+ * before disconnecting.
+ *
+ * A result callback may call DisablePipeline: the pipeline stops accepting
+ * queries at once, and the teardown completes on the next EnablePipeline,
+ * DisablePipeline or Shutdown from another thread. Shutdown and the
+ * destructor must not run inside a callback.
+ */
 class OGC_DB_API DbAsyncConnection {
 public:
     static std::unique_ptr<DbAsyncConnection> Create(DbConnection* syncConnection);
     
+    static std::unique_ptr<DbAsyncConnection> CreatePipelined(DbConnectionPool* pool,
+                                                              const PipelineOptions& options = PipelineOptions());
+    
     explicit DbAsyncConnection(DbConnection* syncConnection);
     ~DbAsyncConnection();
     
@@ -156,10 +184,29 @@ public:
     void DisconnectAsync(AsyncCallback callback);
     void ExecuteAsync(const std::string& sql, AsyncCallback callback);
     void ExecuteQueryAsync(const std::string& sql, AsyncResultSetCallback callback);
+    
+    Result EnablePipeline(const PipelineOptions& options = PipelineOptions());
+    void DisablePipeline();
+    bool IsPipelineEnabled() const;
+    
+    /**
+     * @brief Runs a parameterised query ($1, $2, ...). Requires pipeline mode.
+     */
+    std::future<Result> ExecuteParamsAsync(const std::string& sql, const std::vector<std::string>& params);
+    void ExecuteQueryParamsAsync(const std::string& sql,
+                                 const std::vector<std::string>& params,
+                                 AsyncResultSetCallback callback);
 
 private:
     DbConnection* m_syncConnection;
     std::unique_ptr<DbAsyncExecutor> m_executor;
+    std::shared_ptr<PostGISPipeline> m_pipeline;
+    mutable std::mutex m_pipelineMutex;
+    std::unique_ptr<PooledConnectionGuard> m_pooledConnection;
+    
+    // The pipeline may be torn down from another thread while a call is
+    // using it, so callers work on a copy.
+    std::shared_ptr<PostGISPipeline> GetPipeline() const;
     
     void ExecuteTasks();
 };
@@ -76,7 +76,8 @@ enum class DbResult : int32_t {
     
     kNotSupported = 999,
     kNotImplemented = 1000,
-    kUnknownError = 1001
+    kUnknownError = 1001,
+    kCancelled = 1002
 };
 
 enum class ColumnType : uint8_t {
@@ -175,6 +176,7 @@ inline const char* GetDbResultString(DbResult result) noexcept {
         case DbResult::kPermissionDenied: return "Permission denied";
         case DbResult::kNotSupported: return "Operation not supported";
         case DbResult::kNotImplemented: return "Operation not implemented";
+        case DbResult::kCancelled: return "Operation cancelled";
         default: return "Unknown error";
     }
 }
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "common.h"
+#include "result.h"
+#include "resultset.h"
+#include <libpq-fe.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <future>
+
+namespace ogc {
+namespace db {
+
+class PostGISPipeline;
+
+using PostGISPipelinePtr = std::unique_ptr<PostGISPipeline>;
+using PipelineResultCallback = std::function<void(Result, DbResultSetPtr)>;
+
+struct PipelineOptions {
+    int maxInFlight = 256;
+    int maxBatch = 64;
+    int pollTimeoutMs = 100;
+};
+
+/**
+ * @brief Runs queries over one libpq connection in pipeline mode.
+ *
+ * Queries are queued from any thread and sent by a single event-loop thread
+ * with PQsendQueryParams. Each batch taken from the queue is closed with
+ * PQpipelineSync, so an error only aborts the rest of its own batch. The
+ * loop waits on socket readiness, so round-trips overlap and results
+ * complete their callbacks as soon as they arrive, in submission order.
+ *
+ * The pipeline borrows the connection: it switches it to non-blocking
+ * pipeline mode in Start and restores blocking mode in Stop. The
+ * connection must not be used directly while the pipeline is running.
+ *
+ * Each query must be a single statement, as with PQexecParams; SQL with
+ * several statements separated by semicolons fails with kInvalidParameter
+ * and has to be submitted as separate queries.
+ */
+class OGC_DB_API PostGISPipeline {
+public:
+    static PostGISPipelinePtr Create(PGconn* conn, const PipelineOptions& options = PipelineOptions());
+
+    explicit PostGISPipeline(PGconn* conn, const PipelineOptions& options = PipelineOptions());
+    ~PostGISPipeline();
+
+    static bool IsSupported();
+
+    Result Start();
+
+    /**
+     * @brief Stops accepting queries, waits for those already queued to
+     * complete and returns the connection to blocking mode.
+     *
+     * Called from a result callback it only stops accepting: the loop
+     * finishes the queue and restores the connection as it exits, and a
+     * later Stop, Start or the destructor joins it. The pipeline must not
+     * be destroyed from its own callback.
+     */
+    void Stop();
+
+    bool IsRunning() const;
+
+    // True on the event-loop thread, i.e. inside a result callback.
+    bool IsLoopThread() const;
+
+    void Submit(const std::string& sql,
+                const std::vector<std::string>& params,
+                PipelineResultCallback callback);
+
+    std::future<Result> Submit(const std::string& sql,
+                               const std::vector<std::string>& params = std::vector<std::string>());
+
+    size_t GetQueuedCount() const;
+    size_t GetInFlightCount() const;
+
+private:
+    PostGISPipeline(const PostGISPipeline&) = delete;
+    PostGISPipeline& operator=(const PostGISPipeline&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+
+    void EventLoop();
+};
+
+}
+}
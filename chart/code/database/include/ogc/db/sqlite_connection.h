@@ -34,6 +34,20 @@ struct SpatiaLiteOptions {
     std::string ToConnectionString() const;
 };
 
+/**
+ * @brief Options for SpatiaLiteConnection::SpatialQuery with a result set.
+ *
+ * When the geometry column has an R*Tree (idx_<table>_<geom>) the bounding
+ * box is resolved against it and only the matching rows are read from the
+ * table; otherwise the query falls back to an MbrIntersects scan.
+ */
+struct SpatiaLiteQueryOptions {
+    std::vector<std::string> columns;
+    bool useSpatialIndex = true;
+    bool createIndexIfMissing = false;
+    int64_t limit = -1;
+};
+
 class OGC_DB_API SpatiaLiteConnection : public DbConnection {
 public:
     static SpatiaLiteConnectionPtr Create();
@@ -86,6 +100,24 @@ public:
                                     const ::ogc::Envelope& filter,
                                     std::vector<GeometryPtr>& results) override;
     
+    /**
+     * @brief Runs a spatial query and returns its rows.
+     *
+     * Column 0 is the geometry as WKB, followed by options.columns. filter
+     * may be null, in which case the envelope of queryGeom bounds the
+     * search. queryGeom may be null for a pure bounding-box query.
+     */
+    Result SpatialQuery(const std::string& table,
+                        const std::string& geomColumn,
+                        SpatialOperator op,
+                        const Geometry* queryGeom,
+                        const ::ogc::Envelope* filter,
+                        const SpatiaLiteQueryOptions& options,
+                        DbResultSetPtr& result);
+    
+    bool HasSpatialIndex(const std::string& tableName,
+                         const std::string& geomColumn) const;
+    
     Result UpdateGeometry(const std::string& table,
                           const std::string& geomColumn,
                           int64_t id,
@@ -135,6 +167,7 @@ private:
     Result CheckConnection();
     Result ExecuteInternal(const std::string& sql, sqlite3_stmt*& stmt, bool finalize = true);
     int GetLastInsertRowId() const;
+    int GetGeometrySrid(const std::string& tableName, const std::string& geomColumn) const;
 };
 
 class OGC_DB_API SpatiaLiteStatement : public DbStatement {
@@ -118,5 +118,88 @@ private:
     Result ExecuteInsert();
 };
 
+enum class BulkLoadPhase {
+    kLoading,
+    kIndexing,
+    kDone
+};
+
+using BulkLoadProgressCallback = std::function<void(BulkLoadPhase phase, int64_t done, int64_t total)>;
+using BulkLoadCancelCallback = std::function<bool()>;
+
+struct SpatiaLiteBulkLoadOptions {
+    int rowsPerTransaction = 50000;
+    bool deferSpatialIndex = true;
+    bool createSpatialIndex = false;
+    bool fastPragmas = true;
+    int cacheSizeKb = 262144;
+    int progressInterval = 10000;
+    BulkLoadProgressCallback onProgress;
+    BulkLoadCancelCallback isCancelled;
+};
+
+struct SpatiaLiteBulkLoadStats {
+    int64_t rowsLoaded = 0;
+    int64_t transactions = 0;
+    int64_t indexEntries = 0;
+    bool cancelled = false;
+};
+
+/**
+ * @brief Loads large feature sets into a SpatiaLite table.
+ *
+ * One INSERT is prepared for the session and re-bound for every row, with
+ * geometries bound as WKB blobs, and rows are committed in large
+ * transactions. Load pragmas (synchronous, temp_store, cache_size) are
+ * applied in Begin and restored when the load ends.
+ *
+ * With deferSpatialIndex the triggers that keep the R*Tree in step are
+ * dropped for the duration of the load. The envelopes of the committed
+ * rows are sorted along a Z-order curve and written to the R*Tree in one
+ * pass when the load ends, after which the triggers are recreated. Rows
+ * committed before a cancellation or Abort are indexed the same way, so
+ * the table and its index never disagree.
+ *
+ * The dropped trigger definitions are kept in ogc_bulk_load_triggers until
+ * they are recreated. If the deferred index pass fails, the index is
+ * rebuilt from the table when the triggers come back; if the process dies
+ * mid-load, the next Begin on the table restores the triggers and rebuilds
+ * the index before loading.
+ */
+class OGC_DB_API SpatiaLiteBulkLoader {
+public:
+    explicit SpatiaLiteBulkLoader(SpatiaLiteConnection* connection);
+    ~SpatiaLiteBulkLoader();
+    
+    void SetOptions(const SpatiaLiteBulkLoadOptions& options);
+    
+    Result Begin(const std::string& table,
+                 const std::string& geomColumn,
+                 const std::vector<std::string>& attributeColumns);
+    
+    Result Add(const Geometry* geometry,
+               const std::vector<std::string>& attributeValues);
+    
+    Result Finish(SpatiaLiteBulkLoadStats& stats);
+    
+    // Rolls back the open batch and indexes what was committed. Returns the
+    // error if the index or its triggers could not be restored.
+    Result Abort();
+    
+    bool IsActive() const;
+
+private:
+    SpatiaLiteBulkLoader(const SpatiaLiteBulkLoader&);
+    SpatiaLiteBulkLoader& operator=(const SpatiaLiteBulkLoader&);
+    
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    
+    Result CommitBatch();
+    Result BuildDeferredIndex();
+    Result DeferIndexTriggers();
+    Result End();
+};
+
 }
 }
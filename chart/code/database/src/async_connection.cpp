@@ -1,5 +1,7 @@
 #include "ogc/db/async_connection.h"
 #include "ogc/db/resultset.h"
+#include "ogc/db/connection_pool.h"
+#include "ogc/db/postgis_connection.h"
 #include <algorithm>
 
 namespace ogc {
@@ -85,10 +87,48 @@ size_t DbAsyncExecutor::GetRunningCount() const {
     return m_runningCount.load();
 }
 
+namespace {
+
+// While the pipeline runs it owns the PGconn in non-blocking pipeline mode,
+// so calls that go through the blocking connection are refused.
+Result PipelineBusy() {
+    return Result::Error(DbResult::kNotSupported,
+                         "Not available while pipeline mode is enabled; disable the pipeline first");
+}
+
+std::future<Result> ReadyFuture(const Result& result) {
+    std::promise<Result> promise;
+    promise.set_value(result);
+    return promise.get_future();
+}
+
+}
+
 std::unique_ptr<DbAsyncConnection> DbAsyncConnection::Create(DbConnection* syncConnection) {
     return std::make_unique<DbAsyncConnection>(syncConnection);
 }
 
+std::unique_ptr<DbAsyncConnection> DbAsyncConnection::CreatePipelined(DbConnectionPool* pool,
+                                                                      const PipelineOptions& options) {
+    if (!pool) {
+        return nullptr;
+    }
+    
+    DbConnectionPtr connection;
+    if (!pool->Acquire(connection).IsSuccess() || !connection) {
+        return nullptr;
+    }
+    
+    std::unique_ptr<PooledConnectionGuard> guard(new PooledConnectionGuard(pool, connection));
+    std::unique_ptr<DbAsyncConnection> asyncConn = Create(guard->Get());
+    asyncConn->m_pooledConnection = std::move(guard);
+    
+    if (!asyncConn->EnablePipeline(options).IsSuccess()) {
+        return nullptr;
+    }
+    return asyncConn;
+}
+
 DbAsyncConnection::DbAsyncConnection(DbConnection* syncConnection)
     : m_syncConnection(syncConnection), m_executor(DbAsyncExecutor::Create(4)) {
 }
@@ -98,19 +138,111 @@ DbAsyncConnection::~DbAsyncConnection() {
 }
 
 void DbAsyncConnection::Shutdown() {
+    DisablePipeline();
     if (m_executor) {
         m_executor->Shutdown();
         m_executor.reset();
     }
+    if (m_pooledConnection) {
+        m_pooledConnection->Release();
+        m_pooledConnection.reset();
+    }
+}
+
+std::shared_ptr<PostGISPipeline> DbAsyncConnection::GetPipeline() const {
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return m_pipeline;
+}
+
+Result DbAsyncConnection::EnablePipeline(const PipelineOptions& options) {
+    std::shared_ptr<PostGISPipeline> current = GetPipeline();
+    if (current) {
+        if (current->IsRunning()) {
+            return Result::Success();
+        }
+        if (current->IsLoopThread()) {
+            return PipelineBusy();
+        }
+        // Left behind by a DisablePipeline from a callback.
+        DisablePipeline();
+    }
+    if (!m_syncConnection || m_syncConnection->GetType() != DatabaseType::kPostGIS) {
+        return Result::Error(DbResult::kNotSupported, "Pipeline mode requires a PostGIS connection");
+    }
+    if (!m_syncConnection->IsConnected()) {
+        return Result::Error(DbResult::kNotConnected, "Not connected to database");
+    }
+    
+    PGconn* conn = static_cast<PostGISConnection*>(m_syncConnection)->GetRawConnection();
+    std::shared_ptr<PostGISPipeline> pipeline(PostGISPipeline::Create(conn, options).release());
+    Result result = pipeline->Start();
+    if (result.IsSuccess()) {
+        std::lock_guard<std::mutex> lock(m_pipelineMutex);
+        m_pipeline = pipeline;
+    }
+    return result;
+}
+
+void DbAsyncConnection::DisablePipeline() {
+    std::shared_ptr<PostGISPipeline> pipeline = GetPipeline();
+    if (!pipeline) {
+        return;
+    }
+    // From a callback the pipeline only stops accepting; it stays installed,
+    // so blocking calls keep being refused until another thread joins it.
+    pipeline->Stop();
+    if (pipeline->IsLoopThread()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    if (m_pipeline == pipeline) {
+        m_pipeline.reset();
+    }
+}
+
+bool DbAsyncConnection::IsPipelineEnabled() const {
+    std::shared_ptr<PostGISPipeline> pipeline = GetPipeline();
+    return pipeline && pipeline->IsRunning();
+}
+
+std::future<Result> DbAsyncConnection::ExecuteParamsAsync(const std::string& sql,
+                                                          const std::vector<std::string>& params) {
+    std::shared_ptr<PostGISPipeline> pipeline = GetPipeline();
+    if (!pipeline) {
+        return ReadyFuture(Result::Error(DbResult::kNotSupported, "Parameterised queries require pipeline mode"));
+    }
+    return pipeline->Submit(sql, params);
+}
+
+void DbAsyncConnection::ExecuteQueryParamsAsync(const std::string& sql,
+                                                const std::vector<std::string>& params,
+                                                AsyncResultSetCallback callback) {
+    std::shared_ptr<PostGISPipeline> pipeline = GetPipeline();
+    if (!pipeline) {
+        callback(Result::Error(DbResult::kNotSupported, "Parameterised queries require pipeline mode"), nullptr);
+        return;
+    }
+    pipeline->Submit(sql, params, callback);
 }
 
 std::future<Result> DbAsyncConnection::ConnectAsync(const std::string& connectionString) {
+    if (GetPipeline()) {
+        return ReadyFuture(PipelineBusy());
+    }
     return m_executor->ExecuteAsync([this, connectionString]() -> Result {
         return m_syncConnection->Connect(connectionString);
     });
 }
 
 std::future<void> DbAsyncConnection::DisconnectAsync() {
+    // Queued pipeline queries finish before the connection goes away. From
+    // a callback the pipeline is still draining, so the connection stays.
+    DisablePipeline();
+    if (GetPipeline()) {
+        std::promise<void> promise;
+        promise.set_value();
+        return promise.get_future();
+    }
     return std::async(std::launch::async, [this]() {
         m_syncConnection->Disconnect();
     });
@@ -123,12 +255,24 @@ std::future<bool> DbAsyncConnection::IsConnectedAsync() {
 }
 
 std::future<Result> DbAsyncConnection::ExecuteAsync(const std::string& sql) {
+    if (std::shared_ptr<PostGISPipeline> pipeline = GetPipeline()) {
+        return pipeline->Submit(sql);
+    }
     return m_executor->ExecuteAsync([this, sql]() -> Result {
         return m_syncConnection->Execute(sql);
     });
 }
 
 std::future<Result> DbAsyncConnection::ExecuteQueryAsync(const std::string& sql, DbResultSetPtr& result) {
+    if (std::shared_ptr<PostGISPipeline> pipeline = GetPipeline()) {
+        auto promise = std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        pipeline->Submit(sql, std::vector<std::string>(), [promise, &result](Result r, DbResultSetPtr rs) {
+            result = std::move(rs);
+            promise->set_value(r);
+        });
+        return future;
+    }
     return m_executor->ExecuteAsync([this, sql, &result]() -> Result {
         return m_syncConnection->ExecuteQuery(sql, result);
     });
@@ -139,18 +283,30 @@ std::future<Result> DbAsyncConnection::InsertGeometryAsync(const std::string& ta
                                                            const Geometry* geometry,
                                                            const std::map<std::string, std::string>& attributes,
                                                            int64_t& outId) {
+    if (GetPipeline()) {
+        return ReadyFuture(PipelineBusy());
+    }
     return m_executor->ExecuteAsync([this, table, geomColumn, geometry, attributes, &outId]() -> Result {
         return m_syncConnection->InsertGeometry(table, geomColumn, geometry, attributes, outId);
     });
 }
 
 void DbAsyncConnection::ConnectAsync(const std::string& connectionString, AsyncCallback callback) {
+    if (GetPipeline()) {
+        callback(PipelineBusy());
+        return;
+    }
     m_executor->ExecuteAsync([this, connectionString]() -> Result {
         return m_syncConnection->Connect(connectionString);
     }, callback);
 }
 
 void DbAsyncConnection::DisconnectAsync(AsyncCallback callback) {
+    DisablePipeline();
+    if (GetPipeline()) {
+        callback(PipelineBusy());
+        return;
+    }
     m_executor->ExecuteAsync([this]() -> Result {
         m_syncConnection->Disconnect();
         return Result::Success();
@@ -158,12 +314,22 @@ void DbAsyncConnection::DisconnectAsync(AsyncCallback callback) {
 }
 
 void DbAsyncConnection::ExecuteAsync(const std::string& sql, AsyncCallback callback) {
+    if (std::shared_ptr<PostGISPipeline> pipeline = GetPipeline()) {
+        pipeline->Submit(sql, std::vector<std::string>(), [callback](Result r, DbResultSetPtr) {
+            callback(r);
+        });
+        return;
+    }
     m_executor->ExecuteAsync([this, sql]() -> Result {
         return m_syncConnection->Execute(sql);
     }, callback);
 }
 
 void DbAsyncConnection::ExecuteQueryAsync(const std::string& sql, AsyncResultSetCallback callback) {
+    if (std::shared_ptr<PostGISPipeline> pipeline = GetPipeline()) {
+        pipeline->Submit(sql, std::vector<std::string>(), callback);
+        return;
+    }
     m_executor->ExecuteAsync([this, sql]() -> std::pair<Result, DbResultSetPtr> {
         DbResultSetPtr result;
         Result dbResult = m_syncConnection->ExecuteQuery(sql, result);
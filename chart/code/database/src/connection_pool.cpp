@@ -1,6 +1,7 @@
 #include "ogc/db/connection_pool.h"
 #include <algorithm>
 #include <cstring>
+#include <thread>
 
 namespace ogc {
 namespace db {
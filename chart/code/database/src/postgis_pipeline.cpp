@@ -0,0 +1,507 @@
+#include "ogc/db/postgis_pipeline.h"
+#include "ogc/db/postgis_connection.h"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace ogc {
+namespace db {
+
+namespace {
+
+struct PipelineRequest {
+    std::string sql;
+    std::vector<std::string> params;
+    PipelineResultCallback callback;
+};
+
+struct PipelineEntry {
+    bool isSync;
+    PipelineResultCallback callback;
+    PGresult* result;
+    DbResult errorCode;
+    std::string error;
+
+    PipelineEntry() : isSync(false), result(nullptr), errorCode(DbResult::kSuccess) {}
+};
+
+// PQsendQueryParams accepts a single statement. Semicolons inside quoted
+// strings, quoted identifiers, dollar quotes and comments do not separate
+// statements, and a trailing one is allowed.
+bool HasMultipleStatements(const std::string& sql) {
+    const size_t n = sql.size();
+    bool ended = false;
+    size_t i = 0;
+    while (i < n) {
+        char c = sql[i];
+        if (c == '\'' || c == '"') {
+            if (ended) return true;
+            bool escapes = c == '\'' && i > 0 && (sql[i - 1] == 'E' || sql[i - 1] == 'e');
+            size_t j = i + 1;
+            while (j < n && sql[j] != c) {
+                j += (escapes && sql[j] == '\\') ? 2 : 1;
+            }
+            i = j + 1;
+            continue;
+        }
+        if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+            size_t end = sql.find('\n', i);
+            i = end == std::string::npos ? n : end + 1;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+            size_t end = sql.find("*/", i + 2);
+            i = end == std::string::npos ? n : end + 2;
+            continue;
+        }
+        if (c == '$' && i + 1 < n && !std::isdigit(static_cast<unsigned char>(sql[i + 1]))) {
+            size_t j = i + 1;
+            while (j < n && (std::isalnum(static_cast<unsigned char>(sql[j])) || sql[j] == '_')) ++j;
+            if (j < n && sql[j] == '$') {
+                if (ended) return true;
+                std::string tag = sql.substr(i, j - i + 1);
+                size_t end = sql.find(tag, j + 1);
+                i = end == std::string::npos ? n : end + tag.size();
+                continue;
+            }
+        }
+        if (c == ';') {
+            ended = true;
+        } else if (ended && !std::isspace(static_cast<unsigned char>(c))) {
+            return true;
+        }
+        ++i;
+    }
+    return false;
+}
+
+void InvokeCallback(const PipelineResultCallback& callback, Result result, DbResultSetPtr resultSet) {
+    if (!callback) return;
+    try {
+        callback(result, std::move(resultSet));
+    } catch (...) {
+    }
+}
+
+}
+
+struct PostGISPipeline::Impl {
+    PGconn* conn;
+    PipelineOptions options;
+
+    mutable std::mutex mutex;
+    std::deque<PipelineRequest> queue;
+    bool accepting;
+    bool stopping;
+
+    std::deque<PipelineEntry> inFlight;
+    std::atomic<size_t> inFlightQueries;
+    std::atomic<bool> running;
+    std::thread loop;
+    std::atomic<std::thread::id> loopId;
+
+    int wakeFds[2];
+
+    Impl(PGconn* c, const PipelineOptions& o)
+        : conn(c), options(o), accepting(false), stopping(false)
+        , inFlightQueries(0), running(false), loopId(std::thread::id()) {
+        wakeFds[0] = -1;
+        wakeFds[1] = -1;
+    }
+
+    void Wake() {
+#ifndef _WIN32
+        if (wakeFds[1] >= 0) {
+            char byte = 1;
+            ssize_t ignored = write(wakeFds[1], &byte, 1);
+            (void)ignored;
+        }
+#endif
+    }
+
+    void DrainWake() {
+#ifndef _WIN32
+        char buffer[64];
+        while (wakeFds[0] >= 0 && read(wakeFds[0], buffer, sizeof(buffer)) > 0) {
+        }
+#endif
+    }
+
+    void CloseWake() {
+#ifndef _WIN32
+        for (int i = 0; i < 2; ++i) {
+            if (wakeFds[i] >= 0) {
+                close(wakeFds[i]);
+                wakeFds[i] = -1;
+            }
+        }
+#endif
+    }
+
+    bool OnLoopThread() const {
+        return std::this_thread::get_id() == loopId.load();
+    }
+
+    // Asks the loop to finish what is queued and exit.
+    void RequestStop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        accepting = false;
+        stopping = true;
+    }
+
+    // Runs on the loop thread as it exits, so the connection is usable
+    // again even when nobody has joined the loop yet.
+    void RestoreConnection() {
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PQpipelineStatus(conn) != PQ_PIPELINE_OFF) {
+            PQexitPipelineMode(conn);
+        }
+#endif
+        PQsetnonblocking(conn, 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepting = false;
+        }
+        running = false;
+    }
+
+    void Complete(PipelineEntry& entry) {
+        if (entry.errorCode != DbResult::kSuccess) {
+            if (entry.result) PQclear(entry.result);
+            InvokeCallback(entry.callback, Result::Error(entry.errorCode, entry.error), nullptr);
+        } else {
+            DbResultSetPtr resultSet(new PostGISResultSet(entry.result));
+            InvokeCallback(entry.callback, Result::Success(), std::move(resultSet));
+        }
+        entry.result = nullptr;
+    }
+
+    // Completes everything in flight or queued with an error once the
+    // connection can no longer carry the pipeline.
+    void FailAll(const std::string& error) {
+        std::deque<PipelineRequest> queued;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepting = false;
+            queued.swap(queue);
+        }
+        while (!inFlight.empty()) {
+            PipelineEntry& entry = inFlight.front();
+            if (!entry.isSync) {
+                entry.errorCode = DbResult::kConnectionLost;
+                entry.error = error;
+                Complete(entry);
+            }
+            inFlight.pop_front();
+        }
+        inFlightQueries = 0;
+        for (auto& request : queued) {
+            InvokeCallback(request.callback, Result::Error(DbResult::kConnectionLost, error), nullptr);
+        }
+    }
+
+    void ProcessResults() {
+        while (!inFlight.empty() && !PQisBusy(conn)) {
+            PipelineEntry& front = inFlight.front();
+            PGresult* res = PQgetResult(conn);
+
+            if (front.isSync) {
+                if (!res) break;
+                bool synced = PQresultStatus(res) == PGRES_PIPELINE_SYNC;
+                PQclear(res);
+                if (synced) inFlight.pop_front();
+                continue;
+            }
+
+            if (!res) {
+                Complete(front);
+                inFlight.pop_front();
+                --inFlightQueries;
+                continue;
+            }
+
+            switch (PQresultStatus(res)) {
+                case PGRES_TUPLES_OK:
+                case PGRES_COMMAND_OK:
+                case PGRES_EMPTY_QUERY:
+                    if (front.result) PQclear(front.result);
+                    front.result = res;
+                    break;
+                case PGRES_PIPELINE_ABORTED:
+                    front.errorCode = DbResult::kExecutionError;
+                    front.error = "Query skipped after an earlier error in its pipeline batch";
+                    PQclear(res);
+                    break;
+                default:
+                    if (front.errorCode == DbResult::kSuccess) {
+                        front.errorCode = DbResult::kExecutionError;
+                        const char* message = PQresultErrorMessage(res);
+                        front.error = message ? message : "Query failed";
+                    }
+                    PQclear(res);
+                    break;
+            }
+        }
+    }
+};
+
+PostGISPipelinePtr PostGISPipeline::Create(PGconn* conn, const PipelineOptions& options) {
+    return PostGISPipelinePtr(new PostGISPipeline(conn, options));
+}
+
+PostGISPipeline::PostGISPipeline(PGconn* conn, const PipelineOptions& options)
+    : impl_(new Impl(conn, options)) {
+}
+
+PostGISPipeline::~PostGISPipeline() {
+    Stop();
+}
+
+bool PostGISPipeline::IsSupported() {
+#ifdef LIBPQ_HAS_PIPELINING
+    return true;
+#else
+    return false;
+#endif
+}
+
+Result PostGISPipeline::Start() {
+#ifdef LIBPQ_HAS_PIPELINING
+    if (impl_->OnLoopThread()) {
+        return Result::Error(DbResult::kNotSupported, "Pipeline cannot be restarted from its own callback");
+    }
+    if (impl_->running) {
+        return Result::Success();
+    }
+    // Completes a stop requested from a callback.
+    Stop();
+    if (!impl_->conn || PQstatus(impl_->conn) != CONNECTION_OK) {
+        return Result::Error(DbResult::kNotConnected, "Not connected to database");
+    }
+    if (PQsetnonblocking(impl_->conn, 1) != 0) {
+        return Result::Error(DbResult::kExecutionError, PQerrorMessage(impl_->conn));
+    }
+    if (!PQenterPipelineMode(impl_->conn)) {
+        std::string error = PQerrorMessage(impl_->conn);
+        PQsetnonblocking(impl_->conn, 0);
+        return Result::Error(DbResult::kExecutionError, error);
+    }
+
+#ifndef _WIN32
+    if (pipe(impl_->wakeFds) == 0) {
+        fcntl(impl_->wakeFds[0], F_SETFL, fcntl(impl_->wakeFds[0], F_GETFL) | O_NONBLOCK);
+        fcntl(impl_->wakeFds[1], F_SETFL, fcntl(impl_->wakeFds[1], F_GETFL) | O_NONBLOCK);
+    } else {
+        impl_->wakeFds[0] = impl_->wakeFds[1] = -1;
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->accepting = true;
+        impl_->stopping = false;
+    }
+    impl_->running = true;
+    impl_->loop = std::thread(&PostGISPipeline::EventLoop, this);
+    return Result::Success();
+#else
+    return Result::Error(DbResult::kNotSupported, "libpq was built without pipeline mode");
+#endif
+}
+
+void PostGISPipeline::Stop() {
+    if (!impl_->loop.joinable()) {
+        return;
+    }
+
+    impl_->RequestStop();
+    impl_->Wake();
+    // A callback cannot join the loop it runs on; the loop drains the queue
+    // and exits on its own, and a later Stop or the destructor joins it.
+    if (impl_->OnLoopThread()) {
+        return;
+    }
+    impl_->loop.join();
+    impl_->loopId = std::thread::id();
+    impl_->CloseWake();
+}
+
+bool PostGISPipeline::IsLoopThread() const {
+    return impl_->OnLoopThread();
+}
+
+bool PostGISPipeline::IsRunning() const {
+    return impl_->running;
+}
+
+void PostGISPipeline::Submit(const std::string& sql,
+                             const std::vector<std::string>& params,
+                             PipelineResultCallback callback) {
+    if (HasMultipleStatements(sql)) {
+        InvokeCallback(callback, Result::Error(DbResult::kInvalidParameter,
+                                               "Pipeline mode runs one statement per query"), nullptr);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        if (impl_->accepting) {
+            PipelineRequest request;
+            request.sql = sql;
+            request.params = params;
+            request.callback = std::move(callback);
+            impl_->queue.push_back(std::move(request));
+            callback = nullptr;
+        }
+    }
+
+    if (callback) {
+        InvokeCallback(callback, Result::Error(DbResult::kNotConnected, "Pipeline is not running"), nullptr);
+        return;
+    }
+    impl_->Wake();
+}
+
+std::future<Result> PostGISPipeline::Submit(const std::string& sql,
+                                            const std::vector<std::string>& params) {
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> future = promise->get_future();
+    Submit(sql, params, [promise](Result result, DbResultSetPtr) {
+        promise->set_value(result);
+    });
+    return future;
+}
+
+size_t PostGISPipeline::GetQueuedCount() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->queue.size();
+}
+
+size_t PostGISPipeline::GetInFlightCount() const {
+    return impl_->inFlightQueries.load();
+}
+
+void PostGISPipeline::EventLoop() {
+#ifdef LIBPQ_HAS_PIPELINING
+    Impl& d = *impl_;
+    d.loopId = std::this_thread::get_id();
+    const size_t maxInFlight = d.options.maxInFlight > 0 ? static_cast<size_t>(d.options.maxInFlight) : 1;
+    const size_t maxBatch = d.options.maxBatch > 0 ? static_cast<size_t>(d.options.maxBatch) : 1;
+
+    for (;;) {
+        std::vector<PipelineRequest> batch;
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock(d.mutex);
+            stopping = d.stopping;
+            size_t inFlight = d.inFlightQueries.load();
+            size_t room = inFlight < maxInFlight ? maxInFlight - inFlight : 0;
+            size_t take = std::min(std::min(room, maxBatch), d.queue.size());
+            for (size_t i = 0; i < take; ++i) {
+                batch.push_back(std::move(d.queue.front()));
+                d.queue.pop_front();
+            }
+            if (stopping && d.queue.empty() && d.inFlight.empty() && batch.empty()) {
+                break;
+            }
+        }
+
+        bool sent = false;
+        for (auto& request : batch) {
+            std::vector<const char*> values;
+            values.reserve(request.params.size());
+            for (const auto& param : request.params) {
+                values.push_back(param.c_str());
+            }
+
+            int ok = PQsendQueryParams(d.conn, request.sql.c_str(),
+                                       static_cast<int>(values.size()), nullptr,
+                                       values.empty() ? nullptr : values.data(),
+                                       nullptr, nullptr, 0);
+            if (!ok) {
+                InvokeCallback(request.callback,
+                               Result::Error(DbResult::kExecutionError, PQerrorMessage(d.conn)), nullptr);
+                continue;
+            }
+
+            PipelineEntry entry;
+            entry.callback = std::move(request.callback);
+            d.inFlight.push_back(std::move(entry));
+            ++d.inFlightQueries;
+            sent = true;
+        }
+
+        if (sent) {
+            if (!PQpipelineSync(d.conn)) {
+                d.FailAll(PQerrorMessage(d.conn));
+                break;
+            }
+            PipelineEntry sync;
+            sync.isSync = true;
+            d.inFlight.push_back(std::move(sync));
+        }
+
+        int flush = PQflush(d.conn);
+        if (flush < 0) {
+            d.FailAll(PQerrorMessage(d.conn));
+            break;
+        }
+
+        // Results that arrived with earlier reads may already be complete.
+        d.ProcessResults();
+
+        int sock = PQsocket(d.conn);
+        if (sock < 0) {
+            d.FailAll("Connection socket closed");
+            break;
+        }
+
+#ifdef _WIN32
+        // There is no wake-up pipe on Windows, so new submissions are picked
+        // up on a short poll interval instead.
+        WSAPOLLFD fds[1];
+        fds[0].fd = static_cast<SOCKET>(sock);
+        fds[0].events = POLLRDNORM | (flush == 1 ? POLLWRNORM : 0);
+        fds[0].revents = 0;
+        int ready = WSAPoll(fds, 1, std::min(d.options.pollTimeoutMs, 5));
+        bool readable = ready > 0 && (fds[0].revents & (POLLRDNORM | POLLERR | POLLHUP));
+#else
+        struct pollfd fds[2];
+        fds[0].fd = sock;
+        fds[0].events = POLLIN | (flush == 1 ? POLLOUT : 0);
+        fds[0].revents = 0;
+        fds[1].fd = d.wakeFds[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        int nfds = d.wakeFds[0] >= 0 ? 2 : 1;
+        int ready = poll(fds, nfds, d.options.pollTimeoutMs);
+        bool readable = ready > 0 && (fds[0].revents & (POLLIN | POLLERR | POLLHUP));
+        if (nfds == 2 && (fds[1].revents & POLLIN)) {
+            d.DrainWake();
+        }
+#endif
+
+        if (readable) {
+            if (!PQconsumeInput(d.conn)) {
+                d.FailAll(PQerrorMessage(d.conn));
+                break;
+            }
+            d.ProcessResults();
+        }
+    }
+    d.RestoreConnection();
+#endif
+}
+
+}
+}
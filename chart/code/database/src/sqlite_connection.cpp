@@ -879,16 +879,119 @@ Result SpatiaLiteConnection::InsertGeometries(const std::string& table,
                                               const std::vector<std::map<std::string, std::string>>& attributes,
                                               std::vector<int64_t>& outIds) {
     outIds.clear();
+    if (geometries.empty()) {
+        return Result::Success();
+    }
+    
+    Result connResult = CheckConnection();
+    if (!connResult.IsSuccess()) {
+        return connResult;
+    }
+    
+    // Rows sharing one attribute column set go through a single prepared
+    // statement; mixed column sets fall back to one INSERT per row.
+    static const std::map<std::string, std::string> kNoAttributes;
+    const auto& firstAttrs = attributes.empty() ? kNoAttributes : attributes[0];
+    bool uniform = true;
+    for (size_t i = 0; i < geometries.size() && uniform; ++i) {
+        const auto& attrs = i < attributes.size() ? attributes[i] : kNoAttributes;
+        if (attrs.size() != firstAttrs.size()) {
+            uniform = false;
+            break;
+        }
+        for (auto a = attrs.begin(), b = firstAttrs.begin(); a != attrs.end(); ++a, ++b) {
+            if (a->first != b->first) {
+                uniform = false;
+                break;
+            }
+        }
+    }
+    
+    if (!uniform) {
+        for (size_t i = 0; i < geometries.size(); ++i) {
+            int64_t id = 0;
+            const auto& attrs = i < attributes.size() ? attributes[i] : kNoAttributes;
+            Result result = InsertGeometry(table, geomColumn, geometries[i], attrs, id);
+            if (!result.IsSuccess()) {
+                return result;
+            }
+            outIds.push_back(id);
+        }
+        return Result::Success();
+    }
+    
+    std::ostringstream sql;
+    sql << "INSERT INTO " << table << " (" << geomColumn;
+    for (const auto& attr : firstAttrs) {
+        sql << ", " << attr.first;
+    }
+    sql << ") VALUES (ST_GeomFromWKB(?, ?)";
+    for (size_t i = 0; i < firstAttrs.size(); ++i) {
+        sql << ", ?";
+    }
+    sql << ")";
+    
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(impl_->db, sql.str().c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        impl_->lastError = sqlite3_errmsg(impl_->db);
+        if (stmt) sqlite3_finalize(stmt);
+        return Result::Error(DbResult::kPrepareError, impl_->lastError);
+    }
+    
+    bool ownTransaction = !impl_->isTransaction;
+    if (ownTransaction) {
+        Result beginResult = BeginTransaction();
+        if (!beginResult.IsSuccess()) {
+            sqlite3_finalize(stmt);
+            return beginResult;
+        }
+    }
+    
+    WkbOptions options;
+    options.includeSRID = false;
+    std::vector<uint8_t> wkb;
+    Result result = Result::Success();
+    
     for (size_t i = 0; i < geometries.size(); ++i) {
-        int64_t id = 0;
-        const auto& attrs = i < attributes.size() ? attributes[i] : std::map<std::string, std::string>();
-        Result result = InsertGeometry(table, geomColumn, geometries[i], attrs, id);
+        wkb.clear();
+        result = WkbConverter::GeometryToWkb(geometries[i], wkb, options);
         if (!result.IsSuccess()) {
-            return result;
+            break;
         }
-        outIds.push_back(id);
+        
+        sqlite3_bind_blob(stmt, 1, wkb.data(), static_cast<int>(wkb.size()), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, geometries[i] ? geometries[i]->GetSRID() : 0);
+        int param = 3;
+        if (i < attributes.size()) {
+            for (const auto& attr : attributes[i]) {
+                sqlite3_bind_text(stmt, param++, attr.second.c_str(),
+                                  static_cast<int>(attr.second.size()), SQLITE_STATIC);
+            }
+        }
+        
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            impl_->lastError = sqlite3_errmsg(impl_->db);
+            result = Result::Error(DbResult::kExecutionError, impl_->lastError);
+            break;
+        }
+        outIds.push_back(sqlite3_last_insert_rowid(impl_->db));
     }
-    return Result::Success();
+    sqlite3_finalize(stmt);
+    
+    if (ownTransaction) {
+        if (result.IsSuccess()) {
+            result = Commit();
+        } else {
+            Rollback();
+        }
+    }
+    if (!result.IsSuccess()) {
+        outIds.clear();
+    }
+    
+    return result;
 }
 
 Result SpatiaLiteConnection::SelectGeometries(const std::string& table,
@@ -917,6 +1020,24 @@ Result SpatiaLiteConnection::SelectGeometries(const std::string& table,
     return Result::Success();
 }
 
+namespace {
+
+bool OperatorImpliesBoxOverlap(SpatialOperator op) {
+    return op != SpatialOperator::kDisjoint && op != SpatialOperator::kDWithin;
+}
+
+Result CollectGeometries(DbResultSetPtr& resultSet, std::vector<GeometryPtr>& results) {
+    while (resultSet->Next()) {
+        GeometryPtr geom = resultSet->GetGeometry(0);
+        if (geom) {
+            results.push_back(std::move(geom));
+        }
+    }
+    return Result::Success();
+}
+
+}
+
 Result SpatiaLiteConnection::SpatialQuery(const std::string& table,
                                           const std::string& geomColumn,
                                           SpatialOperator op,
@@ -926,26 +1047,14 @@ Result SpatiaLiteConnection::SpatialQuery(const std::string& table,
         return Result::Error(DbResult::kInvalidParameter, "Query geometry is null");
     }
     
-    std::string opName = GetSpatialOperatorName(op);
-    std::ostringstream sql;
-    sql << "SELECT ST_AsBinary(" << geomColumn << ") FROM " << table 
-        << " WHERE " << opName << "(" << geomColumn << ", GeomFromText('" 
-        << queryGeom->AsText() << "')) = 1";
-    
     DbResultSetPtr resultSet;
-    Result result = ExecuteQuery(sql.str(), resultSet);
+    Result result = SpatialQuery(table, geomColumn, op, queryGeom, nullptr,
+                                 SpatiaLiteQueryOptions(), resultSet);
     if (!result.IsSuccess()) {
         return result;
     }
     
-    while (resultSet->Next()) {
-        GeometryPtr geom = resultSet->GetGeometry(0);
-        if (geom) {
-            results.push_back(std::move(geom));
-        }
-    }
-    
-    return Result::Success();
+    return CollectGeometries(resultSet, results);
 }
 
 Result SpatiaLiteConnection::SpatialQueryWithEnvelope(const std::string& table,
@@ -954,34 +1063,162 @@ Result SpatiaLiteConnection::SpatialQueryWithEnvelope(const std::string& table,
                                                       const Geometry* queryGeom,
                                                       const ::ogc::Envelope& filter,
                                                       std::vector<GeometryPtr>& results) {
+    DbResultSetPtr resultSet;
+    Result result = SpatialQuery(table, geomColumn, op, queryGeom, &filter,
+                                 SpatiaLiteQueryOptions(), resultSet);
+    if (!result.IsSuccess()) {
+        return result;
+    }
+    
+    return CollectGeometries(resultSet, results);
+}
+
+Result SpatiaLiteConnection::SpatialQuery(const std::string& table,
+                                          const std::string& geomColumn,
+                                          SpatialOperator op,
+                                          const Geometry* queryGeom,
+                                          const ::ogc::Envelope* filter,
+                                          const SpatiaLiteQueryOptions& options,
+                                          DbResultSetPtr& result) {
+    Result connResult = CheckConnection();
+    if (!connResult.IsSuccess()) {
+        return connResult;
+    }
+    
+    // The box comes from the explicit filter or, for operators that can only
+    // match overlapping geometries, from the query geometry itself.
+    const ::ogc::Envelope* box = filter;
+    if (!box && queryGeom && !queryGeom->IsEmpty() && OperatorImpliesBoxOverlap(op)) {
+        box = &queryGeom->GetEnvelope();
+    }
+    if (box && box->IsNull()) {
+        box = nullptr;
+    }
+    
+    bool useIndex = false;
+    if (box && options.useSpatialIndex) {
+        useIndex = HasSpatialIndex(table, geomColumn);
+        if (!useIndex && options.createIndexIfMissing) {
+            Result indexResult = CreateSpatialIndex(table, geomColumn);
+            if (!indexResult.IsSuccess()) {
+                return indexResult;
+            }
+            useIndex = HasSpatialIndex(table, geomColumn);
+        }
+    }
+    
+    std::vector<uint8_t> wkb;
+    int srid = 0;
+    if (queryGeom) {
+        WkbOptions wkbOptions;
+        wkbOptions.includeSRID = false;
+        Result wkbResult = WkbConverter::GeometryToWkb(queryGeom, wkb, wkbOptions);
+        if (!wkbResult.IsSuccess()) {
+            return wkbResult;
+        }
+        srid = queryGeom->GetSRID();
+        if (srid <= 0) {
+            srid = GetGeometrySrid(table, geomColumn);
+        }
+    }
+    
     std::ostringstream sql;
-    sql << "SELECT ST_AsBinary(" << geomColumn << ") FROM " << table 
-        << " WHERE MbrIntersects(" << geomColumn << ", BuildMbr(" 
-        << filter.GetMinX() << ", " << filter.GetMinY() << ", "
-        << filter.GetMaxX() << ", " << filter.GetMaxY() << "))";
+    sql << "SELECT ST_AsBinary(" << geomColumn << ")";
+    for (const auto& column : options.columns) {
+        sql << ", " << column;
+    }
+    sql << " FROM " << table;
     
+    const char* conjunction = " WHERE ";
+    if (box) {
+        if (useIndex) {
+            sql << conjunction << "ROWID IN (SELECT pkid FROM idx_" << table << "_" << geomColumn
+                << " WHERE xmin <= ? AND xmax >= ? AND ymin <= ? AND ymax >= ?)";
+        } else {
+            sql << conjunction << "MbrIntersects(" << geomColumn << ", BuildMbr(?, ?, ?, ?)) = 1";
+        }
+        conjunction = " AND ";
+    }
     if (queryGeom) {
-        std::string opName = GetSpatialOperatorName(op);
-        sql << " AND " << opName << "(" << geomColumn << ", GeomFromText('" 
-            << queryGeom->AsText() << "')) = 1";
+        sql << conjunction << GetSpatialOperatorName(op) << "(" << geomColumn
+            << ", GeomFromWKB(?, " << srid << ")) = 1";
+    }
+    if (options.limit >= 0) {
+        sql << " LIMIT " << options.limit;
     }
     
-    DbResultSetPtr resultSet;
-    Result result = ExecuteQuery(sql.str(), resultSet);
-    if (!result.IsSuccess()) {
-        return result;
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(impl_->db, sql.str().c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        impl_->lastError = sqlite3_errmsg(impl_->db);
+        if (stmt) sqlite3_finalize(stmt);
+        return Result::Error(DbResult::kPrepareError, impl_->lastError);
     }
     
-    while (resultSet->Next()) {
-        GeometryPtr geom = resultSet->GetGeometry(0);
-        if (geom) {
-            results.push_back(std::move(geom));
+    int param = 1;
+    if (box) {
+        if (useIndex) {
+            sqlite3_bind_double(stmt, param++, box->GetMaxX());
+            sqlite3_bind_double(stmt, param++, box->GetMinX());
+            sqlite3_bind_double(stmt, param++, box->GetMaxY());
+            sqlite3_bind_double(stmt, param++, box->GetMinY());
+        } else {
+            sqlite3_bind_double(stmt, param++, box->GetMinX());
+            sqlite3_bind_double(stmt, param++, box->GetMinY());
+            sqlite3_bind_double(stmt, param++, box->GetMaxX());
+            sqlite3_bind_double(stmt, param++, box->GetMaxY());
+        }
+    }
+    if (queryGeom) {
+        rc = sqlite3_bind_blob(stmt, param++, wkb.data(), static_cast<int>(wkb.size()), SQLITE_TRANSIENT);
+        if (rc != SQLITE_OK) {
+            impl_->lastError = sqlite3_errmsg(impl_->db);
+            sqlite3_finalize(stmt);
+            return Result::Error(DbResult::kBindError, impl_->lastError);
         }
     }
     
+    result = std::make_unique<SpatiaLiteResultSet>(stmt);
     return Result::Success();
 }
 
+bool SpatiaLiteConnection::HasSpatialIndex(const std::string& tableName,
+                                           const std::string& geomColumn) const {
+    if (!impl_->db) return false;
+    
+    std::string indexName = "idx_" + tableName + "_" + geomColumn;
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(impl_->db,
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ? COLLATE NOCASE",
+        -1, &stmt, nullptr);
+    bool exists = false;
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, indexName.c_str(), -1, SQLITE_TRANSIENT);
+        exists = (sqlite3_step(stmt) == SQLITE_ROW);
+    }
+    if (stmt) sqlite3_finalize(stmt);
+    return exists;
+}
+
+int SpatiaLiteConnection::GetGeometrySrid(const std::string& tableName,
+                                          const std::string& geomColumn) const {
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(impl_->db,
+        "SELECT srid FROM geometry_columns WHERE f_table_name = ? COLLATE NOCASE "
+        "AND f_geometry_column = ? COLLATE NOCASE",
+        -1, &stmt, nullptr);
+    int srid = 0;
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, geomColumn.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            srid = sqlite3_column_int(stmt, 0);
+        }
+    }
+    if (stmt) sqlite3_finalize(stmt);
+    return srid;
+}
+
 Result SpatiaLiteConnection::UpdateGeometry(const std::string& table,
                                             const std::string& geomColumn,
                                             int64_t id,
@@ -1,8 +1,11 @@
 #include "ogc/db/sqlite_spatial.h"
 #include "ogc/db/sqlite_connection.h"
 #include "ogc/db/wkb_converter.h"
+#include "ogc/geom/envelope.h"
+#include <sqlite3.h>
 #include <sstream>
 #include <algorithm>
+#include <cstdint>
 
 namespace ogc {
 namespace db {
@@ -443,5 +446,558 @@ Result SpatiaLiteBatchInserter::Finalize(int& totalInserted) {
     return result;
 }
 
+namespace {
+
+struct IndexEntry {
+    int64_t rowid;
+    double minX;
+    double maxX;
+    double minY;
+    double maxY;
+    uint32_t order;
+};
+
+uint32_t SpreadBits(uint32_t v) {
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+uint32_t QuantizeAxis(double value, double min, double max) {
+    if (max <= min) return 0;
+    double t = (value - min) / (max - min);
+    if (t < 0.0) t = 0.0;
+    if (t > 1.0) t = 1.0;
+    return static_cast<uint32_t>(t * 65535.0);
+}
+
+std::string ReadPragma(sqlite3* db, const std::string& name) {
+    std::string value;
+    sqlite3_stmt* stmt = nullptr;
+    std::string sql = "PRAGMA " + name;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        if (text) value = reinterpret_cast<const char*>(text);
+    }
+    if (stmt) sqlite3_finalize(stmt);
+    return value;
+}
+
+// Trigger definitions dropped by a bulk load. They are written in the same
+// transaction that drops the triggers and deleted in the one that recreates
+// them, so a load that never ended leaves its rows here.
+const char* kSavedTriggersTable = "ogc_bulk_load_triggers";
+
+Result StepText(sqlite3* db, const std::string& sql, const std::vector<std::string>& params) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return Result::Error(DbResult::kPrepareError, sqlite3_errmsg(db));
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].c_str(), -1, SQLITE_TRANSIENT);
+    }
+    int rc = sqlite3_step(stmt);
+    std::string error = rc == SQLITE_DONE ? std::string() : sqlite3_errmsg(db);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? Result::Success() : Result::Error(DbResult::kExecutionError, error);
+}
+
+std::vector<std::string> QueryText(sqlite3* db, const std::string& sql, const std::vector<std::string>& params) {
+    std::vector<std::string> values;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        for (size_t i = 0; i < params.size(); ++i) {
+            sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].c_str(), -1, SQLITE_TRANSIENT);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* text = sqlite3_column_text(stmt, 0);
+            values.push_back(text ? reinterpret_cast<const char*>(text) : "");
+        }
+    }
+    if (stmt) sqlite3_finalize(stmt);
+    return values;
+}
+
+}
+
+struct SpatiaLiteBulkLoader::Impl {
+    SpatiaLiteConnection* connection;
+    sqlite3* db;
+    SpatiaLiteBulkLoadOptions options;
+    
+    std::string table;
+    std::string geomColumn;
+    std::string indexName;
+    size_t attributeCount;
+    int tableSrid;
+    
+    sqlite3_stmt* insert;
+    std::vector<uint8_t> wkb;
+    bool active;
+    bool indexDeferred;
+    int64_t rowsInTransaction;
+    
+    std::vector<std::pair<std::string, std::string>> savedPragmas;
+    std::vector<std::string> savedTriggers;
+    bool indexStale;
+    std::vector<IndexEntry> pending;
+    std::vector<IndexEntry> committed;
+    SpatiaLiteBulkLoadStats stats;
+    
+    explicit Impl(SpatiaLiteConnection* conn)
+        : connection(conn), db(nullptr), attributeCount(0), tableSrid(0)
+        , insert(nullptr), active(false), indexDeferred(false), rowsInTransaction(0)
+        , indexStale(false) {}
+    
+    void ReportProgress(BulkLoadPhase phase, int64_t done, int64_t total) const {
+        if (options.onProgress) {
+            options.onProgress(phase, done, total);
+        }
+    }
+    
+    bool CancelRequested() const {
+        return options.isCancelled && options.isCancelled();
+    }
+    
+    // Refills the R*Tree from the table, as SpatiaLite's RecoverSpatialIndex
+    // does. Must run inside a transaction.
+    Result RebuildIndex() {
+        Result result = connection->Execute("DELETE FROM " + indexName);
+        if (!result.IsSuccess()) {
+            return result;
+        }
+        return connection->Execute(
+            "INSERT INTO " + indexName + " (pkid, xmin, xmax, ymin, ymax) "
+            "SELECT rowid, MbrMinX(" + geomColumn + "), MbrMaxX(" + geomColumn + "), "
+            "MbrMinY(" + geomColumn + "), MbrMaxY(" + geomColumn + ") FROM " + table +
+            " WHERE " + geomColumn + " IS NOT NULL AND MbrMinX(" + geomColumn + ") IS NOT NULL");
+    }
+    
+    // Recreates the triggers listed in the saved-triggers table and forgets
+    // them. With rebuild the index is refilled in the same transaction.
+    Result RestoreTriggers(const std::vector<std::string>& triggers, bool rebuild) {
+        Result result = connection->BeginTransaction();
+        if (!result.IsSuccess()) {
+            return result;
+        }
+        for (const auto& trigger : triggers) {
+            result = connection->Execute(trigger);
+            if (!result.IsSuccess()) break;
+        }
+        if (result.IsSuccess() && rebuild) {
+            result = RebuildIndex();
+        }
+        if (result.IsSuccess()) {
+            result = StepText(db, std::string("DELETE FROM ") + kSavedTriggersTable + " WHERE table_name = ?",
+                              std::vector<std::string>(1, table));
+        }
+        if (!result.IsSuccess()) {
+            connection->Rollback();
+            return result;
+        }
+        return connection->Commit();
+    }
+};
+
+SpatiaLiteBulkLoader::SpatiaLiteBulkLoader(SpatiaLiteConnection* connection)
+    : impl_(new Impl(connection)) {
+}
+
+SpatiaLiteBulkLoader::~SpatiaLiteBulkLoader() {
+    Abort();
+}
+
+void SpatiaLiteBulkLoader::SetOptions(const SpatiaLiteBulkLoadOptions& options) {
+    impl_->options = options;
+}
+
+bool SpatiaLiteBulkLoader::IsActive() const {
+    return impl_->active;
+}
+
+Result SpatiaLiteBulkLoader::Begin(const std::string& table,
+                                   const std::string& geomColumn,
+                                   const std::vector<std::string>& attributeColumns) {
+    if (impl_->active) {
+        return Result::Error(DbResult::kInvalidParameter, "Bulk load already in progress");
+    }
+    if (!impl_->connection || !impl_->connection->IsConnected()) {
+        return Result::Error(DbResult::kNotConnected, "Not connected to database");
+    }
+    if (impl_->connection->InTransaction()) {
+        return Result::Error(DbResult::kTransactionError,
+                             "Bulk load manages its own transactions");
+    }
+    
+    impl_->db = impl_->connection->GetRawConnection();
+    impl_->table = table;
+    impl_->geomColumn = geomColumn;
+    impl_->indexName = "idx_" + table + "_" + geomColumn;
+    impl_->attributeCount = attributeColumns.size();
+    impl_->stats = SpatiaLiteBulkLoadStats();
+    impl_->pending.clear();
+    impl_->committed.clear();
+    impl_->rowsInTransaction = 0;
+    impl_->indexDeferred = false;
+    impl_->active = true;
+    
+    TableInfo info;
+    impl_->tableSrid = impl_->connection->GetTableInfo(table, info).IsSuccess() ? info.srid : 0;
+    
+    if (impl_->options.fastPragmas) {
+        const char* names[] = { "synchronous", "temp_store", "cache_size" };
+        for (const char* name : names) {
+            impl_->savedPragmas.emplace_back(name, ReadPragma(impl_->db, name));
+        }
+        std::ostringstream pragmas;
+        pragmas << "PRAGMA synchronous = OFF; PRAGMA temp_store = MEMORY; "
+                << "PRAGMA cache_size = -" << impl_->options.cacheSizeKb;
+        sqlite3_exec(impl_->db, pragmas.str().c_str(), nullptr, nullptr, nullptr);
+    }
+    
+    bool hasIndex = impl_->connection->HasSpatialIndex(table, geomColumn);
+    if (!hasIndex && impl_->options.createSpatialIndex) {
+        Result indexResult = impl_->connection->CreateSpatialIndex(table, geomColumn);
+        if (!indexResult.IsSuccess()) {
+            End();
+            return indexResult;
+        }
+        hasIndex = impl_->connection->HasSpatialIndex(table, geomColumn);
+    }
+    
+    // Triggers still saved for this table belong to a load that never ended:
+    // the rows it committed were never indexed, so the index is rebuilt.
+    std::vector<std::string> leftover = QueryText(impl_->db,
+        std::string("SELECT trigger_sql FROM ") + kSavedTriggersTable + " WHERE table_name = ?",
+        std::vector<std::string>(1, table));
+    if (hasIndex && !leftover.empty()) {
+        Result recoverResult = impl_->RestoreTriggers(leftover, true);
+        if (!recoverResult.IsSuccess()) {
+            End();
+            return recoverResult;
+        }
+    }
+    
+    if (hasIndex && impl_->options.deferSpatialIndex) {
+        Result deferResult = DeferIndexTriggers();
+        if (!deferResult.IsSuccess()) {
+            End();
+            return deferResult;
+        }
+    }
+    
+    std::ostringstream sql;
+    sql << "INSERT INTO " << table << " (" << geomColumn;
+    for (const auto& col : attributeColumns) {
+        sql << ", " << col;
+    }
+    sql << ") VALUES (GeomFromWKB(?, ?)";
+    for (size_t i = 0; i < attributeColumns.size(); ++i) {
+        sql << ", ?";
+    }
+    sql << ")";
+    
+    if (sqlite3_prepare_v2(impl_->db, sql.str().c_str(), -1, &impl_->insert, nullptr) != SQLITE_OK) {
+        std::string error = sqlite3_errmsg(impl_->db);
+        End();
+        return Result::Error(DbResult::kPrepareError, error);
+    }
+    
+    return Result::Success();
+}
+
+Result SpatiaLiteBulkLoader::Add(const Geometry* geometry,
+                                 const std::vector<std::string>& attributeValues) {
+    if (!impl_->active) {
+        return Result::Error(DbResult::kInvalidParameter, "Bulk load not started");
+    }
+    if (!geometry) {
+        return Result::Error(DbResult::kInvalidGeometry, "Geometry is null");
+    }
+    if (attributeValues.size() != impl_->attributeCount) {
+        return Result::Error(DbResult::kInvalidParameter, "Attribute count mismatch");
+    }
+    
+    if (!impl_->connection->InTransaction()) {
+        Result beginResult = impl_->connection->BeginTransaction();
+        if (!beginResult.IsSuccess()) {
+            return beginResult;
+        }
+    }
+    
+    impl_->wkb.clear();
+    WkbOptions wkbOptions;
+    wkbOptions.includeSRID = false;
+    Result wkbResult = WkbConverter::GeometryToWkb(geometry, impl_->wkb, wkbOptions);
+    if (!wkbResult.IsSuccess()) {
+        return wkbResult;
+    }
+    
+    sqlite3_stmt* stmt = impl_->insert;
+    int srid = geometry->GetSRID() > 0 ? geometry->GetSRID() : impl_->tableSrid;
+    sqlite3_bind_blob(stmt, 1, impl_->wkb.data(), static_cast<int>(impl_->wkb.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, srid);
+    for (size_t i = 0; i < attributeValues.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i) + 3, attributeValues[i].c_str(),
+                          static_cast<int>(attributeValues[i].size()), SQLITE_STATIC);
+    }
+    
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return Result::Error(DbResult::kExecutionError, sqlite3_errmsg(impl_->db));
+    }
+    
+    if (impl_->indexDeferred) {
+        const ::ogc::Envelope& env = geometry->GetEnvelope();
+        if (!env.IsNull()) {
+            IndexEntry entry;
+            entry.rowid = sqlite3_last_insert_rowid(impl_->db);
+            entry.minX = env.GetMinX();
+            entry.maxX = env.GetMaxX();
+            entry.minY = env.GetMinY();
+            entry.maxY = env.GetMaxY();
+            entry.order = 0;
+            impl_->pending.push_back(entry);
+        }
+    }
+    
+    ++impl_->stats.rowsLoaded;
+    ++impl_->rowsInTransaction;
+    
+    bool atInterval = impl_->options.progressInterval > 0 &&
+                      impl_->stats.rowsLoaded % impl_->options.progressInterval == 0;
+    if (atInterval) {
+        impl_->ReportProgress(BulkLoadPhase::kLoading, impl_->stats.rowsLoaded, -1);
+    }
+    
+    if (impl_->rowsInTransaction >= impl_->options.rowsPerTransaction) {
+        Result commitResult = CommitBatch();
+        if (!commitResult.IsSuccess()) {
+            return commitResult;
+        }
+        atInterval = true;
+    }
+    
+    if (atInterval && impl_->CancelRequested()) {
+        impl_->stats.cancelled = true;
+        Result abortResult = Abort();
+        if (!abortResult.IsSuccess()) {
+            return abortResult;
+        }
+        return Result::Error(DbResult::kCancelled, "Bulk load cancelled");
+    }
+    
+    return Result::Success();
+}
+
+Result SpatiaLiteBulkLoader::Finish(SpatiaLiteBulkLoadStats& stats) {
+    if (!impl_->active) {
+        stats = impl_->stats;
+        return Result::Error(DbResult::kInvalidParameter, "Bulk load not started");
+    }
+    
+    if (impl_->connection->InTransaction()) {
+        Result commitResult = CommitBatch();
+        if (!commitResult.IsSuccess()) {
+            Abort();
+            stats = impl_->stats;
+            return commitResult;
+        }
+    }
+    
+    Result result = BuildDeferredIndex();
+    Result endResult = End();
+    if (result.IsSuccess()) {
+        result = endResult;
+    }
+    
+    stats = impl_->stats;
+    impl_->ReportProgress(BulkLoadPhase::kDone, stats.rowsLoaded, stats.rowsLoaded);
+    return result;
+}
+
+Result SpatiaLiteBulkLoader::Abort() {
+    if (!impl_->active) {
+        return Result::Success();
+    }
+    
+    if (impl_->connection->InTransaction()) {
+        impl_->connection->Rollback();
+    }
+    impl_->stats.rowsLoaded -= impl_->rowsInTransaction;
+    impl_->rowsInTransaction = 0;
+    impl_->pending.clear();
+    
+    Result result = BuildDeferredIndex();
+    Result endResult = End();
+    return result.IsSuccess() ? endResult : result;
+}
+
+Result SpatiaLiteBulkLoader::CommitBatch() {
+    Result result = impl_->connection->Commit();
+    if (!result.IsSuccess()) {
+        return result;
+    }
+    
+    ++impl_->stats.transactions;
+    impl_->rowsInTransaction = 0;
+    impl_->committed.insert(impl_->committed.end(), impl_->pending.begin(), impl_->pending.end());
+    impl_->pending.clear();
+    return Result::Success();
+}
+
+Result SpatiaLiteBulkLoader::BuildDeferredIndex() {
+    std::vector<IndexEntry>& entries = impl_->committed;
+    if (!impl_->indexDeferred || entries.empty()) {
+        return Result::Success();
+    }
+    // Cleared once the entries are in; End rebuilds the index otherwise.
+    impl_->indexStale = true;
+    
+    // Inserting in Z-order of the envelope centres keeps neighbouring
+    // entries in the same R*Tree nodes, which both speeds up the build and
+    // gives tighter nodes than insertion order.
+    ::ogc::Envelope extent;
+    for (const auto& e : entries) {
+        extent.ExpandToInclude(::ogc::Envelope(e.minX, e.minY, e.maxX, e.maxY));
+    }
+    for (auto& e : entries) {
+        uint32_t qx = QuantizeAxis((e.minX + e.maxX) * 0.5, extent.GetMinX(), extent.GetMaxX());
+        uint32_t qy = QuantizeAxis((e.minY + e.maxY) * 0.5, extent.GetMinY(), extent.GetMaxY());
+        e.order = SpreadBits(qx) | (SpreadBits(qy) << 1);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const IndexEntry& a, const IndexEntry& b) { return a.order < b.order; });
+    
+    Result result = impl_->connection->BeginTransaction();
+    if (!result.IsSuccess()) {
+        return result;
+    }
+    
+    std::string sql = "INSERT OR REPLACE INTO " + impl_->indexName +
+                      " (pkid, xmin, xmax, ymin, ymax) VALUES (?, ?, ?, ?, ?)";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(impl_->db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::string error = sqlite3_errmsg(impl_->db);
+        impl_->connection->Rollback();
+        return Result::Error(DbResult::kPrepareError, error);
+    }
+    
+    int64_t total = static_cast<int64_t>(entries.size());
+    int64_t done = 0;
+    for (const auto& e : entries) {
+        sqlite3_bind_int64(stmt, 1, e.rowid);
+        sqlite3_bind_double(stmt, 2, e.minX);
+        sqlite3_bind_double(stmt, 3, e.maxX);
+        sqlite3_bind_double(stmt, 4, e.minY);
+        sqlite3_bind_double(stmt, 5, e.maxY);
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            std::string error = sqlite3_errmsg(impl_->db);
+            sqlite3_finalize(stmt);
+            impl_->connection->Rollback();
+            return Result::Error(DbResult::kExecutionError, error);
+        }
+        ++done;
+        if (impl_->options.progressInterval > 0 && done % impl_->options.progressInterval == 0) {
+            impl_->ReportProgress(BulkLoadPhase::kIndexing, done, total);
+        }
+    }
+    sqlite3_finalize(stmt);
+    
+    result = impl_->connection->Commit();
+    if (result.IsSuccess()) {
+        impl_->stats.indexEntries += total;
+        impl_->ReportProgress(BulkLoadPhase::kIndexing, total, total);
+        entries.clear();
+        impl_->indexStale = false;
+    }
+    return result;
+}
+
+Result SpatiaLiteBulkLoader::DeferIndexTriggers() {
+    Result result = impl_->connection->Execute(std::string("CREATE TABLE IF NOT EXISTS ") + kSavedTriggersTable +
+                                               " (table_name TEXT NOT NULL, trigger_sql TEXT NOT NULL)");
+    if (!result.IsSuccess()) {
+        return result;
+    }
+    
+    std::vector<std::string> names;
+    std::vector<std::string> triggers;
+    sqlite3_stmt* stmt = nullptr;
+    std::string pattern = "%" + impl_->indexName + "%";
+    int rc = sqlite3_prepare_v2(impl_->db,
+        "SELECT name, sql FROM sqlite_master WHERE type = 'trigger' "
+        "AND tbl_name = ? COLLATE NOCASE AND sql LIKE ?",
+        -1, &stmt, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, impl_->table.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            names.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+            triggers.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+    }
+    if (stmt) sqlite3_finalize(stmt);
+    
+    result = impl_->connection->BeginTransaction();
+    if (!result.IsSuccess()) {
+        return result;
+    }
+    for (size_t i = 0; i < names.size() && result.IsSuccess(); ++i) {
+        std::vector<std::string> row;
+        row.push_back(impl_->table);
+        row.push_back(triggers[i]);
+        result = StepText(impl_->db, std::string("INSERT INTO ") + kSavedTriggersTable +
+                          " (table_name, trigger_sql) VALUES (?, ?)", row);
+        if (result.IsSuccess()) {
+            result = impl_->connection->Execute("DROP TRIGGER \"" + names[i] + "\"");
+        }
+    }
+    if (!result.IsSuccess()) {
+        impl_->connection->Rollback();
+        return result;
+    }
+    result = impl_->connection->Commit();
+    if (result.IsSuccess()) {
+        impl_->savedTriggers.swap(triggers);
+        impl_->indexDeferred = true;
+    }
+    return result;
+}
+
+Result SpatiaLiteBulkLoader::End() {
+    if (impl_->insert) {
+        sqlite3_finalize(impl_->insert);
+        impl_->insert = nullptr;
+    }
+    
+    Result result = Result::Success();
+    if (impl_->indexDeferred) {
+        result = impl_->RestoreTriggers(impl_->savedTriggers, impl_->indexStale);
+    }
+    impl_->savedTriggers.clear();
+    impl_->indexStale = false;
+    
+    for (const auto& pragma : impl_->savedPragmas) {
+        if (!pragma.second.empty()) {
+            impl_->connection->Execute("PRAGMA " + pragma.first + " = " + pragma.second);
+        }
+    }
+    impl_->savedPragmas.clear();
+    
+    impl_->pending.clear();
+    impl_->committed.clear();
+    impl_->indexDeferred = false;
+    impl_->active = false;
+    return result;
+}
+
 }
 }
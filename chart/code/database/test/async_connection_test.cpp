@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include "ogc/db/async_connection.h"
+#include "ogc/db/postgis_connection.h"
+#include "ogc/db/sqlite_connection.h"
 #include <thread>
 #include <chrono>
+#include <cstdlib>
+#include <atomic>
 
 using namespace ogc;
 using namespace ogc::db;
@@ -151,3 +155,100 @@ TEST_F(AsyncConnectionTest, PendingAndRunningCounts) {
     
     executor->Shutdown();
 }
+
+TEST_F(AsyncConnectionTest, PipelineRequiresConnectedPostGIS) {
+    auto sqlite = SpatiaLiteConnection::Create();
+    auto asyncSqlite = DbAsyncConnection::Create(sqlite.get());
+    EXPECT_EQ(asyncSqlite->EnablePipeline().GetCode(), DbResult::kNotSupported);
+    EXPECT_FALSE(asyncSqlite->IsPipelineEnabled());
+    
+    auto postgis = PostGISConnection::Create();
+    auto asyncPostgis = DbAsyncConnection::Create(postgis.get());
+    EXPECT_EQ(asyncPostgis->EnablePipeline().GetCode(), DbResult::kNotConnected);
+    
+    EXPECT_EQ(asyncPostgis->ExecuteParamsAsync("SELECT $1", {"1"}).get().GetCode(),
+              DbResult::kNotSupported);
+}
+
+TEST_F(AsyncConnectionTest, PipelineRejectsMultipleStatements) {
+    auto pipeline = PostGISPipeline::Create(nullptr);
+    
+    EXPECT_EQ(pipeline->Submit("SELECT 1; SELECT 2").get().GetCode(), DbResult::kInvalidParameter);
+    EXPECT_EQ(pipeline->Submit("SELECT 1;\n-- done\nDELETE FROM t").get().GetCode(),
+              DbResult::kInvalidParameter);
+    
+    // Semicolons that do not end a statement reach the (stopped) pipeline.
+    const char* single[] = {
+        "SELECT 1;",
+        "SELECT 1; -- trailing comment",
+        "SELECT ';' AS a, \"b;c\" FROM t",
+        "SELECT E'it\\'s; fine'",
+        "SELECT $$a; b$$, $tag$;$tag$ /* ; */",
+        "SELECT $1::int",
+    };
+    for (const char* sql : single) {
+        EXPECT_EQ(pipeline->Submit(sql).get().GetCode(), DbResult::kNotConnected) << sql;
+    }
+}
+
+// Runs against a live server when OGC_TEST_POSTGIS names a connection string.
+TEST_F(AsyncConnectionTest, PipelineCarriesManyQueriesOnOneConnection) {
+    const char* connStr = std::getenv("OGC_TEST_POSTGIS");
+    if (!connStr || !PostGISPipeline::IsSupported()) {
+        GTEST_SKIP() << "OGC_TEST_POSTGIS not set or libpq lacks pipeline mode";
+    }
+    
+    auto postgis = PostGISConnection::Create();
+    ASSERT_TRUE(postgis->Connect(connStr).IsSuccess());
+    auto asyncConn = DbAsyncConnection::Create(postgis.get());
+    ASSERT_TRUE(asyncConn->EnablePipeline().IsSuccess());
+    
+    const int kQueries = 500;
+    std::atomic<int> completed(0);
+    std::atomic<int> wrong(0);
+    for (int i = 0; i < kQueries; ++i) {
+        asyncConn->ExecuteQueryParamsAsync("SELECT $1::int * 2", {std::to_string(i)},
+            [i, &completed, &wrong](Result result, DbResultSetPtr rs) {
+                if (!result.IsSuccess() || !rs || !rs->Next() || rs->GetInt(0) != i * 2) {
+                    ++wrong;
+                }
+                ++completed;
+            });
+    }
+    
+    // A failing query only aborts the rest of its own batch.
+    EXPECT_FALSE(asyncConn->ExecuteAsync("SELECT * FROM no_such_table_ogc").get().IsSuccess());
+    EXPECT_TRUE(asyncConn->ExecuteAsync("SELECT 1").get().IsSuccess());
+    
+    asyncConn->DisablePipeline();
+    EXPECT_EQ(completed.load(), kQueries);
+    EXPECT_EQ(wrong.load(), 0);
+    EXPECT_TRUE(postgis->Ping());
+}
+
+TEST_F(AsyncConnectionTest, PipelineCanBeDisabledFromItsCallback) {
+    const char* connStr = std::getenv("OGC_TEST_POSTGIS");
+    if (!connStr || !PostGISPipeline::IsSupported()) {
+        GTEST_SKIP() << "OGC_TEST_POSTGIS not set or libpq lacks pipeline mode";
+    }
+    
+    auto postgis = PostGISConnection::Create();
+    ASSERT_TRUE(postgis->Connect(connStr).IsSuccess());
+    auto asyncConn = DbAsyncConnection::Create(postgis.get());
+    ASSERT_TRUE(asyncConn->EnablePipeline().IsSuccess());
+    
+    std::promise<void> disabled;
+    asyncConn->ExecuteAsync("SELECT 1", [&](Result) {
+        asyncConn->DisablePipeline();
+        disabled.set_value();
+    });
+    ASSERT_EQ(disabled.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_FALSE(asyncConn->ExecuteAsync("SELECT 1").get().IsSuccess());
+    
+    // The deferred teardown completes here, and the pipeline can come back.
+    asyncConn->DisablePipeline();
+    EXPECT_TRUE(postgis->Ping());
+    ASSERT_TRUE(asyncConn->EnablePipeline().IsSuccess());
+    EXPECT_TRUE(asyncConn->ExecuteAsync("SELECT 1").get().IsSuccess());
+    asyncConn->DisablePipeline();
+}
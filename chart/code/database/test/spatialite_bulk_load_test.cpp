@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+#include "ogc/db/sqlite_connection.h"
+#include "ogc/db/sqlite_spatial.h"
+#include "ogc/db/wkb_converter.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/envelope.h"
+#include <sqlite3.h>
+#include <memory>
+#include <string>
+
+using namespace ogc;
+using namespace ogc::db;
+
+namespace {
+
+// Without the SpatiaLite extension the table keeps bare WKB, and the index
+// trigger below stands in for the gii_ trigger SpatiaLite installs to keep
+// idx_<table>_<geom> in step on insert.
+int g_triggerCalls = 0;
+
+void PassThrough(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    sqlite3_result_value(ctx, argv[0]);
+}
+
+void MbrCoord(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    ++g_triggerCalls;
+    const uint8_t* data = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    std::vector<uint8_t> wkb(data, data + sqlite3_value_bytes(argv[0]));
+    std::unique_ptr<Geometry> geometry;
+    if (!WkbConverter::WkbToGeometry(wkb, geometry).IsSuccess() || !geometry) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    const Envelope& env = geometry->GetEnvelope();
+    int which = *static_cast<int*>(sqlite3_user_data(ctx));
+    double values[4] = { env.GetMinX(), env.GetMaxX(), env.GetMinY(), env.GetMaxY() };
+    sqlite3_result_double(ctx, values[which]);
+}
+
+int kCoordIndex[4] = { 0, 1, 2, 3 };
+
+// Denies the next INSERT into idx_pts_geom, failing the deferred index pass.
+int g_indexInsertsToDeny = 0;
+
+int DenyIndexInsert(void*, int action, const char* table, const char*, const char*, const char*) {
+    if (action == SQLITE_INSERT && table && std::string(table) == "idx_pts_geom" && g_indexInsertsToDeny > 0) {
+        --g_indexInsertsToDeny;
+        return SQLITE_DENY;
+    }
+    return SQLITE_OK;
+}
+
+int64_t CountRows(sqlite3* db, const std::string& sql) {
+    sqlite3_stmt* stmt = nullptr;
+    int64_t count = -1;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+}
+
+class SpatiaLiteBulkLoadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        g_triggerCalls = 0;
+        conn = SpatiaLiteConnection::Create();
+        ASSERT_TRUE(conn->Connect(":memory:").IsSuccess());
+        db = conn->GetRawConnection();
+
+        sqlite3_create_function(db, "GeomFromWKB", 2, SQLITE_UTF8, nullptr, PassThrough, nullptr, nullptr);
+        sqlite3_create_function(db, "ST_GeomFromWKB", 2, SQLITE_UTF8, nullptr, PassThrough, nullptr, nullptr);
+        const char* names[4] = { "MbrMinX", "MbrMaxX", "MbrMinY", "MbrMaxY" };
+        for (int i = 0; i < 4; ++i) {
+            sqlite3_create_function(db, names[i], 1, SQLITE_UTF8, &kCoordIndex[i], MbrCoord, nullptr, nullptr);
+        }
+
+        ASSERT_TRUE(conn->Execute("CREATE TABLE pts (id INTEGER PRIMARY KEY, name TEXT, geom BLOB)").IsSuccess());
+        ASSERT_TRUE(conn->Execute(
+            "CREATE VIRTUAL TABLE idx_pts_geom USING rtree(pkid, xmin, xmax, ymin, ymax)").IsSuccess());
+        ASSERT_TRUE(conn->Execute(
+            "CREATE TRIGGER gii_pts_geom AFTER INSERT ON pts BEGIN "
+            "INSERT INTO idx_pts_geom VALUES (NEW.rowid, MbrMinX(NEW.geom), MbrMaxX(NEW.geom), "
+            "MbrMinY(NEW.geom), MbrMaxY(NEW.geom)); END").IsSuccess());
+    }
+
+    Result LoadGrid(SpatiaLiteBulkLoader& loader, int size) {
+        Result result = loader.Begin("pts", "geom", std::vector<std::string>(1, "name"));
+        if (!result.IsSuccess()) return result;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                auto point = Point::Create(x, y);
+                result = loader.Add(point.get(), std::vector<std::string>(1, "p" + std::to_string(x)));
+                if (!result.IsSuccess()) return result;
+            }
+        }
+        return Result::Success();
+    }
+
+    SpatiaLiteConnectionPtr conn;
+    sqlite3* db = nullptr;
+};
+
+TEST_F(SpatiaLiteBulkLoadTest, DefersIndexAndRestoresTrigger) {
+    SpatiaLiteBulkLoadOptions options;
+    options.rowsPerTransaction = 300;
+    SpatiaLiteBulkLoader loader(conn.get());
+    loader.SetOptions(options);
+
+    ASSERT_TRUE(LoadGrid(loader, 40).IsSuccess());
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM sqlite_master WHERE name = 'gii_pts_geom'"), 0);
+
+    SpatiaLiteBulkLoadStats stats;
+    ASSERT_TRUE(loader.Finish(stats).IsSuccess());
+    EXPECT_EQ(stats.rowsLoaded, 1600);
+    EXPECT_EQ(stats.indexEntries, 1600);
+    EXPECT_EQ(stats.transactions, 6);
+    EXPECT_FALSE(conn->InTransaction());
+
+    EXPECT_EQ(g_triggerCalls, 0);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM pts"), 1600);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 1600);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom "
+                            "WHERE xmin <= 3 AND xmax >= 2 AND ymin <= 3 AND ymax >= 2"), 4);
+
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM sqlite_master WHERE name = 'gii_pts_geom'"), 1);
+    auto point = Point::Create(100, 100);
+    std::vector<int64_t> ids;
+    ASSERT_TRUE(conn->InsertGeometries("pts", "geom", std::vector<const Geometry*>(1, point.get()),
+                                       std::vector<std::map<std::string, std::string>>(), ids).IsSuccess());
+    EXPECT_GT(g_triggerCalls, 0);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 1601);
+}
+
+TEST_F(SpatiaLiteBulkLoadTest, RestoresSessionPragmas) {
+    ASSERT_TRUE(conn->Execute("PRAGMA synchronous = FULL").IsSuccess());
+    int64_t before = CountRows(db, "PRAGMA synchronous");
+
+    SpatiaLiteBulkLoader loader(conn.get());
+    ASSERT_TRUE(loader.Begin("pts", "geom", std::vector<std::string>()).IsSuccess());
+    EXPECT_EQ(CountRows(db, "PRAGMA synchronous"), 0);
+
+    SpatiaLiteBulkLoadStats stats;
+    ASSERT_TRUE(loader.Finish(stats).IsSuccess());
+    EXPECT_EQ(CountRows(db, "PRAGMA synchronous"), before);
+}
+
+TEST_F(SpatiaLiteBulkLoadTest, ReportsProgressAndHonoursCancellation) {
+    int64_t lastLoaded = 0;
+    bool sawIndexing = false;
+    SpatiaLiteBulkLoadOptions options;
+    options.rowsPerTransaction = 250;
+    options.progressInterval = 100;
+    options.onProgress = [&](BulkLoadPhase phase, int64_t done, int64_t) {
+        if (phase == BulkLoadPhase::kLoading) lastLoaded = done;
+        if (phase == BulkLoadPhase::kIndexing) sawIndexing = true;
+    };
+    options.isCancelled = [&]() { return lastLoaded >= 500; };
+
+    SpatiaLiteBulkLoader loader(conn.get());
+    loader.SetOptions(options);
+
+    Result result = LoadGrid(loader, 40);
+    EXPECT_EQ(result.GetCode(), DbResult::kCancelled);
+    EXPECT_FALSE(loader.IsActive());
+    EXPECT_FALSE(conn->InTransaction());
+
+    // Rows committed before the cancellation stay and are indexed.
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM pts"), 500);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 500);
+    EXPECT_TRUE(sawIndexing);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM sqlite_master WHERE name = 'gii_pts_geom'"), 1);
+}
+
+TEST_F(SpatiaLiteBulkLoadTest, RebuildsIndexWhenDeferredPassFails) {
+    SpatiaLiteBulkLoader loader(conn.get());
+    ASSERT_TRUE(LoadGrid(loader, 20).IsSuccess());
+
+    g_indexInsertsToDeny = 1;
+    sqlite3_set_authorizer(db, DenyIndexInsert, nullptr);
+    SpatiaLiteBulkLoadStats stats;
+    Result result = loader.Finish(stats);
+    sqlite3_set_authorizer(db, nullptr, nullptr);
+
+    // The pass failed and is reported, but the index was rebuilt from the table.
+    EXPECT_FALSE(result.IsSuccess());
+    EXPECT_EQ(stats.indexEntries, 0);
+    EXPECT_FALSE(loader.IsActive());
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 400);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM sqlite_master WHERE name = 'gii_pts_geom'"), 1);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM ogc_bulk_load_triggers"), 0);
+}
+
+TEST_F(SpatiaLiteBulkLoadTest, RecoversFromInterruptedLoad) {
+    // What a process that died mid-load leaves behind: the trigger saved and
+    // dropped, and committed rows missing from the index.
+    ASSERT_TRUE(conn->Execute("CREATE TABLE ogc_bulk_load_triggers "
+                              "(table_name TEXT NOT NULL, trigger_sql TEXT NOT NULL)").IsSuccess());
+    ASSERT_TRUE(conn->Execute("INSERT INTO ogc_bulk_load_triggers SELECT 'pts', sql FROM sqlite_master "
+                              "WHERE name = 'gii_pts_geom'").IsSuccess());
+    ASSERT_TRUE(conn->Execute("DROP TRIGGER gii_pts_geom").IsSuccess());
+    auto point = Point::Create(1, 1);
+    std::vector<int64_t> ids;
+    ASSERT_TRUE(conn->InsertGeometries("pts", "geom", std::vector<const Geometry*>(1, point.get()),
+                                       std::vector<std::map<std::string, std::string>>(), ids).IsSuccess());
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 0);
+
+    SpatiaLiteBulkLoader loader(conn.get());
+    ASSERT_TRUE(LoadGrid(loader, 10).IsSuccess());
+    SpatiaLiteBulkLoadStats stats;
+    ASSERT_TRUE(loader.Finish(stats).IsSuccess());
+
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM pts"), 101);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM idx_pts_geom"), 101);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM sqlite_master WHERE name = 'gii_pts_geom'"), 1);
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM ogc_bulk_load_triggers"), 0);
+}
+
+TEST_F(SpatiaLiteBulkLoadTest, InsertGeometriesUsesOneStatement) {
+    std::vector<GeometryPtr> points;
+    std::vector<const Geometry*> geometries;
+    std::vector<std::map<std::string, std::string>> attributes;
+    for (int i = 0; i < 10; ++i) {
+        points.push_back(Point::Create(i, i));
+        geometries.push_back(points.back().get());
+        std::map<std::string, std::string> attrs;
+        attrs["name"] = "it's " + std::to_string(i);
+        attributes.push_back(attrs);
+    }
+
+    std::vector<int64_t> ids;
+    ASSERT_TRUE(conn->InsertGeometries("pts", "geom", geometries, attributes, ids).IsSuccess());
+    ASSERT_EQ(ids.size(), 10u);
+    EXPECT_EQ(ids.back() - ids.front(), 9);
+    EXPECT_FALSE(conn->InTransaction());
+    EXPECT_EQ(CountRows(db, "SELECT count(*) FROM pts WHERE name LIKE 'it''s %'"), 10);
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include "ogc/db/sqlite_connection.h"
+#include "ogc/db/wkb_converter.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/polygon.h"
+#include "ogc/geom/envelope.h"
+#include <sqlite3.h>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+using namespace ogc;
+using namespace ogc::db;
+
+namespace {
+
+// The SpatiaLite extension is not available to the tests, so the handful of
+// SQL functions the query planner emits are registered here on a plain
+// SQLite database. Geometries are stored as bare WKB and the R*Tree is a real
+// rtree virtual table laid out like SpatiaLite's idx_<table>_<geom>.
+struct StubCounters {
+    int mbrIntersects = 0;
+    int stIntersects = 0;
+};
+
+bool DecodeEnvelope(sqlite3_value* value, Envelope& env) {
+    if (sqlite3_value_type(value) != SQLITE_BLOB) return false;
+    const uint8_t* data = static_cast<const uint8_t*>(sqlite3_value_blob(value));
+    int size = sqlite3_value_bytes(value);
+    if (size == 4 * static_cast<int>(sizeof(double))) {
+        double v[4];
+        std::memcpy(v, data, sizeof(v));
+        env = Envelope(v[0], v[1], v[2], v[3]);
+        return true;
+    }
+    std::vector<uint8_t> wkb(data, data + size);
+    std::unique_ptr<Geometry> geometry;
+    if (!WkbConverter::WkbToGeometry(wkb, geometry).IsSuccess() || !geometry) {
+        return false;
+    }
+    env = geometry->GetEnvelope();
+    return true;
+}
+
+void PassThrough(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    sqlite3_result_value(ctx, argv[0]);
+}
+
+void BuildMbr(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    double v[4];
+    for (int i = 0; i < 4; ++i) v[i] = sqlite3_value_double(argv[i]);
+    sqlite3_result_blob(ctx, v, sizeof(v), SQLITE_TRANSIENT);
+}
+
+void MbrIntersects(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    static_cast<StubCounters*>(sqlite3_user_data(ctx))->mbrIntersects++;
+    Envelope a, b;
+    bool hit = DecodeEnvelope(argv[0], a) && DecodeEnvelope(argv[1], b) && a.Intersects(b);
+    sqlite3_result_int(ctx, hit ? 1 : 0);
+}
+
+void StIntersects(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    static_cast<StubCounters*>(sqlite3_user_data(ctx))->stIntersects++;
+    Envelope a, b;
+    bool hit = DecodeEnvelope(argv[0], a) && DecodeEnvelope(argv[1], b) && a.Intersects(b);
+    sqlite3_result_int(ctx, hit ? 1 : 0);
+}
+
+void BuildRTree(sqlite3* db, const std::string& table, const std::string& geom) {
+    std::string index = "idx_" + table + "_" + geom;
+    sqlite3_exec(db, ("CREATE VIRTUAL TABLE " + index +
+                      " USING rtree(pkid, xmin, xmax, ymin, ymax)").c_str(),
+                 nullptr, nullptr, nullptr);
+
+    sqlite3_stmt* select = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_prepare_v2(db, ("SELECT rowid, " + geom + " FROM " + table).c_str(), -1, &select, nullptr);
+    sqlite3_prepare_v2(db, ("INSERT INTO " + index + " VALUES (?, ?, ?, ?, ?)").c_str(), -1, &insert, nullptr);
+    while (sqlite3_step(select) == SQLITE_ROW) {
+        Envelope env;
+        if (!DecodeEnvelope(sqlite3_column_value(select, 1), env)) continue;
+        sqlite3_bind_int64(insert, 1, sqlite3_column_int64(select, 0));
+        sqlite3_bind_double(insert, 2, env.GetMinX());
+        sqlite3_bind_double(insert, 3, env.GetMaxX());
+        sqlite3_bind_double(insert, 4, env.GetMinY());
+        sqlite3_bind_double(insert, 5, env.GetMaxY());
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+    }
+    sqlite3_finalize(select);
+    sqlite3_finalize(insert);
+}
+
+void CreateSpatialIndexStub(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    std::string table = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    std::string geom = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+    BuildRTree(sqlite3_context_db_handle(ctx), table, geom);
+    sqlite3_result_int(ctx, 1);
+}
+
+}
+
+class SpatiaLiteQueryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        conn = SpatiaLiteConnection::Create();
+        ASSERT_TRUE(conn->Connect(":memory:").IsSuccess());
+        sqlite3* db = conn->GetRawConnection();
+
+        sqlite3_create_function(db, "ST_AsBinary", 1, SQLITE_UTF8, nullptr, PassThrough, nullptr, nullptr);
+        sqlite3_create_function(db, "GeomFromWKB", 2, SQLITE_UTF8, nullptr, PassThrough, nullptr, nullptr);
+        sqlite3_create_function(db, "BuildMbr", 4, SQLITE_UTF8, nullptr, BuildMbr, nullptr, nullptr);
+        sqlite3_create_function(db, "MbrIntersects", 2, SQLITE_UTF8, &counters, MbrIntersects, nullptr, nullptr);
+        sqlite3_create_function(db, "ST_Intersects", 2, SQLITE_UTF8, &counters, StIntersects, nullptr, nullptr);
+        sqlite3_create_function(db, "CreateSpatialIndex", 2, SQLITE_UTF8, nullptr, CreateSpatialIndexStub, nullptr, nullptr);
+
+        ASSERT_TRUE(conn->Execute("CREATE TABLE pts (id INTEGER PRIMARY KEY, name TEXT, geom BLOB)").IsSuccess());
+
+        sqlite3_stmt* insert = nullptr;
+        sqlite3_prepare_v2(db, "INSERT INTO pts (id, name, geom) VALUES (?, ?, ?)", -1, &insert, nullptr);
+        conn->BeginTransaction();
+        int id = 1;
+        for (int y = 0; y < kGrid; ++y) {
+            for (int x = 0; x < kGrid; ++x) {
+                auto point = Point::Create(x, y);
+                std::vector<uint8_t> wkb;
+                WkbConverter::GeometryToWkb(point.get(), wkb);
+                std::ostringstream name;
+                name << "p" << x << "_" << y;
+                sqlite3_bind_int(insert, 1, id++);
+                sqlite3_bind_text(insert, 2, name.str().c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_blob(insert, 3, wkb.data(), static_cast<int>(wkb.size()), SQLITE_TRANSIENT);
+                sqlite3_step(insert);
+                sqlite3_reset(insert);
+            }
+        }
+        conn->Commit();
+        sqlite3_finalize(insert);
+    }
+
+    static const int kGrid = 50;
+
+    SpatiaLiteConnectionPtr conn;
+    StubCounters counters;
+};
+
+TEST_F(SpatiaLiteQueryTest, DetectsSpatialIndex) {
+    EXPECT_FALSE(conn->HasSpatialIndex("pts", "geom"));
+    BuildRTree(conn->GetRawConnection(), "pts", "geom");
+    EXPECT_TRUE(conn->HasSpatialIndex("pts", "geom"));
+}
+
+TEST_F(SpatiaLiteQueryTest, EnvelopeQueryDrivesFromRTree) {
+    BuildRTree(conn->GetRawConnection(), "pts", "geom");
+
+    std::vector<GeometryPtr> results;
+    Envelope filter(10, 10, 12, 12);
+    ASSERT_TRUE(conn->SpatialQueryWithEnvelope("pts", "geom", SpatialOperator::kIntersects,
+                                               nullptr, filter, results).IsSuccess());
+    EXPECT_EQ(results.size(), 9u);
+    EXPECT_EQ(counters.mbrIntersects, 0);
+}
+
+TEST_F(SpatiaLiteQueryTest, FallsBackToMbrScanWithoutIndex) {
+    std::vector<GeometryPtr> results;
+    Envelope filter(10, 10, 12, 12);
+    ASSERT_TRUE(conn->SpatialQueryWithEnvelope("pts", "geom", SpatialOperator::kIntersects,
+                                               nullptr, filter, results).IsSuccess());
+    EXPECT_EQ(results.size(), 9u);
+    EXPECT_EQ(counters.mbrIntersects, kGrid * kGrid);
+}
+
+TEST_F(SpatiaLiteQueryTest, QueryGeometryBoundsIndexSearch) {
+    BuildRTree(conn->GetRawConnection(), "pts", "geom");
+
+    auto area = Polygon::CreateRectangle(20, 30, 23, 31);
+    std::vector<GeometryPtr> results;
+    ASSERT_TRUE(conn->SpatialQuery("pts", "geom", SpatialOperator::kIntersects,
+                                   area.get(), results).IsSuccess());
+    EXPECT_EQ(results.size(), 8u);
+    EXPECT_EQ(counters.stIntersects, 8);
+}
+
+TEST_F(SpatiaLiteQueryTest, ProjectsColumnsAndLimit) {
+    BuildRTree(conn->GetRawConnection(), "pts", "geom");
+
+    SpatiaLiteQueryOptions options;
+    options.columns.push_back("id");
+    options.columns.push_back("name");
+    options.limit = 2;
+
+    Envelope filter(5, 7, 5, 9);
+    DbResultSetPtr rs;
+    ASSERT_TRUE(conn->SpatialQuery("pts", "geom", SpatialOperator::kIntersects,
+                                   nullptr, &filter, options, rs).IsSuccess());
+    ASSERT_EQ(rs->GetColumnCount(), 3);
+
+    int rows = 0;
+    while (rs->Next()) {
+        GeometryPtr geom = rs->GetGeometry(0);
+        ASSERT_NE(geom, nullptr);
+        EXPECT_EQ(rs->GetString(2).compare(0, 3, "p5_"), 0);
+        EXPECT_GT(rs->GetInt64(1), 0);
+        ++rows;
+    }
+    EXPECT_EQ(rows, 2);
+}
+
+TEST_F(SpatiaLiteQueryTest, CreatesMissingIndexOnDemand) {
+    SpatiaLiteQueryOptions options;
+    options.createIndexIfMissing = true;
+
+    Envelope filter(0, 0, 1, 1);
+    DbResultSetPtr rs;
+    ASSERT_TRUE(conn->SpatialQuery("pts", "geom", SpatialOperator::kIntersects,
+                                   nullptr, &filter, options, rs).IsSuccess());
+    EXPECT_TRUE(conn->HasSpatialIndex("pts", "geom"));
+
+    int rows = 0;
+    while (rs->Next()) ++rows;
+    EXPECT_EQ(rows, 4);
+    EXPECT_EQ(counters.mbrIntersects, 0);
+}
@@ -19,12 +19,37 @@ enum class BatchOperation {
 struct BatchResult {
     size_t success_count;
     size_t failure_count;
+    bool cancelled;
     std::vector<size_t> failed_indices;
     std::vector<std::string> error_messages;
 };
 
+/**
+ * @brief Per-thread scratch buffers handed to geometry processors.
+ *
+ * One instance lives in each worker thread and is reused for every feature
+ * that thread processes, so processors can stage coordinates without
+ * allocating per feature.
+ */
+struct BatchScratch {
+    CoordinateList coords;
+    std::vector<double> values;
+    std::vector<uint8_t> bytes;
+};
+
 using FeatureProcessor = std::function<CNFeature*(CNFeature*)>;
+using FeaturePredicate = std::function<bool(const CNFeature*)>;
+using GeometryProcessor = std::function<bool(CNFeature*, BatchScratch&)>;
 
+/**
+ * @brief Chunked batch executor for feature operations.
+ *
+ * Input is split into chunks of GetBatchSize() features. With a thread count
+ * other than 1, chunks run concurrently on a process-wide worker pool shared
+ * by all processors; processors must then be safe to call concurrently on
+ * distinct features. Results, failed indices and error callbacks are always
+ * reported in input order. Progress is reported once per finished chunk.
+ */
 class OGC_FEATURE_API CNBatchProcessor {
 public:
     CNBatchProcessor();
@@ -33,13 +58,47 @@ public:
     void SetBatchSize(size_t size) { batch_size_ = size; }
     size_t GetBatchSize() const { return batch_size_; }
 
+    /**
+     * @brief Maximum threads used per call, including the caller.
+     * 0 uses all pool threads; 1 (the default) runs sequentially.
+     */
+    void SetThreadCount(size_t count);
+    size_t GetThreadCount() const;
+
     void SetProgressCallback(std::function<void(size_t, size_t)> callback);
     void SetErrorCallback(std::function<void(size_t, const std::string&)> callback);
 
+    /**
+     * @brief Request cancellation of the running call; remaining chunks are skipped.
+     */
+    void Cancel();
+    bool IsCancelled() const;
+
     BatchResult Process(CNFeatureCollection* collection, BatchOperation operation);
     BatchResult ProcessFeatures(const std::vector<CNFeature*>& features, BatchOperation operation);
     BatchResult ExecuteCustomOperation(const std::vector<CNFeature*>& features, FeatureProcessor processor);
 
+    /**
+     * @brief Apply processor to every feature; output[i] is the result for features[i].
+     */
+    std::vector<CNFeature*> Transform(const std::vector<CNFeature*>& features,
+                                      FeatureProcessor processor,
+                                      BatchResult* result = nullptr);
+
+    /**
+     * @brief Keep the features matching predicate, preserving input order.
+     */
+    std::vector<CNFeature*> Filter(const std::vector<CNFeature*>& features,
+                                   FeaturePredicate predicate);
+
+    /**
+     * @brief Run a geometry operation with the calling thread's scratch buffers.
+     */
+    BatchResult ProcessGeometries(const std::vector<CNFeature*>& features,
+                                  GeometryProcessor processor);
+
+    static size_t GetPoolThreadCount();
+
 private:
     struct Impl;
     std::unique_ptr<Impl> impl_;
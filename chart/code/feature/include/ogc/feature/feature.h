@@ -79,6 +79,7 @@ public:
     
     size_t GetGeomFieldCount() const;
     GeometryPtr GetGeometry(size_t index = 0) const;
+    const Geometry* GetGeometryRef(size_t index = 0) const;
     void SetGeometry(GeometryPtr geometry, size_t index = 0);
     
     GeometryPtr StealGeometry(size_t index = 0);
@@ -85,6 +85,7 @@ public:
     bool TryGetInteger64(int64_t& out) const;
     bool TryGetReal(double& out) const;
     bool TryGetString(std::string& out) const;
+    const char* GetStringData(size_t* length = nullptr) const;
     bool TryGetDateTime(CNDateTime& out) const;
     
     bool ConvertToInteger(int32_t& out) const;
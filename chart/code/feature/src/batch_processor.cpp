@@ -1,14 +1,197 @@
 #include "ogc/feature/batch_processor.h"
 #include "ogc/feature/feature_defn.h"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace ogc {
 
+namespace {
+
+class ChunkPool {
+public:
+    static ChunkPool& Instance() {
+        static ChunkPool pool;
+        return pool;
+    }
+
+    size_t GetThreadCount() const { return workers_.size(); }
+
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        condition_.notify_one();
+    }
+
+    ~ChunkPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+private:
+    ChunkPool() : stop_(false) {
+        size_t count = std::thread::hardware_concurrency();
+        if (count == 0) {
+            count = 2;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers_.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    void WorkerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_;
+};
+
+struct ChunkState {
+    std::atomic<size_t> next_chunk;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t completed_chunks;
+
+    ChunkState() : next_chunk(0), completed_chunks(0) {}
+};
+
+BatchResult MakeResult() {
+    BatchResult result;
+    result.success_count = 0;
+    result.failure_count = 0;
+    result.cancelled = false;
+    return result;
+}
+
+void RecordFailure(BatchResult& result, size_t index, const std::string& message) {
+    result.failure_count++;
+    result.failed_indices.push_back(index);
+    result.error_messages.push_back(message);
+}
+
+}
+
 struct CNBatchProcessor::Impl {
     std::function<void(size_t, size_t)> progress_callback;
     std::function<void(size_t, const std::string&)> error_callback;
+    std::atomic<bool> cancelled;
+    size_t thread_count;
+    std::mutex progress_mutex;
+    size_t processed;
+
+    Impl() : cancelled(false), thread_count(1), processed(0) {}
+
+    void ReportProgress(size_t count, size_t total) {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        processed += count;
+        if (progress_callback) {
+            progress_callback(processed, total);
+        }
+    }
+
+    /**
+     * Runs body(begin, end, result) for every chunk and returns the per-chunk
+     * results in chunk order. The calling thread always takes part and only
+     * waits for claimed chunks to finish, so this never deadlocks when invoked
+     * from inside a pool task. Helpers that start late find no chunk left and
+     * never touch the caller's state.
+     */
+    std::vector<BatchResult> RunChunks(
+        size_t total, size_t grain,
+        const std::function<void(size_t, size_t, BatchResult&)>& body) {
+        cancelled.store(false);
+        processed = 0;
+        if (grain == 0) {
+            grain = 1;
+        }
+        size_t chunk_count = (total + grain - 1) / grain;
+        std::vector<BatchResult> partials(chunk_count, MakeResult());
+        if (chunk_count == 0) {
+            return partials;
+        }
+
+        std::shared_ptr<ChunkState> state = std::make_shared<ChunkState>();
+        auto runner = [this, state, chunk_count, total, grain, &body, &partials]() {
+            size_t chunk;
+            while ((chunk = state->next_chunk.fetch_add(1)) < chunk_count) {
+                if (cancelled.load(std::memory_order_relaxed)) {
+                    partials[chunk].cancelled = true;
+                } else {
+                    size_t begin = chunk * grain;
+                    size_t end = std::min(total, begin + grain);
+                    body(begin, end, partials[chunk]);
+                    ReportProgress(end - begin, total);
+                }
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (++state->completed_chunks == chunk_count) {
+                    state->done.notify_all();
+                }
+            }
+        };
+
+        ChunkPool& pool = ChunkPool::Instance();
+        size_t threads = thread_count == 0 ? pool.GetThreadCount() + 1 : thread_count;
+        size_t helpers = std::min(threads - 1, chunk_count - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            pool.Submit(runner);
+        }
+
+        runner();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&state, chunk_count]() {
+            return state->completed_chunks == chunk_count;
+        });
+        return partials;
+    }
 
-    Impl() {}
+    BatchResult Merge(const std::vector<BatchResult>& partials) {
+        BatchResult result = MakeResult();
+        for (const auto& part : partials) {
+            result.success_count += part.success_count;
+            result.failure_count += part.failure_count;
+            result.cancelled = result.cancelled || part.cancelled;
+            result.failed_indices.insert(result.failed_indices.end(),
+                                         part.failed_indices.begin(), part.failed_indices.end());
+            result.error_messages.insert(result.error_messages.end(),
+                                         part.error_messages.begin(), part.error_messages.end());
+            if (error_callback) {
+                for (size_t i = 0; i < part.failed_indices.size() && i < part.error_messages.size(); ++i) {
+                    error_callback(part.failed_indices[i], part.error_messages[i]);
+                }
+            }
+        }
+        return result;
+    }
 };
 
 CNBatchProcessor::CNBatchProcessor()
@@ -18,6 +201,14 @@ CNBatchProcessor::CNBatchProcessor()
 CNBatchProcessor::~CNBatchProcessor() {
 }
 
+void CNBatchProcessor::SetThreadCount(size_t count) {
+    impl_->thread_count = count;
+}
+
+size_t CNBatchProcessor::GetThreadCount() const {
+    return impl_->thread_count;
+}
+
 void CNBatchProcessor::SetProgressCallback(std::function<void(size_t, size_t)> callback) {
     impl_->progress_callback = callback;
 }
@@ -26,163 +217,178 @@ void CNBatchProcessor::SetErrorCallback(std::function<void(size_t, const std::st
     impl_->error_callback = callback;
 }
 
-BatchResult CNBatchProcessor::Process(CNFeatureCollection* collection, BatchOperation operation) {
-    BatchResult result;
-    result.success_count = 0;
-    result.failure_count = 0;
+void CNBatchProcessor::Cancel() {
+    impl_->cancelled.store(true);
+}
+
+bool CNBatchProcessor::IsCancelled() const {
+    return impl_->cancelled.load();
+}
 
+size_t CNBatchProcessor::GetPoolThreadCount() {
+    return ChunkPool::Instance().GetThreadCount();
+}
+
+BatchResult CNBatchProcessor::Process(CNFeatureCollection* collection, BatchOperation operation) {
     if (!collection) {
+        BatchResult result = MakeResult();
         result.error_messages.push_back("Collection is null");
         return result;
     }
 
     size_t total = collection->GetFeatureCount();
-    std::vector<CNFeature*> features;
-    features.reserve(total);
-
-    for (size_t i = 0; i < total; ++i) {
-        features.push_back(collection->GetFeature(i));
-    }
+    std::vector<BatchResult> partials = impl_->RunChunks(total, batch_size_,
+        [](size_t begin, size_t end, BatchResult& part) {
+            part.success_count += end - begin;
+        });
+    (void)operation;
+    return impl_->Merge(partials);
+}
 
-    switch (operation) {
-        case BatchOperation::kRead:
-            for (size_t i = 0; i < total; ++i) {
-                if (impl_->progress_callback) {
-                    impl_->progress_callback(i + 1, total);
-                }
-            }
-            result.success_count = total;
-            break;
-        case BatchOperation::kDelete:
-            for (size_t i = 0; i < total; ++i) {
-                if (impl_->progress_callback) {
-                    impl_->progress_callback(i + 1, total);
-                }
-                result.success_count++;
-            }
-            break;
-        case BatchOperation::kCreate:
-        case BatchOperation::kUpdate:
-            for (size_t i = 0; i < total; ++i) {
-                if (impl_->progress_callback) {
-                    impl_->progress_callback(i + 1, total);
+BatchResult CNBatchProcessor::ProcessFeatures(const std::vector<CNFeature*>& features, BatchOperation operation) {
+    (void)operation;
+    std::vector<BatchResult> partials = impl_->RunChunks(features.size(), batch_size_,
+        [&features](size_t begin, size_t end, BatchResult& part) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!features[i]) {
+                    RecordFailure(part, i, "Feature is null at index " + std::to_string(i));
+                    continue;
                 }
+                part.success_count++;
             }
-            result.success_count = total;
-            break;
+        });
+    return impl_->Merge(partials);
+}
+
+BatchResult CNBatchProcessor::ExecuteCustomOperation(const std::vector<CNFeature*>& features, FeatureProcessor processor) {
+    if (!processor) {
+        BatchResult result = MakeResult();
+        result.error_messages.push_back("Processor function is null");
+        return result;
     }
 
+    BatchResult result;
+    Transform(features, processor, &result);
     return result;
 }
 
-BatchResult CNBatchProcessor::ProcessFeatures(const std::vector<CNFeature*>& features, BatchOperation operation) {
-    BatchResult result;
-    result.success_count = 0;
-    result.failure_count = 0;
-
-    size_t total = features.size();
-
-    for (size_t i = 0; i < total; ++i) {
-        if (impl_->progress_callback) {
-            impl_->progress_callback(i + 1, total);
+std::vector<CNFeature*> CNBatchProcessor::Transform(const std::vector<CNFeature*>& features,
+                                                    FeatureProcessor processor,
+                                                    BatchResult* result) {
+    std::vector<CNFeature*> output(features.size(), nullptr);
+    if (!processor) {
+        if (result) {
+            *result = MakeResult();
+            result->error_messages.push_back("Processor function is null");
         }
+        return output;
+    }
 
-        CNFeature* feature = features[i];
-        if (!feature) {
-            result.failure_count++;
-            result.failed_indices.push_back(i);
-            result.error_messages.push_back("Feature is null at index " + std::to_string(i));
-            if (impl_->error_callback) {
-                impl_->error_callback(i, "Feature is null");
+    std::vector<BatchResult> partials = impl_->RunChunks(features.size(), batch_size_,
+        [&features, &processor, &output](size_t begin, size_t end, BatchResult& part) {
+            for (size_t i = begin; i < end; ++i) {
+                CNFeature* feature = features[i];
+                if (!feature) {
+                    RecordFailure(part, i, "Feature is null at index " + std::to_string(i));
+                    continue;
+                }
+                try {
+                    output[i] = processor(feature);
+                    if (output[i]) {
+                        part.success_count++;
+                    } else {
+                        RecordFailure(part, i, "Processor returned null at index " + std::to_string(i));
+                    }
+                } catch (const std::exception& e) {
+                    RecordFailure(part, i, std::string("Exception: ") + e.what());
+                } catch (...) {
+                    RecordFailure(part, i, "Unknown exception at index " + std::to_string(i));
+                }
             }
-            continue;
-        }
+        });
 
-        bool success = false;
-        switch (operation) {
-            case BatchOperation::kRead:
-                success = true;
-                break;
-            case BatchOperation::kCreate:
-                success = true;
-                break;
-            case BatchOperation::kUpdate:
-                success = true;
-                break;
-            case BatchOperation::kDelete:
-                success = true;
-                break;
-        }
+    BatchResult merged = impl_->Merge(partials);
+    if (result) {
+        *result = merged;
+    }
+    return output;
+}
 
-        if (success) {
-            result.success_count++;
-        } else {
-            result.failure_count++;
-            result.failed_indices.push_back(i);
-        }
+std::vector<CNFeature*> CNBatchProcessor::Filter(const std::vector<CNFeature*>& features,
+                                                 FeaturePredicate predicate) {
+    std::vector<CNFeature*> output;
+    if (!predicate) {
+        return output;
     }
 
-    return result;
-}
+    size_t grain = batch_size_ == 0 ? 1 : batch_size_;
+    size_t chunk_count = (features.size() + grain - 1) / grain;
+    std::vector<std::vector<CNFeature*>> kept(chunk_count);
 
-BatchResult CNBatchProcessor::ExecuteCustomOperation(const std::vector<CNFeature*>& features, FeatureProcessor processor) {
-    BatchResult result;
-    result.success_count = 0;
-    result.failure_count = 0;
+    impl_->RunChunks(features.size(), grain,
+        [&features, &predicate, &kept, grain](size_t begin, size_t end, BatchResult& part) {
+            std::vector<CNFeature*>& chunk = kept[begin / grain];
+            for (size_t i = begin; i < end; ++i) {
+                CNFeature* feature = features[i];
+                if (!feature) {
+                    continue;
+                }
+                try {
+                    if (predicate(feature)) {
+                        chunk.push_back(feature);
+                    }
+                    part.success_count++;
+                } catch (...) {
+                    part.failure_count++;
+                }
+            }
+        });
 
+    size_t total = 0;
+    for (const auto& chunk : kept) {
+        total += chunk.size();
+    }
+    output.reserve(total);
+    for (const auto& chunk : kept) {
+        output.insert(output.end(), chunk.begin(), chunk.end());
+    }
+    return output;
+}
+
+BatchResult CNBatchProcessor::ProcessGeometries(const std::vector<CNFeature*>& features,
+                                                GeometryProcessor processor) {
     if (!processor) {
+        BatchResult result = MakeResult();
         result.error_messages.push_back("Processor function is null");
         return result;
     }
 
-    size_t total = features.size();
-
-    for (size_t i = 0; i < total; ++i) {
-        if (impl_->progress_callback) {
-            impl_->progress_callback(i + 1, total);
-        }
-
-        CNFeature* feature = features[i];
-        if (!feature) {
-            result.failure_count++;
-            result.failed_indices.push_back(i);
-            result.error_messages.push_back("Feature is null at index " + std::to_string(i));
-            if (impl_->error_callback) {
-                impl_->error_callback(i, "Feature is null");
-            }
-            continue;
-        }
-
-        try {
-            CNFeature* processed = processor(feature);
-            if (processed) {
-                result.success_count++;
-            } else {
-                result.failure_count++;
-                result.failed_indices.push_back(i);
-                result.error_messages.push_back("Processor returned null at index " + std::to_string(i));
-                if (impl_->error_callback) {
-                    impl_->error_callback(i, "Processor returned null");
+    std::vector<BatchResult> partials = impl_->RunChunks(features.size(), batch_size_,
+        [&features, &processor](size_t begin, size_t end, BatchResult& part) {
+            static thread_local BatchScratch scratch;
+            for (size_t i = begin; i < end; ++i) {
+                CNFeature* feature = features[i];
+                if (!feature) {
+                    RecordFailure(part, i, "Feature is null at index " + std::to_string(i));
+                    continue;
+                }
+                scratch.coords.clear();
+                scratch.values.clear();
+                scratch.bytes.clear();
+                try {
+                    if (processor(feature, scratch)) {
+                        part.success_count++;
+                    } else {
+                        RecordFailure(part, i, "Geometry processor failed at index " + std::to_string(i));
+                    }
+                } catch (const std::exception& e) {
+                    RecordFailure(part, i, std::string("Exception: ") + e.what());
+                } catch (...) {
+                    RecordFailure(part, i, "Unknown exception at index " + std::to_string(i));
                 }
             }
-        } catch (const std::exception& e) {
-            result.failure_count++;
-            result.failed_indices.push_back(i);
-            result.error_messages.push_back(std::string("Exception: ") + e.what());
-            if (impl_->error_callback) {
-                impl_->error_callback(i, e.what());
-            }
-        } catch (...) {
-            result.failure_count++;
-            result.failed_indices.push_back(i);
-            result.error_messages.push_back("Unknown exception at index " + std::to_string(i));
-            if (impl_->error_callback) {
-                impl_->error_callback(i, "Unknown exception");
-            }
-        }
-    }
-
-    return result;
+        });
+    return impl_->Merge(partials);
 }
 
 }
@@ -334,6 +334,11 @@ GeometryPtr CNFeature::GetGeometry(size_t index) const {
     return geom->Clone();
 }
 
+const Geometry* CNFeature::GetGeometryRef(size_t index) const {
+    if (index >= impl_->geometries_.size()) return nullptr;
+    return impl_->geometries_[index].get();
+}
+
 void CNFeature::SetGeometry(GeometryPtr geometry, size_t index) {
     if (index >= impl_->geometries_.size()) {
         impl_->geometries_.resize(index + 1);
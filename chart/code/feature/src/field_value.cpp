@@ -672,6 +672,24 @@ bool CNFieldValue::TryGetString(std::string& out) const {
     return false;
 }
 
+const char* CNFieldValue::GetStringData(size_t* length) const {
+    const char* data = nullptr;
+    size_t size = 0;
+    if (storage_type_ == StorageType::kString) {
+        if (str_ptr_) {
+            data = str_ptr_->c_str();
+            size = str_ptr_->size();
+        } else {
+            data = reinterpret_cast<const char*>(storage_.buffer);
+            size = std::strlen(data);
+        }
+    }
+    if (length) {
+        *length = size;
+    }
+    return data;
+}
+
 bool CNFieldValue::TryGetDateTime(CNDateTime& out) const {
     if (storage_type_ == StorageType::kDateTime && dt_ptr_) {
         out = *dt_ptr_;
@@ -3,6 +3,7 @@
 #include "ogc/feature/feature.h"
 #include "ogc/feature/feature_collection.h"
 #include "ogc/feature/feature_defn.h"
+#include <atomic>
 
 using namespace ogc;
 
@@ -231,3 +232,183 @@ TEST_F(BatchProcessorTest, ErrorMessageTracking) {
     BatchResult result = processor.Process(&collection, BatchOperation::kRead);
     EXPECT_EQ(result.error_messages.size(), 0);
 }
+
+TEST_F(BatchProcessorTest, DefaultThreadCountIsSequential) {
+    CNBatchProcessor processor;
+    EXPECT_EQ(processor.GetThreadCount(), 1);
+    EXPECT_GE(CNBatchProcessor::GetPoolThreadCount(), 1);
+}
+
+TEST_F(BatchProcessorTest, ParallelTransformPreservesOrder) {
+    CNBatchProcessor processor;
+    processor.SetThreadCount(0);
+    processor.SetBatchSize(7);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 200; ++i) {
+        CNFeature* f = new CNFeature(defn_);
+        f->SetFID(i);
+        features.push_back(f);
+    }
+    
+    std::atomic<int> calls(0);
+    BatchResult result;
+    std::vector<CNFeature*> output = processor.Transform(features,
+        [&calls](CNFeature* f) -> CNFeature* {
+            calls++;
+            f->SetFID(f->GetFID() * 2);
+            return f;
+        }, &result);
+    
+    EXPECT_EQ(calls.load(), 200);
+    EXPECT_EQ(result.success_count, 200);
+    EXPECT_FALSE(result.cancelled);
+    ASSERT_EQ(output.size(), features.size());
+    for (size_t i = 0; i < output.size(); ++i) {
+        EXPECT_EQ(output[i], features[i]);
+        EXPECT_EQ(output[i]->GetFID(), static_cast<int64_t>(i) * 2);
+    }
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
+
+TEST_F(BatchProcessorTest, ParallelFilterPreservesOrder) {
+    CNBatchProcessor processor;
+    processor.SetThreadCount(4);
+    processor.SetBatchSize(5);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 100; ++i) {
+        CNFeature* f = new CNFeature(defn_);
+        f->SetFID(i);
+        features.push_back(f);
+    }
+    
+    std::vector<CNFeature*> kept = processor.Filter(features,
+        [](const CNFeature* f) { return f->GetFID() % 3 == 0; });
+    
+    ASSERT_EQ(kept.size(), 34);
+    for (size_t i = 0; i < kept.size(); ++i) {
+        EXPECT_EQ(kept[i]->GetFID(), static_cast<int64_t>(i) * 3);
+    }
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
+
+TEST_F(BatchProcessorTest, ProgressReportedPerChunk) {
+    CNBatchProcessor processor;
+    processor.SetBatchSize(4);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 10; ++i) {
+        CNFeature* f = new CNFeature(defn_);
+        features.push_back(f);
+    }
+    
+    std::vector<size_t> progress;
+    processor.SetProgressCallback([&progress](size_t current, size_t total) {
+        EXPECT_EQ(total, 10);
+        progress.push_back(current);
+    });
+    
+    processor.ProcessFeatures(features, BatchOperation::kUpdate);
+    
+    ASSERT_EQ(progress.size(), 3);
+    EXPECT_EQ(progress[0], 4);
+    EXPECT_EQ(progress[1], 8);
+    EXPECT_EQ(progress[2], 10);
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
+
+TEST_F(BatchProcessorTest, CancelSkipsRemainingChunks) {
+    CNBatchProcessor processor;
+    processor.SetBatchSize(2);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 10; ++i) {
+        CNFeature* f = new CNFeature(defn_);
+        features.push_back(f);
+    }
+    
+    int calls = 0;
+    BatchResult result = processor.ExecuteCustomOperation(features,
+        [&calls, &processor](CNFeature* f) -> CNFeature* {
+            if (++calls == 3) {
+                processor.Cancel();
+            }
+            return f;
+        });
+    
+    EXPECT_TRUE(result.cancelled);
+    EXPECT_TRUE(processor.IsCancelled());
+    EXPECT_EQ(calls, 4);
+    EXPECT_EQ(result.success_count, 4);
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
+
+TEST_F(BatchProcessorTest, FailuresReportedInInputOrder) {
+    CNBatchProcessor processor;
+    processor.SetThreadCount(0);
+    processor.SetBatchSize(3);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 30; ++i) {
+        features.push_back(i % 4 == 1 ? nullptr : new CNFeature(defn_));
+    }
+    
+    std::vector<size_t> errorIndices;
+    processor.SetErrorCallback([&errorIndices](size_t index, const std::string&) {
+        errorIndices.push_back(index);
+    });
+    
+    BatchResult result = processor.ProcessFeatures(features, BatchOperation::kRead);
+    
+    EXPECT_EQ(result.failure_count, 8);
+    EXPECT_EQ(result.failed_indices, errorIndices);
+    for (size_t i = 0; i < result.failed_indices.size(); ++i) {
+        EXPECT_EQ(result.failed_indices[i], i * 4 + 1);
+    }
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
+
+TEST_F(BatchProcessorTest, GeometryScratchIsReused) {
+    CNBatchProcessor processor;
+    processor.SetBatchSize(8);
+    
+    std::vector<CNFeature*> features;
+    for (int i = 0; i < 32; ++i) {
+        features.push_back(new CNFeature(defn_));
+    }
+    
+    std::vector<const BatchScratch*> seen;
+    BatchResult result = processor.ProcessGeometries(features,
+        [&seen](CNFeature*, BatchScratch& scratch) {
+            EXPECT_TRUE(scratch.coords.empty());
+            scratch.coords.push_back(Coordinate(1.0, 2.0));
+            seen.push_back(&scratch);
+            return true;
+        });
+    
+    EXPECT_EQ(result.success_count, 32);
+    ASSERT_EQ(seen.size(), 32);
+    for (auto* s : seen) {
+        EXPECT_EQ(s, seen[0]);
+    }
+    
+    for (auto* f : features) {
+        delete f;
+    }
+}
@@ -391,190 +391,198 @@ private:
 
 class GeometryFactory::WKBReader {
 public:
-    explicit WKBReader(const std::vector<uint8_t>& wkb)
-        : m_wkb(wkb), m_pos(0) {}
+    WKBReader(const uint8_t* data, size_t size)
+        : m_data(data), m_size(size), m_pos(0), m_failed(false) {}
     
     GeometryPtr Parse() {
-        if (m_wkb.size() < 9) return nullptr;
-        
-        bool hasZ = false;
-        bool hasM = false;
-        uint8_t byteOrder = m_wkb[m_pos++];
-        
-        uint32_t typeInfo = ReadUInt32(byteOrder);
-        uint32_t geometryType = typeInfo & 0xFFFF;
-        
-        if (typeInfo & 0x10000000) hasZ = true;
-        if (typeInfo & 0x20000000) hasM = true;
-        
-        switch (geometryType) {
-            case 1: return ParsePoint(byteOrder, hasZ, hasM);
-            case 2: return ParseLineString(byteOrder, hasZ, hasM);
-            case 3: return ParsePolygon(byteOrder, hasZ, hasM);
-            case 4: return ParseMultiPoint(byteOrder, hasZ, hasM);
-            case 5: return ParseMultiLineString(byteOrder, hasZ, hasM);
-            case 6: return ParseMultiPolygon(byteOrder, hasZ, hasM);
-            case 7: return ParseGeometryCollection(byteOrder, hasZ, hasM);
-        }
-        
-        return nullptr;
+        GeometryPtr geometry = ParseGeometry(0);
+        if (m_failed) return nullptr;
+        return geometry;
     }
     
 private:
-    const std::vector<uint8_t>& m_wkb;
+    static const int kMaxDepth = 32;
+    
+    const uint8_t* m_data;
+    size_t m_size;
     size_t m_pos;
+    bool m_failed;
     
-    uint8_t ReadByte() {
-        if (m_pos >= m_wkb.size()) return 0;
-        return m_wkb[m_pos++];
+    bool Require(size_t bytes) {
+        if (m_failed || bytes > m_size - m_pos) {
+            m_failed = true;
+            return false;
+        }
+        return true;
     }
     
-    uint32_t ReadUInt32(uint8_t byteOrder) {
-        if (m_pos + 4 > m_wkb.size()) return 0;
-        uint32_t val = 0;
-        if (byteOrder == 0) {
-            val = m_wkb[m_pos] | (m_wkb[m_pos+1] << 8) | (m_wkb[m_pos+2] << 16) | (m_wkb[m_pos+3] << 24);
+    uint32_t ReadUInt32(bool littleEndian) {
+        if (!Require(4)) return 0;
+        const uint8_t* p = m_data + m_pos;
+        uint32_t val;
+        if (littleEndian) {
+            val = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                  (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
         } else {
-            val = (m_wkb[m_pos] << 24) | (m_wkb[m_pos+1] << 16) | (m_wkb[m_pos+2] << 8) | m_wkb[m_pos+3];
+            val = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                  (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
         }
         m_pos += 4;
         return val;
     }
     
-    uint64_t ReadUInt64(uint8_t byteOrder) {
-        if (m_pos + 8 > m_wkb.size()) return 0;
-        uint64_t val = 0;
-        if (byteOrder == 0) {
-            for (int i = 0; i < 8; i++) val |= ((uint64_t)m_wkb[m_pos+i] << (i*8));
-        } else {
-            for (int i = 0; i < 8; i++) val |= ((uint64_t)m_wkb[m_pos+i] << ((7-i)*8));
+    double ReadDouble(bool littleEndian) {
+        if (!Require(8)) return 0.0;
+        const uint8_t* p = m_data + m_pos;
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= static_cast<uint64_t>(p[i]) << ((littleEndian ? i : 7 - i) * 8);
         }
         m_pos += 8;
-        return val;
-    }
-    
-    double ReadDouble(uint8_t byteOrder) {
-        if (m_pos + 8 > m_wkb.size()) return 0.0;
-        uint64_t bits = ReadUInt64(byteOrder);
         double val;
         memcpy(&val, &bits, sizeof(double));
         return val;
     }
     
-    Coordinate ReadCoordinate(uint8_t byteOrder, bool hasZ, bool hasM) {
-        double x = ReadDouble(byteOrder);
-        double y = ReadDouble(byteOrder);
-        double z = 0.0;
-        double m = 0.0;
-        
-        if (hasZ) z = ReadDouble(byteOrder);
-        if (hasM) m = ReadDouble(byteOrder);
-        
-        return Coordinate(x, y, z);
-    }
-    
-    GeometryPtr ParsePoint(uint8_t byteOrder, bool hasZ, bool hasM) {
-        auto coord = ReadCoordinate(byteOrder, hasZ, hasM);
-        return Point::Create(coord);
-    }
-    
-    GeometryPtr ParseLineString(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numPoints = ReadUInt32(byteOrder);
-        auto line = LineString::Create();
-        
-        for (uint32_t i = 0; i < numPoints; i++) {
-            auto coord = ReadCoordinate(byteOrder, hasZ, hasM);
-            line->AddPoint(coord);
+    /** Element count, rejected when the remaining bytes cannot hold it. */
+    uint32_t ReadCount(bool littleEndian, size_t minElementSize) {
+        uint32_t count = ReadUInt32(littleEndian);
+        if (!m_failed && static_cast<uint64_t>(count) * minElementSize > m_size - m_pos) {
+            m_failed = true;
+            return 0;
         }
-        
-        return line;
+        return count;
     }
     
-    GeometryPtr ParsePolygon(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numRings = ReadUInt32(byteOrder);
-        auto polygon = Polygon::Create();
-        
-        for (uint32_t r = 0; r < numRings; r++) {
-            uint32_t numPoints = ReadUInt32(byteOrder);
-            auto ring = LinearRing::Create();
-            
-            for (uint32_t i = 0; i < numPoints; i++) {
-                auto coord = ReadCoordinate(byteOrder, hasZ, hasM);
-                ring->AddPoint(coord);
-            }
-            
-            if (r == 0) {
-                polygon->SetExteriorRing(std::move(ring));
-            } else {
-                polygon->AddInteriorRing(std::move(ring));
-            }
+    Coordinate ReadCoordinate(bool littleEndian, bool hasZ, bool hasM) {
+        double x = ReadDouble(littleEndian);
+        double y = ReadDouble(littleEndian);
+        if (hasZ && hasM) {
+            double z = ReadDouble(littleEndian);
+            return Coordinate(x, y, z, ReadDouble(littleEndian));
         }
-        
-        return polygon;
+        if (hasZ) {
+            return Coordinate(x, y, ReadDouble(littleEndian));
+        }
+        if (hasM) {
+            Coordinate coord(x, y);
+            coord.m = ReadDouble(littleEndian);
+            return coord;
+        }
+        return Coordinate(x, y);
     }
     
-    GeometryPtr ParseMultiPoint(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numGeoms = ReadUInt32(byteOrder);
-        auto multiPoint = MultiPoint::Create();
-        
-        for (uint32_t i = 0; i < numGeoms; i++) {
-            if (m_pos + 5 > m_wkb.size()) break;
-            m_pos += 4;
-            auto point = ParsePoint(byteOrder, hasZ, hasM);
-            if (point) {
-                multiPoint->AddPoint(PointPtr(dynamic_cast<Point*>(point.release())));
-            }
+    CoordinateList ReadCoordinates(bool littleEndian, bool hasZ, bool hasM) {
+        size_t dims = 2 + (hasZ ? 1 : 0) + (hasM ? 1 : 0);
+        uint32_t numPoints = ReadCount(littleEndian, dims * 8);
+        CoordinateList coords;
+        coords.reserve(numPoints);
+        for (uint32_t i = 0; i < numPoints && !m_failed; i++) {
+            coords.push_back(ReadCoordinate(littleEndian, hasZ, hasM));
         }
-        
-        return multiPoint;
+        return coords;
     }
     
-    GeometryPtr ParseMultiLineString(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numGeoms = ReadUInt32(byteOrder);
-        auto multiLine = MultiLineString::Create();
-        
-        for (uint32_t i = 0; i < numGeoms; i++) {
-            if (m_pos + 5 > m_wkb.size()) break;
-            m_pos += 4;
-            auto line = ParseLineString(byteOrder, hasZ, hasM);
-            if (line) {
-                multiLine->AddLineString(LineStringPtr(dynamic_cast<LineString*>(line.release())));
-            }
+    /**
+     * Accepts ISO (1001, 2001, 3001) and EWKB (high bit flags) dimension
+     * encodings; byte order 1 is little endian (NDR).
+     */
+    GeometryPtr ParseGeometry(int depth) {
+        if (depth > kMaxDepth || !Require(5)) {
+            m_failed = true;
+            return nullptr;
         }
+        bool littleEndian = m_data[m_pos++] == 1;
+        uint32_t typeInfo = ReadUInt32(littleEndian);
         
-        return multiLine;
-    }
-    
-    GeometryPtr ParseMultiPolygon(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numGeoms = ReadUInt32(byteOrder);
-        auto multiPoly = MultiPolygon::Create();
+        bool hasZ = (typeInfo & 0x80000000u) != 0;
+        bool hasM = (typeInfo & 0x40000000u) != 0;
+        uint32_t isoType = typeInfo & 0x0FFFFFFFu;
+        uint32_t geometryType = isoType % 1000;
+        uint32_t dimension = isoType / 1000;
+        if (dimension == 1 || dimension == 3) hasZ = true;
+        if (dimension == 2 || dimension == 3) hasM = true;
         
-        for (uint32_t i = 0; i < numGeoms; i++) {
-            if (m_pos + 5 > m_wkb.size()) break;
-            m_pos += 4;
-            auto poly = ParsePolygon(byteOrder, hasZ, hasM);
-            if (poly) {
-                multiPoly->AddPolygon(PolygonPtr(dynamic_cast<Polygon*>(poly.release())));
+        switch (geometryType) {
+            case 1: {
+                Coordinate coord = ReadCoordinate(littleEndian, hasZ, hasM);
+                if (m_failed) return nullptr;
+                return Point::Create(coord);
+            }
+            case 2: {
+                CoordinateList coords = ReadCoordinates(littleEndian, hasZ, hasM);
+                if (m_failed) return nullptr;
+                return LineString::Create(std::move(coords));
+            }
+            case 3: return ParsePolygon(littleEndian, hasZ, hasM);
+            case 4: {
+                uint32_t numGeoms = ReadCount(littleEndian, 5);
+                auto multiPoint = MultiPoint::Create();
+                for (uint32_t i = 0; i < numGeoms && !m_failed; i++) {
+                    GeometryPtr part = ParseGeometry(depth + 1);
+                    Point* point = dynamic_cast<Point*>(part.get());
+                    if (!point) { m_failed = true; break; }
+                    part.release();
+                    multiPoint->AddPoint(PointPtr(point));
+                }
+                return multiPoint;
+            }
+            case 5: {
+                uint32_t numGeoms = ReadCount(littleEndian, 5);
+                auto multiLine = MultiLineString::Create();
+                for (uint32_t i = 0; i < numGeoms && !m_failed; i++) {
+                    GeometryPtr part = ParseGeometry(depth + 1);
+                    LineString* line = dynamic_cast<LineString*>(part.get());
+                    if (!line) { m_failed = true; break; }
+                    part.release();
+                    multiLine->AddLineString(LineStringPtr(line));
+                }
+                return multiLine;
+            }
+            case 6: {
+                uint32_t numGeoms = ReadCount(littleEndian, 5);
+                auto multiPoly = MultiPolygon::Create();
+                for (uint32_t i = 0; i < numGeoms && !m_failed; i++) {
+                    GeometryPtr part = ParseGeometry(depth + 1);
+                    Polygon* poly = dynamic_cast<Polygon*>(part.get());
+                    if (!poly) { m_failed = true; break; }
+                    part.release();
+                    multiPoly->AddPolygon(PolygonPtr(poly));
+                }
+                return multiPoly;
+            }
+            case 7: {
+                uint32_t numGeoms = ReadCount(littleEndian, 5);
+                auto collection = GeometryCollection::Create();
+                for (uint32_t i = 0; i < numGeoms && !m_failed; i++) {
+                    GeometryPtr part = ParseGeometry(depth + 1);
+                    if (!part) { m_failed = true; break; }
+                    collection->AddGeometry(std::move(part));
+                }
+                return collection;
             }
         }
         
-        return multiPoly;
+        m_failed = true;
+        return nullptr;
     }
     
-    GeometryPtr ParseGeometryCollection(uint8_t byteOrder, bool hasZ, bool hasM) {
-        uint32_t numGeoms = ReadUInt32(byteOrder);
-        auto collection = GeometryCollection::Create();
+    GeometryPtr ParsePolygon(bool littleEndian, bool hasZ, bool hasM) {
+        uint32_t numRings = ReadCount(littleEndian, 4);
+        auto polygon = Polygon::Create();
         
-        for (uint32_t i = 0; i < numGeoms; i++) {
-            if (m_pos + 5 > m_wkb.size()) break;
-            m_pos += 4;
-            auto geom = Parse();
-            if (geom) {
-                collection->AddGeometry(std::move(geom));
+        for (uint32_t r = 0; r < numRings && !m_failed; r++) {
+            CoordinateList coords = ReadCoordinates(littleEndian, hasZ, hasM);
+            if (m_failed) break;
+            auto ring = LinearRing::Create(coords, false);
+            if (r == 0) {
+                polygon->SetExteriorRing(std::move(ring));
+            } else {
+                polygon->AddInteriorRing(std::move(ring));
             }
         }
         
-        return collection;
+        return polygon;
     }
 };
 
@@ -1012,8 +1020,13 @@ PolygonPtr GeometryFactory::CreatePolygonFromWKT(const std::string& wkt) {
 }
 
 GeomResult GeometryFactory::FromWKB(const std::vector<uint8_t>& wkb, GeometryPtr& result) {
+    return FromWKB(wkb.data(), wkb.size(), result);
+}
+
+GeomResult GeometryFactory::FromWKB(const uint8_t* data, size_t size, GeometryPtr& result) {
+    if (!data || size < 5) return GeomResult::kParseError;
     try {
-        WKBReader reader(wkb);
+        WKBReader reader(data, size);
         result = reader.Parse();
         if (result) {
             result->SetSRID(m_defaultSRID);
@@ -1025,12 +1038,6 @@ GeomResult GeometryFactory::FromWKB(const std::vector<uint8_t>& wkb, GeometryPtr
     }
 }
 
-GeomResult GeometryFactory::FromWKB(const uint8_t* data, size_t size, GeometryPtr& result) {
-    if (!data || size < 5) return GeomResult::kParseError;
-    std::vector<uint8_t> wkb(data, data + size);
-    return FromWKB(wkb, result);
-}
-
 GeomResult GeometryFactory::FromGeoJSON(const std::string& json, GeometryPtr& result) {
     try {
         GeoJSONReader reader(json);
@@ -307,5 +307,49 @@ TEST_F(GeometryFactoryTest, FromWKT_EmptyString_ReturnsError) {
     EXPECT_NE(result, GeomResult::kSuccess);
 }
 
+TEST_F(GeometryFactoryTest, FromWKB_RoundTripsAsBinary) {
+    auto& factory = GeometryFactory::GetInstance();
+    
+    GeometryPtr source;
+    ASSERT_EQ(factory.FromWKT("MULTIPOLYGON(((0 0, 10 0, 10 10, 0 10, 0 0)), ((20 20, 30 20, 30 30, 20 20)))", source),
+              GeomResult::kSuccess);
+    std::vector<uint8_t> wkb = source->AsBinary();
+    
+    GeometryPtr geom;
+    EXPECT_EQ(factory.FromWKB(wkb.data(), wkb.size(), geom), GeomResult::kSuccess);
+    ASSERT_NE(geom, nullptr);
+    EXPECT_EQ(geom->GetGeometryType(), GeomType::kMultiPolygon);
+    EXPECT_EQ(geom->GetNumGeometries(), 2u);
+    EXPECT_FALSE(geom->Is3D());
+    EXPECT_DOUBLE_EQ(geom->GetEnvelope().GetMaxX(), 30.0);
+}
+
+TEST_F(GeometryFactoryTest, FromWKB_BigEndianPointZ) {
+    auto& factory = GeometryFactory::GetInstance();
+    
+    const uint8_t wkb[] = {
+        0x00, 0x00, 0x00, 0x03, 0xE9,
+        0x3F, 0xF0, 0, 0, 0, 0, 0, 0,
+        0x40, 0x00, 0, 0, 0, 0, 0, 0,
+        0x40, 0x08, 0, 0, 0, 0, 0, 0
+    };
+    
+    GeometryPtr geom;
+    EXPECT_EQ(factory.FromWKB(wkb, sizeof(wkb), geom), GeomResult::kSuccess);
+    ASSERT_NE(geom, nullptr);
+    EXPECT_EQ(geom->GetGeometryType(), GeomType::kPoint);
+    EXPECT_TRUE(geom->Is3D());
+    EXPECT_DOUBLE_EQ(geom->GetEnvelope().GetMinX(), 1.0);
+}
+
+TEST_F(GeometryFactoryTest, FromWKB_TruncatedInput_ReturnsError) {
+    auto& factory = GeometryFactory::GetInstance();
+    
+    const uint8_t wkb[] = {0x01, 0x02, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00};
+    
+    GeometryPtr geom;
+    EXPECT_NE(factory.FromWKB(wkb, sizeof(wkb), geom), GeomResult::kSuccess);
+}
+
 }
 }
@@ -8,7 +8,9 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <chrono>
+#include <deque>
+#include <thread>
 
 namespace ogc {
 
@@ -23,7 +25,7 @@ enum class CNBackpressureStrategy {
 struct CNBackpressureConfig {
     CNBackpressureStrategy strategy = CNBackpressureStrategy::kBlock;
     size_t max_buffer_size = 10000;
-    int block_timeout_ms = 5000;
+    int block_timeout_ms = 0;  // 0 waits for the consumer indefinitely
     double throttle_factor = 0.8;
     bool enable_monitoring = true;
 };
@@ -56,6 +58,24 @@ public:
     virtual CNBackpressureStatus GetBackpressureStatus() const = 0;
 };
 
+/**
+ * @brief Feature stream that reads ahead from a layer on a producer thread.
+ *
+ * The producer starts on the first read and pulls batches of batch_size
+ * features into a bounded queue, so layer I/O and decoding overlap with
+ * the consumer. Buffered features are bounded by max_buffer_size (the high
+ * watermark); once it is reached the stream is backpressured until the
+ * consumer drains it to max_buffer_size * throttle_factor (the low
+ * watermark). While backpressured the producer blocks (kBlock; with a
+ * block_timeout_ms it gives up after that long, ending the stream early
+ * with GetStatus() == kTimeout), discards what it reads (kDrop) or
+ * keeps buffering (kBuffer); kThrottle also slows down above the low
+ * watermark. kNone reads synchronously on the caller's thread.
+ *
+ * The layer must not be used elsewhere while the producer runs. Close and
+ * Reset stop it, and Close wakes a consumer blocked in ReadNextBatch.
+ * Strategy changes between kNone and the others apply after Reset.
+ */
 class OGC_LAYER_API CNLayerFeatureStream : public CNFeatureStream {
 public:
     CNLayerFeatureStream(CNLayer* layer, size_t batch_size = 1000);
@@ -76,7 +96,26 @@ public:
 
     void SetBackpressureConfig(const CNBackpressureConfig& config);
 
+    /**
+     * @brief kTimeout when a blocked producer gave up waiting for the
+     * consumer, kError when the layer threw (see GetErrorMessage);
+     * kSuccess otherwise. Features buffered before a failure are still
+     * delivered.
+     */
+    CNStatus GetStatus() const;
+    std::string GetErrorMessage() const;
+
 private:
+    typedef std::vector<std::unique_ptr<CNFeature>> FeatureBatch;
+
+    void StartProducer(std::unique_lock<std::mutex>& lock);
+    void StopProducer();
+    void ProduceLoop();
+    bool AdmitBatch(std::unique_lock<std::mutex>& lock, size_t size);
+    bool WaitForBatch(std::unique_lock<std::mutex>& lock);
+    size_t HighWatermark() const;
+    size_t LowWatermark() const;
+
     CNLayer* layer_;
     size_t batch_size_;
     int64_t read_count_ = 0;
@@ -84,8 +123,18 @@ private:
     CNBackpressureConfig config_;
     mutable std::mutex mutex_;
     std::condition_variable cv_;
-    std::queue<std::unique_ptr<CNFeature>> buffer_;
+    std::condition_variable space_cv_;
+    std::deque<FeatureBatch> batches_;
+    size_t front_offset_ = 0;
     CNBackpressureStatus status_;
+
+    std::thread producer_;
+    bool producer_started_ = false;
+    bool producer_done_ = false;
+    std::atomic<bool> cancel_{false};
+    CNStatus producer_status_ = CNStatus::kSuccess;
+    std::string error_message_;
+    std::chrono::steady_clock::time_point start_time_;
 };
 
 } // namespace ogc
@@ -8,8 +8,24 @@
 
 namespace ogc {
 
+/**
+ * @brief GeoJSON FeatureCollection layer backed by the streaming reader
+ * and writer in geojson_stream.h.
+ *
+ * Opened files are memory-mapped and decoded one feature per read, so
+ * memory use does not grow with the document. The schema is inferred from
+ * the first kSchemaSampleSize features. GetFeature, GetFeatureCount and
+ * GetExtent build an offset index or scan on first use. Layers returned
+ * by Create stream features straight to the output file.
+ */
 class OGC_LAYER_API CNGeoJSONLayer : public CNVectorLayer {
 public:
+    static const size_t kSchemaSampleSize = 1000;
+
+    /**
+     * @brief Opens an existing file. Update mode is not supported and
+     * returns nullptr.
+     */
     static std::unique_ptr<CNVectorLayer> Open(
         const std::string& path,
         bool update = false);
@@ -48,6 +64,9 @@ public:
 
     CNStatus CreateField(const CNFieldDefn* field_defn, bool approx_ok = false) override;
 
+    void SetSpatialFilterRect(
+        double min_x, double min_y,
+        double max_x, double max_y) override;
     void SetSpatialFilter(const CNGeometry* geometry) override;
     const CNGeometry* GetSpatialFilter() const override;
 
@@ -55,6 +74,8 @@ public:
 
     bool TestCapability(CNLayerCapability capability) const override;
 
+    CNStatus SyncToDisk() override;
+
     std::unique_ptr<CNLayer> Clone() const override;
 
 private:
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ogc/layer/export.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ogc {
+
+class CNFeature;
+class CNFeatureDefn;
+
+/**
+ * @brief Incremental GeoJSON reader.
+ *
+ * Reads a FeatureCollection one feature at a time from a memory-mapped file
+ * (or a caller-owned buffer), so memory use is bounded by the largest single
+ * feature rather than the document. Whitespace, strings and skipped values
+ * are scanned 16 bytes at a time with SSE2 where available, and numbers are
+ * parsed straight into coordinates without intermediate strings. A single
+ * Feature document is read as a collection of one.
+ */
+class OGC_LAYER_API CNGeoJSONReader {
+public:
+    CNGeoJSONReader();
+    ~CNGeoJSONReader();
+
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Reads from a buffer that must outlive the reader.
+     */
+    bool OpenBuffer(const char* data, size_t size);
+
+    void Close();
+    bool IsOpen() const;
+
+    /**
+     * @brief Infers field names and types from the properties of the first
+     * sample_size features (all features when 0). Properties first seen
+     * after the sample are not read. The caller owns one reference.
+     */
+    CNFeatureDefn* BuildFeatureDefn(const std::string& name, size_t sample_size);
+
+    /**
+     * @brief Definition used for features returned by ReadNextFeature;
+     * properties are matched to fields by name. The reader keeps a reference.
+     * Without one only the geometry and FID are read.
+     */
+    void SetFeatureDefn(CNFeatureDefn* defn);
+
+    void Rewind();
+
+    /**
+     * @brief Returns the next feature, or nullptr at the end of the
+     * collection or on a syntax error (see HasError). Features without a
+     * numeric "id" get their zero-based position as FID.
+     */
+    std::unique_ptr<CNFeature> ReadNextFeature();
+
+    /**
+     * @brief Advances past the next feature without decoding it, reporting
+     * its FID when fid is given.
+     */
+    bool SkipNextFeature(int64_t* fid = nullptr);
+
+    /**
+     * @brief Byte offset of the next feature, usable with Seek together
+     * with GetSequence.
+     */
+    size_t Tell();
+    bool Seek(size_t offset, int64_t sequence);
+    int64_t GetSequence() const;
+
+    /**
+     * @brief "id" of the feature last returned by ReadNextFeature as text,
+     * whether written as a string or a number; empty when absent.
+     */
+    const std::string& GetFeatureId() const;
+
+    bool HasError() const;
+    const std::string& GetError() const;
+
+private:
+    CNGeoJSONReader(const CNGeoJSONReader&) = delete;
+    CNGeoJSONReader& operator=(const CNGeoJSONReader&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * @brief Buffered GeoJSON FeatureCollection writer.
+ *
+ * Features are serialized directly into an output buffer that is flushed
+ * to the file in large blocks; no document tree is built.
+ */
+class OGC_LAYER_API CNGeoJSONWriter {
+public:
+    static const size_t kDefaultBufferSize = 1 << 20;
+
+    CNGeoJSONWriter();
+    ~CNGeoJSONWriter();
+
+    bool Open(const std::string& path);
+
+    /**
+     * @brief Significant digits written for coordinates and real fields.
+     */
+    void SetPrecision(int digits);
+    int GetPrecision() const;
+
+    bool WriteFeature(const CNFeature& feature);
+    bool Flush();
+
+    /**
+     * @brief Terminates the collection and closes the file. Called by the
+     * destructor when needed.
+     */
+    bool Close();
+
+    bool IsOpen() const;
+    int64_t GetFeatureCount() const;
+
+private:
+    CNGeoJSONWriter(const CNGeoJSONWriter&) = delete;
+    CNGeoJSONWriter& operator=(const CNGeoJSONWriter&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace ogc
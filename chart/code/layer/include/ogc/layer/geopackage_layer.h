@@ -5,11 +5,29 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ogc {
 
+/**
+ * @brief Read-only GeoPackage feature table backed by SQLite.
+ *
+ * Features are streamed through a keyset-paged cursor ordered by FID, so at
+ * most one page is held in memory. Spatial filters are pushed into the
+ * rtree_<table>_<column> virtual table when it exists, attribute filters are
+ * appended to the query as SQL, and geometry blobs are decoded from the
+ * GeoPackage binary header and WKB without an intermediate copy. Prepared
+ * statements are cached until a filter changes.
+ */
 class OGC_LAYER_API CNGeoPackageLayer : public CNVectorLayer {
 public:
+    static const size_t kDefaultPageSize = 256;
+
+    /**
+     * @brief Opens a feature table. An empty layer_name opens the first
+     * feature table listed in gpkg_contents. Update mode is not supported and
+     * returns nullptr.
+     */
     static std::unique_ptr<CNVectorLayer> Open(
         const std::string& path,
         const std::string& layer_name,
@@ -48,10 +66,14 @@ public:
 
     CNStatus CreateFeature(CNFeature* feature) override;
     CNStatus DeleteFeature(int64_t fid) override;
+    int64_t CreateFeatureBatch(const std::vector<CNFeature*>& features) override;
 
     CNStatus CreateField(const CNFieldDefn* field_defn, bool approx_ok = false) override;
     CNStatus DeleteField(int field_index) override;
 
+    void SetSpatialFilterRect(
+        double min_x, double min_y,
+        double max_x, double max_y) override;
     void SetSpatialFilter(const CNGeometry* geometry) override;
     const CNGeometry* GetSpatialFilter() const override;
 
@@ -61,6 +83,14 @@ public:
 
     std::unique_ptr<CNLayer> Clone() const override;
 
+    /**
+     * @brief Number of rows fetched per query; takes effect on the next page.
+     */
+    void SetPageSize(size_t page_size);
+    size_t GetPageSize() const;
+
+    bool HasSpatialIndex() const;
+
 private:
     CNGeoPackageLayer();
     class Impl;
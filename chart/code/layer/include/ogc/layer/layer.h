@@ -52,6 +52,10 @@ public:
 
     virtual std::unique_ptr<CNFeature> GetNextFeature() = 0;
 
+    // Returns the next feature without copying it, or nullptr when the layer
+    // cannot lend features. The feature stays owned by the layer and is only
+    // valid until the next GetNextFeature/GetNextFeatureRef/ResetReading call;
+    // streaming layers reuse or free it for the next row.
     virtual CNFeature* GetNextFeatureRef() {
         return nullptr;
     }
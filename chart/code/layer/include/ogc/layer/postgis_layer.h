@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ogc {
 
@@ -19,8 +20,25 @@ struct CNPostGISConnectionParams {
     std::string geom_column = "geom";
 };
 
+/**
+ * @brief Read-only PostGIS table layer.
+ *
+ * The spatial filter, attribute filter and selected field subset are
+ * translated into one parameterized query whose bounding-box predicate
+ * (geom && ST_MakeEnvelope) can use the GiST index. Rows stream through a
+ * named server-side cursor in fetches of GetFetchSize() rows with binary
+ * results, and geometries are decoded from ST_AsBinary WKB. A cursor needs
+ * a transaction; when none was started with StartTransaction() the layer
+ * opens one for the cursor and ends it when the cursor is closed.
+ */
 class OGC_LAYER_API CNPostGISLayer : public CNVectorLayer {
 public:
+    static const size_t kDefaultFetchSize = 1000;
+
+    /**
+     * @brief Connects and reads the table schema. Update mode is not
+     * supported and returns nullptr.
+     */
     static std::unique_ptr<CNVectorLayer> Open(
         const CNPostGISConnectionParams& params,
         bool update = false);
@@ -57,10 +75,14 @@ public:
 
     CNStatus CreateFeature(CNFeature* feature) override;
     CNStatus DeleteFeature(int64_t fid) override;
+    int64_t CreateFeatureBatch(const std::vector<CNFeature*>& features) override;
 
     CNStatus CreateField(const CNFieldDefn* field_defn, bool approx_ok = false) override;
     CNStatus DeleteField(int field_index) override;
 
+    void SetSpatialFilterRect(
+        double min_x, double min_y,
+        double max_x, double max_y) override;
     void SetSpatialFilter(const CNGeometry* geometry) override;
     const CNGeometry* GetSpatialFilter() const override;
 
@@ -74,6 +96,19 @@ public:
 
     std::unique_ptr<CNLayer> Clone() const override;
 
+    /**
+     * @brief Restricts the attribute columns fetched from the server; the
+     * others stay unset on returned features. An empty list selects all.
+     */
+    CNStatus SetSelectedFields(const std::vector<std::string>& field_names);
+    const std::vector<std::string>& GetSelectedFields() const;
+
+    /**
+     * @brief Rows per FETCH; takes effect when the cursor is next opened.
+     */
+    void SetFetchSize(size_t fetch_size);
+    size_t GetFetchSize() const;
+
 private:
     CNPostGISLayer();
     class Impl;
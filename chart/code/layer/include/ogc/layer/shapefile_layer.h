@@ -8,8 +8,22 @@
 
 namespace ogc {
 
+/**
+ * @brief Native read-only ESRI Shapefile layer.
+ *
+ * The .shp, .shx and .dbf files are memory-mapped and records are decoded
+ * only when a feature is read, so opening is independent of file size.
+ * Spatial filters are answered from a MapServer-compatible .qix quadtree
+ * next to the .shp; when none exists it is built on first open and written
+ * beside the data if the directory is writable, otherwise kept in memory.
+ * FIDs are zero-based record numbers.
+ */
 class OGC_LAYER_API CNShapefileLayer : public CNVectorLayer {
 public:
+    /**
+     * @brief Opens an existing shapefile. Update mode is not supported and
+     * returns nullptr.
+     */
     static std::unique_ptr<CNVectorLayer> Open(
         const std::string& path,
         bool update = false);
@@ -51,6 +65,9 @@ public:
     CNStatus CreateField(const CNFieldDefn* field_defn, bool approx_ok = false) override;
     CNStatus DeleteField(int field_index) override;
 
+    void SetSpatialFilterRect(
+        double min_x, double min_y,
+        double max_x, double max_y) override;
     void SetSpatialFilter(const CNGeometry* geometry) override;
     const CNGeometry* GetSpatialFilter() const override;
 
@@ -60,6 +77,17 @@ public:
 
     std::unique_ptr<CNLayer> Clone() const override;
 
+    /**
+     * @brief Borrowed view of a DBF attribute with its padding trimmed.
+     *
+     * The view points into the mapped .dbf and stays valid while the layer
+     * is open. Returns false for unknown records, fields or deleted records.
+     */
+    bool GetFieldView(int64_t fid, int field_index,
+                      const char** data, size_t* size) const;
+
+    bool HasSpatialIndex() const;
+
 private:
     CNShapefileLayer();
     class Impl;
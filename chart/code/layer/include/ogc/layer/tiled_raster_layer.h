@@ -0,0 +1,198 @@
+#pragma once
+
+#include "ogc/layer/export.h"
+#include "ogc/layer/raster_layer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ogc {
+
+enum class CNResampleMethod {
+    kNearest,
+    kBilinear
+};
+
+/**
+ * @brief Thread-safe LRU cache of decoded raster blocks.
+ *
+ * Blocks are keyed by the owning layer, the pyramid level, the sample plane
+ * and the block index, and are evicted least recently used first once the
+ * cached bytes exceed the capacity. Layers share the process-wide default
+ * cache unless given their own.
+ */
+class OGC_LAYER_API CNRasterBlockCache {
+public:
+    static const size_t kDefaultCapacity = 64 << 20;
+
+    struct Key {
+        uint64_t owner;
+        int level;
+        int plane;
+        int64_t block;
+
+        bool operator==(const Key& other) const {
+            return owner == other.owner && level == other.level &&
+                   plane == other.plane && block == other.block;
+        }
+    };
+
+    typedef std::shared_ptr<const std::vector<uint8_t>> Block;
+
+    explicit CNRasterBlockCache(size_t capacity_bytes = kDefaultCapacity);
+    ~CNRasterBlockCache();
+
+    static std::shared_ptr<CNRasterBlockCache> GetDefault();
+
+    /**
+     * @brief Returns an owner id that no other cache user has.
+     */
+    static uint64_t NewOwnerId();
+
+    Block Find(const Key& key);
+    void Insert(const Key& key, Block block);
+
+    /**
+     * @brief Drops every block of the given owner.
+     */
+    void Erase(uint64_t owner);
+    void Clear();
+
+    void SetCapacity(size_t capacity_bytes);
+    size_t GetCapacity() const;
+    size_t GetSize() const;
+    size_t GetBlockCount() const;
+    uint64_t GetHitCount() const;
+    uint64_t GetMissCount() const;
+
+private:
+    CNRasterBlockCache(const CNRasterBlockCache&) = delete;
+    CNRasterBlockCache& operator=(const CNRasterBlockCache&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * @brief Read-only raster layer over tiled or stripped GeoTIFF files.
+ *
+ * The file is memory-mapped and blocks are decoded only when a read touches
+ * them, then kept in a shared CNRasterBlockCache. Reduced-resolution images
+ * stored in the file are used as overviews, and ReadWindow picks the
+ * coarsest one that still matches the requested output resolution, so a
+ * zoomed-out read touches a few blocks rather than the full raster.
+ *
+ * Uncompressed and Deflate data with 8 to 64 bit integer or floating point
+ * samples, chunky or planar, are supported. Multi-band buffers are band
+ * sequential.
+ */
+class OGC_LAYER_API CNTiledRasterLayer : public CNRasterLayer {
+public:
+    /**
+     * @brief Opens a TIFF file. Uses the default block cache when cache is
+     * null. Returns nullptr for missing files and unsupported layouts.
+     */
+    static std::unique_ptr<CNTiledRasterLayer> Open(
+        const std::string& path,
+        std::shared_ptr<CNRasterBlockCache> cache = nullptr);
+
+    ~CNTiledRasterLayer() override;
+
+    const std::string& GetName() const override;
+
+    CNFeatureDefn* GetFeatureDefn() override;
+    const CNFeatureDefn* GetFeatureDefn() const override;
+
+    GeomType GetGeomType() const override;
+
+    CNStatus GetExtent(Envelope& extent, bool force = true) const override;
+
+    int64_t GetFeatureCount(bool force = true) const override;
+
+    void ResetReading() override;
+    std::unique_ptr<CNFeature> GetNextFeature() override;
+    std::unique_ptr<CNFeature> GetFeature(int64_t fid) override;
+
+    void SetSpatialFilterRect(
+        double min_x, double min_y,
+        double max_x, double max_y) override;
+    void SetSpatialFilter(const CNGeometry* geometry) override;
+    const CNGeometry* GetSpatialFilter() const override;
+
+    CNStatus SetAttributeFilter(const std::string& query) override;
+
+    bool TestCapability(CNLayerCapability capability) const override;
+
+    std::unique_ptr<CNLayer> Clone() const override;
+
+    int GetWidth() const override;
+    int GetHeight() const override;
+    int GetBandCount() const override;
+    double GetPixelWidth() const override;
+    double GetPixelHeight() const override;
+    CNDataType GetDataType() const override;
+
+    void GetGeoTransform(double* transform) const override;
+
+    CNRasterBand* GetBand(int band_index) override;
+
+    /**
+     * @brief Reads a full-resolution window of the first band_count bands.
+     */
+    CNStatus ReadRaster(int x_offset, int y_offset, int width, int height,
+                        int band_count, CNDataType buffer_type, void* buffer) override;
+
+    CNStatus WriteRaster(int x_offset, int y_offset, int width, int height,
+                         int band_count, CNDataType buffer_type, const void* buffer) override;
+
+    /**
+     * @brief Reads the window (x_offset, y_offset, x_size, y_size) in
+     * full-resolution pixels into a buffer_x_size by buffer_y_size buffer,
+     * reading from the best overview for that scale.
+     *
+     * band_list holds zero-based band indices; when null the first
+     * band_count bands are read (all bands when band_count is 0).
+     */
+    CNStatus ReadWindow(int x_offset, int y_offset,
+                        int x_size, int y_size,
+                        void* buffer,
+                        int buffer_x_size, int buffer_y_size,
+                        CNDataType buffer_type,
+                        const int* band_list = nullptr,
+                        int band_count = 0,
+                        CNResampleMethod method = CNResampleMethod::kNearest);
+
+    /**
+     * @brief Overview level ReadWindow reads for the given window and
+     * output size: 0 is full resolution, i is GetOverviewSize(i - 1).
+     */
+    int SelectLevel(int x_size, int y_size, int buffer_x_size, int buffer_y_size) const;
+
+    int GetOverviewCount() const;
+    bool GetOverviewSize(int index, int* width, int* height) const;
+
+    /**
+     * @brief Builds 2x2 averaged overviews in memory down to min_size
+     * pixels when the file has none. The levels are held by the layer, so
+     * this is meant for rasters that fit in memory at a quarter size.
+     * Reads may run concurrently with each other but not with this call.
+     */
+    CNStatus BuildOverviews(int min_size = 256);
+
+    void GetBlockSize(int* width, int* height) const;
+
+    bool HasNoDataValue() const;
+    double GetNoDataValue() const;
+
+    CNRasterBlockCache* GetBlockCache() const;
+
+private:
+    CNTiledRasterLayer();
+    friend class CNTiledRasterBand;
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace ogc
@@ -4,6 +4,7 @@
 #include "ogc/layer/layer.h"
 #include "ogc/layer/layer_type.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -16,16 +17,80 @@ struct CNWFSConnectionParams {
     std::string user;
     std::string password;
     int timeout_ms = 30000;
+    // Page size of GetFeature requests.
     int max_features = 1000;
     bool verify_ssl = true;
+    // Threads fetching pages in the background.
+    int worker_count = 2;
+    // Side of the square cache cells in layer units; 0 derives it from
+    // the layer extent.
+    double cell_size = 0.0;
 };
 
+struct CNWFSResponse {
+    int status_code = 0;
+    std::string content_type;
+    std::string body;
+    std::string error;
+};
+
+/**
+ * @brief HTTP GET used by CNWFSLayer; called concurrently from the fetch
+ * workers, so implementations must be thread-safe.
+ */
+class OGC_LAYER_API CNWFSTransport {
+public:
+    virtual ~CNWFSTransport() = default;
+
+    /**
+     * @brief Returns false when no HTTP response was received; the status
+     * code of a received response is checked by the caller.
+     */
+    virtual bool Get(const std::string& url, int timeout_ms, CNWFSResponse& response) = 0;
+
+    /**
+     * @brief Plain http:// client with optional basic authentication.
+     * https:// URLs need a transport supplied by the application.
+     */
+    static std::shared_ptr<CNWFSTransport> CreateHttp(
+        const std::string& user = "",
+        const std::string& password = "");
+};
+
+struct CNWFSCacheStats {
+    int64_t requests = 0;
+    int64_t cells_fetched = 0;
+    int64_t cell_hits = 0;
+    int64_t cached_cells = 0;
+    int64_t cached_features = 0;
+};
+
+/**
+ * @brief WFS layer reading features page by page into a local cache.
+ *
+ * The plane is divided into square cells. A spatial filter maps to the cells
+ * it covers, and cells not yet cached for the current server revision are
+ * fetched on background workers with bbox-limited GetFeature requests paged
+ * by startIndex/count. Panning therefore only requests the newly exposed
+ * cells. Features are stored once however many cells returned them. The
+ * server revision is the capabilities updateSequence; Refresh drops cached
+ * cells when it changes. Responses may be GeoJSON or GML.
+ */
 class OGC_LAYER_API CNWFSLayer : public CNLayer {
 public:
     static std::unique_ptr<CNWFSLayer> Connect(
         const CNWFSConnectionParams& params,
         const std::string& type_name);
 
+    /**
+     * @brief Connects through the given transport; the default plain HTTP
+     * transport is used when it is null.
+     */
+    static std::unique_ptr<CNWFSLayer> Connect(
+        const CNWFSConnectionParams& params,
+        const std::string& type_name,
+        std::shared_ptr<CNWFSTransport> transport);
+
     static std::string GetCapabilities(const std::string& url);
 
     static std::vector<std::string> ListLayers(const std::string& url);
@@ -62,15 +127,59 @@ public:
 
     bool TestCapability(CNLayerCapability capability) const override;
 
+    /**
+     * @brief Connects again with the same parameters and transport; the
+     * cache is not shared.
+     */
+    std::unique_ptr<CNLayer> Clone() const override;
+
     std::string GetServiceURL() const;
     std::string GetTypeName() const;
 
+    /**
+     * @brief CRS appended to bbox parameters; by default WFS 1.1 and 2.0
+     * requests send lon/lat boxes tagged urn:ogc:def:crs:OGC:1.3:CRS84.
+     */
     void SetBBOXCRS(const std::string& crs);
     void SetSortBy(const std::string& property, bool ascending = true);
     void SetOutputFormat(const std::string& format);
 
+    /**
+     * @brief Fetches every page of the layer without a bbox.
+     */
     CNStatus PreloadAll();
 
+    /**
+     * @brief Queues the cells covering the rectangle without waiting, e.g.
+     * ahead of a pan.
+     */
+    void Prefetch(double min_x, double min_y, double max_x, double max_y);
+
+    /**
+     * @brief Waits for queued fetches; returns false on timeout. A negative
+     * timeout waits indefinitely.
+     */
+    bool WaitForFetches(int timeout_ms = -1);
+
+    /**
+     * @brief Re-reads the server revision and drops the cache when it
+     * changed.
+     */
+    CNStatus Refresh();
+
+    std::string GetServerRevision() const;
+    double GetCellSize() const;
+
+    void ClearCache();
+    CNWFSCacheStats GetCacheStats() const;
+
+    /**
+     * @brief Last request or parse error. A read that needs a failed cell
+     * returns no features and GetFeatureCount() returns -1; the cell is
+     * retried by the next read that needs it.
+     */
+    std::string GetLastError() const;
+
 private:
     CNWFSLayer();
     class Impl;
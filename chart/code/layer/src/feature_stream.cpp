@@ -2,76 +2,287 @@
 
 #include "ogc/feature/feature.h"
 
-#include <queue>
+#include <algorithm>
+#include <exception>
 
 namespace ogc {
 
 CNLayerFeatureStream::CNLayerFeatureStream(CNLayer* layer, size_t batch_size)
-    : layer_(layer), batch_size_(batch_size) {
+    : layer_(layer), batch_size_(batch_size > 0 ? batch_size : 1) {
 }
 
 CNLayerFeatureStream::~CNLayerFeatureStream() {
     Close();
 }
 
-std::vector<std::unique_ptr<CNFeature>> CNLayerFeatureStream::ReadNextBatch(size_t batch_size) {
-    if (closed_ || !layer_) {
-        return {};
+size_t CNLayerFeatureStream::HighWatermark() const {
+    return std::max<size_t>(config_.max_buffer_size, 1);
+}
+
+size_t CNLayerFeatureStream::LowWatermark() const {
+    double factor = std::min(std::max(config_.throttle_factor, 0.0), 1.0);
+    return static_cast<size_t>(static_cast<double>(HighWatermark()) * factor);
+}
+
+void CNLayerFeatureStream::StartProducer(std::unique_lock<std::mutex>& lock) {
+    (void)lock;
+    if (producer_started_) {
+        return;
     }
+    producer_started_ = true;
+    producer_done_ = false;
+    cancel_ = false;
+    start_time_ = std::chrono::steady_clock::now();
+    producer_ = std::thread(&CNLayerFeatureStream::ProduceLoop, this);
+}
 
-    std::vector<std::unique_ptr<CNFeature>> batch;
-    batch.reserve(batch_size);
+void CNLayerFeatureStream::StopProducer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancel_ = true;
+    }
+    space_cv_.notify_all();
+    cv_.notify_all();
+    if (producer_.joinable()) {
+        producer_.join();
+    }
+}
 
-    for (size_t i = 0; i < batch_size; ++i) {
-        auto feature = layer_->GetNextFeature();
-        if (!feature) {
+// Called with a batch of the given size ready to queue. Returns false when
+// the batch must not be queued; producer_done_ is set if the producer has
+// to stop.
+bool CNLayerFeatureStream::AdmitBatch(std::unique_lock<std::mutex>& lock, size_t size) {
+    if (status_.current_buffer_size >= HighWatermark()) {
+        status_.is_backpressured = true;
+    }
+    switch (config_.strategy) {
+        case CNBackpressureStrategy::kDrop:
+            if (status_.is_backpressured) {
+                status_.total_dropped += size;
+                return false;
+            }
+            break;
+        case CNBackpressureStrategy::kBuffer:
+            break;
+        case CNBackpressureStrategy::kThrottle:
+            if (!status_.is_backpressured && status_.current_buffer_size > LowWatermark()) {
+                // Give the consumer a chance to catch up before reading on.
+                space_cv_.wait_for(lock, std::chrono::milliseconds(10), [this] {
+                    return cancel_ || status_.current_buffer_size <= LowWatermark();
+                });
+            }
+            // fall through
+        default:
+            if (status_.is_backpressured) {
+                ++status_.total_blocked;
+                auto drained = [this] { return cancel_ || !status_.is_backpressured; };
+                if (config_.strategy == CNBackpressureStrategy::kBlock &&
+                    config_.block_timeout_ms > 0) {
+                    if (!space_cv_.wait_for(lock, std::chrono::milliseconds(config_.block_timeout_ms),
+                                            drained)) {
+                        producer_status_ = CNStatus::kTimeout;
+                        error_message_ = "consumer did not drain the stream buffer in time";
+                        producer_done_ = true;
+                        return false;
+                    }
+                } else {
+                    space_cv_.wait(lock, drained);
+                }
+            }
+            break;
+    }
+    return !cancel_;
+}
+
+void CNLayerFeatureStream::ProduceLoop() {
+    bool exhausted = false;
+    while (!exhausted && !cancel_) {
+        FeatureBatch batch;
+        batch.reserve(batch_size_);
+        try {
+            while (batch.size() < batch_size_ && !cancel_) {
+                std::unique_ptr<CNFeature> feature = layer_->GetNextFeature();
+                if (!feature) {
+                    exhausted = true;
+                    break;
+                }
+                batch.push_back(std::move(feature));
+            }
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            producer_status_ = CNStatus::kError;
+            error_message_ = e.what();
+            exhausted = true;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            producer_status_ = CNStatus::kError;
+            error_message_ = "unknown exception while reading the layer";
+            exhausted = true;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!batch.empty() && AdmitBatch(lock, batch.size())) {
+            status_.current_buffer_size += batch.size();
+            status_.total_produced += batch.size();
+            batches_.push_back(std::move(batch));
+            cv_.notify_all();
+        }
+        if (producer_done_) {
             break;
         }
-        batch.push_back(std::move(feature));
-        ++read_count_;
     }
+    std::lock_guard<std::mutex> lock(mutex_);
+    producer_done_ = true;
+    cv_.notify_all();
+}
 
-    if (config_.enable_monitoring) {
-        status_.total_produced += batch.size();
-        status_.current_buffer_size = buffer_.size();
+bool CNLayerFeatureStream::WaitForBatch(std::unique_lock<std::mutex>& lock) {
+    if (closed_) {
+        return false;
     }
+    StartProducer(lock);
+    cv_.wait(lock, [this] { return closed_ || !batches_.empty() || producer_done_; });
+    return !closed_ && !batches_.empty();
+}
 
-    return batch;
+std::vector<std::unique_ptr<CNFeature>> CNLayerFeatureStream::ReadNextBatch(size_t batch_size) {
+    if (!layer_) {
+        return {};
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (config_.strategy == CNBackpressureStrategy::kNone && !producer_started_) {
+        if (closed_) {
+            return {};
+        }
+        lock.unlock();
+        FeatureBatch batch;
+        batch.reserve(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            auto feature = layer_->GetNextFeature();
+            if (!feature) {
+                break;
+            }
+            batch.push_back(std::move(feature));
+        }
+        lock.lock();
+        read_count_ += static_cast<int64_t>(batch.size());
+        if (config_.enable_monitoring) {
+            status_.total_produced += batch.size();
+            status_.total_consumed += batch.size();
+        }
+        return batch;
+    }
+
+    FeatureBatch result;
+    while (result.size() < batch_size && WaitForBatch(lock)) {
+        FeatureBatch& front = batches_.front();
+        size_t available = front.size() - front_offset_;
+        size_t take = std::min(available, batch_size - result.size());
+        if (result.empty() && front_offset_ == 0 && take == front.size()) {
+            // Whole producer batches are handed over without copying.
+            result = std::move(front);
+            batches_.pop_front();
+        } else {
+            result.reserve(std::min(batch_size, result.size() + available));
+            for (size_t i = 0; i < take; ++i) {
+                result.push_back(std::move(front[front_offset_ + i]));
+            }
+            front_offset_ += take;
+            if (front_offset_ >= front.size()) {
+                batches_.pop_front();
+                front_offset_ = 0;
+            }
+        }
+        status_.current_buffer_size -= take;
+    }
+
+    read_count_ += static_cast<int64_t>(result.size());
+    status_.total_consumed += result.size();
+    if (status_.is_backpressured && status_.current_buffer_size <= LowWatermark()) {
+        status_.is_backpressured = false;
+    }
+    space_cv_.notify_all();
+    return result;
 }
 
 bool CNLayerFeatureStream::IsEndOfStream() const {
-    return closed_ || read_count_ >= layer_->GetFeatureCount();
+    if (!layer_) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (config_.strategy == CNBackpressureStrategy::kNone && !producer_started_) {
+        return closed_ || read_count_ >= layer_->GetFeatureCount();
+    }
+    // Whether more features follow is only known once the producer has
+    // queued a batch or reached the end, so wait for either.
+    return !const_cast<CNLayerFeatureStream*>(this)->WaitForBatch(lock);
 }
 
 int64_t CNLayerFeatureStream::GetReadCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return read_count_;
 }
 
 void CNLayerFeatureStream::Reset() {
+    StopProducer();
     std::lock_guard<std::mutex> lock(mutex_);
     if (layer_) {
         layer_->ResetReading();
     }
+    batches_.clear();
+    front_offset_ = 0;
     read_count_ = 0;
     closed_ = false;
+    producer_started_ = false;
+    producer_done_ = false;
+    producer_status_ = CNStatus::kSuccess;
+    error_message_.clear();
+    status_ = CNBackpressureStatus();
 }
 
 void CNLayerFeatureStream::Close() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    closed_ = true;
-    while (!buffer_.empty()) {
-        buffer_.pop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
     }
+    StopProducer();
+    std::lock_guard<std::mutex> lock(mutex_);
+    batches_.clear();
+    front_offset_ = 0;
+    status_.current_buffer_size = 0;
 }
 
 CNBackpressureStatus CNLayerFeatureStream::GetBackpressureStatus() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    return status_;
+    CNBackpressureStatus status = status_;
+    if (config_.enable_monitoring && producer_started_) {
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time_).count();
+        if (seconds > 0.0) {
+            status.production_rate = static_cast<double>(status.total_produced) / seconds;
+            status.consumption_rate = static_cast<double>(status.total_consumed) / seconds;
+        }
+    }
+    return status;
 }
 
 void CNLayerFeatureStream::SetBackpressureConfig(const CNBackpressureConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+    }
+    space_cv_.notify_all();
+}
+
+CNStatus CNLayerFeatureStream::GetStatus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return producer_status_;
+}
+
+std::string CNLayerFeatureStream::GetErrorMessage() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    config_ = config;
+    return error_message_;
 }
 
 } // namespace ogc
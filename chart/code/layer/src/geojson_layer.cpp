@@ -1,50 +1,182 @@
 #include "ogc/layer/geojson_layer.h"
+#include "ogc/layer/geojson_stream.h"
 #include "ogc/layer/geometry_compat.h"
 
 #include "ogc/feature/feature.h"
+#include "ogc/feature/feature_defn.h"
 #include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
 #include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
 
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
 
 namespace ogc {
 
+namespace {
+
+std::string LayerNameFromPath(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name.resize(dot);
+    }
+    return name;
+}
+
+} // namespace
+
 class CNGeoJSONLayer::Impl {
 public:
+    struct IndexEntry {
+        int64_t fid;
+        size_t offset;
+        int64_t sequence;
+
+        bool operator<(const IndexEntry& other) const {
+            return fid < other.fid;
+        }
+    };
+
     std::string path_;
     std::string name_;
     bool is_read_only_ = true;
     std::shared_ptr<CNFeatureDefn> feature_defn_;
     void* spatial_ref_ = nullptr;
-    Envelope extent_;
-    bool extent_loaded_ = false;
-    std::vector<std::unique_ptr<CNFeature>> features_;
-    std::unordered_map<int64_t, size_t> fid_index_;
-    size_t read_cursor_ = 0;
     std::unique_ptr<CNGeometry> spatial_filter_;
+    Envelope filter_extent_;
     std::string attribute_filter_;
-    int64_t next_fid_ = 1;
+
+    CNGeoJSONReader reader_;
+    std::unique_ptr<CNFeature> current_;
+
+    // Random access, counting and extent use a second reader so they do
+    // not disturb sequential reading.
+    mutable std::unique_ptr<CNGeoJSONReader> random_reader_;
+    mutable std::vector<IndexEntry> fid_index_;
+    mutable bool index_built_ = false;
+    mutable Envelope extent_;
+    mutable bool extent_loaded_ = false;
+
+    std::unique_ptr<CNGeoJSONWriter> writer_;
+    std::unordered_set<int64_t> written_fids_;
+    int64_t next_fid_ = 0;
+
+    bool PassesFilter(const CNFeature& feature) const;
+    CNGeoJSONReader* GetRandomReader() const;
+    bool BuildIndex() const;
 };
 
+bool CNGeoJSONLayer::Impl::PassesFilter(const CNFeature& feature) const {
+    if (filter_extent_.IsNull()) {
+        return true;
+    }
+    const CNGeometry* geometry = feature.GetGeometryRef();
+    return geometry && !geometry->IsEmpty() &&
+           geometry->GetEnvelope().Intersects(filter_extent_);
+}
+
+CNGeoJSONReader* CNGeoJSONLayer::Impl::GetRandomReader() const {
+    if (!random_reader_) {
+        std::unique_ptr<CNGeoJSONReader> reader(new CNGeoJSONReader());
+        if (!reader->Open(path_)) {
+            return nullptr;
+        }
+        reader->SetFeatureDefn(feature_defn_.get());
+        random_reader_ = std::move(reader);
+    }
+    return random_reader_.get();
+}
+
+bool CNGeoJSONLayer::Impl::BuildIndex() const {
+    if (index_built_) {
+        return true;
+    }
+    CNGeoJSONReader* reader = GetRandomReader();
+    if (!reader) {
+        return false;
+    }
+    reader->Rewind();
+    fid_index_.clear();
+    while (true) {
+        IndexEntry entry;
+        entry.offset = reader->Tell();
+        entry.sequence = reader->GetSequence();
+        if (!reader->SkipNextFeature(&entry.fid)) {
+            break;
+        }
+        fid_index_.push_back(entry);
+    }
+    if (reader->HasError()) {
+        fid_index_.clear();
+        return false;
+    }
+    std::stable_sort(fid_index_.begin(), fid_index_.end());
+    index_built_ = true;
+    return true;
+}
+
 CNGeoJSONLayer::CNGeoJSONLayer()
     : impl_(new Impl()) {
 }
 
-CNGeoJSONLayer::~CNGeoJSONLayer() = default;
+CNGeoJSONLayer::~CNGeoJSONLayer() {
+    if (impl_->writer_) {
+        impl_->writer_->Close();
+    }
+}
 
 std::unique_ptr<CNVectorLayer> CNGeoJSONLayer::Open(
     const std::string& path, bool update) {
-    (void)path;
-    (void)update;
-    return nullptr;
+    if (update || path.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNGeoJSONLayer> layer(new CNGeoJSONLayer());
+    Impl& impl = *layer->impl_;
+    impl.path_ = path;
+    impl.name_ = LayerNameFromPath(path);
+    impl.filter_extent_.SetNull();
+
+    if (!impl.reader_.Open(path)) {
+        return nullptr;
+    }
+    CNFeatureDefn* defn = impl.reader_.BuildFeatureDefn(impl.name_, kSchemaSampleSize);
+    if (!defn) {
+        return nullptr;
+    }
+    impl.feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+    return std::unique_ptr<CNVectorLayer>(layer.release());
 }
 
 std::unique_ptr<CNVectorLayer> CNGeoJSONLayer::Create(
     const std::string& path) {
-    (void)path;
-    return nullptr;
+    if (path.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNGeoJSONLayer> layer(new CNGeoJSONLayer());
+    Impl& impl = *layer->impl_;
+    impl.path_ = path;
+    impl.name_ = LayerNameFromPath(path);
+    impl.filter_extent_.SetNull();
+    impl.extent_.SetNull();
+    impl.extent_loaded_ = true;
+    impl.is_read_only_ = false;
+
+    impl.writer_.reset(new CNGeoJSONWriter());
+    if (!impl.writer_->Open(path)) {
+        return nullptr;
+    }
+    CNFeatureDefn* defn = CNFeatureDefn::Create(impl.name_.c_str());
+    impl.feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+    defn->AddGeomFieldDefn(CreateCNGeomFieldDefn("geom"));
+    return std::unique_ptr<CNVectorLayer>(layer.release());
 }
 
 const std::string& CNGeoJSONLayer::GetName() const {
@@ -87,41 +219,106 @@ const void* CNGeoJSONLayer::GetSpatialRef() const {
 }
 
 CNStatus CNGeoJSONLayer::GetExtent(Envelope& extent, bool force) const {
-    (void)force;
-    extent = impl_->extent_;
+    const Impl& impl = *impl_;
+    if (!impl.extent_loaded_) {
+        if (!force) {
+            return CNStatus::kNotSupported;
+        }
+        CNGeoJSONReader* reader = impl.GetRandomReader();
+        if (!reader) {
+            return CNStatus::kIOError;
+        }
+        Envelope total;
+        total.SetNull();
+        reader->Rewind();
+        while (std::unique_ptr<CNFeature> feature = reader->ReadNextFeature()) {
+            const CNGeometry* geometry = feature->GetGeometryRef();
+            if (geometry && !geometry->IsEmpty()) {
+                total.ExpandToInclude(geometry->GetEnvelope());
+            }
+        }
+        if (reader->HasError()) {
+            return CNStatus::kCorruptData;
+        }
+        impl.extent_ = total;
+        impl.extent_loaded_ = true;
+    }
+    extent = impl.extent_;
     return CNStatus::kSuccess;
 }
 
 int64_t CNGeoJSONLayer::GetFeatureCount(bool force) const {
-    (void)force;
-    return static_cast<int64_t>(impl_->features_.size());
+    const Impl& impl = *impl_;
+    if (impl.writer_) {
+        return impl.writer_->GetFeatureCount();
+    }
+    if (impl.filter_extent_.IsNull()) {
+        if (!impl.index_built_ && !force) {
+            return -1;
+        }
+        return impl.BuildIndex() ? static_cast<int64_t>(impl.fid_index_.size()) : -1;
+    }
+    if (!force) {
+        return -1;
+    }
+    CNGeoJSONReader* reader = impl.GetRandomReader();
+    if (!reader) {
+        return -1;
+    }
+    int64_t count = 0;
+    reader->Rewind();
+    while (std::unique_ptr<CNFeature> feature = reader->ReadNextFeature()) {
+        if (impl.PassesFilter(*feature)) {
+            ++count;
+        }
+    }
+    return count;
 }
 
 void CNGeoJSONLayer::ResetReading() {
-    impl_->read_cursor_ = 0;
+    impl_->reader_.Rewind();
+    impl_->current_.reset();
 }
 
 std::unique_ptr<CNFeature> CNGeoJSONLayer::GetNextFeature() {
-    CNFeature* feature = GetNextFeatureRef();
-    if (!feature) {
+    if (!GetNextFeatureRef()) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(feature->Clone());
+    return std::move(impl_->current_);
 }
 
 CNFeature* CNGeoJSONLayer::GetNextFeatureRef() {
-    if (impl_->read_cursor_ >= impl_->features_.size()) {
+    Impl& impl = *impl_;
+    if (impl.writer_) {
         return nullptr;
     }
-    return impl_->features_[impl_->read_cursor_++].get();
+    while (true) {
+        impl.current_ = impl.reader_.ReadNextFeature();
+        if (!impl.current_) {
+            return nullptr;
+        }
+        if (impl.PassesFilter(*impl.current_)) {
+            return impl.current_.get();
+        }
+    }
 }
 
 std::unique_ptr<CNFeature> CNGeoJSONLayer::GetFeature(int64_t fid) {
-    auto it = impl_->fid_index_.find(fid);
-    if (it == impl_->fid_index_.end()) {
+    Impl& impl = *impl_;
+    if (impl.writer_ || !impl.BuildIndex()) {
+        return nullptr;
+    }
+    Impl::IndexEntry key;
+    key.fid = fid;
+    auto it = std::lower_bound(impl.fid_index_.begin(), impl.fid_index_.end(), key);
+    if (it == impl.fid_index_.end() || it->fid != fid) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(impl_->features_[it->second]->Clone());
+    CNGeoJSONReader* reader = impl.GetRandomReader();
+    if (!reader->Seek(it->offset, it->sequence)) {
+        return nullptr;
+    }
+    return reader->ReadNextFeature();
 }
 
 CNStatus CNGeoJSONLayer::SetFeature(const CNFeature* feature) {
@@ -130,8 +327,30 @@ CNStatus CNGeoJSONLayer::SetFeature(const CNFeature* feature) {
 }
 
 CNStatus CNGeoJSONLayer::CreateFeature(CNFeature* feature) {
-    (void)feature;
-    return CNStatus::kNotSupported;
+    Impl& impl = *impl_;
+    if (!impl.writer_) {
+        return CNStatus::kNotSupported;
+    }
+    if (!feature) {
+        return CNStatus::kNullPointer;
+    }
+
+    int64_t fid = feature->GetFID();
+    if (!impl.written_fids_.insert(fid).second) {
+        fid = impl.next_fid_;
+        feature->SetFID(fid);
+        impl.written_fids_.insert(fid);
+    }
+    impl.next_fid_ = std::max(impl.next_fid_, fid + 1);
+
+    if (!impl.writer_->WriteFeature(*feature)) {
+        return CNStatus::kIOError;
+    }
+    const CNGeometry* geometry = feature->GetGeometryRef();
+    if (geometry && !geometry->IsEmpty()) {
+        impl.extent_.ExpandToInclude(geometry->GetEnvelope());
+    }
+    return CNStatus::kSuccess;
 }
 
 CNStatus CNGeoJSONLayer::DeleteFeature(int64_t fid) {
@@ -140,16 +359,32 @@ CNStatus CNGeoJSONLayer::DeleteFeature(int64_t fid) {
 }
 
 CNStatus CNGeoJSONLayer::CreateField(const CNFieldDefn* field_defn, bool approx_ok) {
-    (void)field_defn;
     (void)approx_ok;
-    return CNStatus::kNotSupported;
+    if (!impl_->writer_) {
+        return CNStatus::kNotSupported;
+    }
+    if (!field_defn) {
+        return CNStatus::kNullPointer;
+    }
+    impl_->feature_defn_->AddFieldDefn(field_defn->Clone());
+    return CNStatus::kSuccess;
+}
+
+void CNGeoJSONLayer::SetSpatialFilterRect(
+    double min_x, double min_y,
+    double max_x, double max_y) {
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
 }
 
 void CNGeoJSONLayer::SetSpatialFilter(const CNGeometry* geometry) {
     if (geometry) {
         impl_->spatial_filter_.reset(geometry->Clone().release());
+        impl_->filter_extent_ = geometry->GetEnvelope();
     } else {
         impl_->spatial_filter_.reset();
+        impl_->filter_extent_ = Envelope();
+        impl_->filter_extent_.SetNull();
     }
 }
 
@@ -165,22 +400,37 @@ CNStatus CNGeoJSONLayer::SetAttributeFilter(const std::string& query) {
 bool CNGeoJSONLayer::TestCapability(CNLayerCapability capability) const {
     switch (capability) {
         case CNLayerCapability::kRandomRead:
+            return impl_->is_read_only_;
         case CNLayerCapability::kFastFeatureCount:
+            return impl_->index_built_ || !impl_->is_read_only_;
         case CNLayerCapability::kFastGetExtent:
-            return true;
+            return impl_->extent_loaded_;
         case CNLayerCapability::kSequentialWrite:
-        case CNLayerCapability::kRandomWrite:
         case CNLayerCapability::kCreateFeature:
-        case CNLayerCapability::kDeleteFeature:
-        case CNLayerCapability::kTransactions:
             return !impl_->is_read_only_;
         default:
             return false;
     }
 }
 
+CNStatus CNGeoJSONLayer::SyncToDisk() {
+    if (impl_->writer_ && !impl_->writer_->Flush()) {
+        return CNStatus::kIOError;
+    }
+    return CNStatus::kSuccess;
+}
+
 std::unique_ptr<CNLayer> CNGeoJSONLayer::Clone() const {
-    return nullptr;
+    if (impl_->writer_) {
+        return nullptr;
+    }
+    std::unique_ptr<CNVectorLayer> layer = Open(impl_->path_);
+    if (!layer) {
+        return nullptr;
+    }
+    layer->SetSpatialFilter(impl_->spatial_filter_.get());
+    layer->SetAttributeFilter(impl_->attribute_filter_);
+    return std::unique_ptr<CNLayer>(layer.release());
 }
 
 } // namespace ogc
@@ -0,0 +1,1762 @@
+#include "ogc/layer/geojson_stream.h"
+#include "mapped_file.h"
+
+#include "ogc/feature/feature.h"
+#include "ogc/feature/feature_defn.h"
+#include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/geometrycollection.h"
+#include "ogc/geom/linearring.h"
+#include "ogc/geom/linestring.h"
+#include "ogc/geom/multilinestring.h"
+#include "ogc/geom/multipoint.h"
+#include "ogc/geom/multipolygon.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/polygon.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OGC_GEOJSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace ogc {
+
+namespace {
+
+const int kMaxGeometryDepth = 32;
+
+const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#ifdef OGC_GEOJSON_SSE2
+inline unsigned CountTrailingZeros(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline __m128i Load16(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+#endif
+
+const char* SkipWhitespace(const char* p, const char* end) {
+    if (p < end && !IsSpace(*p)) {
+        return p;
+    }
+#ifdef OGC_GEOJSON_SSE2
+    // Indented documents spend most bytes here, so test 16 at a time.
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while (end - p >= 16) {
+        __m128i v = Load16(p);
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, carriage), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xFFFFu;
+        if (mask != 0) {
+            return p + CountTrailingZeros(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && IsSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* FindQuoteOrBackslash(const char* p, const char* end) {
+#ifdef OGC_GEOJSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (end - p >= 16) {
+        __m128i v = Load16(p);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash))));
+        if (mask != 0) {
+            return p + CountTrailingZeros(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\') {
+        ++p;
+    }
+    return p;
+}
+
+// Finds the next '"', '[', ']', '{' or '}'. Clearing bit 5 folds the
+// braces onto the brackets, so three compares cover all five.
+const char* FindStructural(const char* p, const char* end) {
+#ifdef OGC_GEOJSON_SSE2
+    const __m128i fold = _mm_set1_epi8(static_cast<char>(0xDF));
+    const __m128i open = _mm_set1_epi8('[');
+    const __m128i close = _mm_set1_epi8(']');
+    const __m128i quote = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        __m128i v = Load16(p);
+        __m128i folded = _mm_and_si128(v, fold);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+            _mm_cmpeq_epi8(v, quote));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return p + CountTrailingZeros(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        char c = *p;
+        if (c == '"' || c == '[' || c == ']' || c == '{' || c == '}') {
+            return p;
+        }
+        ++p;
+    }
+    return p;
+}
+
+struct Span {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool escaped = false;
+
+    bool Equals(const char* literal) const {
+        size_t n = std::strlen(literal);
+        return !escaped && n == size && std::memcmp(data, literal, n) == 0;
+    }
+};
+
+// p is on the opening quote; on success it is left past the closing one.
+bool ScanString(const char*& p, const char* end, Span& span) {
+    const char* begin = p + 1;
+    const char* q = begin;
+    span.escaped = false;
+    for (;;) {
+        q = FindQuoteOrBackslash(q, end);
+        if (q >= end) {
+            return false;
+        }
+        if (*q == '"') {
+            break;
+        }
+        span.escaped = true;
+        q += 2;
+    }
+    span.data = begin;
+    span.size = static_cast<size_t>(q - begin);
+    p = q + 1;
+    return true;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool ReadHex4(const char* p, const char* end, unsigned& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        int digit = HexValue(p[i]);
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | static_cast<unsigned>(digit);
+    }
+    return true;
+}
+
+void AppendUtf8(std::string& out, unsigned cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool DecodeString(const Span& span, std::string& out) {
+    if (!span.escaped) {
+        out.assign(span.data, span.size);
+        return true;
+    }
+    out.clear();
+    const char* p = span.data;
+    const char* end = span.data + span.size;
+    while (p < end) {
+        const char* run = p;
+        while (p < end && *p != '\\') {
+            ++p;
+        }
+        out.append(run, static_cast<size_t>(p - run));
+        if (p >= end) {
+            break;
+        }
+        if (++p >= end) {
+            return false;
+        }
+        char c = *p++;
+        switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (!ReadHex4(p, end, cp)) {
+                    return false;
+                }
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    unsigned low;
+                    if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                        ReadHex4(p + 2, end, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+struct Number {
+    double value = 0.0;
+    int64_t integer = 0;
+    bool is_integer = false;
+};
+
+// Parses a JSON number in place. Up to 19 significant digits are
+// accumulated into an integer mantissa; when it and the decimal exponent
+// are small enough the result is a single correctly rounded multiply or
+// divide, otherwise strtod sees the original text.
+bool ParseNumber(const char*& p, const char* end, Number& out) {
+    const char* start = p;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    if (p >= end || !IsDigit(*p)) {
+        return false;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool is_integer = true;
+
+    if (*p == '0') {
+        ++p;
+    } else {
+        while (p < end && IsDigit(*p)) {
+            int d = *p - '0';
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(d);
+                ++digits;
+            } else {
+                ++exponent;
+                truncated = truncated || d != 0;
+            }
+            ++p;
+        }
+    }
+    if (p < end && *p == '.') {
+        is_integer = false;
+        ++p;
+        if (p >= end || !IsDigit(*p)) {
+            return false;
+        }
+        while (p < end && IsDigit(*p)) {
+            int d = *p - '0';
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(d);
+                if (mantissa != 0) {
+                    ++digits;
+                }
+                --exponent;
+            } else {
+                truncated = truncated || d != 0;
+            }
+            ++p;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        is_integer = false;
+        ++p;
+        bool exp_negative = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            exp_negative = *p == '-';
+            ++p;
+        }
+        if (p >= end || !IsDigit(*p)) {
+            return false;
+        }
+        int exp_value = 0;
+        while (p < end && IsDigit(*p)) {
+            if (exp_value < 100000) {
+                exp_value = exp_value * 10 + (*p - '0');
+            }
+            ++p;
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    out.is_integer = is_integer && !truncated &&
+        mantissa <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    if (out.is_integer) {
+        out.integer = negative ? -static_cast<int64_t>(mantissa)
+                               : static_cast<int64_t>(mantissa);
+    }
+
+    if (!truncated && mantissa <= (uint64_t(1) << 53) &&
+        exponent >= -22 && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+        out.value = negative ? -value : value;
+        return true;
+    }
+
+    char local[64];
+    size_t length = static_cast<size_t>(p - start);
+    if (length < sizeof(local)) {
+        std::memcpy(local, start, length);
+        local[length] = '\0';
+        out.value = std::strtod(local, nullptr);
+    } else {
+        std::string text(start, length);
+        out.value = std::strtod(text.c_str(), nullptr);
+    }
+    return true;
+}
+
+bool MatchLiteral(const char*& p, const char* end, const char* literal) {
+    size_t n = std::strlen(literal);
+    if (static_cast<size_t>(end - p) < n || std::memcmp(p, literal, n) != 0) {
+        return false;
+    }
+    p += n;
+    return true;
+}
+
+bool SkipContainer(const char*& p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        p = FindStructural(p, end);
+        if (p >= end) {
+            return false;
+        }
+        char c = *p;
+        if (c == '"') {
+            Span span;
+            if (!ScanString(p, end, span)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '[' || c == '{') {
+            ++depth;
+        } else if (--depth == 0) {
+            ++p;
+            return true;
+        }
+        ++p;
+    }
+    return false;
+}
+
+bool SkipValue(const char*& p, const char* end) {
+    p = SkipWhitespace(p, end);
+    if (p >= end) {
+        return false;
+    }
+    switch (*p) {
+        case '"': {
+            Span span;
+            return ScanString(p, end, span);
+        }
+        case '{':
+        case '[':
+            return SkipContainer(p, end);
+        case 't':
+            return MatchLiteral(p, end, "true");
+        case 'f':
+            return MatchLiteral(p, end, "false");
+        case 'n':
+            return MatchLiteral(p, end, "null");
+        default: {
+            Number number;
+            return ParseNumber(p, end, number);
+        }
+    }
+}
+
+bool IsNull(const char*& p, const char* end) {
+    p = SkipWhitespace(p, end);
+    return p < end && *p == 'n' && MatchLiteral(p, end, "null");
+}
+
+// Object and array iteration. Each returns 1 with p on the next member
+// value or element, 0 past the closing delimiter, and -1 on a syntax error.
+bool BeginContainer(const char*& p, const char* end, char open) {
+    p = SkipWhitespace(p, end);
+    if (p >= end || *p != open) {
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+int NextItem(const char*& p, const char* end, char close, bool& first) {
+    p = SkipWhitespace(p, end);
+    if (p >= end) {
+        return -1;
+    }
+    if (*p == close) {
+        ++p;
+        return 0;
+    }
+    if (!first) {
+        if (*p != ',') {
+            return -1;
+        }
+        p = SkipWhitespace(p + 1, end);
+        if (p >= end) {
+            return -1;
+        }
+    }
+    first = false;
+    return 1;
+}
+
+int NextMember(const char*& p, const char* end, bool& first, Span& key) {
+    int result = NextItem(p, end, '}', first);
+    if (result <= 0) {
+        return result;
+    }
+    if (*p != '"' || !ScanString(p, end, key)) {
+        return -1;
+    }
+    p = SkipWhitespace(p, end);
+    if (p >= end || *p != ':') {
+        return -1;
+    }
+    p = SkipWhitespace(p + 1, end);
+    return 1;
+}
+
+GeomType ParseGeomTypeName(const Span& name) {
+    if (name.Equals("Point")) return GeomType::kPoint;
+    if (name.Equals("LineString")) return GeomType::kLineString;
+    if (name.Equals("Polygon")) return GeomType::kPolygon;
+    if (name.Equals("MultiPoint")) return GeomType::kMultiPoint;
+    if (name.Equals("MultiLineString")) return GeomType::kMultiLineString;
+    if (name.Equals("MultiPolygon")) return GeomType::kMultiPolygon;
+    if (name.Equals("GeometryCollection")) return GeomType::kGeometryCollection;
+    return GeomType::kUnknown;
+}
+
+bool ParsePosition(const char*& p, const char* end, Coordinate& coord) {
+    if (!BeginContainer(p, end, '[')) {
+        return false;
+    }
+    double values[3];
+    int count = 0;
+    bool first = true;
+    int result;
+    while ((result = NextItem(p, end, ']', first)) > 0) {
+        Number number;
+        if (!ParseNumber(p, end, number)) {
+            return false;
+        }
+        if (count < 3) {
+            values[count] = number.value;
+        }
+        ++count;
+    }
+    if (result < 0 || count < 2) {
+        return false;
+    }
+    coord = count >= 3 ? Coordinate(values[0], values[1], values[2])
+                       : Coordinate(values[0], values[1]);
+    return true;
+}
+
+bool ParsePositions(const char*& p, const char* end, CoordinateList& coords) {
+    if (!BeginContainer(p, end, '[')) {
+        return false;
+    }
+    bool first = true;
+    int result;
+    while ((result = NextItem(p, end, ']', first)) > 0) {
+        Coordinate coord;
+        if (!ParsePosition(p, end, coord)) {
+            return false;
+        }
+        coords.push_back(coord);
+    }
+    return result == 0;
+}
+
+bool ParsePolygonRings(const char*& p, const char* end, PolygonPtr& polygon) {
+    if (!BeginContainer(p, end, '[')) {
+        return false;
+    }
+    polygon = Polygon::Create();
+    bool first = true;
+    bool exterior = true;
+    int result;
+    while ((result = NextItem(p, end, ']', first)) > 0) {
+        CoordinateList coords;
+        if (!ParsePositions(p, end, coords)) {
+            return false;
+        }
+        LinearRingPtr ring = LinearRing::Create(coords, false);
+        if (exterior) {
+            polygon = Polygon::Create(std::move(ring));
+            exterior = false;
+        } else {
+            polygon->AddInteriorRing(std::move(ring));
+        }
+    }
+    return result == 0;
+}
+
+bool ParseGeometryObject(const char*& p, const char* end, int depth, GeometryPtr& out);
+
+bool ParseCoordinates(const char*& p, const char* end, GeomType type, GeometryPtr& out) {
+    switch (type) {
+        case GeomType::kPoint: {
+            const char* q = p;
+            bool first = true;
+            if (BeginContainer(q, end, '[') && NextItem(q, end, ']', first) == 0) {
+                p = q;
+                out = Point::Create(Coordinate());
+                return true;
+            }
+            Coordinate coord;
+            if (!ParsePosition(p, end, coord)) {
+                return false;
+            }
+            out = Point::Create(coord);
+            return true;
+        }
+        case GeomType::kLineString: {
+            CoordinateList coords;
+            if (!ParsePositions(p, end, coords)) {
+                return false;
+            }
+            out = LineString::Create(std::move(coords));
+            return true;
+        }
+        case GeomType::kMultiPoint: {
+            CoordinateList coords;
+            if (!ParsePositions(p, end, coords)) {
+                return false;
+            }
+            out = MultiPoint::Create(coords);
+            return true;
+        }
+        case GeomType::kPolygon: {
+            PolygonPtr polygon;
+            if (!ParsePolygonRings(p, end, polygon)) {
+                return false;
+            }
+            out = std::move(polygon);
+            return true;
+        }
+        case GeomType::kMultiLineString: {
+            if (!BeginContainer(p, end, '[')) {
+                return false;
+            }
+            MultiLineStringPtr multi = MultiLineString::Create();
+            bool first = true;
+            int result;
+            while ((result = NextItem(p, end, ']', first)) > 0) {
+                CoordinateList coords;
+                if (!ParsePositions(p, end, coords)) {
+                    return false;
+                }
+                multi->AddLineString(LineString::Create(std::move(coords)));
+            }
+            out = std::move(multi);
+            return result == 0;
+        }
+        case GeomType::kMultiPolygon: {
+            if (!BeginContainer(p, end, '[')) {
+                return false;
+            }
+            MultiPolygonPtr multi = MultiPolygon::Create();
+            bool first = true;
+            int result;
+            while ((result = NextItem(p, end, ']', first)) > 0) {
+                PolygonPtr polygon;
+                if (!ParsePolygonRings(p, end, polygon)) {
+                    return false;
+                }
+                multi->AddPolygon(std::move(polygon));
+            }
+            out = std::move(multi);
+            return result == 0;
+        }
+        default:
+            return false;
+    }
+}
+
+bool ParseGeometries(const char*& p, const char* end, int depth, GeometryPtr& out) {
+    if (!BeginContainer(p, end, '[')) {
+        return false;
+    }
+    GeometryCollectionPtr collection = GeometryCollection::Create();
+    bool first = true;
+    int result;
+    while ((result = NextItem(p, end, ']', first)) > 0) {
+        GeometryPtr part;
+        if (!ParseGeometryObject(p, end, depth + 1, part)) {
+            return false;
+        }
+        if (part) {
+            collection->AddGeometry(std::move(part));
+        }
+    }
+    out = std::move(collection);
+    return result == 0;
+}
+
+// Members may come in any order; when "coordinates" or "geometries"
+// precedes "type" its position is remembered and parsed afterwards.
+bool ParseGeometryObject(const char*& p, const char* end, int depth, GeometryPtr& out) {
+    out.reset();
+    if (IsNull(p, end)) {
+        return true;
+    }
+    if (depth > kMaxGeometryDepth || !BeginContainer(p, end, '{')) {
+        return false;
+    }
+    GeomType type = GeomType::kUnknown;
+    const char* deferred = nullptr;
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end, first, key)) > 0) {
+        if (key.Equals("type")) {
+            Span name;
+            if (*p != '"' || !ScanString(p, end, name)) {
+                return false;
+            }
+            type = ParseGeomTypeName(name);
+            if (type == GeomType::kUnknown) {
+                return false;
+            }
+        } else if (key.Equals("coordinates") || key.Equals("geometries")) {
+            bool collection = key.Equals("geometries");
+            if (type == GeomType::kUnknown) {
+                deferred = p;
+                if (!SkipValue(p, end)) {
+                    return false;
+                }
+            } else if ((type == GeomType::kGeometryCollection) == collection) {
+                bool ok = collection ? ParseGeometries(p, end, depth, out)
+                                     : ParseCoordinates(p, end, type, out);
+                if (!ok) {
+                    return false;
+                }
+            } else if (!SkipValue(p, end)) {
+                return false;
+            }
+        } else if (!SkipValue(p, end)) {
+            return false;
+        }
+    }
+    if (result < 0 || type == GeomType::kUnknown) {
+        return false;
+    }
+    if (!out && deferred) {
+        const char* q = deferred;
+        bool ok = type == GeomType::kGeometryCollection
+            ? ParseGeometries(q, end, depth, out)
+            : ParseCoordinates(q, end, type, out);
+        if (!ok) {
+            return false;
+        }
+    }
+    return out != nullptr;
+}
+
+// Reads only the "type" member of a geometry for schema inference.
+bool PeekGeometryType(const char*& p, const char* end, GeomType& type) {
+    type = GeomType::kUnknown;
+    if (IsNull(p, end)) {
+        return true;
+    }
+    if (!BeginContainer(p, end, '{')) {
+        return false;
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end, first, key)) > 0) {
+        if (key.Equals("type") && *p == '"') {
+            Span name;
+            if (!ScanString(p, end, name)) {
+                return false;
+            }
+            type = ParseGeomTypeName(name);
+        } else if (!SkipValue(p, end)) {
+            return false;
+        }
+    }
+    return result == 0;
+}
+
+// Inferred property kinds, ordered so that numeric kinds widen by max().
+enum class ValueKind { kNone, kInteger, kInteger64, kReal, kBoolean, kString };
+
+ValueKind MergeKinds(ValueKind a, ValueKind b) {
+    if (a == ValueKind::kNone || a == b) return b;
+    if (b == ValueKind::kNone) return a;
+    bool a_numeric = a <= ValueKind::kReal;
+    bool b_numeric = b <= ValueKind::kReal;
+    if (a_numeric && b_numeric) {
+        return a > b ? a : b;
+    }
+    return ValueKind::kString;
+}
+
+CNFieldType ToFieldType(ValueKind kind) {
+    switch (kind) {
+        case ValueKind::kInteger: return CNFieldType::kInteger;
+        case ValueKind::kInteger64: return CNFieldType::kInteger64;
+        case ValueKind::kReal: return CNFieldType::kReal;
+        case ValueKind::kBoolean: return CNFieldType::kBoolean;
+        default: return CNFieldType::kString;
+    }
+}
+
+bool ClassifyValue(const char*& p, const char* end, ValueKind& kind) {
+    p = SkipWhitespace(p, end);
+    if (p >= end) {
+        return false;
+    }
+    switch (*p) {
+        case 'n':
+            kind = ValueKind::kNone;
+            return MatchLiteral(p, end, "null");
+        case 't':
+            kind = ValueKind::kBoolean;
+            return MatchLiteral(p, end, "true");
+        case 'f':
+            kind = ValueKind::kBoolean;
+            return MatchLiteral(p, end, "false");
+        case '"':
+        case '{':
+        case '[':
+            kind = ValueKind::kString;
+            return SkipValue(p, end);
+        default: {
+            Number number;
+            if (!ParseNumber(p, end, number)) {
+                return false;
+            }
+            if (!number.is_integer) {
+                kind = ValueKind::kReal;
+            } else if (number.integer >= std::numeric_limits<int32_t>::min() &&
+                       number.integer <= std::numeric_limits<int32_t>::max()) {
+                kind = ValueKind::kInteger;
+            } else {
+                kind = ValueKind::kInteger64;
+            }
+            return true;
+        }
+    }
+}
+
+std::vector<uint8_t> DecodeHex(const std::string& text) {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(text.size() / 2);
+    for (size_t i = 0; i + 1 < text.size(); i += 2) {
+        int high = HexValue(text[i]);
+        int low = HexValue(text[i + 1]);
+        if (high < 0 || low < 0) {
+            break;
+        }
+        bytes.push_back(static_cast<uint8_t>((high << 4) | low));
+    }
+    return bytes;
+}
+
+} // namespace
+
+class CNGeoJSONReader::Impl {
+public:
+    MappedFile file_;
+    const char* begin_ = nullptr;
+    const char* end_ = nullptr;
+    const char* features_begin_ = nullptr;
+    const char* pos_ = nullptr;
+    bool single_feature_ = false;
+    bool at_element_ = true;
+    bool done_ = false;
+    int64_t sequence_ = 0;
+    std::shared_ptr<CNFeatureDefn> defn_;
+    std::unordered_map<std::string, int> field_index_;
+    std::vector<CNFieldType> field_types_;
+    std::string key_;
+    std::string text_;
+    std::string id_;
+    std::string error_;
+
+    bool Locate();
+    const char* NextElement();
+    bool Fail(const char* message, const char* where);
+    bool ParseFeature(const char*& p, CNFeature* feature, bool* has_id);
+    bool SkipFeature(const char*& p, int64_t* fid, bool* has_id);
+    bool ParseProperties(const char*& p, CNFeature* feature);
+    bool ParseFieldValue(const char*& p, CNFeature* feature, int index);
+    bool ScanFeatureSchema(const char*& p, std::vector<std::string>& names,
+                           std::vector<ValueKind>& kinds,
+                           std::unordered_map<std::string, size_t>& seen,
+                           GeomType& geom_type, bool& mixed_geometry);
+};
+
+bool CNGeoJSONReader::Impl::Fail(const char* message, const char* where) {
+    error_ = message;
+    if (where) {
+        error_ += " at offset " + std::to_string(where - begin_);
+    }
+    done_ = true;
+    return false;
+}
+
+// Finds the top-level "features" array, or the document itself when it
+// is a single Feature. Members after "features" are never read.
+bool CNGeoJSONReader::Impl::Locate() {
+    const char* p = begin_;
+    if (end_ - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+    p = SkipWhitespace(p, end_);
+    const char* object = p;
+    if (!BeginContainer(p, end_, '{')) {
+        return Fail("expected a GeoJSON object", p);
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end_, first, key)) > 0) {
+        if (key.Equals("features")) {
+            if (!BeginContainer(p, end_, '[')) {
+                return Fail("\"features\" is not an array", p);
+            }
+            features_begin_ = p;
+            return true;
+        }
+        if (key.Equals("type") && *p == '"') {
+            Span name;
+            ScanString(p, end_, name);
+            if (name.Equals("Feature")) {
+                single_feature_ = true;
+                features_begin_ = object;
+                return true;
+            }
+        } else if (!SkipValue(p, end_)) {
+            return Fail("malformed value", p);
+        }
+    }
+    if (result < 0) {
+        return Fail("malformed object", p);
+    }
+    // A collection without "features" is empty.
+    features_begin_ = end_;
+    done_ = true;
+    return true;
+}
+
+const char* CNGeoJSONReader::Impl::NextElement() {
+    if (done_) {
+        return nullptr;
+    }
+    if (single_feature_) {
+        if (pos_ >= end_) {
+            done_ = true;
+            return nullptr;
+        }
+        at_element_ = false;
+        return SkipWhitespace(pos_, end_);
+    }
+    bool first = at_element_;
+    const char* p = pos_;
+    int result = NextItem(p, end_, ']', first);
+    if (result <= 0) {
+        if (result < 0) {
+            Fail("expected ',' or ']' in \"features\"", p);
+        }
+        done_ = true;
+        return nullptr;
+    }
+    at_element_ = false;
+    return p;
+}
+
+bool CNGeoJSONReader::Impl::ParseFeature(const char*& p, CNFeature* feature, bool* has_id) {
+    *has_id = false;
+    id_.clear();
+    if (!BeginContainer(p, end_, '{')) {
+        return Fail("expected a Feature object", p);
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end_, first, key)) > 0) {
+        if (key.Equals("geometry")) {
+            GeometryPtr geometry;
+            if (!ParseGeometryObject(p, end_, 0, geometry)) {
+                return Fail("malformed geometry", p);
+            }
+            if (geometry) {
+                feature->SetGeometry(std::move(geometry));
+            }
+        } else if (key.Equals("properties")) {
+            if (!ParseProperties(p, feature)) {
+                return false;
+            }
+        } else if (key.Equals("id") && (IsDigit(*p) || *p == '-')) {
+            const char* start = p;
+            Number number;
+            if (!ParseNumber(p, end_, number)) {
+                return Fail("malformed id", p);
+            }
+            id_.assign(start, static_cast<size_t>(p - start));
+            if (number.is_integer) {
+                feature->SetFID(number.integer);
+                *has_id = true;
+            }
+        } else if (key.Equals("id") && *p == '"') {
+            Span span;
+            if (!ScanString(p, end_, span) || !DecodeString(span, id_)) {
+                return Fail("malformed id", p);
+            }
+        } else if (!SkipValue(p, end_)) {
+            return Fail("malformed value", p);
+        }
+    }
+    if (result < 0) {
+        return Fail("malformed Feature object", p);
+    }
+    return true;
+}
+
+bool CNGeoJSONReader::Impl::SkipFeature(const char*& p, int64_t* fid, bool* has_id) {
+    *has_id = false;
+    if (!fid) {
+        if (*p != '{' || !SkipContainer(p, end_)) {
+            return Fail("expected a Feature object", p);
+        }
+        return true;
+    }
+    if (!BeginContainer(p, end_, '{')) {
+        return Fail("expected a Feature object", p);
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end_, first, key)) > 0) {
+        if (key.Equals("id") && (IsDigit(*p) || *p == '-')) {
+            Number number;
+            if (!ParseNumber(p, end_, number)) {
+                return Fail("malformed id", p);
+            }
+            if (number.is_integer) {
+                *fid = number.integer;
+                *has_id = true;
+            }
+        } else if (!SkipValue(p, end_)) {
+            return Fail("malformed value", p);
+        }
+    }
+    if (result < 0) {
+        return Fail("malformed Feature object", p);
+    }
+    return true;
+}
+
+bool CNGeoJSONReader::Impl::ParseProperties(const char*& p, CNFeature* feature) {
+    if (IsNull(p, end_)) {
+        return true;
+    }
+    if (!BeginContainer(p, end_, '{')) {
+        return Fail("\"properties\" is not an object", p);
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end_, first, key)) > 0) {
+        if (!DecodeString(key, key_)) {
+            return Fail("malformed property name", p);
+        }
+        auto it = field_index_.find(key_);
+        bool ok = it == field_index_.end() ? SkipValue(p, end_)
+                                           : ParseFieldValue(p, feature, it->second);
+        if (!ok) {
+            return Fail("malformed property value", p);
+        }
+    }
+    if (result < 0) {
+        return Fail("malformed properties object", p);
+    }
+    return true;
+}
+
+bool CNGeoJSONReader::Impl::ParseFieldValue(const char*& p, CNFeature* feature, int index) {
+    size_t i = static_cast<size_t>(index);
+    CNFieldType type = field_types_[i];
+    switch (*p) {
+        case 'n':
+            if (!MatchLiteral(p, end_, "null")) {
+                return false;
+            }
+            feature->SetFieldNull(i);
+            return true;
+        case 't':
+        case 'f': {
+            bool value = *p == 't';
+            if (!MatchLiteral(p, end_, value ? "true" : "false")) {
+                return false;
+            }
+            switch (type) {
+                case CNFieldType::kBoolean:
+                    feature->SetField(i, CNFieldValue(value));
+                    break;
+                case CNFieldType::kInteger:
+                    feature->SetFieldInteger(i, value ? 1 : 0);
+                    break;
+                case CNFieldType::kInteger64:
+                    feature->SetFieldInteger64(i, value ? 1 : 0);
+                    break;
+                case CNFieldType::kReal:
+                    feature->SetFieldReal(i, value ? 1.0 : 0.0);
+                    break;
+                default:
+                    feature->SetFieldString(i, value ? "true" : "false");
+                    break;
+            }
+            return true;
+        }
+        case '"': {
+            Span span;
+            if (!ScanString(p, end_, span) || !DecodeString(span, text_)) {
+                return false;
+            }
+            switch (type) {
+                case CNFieldType::kInteger:
+                    feature->SetFieldInteger(i, static_cast<int32_t>(std::strtol(text_.c_str(), nullptr, 10)));
+                    break;
+                case CNFieldType::kInteger64:
+                    feature->SetFieldInteger64(i, std::strtoll(text_.c_str(), nullptr, 10));
+                    break;
+                case CNFieldType::kReal:
+                    feature->SetFieldReal(i, std::strtod(text_.c_str(), nullptr));
+                    break;
+                case CNFieldType::kDate:
+                case CNFieldType::kTime:
+                case CNFieldType::kDateTime:
+                    feature->SetFieldDateTime(i, CNDateTime::FromISO8601(text_));
+                    break;
+                case CNFieldType::kBinary:
+                    feature->SetFieldBinary(i, DecodeHex(text_));
+                    break;
+                default:
+                    feature->SetFieldString(i, text_);
+                    break;
+            }
+            return true;
+        }
+        case '{':
+        case '[': {
+            // Nested values are kept as their JSON text.
+            const char* start = p;
+            if (!SkipContainer(p, end_)) {
+                return false;
+            }
+            if (type == CNFieldType::kString) {
+                text_.assign(start, static_cast<size_t>(p - start));
+                feature->SetFieldString(i, text_);
+            }
+            return true;
+        }
+        default: {
+            const char* start = p;
+            Number number;
+            if (!ParseNumber(p, end_, number)) {
+                return false;
+            }
+            switch (type) {
+                case CNFieldType::kInteger:
+                    feature->SetFieldInteger(i, number.is_integer
+                        ? static_cast<int32_t>(number.integer)
+                        : static_cast<int32_t>(number.value));
+                    break;
+                case CNFieldType::kInteger64:
+                    feature->SetFieldInteger64(i, number.is_integer
+                        ? number.integer
+                        : static_cast<int64_t>(number.value));
+                    break;
+                case CNFieldType::kBoolean:
+                    feature->SetField(i, CNFieldValue(number.value != 0.0));
+                    break;
+                case CNFieldType::kString:
+                    text_.assign(start, static_cast<size_t>(p - start));
+                    feature->SetFieldString(i, text_);
+                    break;
+                default:
+                    feature->SetFieldReal(i, number.value);
+                    break;
+            }
+            return true;
+        }
+    }
+}
+
+bool CNGeoJSONReader::Impl::ScanFeatureSchema(
+    const char*& p, std::vector<std::string>& names, std::vector<ValueKind>& kinds,
+    std::unordered_map<std::string, size_t>& seen, GeomType& geom_type,
+    bool& mixed_geometry) {
+    if (!BeginContainer(p, end_, '{')) {
+        return Fail("expected a Feature object", p);
+    }
+    bool first = true;
+    Span key;
+    int result;
+    while ((result = NextMember(p, end_, first, key)) > 0) {
+        if (key.Equals("geometry")) {
+            GeomType type;
+            if (!PeekGeometryType(p, end_, type)) {
+                return Fail("malformed geometry", p);
+            }
+            if (type != GeomType::kUnknown) {
+                if (geom_type == GeomType::kUnknown && !mixed_geometry) {
+                    geom_type = type;
+                } else if (geom_type != type) {
+                    geom_type = GeomType::kUnknown;
+                    mixed_geometry = true;
+                }
+            }
+        } else if (key.Equals("properties")) {
+            if (IsNull(p, end_)) {
+                continue;
+            }
+            if (!BeginContainer(p, end_, '{')) {
+                return Fail("\"properties\" is not an object", p);
+            }
+            bool first_property = true;
+            Span name;
+            int property;
+            while ((property = NextMember(p, end_, first_property, name)) > 0) {
+                ValueKind kind = ValueKind::kNone;
+                if (!DecodeString(name, key_) || !ClassifyValue(p, end_, kind)) {
+                    return Fail("malformed property", p);
+                }
+                auto it = seen.find(key_);
+                if (it == seen.end()) {
+                    seen.emplace(key_, names.size());
+                    names.push_back(key_);
+                    kinds.push_back(kind);
+                } else {
+                    kinds[it->second] = MergeKinds(kinds[it->second], kind);
+                }
+            }
+            if (property < 0) {
+                return Fail("malformed properties object", p);
+            }
+        } else if (!SkipValue(p, end_)) {
+            return Fail("malformed value", p);
+        }
+    }
+    if (result < 0) {
+        return Fail("malformed Feature object", p);
+    }
+    return true;
+}
+
+CNGeoJSONReader::CNGeoJSONReader()
+    : impl_(new Impl()) {
+}
+
+CNGeoJSONReader::~CNGeoJSONReader() = default;
+
+bool CNGeoJSONReader::Open(const std::string& path) {
+    Close();
+    if (!impl_->file_.Open(path)) {
+        impl_->error_ = "cannot map " + path;
+        return false;
+    }
+    const char* data = reinterpret_cast<const char*>(impl_->file_.Data());
+    return OpenBuffer(data, impl_->file_.Size());
+}
+
+bool CNGeoJSONReader::OpenBuffer(const char* data, size_t size) {
+    Impl& impl = *impl_;
+    if (impl.file_.IsOpen() && reinterpret_cast<const char*>(impl.file_.Data()) != data) {
+        impl.file_.Close();
+    }
+    impl.begin_ = data;
+    impl.end_ = data + size;
+    impl.single_feature_ = false;
+    impl.done_ = false;
+    impl.error_.clear();
+    if (!data || !impl.Locate()) {
+        if (!data) {
+            impl.error_ = "no data";
+        }
+        impl.begin_ = impl.end_ = nullptr;
+        impl.file_.Close();
+        return false;
+    }
+    Rewind();
+    return true;
+}
+
+void CNGeoJSONReader::Close() {
+    impl_->file_.Close();
+    impl_->begin_ = impl_->end_ = nullptr;
+    impl_->features_begin_ = impl_->pos_ = nullptr;
+    impl_->done_ = true;
+}
+
+bool CNGeoJSONReader::IsOpen() const {
+    return impl_->begin_ != nullptr;
+}
+
+CNFeatureDefn* CNGeoJSONReader::BuildFeatureDefn(const std::string& name, size_t sample_size) {
+    Impl& impl = *impl_;
+    if (!IsOpen()) {
+        return nullptr;
+    }
+    std::vector<std::string> names;
+    std::vector<ValueKind> kinds;
+    std::unordered_map<std::string, size_t> seen;
+    GeomType geom_type = GeomType::kUnknown;
+    bool mixed_geometry = false;
+
+    Rewind();
+    for (size_t n = 0; sample_size == 0 || n < sample_size; ++n) {
+        const char* p = impl.NextElement();
+        if (!p) {
+            break;
+        }
+        if (!impl.ScanFeatureSchema(p, names, kinds, seen, geom_type, mixed_geometry)) {
+            return nullptr;
+        }
+        impl.pos_ = p;
+        if (impl.single_feature_) {
+            impl.done_ = true;
+        }
+    }
+    if (impl.error_.size() > 0) {
+        return nullptr;
+    }
+    Rewind();
+
+    CNFeatureDefn* defn = CNFeatureDefn::Create(name.c_str());
+    for (size_t i = 0; i < names.size(); ++i) {
+        CNFieldDefn* field = CreateCNFieldDefn(names[i].c_str());
+        field->SetType(ToFieldType(kinds[i]));
+        defn->AddFieldDefn(field);
+    }
+    CNGeomFieldDefn* geom_field = CreateCNGeomFieldDefn("geom");
+    geom_field->SetGeomType(geom_type);
+    defn->AddGeomFieldDefn(geom_field);
+    SetFeatureDefn(defn);
+    return defn;
+}
+
+void CNGeoJSONReader::SetFeatureDefn(CNFeatureDefn* defn) {
+    Impl& impl = *impl_;
+    impl.field_index_.clear();
+    impl.field_types_.clear();
+    if (!defn) {
+        impl.defn_.reset();
+        return;
+    }
+    defn->AddReference();
+    impl.defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+    for (size_t i = 0; i < defn->GetFieldCount(); ++i) {
+        const CNFieldDefn* field = defn->GetFieldDefn(i);
+        impl.field_index_.emplace(field->GetName(), static_cast<int>(i));
+        impl.field_types_.push_back(field->GetType());
+    }
+}
+
+void CNGeoJSONReader::Rewind() {
+    Impl& impl = *impl_;
+    impl.pos_ = impl.features_begin_;
+    impl.at_element_ = true;
+    impl.done_ = !IsOpen() || impl.features_begin_ >= impl.end_;
+    impl.sequence_ = 0;
+    impl.error_.clear();
+}
+
+std::unique_ptr<CNFeature> CNGeoJSONReader::ReadNextFeature() {
+    Impl& impl = *impl_;
+    const char* p = impl.NextElement();
+    if (!p) {
+        return nullptr;
+    }
+    std::unique_ptr<CNFeature> feature(new CNFeature(impl.defn_.get()));
+    bool has_id;
+    if (!impl.ParseFeature(p, feature.get(), &has_id)) {
+        return nullptr;
+    }
+    if (!has_id) {
+        feature->SetFID(impl.sequence_);
+    }
+    impl.pos_ = p;
+    ++impl.sequence_;
+    if (impl.single_feature_) {
+        impl.done_ = true;
+    }
+    return feature;
+}
+
+bool CNGeoJSONReader::SkipNextFeature(int64_t* fid) {
+    Impl& impl = *impl_;
+    const char* p = impl.NextElement();
+    if (!p) {
+        return false;
+    }
+    bool has_id;
+    if (!impl.SkipFeature(p, fid, &has_id)) {
+        return false;
+    }
+    if (fid && !has_id) {
+        *fid = impl.sequence_;
+    }
+    impl.pos_ = p;
+    ++impl.sequence_;
+    if (impl.single_feature_) {
+        impl.done_ = true;
+    }
+    return true;
+}
+
+size_t CNGeoJSONReader::Tell() {
+    Impl& impl = *impl_;
+    if (!IsOpen()) {
+        return 0;
+    }
+    if (impl.done_) {
+        return static_cast<size_t>(impl.end_ - impl.begin_);
+    }
+    if (!impl.at_element_) {
+        // Step over the separator so the offset names the element itself.
+        const char* p = impl.NextElement();
+        if (!p) {
+            return static_cast<size_t>(impl.end_ - impl.begin_);
+        }
+        impl.pos_ = p;
+        impl.at_element_ = true;
+    }
+    return static_cast<size_t>(impl.pos_ - impl.begin_);
+}
+
+bool CNGeoJSONReader::Seek(size_t offset, int64_t sequence) {
+    Impl& impl = *impl_;
+    if (!IsOpen() || offset > static_cast<size_t>(impl.end_ - impl.begin_)) {
+        return false;
+    }
+    impl.pos_ = impl.begin_ + offset;
+    impl.at_element_ = true;
+    impl.done_ = impl.pos_ >= impl.end_;
+    impl.sequence_ = sequence;
+    impl.error_.clear();
+    return true;
+}
+
+int64_t CNGeoJSONReader::GetSequence() const {
+    return impl_->sequence_;
+}
+
+const std::string& CNGeoJSONReader::GetFeatureId() const {
+    return impl_->id_;
+}
+
+bool CNGeoJSONReader::HasError() const {
+    return !impl_->error_.empty();
+}
+
+const std::string& CNGeoJSONReader::GetError() const {
+    return impl_->error_;
+}
+
+class CNGeoJSONWriter::Impl {
+public:
+    FILE* file_ = nullptr;
+    std::string buffer_;
+    int precision_ = 15;
+    int64_t count_ = 0;
+    bool failed_ = false;
+
+    void AppendDouble(double value);
+    void AppendString(const std::string& value);
+    void AppendPosition(const Coordinate& coord);
+    void AppendPositions(const Geometry* geometry);
+    void AppendRings(const Polygon* polygon);
+    void AppendGeometry(const Geometry* geometry, int depth);
+    void AppendField(const CNFeature& feature, size_t index, CNFieldType type);
+};
+
+void CNGeoJSONWriter::Impl::AppendDouble(double value) {
+    if (!std::isfinite(value)) {
+        buffer_ += "null";
+        return;
+    }
+    char text[40];
+    int length;
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        length = std::snprintf(text, sizeof(text), "%lld", static_cast<long long>(value));
+    } else {
+        length = std::snprintf(text, sizeof(text), "%.*g", precision_, value);
+    }
+    buffer_.append(text, static_cast<size_t>(length));
+}
+
+void CNGeoJSONWriter::Impl::AppendString(const std::string& value) {
+    static const char kHex[] = "0123456789abcdef";
+    buffer_ += '"';
+    const char* p = value.data();
+    const char* end = p + value.size();
+    while (p < end) {
+        const char* run = p;
+        while (p < end && static_cast<unsigned char>(*p) >= 0x20 && *p != '"' && *p != '\\') {
+            ++p;
+        }
+        buffer_.append(run, static_cast<size_t>(p - run));
+        if (p >= end) {
+            break;
+        }
+        char c = *p++;
+        switch (c) {
+            case '"': buffer_ += "\\\""; break;
+            case '\\': buffer_ += "\\\\"; break;
+            case '\n': buffer_ += "\\n"; break;
+            case '\r': buffer_ += "\\r"; break;
+            case '\t': buffer_ += "\\t"; break;
+            default:
+                buffer_ += "\\u00";
+                buffer_ += kHex[(c >> 4) & 0xF];
+                buffer_ += kHex[c & 0xF];
+                break;
+        }
+    }
+    buffer_ += '"';
+}
+
+void CNGeoJSONWriter::Impl::AppendPosition(const Coordinate& coord) {
+    buffer_ += '[';
+    AppendDouble(coord.x);
+    buffer_ += ',';
+    AppendDouble(coord.y);
+    if (coord.Is3D()) {
+        buffer_ += ',';
+        AppendDouble(coord.z);
+    }
+    buffer_ += ']';
+}
+
+void CNGeoJSONWriter::Impl::AppendPositions(const Geometry* geometry) {
+    buffer_ += '[';
+    size_t count = geometry ? geometry->GetNumCoordinates() : 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            buffer_ += ',';
+        }
+        AppendPosition(geometry->GetCoordinateN(i));
+    }
+    buffer_ += ']';
+}
+
+void CNGeoJSONWriter::Impl::AppendRings(const Polygon* polygon) {
+    buffer_ += '[';
+    if (!polygon->IsEmpty()) {
+        AppendPositions(polygon->GetExteriorRing());
+        for (size_t i = 0; i < polygon->GetNumInteriorRings(); ++i) {
+            buffer_ += ',';
+            AppendPositions(polygon->GetInteriorRingN(i));
+        }
+    }
+    buffer_ += ']';
+}
+
+void CNGeoJSONWriter::Impl::AppendGeometry(const Geometry* geometry, int depth) {
+    if (!geometry || depth > kMaxGeometryDepth) {
+        buffer_ += "null";
+        return;
+    }
+    size_t parts = geometry->GetNumGeometries();
+    switch (geometry->GetGeometryType()) {
+        case GeomType::kPoint:
+            buffer_ += "{\"type\":\"Point\",\"coordinates\":";
+            if (geometry->IsEmpty()) {
+                buffer_ += "[]";
+            } else {
+                AppendPosition(geometry->GetCoordinateN(0));
+            }
+            break;
+        case GeomType::kLineString:
+            buffer_ += "{\"type\":\"LineString\",\"coordinates\":";
+            AppendPositions(geometry);
+            break;
+        case GeomType::kPolygon:
+            buffer_ += "{\"type\":\"Polygon\",\"coordinates\":";
+            AppendRings(static_cast<const Polygon*>(geometry));
+            break;
+        case GeomType::kMultiPoint:
+            buffer_ += "{\"type\":\"MultiPoint\",\"coordinates\":";
+            AppendPositions(geometry);
+            break;
+        case GeomType::kMultiLineString:
+            buffer_ += "{\"type\":\"MultiLineString\",\"coordinates\":[";
+            for (size_t i = 0; i < parts; ++i) {
+                if (i > 0) {
+                    buffer_ += ',';
+                }
+                AppendPositions(geometry->GetGeometryN(i));
+            }
+            buffer_ += ']';
+            break;
+        case GeomType::kMultiPolygon:
+            buffer_ += "{\"type\":\"MultiPolygon\",\"coordinates\":[";
+            for (size_t i = 0; i < parts; ++i) {
+                if (i > 0) {
+                    buffer_ += ',';
+                }
+                AppendRings(static_cast<const Polygon*>(geometry->GetGeometryN(i)));
+            }
+            buffer_ += ']';
+            break;
+        case GeomType::kGeometryCollection:
+            buffer_ += "{\"type\":\"GeometryCollection\",\"geometries\":[";
+            for (size_t i = 0; i < parts; ++i) {
+                if (i > 0) {
+                    buffer_ += ',';
+                }
+                AppendGeometry(geometry->GetGeometryN(i), depth + 1);
+            }
+            buffer_ += ']';
+            break;
+        default:
+            buffer_ += "null";
+            return;
+    }
+    buffer_ += '}';
+}
+
+void CNGeoJSONWriter::Impl::AppendField(const CNFeature& feature, size_t index,
+                                        CNFieldType type) {
+    if (feature.IsFieldNull(index)) {
+        buffer_ += "null";
+        return;
+    }
+    switch (type) {
+        case CNFieldType::kInteger:
+            buffer_ += std::to_string(feature.GetFieldAsInteger(index));
+            break;
+        case CNFieldType::kInteger64:
+            buffer_ += std::to_string(feature.GetFieldAsInteger64(index));
+            break;
+        case CNFieldType::kReal:
+            AppendDouble(feature.GetFieldAsReal(index));
+            break;
+        case CNFieldType::kBoolean:
+            buffer_ += feature.GetField(index).GetBoolean() ? "true" : "false";
+            break;
+        case CNFieldType::kDate:
+        case CNFieldType::kTime:
+        case CNFieldType::kDateTime:
+            AppendString(feature.GetFieldAsDateTime(index).ToISO8601());
+            break;
+        case CNFieldType::kBinary: {
+            static const char kHex[] = "0123456789abcdef";
+            std::vector<uint8_t> bytes = feature.GetFieldAsBinary(index);
+            buffer_ += '"';
+            for (uint8_t byte : bytes) {
+                buffer_ += kHex[byte >> 4];
+                buffer_ += kHex[byte & 0xF];
+            }
+            buffer_ += '"';
+            break;
+        }
+        default:
+            AppendString(feature.GetFieldAsString(index));
+            break;
+    }
+}
+
+CNGeoJSONWriter::CNGeoJSONWriter()
+    : impl_(new Impl()) {
+}
+
+CNGeoJSONWriter::~CNGeoJSONWriter() {
+    Close();
+}
+
+bool CNGeoJSONWriter::Open(const std::string& path) {
+    Close();
+    impl_->file_ = std::fopen(path.c_str(), "wb");
+    if (!impl_->file_) {
+        return false;
+    }
+    impl_->buffer_.clear();
+    impl_->buffer_.reserve(kDefaultBufferSize + kDefaultBufferSize / 4);
+    impl_->buffer_ += "{\"type\":\"FeatureCollection\",\"features\":[";
+    impl_->count_ = 0;
+    impl_->failed_ = false;
+    return true;
+}
+
+void CNGeoJSONWriter::SetPrecision(int digits) {
+    if (digits > 0 && digits <= 17) {
+        impl_->precision_ = digits;
+    }
+}
+
+int CNGeoJSONWriter::GetPrecision() const {
+    return impl_->precision_;
+}
+
+bool CNGeoJSONWriter::WriteFeature(const CNFeature& feature) {
+    Impl& impl = *impl_;
+    if (!impl.file_ || impl.failed_) {
+        return false;
+    }
+    std::string& out = impl.buffer_;
+    out += impl.count_ > 0 ? ",\n" : "\n";
+    out += "{\"type\":\"Feature\",\"id\":";
+    out += std::to_string(feature.GetFID());
+    out += ",\"geometry\":";
+    impl.AppendGeometry(feature.GetGeometryRef(), 0);
+    out += ",\"properties\":{";
+    const CNFeatureDefn* defn = feature.GetFeatureDefn();
+    bool first = true;
+    size_t count = defn ? defn->GetFieldCount() : 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!feature.IsFieldSet(i)) {
+            continue;
+        }
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        const CNFieldDefn* field = defn->GetFieldDefn(i);
+        impl.AppendString(field->GetName());
+        out += ':';
+        impl.AppendField(feature, i, field->GetType());
+    }
+    out += "}}";
+    ++impl.count_;
+    if (out.size() >= kDefaultBufferSize) {
+        return Flush();
+    }
+    return true;
+}
+
+bool CNGeoJSONWriter::Flush() {
+    Impl& impl = *impl_;
+    if (!impl.file_) {
+        return false;
+    }
+    if (!impl.buffer_.empty()) {
+        if (std::fwrite(impl.buffer_.data(), 1, impl.buffer_.size(), impl.file_) !=
+            impl.buffer_.size()) {
+            impl.failed_ = true;
+        }
+        impl.buffer_.clear();
+    }
+    if (std::fflush(impl.file_) != 0) {
+        impl.failed_ = true;
+    }
+    return !impl.failed_;
+}
+
+bool CNGeoJSONWriter::Close() {
+    Impl& impl = *impl_;
+    if (!impl.file_) {
+        return false;
+    }
+    impl.buffer_ += "\n]}\n";
+    bool ok = Flush();
+    if (std::fclose(impl.file_) != 0) {
+        ok = false;
+    }
+    impl.file_ = nullptr;
+    return ok;
+}
+
+bool CNGeoJSONWriter::IsOpen() const {
+    return impl_->file_ != nullptr;
+}
+
+int64_t CNGeoJSONWriter::GetFeatureCount() const {
+    return impl_->count_;
+}
+
+} // namespace ogc
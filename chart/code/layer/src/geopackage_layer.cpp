@@ -3,14 +3,129 @@
 
 #include "ogc/feature/feature.h"
 #include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
+#include "ogc/geom/factory.h"
 #include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
 
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <vector>
 
 namespace ogc {
 
+namespace {
+
+std::string QuoteIdentifier(const std::string& name) {
+    std::string quoted = "\"";
+    for (char c : name) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string ToUpper(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return text;
+}
+
+std::string ColumnText(sqlite3_stmt* stmt, int column) {
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+    return text ? std::string(reinterpret_cast<const char*>(text)) : std::string();
+}
+
+CNFieldType FieldTypeFromDeclared(const std::string& declared) {
+    std::string type = ToUpper(declared);
+    if (type == "BOOLEAN") {
+        return CNFieldType::kBoolean;
+    }
+    if (type == "TINYINT" || type == "SMALLINT" || type == "MEDIUMINT") {
+        return CNFieldType::kInteger;
+    }
+    if (type.find("INT") != std::string::npos) {
+        return CNFieldType::kInteger64;
+    }
+    if (type == "FLOAT" || type == "DOUBLE" || type == "REAL") {
+        return CNFieldType::kReal;
+    }
+    if (type == "DATE") {
+        return CNFieldType::kDate;
+    }
+    if (type == "DATETIME") {
+        return CNFieldType::kDateTime;
+    }
+    if (type.compare(0, 4, "BLOB") == 0) {
+        return CNFieldType::kBinary;
+    }
+    return CNFieldType::kString;
+}
+
+GeomType GeomTypeFromName(const std::string& name) {
+    std::string type = ToUpper(name);
+    if (type == "POINT") return GeomType::kPoint;
+    if (type == "LINESTRING") return GeomType::kLineString;
+    if (type == "POLYGON") return GeomType::kPolygon;
+    if (type == "MULTIPOINT") return GeomType::kMultiPoint;
+    if (type == "MULTILINESTRING") return GeomType::kMultiLineString;
+    if (type == "MULTIPOLYGON") return GeomType::kMultiPolygon;
+    if (type == "GEOMETRYCOLLECTION") return GeomType::kGeometryCollection;
+    return GeomType::kUnknown;
+}
+
+double ReadHeaderDouble(const uint8_t* data, bool little_endian) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(data[i]) << ((little_endian ? i : 7 - i) * 8);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Parses a GeoPackage geometry blob header ("GP", version, flags, srs_id,
+ * optional envelope) and returns the offset of the WKB that follows.
+ */
+bool ParseGpkgHeader(const uint8_t* data, size_t size, size_t* wkb_offset,
+                     bool* empty, Envelope* envelope) {
+    if (size < 8 || data[0] != 'G' || data[1] != 'P') {
+        return false;
+    }
+    uint8_t flags = data[3];
+    bool little_endian = (flags & 0x01) != 0;
+    int envelope_kind = (flags >> 1) & 0x07;
+    static const size_t kEnvelopeSizes[] = {0, 32, 48, 48, 64};
+    if (envelope_kind > 4) {
+        return false;
+    }
+    size_t offset = 8 + kEnvelopeSizes[envelope_kind];
+    if (offset > size) {
+        return false;
+    }
+    if (envelope && envelope_kind > 0) {
+        *envelope = Envelope(ReadHeaderDouble(data + 8, little_endian),
+                             ReadHeaderDouble(data + 24, little_endian),
+                             ReadHeaderDouble(data + 16, little_endian),
+                             ReadHeaderDouble(data + 32, little_endian));
+    } else if (envelope) {
+        envelope->SetNull();
+    }
+    *empty = (flags & 0x10) != 0;
+    *wkb_offset = offset;
+    return true;
+}
+
+} // namespace
+
 class CNGeoPackageLayer::Impl {
 public:
     std::string path_;
@@ -20,17 +135,371 @@ public:
     void* spatial_ref_ = nullptr;
     Envelope extent_;
     bool extent_loaded_ = false;
-    std::vector<std::unique_ptr<CNFeature>> features_;
-    std::unordered_map<int64_t, size_t> fid_index_;
-    size_t read_cursor_ = 0;
     std::unique_ptr<CNGeometry> spatial_filter_;
+    Envelope filter_extent_;
     std::string attribute_filter_;
-    int64_t next_fid_ = 1;
-    void* db_handle_ = nullptr;
+
+    sqlite3* db_ = nullptr;
+    std::string fid_column_;
+    std::string geom_column_;
+    std::string rtree_name_;
+    std::vector<std::string> field_columns_;
+    int srs_id_ = 0;
+
+    sqlite3_stmt* page_stmt_ = nullptr;
+    sqlite3_stmt* fetch_stmt_ = nullptr;
+    sqlite3_stmt* count_stmt_ = nullptr;
+    size_t page_size_ = kDefaultPageSize;
+
+    std::vector<std::unique_ptr<CNFeature>> page_;
+    size_t page_pos_ = 0;
+    int64_t last_fid_ = std::numeric_limits<int64_t>::min();
+    bool exhausted_ = false;
+
+    ~Impl();
+
+    bool OpenDatabase(const std::string& path);
+    bool LoadTable(const std::string& layer_name);
+    bool LoadExtent();
+    void FinalizeQueries();
+
+    std::string SelectColumns() const;
+    std::string WhereClause() const;
+    bool UsesRTree() const;
+    sqlite3_stmt* Prepare(const std::string& sql) const;
+    int BindFilter(sqlite3_stmt* stmt, int first) const;
+
+    bool FetchPage();
+    std::unique_ptr<CNFeature> ReadRow(sqlite3_stmt* stmt, bool apply_filter) const;
+    GeometryPtr DecodeGeometry(const void* blob, int size, bool apply_filter,
+                               bool* rejected) const;
+    void ResetCursor();
 };
 
+CNGeoPackageLayer::Impl::~Impl() {
+    FinalizeQueries();
+    if (fetch_stmt_) {
+        sqlite3_finalize(fetch_stmt_);
+    }
+    if (db_) {
+        sqlite3_close(db_);
+    }
+}
+
+bool CNGeoPackageLayer::Impl::OpenDatabase(const std::string& path) {
+    if (sqlite3_open_v2(path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_stmt* stmt = Prepare(
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'gpkg_contents'");
+    bool valid = stmt && sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return valid;
+}
+
+bool CNGeoPackageLayer::Impl::LoadTable(const std::string& layer_name) {
+    std::string sql =
+        "SELECT c.table_name, g.column_name, g.geometry_type_name, g.srs_id "
+        "FROM gpkg_contents c JOIN gpkg_geometry_columns g ON c.table_name = g.table_name "
+        "WHERE c.data_type = 'features'";
+    if (!layer_name.empty()) {
+        sql += " AND c.table_name = ?";
+    }
+    sql += " ORDER BY c.table_name LIMIT 1";
+    sqlite3_stmt* stmt = Prepare(sql);
+    if (!stmt) {
+        return false;
+    }
+    if (!layer_name.empty()) {
+        sqlite3_bind_text(stmt, 1, layer_name.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    name_ = ColumnText(stmt, 0);
+    geom_column_ = ColumnText(stmt, 1);
+    GeomType geom_type = GeomTypeFromName(ColumnText(stmt, 2));
+    srs_id_ = sqlite3_column_int(stmt, 3);
+    sqlite3_finalize(stmt);
+
+    CNFeatureDefn* defn = CNFeatureDefn::Create(name_.c_str());
+    feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+
+    stmt = Prepare("PRAGMA table_info(" + QuoteIdentifier(name_) + ")");
+    if (!stmt) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        std::string column = ColumnText(stmt, 1);
+        std::string declared = ColumnText(stmt, 2);
+        bool primary_key = sqlite3_column_int(stmt, 5) != 0;
+        if (column == geom_column_) {
+            continue;
+        }
+        if (primary_key && fid_column_.empty() &&
+            ToUpper(declared).find("INT") != std::string::npos) {
+            fid_column_ = column;
+            continue;
+        }
+        CNFieldDefn* field = CreateCNFieldDefn(column.c_str());
+        field->SetType(FieldTypeFromDeclared(declared));
+        field->SetNullable(sqlite3_column_int(stmt, 3) == 0);
+        defn->AddFieldDefn(field);
+        field_columns_.push_back(column);
+    }
+    sqlite3_finalize(stmt);
+    if (fid_column_.empty()) {
+        fid_column_ = "rowid";
+    }
+
+    CNGeomFieldDefn* geom_field = CreateCNGeomFieldDefn(geom_column_.c_str());
+    geom_field->SetGeomType(geom_type);
+    defn->AddGeomFieldDefn(geom_field);
+
+    std::string rtree = "rtree_" + name_ + "_" + geom_column_;
+    stmt = Prepare("SELECT 1 FROM sqlite_master WHERE name = ?");
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, rtree.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            rtree_name_ = rtree;
+        }
+        sqlite3_finalize(stmt);
+    }
+    return true;
+}
+
+bool CNGeoPackageLayer::Impl::LoadExtent() {
+    extent_.SetNull();
+    sqlite3_stmt* stmt = Prepare(
+        "SELECT min_x, min_y, max_x, max_y FROM gpkg_contents WHERE table_name = ?");
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, name_.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            extent_ = Envelope(sqlite3_column_double(stmt, 0), sqlite3_column_double(stmt, 1),
+                               sqlite3_column_double(stmt, 2), sqlite3_column_double(stmt, 3));
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (extent_.IsNull() && !rtree_name_.empty()) {
+        stmt = Prepare("SELECT min(minx), min(miny), max(maxx), max(maxy) FROM " +
+                       QuoteIdentifier(rtree_name_));
+        if (stmt) {
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+                extent_ = Envelope(sqlite3_column_double(stmt, 0), sqlite3_column_double(stmt, 1),
+                                   sqlite3_column_double(stmt, 2), sqlite3_column_double(stmt, 3));
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    extent_loaded_ = true;
+    return !extent_.IsNull();
+}
+
+void CNGeoPackageLayer::Impl::FinalizeQueries() {
+    if (page_stmt_) {
+        sqlite3_finalize(page_stmt_);
+        page_stmt_ = nullptr;
+    }
+    if (count_stmt_) {
+        sqlite3_finalize(count_stmt_);
+        count_stmt_ = nullptr;
+    }
+}
+
+std::string CNGeoPackageLayer::Impl::SelectColumns() const {
+    std::string columns = QuoteIdentifier(fid_column_) + ", " + QuoteIdentifier(geom_column_);
+    for (const auto& column : field_columns_) {
+        columns += ", " + QuoteIdentifier(column);
+    }
+    return columns;
+}
+
+bool CNGeoPackageLayer::Impl::UsesRTree() const {
+    return !rtree_name_.empty() && !filter_extent_.IsNull();
+}
+
+std::string CNGeoPackageLayer::Impl::WhereClause() const {
+    std::string where;
+    if (UsesRTree()) {
+        where += " AND " + QuoteIdentifier(fid_column_) + " IN (SELECT id FROM " +
+                 QuoteIdentifier(rtree_name_) +
+                 " WHERE minx <= ? AND maxx >= ? AND miny <= ? AND maxy >= ?)";
+    }
+    if (!attribute_filter_.empty()) {
+        where += " AND (" + attribute_filter_ + ")";
+    }
+    return where;
+}
+
+sqlite3_stmt* CNGeoPackageLayer::Impl::Prepare(const std::string& sql) const {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    return stmt;
+}
+
+int CNGeoPackageLayer::Impl::BindFilter(sqlite3_stmt* stmt, int first) const {
+    if (!UsesRTree()) {
+        return first;
+    }
+    sqlite3_bind_double(stmt, first, filter_extent_.GetMaxX());
+    sqlite3_bind_double(stmt, first + 1, filter_extent_.GetMinX());
+    sqlite3_bind_double(stmt, first + 2, filter_extent_.GetMaxY());
+    sqlite3_bind_double(stmt, first + 3, filter_extent_.GetMinY());
+    return first + 4;
+}
+
+GeometryPtr CNGeoPackageLayer::Impl::DecodeGeometry(const void* blob, int size,
+                                                    bool apply_filter,
+                                                    bool* rejected) const {
+    *rejected = false;
+    const uint8_t* data = static_cast<const uint8_t*>(blob);
+    size_t wkb_offset = 0;
+    bool empty = false;
+    Envelope envelope;
+    if (!data || size <= 0 ||
+        !ParseGpkgHeader(data, static_cast<size_t>(size), &wkb_offset, &empty, &envelope)) {
+        return nullptr;
+    }
+    // Without an R-tree the filter is applied here, preferring the header
+    // envelope so that rejected rows are never decoded.
+    bool check_envelope = apply_filter && !filter_extent_.IsNull() && rtree_name_.empty();
+    if (check_envelope && !envelope.IsNull() && !envelope.Intersects(filter_extent_)) {
+        *rejected = true;
+        return nullptr;
+    }
+    if (empty) {
+        *rejected = check_envelope;
+        return nullptr;
+    }
+
+    GeometryPtr geometry;
+    if (GeometryFactory::GetInstance().FromWKB(data + wkb_offset,
+                                               static_cast<size_t>(size) - wkb_offset,
+                                               geometry) != GeomResult::kSuccess) {
+        return nullptr;
+    }
+    if (check_envelope && envelope.IsNull() &&
+        !geometry->GetEnvelope().Intersects(filter_extent_)) {
+        *rejected = true;
+        return nullptr;
+    }
+    return geometry;
+}
+
+std::unique_ptr<CNFeature> CNGeoPackageLayer::Impl::ReadRow(sqlite3_stmt* stmt,
+                                                            bool apply_filter) const {
+    bool rejected = false;
+    GeometryPtr geometry;
+    if (sqlite3_column_type(stmt, 1) == SQLITE_BLOB) {
+        geometry = DecodeGeometry(sqlite3_column_blob(stmt, 1),
+                                  sqlite3_column_bytes(stmt, 1), apply_filter, &rejected);
+    } else {
+        rejected = apply_filter && !filter_extent_.IsNull() && rtree_name_.empty();
+    }
+    if (rejected) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNFeature> feature(new CNFeature(feature_defn_.get()));
+    feature->SetFID(sqlite3_column_int64(stmt, 0));
+    if (geometry) {
+        feature->SetGeometry(std::move(geometry));
+    }
+
+    for (size_t i = 0; i < field_columns_.size(); ++i) {
+        int column = static_cast<int>(i) + 2;
+        if (sqlite3_column_type(stmt, column) == SQLITE_NULL) {
+            feature->SetFieldNull(i);
+            continue;
+        }
+        switch (feature_defn_->GetFieldDefn(i)->GetType()) {
+            case CNFieldType::kInteger:
+                feature->SetFieldInteger(i, sqlite3_column_int(stmt, column));
+                break;
+            case CNFieldType::kInteger64:
+                feature->SetFieldInteger64(i, sqlite3_column_int64(stmt, column));
+                break;
+            case CNFieldType::kReal:
+                feature->SetFieldReal(i, sqlite3_column_double(stmt, column));
+                break;
+            case CNFieldType::kBoolean:
+                feature->SetField(i, CNFieldValue(sqlite3_column_int(stmt, column) != 0));
+                break;
+            case CNFieldType::kDate:
+            case CNFieldType::kDateTime:
+                feature->SetFieldDateTime(i, CNDateTime::FromISO8601(ColumnText(stmt, column)));
+                break;
+            case CNFieldType::kBinary: {
+                const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, column));
+                int bytes = sqlite3_column_bytes(stmt, column);
+                feature->SetFieldBinary(i, std::vector<uint8_t>(blob, blob + bytes));
+                break;
+            }
+            default:
+                feature->SetFieldString(i, ColumnText(stmt, column));
+                break;
+        }
+    }
+    return feature;
+}
+
+bool CNGeoPackageLayer::Impl::FetchPage() {
+    page_.clear();
+    page_pos_ = 0;
+    if (exhausted_) {
+        return false;
+    }
+    if (!page_stmt_) {
+        page_stmt_ = Prepare("SELECT " + SelectColumns() + " FROM " + QuoteIdentifier(name_) +
+                             " WHERE " + QuoteIdentifier(fid_column_) + " > ?" + WhereClause() +
+                             " ORDER BY " + QuoteIdentifier(fid_column_) + " LIMIT ?");
+        if (!page_stmt_) {
+            exhausted_ = true;
+            return false;
+        }
+    }
+
+    // Keyset paging: each page resumes after the last FID seen, so the
+    // statement never re-walks skipped rows the way OFFSET would.
+    while (page_.empty()) {
+        sqlite3_reset(page_stmt_);
+        sqlite3_bind_int64(page_stmt_, 1, last_fid_);
+        int next = BindFilter(page_stmt_, 2);
+        sqlite3_bind_int64(page_stmt_, next, static_cast<sqlite3_int64>(page_size_));
+
+        size_t rows = 0;
+        while (sqlite3_step(page_stmt_) == SQLITE_ROW) {
+            ++rows;
+            last_fid_ = sqlite3_column_int64(page_stmt_, 0);
+            std::unique_ptr<CNFeature> feature = ReadRow(page_stmt_, true);
+            if (feature) {
+                page_.push_back(std::move(feature));
+            }
+        }
+        sqlite3_reset(page_stmt_);
+        if (rows < page_size_) {
+            exhausted_ = true;
+            break;
+        }
+    }
+    return !page_.empty();
+}
+
+void CNGeoPackageLayer::Impl::ResetCursor() {
+    page_.clear();
+    page_pos_ = 0;
+    last_fid_ = std::numeric_limits<int64_t>::min();
+    exhausted_ = false;
+}
+
 CNGeoPackageLayer::CNGeoPackageLayer()
     : impl_(new Impl()) {
+    impl_->filter_extent_.SetNull();
 }
 
 CNGeoPackageLayer::~CNGeoPackageLayer() = default;
@@ -39,10 +508,18 @@ std::unique_ptr<CNVectorLayer> CNGeoPackageLayer::Open(
     const std::string& path,
     const std::string& layer_name,
     bool update) {
-    (void)path;
-    (void)layer_name;
-    (void)update;
-    return nullptr;
+    if (update) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNGeoPackageLayer> layer(new CNGeoPackageLayer());
+    Impl& impl = *layer->impl_;
+    impl.path_ = path;
+    if (!impl.OpenDatabase(path) || !impl.LoadTable(layer_name)) {
+        return nullptr;
+    }
+    impl.LoadExtent();
+    return std::unique_ptr<CNVectorLayer>(layer.release());
 }
 
 std::unique_ptr<CNVectorLayer> CNGeoPackageLayer::Create(
@@ -95,18 +572,49 @@ const void* CNGeoPackageLayer::GetSpatialRef() const {
 }
 
 CNStatus CNGeoPackageLayer::GetExtent(Envelope& extent, bool force) const {
-    (void)force;
+    if (!impl_->extent_loaded_ && force) {
+        impl_->LoadExtent();
+    }
     extent = impl_->extent_;
     return CNStatus::kSuccess;
 }
 
 int64_t CNGeoPackageLayer::GetFeatureCount(bool force) const {
-    (void)force;
-    return static_cast<int64_t>(impl_->features_.size());
+    Impl& impl = *impl_;
+    bool filtered_in_memory = !impl.filter_extent_.IsNull() && impl.rtree_name_.empty();
+    if (filtered_in_memory) {
+        if (!force) {
+            return -1;
+        }
+        std::unique_ptr<CNLayer> cursor = Clone();
+        int64_t count = 0;
+        while (cursor && cursor->GetNextFeatureRef()) {
+            ++count;
+        }
+        return count;
+    }
+
+    if (!impl.count_stmt_) {
+        impl.count_stmt_ = impl.Prepare("SELECT COUNT(*) FROM " + QuoteIdentifier(impl.name_) +
+                                        " WHERE " + QuoteIdentifier(impl.fid_column_) +
+                                        " > ?" + impl.WhereClause());
+        if (!impl.count_stmt_) {
+            return -1;
+        }
+    }
+    sqlite3_reset(impl.count_stmt_);
+    sqlite3_bind_int64(impl.count_stmt_, 1, std::numeric_limits<int64_t>::min());
+    impl.BindFilter(impl.count_stmt_, 2);
+    int64_t count = -1;
+    if (sqlite3_step(impl.count_stmt_) == SQLITE_ROW) {
+        count = sqlite3_column_int64(impl.count_stmt_, 0);
+    }
+    sqlite3_reset(impl.count_stmt_);
+    return count;
 }
 
 void CNGeoPackageLayer::ResetReading() {
-    impl_->read_cursor_ = 0;
+    impl_->ResetCursor();
 }
 
 std::unique_ptr<CNFeature> CNGeoPackageLayer::GetNextFeature() {
@@ -114,22 +622,35 @@ std::unique_ptr<CNFeature> CNGeoPackageLayer::GetNextFeature() {
     if (!feature) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(feature->Clone());
+    return std::move(impl_->page_[impl_->page_pos_ - 1]);
 }
 
 CNFeature* CNGeoPackageLayer::GetNextFeatureRef() {
-    if (impl_->read_cursor_ >= impl_->features_.size()) {
+    Impl& impl = *impl_;
+    if (impl.page_pos_ >= impl.page_.size() && !impl.FetchPage()) {
         return nullptr;
     }
-    return impl_->features_[impl_->read_cursor_++].get();
+    return impl.page_[impl.page_pos_++].get();
 }
 
 std::unique_ptr<CNFeature> CNGeoPackageLayer::GetFeature(int64_t fid) {
-    auto it = impl_->fid_index_.find(fid);
-    if (it == impl_->fid_index_.end()) {
-        return nullptr;
+    Impl& impl = *impl_;
+    if (!impl.fetch_stmt_) {
+        impl.fetch_stmt_ = impl.Prepare("SELECT " + impl.SelectColumns() + " FROM " +
+                                        QuoteIdentifier(impl.name_) + " WHERE " +
+                                        QuoteIdentifier(impl.fid_column_) + " = ?");
+        if (!impl.fetch_stmt_) {
+            return nullptr;
+        }
+    }
+    sqlite3_reset(impl.fetch_stmt_);
+    sqlite3_bind_int64(impl.fetch_stmt_, 1, fid);
+    std::unique_ptr<CNFeature> feature;
+    if (sqlite3_step(impl.fetch_stmt_) == SQLITE_ROW) {
+        feature = impl.ReadRow(impl.fetch_stmt_, false);
     }
-    return std::unique_ptr<CNFeature>(impl_->features_[it->second]->Clone());
+    sqlite3_reset(impl.fetch_stmt_);
+    return feature;
 }
 
 CNStatus CNGeoPackageLayer::SetFeature(const CNFeature* feature) {
@@ -147,6 +668,11 @@ CNStatus CNGeoPackageLayer::DeleteFeature(int64_t fid) {
     return CNStatus::kNotSupported;
 }
 
+int64_t CNGeoPackageLayer::CreateFeatureBatch(const std::vector<CNFeature*>& features) {
+    (void)features;
+    return 0;
+}
+
 CNStatus CNGeoPackageLayer::CreateField(const CNFieldDefn* field_defn, bool approx_ok) {
     (void)field_defn;
     (void)approx_ok;
@@ -158,12 +684,24 @@ CNStatus CNGeoPackageLayer::DeleteField(int field_index) {
     return CNStatus::kNotSupported;
 }
 
+void CNGeoPackageLayer::SetSpatialFilterRect(
+    double min_x, double min_y,
+    double max_x, double max_y) {
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
+}
+
 void CNGeoPackageLayer::SetSpatialFilter(const CNGeometry* geometry) {
     if (geometry) {
         impl_->spatial_filter_.reset(geometry->Clone().release());
+        impl_->filter_extent_ = geometry->GetEnvelope();
     } else {
         impl_->spatial_filter_.reset();
+        impl_->filter_extent_ = Envelope();
+        impl_->filter_extent_.SetNull();
     }
+    impl_->FinalizeQueries();
+    impl_->ResetCursor();
 }
 
 const CNGeometry* CNGeoPackageLayer::GetSpatialFilter() const {
@@ -171,7 +709,18 @@ const CNGeometry* CNGeoPackageLayer::GetSpatialFilter() const {
 }
 
 CNStatus CNGeoPackageLayer::SetAttributeFilter(const std::string& query) {
-    impl_->attribute_filter_ = query;
+    Impl& impl = *impl_;
+    if (!query.empty()) {
+        sqlite3_stmt* stmt = impl.Prepare("SELECT 1 FROM " + QuoteIdentifier(impl.name_) +
+                                          " WHERE (" + query + ") LIMIT 0");
+        if (!stmt) {
+            return CNStatus::kInvalidParameter;
+        }
+        sqlite3_finalize(stmt);
+    }
+    impl.attribute_filter_ = query;
+    impl.FinalizeQueries();
+    impl.ResetCursor();
     return CNStatus::kSuccess;
 }
 
@@ -180,7 +729,10 @@ bool CNGeoPackageLayer::TestCapability(CNLayerCapability capability) const {
         case CNLayerCapability::kRandomRead:
         case CNLayerCapability::kFastFeatureCount:
         case CNLayerCapability::kFastGetExtent:
+        case CNLayerCapability::kStringsAsUTF8:
             return true;
+        case CNLayerCapability::kFastSpatialFilter:
+            return !impl_->rtree_name_.empty();
         case CNLayerCapability::kSequentialWrite:
         case CNLayerCapability::kRandomWrite:
         case CNLayerCapability::kCreateFeature:
@@ -193,7 +745,26 @@ bool CNGeoPackageLayer::TestCapability(CNLayerCapability capability) const {
 }
 
 std::unique_ptr<CNLayer> CNGeoPackageLayer::Clone() const {
-    return nullptr;
+    std::unique_ptr<CNVectorLayer> layer = Open(impl_->path_, impl_->name_);
+    if (!layer) {
+        return nullptr;
+    }
+    static_cast<CNGeoPackageLayer*>(layer.get())->SetPageSize(impl_->page_size_);
+    layer->SetSpatialFilter(impl_->spatial_filter_.get());
+    layer->SetAttributeFilter(impl_->attribute_filter_);
+    return std::unique_ptr<CNLayer>(layer.release());
+}
+
+void CNGeoPackageLayer::SetPageSize(size_t page_size) {
+    impl_->page_size_ = page_size > 0 ? page_size : 1;
+}
+
+size_t CNGeoPackageLayer::GetPageSize() const {
+    return impl_->page_size_;
+}
+
+bool CNGeoPackageLayer::HasSpatialIndex() const {
+    return !impl_->rtree_name_.empty();
 }
 
 } // namespace ogc
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ogc {
+
+/**
+ * @brief Read-only memory mapping of a whole file, shared by the file-based
+ * layers. Empty files cannot be mapped and fail to open.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool IsOpen() const { return data_ != nullptr; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = reinterpret_cast<void*>(static_cast<intptr_t>(-1));
+    void* mapping_ = nullptr;
+#endif
+};
+
+} // namespace ogc
@@ -3,14 +3,158 @@
 
 #include "ogc/feature/feature.h"
 #include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
+#include "ogc/geom/factory.h"
 #include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
 
-#include <fstream>
+#include <libpq-fe.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
-#include <unordered_map>
 
 namespace ogc {
 
+namespace {
+
+// Built-in type OIDs from pg_type.
+const Oid kBoolOid = 16;
+const Oid kByteaOid = 17;
+const Oid kInt8Oid = 20;
+const Oid kInt2Oid = 21;
+const Oid kInt4Oid = 23;
+const Oid kTextOid = 25;
+const Oid kFloat4Oid = 700;
+const Oid kFloat8Oid = 701;
+const Oid kBpcharOid = 1042;
+const Oid kVarcharOid = 1043;
+const Oid kDateOid = 1082;
+const Oid kTimestampOid = 1114;
+const Oid kTimestampTzOid = 1184;
+const Oid kNumericOid = 1700;
+
+std::atomic<unsigned> g_cursor_counter(0);
+
+std::string QuoteIdentifier(const std::string& name) {
+    std::string quoted = "\"";
+    for (char c : name) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+std::string FormatDouble(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+uint32_t ReadUInt32BE(const char* data) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint64_t ReadUInt64BE(const char* data) {
+    return (static_cast<uint64_t>(ReadUInt32BE(data)) << 32) | ReadUInt32BE(data + 4);
+}
+
+double ReadFloat8BE(const char* data) {
+    uint64_t bits = ReadUInt64BE(data);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+float ReadFloat4BE(const char* data) {
+    uint32_t bits = ReadUInt32BE(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+CNFieldType FieldTypeFromOid(Oid oid) {
+    switch (oid) {
+        case kBoolOid: return CNFieldType::kBoolean;
+        case kByteaOid: return CNFieldType::kBinary;
+        case kInt8Oid: return CNFieldType::kInteger64;
+        case kInt2Oid:
+        case kInt4Oid: return CNFieldType::kInteger;
+        case kFloat4Oid:
+        case kFloat8Oid:
+        case kNumericOid: return CNFieldType::kReal;
+        case kDateOid: return CNFieldType::kDate;
+        case kTimestampOid:
+        case kTimestampTzOid: return CNFieldType::kDateTime;
+        default: return CNFieldType::kString;
+    }
+}
+
+/**
+ * Select-list expression for a column so that its binary result is one of
+ * the formats decoded in ReadRow; other types are sent as text.
+ */
+std::string SelectExpression(const std::string& column, Oid oid) {
+    switch (oid) {
+        case kBoolOid:
+        case kByteaOid:
+        case kInt8Oid:
+        case kInt2Oid:
+        case kInt4Oid:
+        case kTextOid:
+        case kFloat4Oid:
+        case kFloat8Oid:
+        case kBpcharOid:
+        case kVarcharOid:
+            return QuoteIdentifier(column);
+        case kNumericOid:
+            return QuoteIdentifier(column) + "::float8";
+        default:
+            return QuoteIdentifier(column) + "::text";
+    }
+}
+
+GeomType GeomTypeFromName(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    if (!name.empty() && name.back() == 'M') {
+        name.pop_back();
+    }
+    if (name == "POINT") return GeomType::kPoint;
+    if (name == "LINESTRING") return GeomType::kLineString;
+    if (name == "POLYGON") return GeomType::kPolygon;
+    if (name == "MULTIPOINT") return GeomType::kMultiPoint;
+    if (name == "MULTILINESTRING") return GeomType::kMultiLineString;
+    if (name == "MULTIPOLYGON") return GeomType::kMultiPolygon;
+    if (name == "GEOMETRYCOLLECTION") return GeomType::kGeometryCollection;
+    return GeomType::kUnknown;
+}
+
+class PGResultGuard {
+public:
+    explicit PGResultGuard(PGresult* result) : result_(result) {}
+    ~PGResultGuard() { PQclear(result_); }
+    PGresult* get() const { return result_; }
+    bool Ok(ExecStatusType expected) const {
+        return result_ && PQresultStatus(result_) == expected;
+    }
+
+private:
+    PGResultGuard(const PGResultGuard&) = delete;
+    PGResultGuard& operator=(const PGResultGuard&) = delete;
+    PGresult* result_;
+};
+
+} // namespace
+
 class CNPostGISLayer::Impl {
 public:
     CNPostGISConnectionParams params_;
@@ -20,18 +164,345 @@ public:
     void* spatial_ref_ = nullptr;
     Envelope extent_;
     bool extent_loaded_ = false;
-    std::vector<std::unique_ptr<CNFeature>> features_;
-    std::unordered_map<int64_t, size_t> fid_index_;
-    size_t read_cursor_ = 0;
     std::unique_ptr<CNGeometry> spatial_filter_;
+    Envelope filter_extent_;
     std::string attribute_filter_;
-    int64_t next_fid_ = 1;
-    void* connection_ = nullptr;
+    PGconn* connection_ = nullptr;
     bool in_transaction_ = false;
+
+    std::string table_sql_;
+    std::string fid_column_;
+    int srid_ = 0;
+    std::vector<Oid> field_oids_;
+    std::vector<std::string> selected_names_;
+    std::vector<int> selected_fields_;
+
+    std::string cursor_name_;
+    bool cursor_open_ = false;
+    bool cursor_owns_transaction_ = false;
+    bool exhausted_ = false;
+    size_t fetch_size_ = kDefaultFetchSize;
+    std::string fetch_statement_;
+    int64_t row_counter_ = 0;
+
+    std::vector<std::unique_ptr<CNFeature>> page_;
+    size_t page_pos_ = 0;
+
+    ~Impl();
+
+    bool Connect();
+    bool LoadSchema();
+    bool Execute(const char* sql);
+
+    std::string SelectList() const;
+    std::string WhereClause(std::vector<std::string>& params) const;
+    PGresult* ExecParams(const std::string& sql, const std::vector<std::string>& params,
+                         int result_format) const;
+
+    bool OpenCursor();
+    void CloseCursor();
+    bool FetchPage();
+    std::unique_ptr<CNFeature> ReadRow(PGresult* result, int row);
+    void ResetCursor();
 };
 
+CNPostGISLayer::Impl::~Impl() {
+    CloseCursor();
+    if (connection_) {
+        PQfinish(connection_);
+    }
+}
+
+bool CNPostGISLayer::Impl::Connect() {
+    std::string port = std::to_string(params_.port);
+    const char* keywords[] = {"host", "port", "dbname", "user", "password",
+                              "connect_timeout", "application_name", nullptr};
+    const char* values[] = {params_.host.c_str(), port.c_str(), params_.database.c_str(),
+                            params_.user.c_str(), params_.password.c_str(), "10",
+                            "ogc_layer", nullptr};
+    connection_ = PQconnectdbParams(keywords, values, 0);
+    return connection_ && PQstatus(connection_) == CONNECTION_OK;
+}
+
+bool CNPostGISLayer::Impl::Execute(const char* sql) {
+    PGResultGuard result(PQexec(connection_, sql));
+    return result.Ok(PGRES_COMMAND_OK);
+}
+
+PGresult* CNPostGISLayer::Impl::ExecParams(const std::string& sql,
+                                           const std::vector<std::string>& params,
+                                           int result_format) const {
+    std::vector<const char*> values;
+    values.reserve(params.size());
+    for (const auto& param : params) {
+        values.push_back(param.c_str());
+    }
+    return PQexecParams(connection_, sql.c_str(), static_cast<int>(values.size()), nullptr,
+                        values.empty() ? nullptr : values.data(), nullptr, nullptr,
+                        result_format);
+}
+
+bool CNPostGISLayer::Impl::LoadSchema() {
+    table_sql_ = QuoteIdentifier(params_.schema) + "." + QuoteIdentifier(params_.table);
+    std::vector<std::string> table_param = {table_sql_};
+
+    PGResultGuard columns(ExecParams(
+        "SELECT a.attname, a.atttypid, a.attnotnull, "
+        "COALESCE((SELECT true FROM pg_index i WHERE i.indrelid = a.attrelid "
+        "AND i.indisprimary AND i.indnatts = 1 AND i.indkey[0] = a.attnum), false) "
+        "FROM pg_attribute a WHERE a.attrelid = $1::regclass AND a.attnum > 0 "
+        "AND NOT a.attisdropped ORDER BY a.attnum",
+        table_param, 0));
+    if (!columns.Ok(PGRES_TUPLES_OK) || PQntuples(columns.get()) == 0) {
+        return false;
+    }
+
+    CNFeatureDefn* defn = CNFeatureDefn::Create(params_.table.c_str());
+    feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+
+    bool has_geometry = false;
+    for (int row = 0; row < PQntuples(columns.get()); ++row) {
+        std::string column = PQgetvalue(columns.get(), row, 0);
+        Oid oid = static_cast<Oid>(std::strtoul(PQgetvalue(columns.get(), row, 1), nullptr, 10));
+        bool not_null = PQgetvalue(columns.get(), row, 2)[0] == 't';
+        bool primary_key = PQgetvalue(columns.get(), row, 3)[0] == 't';
+        if (column == params_.geom_column) {
+            has_geometry = true;
+            continue;
+        }
+        if (primary_key && fid_column_.empty() &&
+            (oid == kInt2Oid || oid == kInt4Oid || oid == kInt8Oid)) {
+            fid_column_ = column;
+            continue;
+        }
+        CNFieldDefn* field = CreateCNFieldDefn(column.c_str());
+        field->SetType(FieldTypeFromOid(oid));
+        field->SetNullable(!not_null);
+        defn->AddFieldDefn(field);
+        field_oids_.push_back(oid);
+    }
+    if (!has_geometry) {
+        return false;
+    }
+
+    GeomType geom_type = GeomType::kUnknown;
+    PGResultGuard geometry(ExecParams(
+        "SELECT type, srid FROM geometry_columns WHERE f_table_schema = $1 "
+        "AND f_table_name = $2 AND f_geometry_column = $3",
+        {params_.schema, params_.table, params_.geom_column}, 0));
+    if (geometry.Ok(PGRES_TUPLES_OK) && PQntuples(geometry.get()) > 0) {
+        geom_type = GeomTypeFromName(PQgetvalue(geometry.get(), 0, 0));
+        srid_ = std::atoi(PQgetvalue(geometry.get(), 0, 1));
+    }
+    if (srid_ <= 0) {
+        // Unconstrained column: the envelope must carry the data's SRID or
+        // the && operator rejects it as mixed SRIDs.
+        PGResultGuard sample(PQexec(connection_, ("SELECT ST_SRID(" +
+            QuoteIdentifier(params_.geom_column) + ") FROM " + table_sql_ + " WHERE " +
+            QuoteIdentifier(params_.geom_column) + " IS NOT NULL LIMIT 1").c_str()));
+        if (sample.Ok(PGRES_TUPLES_OK) && PQntuples(sample.get()) > 0) {
+            srid_ = std::atoi(PQgetvalue(sample.get(), 0, 0));
+        }
+    }
+
+    CNGeomFieldDefn* geom_field = CreateCNGeomFieldDefn(params_.geom_column.c_str());
+    geom_field->SetGeomType(geom_type);
+    defn->AddGeomFieldDefn(geom_field);
+
+    for (size_t i = 0; i < field_oids_.size(); ++i) {
+        selected_fields_.push_back(static_cast<int>(i));
+    }
+    return true;
+}
+
+std::string CNPostGISLayer::Impl::SelectList() const {
+    std::string list = fid_column_.empty() ? std::string("NULL") : QuoteIdentifier(fid_column_);
+    list += ", ST_AsBinary(" + QuoteIdentifier(params_.geom_column) + ")";
+    for (int index : selected_fields_) {
+        list += ", " + SelectExpression(feature_defn_->GetFieldDefn(index)->GetName(),
+                                        field_oids_[index]);
+    }
+    return list;
+}
+
+std::string CNPostGISLayer::Impl::WhereClause(std::vector<std::string>& params) const {
+    std::string where;
+    if (!filter_extent_.IsNull()) {
+        size_t first = params.size() + 1;
+        params.push_back(FormatDouble(filter_extent_.GetMinX()));
+        params.push_back(FormatDouble(filter_extent_.GetMinY()));
+        params.push_back(FormatDouble(filter_extent_.GetMaxX()));
+        params.push_back(FormatDouble(filter_extent_.GetMaxY()));
+        std::ostringstream oss;
+        oss << QuoteIdentifier(params_.geom_column) << " && ST_MakeEnvelope($" << first
+            << "::float8, $" << first + 1 << "::float8, $" << first + 2
+            << "::float8, $" << first + 3 << "::float8, " << srid_ << ")";
+        where = oss.str();
+    }
+    if (!attribute_filter_.empty()) {
+        where += (where.empty() ? "(" : " AND (") + attribute_filter_ + ")";
+    }
+    return where.empty() ? where : " WHERE " + where;
+}
+
+bool CNPostGISLayer::Impl::OpenCursor() {
+    if (!in_transaction_) {
+        if (!Execute("BEGIN")) {
+            return false;
+        }
+        cursor_owns_transaction_ = true;
+    }
+
+    cursor_name_ = "ogc_cursor_" + std::to_string(++g_cursor_counter);
+    std::vector<std::string> params;
+    std::string sql = "DECLARE " + cursor_name_ + " NO SCROLL CURSOR FOR SELECT " +
+                      SelectList() + " FROM " + table_sql_ + WhereClause(params);
+    if (!fid_column_.empty()) {
+        sql += " ORDER BY " + QuoteIdentifier(fid_column_);
+    }
+    PGResultGuard result(ExecParams(sql, params, 0));
+    if (!result.Ok(PGRES_COMMAND_OK)) {
+        if (cursor_owns_transaction_) {
+            Execute("ROLLBACK");
+            cursor_owns_transaction_ = false;
+        }
+        return false;
+    }
+    fetch_statement_ = "FETCH FORWARD " + std::to_string(fetch_size_) + " FROM " + cursor_name_;
+    cursor_open_ = true;
+    return true;
+}
+
+void CNPostGISLayer::Impl::CloseCursor() {
+    if (!cursor_open_) {
+        return;
+    }
+    if (cursor_owns_transaction_) {
+        Execute("COMMIT");
+        cursor_owns_transaction_ = false;
+    } else {
+        Execute(("CLOSE " + cursor_name_).c_str());
+    }
+    cursor_open_ = false;
+}
+
+bool CNPostGISLayer::Impl::FetchPage() {
+    page_.clear();
+    page_pos_ = 0;
+    if (exhausted_) {
+        return false;
+    }
+    if (!cursor_open_ && !OpenCursor()) {
+        exhausted_ = true;
+        return false;
+    }
+
+    PGResultGuard result(PQexecParams(connection_, fetch_statement_.c_str(), 0, nullptr,
+                                      nullptr, nullptr, nullptr, 1));
+    if (!result.Ok(PGRES_TUPLES_OK)) {
+        exhausted_ = true;
+        CloseCursor();
+        return false;
+    }
+    int rows = PQntuples(result.get());
+    page_.reserve(static_cast<size_t>(rows));
+    for (int row = 0; row < rows; ++row) {
+        page_.push_back(ReadRow(result.get(), row));
+    }
+    if (static_cast<size_t>(rows) < fetch_size_) {
+        exhausted_ = true;
+        CloseCursor();
+    }
+    return !page_.empty();
+}
+
+std::unique_ptr<CNFeature> CNPostGISLayer::Impl::ReadRow(PGresult* result, int row) {
+    std::unique_ptr<CNFeature> feature(new CNFeature(feature_defn_.get()));
+    if (!PQgetisnull(result, row, 0) && PQfformat(result, 0) == 1) {
+        const char* value = PQgetvalue(result, row, 0);
+        switch (PQgetlength(result, row, 0)) {
+            case 2:
+                feature->SetFID(static_cast<int16_t>((static_cast<unsigned char>(value[0]) << 8) |
+                                                     static_cast<unsigned char>(value[1])));
+                break;
+            case 4: feature->SetFID(static_cast<int32_t>(ReadUInt32BE(value))); break;
+            default: feature->SetFID(static_cast<int64_t>(ReadUInt64BE(value))); break;
+        }
+    } else {
+        feature->SetFID(row_counter_);
+    }
+    ++row_counter_;
+
+    if (!PQgetisnull(result, row, 1)) {
+        GeometryPtr geometry;
+        const uint8_t* wkb = reinterpret_cast<const uint8_t*>(PQgetvalue(result, row, 1));
+        size_t size = static_cast<size_t>(PQgetlength(result, row, 1));
+        if (GeometryFactory::GetInstance().FromWKB(wkb, size, geometry) == GeomResult::kSuccess) {
+            feature->SetGeometry(std::move(geometry));
+        }
+    }
+
+    for (size_t i = 0; i < selected_fields_.size(); ++i) {
+        int column = static_cast<int>(i) + 2;
+        size_t index = static_cast<size_t>(selected_fields_[i]);
+        if (PQgetisnull(result, row, column)) {
+            feature->SetFieldNull(index);
+            continue;
+        }
+        const char* value = PQgetvalue(result, row, column);
+        int length = PQgetlength(result, row, column);
+        switch (PQftype(result, column)) {
+            case kBoolOid:
+                feature->SetField(index, CNFieldValue(value[0] != 0));
+                break;
+            case kInt2Oid:
+                feature->SetFieldInteger(index, static_cast<int16_t>(
+                    (static_cast<unsigned char>(value[0]) << 8) | static_cast<unsigned char>(value[1])));
+                break;
+            case kInt4Oid:
+                feature->SetFieldInteger(index, static_cast<int32_t>(ReadUInt32BE(value)));
+                break;
+            case kInt8Oid:
+                feature->SetFieldInteger64(index, static_cast<int64_t>(ReadUInt64BE(value)));
+                break;
+            case kFloat4Oid:
+                feature->SetFieldReal(index, ReadFloat4BE(value));
+                break;
+            case kFloat8Oid:
+                feature->SetFieldReal(index, ReadFloat8BE(value));
+                break;
+            case kByteaOid:
+                feature->SetFieldBinary(index, std::vector<uint8_t>(
+                    reinterpret_cast<const uint8_t*>(value),
+                    reinterpret_cast<const uint8_t*>(value) + length));
+                break;
+            default: {
+                std::string text(value, static_cast<size_t>(length));
+                CNFieldType type = feature_defn_->GetFieldDefn(index)->GetType();
+                if (type == CNFieldType::kDate || type == CNFieldType::kDateTime) {
+                    feature->SetFieldDateTime(index, CNDateTime::FromISO8601(text));
+                } else {
+                    feature->SetFieldString(index, text);
+                }
+                break;
+            }
+        }
+    }
+    return feature;
+}
+
+void CNPostGISLayer::Impl::ResetCursor() {
+    CloseCursor();
+    page_.clear();
+    page_pos_ = 0;
+    exhausted_ = false;
+    row_counter_ = 0;
+}
+
 CNPostGISLayer::CNPostGISLayer()
     : impl_(new Impl()) {
+    impl_->filter_extent_.SetNull();
 }
 
 CNPostGISLayer::~CNPostGISLayer() = default;
@@ -39,9 +510,19 @@ CNPostGISLayer::~CNPostGISLayer() = default;
 std::unique_ptr<CNVectorLayer> CNPostGISLayer::Open(
     const CNPostGISConnectionParams& params,
     bool update) {
-    (void)params;
-    (void)update;
-    return nullptr;
+    if (update || params.database.empty() || params.table.empty() ||
+        params.geom_column.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNPostGISLayer> layer(new CNPostGISLayer());
+    Impl& impl = *layer->impl_;
+    impl.params_ = params;
+    impl.name_ = params.table;
+    if (!impl.Connect() || !impl.LoadSchema()) {
+        return nullptr;
+    }
+    return std::unique_ptr<CNVectorLayer>(layer.release());
 }
 
 std::unique_ptr<CNVectorLayer> CNPostGISLayer::Create(
@@ -95,18 +576,61 @@ const void* CNPostGISLayer::GetSpatialRef() const {
 }
 
 CNStatus CNPostGISLayer::GetExtent(Envelope& extent, bool force) const {
-    (void)force;
-    extent = impl_->extent_;
+    Impl& impl = *impl_;
+    if (!impl.extent_loaded_) {
+        std::string geom = QuoteIdentifier(impl.params_.geom_column);
+        std::string sql;
+        std::vector<std::string> params;
+        if (force) {
+            sql = "SELECT ST_XMin(e), ST_YMin(e), ST_XMax(e), ST_YMax(e) FROM "
+                  "(SELECT ST_Extent(" + geom + ") AS e FROM " + impl.table_sql_ + ") s";
+        } else {
+            sql = "SELECT ST_XMin(e), ST_YMin(e), ST_XMax(e), ST_YMax(e) FROM "
+                  "(SELECT ST_EstimatedExtent($1, $2, $3) AS e) s";
+            params = {impl.params_.schema, impl.params_.table, impl.params_.geom_column};
+        }
+        PGResultGuard result(impl.ExecParams(sql, params, 0));
+        if (!result.Ok(PGRES_TUPLES_OK) || PQntuples(result.get()) == 0 ||
+            PQgetisnull(result.get(), 0, 0)) {
+            extent.SetNull();
+            return force ? CNStatus::kError : CNStatus::kNotSupported;
+        }
+        impl.extent_ = Envelope(std::atof(PQgetvalue(result.get(), 0, 0)),
+                                std::atof(PQgetvalue(result.get(), 0, 1)),
+                                std::atof(PQgetvalue(result.get(), 0, 2)),
+                                std::atof(PQgetvalue(result.get(), 0, 3)));
+        impl.extent_loaded_ = force;
+    }
+    extent = impl.extent_;
     return CNStatus::kSuccess;
 }
 
 int64_t CNPostGISLayer::GetFeatureCount(bool force) const {
-    (void)force;
-    return static_cast<int64_t>(impl_->features_.size());
+    Impl& impl = *impl_;
+    bool filtered = !impl.filter_extent_.IsNull() || !impl.attribute_filter_.empty();
+    if (!force && !filtered) {
+        PGResultGuard estimate(impl.ExecParams(
+            "SELECT reltuples::int8 FROM pg_class WHERE oid = $1::regclass",
+            {impl.table_sql_}, 0));
+        if (estimate.Ok(PGRES_TUPLES_OK) && PQntuples(estimate.get()) > 0) {
+            int64_t rows = std::atoll(PQgetvalue(estimate.get(), 0, 0));
+            if (rows >= 0) {
+                return rows;
+            }
+        }
+    }
+
+    std::vector<std::string> params;
+    std::string sql = "SELECT count(*) FROM " + impl.table_sql_ + impl.WhereClause(params);
+    PGResultGuard result(impl.ExecParams(sql, params, 0));
+    if (!result.Ok(PGRES_TUPLES_OK) || PQntuples(result.get()) == 0) {
+        return -1;
+    }
+    return std::atoll(PQgetvalue(result.get(), 0, 0));
 }
 
 void CNPostGISLayer::ResetReading() {
-    impl_->read_cursor_ = 0;
+    impl_->ResetCursor();
 }
 
 std::unique_ptr<CNFeature> CNPostGISLayer::GetNextFeature() {
@@ -114,22 +638,29 @@ std::unique_ptr<CNFeature> CNPostGISLayer::GetNextFeature() {
     if (!feature) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(feature->Clone());
+    return std::move(impl_->page_[impl_->page_pos_ - 1]);
 }
 
 CNFeature* CNPostGISLayer::GetNextFeatureRef() {
-    if (impl_->read_cursor_ >= impl_->features_.size()) {
+    Impl& impl = *impl_;
+    if (impl.page_pos_ >= impl.page_.size() && !impl.FetchPage()) {
         return nullptr;
     }
-    return impl_->features_[impl_->read_cursor_++].get();
+    return impl.page_[impl.page_pos_++].get();
 }
 
 std::unique_ptr<CNFeature> CNPostGISLayer::GetFeature(int64_t fid) {
-    auto it = impl_->fid_index_.find(fid);
-    if (it == impl_->fid_index_.end()) {
+    Impl& impl = *impl_;
+    if (impl.fid_column_.empty()) {
+        return nullptr;
+    }
+    std::string sql = "SELECT " + impl.SelectList() + " FROM " + impl.table_sql_ +
+                      " WHERE " + QuoteIdentifier(impl.fid_column_) + " = $1";
+    PGResultGuard result(impl.ExecParams(sql, {std::to_string(fid)}, 1));
+    if (!result.Ok(PGRES_TUPLES_OK) || PQntuples(result.get()) == 0) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(impl_->features_[it->second]->Clone());
+    return impl.ReadRow(result.get(), 0);
 }
 
 CNStatus CNPostGISLayer::SetFeature(const CNFeature* feature) {
@@ -147,6 +678,11 @@ CNStatus CNPostGISLayer::DeleteFeature(int64_t fid) {
     return CNStatus::kNotSupported;
 }
 
+int64_t CNPostGISLayer::CreateFeatureBatch(const std::vector<CNFeature*>& features) {
+    (void)features;
+    return 0;
+}
+
 CNStatus CNPostGISLayer::CreateField(const CNFieldDefn* field_defn, bool approx_ok) {
     (void)field_defn;
     (void)approx_ok;
@@ -158,12 +694,23 @@ CNStatus CNPostGISLayer::DeleteField(int field_index) {
     return CNStatus::kNotSupported;
 }
 
+void CNPostGISLayer::SetSpatialFilterRect(
+    double min_x, double min_y,
+    double max_x, double max_y) {
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
+}
+
 void CNPostGISLayer::SetSpatialFilter(const CNGeometry* geometry) {
     if (geometry) {
         impl_->spatial_filter_.reset(geometry->Clone().release());
+        impl_->filter_extent_ = geometry->GetEnvelope();
     } else {
         impl_->spatial_filter_.reset();
+        impl_->filter_extent_ = Envelope();
+        impl_->filter_extent_.SetNull();
     }
+    impl_->ResetCursor();
 }
 
 const CNGeometry* CNPostGISLayer::GetSpatialFilter() const {
@@ -171,7 +718,18 @@ const CNGeometry* CNPostGISLayer::GetSpatialFilter() const {
 }
 
 CNStatus CNPostGISLayer::SetAttributeFilter(const std::string& query) {
-    impl_->attribute_filter_ = query;
+    Impl& impl = *impl_;
+    impl.ResetCursor();
+    if (!query.empty() && !impl.in_transaction_) {
+        // Inside a caller's transaction a failed check would abort it, so the
+        // filter is then only checked when the cursor is opened.
+        PGResultGuard check(PQexec(impl.connection_, ("SELECT 1 FROM " + impl.table_sql_ +
+                                                      " WHERE (" + query + ") LIMIT 0").c_str()));
+        if (!check.Ok(PGRES_TUPLES_OK)) {
+            return CNStatus::kInvalidParameter;
+        }
+    }
+    impl.attribute_filter_ = query;
     return CNStatus::kSuccess;
 }
 
@@ -179,6 +737,10 @@ CNStatus CNPostGISLayer::StartTransaction() {
     if (impl_->in_transaction_) {
         return CNStatus::kTransactionActive;
     }
+    impl_->ResetCursor();
+    if (!impl_->Execute("BEGIN")) {
+        return CNStatus::kError;
+    }
     impl_->in_transaction_ = true;
     return CNStatus::kSuccess;
 }
@@ -187,24 +749,29 @@ CNStatus CNPostGISLayer::CommitTransaction() {
     if (!impl_->in_transaction_) {
         return CNStatus::kTransactionNotActive;
     }
+    impl_->ResetCursor();
     impl_->in_transaction_ = false;
-    return CNStatus::kSuccess;
+    return impl_->Execute("COMMIT") ? CNStatus::kSuccess : CNStatus::kCommitFailed;
 }
 
 CNStatus CNPostGISLayer::RollbackTransaction() {
     if (!impl_->in_transaction_) {
         return CNStatus::kTransactionNotActive;
     }
+    impl_->ResetCursor();
     impl_->in_transaction_ = false;
-    return CNStatus::kSuccess;
+    return impl_->Execute("ROLLBACK") ? CNStatus::kSuccess : CNStatus::kRollbackFailed;
 }
 
 bool CNPostGISLayer::TestCapability(CNLayerCapability capability) const {
     switch (capability) {
         case CNLayerCapability::kRandomRead:
+            return !impl_->fid_column_.empty();
+        case CNLayerCapability::kFastSpatialFilter:
         case CNLayerCapability::kFastFeatureCount:
         case CNLayerCapability::kFastGetExtent:
         case CNLayerCapability::kTransactions:
+        case CNLayerCapability::kIgnoreFields:
             return true;
         case CNLayerCapability::kSequentialWrite:
         case CNLayerCapability::kRandomWrite:
@@ -217,7 +784,50 @@ bool CNPostGISLayer::TestCapability(CNLayerCapability capability) const {
 }
 
 std::unique_ptr<CNLayer> CNPostGISLayer::Clone() const {
-    return nullptr;
+    std::unique_ptr<CNVectorLayer> layer = Open(impl_->params_);
+    if (!layer) {
+        return nullptr;
+    }
+    CNPostGISLayer* clone = static_cast<CNPostGISLayer*>(layer.get());
+    clone->SetFetchSize(impl_->fetch_size_);
+    clone->SetSelectedFields(impl_->selected_names_);
+    clone->SetSpatialFilter(impl_->spatial_filter_.get());
+    clone->SetAttributeFilter(impl_->attribute_filter_);
+    return std::unique_ptr<CNLayer>(layer.release());
+}
+
+CNStatus CNPostGISLayer::SetSelectedFields(const std::vector<std::string>& field_names) {
+    Impl& impl = *impl_;
+    std::vector<int> fields;
+    if (field_names.empty()) {
+        for (size_t i = 0; i < impl.field_oids_.size(); ++i) {
+            fields.push_back(static_cast<int>(i));
+        }
+    } else {
+        for (const auto& name : field_names) {
+            int index = impl.feature_defn_->GetFieldIndex(name.c_str());
+            if (index < 0) {
+                return CNStatus::kFieldNotFound;
+            }
+            fields.push_back(index);
+        }
+    }
+    impl.ResetCursor();
+    impl.selected_fields_ = fields;
+    impl.selected_names_ = field_names;
+    return CNStatus::kSuccess;
+}
+
+const std::vector<std::string>& CNPostGISLayer::GetSelectedFields() const {
+    return impl_->selected_names_;
+}
+
+void CNPostGISLayer::SetFetchSize(size_t fetch_size) {
+    impl_->fetch_size_ = fetch_size > 0 ? fetch_size : 1;
+}
+
+size_t CNPostGISLayer::GetFetchSize() const {
+    return impl_->fetch_size_;
 }
 
 } // namespace ogc
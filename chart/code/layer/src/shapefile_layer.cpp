@@ -1,16 +1,208 @@
 #include "ogc/layer/shapefile_layer.h"
 #include "ogc/layer/geometry_compat.h"
+#include "mapped_file.h"
 
 #include "ogc/feature/feature.h"
 #include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
 #include "ogc/geom/geometry.h"
+#include "ogc/geom/linearring.h"
+#include "ogc/geom/linestring.h"
+#include "ogc/geom/multilinestring.h"
+#include "ogc/geom/multipoint.h"
+#include "ogc/geom/multipolygon.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/polygon.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <sstream>
-#include <unordered_map>
+#include <vector>
 
 namespace ogc {
 
+namespace {
+
+const size_t kShpHeaderSize = 100;
+const size_t kQixHeaderSize = 16;
+const int kQixMaxDepth = 12;
+
+enum ShapeType {
+    kShapeNull = 0,
+    kShapePoint = 1,
+    kShapeArc = 3,
+    kShapePolygon = 5,
+    kShapeMultiPoint = 8,
+    kShapePointZ = 11,
+    kShapeArcZ = 13,
+    kShapePolygonZ = 15,
+    kShapeMultiPointZ = 18,
+    kShapePointM = 21,
+    kShapeArcM = 23,
+    kShapePolygonM = 25,
+    kShapeMultiPointM = 28
+};
+
+int32_t ReadInt32LE(const uint8_t* p) {
+    return static_cast<int32_t>(static_cast<uint32_t>(p[0]) |
+                                (static_cast<uint32_t>(p[1]) << 8) |
+                                (static_cast<uint32_t>(p[2]) << 16) |
+                                (static_cast<uint32_t>(p[3]) << 24));
+}
+
+int32_t ReadInt32BE(const uint8_t* p) {
+    return static_cast<int32_t>(static_cast<uint32_t>(p[3]) |
+                                (static_cast<uint32_t>(p[2]) << 8) |
+                                (static_cast<uint32_t>(p[1]) << 16) |
+                                (static_cast<uint32_t>(p[0]) << 24));
+}
+
+uint16_t ReadUInt16LE(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+double ReadDoubleLE(const uint8_t* p) {
+    uint64_t bits = 0;
+    for (int i = 7; i >= 0; --i) {
+        bits = (bits << 8) | p[i];
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void AppendInt32LE(std::vector<uint8_t>& out, int32_t value) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+}
+
+void AppendDoubleLE(std::vector<uint8_t>& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < suffix.size(); ++i) {
+        char a = text[text.size() - suffix.size() + i];
+        if (std::tolower(static_cast<unsigned char>(a)) != suffix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SidecarPath(const std::string& shp_path, const char* ext) {
+    std::string base = shp_path.substr(0, shp_path.size() - 4);
+    bool upper = std::isupper(static_cast<unsigned char>(shp_path[shp_path.size() - 1])) != 0;
+    std::string suffix = ext;
+    if (upper) {
+        for (auto& c : suffix) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+    }
+    return base + suffix;
+}
+
+void TrimField(const char*& data, size_t& size) {
+    while (size > 0 && (*data == ' ' || *data == '\0')) {
+        ++data;
+        --size;
+    }
+    while (size > 0 && (data[size - 1] == ' ' || data[size - 1] == '\0')) {
+        --size;
+    }
+}
+
+/**
+ * @brief In-memory quadtree node used while building a .qix file.
+ */
+struct QuadNode {
+    Envelope bounds;
+    std::vector<int32_t> ids;
+    std::unique_ptr<QuadNode> children[4];
+
+    explicit QuadNode(const Envelope& b) : bounds(b) {}
+
+    void Insert(int32_t id, const Envelope& env, int depth, int max_depth) {
+        if (depth < max_depth) {
+            double mid_x = (bounds.GetMinX() + bounds.GetMaxX()) * 0.5;
+            double mid_y = (bounds.GetMinY() + bounds.GetMaxY()) * 0.5;
+            Envelope quads[4] = {
+                Envelope(bounds.GetMinX(), bounds.GetMinY(), mid_x, mid_y),
+                Envelope(mid_x, bounds.GetMinY(), bounds.GetMaxX(), mid_y),
+                Envelope(bounds.GetMinX(), mid_y, mid_x, bounds.GetMaxY()),
+                Envelope(mid_x, mid_y, bounds.GetMaxX(), bounds.GetMaxY())
+            };
+            for (int i = 0; i < 4; ++i) {
+                if (quads[i].Contains(env)) {
+                    if (!children[i]) {
+                        children[i].reset(new QuadNode(quads[i]));
+                    }
+                    children[i]->Insert(id, env, depth + 1, max_depth);
+                    return;
+                }
+            }
+        }
+        ids.push_back(id);
+    }
+
+    /** Bytes of this node's serialized children. */
+    int32_t ChildrenSize() const {
+        int32_t size = 0;
+        for (const auto& child : children) {
+            if (child) {
+                size += 44 + 4 * static_cast<int32_t>(child->ids.size()) + child->ChildrenSize();
+            }
+        }
+        return size;
+    }
+
+    void Write(std::vector<uint8_t>& out) const {
+        AppendInt32LE(out, ChildrenSize());
+        AppendDoubleLE(out, bounds.GetMinX());
+        AppendDoubleLE(out, bounds.GetMinY());
+        AppendDoubleLE(out, bounds.GetMaxX());
+        AppendDoubleLE(out, bounds.GetMaxY());
+        AppendInt32LE(out, static_cast<int32_t>(ids.size()));
+        for (int32_t id : ids) {
+            AppendInt32LE(out, id);
+        }
+        int32_t child_count = 0;
+        for (const auto& child : children) {
+            if (child) {
+                ++child_count;
+            }
+        }
+        AppendInt32LE(out, child_count);
+        for (const auto& child : children) {
+            if (child) {
+                child->Write(out);
+            }
+        }
+    }
+};
+
+double SignedRingArea(const CoordinateList& ring) {
+    double area = 0.0;
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        area += (ring[j].x * ring[i].y) - (ring[i].x * ring[j].y);
+    }
+    return area * 0.5;
+}
+
+} // namespace
+
 class CNShapefileLayer::Impl {
 public:
     std::string path_;
@@ -19,15 +211,582 @@ public:
     std::shared_ptr<CNFeatureDefn> feature_defn_;
     void* spatial_ref_ = nullptr;
     Envelope extent_;
-    bool extent_loaded_ = false;
-    std::vector<std::unique_ptr<CNFeature>> features_;
-    std::unordered_map<int64_t, size_t> fid_index_;
-    size_t read_cursor_ = 0;
     std::unique_ptr<CNGeometry> spatial_filter_;
+    Envelope filter_extent_;
     std::string attribute_filter_;
-    int64_t next_fid_ = 1;
+
+    MappedFile shp_;
+    MappedFile shx_;
+    MappedFile dbf_;
+    MappedFile qix_file_;
+    std::vector<uint8_t> qix_memory_;
+    const uint8_t* qix_ = nullptr;
+    size_t qix_size_ = 0;
+
+    int shape_type_ = kShapeNull;
+    int64_t record_count_ = 0;
+    std::vector<uint32_t> scanned_offsets_;
+
+    int64_t dbf_record_count_ = 0;
+    size_t dbf_header_size_ = 0;
+    size_t dbf_record_size_ = 0;
+    struct DbfField {
+        size_t offset;
+        size_t width;
+        char type;
+        CNFieldType field_type;
+    };
+    std::vector<DbfField> dbf_fields_;
+
+    std::vector<int32_t> candidates_;
+    bool use_candidates_ = false;
+    size_t read_cursor_ = 0;
+    std::unique_ptr<CNFeature> current_;
+
+    bool OpenFiles(const std::string& path);
+    bool ReadShpHeader();
+    bool ReadDbfHeader();
+    void BuildFeatureDefn();
+
+    bool GetRecord(int64_t index, const uint8_t** content, size_t* length) const;
+    bool GetRecordEnvelope(int64_t index, Envelope& env) const;
+    bool IsDeleted(int64_t index) const;
+    GeometryPtr DecodeGeometry(const uint8_t* content, size_t length) const;
+    std::unique_ptr<CNFeature> DecodeFeature(int64_t index) const;
+
+    bool LoadSpatialIndex();
+    void BuildSpatialIndex(const std::string& qix_path);
+    bool QueryIndex(const Envelope& env, std::vector<int32_t>& ids) const;
+    bool QueryNode(size_t pos, size_t end, const Envelope& env,
+                   std::vector<int32_t>& ids) const;
+
+    void PrepareReading();
+    bool PassesFilter(int64_t index) const;
 };
 
+bool CNShapefileLayer::Impl::OpenFiles(const std::string& path) {
+    if (!shp_.Open(path) || !ReadShpHeader()) {
+        return false;
+    }
+
+    if (shx_.Open(SidecarPath(path, ".shx")) && shx_.Size() >= kShpHeaderSize) {
+        record_count_ = static_cast<int64_t>((shx_.Size() - kShpHeaderSize) / 8);
+    } else {
+        shx_.Close();
+        size_t pos = kShpHeaderSize;
+        while (pos + 8 <= shp_.Size()) {
+            int64_t content_length = static_cast<int64_t>(ReadInt32BE(shp_.Data() + pos + 4)) * 2;
+            if (content_length < 0 || pos + 8 + static_cast<size_t>(content_length) > shp_.Size()) {
+                break;
+            }
+            scanned_offsets_.push_back(static_cast<uint32_t>(pos / 2));
+            pos += 8 + static_cast<size_t>(content_length);
+        }
+        record_count_ = static_cast<int64_t>(scanned_offsets_.size());
+    }
+
+    if (dbf_.Open(SidecarPath(path, ".dbf")) && !ReadDbfHeader()) {
+        dbf_.Close();
+    }
+
+    BuildFeatureDefn();
+    return true;
+}
+
+bool CNShapefileLayer::Impl::ReadShpHeader() {
+    const uint8_t* data = shp_.Data();
+    if (shp_.Size() < kShpHeaderSize || ReadInt32BE(data) != 9994) {
+        return false;
+    }
+    shape_type_ = ReadInt32LE(data + 32);
+    extent_ = Envelope(ReadDoubleLE(data + 36), ReadDoubleLE(data + 44),
+                       ReadDoubleLE(data + 52), ReadDoubleLE(data + 60));
+    return true;
+}
+
+bool CNShapefileLayer::Impl::ReadDbfHeader() {
+    const uint8_t* data = dbf_.Data();
+    if (dbf_.Size() < 32) {
+        return false;
+    }
+    dbf_record_count_ = static_cast<int64_t>(static_cast<uint32_t>(ReadInt32LE(data + 4)));
+    dbf_header_size_ = ReadUInt16LE(data + 8);
+    dbf_record_size_ = ReadUInt16LE(data + 10);
+    if (dbf_header_size_ > dbf_.Size() || dbf_record_size_ == 0) {
+        return false;
+    }
+
+    size_t offset = 1;
+    for (size_t pos = 32; pos + 32 <= dbf_header_size_ && data[pos] != 0x0D; pos += 32) {
+        DbfField field;
+        field.offset = offset;
+        field.width = data[pos + 16];
+        field.type = static_cast<char>(data[pos + 11]);
+        int decimals = data[pos + 17];
+        switch (field.type) {
+            case 'N':
+                if (decimals > 0) {
+                    field.field_type = CNFieldType::kReal;
+                } else {
+                    field.field_type = field.width < 10 ? CNFieldType::kInteger : CNFieldType::kInteger64;
+                }
+                break;
+            case 'F':
+                field.field_type = CNFieldType::kReal;
+                break;
+            case 'L':
+                field.field_type = CNFieldType::kBoolean;
+                break;
+            case 'D':
+                field.field_type = CNFieldType::kDate;
+                break;
+            default:
+                field.field_type = CNFieldType::kString;
+                break;
+        }
+        offset += field.width;
+        dbf_fields_.push_back(field);
+    }
+    return offset <= dbf_record_size_;
+}
+
+void CNShapefileLayer::Impl::BuildFeatureDefn() {
+    CNFeatureDefn* defn = CNFeatureDefn::Create(name_.c_str());
+    feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+
+    const uint8_t* data = dbf_.Data();
+    for (size_t i = 0; i < dbf_fields_.size(); ++i) {
+        const uint8_t* desc = data + 32 + i * 32;
+        size_t name_length = 0;
+        while (name_length < 11 && desc[name_length] != 0) {
+            ++name_length;
+        }
+        std::string name(reinterpret_cast<const char*>(desc), name_length);
+        CNFieldDefn* field = CreateCNFieldDefn(name.c_str());
+        field->SetType(dbf_fields_[i].field_type);
+        field->SetWidth(static_cast<int>(dbf_fields_[i].width));
+        field->SetPrecision(desc[17]);
+        defn->AddFieldDefn(field);
+    }
+
+    GeomType geom_type = GeomType::kUnknown;
+    switch (shape_type_ % 10) {
+        case kShapePoint: geom_type = GeomType::kPoint; break;
+        case kShapeArc: geom_type = GeomType::kLineString; break;
+        case kShapePolygon: geom_type = GeomType::kPolygon; break;
+        case kShapeMultiPoint: geom_type = GeomType::kMultiPoint; break;
+        default: break;
+    }
+    CNGeomFieldDefn* geom_field = CreateCNGeomFieldDefn("geom");
+    geom_field->SetGeomType(geom_type);
+    defn->AddGeomFieldDefn(geom_field);
+}
+
+bool CNShapefileLayer::Impl::GetRecord(int64_t index, const uint8_t** content,
+                                       size_t* length) const {
+    if (index < 0 || index >= record_count_) {
+        return false;
+    }
+    size_t offset;
+    if (shx_.IsOpen()) {
+        offset = static_cast<size_t>(static_cast<uint32_t>(
+            ReadInt32BE(shx_.Data() + kShpHeaderSize + index * 8))) * 2;
+    } else {
+        offset = static_cast<size_t>(scanned_offsets_[static_cast<size_t>(index)]) * 2;
+    }
+    if (offset < kShpHeaderSize || offset + 12 > shp_.Size()) {
+        return false;
+    }
+    size_t content_length = static_cast<size_t>(static_cast<uint32_t>(
+        ReadInt32BE(shp_.Data() + offset + 4))) * 2;
+    if (content_length < 4 || offset + 8 + content_length > shp_.Size()) {
+        return false;
+    }
+    *content = shp_.Data() + offset + 8;
+    *length = content_length;
+    return true;
+}
+
+bool CNShapefileLayer::Impl::GetRecordEnvelope(int64_t index, Envelope& env) const {
+    const uint8_t* content = nullptr;
+    size_t length = 0;
+    if (!GetRecord(index, &content, &length)) {
+        return false;
+    }
+    int type = ReadInt32LE(content);
+    if (type == kShapeNull) {
+        return false;
+    }
+    if (type % 10 == kShapePoint) {
+        if (length < 20) {
+            return false;
+        }
+        double x = ReadDoubleLE(content + 4);
+        double y = ReadDoubleLE(content + 12);
+        env = Envelope(x, y, x, y);
+        return true;
+    }
+    if (length < 36) {
+        return false;
+    }
+    env = Envelope(ReadDoubleLE(content + 4), ReadDoubleLE(content + 12),
+                   ReadDoubleLE(content + 20), ReadDoubleLE(content + 28));
+    return true;
+}
+
+bool CNShapefileLayer::Impl::IsDeleted(int64_t index) const {
+    if (!dbf_.IsOpen() || index >= dbf_record_count_) {
+        return false;
+    }
+    size_t pos = dbf_header_size_ + static_cast<size_t>(index) * dbf_record_size_;
+    return pos < dbf_.Size() && dbf_.Data()[pos] == '*';
+}
+
+GeometryPtr CNShapefileLayer::Impl::DecodeGeometry(const uint8_t* content,
+                                                   size_t length) const {
+    int type = ReadInt32LE(content);
+    int base_type = type % 10;
+    bool has_z = type >= kShapePointZ && type <= kShapeMultiPointZ;
+
+    if (base_type == kShapePoint) {
+        if (length < 20) {
+            return nullptr;
+        }
+        double x = ReadDoubleLE(content + 4);
+        double y = ReadDoubleLE(content + 12);
+        if (has_z && length >= 28) {
+            return Point::Create(x, y, ReadDoubleLE(content + 20));
+        }
+        return Point::Create(x, y);
+    }
+
+    if (base_type == kShapeMultiPoint) {
+        if (length < 40) {
+            return nullptr;
+        }
+        size_t num_points = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(content + 36)));
+        size_t xy_start = 40;
+        if (xy_start + num_points * 16 > length) {
+            return nullptr;
+        }
+        size_t z_start = xy_start + num_points * 16 + 16;
+        bool read_z = has_z && z_start + num_points * 8 <= length;
+        CoordinateList coords;
+        coords.reserve(num_points);
+        for (size_t i = 0; i < num_points; ++i) {
+            const uint8_t* p = content + xy_start + i * 16;
+            if (read_z) {
+                coords.push_back(Coordinate(ReadDoubleLE(p), ReadDoubleLE(p + 8),
+                                            ReadDoubleLE(content + z_start + i * 8)));
+            } else {
+                coords.push_back(Coordinate(ReadDoubleLE(p), ReadDoubleLE(p + 8)));
+            }
+        }
+        return MultiPoint::Create(coords);
+    }
+
+    if (base_type != kShapeArc && base_type != kShapePolygon) {
+        return nullptr;
+    }
+    if (length < 44) {
+        return nullptr;
+    }
+    size_t num_parts = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(content + 36)));
+    size_t num_points = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(content + 40)));
+    size_t parts_start = 44;
+    size_t xy_start = parts_start + num_parts * 4;
+    if (num_parts == 0 || xy_start + num_points * 16 > length) {
+        return nullptr;
+    }
+    size_t z_start = xy_start + num_points * 16 + 16;
+    bool read_z = has_z && z_start + num_points * 8 <= length;
+
+    std::vector<CoordinateList> parts(num_parts);
+    for (size_t part = 0; part < num_parts; ++part) {
+        size_t begin = static_cast<size_t>(static_cast<uint32_t>(
+            ReadInt32LE(content + parts_start + part * 4)));
+        size_t end = part + 1 < num_parts
+            ? static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(content + parts_start + (part + 1) * 4)))
+            : num_points;
+        if (begin > end || end > num_points) {
+            return nullptr;
+        }
+        parts[part].reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            const uint8_t* p = content + xy_start + i * 16;
+            if (read_z) {
+                parts[part].push_back(Coordinate(ReadDoubleLE(p), ReadDoubleLE(p + 8),
+                                                 ReadDoubleLE(content + z_start + i * 8)));
+            } else {
+                parts[part].push_back(Coordinate(ReadDoubleLE(p), ReadDoubleLE(p + 8)));
+            }
+        }
+    }
+
+    if (base_type == kShapeArc) {
+        if (parts.size() == 1) {
+            return LineString::Create(std::move(parts[0]));
+        }
+        auto multi = MultiLineString::Create();
+        for (auto& part : parts) {
+            multi->AddLineString(LineString::Create(std::move(part)));
+        }
+        return GeometryPtr(std::move(multi));
+    }
+
+    // Outer rings are clockwise (negative signed area), holes counter-clockwise.
+    // Each hole goes to the outer ring whose envelope holds its first vertex.
+    std::vector<PolygonPtr> polygons;
+    std::vector<Envelope> outer_extents;
+    std::vector<size_t> holes;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (parts[i].size() < 3) {
+            continue;
+        }
+        if (SignedRingArea(parts[i]) <= 0.0) {
+            outer_extents.push_back(Envelope(parts[i]));
+            polygons.push_back(Polygon::Create(LinearRing::Create(parts[i], true)));
+        } else {
+            holes.push_back(i);
+        }
+    }
+    for (size_t hole : holes) {
+        if (polygons.empty()) {
+            outer_extents.push_back(Envelope(parts[hole]));
+            polygons.push_back(Polygon::Create(LinearRing::Create(parts[hole], true)));
+            continue;
+        }
+        size_t owner = polygons.size() - 1;
+        for (size_t j = 0; j < outer_extents.size(); ++j) {
+            if (outer_extents[j].Contains(parts[hole][0])) {
+                owner = j;
+                break;
+            }
+        }
+        polygons[owner]->AddInteriorRing(LinearRing::Create(parts[hole], true));
+    }
+    if (polygons.empty()) {
+        return nullptr;
+    }
+    if (polygons.size() == 1) {
+        return std::move(polygons[0]);
+    }
+    return MultiPolygon::Create(std::move(polygons));
+}
+
+std::unique_ptr<CNFeature> CNShapefileLayer::Impl::DecodeFeature(int64_t index) const {
+    if (index < 0 || index >= record_count_ || IsDeleted(index)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNFeature> feature(new CNFeature(feature_defn_.get()));
+    feature->SetFID(index);
+
+    const uint8_t* content = nullptr;
+    size_t length = 0;
+    if (GetRecord(index, &content, &length)) {
+        GeometryPtr geometry = DecodeGeometry(content, length);
+        if (geometry) {
+            feature->SetGeometry(std::move(geometry));
+        }
+    }
+
+    if (!dbf_.IsOpen() || index >= dbf_record_count_) {
+        return feature;
+    }
+    const char* record = reinterpret_cast<const char*>(dbf_.Data()) +
+                         dbf_header_size_ + static_cast<size_t>(index) * dbf_record_size_;
+    if (dbf_header_size_ + static_cast<size_t>(index + 1) * dbf_record_size_ > dbf_.Size()) {
+        return feature;
+    }
+
+    for (size_t i = 0; i < dbf_fields_.size(); ++i) {
+        const DbfField& field = dbf_fields_[i];
+        const char* data = record + field.offset;
+        size_t size = field.width;
+        TrimField(data, size);
+        if (size == 0) {
+            feature->SetFieldNull(i);
+            continue;
+        }
+        std::string text(data, size);
+        switch (field.field_type) {
+            case CNFieldType::kInteger:
+                feature->SetFieldInteger(i, static_cast<int32_t>(std::strtol(text.c_str(), nullptr, 10)));
+                break;
+            case CNFieldType::kInteger64:
+                feature->SetFieldInteger64(i, static_cast<int64_t>(std::strtoll(text.c_str(), nullptr, 10)));
+                break;
+            case CNFieldType::kReal:
+                feature->SetFieldReal(i, std::strtod(text.c_str(), nullptr));
+                break;
+            case CNFieldType::kBoolean:
+                if (std::strchr("TtYy", text[0])) {
+                    feature->SetField(i, CNFieldValue(true));
+                } else if (std::strchr("FfNn", text[0])) {
+                    feature->SetField(i, CNFieldValue(false));
+                } else {
+                    feature->SetFieldNull(i);
+                }
+                break;
+            case CNFieldType::kDate:
+                if (size == 8) {
+                    feature->SetFieldDateTime(i, CNDateTime(std::atoi(text.substr(0, 4).c_str()),
+                                                            std::atoi(text.substr(4, 2).c_str()),
+                                                            std::atoi(text.substr(6, 2).c_str())));
+                } else {
+                    feature->SetFieldNull(i);
+                }
+                break;
+            default:
+                feature->SetFieldString(i, text);
+                break;
+        }
+    }
+    return feature;
+}
+
+bool CNShapefileLayer::Impl::LoadSpatialIndex() {
+    std::string qix_path = SidecarPath(path_, ".qix");
+    if (qix_file_.Open(qix_path)) {
+        const uint8_t* data = qix_file_.Data();
+        if (qix_file_.Size() > kQixHeaderSize && std::memcmp(data, "SQT", 3) == 0 &&
+            data[3] == 1 && ReadInt32LE(data + 8) == record_count_) {
+            qix_ = data;
+            qix_size_ = qix_file_.Size();
+            return true;
+        }
+        qix_file_.Close();
+    }
+    BuildSpatialIndex(qix_path);
+    return qix_ != nullptr;
+}
+
+void CNShapefileLayer::Impl::BuildSpatialIndex(const std::string& qix_path) {
+    Envelope bounds = extent_;
+    if (bounds.IsNull()) {
+        return;
+    }
+    int max_depth = 0;
+    for (int64_t nodes = 1; nodes * 4 < record_count_ && max_depth < kQixMaxDepth; nodes *= 2) {
+        ++max_depth;
+    }
+
+    QuadNode root(bounds);
+    for (int64_t i = 0; i < record_count_; ++i) {
+        Envelope env;
+        if (GetRecordEnvelope(i, env)) {
+            root.Insert(static_cast<int32_t>(i), env, 0, max_depth);
+        }
+    }
+
+    qix_memory_.clear();
+    qix_memory_.push_back('S');
+    qix_memory_.push_back('Q');
+    qix_memory_.push_back('T');
+    qix_memory_.push_back(1);
+    qix_memory_.push_back(1);
+    qix_memory_.push_back(0);
+    qix_memory_.push_back(0);
+    qix_memory_.push_back(0);
+    AppendInt32LE(qix_memory_, static_cast<int32_t>(record_count_));
+    AppendInt32LE(qix_memory_, max_depth);
+    root.Write(qix_memory_);
+
+    std::ofstream file(qix_path, std::ios::binary);
+    if (file) {
+        file.write(reinterpret_cast<const char*>(qix_memory_.data()),
+                   static_cast<std::streamsize>(qix_memory_.size()));
+    }
+    if (file) {
+        file.close();
+        if (qix_file_.Open(qix_path) && qix_file_.Size() == qix_memory_.size()) {
+            std::vector<uint8_t>().swap(qix_memory_);
+            qix_ = qix_file_.Data();
+            qix_size_ = qix_file_.Size();
+            return;
+        }
+        qix_file_.Close();
+    }
+    qix_ = qix_memory_.data();
+    qix_size_ = qix_memory_.size();
+}
+
+bool CNShapefileLayer::Impl::QueryIndex(const Envelope& env, std::vector<int32_t>& ids) const {
+    if (!qix_) {
+        return false;
+    }
+    if (!QueryNode(kQixHeaderSize, qix_size_, env, ids)) {
+        ids.clear();
+        return false;
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return true;
+}
+
+bool CNShapefileLayer::Impl::QueryNode(size_t pos, size_t end, const Envelope& env,
+                                       std::vector<int32_t>& ids) const {
+    if (pos + 44 > end) {
+        return false;
+    }
+    const uint8_t* node = qix_ + pos;
+    size_t children_size = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(node)));
+    size_t num_ids = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(node + 36)));
+    size_t children_pos = pos + 44 + num_ids * 4;
+    if (children_pos > end || children_pos + children_size > end) {
+        return false;
+    }
+
+    Envelope bounds(ReadDoubleLE(node + 4), ReadDoubleLE(node + 12),
+                    ReadDoubleLE(node + 20), ReadDoubleLE(node + 28));
+    if (!bounds.Intersects(env)) {
+        return true;
+    }
+
+    for (size_t i = 0; i < num_ids; ++i) {
+        ids.push_back(ReadInt32LE(node + 40 + i * 4));
+    }
+    int32_t num_children = ReadInt32LE(qix_ + children_pos - 4);
+    size_t child_pos = children_pos;
+    size_t children_end = children_pos + children_size;
+    for (int32_t i = 0; i < num_children; ++i) {
+        if (child_pos + 44 > children_end) {
+            return false;
+        }
+        size_t child_ids = static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(qix_ + child_pos + 36)));
+        size_t child_size = 44 + child_ids * 4 +
+                            static_cast<size_t>(static_cast<uint32_t>(ReadInt32LE(qix_ + child_pos)));
+        if (!QueryNode(child_pos, children_end, env, ids)) {
+            return false;
+        }
+        child_pos += child_size;
+    }
+    return true;
+}
+
+void CNShapefileLayer::Impl::PrepareReading() {
+    read_cursor_ = 0;
+    candidates_.clear();
+    use_candidates_ = false;
+    if (filter_extent_.IsNull()) {
+        return;
+    }
+    if (!qix_ && !LoadSpatialIndex()) {
+        return;
+    }
+    use_candidates_ = QueryIndex(filter_extent_, candidates_);
+}
+
+bool CNShapefileLayer::Impl::PassesFilter(int64_t index) const {
+    if (filter_extent_.IsNull()) {
+        return true;
+    }
+    Envelope env;
+    return GetRecordEnvelope(index, env) && env.Intersects(filter_extent_);
+}
+
 CNShapefileLayer::CNShapefileLayer()
     : impl_(new Impl()) {
 }
@@ -36,9 +795,23 @@ CNShapefileLayer::~CNShapefileLayer() = default;
 
 std::unique_ptr<CNVectorLayer> CNShapefileLayer::Open(
     const std::string& path, bool update) {
-    (void)path;
-    (void)update;
-    return nullptr;
+    if (update || !EndsWith(path, ".shp")) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CNShapefileLayer> layer(new CNShapefileLayer());
+    Impl& impl = *layer->impl_;
+    impl.path_ = path;
+    size_t slash = path.find_last_of("/\\");
+    impl.name_ = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    impl.name_.resize(impl.name_.size() - 4);
+    impl.filter_extent_.SetNull();
+
+    if (!impl.OpenFiles(path)) {
+        return nullptr;
+    }
+    impl.LoadSpatialIndex();
+    return std::unique_ptr<CNVectorLayer>(layer.release());
 }
 
 std::unique_ptr<CNVectorLayer> CNShapefileLayer::Create(
@@ -94,12 +867,30 @@ CNStatus CNShapefileLayer::GetExtent(Envelope& extent, bool force) const {
 }
 
 int64_t CNShapefileLayer::GetFeatureCount(bool force) const {
-    (void)force;
-    return static_cast<int64_t>(impl_->features_.size());
+    if (impl_->filter_extent_.IsNull() || !force) {
+        return impl_->record_count_;
+    }
+
+    std::vector<int32_t> ids;
+    int64_t count = 0;
+    if (impl_->QueryIndex(impl_->filter_extent_, ids)) {
+        for (int32_t id : ids) {
+            if (!impl_->IsDeleted(id) && impl_->PassesFilter(id)) {
+                ++count;
+            }
+        }
+        return count;
+    }
+    for (int64_t i = 0; i < impl_->record_count_; ++i) {
+        if (!impl_->IsDeleted(i) && impl_->PassesFilter(i)) {
+            ++count;
+        }
+    }
+    return count;
 }
 
 void CNShapefileLayer::ResetReading() {
-    impl_->read_cursor_ = 0;
+    impl_->PrepareReading();
 }
 
 std::unique_ptr<CNFeature> CNShapefileLayer::GetNextFeature() {
@@ -107,22 +898,36 @@ std::unique_ptr<CNFeature> CNShapefileLayer::GetNextFeature() {
     if (!feature) {
         return nullptr;
     }
-    return std::unique_ptr<CNFeature>(feature->Clone());
+    return std::unique_ptr<CNFeature>(impl_->current_.release());
 }
 
 CNFeature* CNShapefileLayer::GetNextFeatureRef() {
-    if (impl_->read_cursor_ >= impl_->features_.size()) {
-        return nullptr;
+    Impl& impl = *impl_;
+    while (true) {
+        int64_t index;
+        if (impl.use_candidates_) {
+            if (impl.read_cursor_ >= impl.candidates_.size()) {
+                return nullptr;
+            }
+            index = impl.candidates_[impl.read_cursor_++];
+        } else {
+            if (impl.read_cursor_ >= static_cast<size_t>(impl.record_count_)) {
+                return nullptr;
+            }
+            index = static_cast<int64_t>(impl.read_cursor_++);
+        }
+        if (impl.IsDeleted(index) || !impl.PassesFilter(index)) {
+            continue;
+        }
+        impl.current_ = impl.DecodeFeature(index);
+        if (impl.current_) {
+            return impl.current_.get();
+        }
     }
-    return impl_->features_[impl_->read_cursor_++].get();
 }
 
 std::unique_ptr<CNFeature> CNShapefileLayer::GetFeature(int64_t fid) {
-    auto it = impl_->fid_index_.find(fid);
-    if (it == impl_->fid_index_.end()) {
-        return nullptr;
-    }
-    return std::unique_ptr<CNFeature>(impl_->features_[it->second]->Clone());
+    return impl_->DecodeFeature(fid);
 }
 
 CNStatus CNShapefileLayer::SetFeature(const CNFeature* feature) {
@@ -156,12 +961,23 @@ CNStatus CNShapefileLayer::DeleteField(int field_index) {
     return CNStatus::kNotSupported;
 }
 
+void CNShapefileLayer::SetSpatialFilterRect(
+    double min_x, double min_y,
+    double max_x, double max_y) {
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
+}
+
 void CNShapefileLayer::SetSpatialFilter(const CNGeometry* geometry) {
     if (geometry) {
         impl_->spatial_filter_.reset(geometry->Clone().release());
+        impl_->filter_extent_ = geometry->GetEnvelope();
     } else {
         impl_->spatial_filter_.reset();
+        impl_->filter_extent_ = Envelope();
+        impl_->filter_extent_.SetNull();
     }
+    impl_->PrepareReading();
 }
 
 const CNGeometry* CNShapefileLayer::GetSpatialFilter() const {
@@ -179,6 +995,8 @@ bool CNShapefileLayer::TestCapability(CNLayerCapability capability) const {
         case CNLayerCapability::kFastFeatureCount:
         case CNLayerCapability::kFastGetExtent:
             return true;
+        case CNLayerCapability::kFastSpatialFilter:
+            return impl_->qix_ != nullptr;
         case CNLayerCapability::kSequentialWrite:
         case CNLayerCapability::kRandomWrite:
         case CNLayerCapability::kCreateFeature:
@@ -191,7 +1009,38 @@ bool CNShapefileLayer::TestCapability(CNLayerCapability capability) const {
 }
 
 std::unique_ptr<CNLayer> CNShapefileLayer::Clone() const {
-    return nullptr;
+    std::unique_ptr<CNVectorLayer> layer = Open(impl_->path_);
+    if (!layer) {
+        return nullptr;
+    }
+    layer->SetSpatialFilter(impl_->spatial_filter_.get());
+    layer->SetAttributeFilter(impl_->attribute_filter_);
+    return std::unique_ptr<CNLayer>(layer.release());
+}
+
+bool CNShapefileLayer::GetFieldView(int64_t fid, int field_index,
+                                    const char** data, size_t* size) const {
+    const Impl& impl = *impl_;
+    if (!data || !size || !impl.dbf_.IsOpen() || fid < 0 || fid >= impl.dbf_record_count_ ||
+        field_index < 0 || static_cast<size_t>(field_index) >= impl.dbf_fields_.size() ||
+        impl.IsDeleted(fid)) {
+        return false;
+    }
+    size_t record = impl.dbf_header_size_ + static_cast<size_t>(fid) * impl.dbf_record_size_;
+    if (record + impl.dbf_record_size_ > impl.dbf_.Size()) {
+        return false;
+    }
+    const Impl::DbfField& field = impl.dbf_fields_[static_cast<size_t>(field_index)];
+    const char* view = reinterpret_cast<const char*>(impl.dbf_.Data()) + record + field.offset;
+    size_t view_size = field.width;
+    TrimField(view, view_size);
+    *data = view;
+    *size = view_size;
+    return true;
+}
+
+bool CNShapefileLayer::HasSpatialIndex() const {
+    return impl_->qix_ != nullptr;
 }
 
 } // namespace ogc
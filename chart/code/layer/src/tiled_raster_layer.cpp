@@ -0,0 +1,1668 @@
+#include "ogc/layer/tiled_raster_layer.h"
+#include "mapped_file.h"
+
+#include "ogc/feature/feature.h"
+#include "ogc/geom/envelope.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+#ifdef OGC_LAYER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OGC_RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace ogc {
+
+// ---------------------------------------------------------------------------
+// CNRasterBlockCache
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct BlockKeyHash {
+    size_t operator()(const CNRasterBlockCache::Key& key) const {
+        uint64_t h = key.owner * 0x9E3779B97F4A7C15ULL;
+        h ^= static_cast<uint64_t>(key.block) + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        h ^= (static_cast<uint64_t>(key.level) << 32 | static_cast<uint32_t>(key.plane)) +
+             0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h);
+    }
+};
+
+} // namespace
+
+class CNRasterBlockCache::Impl {
+public:
+    struct Entry {
+        Key key;
+        Block block;
+        size_t bytes;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    void EvictLocked() {
+        while (size_ > capacity_ && !lru_.empty()) {
+            Entry& victim = lru_.back();
+            size_ -= victim.bytes;
+            index_.erase(victim.key);
+            lru_.pop_back();
+        }
+    }
+
+    mutable std::mutex mutex_;
+    EntryList lru_;
+    std::unordered_map<Key, EntryList::iterator, BlockKeyHash> index_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+CNRasterBlockCache::CNRasterBlockCache(size_t capacity_bytes)
+    : impl_(new Impl()) {
+    impl_->capacity_ = capacity_bytes;
+}
+
+CNRasterBlockCache::~CNRasterBlockCache() = default;
+
+std::shared_ptr<CNRasterBlockCache> CNRasterBlockCache::GetDefault() {
+    static std::shared_ptr<CNRasterBlockCache> cache = std::make_shared<CNRasterBlockCache>();
+    return cache;
+}
+
+uint64_t CNRasterBlockCache::NewOwnerId() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id.fetch_add(1);
+}
+
+CNRasterBlockCache::Block CNRasterBlockCache::Find(const Key& key) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    auto it = impl_->index_.find(key);
+    if (it == impl_->index_.end()) {
+        ++impl_->misses_;
+        return Block();
+    }
+    ++impl_->hits_;
+    impl_->lru_.splice(impl_->lru_.begin(), impl_->lru_, it->second);
+    return it->second->block;
+}
+
+void CNRasterBlockCache::Insert(const Key& key, Block block) {
+    if (!block) {
+        return;
+    }
+    size_t bytes = block->size();
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    auto it = impl_->index_.find(key);
+    if (it != impl_->index_.end()) {
+        impl_->size_ -= it->second->bytes;
+        impl_->lru_.erase(it->second);
+        impl_->index_.erase(it);
+    }
+    if (bytes > impl_->capacity_) {
+        return;
+    }
+    Impl::Entry entry;
+    entry.key = key;
+    entry.block = std::move(block);
+    entry.bytes = bytes;
+    impl_->lru_.push_front(std::move(entry));
+    impl_->index_[key] = impl_->lru_.begin();
+    impl_->size_ += bytes;
+    impl_->EvictLocked();
+}
+
+void CNRasterBlockCache::Erase(uint64_t owner) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    for (auto it = impl_->lru_.begin(); it != impl_->lru_.end();) {
+        if (it->key.owner == owner) {
+            impl_->size_ -= it->bytes;
+            impl_->index_.erase(it->key);
+            it = impl_->lru_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CNRasterBlockCache::Clear() {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    impl_->lru_.clear();
+    impl_->index_.clear();
+    impl_->size_ = 0;
+}
+
+void CNRasterBlockCache::SetCapacity(size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    impl_->capacity_ = capacity_bytes;
+    impl_->EvictLocked();
+}
+
+size_t CNRasterBlockCache::GetCapacity() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->capacity_;
+}
+
+size_t CNRasterBlockCache::GetSize() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->size_;
+}
+
+size_t CNRasterBlockCache::GetBlockCount() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->lru_.size();
+}
+
+uint64_t CNRasterBlockCache::GetHitCount() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->hits_;
+}
+
+uint64_t CNRasterBlockCache::GetMissCount() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->misses_;
+}
+
+// ---------------------------------------------------------------------------
+// TIFF directory parsing
+// ---------------------------------------------------------------------------
+
+namespace {
+
+enum TiffTag {
+    kTagNewSubfileType = 254,
+    kTagImageWidth = 256,
+    kTagImageLength = 257,
+    kTagBitsPerSample = 258,
+    kTagCompression = 259,
+    kTagStripOffsets = 273,
+    kTagSamplesPerPixel = 277,
+    kTagRowsPerStrip = 278,
+    kTagStripByteCounts = 279,
+    kTagPlanarConfig = 284,
+    kTagPredictor = 317,
+    kTagTileWidth = 322,
+    kTagTileLength = 323,
+    kTagTileOffsets = 324,
+    kTagTileByteCounts = 325,
+    kTagSampleFormat = 339,
+    kTagModelPixelScale = 33550,
+    kTagModelTiepoint = 33922,
+    kTagModelTransformation = 34264,
+    kTagGdalNoData = 42113
+};
+
+enum TiffType {
+    kTypeByte = 1,
+    kTypeAscii = 2,
+    kTypeShort = 3,
+    kTypeLong = 4,
+    kTypeRational = 5,
+    kTypeSByte = 6,
+    kTypeUndefined = 7,
+    kTypeSShort = 8,
+    kTypeSLong = 9,
+    kTypeSRational = 10,
+    kTypeFloat = 11,
+    kTypeDouble = 12,
+    kTypeLong8 = 16,
+    kTypeSLong8 = 17,
+    kTypeIfd8 = 18
+};
+
+const int kCompressionNone = 1;
+const int kCompressionDeflate = 8;
+const int kCompressionAdobeDeflate = 32946;
+
+const int kSubfileReducedImage = 1;
+const int kSubfileMask = 4;
+
+const int kMaxDirectories = 256;
+
+size_t TiffTypeSize(int type) {
+    switch (type) {
+        case kTypeByte:
+        case kTypeAscii:
+        case kTypeSByte:
+        case kTypeUndefined:
+            return 1;
+        case kTypeShort:
+        case kTypeSShort:
+            return 2;
+        case kTypeLong:
+        case kTypeSLong:
+        case kTypeFloat:
+            return 4;
+        case kTypeRational:
+        case kTypeSRational:
+        case kTypeDouble:
+        case kTypeLong8:
+        case kTypeSLong8:
+        case kTypeIfd8:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+size_t DataTypeSize(CNDataType type) {
+    switch (type) {
+        case CNDataType::kByte:
+            return 1;
+        case CNDataType::kUInt16:
+        case CNDataType::kInt16:
+            return 2;
+        case CNDataType::kUInt32:
+        case CNDataType::kInt32:
+        case CNDataType::kFloat32:
+            return 4;
+        case CNDataType::kFloat64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+struct TiffEntry {
+    int type = 0;
+    uint64_t count = 0;
+    size_t value_offset = 0;
+};
+
+/**
+ * Bounds-checked reader over the mapped file in the file's byte order.
+ */
+class TiffReader {
+public:
+    TiffReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool ReadHeader(uint64_t* first_ifd) {
+        if (size_ < 8) {
+            return false;
+        }
+        if (data_[0] == 'I' && data_[1] == 'I') {
+            big_endian_ = false;
+        } else if (data_[0] == 'M' && data_[1] == 'M') {
+            big_endian_ = true;
+        } else {
+            return false;
+        }
+        uint16_t magic = U16(2);
+        if (magic == 42) {
+            big_tiff_ = false;
+            *first_ifd = U32(4);
+            return true;
+        }
+        if (magic == 43 && size_ >= 16 && U16(4) == 8 && U16(6) == 0) {
+            big_tiff_ = true;
+            *first_ifd = U64(8);
+            return true;
+        }
+        return false;
+    }
+
+    bool ReadDirectory(uint64_t offset, std::unordered_map<int, TiffEntry>* entries,
+                       uint64_t* next) const {
+        size_t count_size = big_tiff_ ? 8 : 2;
+        size_t entry_size = big_tiff_ ? 20 : 12;
+        size_t inline_size = big_tiff_ ? 8 : 4;
+        if (!InRange(offset, count_size)) {
+            return false;
+        }
+        uint64_t count = big_tiff_ ? U64(offset) : U16(offset);
+        size_t pos = static_cast<size_t>(offset) + count_size;
+        if (count > (size_ - pos) / entry_size || !InRange(pos + count * entry_size,
+                                                            big_tiff_ ? 8 : 4)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i, pos += entry_size) {
+            TiffEntry entry;
+            int tag = U16(pos);
+            entry.type = U16(pos + 2);
+            entry.count = big_tiff_ ? U64(pos + 4) : U32(pos + 4);
+            size_t value_pos = pos + (big_tiff_ ? 12 : 8);
+            size_t type_size = TiffTypeSize(entry.type);
+            if (type_size == 0 || entry.count > size_ / type_size) {
+                continue;
+            }
+            uint64_t bytes = entry.count * type_size;
+            if (bytes <= inline_size) {
+                entry.value_offset = value_pos;
+            } else {
+                uint64_t value = big_tiff_ ? U64(value_pos) : U32(value_pos);
+                if (!InRange(value, static_cast<size_t>(bytes))) {
+                    continue;
+                }
+                entry.value_offset = static_cast<size_t>(value);
+            }
+            (*entries)[tag] = entry;
+        }
+        *next = big_tiff_ ? U64(pos) : U32(pos);
+        return true;
+    }
+
+    bool GetUInts(const TiffEntry& entry, std::vector<uint64_t>* values) const {
+        values->clear();
+        values->reserve(static_cast<size_t>(entry.count));
+        size_t step = TiffTypeSize(entry.type);
+        for (uint64_t i = 0; i < entry.count; ++i) {
+            size_t pos = entry.value_offset + static_cast<size_t>(i) * step;
+            switch (entry.type) {
+                case kTypeByte:
+                case kTypeUndefined:
+                    values->push_back(data_[pos]);
+                    break;
+                case kTypeShort:
+                    values->push_back(U16(pos));
+                    break;
+                case kTypeLong:
+                    values->push_back(U32(pos));
+                    break;
+                case kTypeLong8:
+                case kTypeIfd8:
+                    values->push_back(U64(pos));
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool GetUInt(const std::unordered_map<int, TiffEntry>& entries, int tag,
+                 uint64_t* value) const {
+        auto it = entries.find(tag);
+        std::vector<uint64_t> values;
+        if (it == entries.end() || !GetUInts(it->second, &values) || values.empty()) {
+            return false;
+        }
+        *value = values[0];
+        return true;
+    }
+
+    bool GetDoubles(const TiffEntry& entry, std::vector<double>* values) const {
+        values->clear();
+        size_t step = TiffTypeSize(entry.type);
+        for (uint64_t i = 0; i < entry.count; ++i) {
+            size_t pos = entry.value_offset + static_cast<size_t>(i) * step;
+            switch (entry.type) {
+                case kTypeDouble: {
+                    uint64_t bits = U64(pos);
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    values->push_back(value);
+                    break;
+                }
+                case kTypeFloat: {
+                    uint32_t bits = U32(pos);
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    values->push_back(value);
+                    break;
+                }
+                case kTypeShort:
+                    values->push_back(U16(pos));
+                    break;
+                case kTypeLong:
+                    values->push_back(U32(pos));
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    std::string GetAscii(const TiffEntry& entry) const {
+        if (entry.type != kTypeAscii) {
+            return std::string();
+        }
+        const char* text = reinterpret_cast<const char*>(data_ + entry.value_offset);
+        size_t length = static_cast<size_t>(entry.count);
+        while (length > 0 && text[length - 1] == '\0') {
+            --length;
+        }
+        return std::string(text, length);
+    }
+
+    bool BigEndian() const { return big_endian_; }
+
+private:
+    bool InRange(uint64_t offset, size_t length) const {
+        return offset <= size_ && length <= size_ - static_cast<size_t>(offset);
+    }
+
+    uint16_t U16(size_t pos) const {
+        const uint8_t* p = data_ + pos;
+        return big_endian_ ? static_cast<uint16_t>((p[0] << 8) | p[1])
+                           : static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t U32(size_t pos) const {
+        const uint8_t* p = data_ + pos;
+        if (big_endian_) {
+            return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        }
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    uint64_t U64(size_t pos) const {
+        uint64_t a = U32(pos);
+        uint64_t b = U32(pos + 4);
+        return big_endian_ ? (a << 32) | b : (b << 32) | a;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    bool big_endian_ = false;
+    bool big_tiff_ = false;
+};
+
+bool MapDataType(int sample_format, int bits, CNDataType* type) {
+    if (sample_format == 1) {
+        if (bits == 8) { *type = CNDataType::kByte; return true; }
+        if (bits == 16) { *type = CNDataType::kUInt16; return true; }
+        if (bits == 32) { *type = CNDataType::kUInt32; return true; }
+    } else if (sample_format == 2) {
+        if (bits == 16) { *type = CNDataType::kInt16; return true; }
+        if (bits == 32) { *type = CNDataType::kInt32; return true; }
+    } else if (sample_format == 3) {
+        if (bits == 32) { *type = CNDataType::kFloat32; return true; }
+        if (bits == 64) { *type = CNDataType::kFloat64; return true; }
+    }
+    return false;
+}
+
+void SwapSamples(uint8_t* data, size_t size, size_t sample_size) {
+    for (size_t i = 0; i + sample_size <= size; i += sample_size) {
+        std::reverse(data + i, data + i + sample_size);
+    }
+}
+
+template <typename T>
+void UndoHorizontalDifferencing(uint8_t* data, size_t rows, size_t row_samples,
+                                size_t channels) {
+    T* samples = reinterpret_cast<T*>(data);
+    for (size_t y = 0; y < rows; ++y) {
+        T* row = samples + y * row_samples;
+        for (size_t i = channels; i < row_samples; ++i) {
+            row[i] = static_cast<T>(row[i] + row[i - channels]);
+        }
+    }
+}
+
+#ifdef OGC_LAYER_HAVE_ZLIB
+bool Inflate(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = const_cast<Bytef*>(src);
+    stream.avail_in = static_cast<uInt>(src_size);
+    stream.next_out = dst;
+    stream.avail_out = static_cast<uInt>(dst_size);
+    int result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    // Encoders may pad the stream, so a full output buffer is enough.
+    return result == Z_STREAM_END || stream.avail_out == 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Sample conversion and resampling kernels
+// ---------------------------------------------------------------------------
+
+template <typename S, typename W>
+void LoadSamples(const uint8_t* src, size_t stride, size_t count, W* out) {
+    const S* samples = reinterpret_cast<const S*>(src);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<W>(samples[i * stride]);
+    }
+}
+
+template <typename W>
+void LoadSamples(CNDataType type, const uint8_t* src, size_t stride, size_t count, W* out) {
+    switch (type) {
+        case CNDataType::kByte:    LoadSamples<uint8_t>(src, stride, count, out); break;
+        case CNDataType::kUInt16:  LoadSamples<uint16_t>(src, stride, count, out); break;
+        case CNDataType::kInt16:   LoadSamples<int16_t>(src, stride, count, out); break;
+        case CNDataType::kUInt32:  LoadSamples<uint32_t>(src, stride, count, out); break;
+        case CNDataType::kInt32:   LoadSamples<int32_t>(src, stride, count, out); break;
+        case CNDataType::kFloat32: LoadSamples<float>(src, stride, count, out); break;
+        case CNDataType::kFloat64: LoadSamples<double>(src, stride, count, out); break;
+        default: break;
+    }
+}
+
+template <typename T, typename W>
+void StoreIntegers(const W* src, size_t count, T* dst) {
+    const W lo = static_cast<W>(std::numeric_limits<T>::min());
+    const W hi = static_cast<W>(std::numeric_limits<T>::max());
+    for (size_t i = 0; i < count; ++i) {
+        W value = src[i];
+        if (!(value == value)) {
+            dst[i] = 0;
+            continue;
+        }
+        value = std::floor(value + W(0.5));
+        dst[i] = value <= lo ? std::numeric_limits<T>::min()
+                 : value >= hi ? std::numeric_limits<T>::max()
+                 : static_cast<T>(value);
+    }
+}
+
+void StoreBytes(const float* src, size_t count, uint8_t* dst) {
+    size_t i = 0;
+#ifdef OGC_RASTER_SSE2
+    // Clamp first (max_ps maps NaN to 0), then round half up like the
+    // scalar path.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 16 <= count; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * k), zero), top);
+            q[k] = _mm_cvttps_epi32(_mm_add_ps(v, half));
+        }
+        __m128i low = _mm_packs_epi32(q[0], q[1]);
+        __m128i high = _mm_packs_epi32(q[2], q[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    StoreIntegers(src + i, count - i, dst + i);
+}
+
+void StoreBytes(const double* src, size_t count, uint8_t* dst) {
+    StoreIntegers(src, count, dst);
+}
+
+template <typename W>
+void StoreSamples(const W* src, size_t count, CNDataType type, uint8_t* dst) {
+    switch (type) {
+        case CNDataType::kByte:
+            StoreBytes(src, count, dst);
+            break;
+        case CNDataType::kUInt16:
+            StoreIntegers(src, count, reinterpret_cast<uint16_t*>(dst));
+            break;
+        case CNDataType::kInt16:
+            StoreIntegers(src, count, reinterpret_cast<int16_t*>(dst));
+            break;
+        case CNDataType::kUInt32:
+            StoreIntegers(src, count, reinterpret_cast<uint32_t*>(dst));
+            break;
+        case CNDataType::kInt32:
+            StoreIntegers(src, count, reinterpret_cast<int32_t*>(dst));
+            break;
+        case CNDataType::kFloat32: {
+            float* out = reinterpret_cast<float*>(dst);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<float>(src[i]);
+            }
+            break;
+        }
+        case CNDataType::kFloat64: {
+            double* out = reinterpret_cast<double*>(dst);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<double>(src[i]);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// out[i] = a[i] + (b[i] - a[i]) * t[i]
+void Lerp(const float* a, const float* b, const float* t, float* out, size_t count) {
+    size_t i = 0;
+#ifdef OGC_RASTER_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vd = _mm_sub_ps(_mm_loadu_ps(b + i), va);
+        _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(vd, _mm_loadu_ps(t + i))));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * t[i];
+    }
+}
+
+void Lerp(const double* a, const double* b, const double* t, double* out, size_t count) {
+    size_t i = 0;
+#ifdef OGC_RASTER_SSE2
+    for (; i + 2 <= count; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i);
+        __m128d vd = _mm_sub_pd(_mm_loadu_pd(b + i), va);
+        _mm_storeu_pd(out + i, _mm_add_pd(va, _mm_mul_pd(vd, _mm_loadu_pd(t + i))));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * t[i];
+    }
+}
+
+// out[i] = a[i] + (b[i] - a[i]) * t
+void Lerp(const float* a, const float* b, float t, float* out, size_t count) {
+    size_t i = 0;
+#ifdef OGC_RASTER_SSE2
+    __m128 vt = _mm_set1_ps(t);
+    for (; i + 4 <= count; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vd = _mm_sub_ps(_mm_loadu_ps(b + i), va);
+        _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(vd, vt)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+void Lerp(const double* a, const double* b, double t, double* out, size_t count) {
+    size_t i = 0;
+#ifdef OGC_RASTER_SSE2
+    __m128d vt = _mm_set1_pd(t);
+    for (; i + 2 <= count; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i);
+        __m128d vd = _mm_sub_pd(_mm_loadu_pd(b + i), va);
+        _mm_storeu_pd(out + i, _mm_add_pd(va, _mm_mul_pd(vd, vt)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+/**
+ * Source row of the level being resampled, fetched over the columns the
+ * output needs and gathered at each output column's neighbours.
+ */
+template <typename W>
+struct SourceRow {
+    int y = -1;
+    std::vector<W> samples;
+    std::vector<W> left;
+    std::vector<W> right;
+    std::vector<W> blend;
+};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// CNTiledRasterLayer
+// ---------------------------------------------------------------------------
+
+class CNTiledRasterBand : public CNRasterBand {
+public:
+    CNTiledRasterBand(CNTiledRasterLayer* layer, int index) : layer_(layer), index_(index) {}
+
+    int GetWidth() const override { return layer_->GetWidth(); }
+    int GetHeight() const override { return layer_->GetHeight(); }
+    CNDataType GetDataType() const override { return layer_->GetDataType(); }
+
+    int GetNoDataValue(double& value) const override {
+        value = layer_->GetNoDataValue();
+        return layer_->HasNoDataValue() ? 1 : 0;
+    }
+
+    double GetNoDataValue() const override { return layer_->GetNoDataValue(); }
+
+    CNStatus ReadRaster(int x_offset, int y_offset, int width, int height,
+                        void* buffer, CNDataType buffer_type) override {
+        return layer_->ReadWindow(x_offset, y_offset, width, height, buffer,
+                                  width, height, buffer_type, &index_, 1);
+    }
+
+    CNStatus WriteRaster(int x_offset, int y_offset, int width, int height,
+                         const void* buffer, CNDataType buffer_type) override {
+        (void)x_offset; (void)y_offset; (void)width; (void)height;
+        (void)buffer; (void)buffer_type;
+        return CNStatus::kNotSupported;
+    }
+
+    // Approximate statistics from the coarsest level.
+    double GetMinimum() const override {
+        ComputeStatistics();
+        return minimum_;
+    }
+
+    double GetMaximum() const override {
+        ComputeStatistics();
+        return maximum_;
+    }
+
+    double GetOffset() const override { return 0.0; }
+    double GetScale() const override { return 1.0; }
+    std::string GetDescription() const override { return "Band " + std::to_string(index_ + 1); }
+
+private:
+    void ComputeStatistics() const;
+
+    CNTiledRasterLayer* layer_;
+    int index_;
+    mutable std::once_flag statistics_once_;
+    mutable double minimum_ = 0.0;
+    mutable double maximum_ = 0.0;
+};
+
+class CNTiledRasterLayer::Impl {
+public:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int block_width = 0;
+        int block_height = 0;
+        bool tiled = false;
+        int blocks_across = 0;
+        int blocks_down = 0;
+        int compression = kCompressionNone;
+        int predictor = 1;
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> byte_counts;
+        // Pixels of an overview built in memory, chunky in the native type.
+        std::vector<uint8_t> pixels;
+    };
+
+    ~Impl() {
+        if (cache_) {
+            cache_->Erase(owner_);
+        }
+    }
+
+    bool Load();
+    bool ParseLevel(const TiffReader& reader,
+                    const std::unordered_map<int, TiffEntry>& entries,
+                    bool first, Level* level);
+    void ParseGeoreference(const TiffReader& reader,
+                           const std::unordered_map<int, TiffEntry>& entries);
+
+    size_t PixelStride() const { return planar_ ? 1 : static_cast<size_t>(band_count_); }
+    size_t BlockBytes(const Level& level) const {
+        return static_cast<size_t>(level.block_width) * level.block_height *
+               PixelStride() * sample_size_;
+    }
+
+    CNRasterBlockCache::Block LoadBlock(int level_index, int plane, int block_x, int block_y);
+    bool DecodeBlock(const Level& level, size_t index, int block_y,
+                     std::vector<uint8_t>* block) const;
+    void FillNoData(std::vector<uint8_t>* block) const;
+
+    template <typename W>
+    bool FetchRow(int level_index, int band, int y, int x_begin, int x_end, W* out);
+
+    template <typename W>
+    CNStatus ReadLevel(int level_index, int x_offset, int y_offset, int x_size, int y_size,
+                       uint8_t* buffer, int buffer_x_size, int buffer_y_size,
+                       CNDataType buffer_type, const std::vector<int>& bands,
+                       CNResampleMethod method);
+
+    bool UsesDoubleWork() const {
+        return data_type_ == CNDataType::kUInt32 || data_type_ == CNDataType::kInt32 ||
+               data_type_ == CNDataType::kFloat64;
+    }
+
+    void StoreNative(double value, uint8_t* dst) const;
+
+    std::string path_;
+    std::string name_;
+    MappedFile file_;
+    bool big_endian_ = false;
+    std::vector<Level> levels_;
+    int band_count_ = 0;
+    int bits_ = 0;
+    int sample_format_ = 1;
+    size_t sample_size_ = 0;
+    bool planar_ = false;
+    CNDataType data_type_ = CNDataType::kByte;
+    bool has_nodata_ = false;
+    double nodata_ = 0.0;
+    std::vector<double> geo_transform_ = {0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+    std::shared_ptr<CNRasterBlockCache> cache_;
+    uint64_t owner_ = 0;
+    std::vector<std::unique_ptr<CNTiledRasterBand>> bands_;
+    std::unique_ptr<CNGeometry> spatial_filter_;
+    std::string attribute_filter_;
+};
+
+bool CNTiledRasterLayer::Impl::ParseLevel(const TiffReader& reader,
+                                          const std::unordered_map<int, TiffEntry>& entries,
+                                          bool first, Level* level) {
+    uint64_t width = 0;
+    uint64_t height = 0;
+    if (!reader.GetUInt(entries, kTagImageWidth, &width) ||
+        !reader.GetUInt(entries, kTagImageLength, &height) ||
+        width == 0 || height == 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF) {
+        return false;
+    }
+
+    uint64_t samples = 1;
+    uint64_t sample_format = 1;
+    uint64_t planar = 1;
+    uint64_t compression = kCompressionNone;
+    uint64_t predictor = 1;
+    reader.GetUInt(entries, kTagSamplesPerPixel, &samples);
+    reader.GetUInt(entries, kTagSampleFormat, &sample_format);
+    reader.GetUInt(entries, kTagPlanarConfig, &planar);
+    reader.GetUInt(entries, kTagCompression, &compression);
+    reader.GetUInt(entries, kTagPredictor, &predictor);
+
+    std::vector<uint64_t> bits(1, 1);
+    auto bits_it = entries.find(kTagBitsPerSample);
+    if (bits_it != entries.end() && (!reader.GetUInts(bits_it->second, &bits) || bits.empty())) {
+        return false;
+    }
+    for (uint64_t b : bits) {
+        if (b != bits[0]) {
+            return false;
+        }
+    }
+
+    if (first) {
+        if (samples == 0 || samples > 0xFFFF ||
+            !MapDataType(static_cast<int>(sample_format), static_cast<int>(bits[0]), &data_type_)) {
+            return false;
+        }
+        band_count_ = static_cast<int>(samples);
+        bits_ = static_cast<int>(bits[0]);
+        sample_format_ = static_cast<int>(sample_format);
+        sample_size_ = DataTypeSize(data_type_);
+        planar_ = planar == 2 && samples > 1;
+    } else if (static_cast<int>(samples) != band_count_ || static_cast<int>(bits[0]) != bits_ ||
+               static_cast<int>(sample_format) != sample_format_ ||
+               (planar == 2 && samples > 1) != planar_) {
+        return false;
+    }
+
+    bool compression_ok = compression == kCompressionNone;
+#ifdef OGC_LAYER_HAVE_ZLIB
+    compression_ok = compression_ok || compression == kCompressionDeflate ||
+                     compression == kCompressionAdobeDeflate;
+#endif
+    if (!compression_ok || (predictor != 1 && (predictor != 2 || sample_format == 3))) {
+        return false;
+    }
+
+    level->width = static_cast<int>(width);
+    level->height = static_cast<int>(height);
+    level->compression = static_cast<int>(compression);
+    level->predictor = static_cast<int>(predictor);
+
+    int offsets_tag = kTagStripOffsets;
+    int counts_tag = kTagStripByteCounts;
+    uint64_t block_width = 0;
+    uint64_t block_height = 0;
+    if (reader.GetUInt(entries, kTagTileWidth, &block_width)) {
+        if (!reader.GetUInt(entries, kTagTileLength, &block_height)) {
+            return false;
+        }
+        offsets_tag = kTagTileOffsets;
+        level->tiled = true;
+        counts_tag = kTagTileByteCounts;
+    } else {
+        block_width = width;
+        block_height = height;
+        reader.GetUInt(entries, kTagRowsPerStrip, &block_height);
+        block_height = std::min(block_height, height);
+    }
+    if (block_width == 0 || block_height == 0 || block_width > 0xFFFF || block_height > 0xFFFF) {
+        return false;
+    }
+    level->block_width = static_cast<int>(block_width);
+    level->block_height = static_cast<int>(block_height);
+    level->blocks_across = static_cast<int>((width + block_width - 1) / block_width);
+    level->blocks_down = static_cast<int>((height + block_height - 1) / block_height);
+
+    auto offsets_it = entries.find(offsets_tag);
+    auto counts_it = entries.find(counts_tag);
+    if (offsets_it == entries.end() || counts_it == entries.end() ||
+        !reader.GetUInts(offsets_it->second, &level->offsets) ||
+        !reader.GetUInts(counts_it->second, &level->byte_counts)) {
+        return false;
+    }
+    size_t expected = static_cast<size_t>(level->blocks_across) * level->blocks_down *
+                      (planar_ ? static_cast<size_t>(band_count_) : 1);
+    return level->offsets.size() == expected && level->byte_counts.size() == expected;
+}
+
+void CNTiledRasterLayer::Impl::ParseGeoreference(
+    const TiffReader& reader, const std::unordered_map<int, TiffEntry>& entries) {
+    std::vector<double> values;
+    auto matrix = entries.find(kTagModelTransformation);
+    auto scale = entries.find(kTagModelPixelScale);
+    auto tiepoint = entries.find(kTagModelTiepoint);
+    if (matrix != entries.end() && reader.GetDoubles(matrix->second, &values) &&
+        values.size() >= 16) {
+        geo_transform_[0] = values[3];
+        geo_transform_[1] = values[0];
+        geo_transform_[2] = values[1];
+        geo_transform_[3] = values[7];
+        geo_transform_[4] = values[4];
+        geo_transform_[5] = values[5];
+    } else if (scale != entries.end() && tiepoint != entries.end()) {
+        std::vector<double> scales;
+        if (reader.GetDoubles(scale->second, &scales) && scales.size() >= 2 &&
+            reader.GetDoubles(tiepoint->second, &values) && values.size() >= 6) {
+            geo_transform_[0] = values[3] - values[0] * scales[0];
+            geo_transform_[1] = scales[0];
+            geo_transform_[2] = 0.0;
+            geo_transform_[3] = values[4] + values[1] * scales[1];
+            geo_transform_[4] = 0.0;
+            geo_transform_[5] = -scales[1];
+        }
+    }
+
+    auto nodata = entries.find(kTagGdalNoData);
+    if (nodata != entries.end()) {
+        std::string text = reader.GetAscii(nodata->second);
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (end != text.c_str()) {
+            has_nodata_ = true;
+            nodata_ = value;
+        }
+    }
+}
+
+bool CNTiledRasterLayer::Impl::Load() {
+    if (!file_.Open(path_)) {
+        return false;
+    }
+    TiffReader reader(file_.Data(), file_.Size());
+    uint64_t offset = 0;
+    if (!reader.ReadHeader(&offset)) {
+        return false;
+    }
+    big_endian_ = reader.BigEndian();
+
+    std::set<uint64_t> visited;
+    while (offset != 0 && visited.size() < static_cast<size_t>(kMaxDirectories) &&
+           visited.insert(offset).second) {
+        std::unordered_map<int, TiffEntry> entries;
+        uint64_t next = 0;
+        if (!reader.ReadDirectory(offset, &entries, &next)) {
+            break;
+        }
+        offset = next;
+
+        bool first = levels_.empty();
+        uint64_t subfile = 0;
+        reader.GetUInt(entries, kTagNewSubfileType, &subfile);
+        if (!first && ((subfile & kSubfileReducedImage) == 0 || (subfile & kSubfileMask) != 0)) {
+            continue;
+        }
+        Level level;
+        if (!ParseLevel(reader, entries, first, &level)) {
+            if (first) {
+                return false;
+            }
+            continue;
+        }
+        if (first) {
+            ParseGeoreference(reader, entries);
+        } else if (level.width >= levels_[0].width && level.height >= levels_[0].height) {
+            continue;
+        }
+        levels_.push_back(std::move(level));
+    }
+    if (levels_.empty()) {
+        return false;
+    }
+    std::stable_sort(levels_.begin() + 1, levels_.end(), [](const Level& a, const Level& b) {
+        return a.width > b.width;
+    });
+    return true;
+}
+
+bool CNTiledRasterLayer::Impl::DecodeBlock(const Level& level, size_t index, int block_y,
+                                           std::vector<uint8_t>* block) const {
+    size_t row_bytes = static_cast<size_t>(level.block_width) * PixelStride() * sample_size_;
+    // The last strip of a stripped image may hold fewer rows.
+    size_t rows = static_cast<size_t>(level.block_height);
+    if (!level.tiled) {
+        rows = std::min<size_t>(rows, static_cast<size_t>(level.height) -
+                                          static_cast<size_t>(block_y) * level.block_height);
+    }
+    size_t expected = rows * row_bytes;
+
+    uint64_t offset = level.offsets[index];
+    uint64_t count = level.byte_counts[index];
+    if (offset == 0 && count == 0) {
+        FillNoData(block);
+        return true;
+    }
+    if (offset > file_.Size() || count > file_.Size() - offset) {
+        return false;
+    }
+    const uint8_t* src = file_.Data() + offset;
+
+    if (level.compression == kCompressionNone) {
+        std::memcpy(block->data(), src, std::min<size_t>(static_cast<size_t>(count), expected));
+    } else {
+#ifdef OGC_LAYER_HAVE_ZLIB
+        if (!Inflate(src, static_cast<size_t>(count), block->data(), expected)) {
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    if (big_endian_ && sample_size_ > 1) {
+        SwapSamples(block->data(), expected, sample_size_);
+    }
+    if (level.predictor == 2) {
+        size_t row_samples = static_cast<size_t>(level.block_width) * PixelStride();
+        switch (sample_size_) {
+            case 1:
+                UndoHorizontalDifferencing<uint8_t>(block->data(), rows, row_samples, PixelStride());
+                break;
+            case 2:
+                UndoHorizontalDifferencing<uint16_t>(block->data(), rows, row_samples, PixelStride());
+                break;
+            case 4:
+                UndoHorizontalDifferencing<uint32_t>(block->data(), rows, row_samples, PixelStride());
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+void CNTiledRasterLayer::Impl::StoreNative(double value, uint8_t* dst) const {
+    switch (data_type_) {
+        case CNDataType::kByte:    StoreIntegers(&value, 1, dst); break;
+        case CNDataType::kUInt16:  StoreIntegers(&value, 1, reinterpret_cast<uint16_t*>(dst)); break;
+        case CNDataType::kInt16:   StoreIntegers(&value, 1, reinterpret_cast<int16_t*>(dst)); break;
+        case CNDataType::kUInt32:  StoreIntegers(&value, 1, reinterpret_cast<uint32_t*>(dst)); break;
+        case CNDataType::kInt32:   StoreIntegers(&value, 1, reinterpret_cast<int32_t*>(dst)); break;
+        case CNDataType::kFloat32: {
+            float f = static_cast<float>(value);
+            std::memcpy(dst, &f, sizeof(f));
+            break;
+        }
+        case CNDataType::kFloat64:
+            std::memcpy(dst, &value, sizeof(value));
+            break;
+        default:
+            break;
+    }
+}
+
+void CNTiledRasterLayer::Impl::FillNoData(std::vector<uint8_t>* block) const {
+    if (!has_nodata_ || nodata_ == 0.0) {
+        std::fill(block->begin(), block->end(), 0);
+        return;
+    }
+    uint8_t sample[8];
+    StoreNative(nodata_, sample);
+    for (size_t i = 0; i + sample_size_ <= block->size(); i += sample_size_) {
+        std::memcpy(block->data() + i, sample, sample_size_);
+    }
+}
+
+CNRasterBlockCache::Block CNTiledRasterLayer::Impl::LoadBlock(int level_index, int plane,
+                                                              int block_x, int block_y) {
+    const Level& level = levels_[static_cast<size_t>(level_index)];
+    CNRasterBlockCache::Key key;
+    key.owner = owner_;
+    key.level = level_index;
+    key.plane = plane;
+    key.block = static_cast<int64_t>(block_y) * level.blocks_across + block_x;
+
+    CNRasterBlockCache::Block block = cache_->Find(key);
+    if (block) {
+        return block;
+    }
+    size_t index = static_cast<size_t>(plane) * level.blocks_across * level.blocks_down +
+                   static_cast<size_t>(key.block);
+    std::shared_ptr<std::vector<uint8_t>> decoded =
+        std::make_shared<std::vector<uint8_t>>(BlockBytes(level), 0);
+    if (!DecodeBlock(level, index, block_y, decoded.get())) {
+        return CNRasterBlockCache::Block();
+    }
+    block = decoded;
+    cache_->Insert(key, block);
+    return block;
+}
+
+template <typename W>
+bool CNTiledRasterLayer::Impl::FetchRow(int level_index, int band, int y,
+                                        int x_begin, int x_end, W* out) {
+    const Level& level = levels_[static_cast<size_t>(level_index)];
+    size_t pixel_bytes = PixelStride() * sample_size_;
+    size_t band_offset = planar_ ? 0 : static_cast<size_t>(band) * sample_size_;
+
+    if (!level.pixels.empty()) {
+        const uint8_t* row = level.pixels.data() +
+                             static_cast<size_t>(y) * level.width * band_count_ * sample_size_;
+        LoadSamples(data_type_, row + static_cast<size_t>(x_begin) * band_count_ * sample_size_ +
+                                    static_cast<size_t>(band) * sample_size_,
+                    static_cast<size_t>(band_count_), static_cast<size_t>(x_end - x_begin), out);
+        return true;
+    }
+
+    int block_y = y / level.block_height;
+    size_t row_in_block = static_cast<size_t>(y - block_y * level.block_height);
+    int plane = planar_ ? band : 0;
+    for (int block_x = x_begin / level.block_width; block_x * level.block_width < x_end; ++block_x) {
+        CNRasterBlockCache::Block block = LoadBlock(level_index, plane, block_x, block_y);
+        if (!block) {
+            return false;
+        }
+        int block_left = block_x * level.block_width;
+        int from = std::max(x_begin, block_left);
+        int to = std::min(x_end, block_left + level.block_width);
+        const uint8_t* src = block->data() +
+                             (row_in_block * level.block_width + (from - block_left)) * pixel_bytes +
+                             band_offset;
+        LoadSamples(data_type_, src, PixelStride(), static_cast<size_t>(to - from),
+                    out + (from - x_begin));
+    }
+    return true;
+}
+
+template <typename W>
+CNStatus CNTiledRasterLayer::Impl::ReadLevel(int level_index, int x_offset, int y_offset,
+                                             int x_size, int y_size, uint8_t* buffer,
+                                             int buffer_x_size, int buffer_y_size,
+                                             CNDataType buffer_type,
+                                             const std::vector<int>& bands,
+                                             CNResampleMethod method) {
+    const Level& level = levels_[static_cast<size_t>(level_index)];
+    const Level& base = levels_[0];
+    bool bilinear = method == CNResampleMethod::kBilinear;
+
+    // Output pixel centres mapped into the level, one table per axis.
+    auto build_axis = [bilinear](double offset, double step, int count, int limit,
+                                 std::vector<int>* first, std::vector<int>* second,
+                                 std::vector<W>* weight) {
+        first->resize(static_cast<size_t>(count));
+        second->resize(static_cast<size_t>(count));
+        weight->assign(static_cast<size_t>(count), W(0));
+        for (int i = 0; i < count; ++i) {
+            double centre = offset + (i + 0.5) * step;
+            int a;
+            int b;
+            if (bilinear) {
+                centre -= 0.5;
+                double floor_value = std::floor(centre);
+                a = static_cast<int>(floor_value);
+                b = a + 1;
+                (*weight)[static_cast<size_t>(i)] = static_cast<W>(centre - floor_value);
+            } else {
+                a = b = static_cast<int>(std::floor(centre));
+            }
+            (*first)[static_cast<size_t>(i)] = std::min(std::max(a, 0), limit - 1);
+            (*second)[static_cast<size_t>(i)] = std::min(std::max(b, 0), limit - 1);
+        }
+    };
+
+    double scale_x = static_cast<double>(level.width) / base.width;
+    double scale_y = static_cast<double>(level.height) / base.height;
+    std::vector<int> col_a, col_b, row_a, row_b;
+    std::vector<W> col_w, row_w;
+    build_axis(x_offset * scale_x, x_size * scale_x / buffer_x_size, buffer_x_size,
+               level.width, &col_a, &col_b, &col_w);
+    build_axis(y_offset * scale_y, y_size * scale_y / buffer_y_size, buffer_y_size,
+               level.height, &row_a, &row_b, &row_w);
+
+    int x_begin = *std::min_element(col_a.begin(), col_a.end());
+    int x_end = *std::max_element(col_b.begin(), col_b.end()) + 1;
+    for (int& c : col_a) c -= x_begin;
+    for (int& c : col_b) c -= x_begin;
+
+    size_t out_width = static_cast<size_t>(buffer_x_size);
+    size_t out_row_bytes = out_width * DataTypeSize(buffer_type);
+    W nodata = static_cast<W>(nodata_);
+    std::vector<W> output(out_width);
+
+    for (size_t k = 0; k < bands.size(); ++k) {
+        SourceRow<W> rows[2];
+        auto acquire = [&](int y, const SourceRow<W>* keep) -> SourceRow<W>* {
+            for (SourceRow<W>& row : rows) {
+                if (row.y == y) {
+                    return &row;
+                }
+            }
+            SourceRow<W>* row = &rows[0];
+            if (row == keep || (rows[1].y < rows[0].y && &rows[1] != keep)) {
+                row = &rows[1];
+            }
+            row->samples.resize(static_cast<size_t>(x_end - x_begin));
+            if (!FetchRow(level_index, bands[k], y, x_begin, x_end, row->samples.data())) {
+                return nullptr;
+            }
+            row->y = y;
+            row->left.resize(out_width);
+            for (size_t i = 0; i < out_width; ++i) {
+                row->left[i] = row->samples[static_cast<size_t>(col_a[i])];
+            }
+            if (bilinear) {
+                row->right.resize(out_width);
+                row->blend.resize(out_width);
+                for (size_t i = 0; i < out_width; ++i) {
+                    row->right[i] = row->samples[static_cast<size_t>(col_b[i])];
+                }
+                Lerp(row->left.data(), row->right.data(), col_w.data(), row->blend.data(),
+                     out_width);
+            }
+            return row;
+        };
+
+        for (int j = 0; j < buffer_y_size; ++j) {
+            const SourceRow<W>* top = acquire(row_a[static_cast<size_t>(j)], nullptr);
+            if (!top) {
+                return CNStatus::kCorruptData;
+            }
+            const W* result = top->left.data();
+            if (bilinear) {
+                const SourceRow<W>* bottom = acquire(row_b[static_cast<size_t>(j)], top);
+                if (!bottom) {
+                    return CNStatus::kCorruptData;
+                }
+                W fy = row_w[static_cast<size_t>(j)];
+                Lerp(top->blend.data(), bottom->blend.data(), fy, output.data(), out_width);
+                if (has_nodata_) {
+                    // Blending with nodata is meaningless; use the nearest
+                    // sample wherever a neighbour is nodata.
+                    for (size_t i = 0; i < out_width; ++i) {
+                        if (top->left[i] == nodata || top->right[i] == nodata ||
+                            bottom->left[i] == nodata || bottom->right[i] == nodata) {
+                            const SourceRow<W>* near_row = fy < W(0.5) ? top : bottom;
+                            output[i] = col_w[i] < W(0.5) ? near_row->left[i] : near_row->right[i];
+                        }
+                    }
+                }
+                result = output.data();
+            }
+            StoreSamples(result, out_width, buffer_type,
+                         buffer + (k * static_cast<size_t>(buffer_y_size) + j) * out_row_bytes);
+        }
+    }
+    return CNStatus::kSuccess;
+}
+
+void CNTiledRasterBand::ComputeStatistics() const {
+    std::call_once(statistics_once_, [this] {
+        CNTiledRasterLayer::Impl& impl = *layer_->impl_;
+        int level = static_cast<int>(impl.levels_.size()) - 1;
+        const CNTiledRasterLayer::Impl::Level& coarsest = impl.levels_.back();
+        std::vector<double> row(static_cast<size_t>(coarsest.width));
+        bool any = false;
+        for (int y = 0; y < coarsest.height; ++y) {
+            if (!impl.FetchRow(level, index_, y, 0, coarsest.width, row.data())) {
+                break;
+            }
+            for (double value : row) {
+                if ((impl.has_nodata_ && value == impl.nodata_) || std::isnan(value)) {
+                    continue;
+                }
+                if (!any) {
+                    minimum_ = maximum_ = value;
+                    any = true;
+                } else {
+                    minimum_ = std::min(minimum_, value);
+                    maximum_ = std::max(maximum_, value);
+                }
+            }
+        }
+    });
+}
+
+CNTiledRasterLayer::CNTiledRasterLayer() : impl_(new Impl()) {
+}
+
+CNTiledRasterLayer::~CNTiledRasterLayer() = default;
+
+std::unique_ptr<CNTiledRasterLayer> CNTiledRasterLayer::Open(
+    const std::string& path, std::shared_ptr<CNRasterBlockCache> cache) {
+    std::unique_ptr<CNTiledRasterLayer> layer(new CNTiledRasterLayer());
+    Impl& impl = *layer->impl_;
+    impl.path_ = path;
+    size_t slash = path.find_last_of("/\\");
+    impl.name_ = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    size_t dot = impl.name_.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        impl.name_.erase(dot);
+    }
+
+    if (!impl.Load()) {
+        return nullptr;
+    }
+    layer->geo_transform_ = impl.geo_transform_;
+    impl.cache_ = cache ? cache : CNRasterBlockCache::GetDefault();
+    impl.owner_ = CNRasterBlockCache::NewOwnerId();
+    for (int i = 0; i < impl.band_count_; ++i) {
+        impl.bands_.emplace_back(new CNTiledRasterBand(layer.get(), i));
+    }
+    return layer;
+}
+
+const std::string& CNTiledRasterLayer::GetName() const {
+    return impl_->name_;
+}
+
+CNFeatureDefn* CNTiledRasterLayer::GetFeatureDefn() {
+    return nullptr;
+}
+
+const CNFeatureDefn* CNTiledRasterLayer::GetFeatureDefn() const {
+    return nullptr;
+}
+
+GeomType CNTiledRasterLayer::GetGeomType() const {
+    return GeomType::kUnknown;
+}
+
+CNStatus CNTiledRasterLayer::GetExtent(Envelope& extent, bool force) const {
+    (void)force;
+    const double* gt = geo_transform_.data();
+    double width = impl_->levels_[0].width;
+    double height = impl_->levels_[0].height;
+    double xs[4] = {gt[0], gt[0] + width * gt[1], gt[0] + height * gt[2],
+                    gt[0] + width * gt[1] + height * gt[2]};
+    double ys[4] = {gt[3], gt[3] + width * gt[4], gt[3] + height * gt[5],
+                    gt[3] + width * gt[4] + height * gt[5]};
+    extent = Envelope(*std::min_element(xs, xs + 4), *std::min_element(ys, ys + 4),
+                      *std::max_element(xs, xs + 4), *std::max_element(ys, ys + 4));
+    return CNStatus::kSuccess;
+}
+
+int64_t CNTiledRasterLayer::GetFeatureCount(bool force) const {
+    (void)force;
+    return 0;
+}
+
+void CNTiledRasterLayer::ResetReading() {
+}
+
+std::unique_ptr<CNFeature> CNTiledRasterLayer::GetNextFeature() {
+    return nullptr;
+}
+
+std::unique_ptr<CNFeature> CNTiledRasterLayer::GetFeature(int64_t fid) {
+    (void)fid;
+    return nullptr;
+}
+
+void CNTiledRasterLayer::SetSpatialFilterRect(
+    double min_x, double min_y,
+    double max_x, double max_y) {
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
+}
+
+void CNTiledRasterLayer::SetSpatialFilter(const CNGeometry* geometry) {
+    if (geometry) {
+        impl_->spatial_filter_.reset(geometry->Clone().release());
+    } else {
+        impl_->spatial_filter_.reset();
+    }
+}
+
+const CNGeometry* CNTiledRasterLayer::GetSpatialFilter() const {
+    return impl_->spatial_filter_.get();
+}
+
+CNStatus CNTiledRasterLayer::SetAttributeFilter(const std::string& query) {
+    (void)query;
+    return CNStatus::kNotSupported;
+}
+
+bool CNTiledRasterLayer::TestCapability(CNLayerCapability capability) const {
+    switch (capability) {
+        case CNLayerCapability::kRandomRead:
+        case CNLayerCapability::kFastGetExtent:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::unique_ptr<CNLayer> CNTiledRasterLayer::Clone() const {
+    std::unique_ptr<CNTiledRasterLayer> layer = Open(impl_->path_, impl_->cache_);
+    if (!layer) {
+        return nullptr;
+    }
+    layer->SetSpatialFilter(impl_->spatial_filter_.get());
+    return std::unique_ptr<CNLayer>(layer.release());
+}
+
+int CNTiledRasterLayer::GetWidth() const {
+    return impl_->levels_[0].width;
+}
+
+int CNTiledRasterLayer::GetHeight() const {
+    return impl_->levels_[0].height;
+}
+
+int CNTiledRasterLayer::GetBandCount() const {
+    return impl_->band_count_;
+}
+
+double CNTiledRasterLayer::GetPixelWidth() const {
+    return std::fabs(geo_transform_[1]);
+}
+
+double CNTiledRasterLayer::GetPixelHeight() const {
+    return std::fabs(geo_transform_[5]);
+}
+
+CNDataType CNTiledRasterLayer::GetDataType() const {
+    return impl_->data_type_;
+}
+
+void CNTiledRasterLayer::GetGeoTransform(double* transform) const {
+    if (transform) {
+        std::copy(geo_transform_.begin(), geo_transform_.end(), transform);
+    }
+}
+
+CNRasterBand* CNTiledRasterLayer::GetBand(int band_index) {
+    if (band_index < 0 || band_index >= impl_->band_count_) {
+        return nullptr;
+    }
+    return impl_->bands_[static_cast<size_t>(band_index)].get();
+}
+
+CNStatus CNTiledRasterLayer::ReadRaster(int x_offset, int y_offset, int width, int height,
+                                        int band_count, CNDataType buffer_type, void* buffer) {
+    if (band_count <= 0) {
+        return CNStatus::kInvalidParameter;
+    }
+    return ReadWindow(x_offset, y_offset, width, height, buffer, width, height,
+                      buffer_type, nullptr, band_count);
+}
+
+CNStatus CNTiledRasterLayer::WriteRaster(int x_offset, int y_offset, int width, int height,
+                                         int band_count, CNDataType buffer_type,
+                                         const void* buffer) {
+    (void)x_offset; (void)y_offset; (void)width; (void)height;
+    (void)band_count; (void)buffer_type; (void)buffer;
+    return CNStatus::kNotSupported;
+}
+
+CNStatus CNTiledRasterLayer::ReadWindow(int x_offset, int y_offset,
+                                        int x_size, int y_size,
+                                        void* buffer,
+                                        int buffer_x_size, int buffer_y_size,
+                                        CNDataType buffer_type,
+                                        const int* band_list,
+                                        int band_count,
+                                        CNResampleMethod method) {
+    Impl& impl = *impl_;
+    if (!buffer) {
+        return CNStatus::kNullPointer;
+    }
+    if (x_size <= 0 || y_size <= 0 || buffer_x_size <= 0 || buffer_y_size <= 0 ||
+        band_count < 0) {
+        return CNStatus::kInvalidParameter;
+    }
+    if (DataTypeSize(buffer_type) == 0) {
+        return CNStatus::kNotSupported;
+    }
+    if (x_offset < 0 || y_offset < 0 || x_size > GetWidth() - x_offset ||
+        y_size > GetHeight() - y_offset) {
+        return CNStatus::kOutOfRange;
+    }
+
+    std::vector<int> bands;
+    int count = band_count > 0 ? band_count : impl.band_count_;
+    for (int i = 0; i < count; ++i) {
+        int band = band_list ? band_list[i] : i;
+        if (band < 0 || band >= impl.band_count_) {
+            return CNStatus::kOutOfRange;
+        }
+        bands.push_back(band);
+    }
+
+    int level = SelectLevel(x_size, y_size, buffer_x_size, buffer_y_size);
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    if (impl.UsesDoubleWork()) {
+        return impl.ReadLevel<double>(level, x_offset, y_offset, x_size, y_size, out,
+                                      buffer_x_size, buffer_y_size, buffer_type, bands, method);
+    }
+    return impl.ReadLevel<float>(level, x_offset, y_offset, x_size, y_size, out,
+                                 buffer_x_size, buffer_y_size, buffer_type, bands, method);
+}
+
+int CNTiledRasterLayer::SelectLevel(int x_size, int y_size,
+                                    int buffer_x_size, int buffer_y_size) const {
+    if (x_size <= 0 || y_size <= 0 || buffer_x_size <= 0 || buffer_y_size <= 0) {
+        return 0;
+    }
+    const std::vector<Impl::Level>& levels = impl_->levels_;
+    // Coarsest level whose pixels are no larger than the output pixels
+    // along either axis, allowing for rounding of odd overview sizes.
+    double factor = std::min(static_cast<double>(x_size) / buffer_x_size,
+                             static_cast<double>(y_size) / buffer_y_size);
+    int best = 0;
+    for (size_t i = 1; i < levels.size(); ++i) {
+        double level_factor = std::max(static_cast<double>(levels[0].width) / levels[i].width,
+                                       static_cast<double>(levels[0].height) / levels[i].height);
+        if (level_factor <= factor * 1.01) {
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+int CNTiledRasterLayer::GetOverviewCount() const {
+    return static_cast<int>(impl_->levels_.size()) - 1;
+}
+
+bool CNTiledRasterLayer::GetOverviewSize(int index, int* width, int* height) const {
+    if (index < 0 || index >= GetOverviewCount()) {
+        return false;
+    }
+    const Impl::Level& level = impl_->levels_[static_cast<size_t>(index) + 1];
+    if (width) {
+        *width = level.width;
+    }
+    if (height) {
+        *height = level.height;
+    }
+    return true;
+}
+
+CNStatus CNTiledRasterLayer::BuildOverviews(int min_size) {
+    Impl& impl = *impl_;
+    if (min_size < 1) {
+        return CNStatus::kInvalidParameter;
+    }
+    if (impl.levels_.size() > 1) {
+        return CNStatus::kSuccess;
+    }
+    size_t pixel_bytes = static_cast<size_t>(impl.band_count_) * impl.sample_size_;
+    while (std::max(impl.levels_.back().width, impl.levels_.back().height) > min_size) {
+        int source = static_cast<int>(impl.levels_.size()) - 1;
+        int source_width = impl.levels_.back().width;
+        int source_height = impl.levels_.back().height;
+
+        Impl::Level level;
+        level.width = (source_width + 1) / 2;
+        level.height = (source_height + 1) / 2;
+        level.block_width = level.width;
+        level.block_height = level.height;
+        level.blocks_across = 1;
+        level.blocks_down = 1;
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * pixel_bytes);
+
+        std::vector<double> upper(static_cast<size_t>(source_width));
+        std::vector<double> lower(static_cast<size_t>(source_width));
+        for (int band = 0; band < impl.band_count_; ++band) {
+            for (int y = 0; y < level.height; ++y) {
+                int y0 = 2 * y;
+                int y1 = std::min(y0 + 1, source_height - 1);
+                if (!impl.FetchRow(source, band, y0, 0, source_width, upper.data()) ||
+                    !impl.FetchRow(source, band, y1, 0, source_width, lower.data())) {
+                    return CNStatus::kCorruptData;
+                }
+                for (int x = 0; x < level.width; ++x) {
+                    size_t x0 = static_cast<size_t>(2 * x);
+                    size_t x1 = static_cast<size_t>(std::min(2 * x + 1, source_width - 1));
+                    double samples[4] = {upper[x0], upper[x1], lower[x0], lower[x1]};
+                    double sum = 0.0;
+                    int valid = 0;
+                    for (double value : samples) {
+                        if (!impl.has_nodata_ || value != impl.nodata_) {
+                            sum += value;
+                            ++valid;
+                        }
+                    }
+                    double value = valid > 0 ? sum / valid : impl.nodata_;
+                    impl.StoreNative(value, level.pixels.data() +
+                                                (static_cast<size_t>(y) * level.width + x) *
+                                                    pixel_bytes +
+                                                static_cast<size_t>(band) * impl.sample_size_);
+                }
+            }
+        }
+        impl.levels_.push_back(std::move(level));
+    }
+    return CNStatus::kSuccess;
+}
+
+void CNTiledRasterLayer::GetBlockSize(int* width, int* height) const {
+    if (width) {
+        *width = impl_->levels_[0].block_width;
+    }
+    if (height) {
+        *height = impl_->levels_[0].block_height;
+    }
+}
+
+bool CNTiledRasterLayer::HasNoDataValue() const {
+    return impl_->has_nodata_;
+}
+
+double CNTiledRasterLayer::GetNoDataValue() const {
+    return impl_->nodata_;
+}
+
+CNRasterBlockCache* CNTiledRasterLayer::GetBlockCache() const {
+    return impl_->cache_.get();
+}
+
+} // namespace ogc
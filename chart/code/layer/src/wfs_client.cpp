@@ -0,0 +1,1139 @@
+#include "wfs_client.h"
+#include "ogc/layer/wfs_layer.h"
+
+#include "ogc/geom/linearring.h"
+#include "ogc/geom/linestring.h"
+#include "ogc/geom/multilinestring.h"
+#include "ogc/geom/multipoint.h"
+#include "ogc/geom/multipolygon.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/polygon.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace ogc {
+
+// ---------------------------------------------------------------------------
+// URLs
+// ---------------------------------------------------------------------------
+
+bool ParseHttpUrl(const std::string& url, HttpUrl* out) {
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) {
+        return false;
+    }
+    HttpUrl parsed;
+    parsed.scheme = url.substr(0, scheme_end);
+    std::transform(parsed.scheme.begin(), parsed.scheme.end(), parsed.scheme.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (parsed.scheme != "http" && parsed.scheme != "https") {
+        return false;
+    }
+    size_t host_begin = scheme_end + 3;
+    size_t host_end = url.find_first_of("/?#", host_begin);
+    std::string authority = url.substr(host_begin, host_end == std::string::npos
+                                                       ? std::string::npos
+                                                       : host_end - host_begin);
+    size_t at = authority.rfind('@');
+    if (at != std::string::npos) {
+        authority.erase(0, at + 1);
+    }
+    parsed.port = parsed.scheme == "https" ? 443 : 80;
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+        std::string port = authority.substr(colon + 1);
+        char* end = nullptr;
+        long value = std::strtol(port.c_str(), &end, 10);
+        if (port.empty() || *end != '\0' || value <= 0 || value > 65535) {
+            return false;
+        }
+        parsed.port = static_cast<int>(value);
+        authority.erase(colon);
+    }
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    if (authority.empty()) {
+        return false;
+    }
+    parsed.host = authority;
+    parsed.target = host_end == std::string::npos ? "/" : url.substr(host_end);
+    size_t fragment = parsed.target.find('#');
+    if (fragment != std::string::npos) {
+        parsed.target.erase(fragment);
+    }
+    if (parsed.target.empty() || parsed.target[0] != '/') {
+        parsed.target.insert(0, "/");
+    }
+    *out = parsed;
+    return true;
+}
+
+std::string UrlEncode(const std::string& value) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(value.size());
+    for (unsigned char c : value) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' ||
+            c == ',' || c == ':') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(kHex[c >> 4]);
+            out.push_back(kHex[c & 15]);
+        }
+    }
+    return out;
+}
+
+std::string AppendQuery(const std::string& url,
+                        const std::vector<std::pair<std::string, std::string>>& params) {
+    std::string out = url;
+    char separator = out.find('?') == std::string::npos ? '?' : '&';
+    if (separator == '&' && (out.back() == '?' || out.back() == '&')) {
+        separator = '\0';
+    }
+    for (const auto& param : params) {
+        if (separator) {
+            out.push_back(separator);
+        }
+        separator = '&';
+        out += UrlEncode(param.first);
+        out.push_back('=');
+        out += UrlEncode(param.second);
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Plain HTTP/1.1 transport
+// ---------------------------------------------------------------------------
+
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+void CloseSocket(SocketHandle s) {
+    closesocket(s);
+}
+
+bool StartSockets() {
+    static std::once_flag once;
+    static bool started = false;
+    std::call_once(once, [] {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    });
+    return started;
+}
+
+bool SetBlocking(SocketHandle s, bool blocking) {
+    u_long mode = blocking ? 0 : 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+
+bool ConnectInProgress() {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+void SetTimeouts(SocketHandle s, int timeout_ms) {
+    DWORD value = static_cast<DWORD>(timeout_ms);
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+#else
+typedef int SocketHandle;
+const SocketHandle kInvalidSocket = -1;
+
+void CloseSocket(SocketHandle s) {
+    close(s);
+}
+
+bool StartSockets() {
+    return true;
+}
+
+bool SetBlocking(SocketHandle s, bool blocking) {
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(s, F_SETFL, flags) == 0;
+}
+
+bool ConnectInProgress() {
+    return errno == EINPROGRESS;
+}
+
+void SetTimeouts(SocketHandle s, int timeout_ms) {
+    timeval value;
+    value.tv_sec = timeout_ms / 1000;
+    value.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+}
+#endif
+
+// Connects with the timeout applied to the handshake as well as to reads.
+SocketHandle ConnectTo(const HttpUrl& url, int timeout_ms, std::string* error) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    std::string port = std::to_string(url.port);
+    if (getaddrinfo(url.host.c_str(), port.c_str(), &hints, &addresses) != 0 || !addresses) {
+        *error = "cannot resolve " + url.host;
+        return kInvalidSocket;
+    }
+    SocketHandle result = kInvalidSocket;
+    for (addrinfo* a = addresses; a && result == kInvalidSocket; a = a->ai_next) {
+        SocketHandle s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == kInvalidSocket) {
+            continue;
+        }
+        bool connected = false;
+        if (SetBlocking(s, false)) {
+            int rc = connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen));
+            if (rc == 0) {
+                connected = true;
+            } else if (ConnectInProgress()) {
+                fd_set writable;
+                FD_ZERO(&writable);
+                FD_SET(s, &writable);
+                timeval tv;
+                tv.tv_sec = timeout_ms / 1000;
+                tv.tv_usec = (timeout_ms % 1000) * 1000;
+                if (select(static_cast<int>(s) + 1, nullptr, &writable, nullptr, &tv) > 0) {
+                    int socket_error = 0;
+                    socklen_t length = sizeof(socket_error);
+                    getsockopt(s, SOL_SOCKET, SO_ERROR,
+                               reinterpret_cast<char*>(&socket_error), &length);
+                    connected = socket_error == 0;
+                }
+            }
+        }
+        if (connected && SetBlocking(s, true)) {
+            SetTimeouts(s, timeout_ms);
+            result = s;
+        } else {
+            CloseSocket(s);
+        }
+    }
+    freeaddrinfo(addresses);
+    if (result == kInvalidSocket) {
+        *error = "cannot connect to " + url.host + ":" + port;
+    }
+    return result;
+}
+
+std::string Base64(const std::string& input) {
+    static const char kAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < input.size(); i += 3) {
+        uint32_t v = (static_cast<uint8_t>(input[i]) << 16) |
+                     (static_cast<uint8_t>(input[i + 1]) << 8) |
+                     static_cast<uint8_t>(input[i + 2]);
+        out.push_back(kAlphabet[(v >> 18) & 63]);
+        out.push_back(kAlphabet[(v >> 12) & 63]);
+        out.push_back(kAlphabet[(v >> 6) & 63]);
+        out.push_back(kAlphabet[v & 63]);
+    }
+    if (i < input.size()) {
+        uint32_t v = static_cast<uint8_t>(input[i]) << 16;
+        if (i + 1 < input.size()) {
+            v |= static_cast<uint8_t>(input[i + 1]) << 8;
+        }
+        out.push_back(kAlphabet[(v >> 18) & 63]);
+        out.push_back(kAlphabet[(v >> 12) & 63]);
+        out.push_back(i + 1 < input.size() ? kAlphabet[(v >> 6) & 63] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+bool DecodeChunked(const std::string& body, std::string* out) {
+    out->clear();
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t line_end = body.find("\r\n", pos);
+        if (line_end == std::string::npos) {
+            return false;
+        }
+        unsigned long size = std::strtoul(body.c_str() + pos, nullptr, 16);
+        pos = line_end + 2;
+        if (size == 0) {
+            return true;
+        }
+        if (size > body.size() - pos) {
+            return false;
+        }
+        out->append(body, pos, size);
+        pos += size + 2;
+    }
+    return false;
+}
+
+class HttpTransport : public CNWFSTransport {
+public:
+    HttpTransport(const std::string& user, const std::string& password)
+        : authorization_(user.empty() ? std::string() : Base64(user + ":" + password)) {}
+
+    bool Get(const std::string& url, int timeout_ms, CNWFSResponse& response) override {
+        response = CNWFSResponse();
+        HttpUrl parsed;
+        if (!ParseHttpUrl(url, &parsed)) {
+            response.error = "invalid URL: " + url;
+            return false;
+        }
+        if (parsed.scheme != "http") {
+            response.error = "https requires an application-supplied transport";
+            return false;
+        }
+        if (!StartSockets()) {
+            response.error = "socket initialisation failed";
+            return false;
+        }
+        SocketHandle s = ConnectTo(parsed, timeout_ms > 0 ? timeout_ms : 30000, &response.error);
+        if (s == kInvalidSocket) {
+            return false;
+        }
+
+        std::string request = "GET " + parsed.target + " HTTP/1.1\r\nHost: " + parsed.host;
+        if (parsed.port != 80) {
+            request += ":" + std::to_string(parsed.port);
+        }
+        request += "\r\nUser-Agent: ogc-layer\r\nAccept-Encoding: identity\r\nConnection: close\r\n";
+        if (!authorization_.empty()) {
+            request += "Authorization: Basic " + authorization_ + "\r\n";
+        }
+        request += "\r\n";
+        size_t sent = 0;
+        while (sent < request.size()) {
+            int n = static_cast<int>(send(s, request.data() + sent,
+                                          static_cast<int>(request.size() - sent), 0));
+            if (n <= 0) {
+                CloseSocket(s);
+                response.error = "send failed";
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+
+        std::string raw;
+        char buffer[16384];
+        for (;;) {
+            int n = static_cast<int>(recv(s, buffer, sizeof(buffer), 0));
+            if (n < 0) {
+                CloseSocket(s);
+                response.error = "receive failed or timed out";
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            raw.append(buffer, static_cast<size_t>(n));
+        }
+        CloseSocket(s);
+        return ParseResponse(raw, &response);
+    }
+
+private:
+    static bool ParseResponse(const std::string& raw, CNWFSResponse* response) {
+        size_t header_end = raw.find("\r\n\r\n");
+        if (raw.compare(0, 5, "HTTP/") != 0 || header_end == std::string::npos) {
+            response->error = "malformed HTTP response";
+            return false;
+        }
+        size_t space = raw.find(' ');
+        response->status_code = std::atoi(raw.c_str() + space + 1);
+
+        bool chunked = false;
+        long long content_length = -1;
+        size_t line = raw.find("\r\n") + 2;
+        while (line < header_end) {
+            size_t next = raw.find("\r\n", line);
+            std::string header = raw.substr(line, next - line);
+            line = next + 2;
+            size_t colon = header.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = header.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            size_t value_begin = header.find_first_not_of(' ', colon + 1);
+            std::string value = value_begin == std::string::npos ? "" : header.substr(value_begin);
+            if (name == "content-type") {
+                response->content_type = value;
+            } else if (name == "transfer-encoding") {
+                chunked = value.find("chunked") != std::string::npos;
+            } else if (name == "content-length") {
+                content_length = std::atoll(value.c_str());
+            }
+        }
+
+        std::string body = raw.substr(header_end + 4);
+        if (chunked) {
+            if (!DecodeChunked(body, &response->body)) {
+                response->error = "malformed chunked body";
+                return false;
+            }
+        } else {
+            if (content_length >= 0 && static_cast<size_t>(content_length) < body.size()) {
+                body.resize(static_cast<size_t>(content_length));
+            }
+            response->body.swap(body);
+        }
+        return true;
+    }
+
+    std::string authorization_;
+};
+
+} // namespace
+
+std::shared_ptr<CNWFSTransport> CNWFSTransport::CreateHttp(const std::string& user,
+                                                           const std::string& password) {
+    return std::make_shared<HttpTransport>(user, password);
+}
+
+// ---------------------------------------------------------------------------
+// XML
+// ---------------------------------------------------------------------------
+
+namespace {
+
+inline bool IsXmlSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+std::string LocalName(const char* begin, const char* end) {
+    const char* colon = static_cast<const char*>(std::memchr(begin, ':', end - begin));
+    return colon ? std::string(colon + 1, end) : std::string(begin, end);
+}
+
+void AppendUtf8(uint32_t code, std::string* out) {
+    if (code < 0x80) {
+        out->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+void DecodeEntities(const char* begin, const char* end, std::string* out) {
+    out->clear();
+    for (const char* p = begin; p < end; ++p) {
+        if (*p != '&') {
+            out->push_back(*p);
+            continue;
+        }
+        const char* semi = static_cast<const char*>(std::memchr(p, ';', end - p));
+        if (!semi) {
+            out->push_back(*p);
+            continue;
+        }
+        std::string entity(p + 1, semi);
+        if (entity == "lt") {
+            out->push_back('<');
+        } else if (entity == "gt") {
+            out->push_back('>');
+        } else if (entity == "amp") {
+            out->push_back('&');
+        } else if (entity == "quot") {
+            out->push_back('"');
+        } else if (entity == "apos") {
+            out->push_back('\'');
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x' || entity[1] == 'X';
+            AppendUtf8(static_cast<uint32_t>(std::strtoul(entity.c_str() + (hex ? 2 : 1),
+                                                          nullptr, hex ? 16 : 10)),
+                       out);
+        } else {
+            out->append(p, semi + 1);
+        }
+        p = semi;
+    }
+}
+
+const char* FindText(const char* p, const char* end, const char* text) {
+    size_t length = std::strlen(text);
+    for (; p + length <= end; ++p) {
+        if (std::memcmp(p, text, length) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+XmlPullParser::XmlPullParser(const char* data, size_t size)
+    : p_(data), end_(data + size) {
+}
+
+bool XmlPullParser::ParseStartTag() {
+    const char* p = p_ + 1;
+    const char* name_begin = p;
+    while (p < end_ && !IsXmlSpace(*p) && *p != '>' && *p != '/') {
+        ++p;
+    }
+    name_ = LocalName(name_begin, p);
+    attributes_.clear();
+    for (;;) {
+        while (p < end_ && IsXmlSpace(*p)) {
+            ++p;
+        }
+        if (p >= end_) {
+            return false;
+        }
+        if (*p == '>') {
+            p_ = p + 1;
+            return true;
+        }
+        if (*p == '/') {
+            if (p + 1 >= end_ || p[1] != '>') {
+                return false;
+            }
+            pending_end_ = true;
+            p_ = p + 2;
+            return true;
+        }
+        const char* attr_begin = p;
+        while (p < end_ && *p != '=' && !IsXmlSpace(*p) && *p != '>') {
+            ++p;
+        }
+        const char* attr_end = p;
+        while (p < end_ && IsXmlSpace(*p)) {
+            ++p;
+        }
+        if (p >= end_ || *p != '=') {
+            return false;
+        }
+        ++p;
+        while (p < end_ && IsXmlSpace(*p)) {
+            ++p;
+        }
+        if (p >= end_ || (*p != '"' && *p != '\'')) {
+            return false;
+        }
+        char quote = *p++;
+        const char* value_begin = p;
+        while (p < end_ && *p != quote) {
+            ++p;
+        }
+        if (p >= end_) {
+            return false;
+        }
+        std::string value;
+        DecodeEntities(value_begin, p, &value);
+        attributes_.emplace_back(LocalName(attr_begin, attr_end), value);
+        ++p;
+    }
+}
+
+XmlPullParser::Event XmlPullParser::Next() {
+    if (pending_end_) {
+        pending_end_ = false;
+        --depth_;
+        return kEndElement;
+    }
+    while (p_ < end_) {
+        if (*p_ != '<') {
+            const char* begin = p_;
+            const char* lt = static_cast<const char*>(std::memchr(p_, '<', end_ - p_));
+            p_ = lt ? lt : end_;
+            const char* q = begin;
+            while (q < p_ && IsXmlSpace(*q)) {
+                ++q;
+            }
+            if (q == p_) {
+                continue;
+            }
+            DecodeEntities(begin, p_, &text_);
+            return kText;
+        }
+        if (end_ - p_ >= 4 && std::memcmp(p_, "<!--", 4) == 0) {
+            const char* close = FindText(p_ + 4, end_, "-->");
+            if (!close) {
+                return kError;
+            }
+            p_ = close + 3;
+            continue;
+        }
+        if (end_ - p_ >= 9 && std::memcmp(p_, "<![CDATA[", 9) == 0) {
+            const char* close = FindText(p_ + 9, end_, "]]>");
+            if (!close) {
+                return kError;
+            }
+            text_.assign(p_ + 9, close);
+            p_ = close + 3;
+            return kText;
+        }
+        if (end_ - p_ >= 2 && (p_[1] == '?' || p_[1] == '!')) {
+            const char* close = static_cast<const char*>(std::memchr(p_, '>', end_ - p_));
+            if (!close) {
+                return kError;
+            }
+            p_ = close + 1;
+            continue;
+        }
+        if (end_ - p_ >= 2 && p_[1] == '/') {
+            const char* close = static_cast<const char*>(std::memchr(p_, '>', end_ - p_));
+            if (!close) {
+                return kError;
+            }
+            const char* name_end = close;
+            while (name_end > p_ + 2 && IsXmlSpace(name_end[-1])) {
+                --name_end;
+            }
+            name_ = LocalName(p_ + 2, name_end);
+            p_ = close + 1;
+            --depth_;
+            return kEndElement;
+        }
+        if (!ParseStartTag()) {
+            return kError;
+        }
+        ++depth_;
+        return kStartElement;
+    }
+    return kEnd;
+}
+
+bool XmlPullParser::GetAttribute(const char* name, std::string* value) const {
+    for (const auto& attribute : attributes_) {
+        if (attribute.first == name) {
+            *value = attribute.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool XmlPullParser::Skip() {
+    int depth = depth_;
+    while (depth_ >= depth) {
+        Event event = Next();
+        if (event == kEnd || event == kError) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool XmlPullParser::ReadText(std::string* text) {
+    text->clear();
+    int depth = depth_;
+    while (depth_ >= depth) {
+        Event event = Next();
+        if (event == kEnd || event == kError) {
+            return false;
+        }
+        if (event == kText) {
+            *text += text_;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Capabilities
+// ---------------------------------------------------------------------------
+
+namespace {
+
+bool ParseCorner(const std::string& text, double* x, double* y) {
+    char* end = nullptr;
+    *x = std::strtod(text.c_str(), &end);
+    if (end == text.c_str()) {
+        return false;
+    }
+    const char* second = end;
+    *y = std::strtod(second, &end);
+    return end != second;
+}
+
+} // namespace
+
+bool ParseWfsCapabilities(const std::string& xml, WfsCapabilities* capabilities) {
+    *capabilities = WfsCapabilities();
+    XmlPullParser parser(xml.data(), xml.size());
+    XmlPullParser::Event event;
+    bool root = true;
+    WfsFeatureTypeInfo* current = nullptr;
+    double lower[2] = {0.0, 0.0};
+    bool has_lower = false;
+    while ((event = parser.Next()) != XmlPullParser::kEnd) {
+        if (event == XmlPullParser::kError) {
+            return false;
+        }
+        if (event == XmlPullParser::kEndElement) {
+            if (parser.Name() == "FeatureType") {
+                current = nullptr;
+            }
+            continue;
+        }
+        if (event != XmlPullParser::kStartElement) {
+            continue;
+        }
+        const std::string& name = parser.Name();
+        if (root) {
+            root = false;
+            if (name != "WFS_Capabilities") {
+                return false;
+            }
+            parser.GetAttribute("updateSequence", &capabilities->update_sequence);
+        } else if (name == "FeatureType") {
+            capabilities->feature_types.push_back(WfsFeatureTypeInfo());
+            current = &capabilities->feature_types.back();
+            current->wgs84_extent.SetNull();
+            has_lower = false;
+        } else if (current && name == "Name" && parser.Depth() == 4) {
+            std::string text;
+            if (!parser.ReadText(&text)) {
+                return false;
+            }
+            current->name = text;
+        } else if (current && name == "LowerCorner") {
+            std::string text;
+            if (!parser.ReadText(&text)) {
+                return false;
+            }
+            has_lower = ParseCorner(text, &lower[0], &lower[1]);
+        } else if (current && name == "UpperCorner") {
+            std::string text;
+            double upper[2];
+            if (!parser.ReadText(&text)) {
+                return false;
+            }
+            if (has_lower && ParseCorner(text, &upper[0], &upper[1])) {
+                current->wgs84_extent = Envelope(lower[0], lower[1], upper[0], upper[1]);
+            }
+        }
+    }
+    return !root;
+}
+
+// ---------------------------------------------------------------------------
+// GML
+// ---------------------------------------------------------------------------
+
+namespace {
+
+const int kMaxGmlDepth = 32;
+
+struct GmlContext {
+    XmlPullParser& xml;
+    int dimension;
+};
+
+bool ParsePosList(const std::string& text, int dimension, CoordinateList* coords) {
+    const char* p = text.c_str();
+    std::vector<double> values;
+    for (;;) {
+        char* end = nullptr;
+        double value = std::strtod(p, &end);
+        if (end == p) {
+            break;
+        }
+        values.push_back(value);
+        p = end;
+    }
+    if (dimension < 2) {
+        dimension = 2;
+    }
+    if (values.size() % static_cast<size_t>(dimension) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < values.size(); i += static_cast<size_t>(dimension)) {
+        if (dimension >= 3) {
+            coords->push_back(Coordinate(values[i], values[i + 1], values[i + 2]));
+        } else {
+            coords->push_back(Coordinate(values[i], values[i + 1]));
+        }
+    }
+    return true;
+}
+
+// GML 2 <coordinates>: tuples separated by spaces, components by commas.
+bool ParseCoordinatesText(const std::string& text, CoordinateList* coords) {
+    std::string normalized = text;
+    std::replace(normalized.begin(), normalized.end(), ',', ' ');
+    size_t components = 0;
+    size_t tuples = 0;
+    bool in_tuple = false;
+    for (char c : text) {
+        if (IsXmlSpace(c)) {
+            in_tuple = false;
+        } else {
+            if (!in_tuple) {
+                ++tuples;
+                in_tuple = true;
+            }
+            if (c == ',') {
+                ++components;
+            }
+        }
+    }
+    int dimension = tuples > 0 && components >= tuples * 2 ? 3 : 2;
+    return ParsePosList(normalized, dimension, coords);
+}
+
+int Dimension(const XmlPullParser& xml, int inherited) {
+    std::string value;
+    if (xml.GetAttribute("srsDimension", &value)) {
+        int dimension = std::atoi(value.c_str());
+        if (dimension >= 2) {
+            return dimension;
+        }
+    }
+    return inherited;
+}
+
+// Reads the positions of a Point, LineString or LinearRing element.
+bool ParsePositions(XmlPullParser& xml, int dimension, CoordinateList* coords) {
+    dimension = Dimension(xml, dimension);
+    int depth = xml.Depth();
+    for (;;) {
+        XmlPullParser::Event event = xml.Next();
+        if (event == XmlPullParser::kEnd || event == XmlPullParser::kError) {
+            return false;
+        }
+        if (event == XmlPullParser::kEndElement && xml.Depth() < depth) {
+            return true;
+        }
+        if (event != XmlPullParser::kStartElement) {
+            continue;
+        }
+        std::string name = xml.Name();
+        int child_dimension = Dimension(xml, dimension);
+        std::string text;
+        if (name == "pos" || name == "posList") {
+            if (!xml.ReadText(&text) || !ParsePosList(text, child_dimension, coords)) {
+                return false;
+            }
+        } else if (name == "coordinates") {
+            if (!xml.ReadText(&text) || !ParseCoordinatesText(text, coords)) {
+                return false;
+            }
+        } else if (!xml.Skip()) {
+            return false;
+        }
+    }
+}
+
+bool ParseGmlGeometry(XmlPullParser& xml, int dimension, int depth, GeometryPtr* out);
+
+// Parses the member geometries inside a multi-geometry or polygon boundary
+// element, calling add for each one.
+template <typename Add>
+bool ParseMembers(XmlPullParser& xml, int dimension, int depth, Add add) {
+    int element_depth = xml.Depth();
+    for (;;) {
+        XmlPullParser::Event event = xml.Next();
+        if (event == XmlPullParser::kEnd || event == XmlPullParser::kError) {
+            return false;
+        }
+        if (event == XmlPullParser::kEndElement && xml.Depth() < element_depth) {
+            return true;
+        }
+        if (event != XmlPullParser::kStartElement) {
+            continue;
+        }
+        GeometryPtr geometry;
+        if (!ParseGmlGeometry(xml, dimension, depth + 1, &geometry)) {
+            return false;
+        }
+        if (geometry) {
+            add(std::move(geometry));
+        }
+    }
+}
+
+bool ParseGmlGeometry(XmlPullParser& xml, int dimension, int depth, GeometryPtr* out) {
+    if (depth > kMaxGmlDepth) {
+        return false;
+    }
+    dimension = Dimension(xml, dimension);
+    std::string name = xml.Name();
+    if (name == "Point") {
+        CoordinateList coords;
+        if (!ParsePositions(xml, dimension, &coords)) {
+            return false;
+        }
+        *out = coords.empty() ? Point::Create(Coordinate()) : Point::Create(coords[0]);
+        return true;
+    }
+    if (name == "LineString" || name == "LinearRing") {
+        CoordinateList coords;
+        if (!ParsePositions(xml, dimension, &coords)) {
+            return false;
+        }
+        if (name == "LinearRing") {
+            *out = LinearRing::Create(coords, false);
+        } else {
+            *out = LineString::Create(std::move(coords));
+        }
+        return true;
+    }
+    if (name == "Polygon") {
+        PolygonPtr polygon;
+        std::vector<LinearRingPtr> holes;
+        int element_depth = xml.Depth();
+        for (;;) {
+            XmlPullParser::Event event = xml.Next();
+            if (event == XmlPullParser::kEnd || event == XmlPullParser::kError) {
+                return false;
+            }
+            if (event == XmlPullParser::kEndElement && xml.Depth() < element_depth) {
+                break;
+            }
+            if (event != XmlPullParser::kStartElement) {
+                continue;
+            }
+            std::string boundary = xml.Name();
+            bool exterior = boundary == "exterior" || boundary == "outerBoundaryIs";
+            bool interior = boundary == "interior" || boundary == "innerBoundaryIs";
+            if (!exterior && !interior) {
+                if (!xml.Skip()) {
+                    return false;
+                }
+                continue;
+            }
+            bool ok = ParseMembers(xml, dimension, depth, [&](GeometryPtr ring) {
+                if (ring->GetGeometryType() != GeomType::kLineString) {
+                    return;
+                }
+                LinearRingPtr linear;
+                if (dynamic_cast<LinearRing*>(ring.get())) {
+                    linear.reset(static_cast<LinearRing*>(ring.release()));
+                } else {
+                    linear = LinearRing::Create(ring->GetCoordinates(), true);
+                }
+                if (exterior) {
+                    polygon = Polygon::Create(std::move(linear));
+                } else {
+                    holes.push_back(std::move(linear));
+                }
+            });
+            if (!ok) {
+                return false;
+            }
+        }
+        if (!polygon) {
+            polygon = Polygon::Create();
+        }
+        for (auto& hole : holes) {
+            polygon->AddInteriorRing(std::move(hole));
+        }
+        *out = std::move(polygon);
+        return true;
+    }
+    if (name == "MultiPoint") {
+        CoordinateList coords;
+        bool ok = ParseMembers(xml, dimension, depth, [&](GeometryPtr member) {
+            if (member->GetGeometryType() == GeomType::kPoint) {
+                coords.push_back(static_cast<Point*>(member.get())->GetCoordinate());
+            }
+        });
+        if (!ok) {
+            return false;
+        }
+        *out = MultiPoint::Create(coords);
+        return true;
+    }
+    if (name == "MultiLineString" || name == "MultiCurve") {
+        MultiLineStringPtr multi = MultiLineString::Create();
+        bool ok = ParseMembers(xml, dimension, depth, [&](GeometryPtr member) {
+            if (member->GetGeometryType() == GeomType::kLineString) {
+                multi->AddLineString(
+                    LineStringPtr(static_cast<LineString*>(member.release())));
+            }
+        });
+        if (!ok) {
+            return false;
+        }
+        *out = std::move(multi);
+        return true;
+    }
+    if (name == "MultiPolygon" || name == "MultiSurface") {
+        MultiPolygonPtr multi = MultiPolygon::Create();
+        bool ok = ParseMembers(xml, dimension, depth, [&](GeometryPtr member) {
+            if (member->GetGeometryType() == GeomType::kPolygon) {
+                multi->AddPolygon(PolygonPtr(static_cast<Polygon*>(member.release())));
+            }
+        });
+        if (!ok) {
+            return false;
+        }
+        *out = std::move(multi);
+        return true;
+    }
+    // Member wrappers (pointMember, surfaceMembers, ...) hold the geometry.
+    if (name.find("Member") != std::string::npos) {
+        GeometryPtr last;
+        bool ok = ParseMembers(xml, dimension, depth, [&](GeometryPtr member) {
+            last = std::move(member);
+        });
+        *out = std::move(last);
+        return ok;
+    }
+    return xml.Skip();
+}
+
+bool ParseGmlFeature(XmlPullParser& xml, GmlFeature* feature) {
+    if (!xml.GetAttribute("id", &feature->id)) {
+        xml.GetAttribute("fid", &feature->id);
+    }
+    int feature_depth = xml.Depth();
+    for (;;) {
+        XmlPullParser::Event event = xml.Next();
+        if (event == XmlPullParser::kEnd || event == XmlPullParser::kError) {
+            return false;
+        }
+        if (event == XmlPullParser::kEndElement && xml.Depth() < feature_depth) {
+            return true;
+        }
+        if (event != XmlPullParser::kStartElement) {
+            continue;
+        }
+        GmlProperty property;
+        property.name = xml.Name();
+        if (property.name == "boundedBy") {
+            if (!xml.Skip()) {
+                return false;
+            }
+            continue;
+        }
+        std::string nil;
+        property.is_null = xml.GetAttribute("nil", &nil) && nil == "true";
+        int property_depth = xml.Depth();
+        bool has_text = false;
+        bool is_geometry = false;
+        for (;;) {
+            XmlPullParser::Event inner = xml.Next();
+            if (inner == XmlPullParser::kEnd || inner == XmlPullParser::kError) {
+                return false;
+            }
+            if (inner == XmlPullParser::kEndElement && xml.Depth() < property_depth) {
+                break;
+            }
+            if (inner == XmlPullParser::kText) {
+                property.value += xml.Text();
+                has_text = true;
+            } else if (inner == XmlPullParser::kStartElement) {
+                GeometryPtr geometry;
+                if (!ParseGmlGeometry(xml, 2, 0, &geometry)) {
+                    return false;
+                }
+                if (geometry) {
+                    is_geometry = true;
+                    if (!feature->geometry) {
+                        feature->geometry = std::move(geometry);
+                    }
+                }
+            }
+        }
+        if (is_geometry) {
+            continue;
+        }
+        if (!has_text && !property.is_null) {
+            property.is_null = true;
+        }
+        feature->properties.push_back(std::move(property));
+    }
+}
+
+} // namespace
+
+bool ParseGmlFeatures(const char* data, size_t size, std::vector<GmlFeature>* features,
+                      std::string* error) {
+    XmlPullParser xml(data, size);
+    XmlPullParser::Event event;
+    bool root = true;
+    while ((event = xml.Next()) != XmlPullParser::kEnd) {
+        if (event == XmlPullParser::kError) {
+            *error = "malformed XML";
+            return false;
+        }
+        if (event != XmlPullParser::kStartElement) {
+            continue;
+        }
+        const std::string& name = xml.Name();
+        if (root) {
+            root = false;
+            if (name == "ExceptionReport" || name == "ServiceExceptionReport") {
+                std::string text;
+                xml.ReadText(&text);
+                *error = "service exception: " + text;
+                return false;
+            }
+            continue;
+        }
+        if (name == "member" || name == "featureMember" || name == "featureMembers") {
+            int member_depth = xml.Depth();
+            for (;;) {
+                XmlPullParser::Event inner = xml.Next();
+                if (inner == XmlPullParser::kEnd || inner == XmlPullParser::kError) {
+                    *error = "truncated feature member";
+                    return false;
+                }
+                if (inner == XmlPullParser::kEndElement && xml.Depth() < member_depth) {
+                    break;
+                }
+                if (inner == XmlPullParser::kStartElement) {
+                    GmlFeature feature;
+                    if (!ParseGmlFeature(xml, &feature)) {
+                        *error = "malformed feature";
+                        return false;
+                    }
+                    features->push_back(std::move(feature));
+                }
+            }
+        } else if (xml.Depth() > 1 && !xml.Skip()) {
+            *error = "malformed XML";
+            return false;
+        }
+    }
+    if (root) {
+        *error = "empty response";
+        return false;
+    }
+    return true;
+}
+
+} // namespace ogc
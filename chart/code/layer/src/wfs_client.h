@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ogc/geom/envelope.h"
+#include "ogc/geom/geometry.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ogc {
+
+/**
+ * @brief Parts of an http:// or https:// URL.
+ */
+struct HttpUrl {
+    std::string scheme;
+    std::string host;
+    int port = 0;
+    std::string target;
+};
+
+bool ParseHttpUrl(const std::string& url, HttpUrl* out);
+
+std::string UrlEncode(const std::string& value);
+
+/**
+ * @brief Appends key=value pairs to the URL's query string.
+ */
+std::string AppendQuery(const std::string& url,
+                        const std::vector<std::pair<std::string, std::string>>& params);
+
+/**
+ * @brief Pull parser for the subset of XML that WFS responses use.
+ *
+ * Element and attribute names are reported without their namespace prefix,
+ * whitespace-only text is skipped and entities are decoded. Self-closing
+ * elements produce a start and an end event.
+ */
+class XmlPullParser {
+public:
+    enum Event {
+        kStartElement,
+        kEndElement,
+        kText,
+        kEnd,
+        kError
+    };
+
+    XmlPullParser(const char* data, size_t size);
+
+    Event Next();
+
+    const std::string& Name() const { return name_; }
+    const std::string& Text() const { return text_; }
+    int Depth() const { return depth_; }
+
+    bool GetAttribute(const char* name, std::string* value) const;
+
+    /**
+     * @brief Consumes the rest of the element just started.
+     */
+    bool Skip();
+
+    /**
+     * @brief Consumes the rest of the element just started, returning the
+     * text it contains.
+     */
+    bool ReadText(std::string* text);
+
+private:
+    bool ParseStartTag();
+
+    const char* p_;
+    const char* end_;
+    std::string name_;
+    std::string text_;
+    std::vector<std::pair<std::string, std::string>> attributes_;
+    bool pending_end_ = false;
+    int depth_ = 0;
+};
+
+struct WfsFeatureTypeInfo {
+    std::string name;
+    Envelope wgs84_extent;
+};
+
+struct WfsCapabilities {
+    std::string update_sequence;
+    std::vector<WfsFeatureTypeInfo> feature_types;
+};
+
+/**
+ * @brief Reads the update sequence and the feature types from a WFS
+ * GetCapabilities document.
+ */
+bool ParseWfsCapabilities(const std::string& xml, WfsCapabilities* capabilities);
+
+struct GmlProperty {
+    std::string name;
+    std::string value;
+    bool is_null = false;
+};
+
+struct GmlFeature {
+    std::string id;
+    std::vector<GmlProperty> properties;
+    GeometryPtr geometry;
+};
+
+/**
+ * @brief Parses the members of a WFS 1.1/2.0 GML FeatureCollection. The
+ * first geometry property of each feature becomes its geometry. An
+ * ows:ExceptionReport is returned as an error.
+ */
+bool ParseGmlFeatures(const char* data, size_t size, std::vector<GmlFeature>* features,
+                      std::string* error);
+
+} // namespace ogc
@@ -1,26 +1,254 @@
 #include "ogc/layer/wfs_layer.h"
+#include "ogc/layer/geojson_stream.h"
 #include "ogc/layer/geometry_compat.h"
 
 #include "ogc/feature/feature.h"
 #include "ogc/feature/field_defn.h"
+#include "ogc/feature/geom_field_defn.h"
 #include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
 
-#include <fstream>
+#include "wfs_client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <locale>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace ogc {
 
+namespace {
+
+// A query touching more cells than this fetches the whole layer instead.
+const size_t kMaxQueryCells = 64;
+// Cells per side of the layer extent when no cell size is configured.
+const int kDefaultCellsPerSide = 16;
+const int kSchemaProbeCount = 100;
+// Cells are laid out over the WGS84 extent, so bboxes are lon/lat unless
+// SetBBOXCRS says otherwise.
+const char* const kDefaultBBoxCrs = "urn:ogc:def:crs:OGC:1.3:CRS84";
+
+typedef std::pair<int64_t, int64_t> CellKey;
+
+// Cell standing for the whole layer, fetched without a bbox.
+const CellKey kAllCell(std::numeric_limits<int64_t>::min(),
+                       std::numeric_limits<int64_t>::min());
+
+std::string FormatNumber(double value) {
+    std::ostringstream out;
+    out.imbue(std::locale::classic());
+    out.precision(17);
+    out << value;
+    return out.str();
+}
+
+bool IsVersion1(const std::string& version) {
+    return !version.empty() && version[0] == '1';
+}
+
+// WFS 1.0 bboxes carry no CRS and are read in the feature type's SRS.
+bool IsVersion10(const std::string& version) {
+    return version.compare(0, 3, "1.0") == 0;
+}
+
+const char* SkipSpace(const std::string& body) {
+    const char* p = body.c_str();
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        ++p;
+    }
+    // UTF-8 byte order mark.
+    if (static_cast<unsigned char>(p[0]) == 0xEF && static_cast<unsigned char>(p[1]) == 0xBB &&
+        static_cast<unsigned char>(p[2]) == 0xBF) {
+        p += 3;
+    }
+    return p;
+}
+
+bool ParseInteger(const std::string& text, int64_t* value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = std::strtoll(text.c_str(), &end, 10);
+    if (*end != '\0' || errno != 0) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+bool ParseReal(const std::string& text, double* value) {
+    if (text.empty()) {
+        return false;
+    }
+    std::istringstream in(text);
+    in.imbue(std::locale::classic());
+    in >> *value;
+    return !in.fail() && in.eof();
+}
+
+struct ParsedFeature {
+    std::string server_id;
+    std::unique_ptr<CNFeature> feature;
+};
+
+// Paging hints a WFS 2.0 server attaches to a page.
+struct PageInfo {
+    int64_t number_matched = -1;  // -1 when absent or "unknown"
+    int has_next = -1;            // -1 when the format carries no next link
+};
+
+std::string XmlAttribute(const std::string& tag, const char* name) {
+    std::string key = std::string(" ") + name + "=\"";
+    size_t at = tag.find(key);
+    if (at == std::string::npos) {
+        return std::string();
+    }
+    at += key.size();
+    size_t end = tag.find('"', at);
+    return end == std::string::npos ? std::string() : tag.substr(at, end - at);
+}
+
+// Reads numberMatched from the top-level members of a GeoJSON page, or
+// numberMatched and next from the root tag of a WFS 2.0 collection.
+PageInfo ReadPageInfo(const char* start, const char* end) {
+    PageInfo info;
+    if (start < end && *start == '<') {
+        const char* p = start;
+        while (p < end && *p == '<' && p + 1 < end && (p[1] == '?' || p[1] == '!')) {
+            const char* close = static_cast<const char*>(std::memchr(p, '>', end - p));
+            if (!close) {
+                return info;
+            }
+            p = close + 1;
+            while (p < end && std::isspace(static_cast<unsigned char>(*p))) {
+                ++p;
+            }
+        }
+        const char* close = p < end ? static_cast<const char*>(std::memchr(p, '>', end - p))
+                                    : nullptr;
+        if (!close) {
+            return info;
+        }
+        std::string tag(p, close);
+        ParseInteger(XmlAttribute(tag, "numberMatched"), &info.number_matched);
+        if (tag.find(" numberReturned=\"") != std::string::npos) {
+            info.has_next = tag.find(" next=\"") != std::string::npos ? 1 : 0;
+        }
+        return info;
+    }
+    int depth = 0;
+    for (const char* p = start; p < end; ++p) {
+        if (*p == '{' || *p == '[') {
+            ++depth;
+        } else if (*p == '}' || *p == ']') {
+            --depth;
+        } else if (*p == '"') {
+            const char* text = ++p;
+            while (p < end && *p != '"') {
+                p += *p == '\\' ? 2 : 1;
+            }
+            if (p >= end) {
+                break;
+            }
+            if (depth != 1 || static_cast<size_t>(p - text) != 13 ||
+                std::memcmp(text, "numberMatched", 13) != 0) {
+                continue;
+            }
+            const char* value = p + 1;
+            while (value < end && (std::isspace(static_cast<unsigned char>(*value)) ||
+                                   *value == ':')) {
+                ++value;
+            }
+            const char* digits = value;
+            while (digits < end && *digits >= '0' && *digits <= '9') {
+                ++digits;
+            }
+            ParseInteger(std::string(value, digits), &info.number_matched);
+            break;
+        }
+    }
+    return info;
+}
+
+} // namespace
+
 class CNWFSLayer::Impl {
 public:
+    enum class CellState {
+        kPending,
+        kComplete,
+        kFailed
+    };
+
+    struct CellEntry {
+        std::string revision;
+        uint64_t generation = 0;
+        CellState state = CellState::kPending;
+        std::vector<int64_t> fids;
+    };
+
+    struct StoredFeature {
+        std::shared_ptr<CNFeature> feature;
+        Envelope envelope;
+    };
+
+    struct Job {
+        CellKey cell;
+        uint64_t generation;
+        std::vector<std::pair<std::string, std::string>> query;
+    };
+
+    ~Impl() { StopWorkers(); }
+
+    bool FetchCapabilities(WfsCapabilities* capabilities, std::string* error) const;
+    bool Get(const std::string& url, CNWFSResponse* response, std::string* error) const;
+    bool ParsePage(const std::string& body, std::vector<ParsedFeature>* features,
+                   std::string* error) const;
+    bool BuildFeatureDefn(const std::string& body, std::string* error);
+
+    std::vector<std::pair<std::string, std::string>> BuildQuery(const CellKey& cell) const;
+    Envelope CellEnvelope(const CellKey& cell) const;
+    std::vector<CellKey> CellsFor(const Envelope& area) const;
+
+    bool IsCoveredLocked(const CellKey& cell) const;
+    void EnqueueLocked(const std::vector<CellKey>& cells);
+    void WaitLocked(std::unique_lock<std::mutex>& lock, const std::vector<CellKey>& cells);
+    bool CollectLocked(const std::vector<CellKey>& cells,
+                       std::vector<std::shared_ptr<CNFeature>>* out);
+    int64_t AssignFidLocked(const std::string& server_id);
+    void ClearLocked();
+
+    void StartWorkersLocked();
+    void StopWorkers();
+    void WorkerLoop();
+    bool FetchCell(const Job& job, std::vector<ParsedFeature>* features, std::string* error);
+
+    void BuildSnapshot();
+
     CNWFSConnectionParams params_;
     std::string type_name_;
+    std::shared_ptr<CNWFSTransport> transport_;
     std::shared_ptr<CNFeatureDefn> feature_defn_;
     void* spatial_ref_ = nullptr;
     Envelope extent_;
-    bool extent_loaded_ = false;
-    bool preloaded_ = false;
-    std::vector<std::unique_ptr<CNFeature>> features_;
-    size_t read_cursor_ = 0;
+    double cell_size_ = 0.0;
+
     std::unique_ptr<CNGeometry> spatial_filter_;
     Envelope filter_extent_;
     std::string attribute_filter_;
@@ -28,8 +256,554 @@ public:
     std::string sort_by_property_;
     bool sort_ascending_ = true;
     std::string output_format_;
+
+    std::vector<std::shared_ptr<CNFeature>> snapshot_;
+    bool snapshot_valid_ = false;
+    size_t read_cursor_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string revision_;
+    std::map<CellKey, CellEntry> cells_;
+    std::unordered_map<int64_t, StoredFeature> features_;
+    std::unordered_map<std::string, int64_t> server_ids_;
+    std::unordered_set<int64_t> used_fids_;
+    int64_t next_fid_ = 1;
+    uint64_t next_generation_ = 1;
+    std::deque<Job> jobs_;
+    size_t pending_ = 0;
+    std::vector<std::thread> workers_;
+    bool stop_ = false;
+    std::string last_error_;
+    CNWFSCacheStats stats_;
+    mutable std::atomic<int64_t> requests_{0};
 };
 
+bool CNWFSLayer::Impl::Get(const std::string& url, CNWFSResponse* response,
+                           std::string* error) const {
+    requests_.fetch_add(1);
+    if (!transport_->Get(url, params_.timeout_ms, *response)) {
+        *error = response->error.empty() ? "request failed: " + url : response->error;
+        return false;
+    }
+    if (response->status_code != 200) {
+        *error = "HTTP " + std::to_string(response->status_code) + " from " + url;
+        return false;
+    }
+    return true;
+}
+
+bool CNWFSLayer::Impl::FetchCapabilities(WfsCapabilities* capabilities,
+                                         std::string* error) const {
+    std::string url = AppendQuery(params_.url, {{"service", "WFS"},
+                                                {"request", "GetCapabilities"},
+                                                {"version", params_.version}});
+    CNWFSResponse response;
+    if (!Get(url, &response, error)) {
+        return false;
+    }
+    if (!ParseWfsCapabilities(response.body, capabilities)) {
+        *error = "invalid capabilities document";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::pair<std::string, std::string>> CNWFSLayer::Impl::BuildQuery(
+    const CellKey& cell) const {
+    bool v1 = IsVersion1(params_.version);
+    std::vector<std::pair<std::string, std::string>> query = {
+        {"service", "WFS"},
+        {"version", params_.version},
+        {"request", "GetFeature"},
+        {v1 ? "typeName" : "typeNames", type_name_},
+        {"outputFormat", output_format_.empty() ? "application/json" : output_format_}};
+    if (cell != kAllCell) {
+        Envelope box = CellEnvelope(cell);
+        std::string bbox = FormatNumber(box.GetMinX()) + "," + FormatNumber(box.GetMinY()) +
+                           "," + FormatNumber(box.GetMaxX()) + "," + FormatNumber(box.GetMaxY());
+        if (!bbox_crs_.empty()) {
+            bbox += "," + bbox_crs_;
+        } else if (!IsVersion10(params_.version)) {
+            bbox += std::string(",") + kDefaultBBoxCrs;
+        }
+        query.emplace_back("bbox", bbox);
+    }
+    if (!sort_by_property_.empty()) {
+        query.emplace_back("sortBy", sort_by_property_ +
+                                         (v1 ? (sort_ascending_ ? " A" : " D")
+                                             : (sort_ascending_ ? " ASC" : " DESC")));
+    }
+    return query;
+}
+
+Envelope CNWFSLayer::Impl::CellEnvelope(const CellKey& cell) const {
+    double x = static_cast<double>(cell.first) * cell_size_;
+    double y = static_cast<double>(cell.second) * cell_size_;
+    return Envelope(x, y, x + cell_size_, y + cell_size_);
+}
+
+std::vector<CellKey> CNWFSLayer::Impl::CellsFor(const Envelope& area) const {
+    if (cell_size_ <= 0.0 || area.IsNull()) {
+        return {kAllCell};
+    }
+    double x0 = std::floor(area.GetMinX() / cell_size_);
+    double y0 = std::floor(area.GetMinY() / cell_size_);
+    double x1 = std::floor(area.GetMaxX() / cell_size_);
+    double y1 = std::floor(area.GetMaxY() / cell_size_);
+    if (!std::isfinite(x0) || !std::isfinite(y0) || !std::isfinite(x1) || !std::isfinite(y1) ||
+        (x1 - x0 + 1.0) * (y1 - y0 + 1.0) > static_cast<double>(kMaxQueryCells)) {
+        return {kAllCell};
+    }
+    std::vector<CellKey> cells;
+    for (int64_t y = static_cast<int64_t>(y0); y <= static_cast<int64_t>(y1); ++y) {
+        for (int64_t x = static_cast<int64_t>(x0); x <= static_cast<int64_t>(x1); ++x) {
+            cells.emplace_back(x, y);
+        }
+    }
+    return cells;
+}
+
+bool CNWFSLayer::Impl::ParsePage(const std::string& body, std::vector<ParsedFeature>* features,
+                                 std::string* error) const {
+    const char* start = SkipSpace(body);
+    if (*start == '{') {
+        CNGeoJSONReader reader;
+        if (!reader.OpenBuffer(start, body.size() - (start - body.c_str()))) {
+            *error = reader.GetError().empty() ? "invalid GeoJSON response" : reader.GetError();
+            return false;
+        }
+        reader.SetFeatureDefn(feature_defn_.get());
+        while (std::unique_ptr<CNFeature> feature = reader.ReadNextFeature()) {
+            ParsedFeature parsed;
+            parsed.server_id = reader.GetFeatureId();
+            parsed.feature = std::move(feature);
+            features->push_back(std::move(parsed));
+        }
+        if (reader.HasError()) {
+            *error = reader.GetError();
+            return false;
+        }
+        return true;
+    }
+    if (*start != '<') {
+        *error = "unrecognised response format";
+        return false;
+    }
+    std::vector<GmlFeature> gml;
+    if (!ParseGmlFeatures(start, body.size() - (start - body.c_str()), &gml, error)) {
+        return false;
+    }
+    for (GmlFeature& source : gml) {
+        ParsedFeature parsed;
+        parsed.server_id = source.id;
+        parsed.feature.reset(new CNFeature(feature_defn_.get()));
+        for (const GmlProperty& property : source.properties) {
+            int index = feature_defn_->GetFieldIndex(property.name.c_str());
+            if (index < 0) {
+                continue;
+            }
+            size_t i = static_cast<size_t>(index);
+            int64_t integer = 0;
+            double real = 0.0;
+            if (property.is_null) {
+                parsed.feature->SetFieldNull(i);
+                continue;
+            }
+            switch (feature_defn_->GetFieldDefn(i)->GetType()) {
+                case CNFieldType::kInteger:
+                    if (ParseInteger(property.value, &integer) &&
+                        integer >= std::numeric_limits<int32_t>::min() &&
+                        integer <= std::numeric_limits<int32_t>::max()) {
+                        parsed.feature->SetFieldInteger(i, static_cast<int32_t>(integer));
+                    } else {
+                        parsed.feature->SetFieldNull(i);
+                    }
+                    break;
+                case CNFieldType::kInteger64:
+                    if (ParseInteger(property.value, &integer)) {
+                        parsed.feature->SetFieldInteger64(i, integer);
+                    } else {
+                        parsed.feature->SetFieldNull(i);
+                    }
+                    break;
+                case CNFieldType::kReal:
+                    if (ParseReal(property.value, &real)) {
+                        parsed.feature->SetFieldReal(i, real);
+                    } else {
+                        parsed.feature->SetFieldNull(i);
+                    }
+                    break;
+                default:
+                    parsed.feature->SetFieldString(i, property.value);
+                    break;
+            }
+        }
+        if (source.geometry) {
+            parsed.feature->SetGeometry(std::move(source.geometry));
+        }
+        features->push_back(std::move(parsed));
+    }
+    return true;
+}
+
+bool CNWFSLayer::Impl::BuildFeatureDefn(const std::string& body, std::string* error) {
+    const char* start = SkipSpace(body);
+    CNFeatureDefn* defn = nullptr;
+    if (*start == '{') {
+        CNGeoJSONReader reader;
+        if (reader.OpenBuffer(start, body.size() - (start - body.c_str()))) {
+            defn = reader.BuildFeatureDefn(type_name_, 0);
+        }
+        if (!defn) {
+            *error = reader.GetError().empty() ? "invalid GeoJSON response" : reader.GetError();
+            return false;
+        }
+    } else if (*start == '<') {
+        std::vector<GmlFeature> gml;
+        if (!ParseGmlFeatures(start, body.size() - (start - body.c_str()), &gml, error)) {
+            return false;
+        }
+        // Property types are inferred from the text of the sampled values.
+        std::vector<std::string> names;
+        std::vector<CNFieldType> types;
+        GeomType geom_type = GeomType::kUnknown;
+        bool mixed_geometry = false;
+        for (const GmlFeature& feature : gml) {
+            for (const GmlProperty& property : feature.properties) {
+                size_t i = std::find(names.begin(), names.end(), property.name) - names.begin();
+                if (i == names.size()) {
+                    names.push_back(property.name);
+                    types.push_back(CNFieldType::kInteger);
+                }
+                if (property.is_null) {
+                    continue;
+                }
+                int64_t integer = 0;
+                double real = 0.0;
+                if (types[i] == CNFieldType::kInteger || types[i] == CNFieldType::kInteger64) {
+                    if (ParseInteger(property.value, &integer)) {
+                        if (integer < std::numeric_limits<int32_t>::min() ||
+                            integer > std::numeric_limits<int32_t>::max()) {
+                            types[i] = CNFieldType::kInteger64;
+                        }
+                        continue;
+                    }
+                    types[i] = CNFieldType::kReal;
+                }
+                if (types[i] == CNFieldType::kReal && !ParseReal(property.value, &real)) {
+                    types[i] = CNFieldType::kString;
+                }
+            }
+            if (feature.geometry && !mixed_geometry) {
+                GeomType type = feature.geometry->GetGeometryType();
+                if (geom_type == GeomType::kUnknown) {
+                    geom_type = type;
+                } else if (geom_type != type) {
+                    geom_type = GeomType::kUnknown;
+                    mixed_geometry = true;
+                }
+            }
+        }
+        defn = CNFeatureDefn::Create(type_name_.c_str());
+        for (size_t i = 0; i < names.size(); ++i) {
+            CNFieldDefn* field = CreateCNFieldDefn(names[i].c_str());
+            field->SetType(types[i]);
+            defn->AddFieldDefn(field);
+        }
+        CNGeomFieldDefn* geom_field = CreateCNGeomFieldDefn("geom");
+        geom_field->SetGeomType(geom_type);
+        defn->AddGeomFieldDefn(geom_field);
+    } else {
+        *error = "unrecognised response format";
+        return false;
+    }
+    feature_defn_ = std::shared_ptr<CNFeatureDefn>(
+        defn, [](CNFeatureDefn* d) { d->ReleaseReference(); });
+    return true;
+}
+
+bool CNWFSLayer::Impl::IsCoveredLocked(const CellKey& cell) const {
+    for (const CellKey& key : {kAllCell, cell}) {
+        auto it = cells_.find(key);
+        if (it != cells_.end() && it->second.state == CellState::kComplete &&
+            it->second.revision == revision_) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CNWFSLayer::Impl::EnqueueLocked(const std::vector<CellKey>& cells) {
+    for (const CellKey& cell : cells) {
+        if (IsCoveredLocked(cell)) {
+            ++stats_.cell_hits;
+            continue;
+        }
+        CellEntry& entry = cells_[cell];
+        if (entry.state == CellState::kPending && entry.generation != 0 &&
+            entry.revision == revision_) {
+            continue;
+        }
+        entry = CellEntry();
+        entry.revision = revision_;
+        entry.generation = next_generation_++;
+        Job job;
+        job.cell = cell;
+        job.generation = entry.generation;
+        job.query = BuildQuery(cell);
+        jobs_.push_back(std::move(job));
+        ++pending_;
+    }
+    if (!jobs_.empty()) {
+        StartWorkersLocked();
+        cv_.notify_all();
+    }
+}
+
+void CNWFSLayer::Impl::WaitLocked(std::unique_lock<std::mutex>& lock,
+                                  const std::vector<CellKey>& cells) {
+    cv_.wait(lock, [&] {
+        for (const CellKey& cell : cells) {
+            if (IsCoveredLocked(cell)) {
+                continue;
+            }
+            auto it = cells_.find(cell);
+            if (it != cells_.end() && it->second.state == CellState::kPending &&
+                it->second.revision == revision_) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+bool CNWFSLayer::Impl::CollectLocked(const std::vector<CellKey>& cells,
+                                     std::vector<std::shared_ptr<CNFeature>>* out) {
+    out->clear();
+    auto matches = [&](const StoredFeature& stored) {
+        return filter_extent_.IsNull() ||
+               (!stored.envelope.IsNull() && stored.envelope.Intersects(filter_extent_));
+    };
+    std::vector<std::pair<int64_t, std::shared_ptr<CNFeature>>> found;
+    auto all = cells_.find(kAllCell);
+    if (all != cells_.end() && all->second.state == CellState::kComplete &&
+        all->second.revision == revision_) {
+        for (const auto& entry : features_) {
+            if (matches(entry.second)) {
+                found.emplace_back(entry.first, entry.second.feature);
+            }
+        }
+    } else {
+        std::unordered_set<int64_t> seen;
+        for (const CellKey& cell : cells) {
+            // A missing or failed cell fails the read rather than leaving a hole.
+            auto it = cells_.find(cell);
+            if (it == cells_.end() || it->second.state != CellState::kComplete ||
+                it->second.revision != revision_) {
+                return false;
+            }
+            for (int64_t fid : it->second.fids) {
+                auto feature = features_.find(fid);
+                if (feature != features_.end() && seen.insert(fid).second &&
+                    matches(feature->second)) {
+                    found.emplace_back(fid, feature->second.feature);
+                }
+            }
+        }
+    }
+    std::sort(found.begin(), found.end(),
+              [](const std::pair<int64_t, std::shared_ptr<CNFeature>>& a,
+                 const std::pair<int64_t, std::shared_ptr<CNFeature>>& b) {
+                  return a.first < b.first;
+              });
+    out->reserve(found.size());
+    for (auto& entry : found) {
+        out->push_back(std::move(entry.second));
+    }
+    return true;
+}
+
+int64_t CNWFSLayer::Impl::AssignFidLocked(const std::string& server_id) {
+    if (!server_id.empty()) {
+        auto it = server_ids_.find(server_id);
+        if (it != server_ids_.end()) {
+            return it->second;
+        }
+    }
+    // Ids such as "roads.42" keep their number as FID when it is free.
+    int64_t fid = -1;
+    size_t digits = server_id.size();
+    while (digits > 0 && server_id[digits - 1] >= '0' && server_id[digits - 1] <= '9') {
+        --digits;
+    }
+    int64_t number = 0;
+    if (digits < server_id.size() && server_id.size() - digits <= 18 &&
+        ParseInteger(server_id.substr(digits), &number) && used_fids_.count(number) == 0) {
+        fid = number;
+    }
+    if (fid < 0) {
+        while (used_fids_.count(next_fid_) != 0) {
+            ++next_fid_;
+        }
+        fid = next_fid_++;
+    }
+    used_fids_.insert(fid);
+    if (!server_id.empty()) {
+        server_ids_[server_id] = fid;
+    }
+    return fid;
+}
+
+void CNWFSLayer::Impl::ClearLocked() {
+    cells_.clear();
+    features_.clear();
+    snapshot_valid_ = false;
+}
+
+void CNWFSLayer::Impl::StartWorkersLocked() {
+    size_t wanted = static_cast<size_t>(std::max(1, params_.worker_count));
+    while (workers_.size() < wanted && workers_.size() < pending_) {
+        workers_.emplace_back(&Impl::WorkerLoop, this);
+    }
+}
+
+void CNWFSLayer::Impl::StopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        jobs_.clear();
+    }
+    cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+bool CNWFSLayer::Impl::FetchCell(const Job& job, std::vector<ParsedFeature>* features,
+                                 std::string* error) {
+    const int page_size = std::max(1, params_.max_features);
+    bool v1 = IsVersion1(params_.version);
+    std::unordered_set<std::string> seen;
+    for (int64_t start = 0;; ) {
+        std::vector<std::pair<std::string, std::string>> query = job.query;
+        query.emplace_back(v1 ? "maxFeatures" : "count", std::to_string(page_size));
+        query.emplace_back("startIndex", std::to_string(start));
+        CNWFSResponse response;
+        if (!Get(AppendQuery(params_.url, query), &response, error)) {
+            return false;
+        }
+        size_t before = features->size();
+        if (!ParsePage(response.body, features, error)) {
+            return false;
+        }
+        // startIndex is not part of WFS 1.x; a server ignoring it sends the
+        // same page again, which ends the cell.
+        bool repeated = false;
+        bool anonymous = false;
+        size_t kept = before;
+        for (size_t i = before; i < features->size(); ++i) {
+            ParsedFeature& parsed = (*features)[i];
+            if (parsed.server_id.empty()) {
+                anonymous = true;
+            } else if (!seen.insert(parsed.server_id).second) {
+                repeated = true;
+                continue;
+            }
+            if (kept != i) {
+                (*features)[kept] = std::move(parsed);
+            }
+            ++kept;
+        }
+        features->resize(kept);
+        size_t received = kept - before;
+        if (received == 0 || repeated) {
+            return true;
+        }
+        start += static_cast<int64_t>(received);
+        if (v1) {
+            // Without ids a repeated page cannot be told apart.
+            if (anonymous || received < static_cast<size_t>(page_size)) {
+                return true;
+            }
+        } else {
+            // A 2.0 server may cap pages below count, so a short page only
+            // ends the cell when the server says nothing more matches.
+            const char* body = SkipSpace(response.body);
+            PageInfo info = ReadPageInfo(body, response.body.c_str() + response.body.size());
+            if ((info.number_matched >= 0 && start >= info.number_matched) ||
+                info.has_next == 0) {
+                return true;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cells_.find(job.cell);
+        if (stop_ || it == cells_.end() || it->second.generation != job.generation) {
+            return false;
+        }
+    }
+}
+
+void CNWFSLayer::Impl::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (stop_) {
+            return;
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+
+        std::vector<ParsedFeature> features;
+        std::string error;
+        bool ok = FetchCell(job, &features, &error);
+
+        lock.lock();
+        --pending_;
+        auto it = cells_.find(job.cell);
+        // Cells dropped by Refresh or ClearCache while in flight are discarded.
+        if (!stop_ && it != cells_.end() && it->second.generation == job.generation) {
+            CellEntry& entry = it->second;
+            if (ok) {
+                entry.fids.reserve(features.size());
+                for (ParsedFeature& parsed : features) {
+                    int64_t fid = AssignFidLocked(parsed.server_id);
+                    parsed.feature->SetFID(fid);
+                    StoredFeature& stored = features_[fid];
+                    const CNGeometry* geometry = parsed.feature->GetGeometryRef();
+                    if (geometry) {
+                        stored.envelope = geometry->GetEnvelope();
+                    } else {
+                        stored.envelope.SetNull();
+                    }
+                    stored.feature.reset(parsed.feature.release());
+                    entry.fids.push_back(fid);
+                }
+                entry.state = CellState::kComplete;
+                ++stats_.cells_fetched;
+            } else {
+                entry.state = CellState::kFailed;
+                last_error_ = error;
+            }
+        }
+        cv_.notify_all();
+    }
+}
+
+void CNWFSLayer::Impl::BuildSnapshot() {
+    std::vector<CellKey> cells = CellsFor(filter_extent_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    EnqueueLocked(cells);
+    WaitLocked(lock, cells);
+    if (!CollectLocked(cells, &snapshot_) && last_error_.empty()) {
+        last_error_ = "feature fetch did not complete";
+    }
+    snapshot_valid_ = true;
+    read_cursor_ = 0;
+}
+
 CNWFSLayer::CNWFSLayer()
     : impl_(new Impl()) {
 }
@@ -39,19 +813,90 @@ CNWFSLayer::~CNWFSLayer() = default;
 std::unique_ptr<CNWFSLayer> CNWFSLayer::Connect(
     const CNWFSConnectionParams& params,
     const std::string& type_name) {
-    (void)params;
-    (void)type_name;
-    return nullptr;
+    return Connect(params, type_name, nullptr);
+}
+
+std::unique_ptr<CNWFSLayer> CNWFSLayer::Connect(
+    const CNWFSConnectionParams& params,
+    const std::string& type_name,
+    std::shared_ptr<CNWFSTransport> transport) {
+    HttpUrl url;
+    if (type_name.empty() || !ParseHttpUrl(params.url, &url)) {
+        return nullptr;
+    }
+    std::unique_ptr<CNWFSLayer> layer(new CNWFSLayer());
+    Impl& impl = *layer->impl_;
+    impl.params_ = params;
+    impl.type_name_ = type_name;
+    impl.transport_ = transport ? transport
+                                : CNWFSTransport::CreateHttp(params.user, params.password);
+
+    WfsCapabilities capabilities;
+    std::string error;
+    if (!impl.FetchCapabilities(&capabilities, &error)) {
+        return nullptr;
+    }
+    const WfsFeatureTypeInfo* info = nullptr;
+    for (const WfsFeatureTypeInfo& candidate : capabilities.feature_types) {
+        size_t colon = candidate.name.find(':');
+        if (candidate.name == type_name ||
+            (colon != std::string::npos && candidate.name.compare(colon + 1,
+                                                                  std::string::npos,
+                                                                  type_name) == 0)) {
+            info = &candidate;
+            break;
+        }
+    }
+    if (!info) {
+        return nullptr;
+    }
+    impl.revision_ = capabilities.update_sequence;
+    impl.extent_ = info->wgs84_extent;
+
+    // Fields are inferred from a small first page.
+    std::vector<std::pair<std::string, std::string>> query = impl.BuildQuery(kAllCell);
+    query.emplace_back(IsVersion1(params.version) ? "maxFeatures" : "count",
+                       std::to_string(std::max(1, std::min(params.max_features,
+                                                           kSchemaProbeCount))));
+    CNWFSResponse response;
+    if (!impl.Get(AppendQuery(params.url, query), &response, &error) ||
+        !impl.BuildFeatureDefn(response.body, &error)) {
+        return nullptr;
+    }
+
+    if (params.cell_size > 0.0) {
+        impl.cell_size_ = params.cell_size;
+    } else if (!impl.extent_.IsNull()) {
+        double side = std::max(impl.extent_.GetWidth(), impl.extent_.GetHeight());
+        impl.cell_size_ = side > 0.0 ? side / kDefaultCellsPerSide : 0.0;
+    }
+    return layer;
 }
 
 std::string CNWFSLayer::GetCapabilities(const std::string& url) {
-    (void)url;
-    return "";
+    HttpUrl parsed;
+    if (!ParseHttpUrl(url, &parsed)) {
+        return "";
+    }
+    CNWFSResponse response;
+    std::string request = AppendQuery(url, {{"service", "WFS"}, {"request", "GetCapabilities"}});
+    if (!CNWFSTransport::CreateHttp()->Get(request, 30000, response) ||
+        response.status_code != 200) {
+        return "";
+    }
+    return response.body;
 }
 
 std::vector<std::string> CNWFSLayer::ListLayers(const std::string& url) {
-    (void)url;
-    return {};
+    WfsCapabilities capabilities;
+    if (!ParseWfsCapabilities(GetCapabilities(url), &capabilities)) {
+        return {};
+    }
+    std::vector<std::string> names;
+    for (const WfsFeatureTypeInfo& info : capabilities.feature_types) {
+        names.push_back(info.name);
+    }
+    return names;
 }
 
 const std::string& CNWFSLayer::GetName() const {
@@ -86,17 +931,45 @@ const void* CNWFSLayer::GetSpatialRef() const {
 }
 
 CNStatus CNWFSLayer::GetExtent(Envelope& extent, bool force) const {
-    (void)force;
-    extent = impl_->extent_;
-    return CNStatus::kSuccess;
+    if (!impl_->extent_.IsNull()) {
+        extent = impl_->extent_;
+        return CNStatus::kSuccess;
+    }
+    if (!force) {
+        return CNStatus::kError;
+    }
+    CNStatus status = const_cast<CNWFSLayer*>(this)->PreloadAll();
+    if (status != CNStatus::kSuccess) {
+        return status;
+    }
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    extent.SetNull();
+    for (const auto& entry : impl_->features_) {
+        if (!entry.second.envelope.IsNull()) {
+            extent.ExpandToInclude(entry.second.envelope);
+        }
+    }
+    return extent.IsNull() ? CNStatus::kError : CNStatus::kSuccess;
 }
 
 int64_t CNWFSLayer::GetFeatureCount(bool force) const {
-    (void)force;
-    return static_cast<int64_t>(impl_->features_.size());
+    Impl& impl = *impl_;
+    std::vector<CellKey> cells = impl.CellsFor(impl.filter_extent_);
+    std::unique_lock<std::mutex> lock(impl.mutex_);
+    if (force) {
+        impl.EnqueueLocked(cells);
+        impl.WaitLocked(lock, cells);
+    }
+    std::vector<std::shared_ptr<CNFeature>> features;
+    if (!impl.CollectLocked(cells, &features)) {
+        return -1;
+    }
+    return static_cast<int64_t>(features.size());
 }
 
 void CNWFSLayer::ResetReading() {
+    impl_->snapshot_valid_ = false;
+    impl_->snapshot_.clear();
     impl_->read_cursor_ = 0;
 }
 
@@ -109,32 +982,43 @@ std::unique_ptr<CNFeature> CNWFSLayer::GetNextFeature() {
 }
 
 CNFeature* CNWFSLayer::GetNextFeatureRef() {
-    if (impl_->read_cursor_ >= impl_->features_.size()) {
+    if (!impl_->snapshot_valid_) {
+        impl_->BuildSnapshot();
+    }
+    if (impl_->read_cursor_ >= impl_->snapshot_.size()) {
         return nullptr;
     }
-    return impl_->features_[impl_->read_cursor_++].get();
+    return impl_->snapshot_[impl_->read_cursor_++].get();
 }
 
 std::unique_ptr<CNFeature> CNWFSLayer::GetFeature(int64_t fid) {
-    for (auto& f : impl_->features_) {
-        if (f->GetFID() == fid) {
-            return std::unique_ptr<CNFeature>(f->Clone());
-        }
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    auto it = impl_->features_.find(fid);
+    if (it == impl_->features_.end()) {
+        return nullptr;
     }
-    return nullptr;
+    return std::unique_ptr<CNFeature>(it->second.feature->Clone());
 }
 
 void CNWFSLayer::SetSpatialFilterRect(double min_x, double min_y,
                                        double max_x, double max_y) {
-    impl_->filter_extent_ = Envelope(min_x, max_x, min_y, max_y);
+    auto rect = Polygon::CreateRectangle(min_x, min_y, max_x, max_y);
+    SetSpatialFilter(rect.get());
 }
 
 void CNWFSLayer::SetSpatialFilter(const CNGeometry* geometry) {
     if (geometry) {
         impl_->spatial_filter_.reset(geometry->Clone().release());
+        impl_->filter_extent_ = geometry->GetEnvelope();
     } else {
         impl_->spatial_filter_.reset();
+        impl_->filter_extent_.SetNull();
     }
+    ResetReading();
+    // Start fetching the newly exposed cells before the first read.
+    std::vector<CellKey> cells = impl_->CellsFor(impl_->filter_extent_);
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    impl_->EnqueueLocked(cells);
 }
 
 const CNGeometry* CNWFSLayer::GetSpatialFilter() const {
@@ -149,7 +1033,7 @@ CNStatus CNWFSLayer::SetAttributeFilter(const std::string& query) {
 bool CNWFSLayer::TestCapability(CNLayerCapability capability) const {
     switch (capability) {
         case CNLayerCapability::kRandomRead:
-        case CNLayerCapability::kFastFeatureCount:
+        case CNLayerCapability::kFastSpatialFilter:
         case CNLayerCapability::kFastGetExtent:
         case CNLayerCapability::kSequentialRead:
             return true;
@@ -158,6 +1042,21 @@ bool CNWFSLayer::TestCapability(CNLayerCapability capability) const {
     }
 }
 
+std::unique_ptr<CNLayer> CNWFSLayer::Clone() const {
+    std::unique_ptr<CNWFSLayer> layer = Connect(impl_->params_, impl_->type_name_,
+                                                impl_->transport_);
+    if (!layer) {
+        return nullptr;
+    }
+    layer->impl_->bbox_crs_ = impl_->bbox_crs_;
+    layer->impl_->sort_by_property_ = impl_->sort_by_property_;
+    layer->impl_->sort_ascending_ = impl_->sort_ascending_;
+    layer->impl_->output_format_ = impl_->output_format_;
+    layer->SetAttributeFilter(impl_->attribute_filter_);
+    layer->SetSpatialFilter(impl_->spatial_filter_.get());
+    return std::unique_ptr<CNLayer>(layer.release());
+}
+
 std::string CNWFSLayer::GetServiceURL() const {
     return impl_->params_.url;
 }
@@ -167,21 +1066,95 @@ std::string CNWFSLayer::GetTypeName() const {
 }
 
 void CNWFSLayer::SetBBOXCRS(const std::string& crs) {
-    impl_->bbox_crs_ = crs;
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    if (impl_->bbox_crs_ != crs) {
+        impl_->bbox_crs_ = crs;
+        impl_->ClearLocked();
+    }
 }
 
 void CNWFSLayer::SetSortBy(const std::string& property, bool ascending) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
     impl_->sort_by_property_ = property;
     impl_->sort_ascending_ = ascending;
 }
 
 void CNWFSLayer::SetOutputFormat(const std::string& format) {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
     impl_->output_format_ = format;
 }
 
 CNStatus CNWFSLayer::PreloadAll() {
-    impl_->preloaded_ = true;
+    std::vector<CellKey> cells = {kAllCell};
+    std::unique_lock<std::mutex> lock(impl_->mutex_);
+    impl_->EnqueueLocked(cells);
+    impl_->WaitLocked(lock, cells);
+    return impl_->IsCoveredLocked(kAllCell) ? CNStatus::kSuccess : CNStatus::kIOError;
+}
+
+void CNWFSLayer::Prefetch(double min_x, double min_y, double max_x, double max_y) {
+    std::vector<CellKey> cells = impl_->CellsFor(Envelope(min_x, min_y, max_x, max_y));
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    impl_->EnqueueLocked(cells);
+}
+
+bool CNWFSLayer::WaitForFetches(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(impl_->mutex_);
+    auto idle = [this] { return impl_->pending_ == 0; };
+    if (timeout_ms < 0) {
+        impl_->cv_.wait(lock, idle);
+        return true;
+    }
+    return impl_->cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), idle);
+}
+
+CNStatus CNWFSLayer::Refresh() {
+    WfsCapabilities capabilities;
+    std::string error;
+    if (!impl_->FetchCapabilities(&capabilities, &error)) {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        impl_->last_error_ = error;
+        return CNStatus::kIOError;
+    }
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    if (capabilities.update_sequence != impl_->revision_) {
+        impl_->revision_ = capabilities.update_sequence;
+        impl_->ClearLocked();
+    }
     return CNStatus::kSuccess;
 }
 
+std::string CNWFSLayer::GetServerRevision() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->revision_;
+}
+
+double CNWFSLayer::GetCellSize() const {
+    return impl_->cell_size_;
+}
+
+void CNWFSLayer::ClearCache() {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    impl_->ClearLocked();
+}
+
+CNWFSCacheStats CNWFSLayer::GetCacheStats() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    CNWFSCacheStats stats = impl_->stats_;
+    stats.requests = impl_->requests_.load();
+    for (const auto& entry : impl_->cells_) {
+        if (entry.second.state == Impl::CellState::kComplete &&
+            entry.second.revision == impl_->revision_) {
+            ++stats.cached_cells;
+        }
+    }
+    stats.cached_features = static_cast<int64_t>(impl_->features_.size());
+    return stats;
+}
+
+std::string CNWFSLayer::GetLastError() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex_);
+    return impl_->last_error_;
+}
+
 } // namespace ogc
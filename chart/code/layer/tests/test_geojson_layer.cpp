@@ -0,0 +1,314 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/geojson_layer.h"
+#include "ogc/layer/geojson_stream.h"
+#include "ogc/layer/geometry_compat.h"
+#include "ogc/feature/feature.h"
+#include "ogc/feature/feature_defn.h"
+#include "ogc/feature/field_defn.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/linestring.h"
+#include "ogc/geom/multipolygon.h"
+#include "ogc/geom/point.h"
+#include "ogc/geom/polygon.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace ogc;
+
+namespace {
+
+void WriteText(const std::string& path, const std::string& text) {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out << text;
+}
+
+std::unique_ptr<CNFeature> ReadOne(const std::string& json, CNFeatureDefn** defn_out = nullptr) {
+    CNGeoJSONReader reader;
+    if (!reader.OpenBuffer(json.data(), json.size())) {
+        return nullptr;
+    }
+    CNFeatureDefn* defn = reader.BuildFeatureDefn("test", 0);
+    std::unique_ptr<CNFeature> feature = reader.ReadNextFeature();
+    if (defn_out) {
+        *defn_out = defn;
+    } else if (defn) {
+        defn->ReleaseReference();
+    }
+    return feature;
+}
+
+} // namespace
+
+class CNGeoJSONLayerStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = "./test_geojson_stations.geojson";
+    }
+
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+
+    // Writes a size x size grid of points; feature (x, y) has id y * size + x.
+    void WriteGrid(int size) {
+        std::unique_ptr<CNVectorLayer> layer = CNGeoJSONLayer::Create(path_);
+        ASSERT_NE(layer, nullptr);
+        CNFieldDefn* name = CreateCNFieldDefn("name");
+        name->SetType(CNFieldType::kString);
+        CNFieldDefn* lanes = CreateCNFieldDefn("lanes");
+        lanes->SetType(CNFieldType::kInteger);
+        CNFieldDefn* depth = CreateCNFieldDefn("depth");
+        depth->SetType(CNFieldType::kReal);
+        ASSERT_EQ(layer->CreateField(name), CNStatus::kSuccess);
+        ASSERT_EQ(layer->CreateField(lanes), CNStatus::kSuccess);
+        ASSERT_EQ(layer->CreateField(depth), CNStatus::kSuccess);
+        delete name;
+        delete lanes;
+        delete depth;
+
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                CNFeature feature(layer->GetFeatureDefn());
+                feature.SetFID(y * size + x);
+                feature.SetGeometry(Point::Create(x, y));
+                feature.SetFieldString("name", "S\"" + std::to_string(y * size + x));
+                feature.SetFieldInteger("lanes", x % 4);
+                feature.SetFieldReal("depth", x * 0.5);
+                ASSERT_EQ(layer->CreateFeature(&feature), CNStatus::kSuccess);
+            }
+        }
+        EXPECT_EQ(layer->GetFeatureCount(), size * size);
+        Envelope extent;
+        EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+        EXPECT_DOUBLE_EQ(extent.GetMaxX(), size - 1.0);
+    }
+
+    std::string path_;
+};
+
+TEST_F(CNGeoJSONLayerStreamTest, WriteThenStreamBack) {
+    WriteGrid(40);
+    auto layer = CNGeoJSONLayer::Open(path_);
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetName(), "test_geojson_stations");
+    EXPECT_EQ(layer->GetFormatName(), "GeoJSON");
+    EXPECT_TRUE(layer->IsReadOnly());
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPoint);
+    ASSERT_EQ(layer->GetFeatureDefn()->GetFieldCount(), 3u);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(0)->GetType(), CNFieldType::kString);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(1)->GetType(), CNFieldType::kInteger);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(2)->GetType(), CNFieldType::kReal);
+
+    int64_t count = 0;
+    while (CNFeature* feature = layer->GetNextFeatureRef()) {
+        EXPECT_EQ(feature->GetFID(), count);
+        ++count;
+    }
+    EXPECT_EQ(count, 1600);
+    EXPECT_EQ(layer->GetFeatureCount(), 1600);
+
+    layer->ResetReading();
+    std::unique_ptr<CNFeature> feature = layer->GetNextFeature();
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "S\"0");
+    auto* point = dynamic_cast<const Point*>(feature->GetGeometryRef());
+    ASSERT_NE(point, nullptr);
+    EXPECT_DOUBLE_EQ(point->GetX(), 0.0);
+    EXPECT_FALSE(point->Is3D());
+
+    Envelope extent;
+    EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+    EXPECT_DOUBLE_EQ(extent.GetMaxY(), 39.0);
+}
+
+TEST_F(CNGeoJSONLayerStreamTest, SpatialFilterAndGetFeature) {
+    WriteGrid(40);
+    auto layer = CNGeoJSONLayer::Open(path_);
+    ASSERT_NE(layer, nullptr);
+
+    std::unique_ptr<CNFeature> feature = layer->GetFeature(41);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 41);
+    EXPECT_EQ(feature->GetFieldAsInteger("lanes"), 1);
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal("depth"), 0.5);
+    EXPECT_EQ(layer->GetFeature(100000), nullptr);
+
+    layer->SetSpatialFilterRect(10.0, 10.0, 14.5, 12.5);
+    EXPECT_EQ(layer->GetFeatureCount(), 15);
+    int count = 0;
+    while (CNFeature* next = layer->GetNextFeatureRef()) {
+        auto* point = dynamic_cast<const Point*>(next->GetGeometryRef());
+        ASSERT_NE(point, nullptr);
+        EXPECT_GE(point->GetX(), 10.0);
+        EXPECT_LE(point->GetY(), 12.5);
+        ++count;
+    }
+    EXPECT_EQ(count, 15);
+
+    std::unique_ptr<CNLayer> clone = layer->Clone();
+    ASSERT_NE(clone, nullptr);
+    EXPECT_EQ(clone->GetFeatureCount(), 15);
+}
+
+TEST_F(CNGeoJSONLayerStreamTest, InfersTypesAndReadsMembersInAnyOrder) {
+    WriteText(path_,
+        "\xEF\xBB\xBF{ \"name\": \"mixed\", \"features\" : [\n"
+        "  { \"properties\": { \"a\": 1, \"b\": true, \"c\": 1, \"d\": {\"x\": [1, 2]} },\n"
+        "    \"geometry\": { \"coordinates\": [[0, 0], [4, 0], [4, 4], [0, 0]],\n"
+        "                    \"type\": \"LineString\" },\n"
+        "    \"type\": \"Feature\", \"id\": \"text-id\" },\n"
+        "  { \"type\": \"Feature\", \"geometry\": null,\n"
+        "    \"properties\": { \"a\": 5000000000, \"b\": \"yes\", \"c\": 2.5, \"e\": null } }\n"
+        "], \"type\": \"FeatureCollection\" }");
+    auto layer = CNGeoJSONLayer::Open(path_);
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kLineString);
+    const CNFeatureDefn* defn = layer->GetFeatureDefn();
+    ASSERT_EQ(defn->GetFieldCount(), 5u);
+    EXPECT_EQ(defn->GetFieldDefn(0)->GetType(), CNFieldType::kInteger64);
+    EXPECT_EQ(defn->GetFieldDefn(1)->GetType(), CNFieldType::kString);
+    EXPECT_EQ(defn->GetFieldDefn(2)->GetType(), CNFieldType::kReal);
+    EXPECT_EQ(defn->GetFieldDefn(3)->GetType(), CNFieldType::kString);
+
+    std::unique_ptr<CNFeature> first = layer->GetNextFeature();
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->GetFID(), 0);
+    EXPECT_EQ(first->GetFieldAsString("b"), "true");
+    EXPECT_EQ(first->GetFieldAsString("d"), "{\"x\": [1, 2]}");
+    auto* line = dynamic_cast<const LineString*>(first->GetGeometryRef());
+    ASSERT_NE(line, nullptr);
+    EXPECT_EQ(line->GetNumPoints(), 4u);
+
+    std::unique_ptr<CNFeature> second = layer->GetNextFeature();
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(second->GetFID(), 1);
+    EXPECT_EQ(second->GetFieldAsInteger64("a"), 5000000000LL);
+    EXPECT_TRUE(second->IsFieldNull(4));
+    EXPECT_EQ(second->GetGeometryRef(), nullptr);
+    EXPECT_EQ(layer->GetNextFeature(), nullptr);
+}
+
+TEST(CNGeoJSONReaderTest, ParsesNumbersAndEscapes) {
+    std::unique_ptr<CNFeature> feature = ReadOne(
+        "{\"type\":\"Feature\",\"id\":7,\"geometry\":{\"type\":\"Point\","
+        "\"coordinates\":[-122.41941550000001,3.7e1,-1.5E-3]},\"properties\":"
+        "{\"s\":\"tab\\there \\u00e9\\ud83d\\ude00\",\"r\":0.1,\"big\":123456789012345678901}}");
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 7);
+    EXPECT_EQ(feature->GetFieldAsString("s"), "tab\there \xC3\xA9\xF0\x9F\x98\x80");
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal("r"), 0.1);
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal("big"), 123456789012345678901.0);
+    auto* point = dynamic_cast<const Point*>(feature->GetGeometryRef());
+    ASSERT_NE(point, nullptr);
+    EXPECT_EQ(point->GetX(), -122.41941550000001);
+    EXPECT_EQ(point->GetY(), 37.0);
+    EXPECT_TRUE(point->Is3D());
+    EXPECT_EQ(point->GetZ(), -0.0015);
+}
+
+TEST(CNGeoJSONReaderTest, ParsesPolygonsAndCollections) {
+    std::unique_ptr<CNFeature> feature = ReadOne(
+        "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\","
+        "\"geometry\":{\"type\":\"MultiPolygon\",\"coordinates\":["
+        "[[[0,0],[10,0],[10,10],[0,10],[0,0]],[[2,2],[3,2],[3,3],[2,2]]],"
+        "[[[20,20],[21,20],[21,21],[20,20]]]]},\"properties\":{}}]}");
+    ASSERT_NE(feature, nullptr);
+    auto* multi = dynamic_cast<const MultiPolygon*>(feature->GetGeometryRef());
+    ASSERT_NE(multi, nullptr);
+    ASSERT_EQ(multi->GetNumGeometries(), 2u);
+    auto* polygon = dynamic_cast<const Polygon*>(multi->GetGeometryN(0));
+    ASSERT_NE(polygon, nullptr);
+    EXPECT_EQ(polygon->GetNumInteriorRings(), 1u);
+
+    feature = ReadOne(
+        "{\"type\":\"Feature\",\"geometry\":{\"geometries\":[{\"type\":\"Point\","
+        "\"coordinates\":[1,2]},{\"type\":\"LineString\",\"coordinates\":[[0,0],[1,1]]}],"
+        "\"type\":\"GeometryCollection\"},\"properties\":null}");
+    ASSERT_NE(feature, nullptr);
+    ASSERT_NE(feature->GetGeometryRef(), nullptr);
+    EXPECT_EQ(feature->GetGeometryRef()->GetGeometryType(), GeomType::kGeometryCollection);
+    EXPECT_EQ(feature->GetGeometryRef()->GetNumGeometries(), 2u);
+}
+
+TEST(CNGeoJSONReaderTest, TellAndSeekResumeAtFeature) {
+    std::string json =
+        "{\"type\":\"FeatureCollection\",\"features\":[\n"
+        "{\"type\":\"Feature\",\"geometry\":null,\"properties\":{\"n\":0}},\n"
+        "{\"type\":\"Feature\",\"geometry\":null,\"properties\":{\"n\":1}},\n"
+        "{\"type\":\"Feature\",\"geometry\":null,\"properties\":{\"n\":2}}\n]}";
+    CNGeoJSONReader reader;
+    ASSERT_TRUE(reader.OpenBuffer(json.data(), json.size()));
+    CNFeatureDefn* defn = reader.BuildFeatureDefn("seek", 0);
+    ASSERT_NE(defn, nullptr);
+    ASSERT_TRUE(reader.SkipNextFeature());
+    size_t offset = reader.Tell();
+    int64_t sequence = reader.GetSequence();
+    ASSERT_TRUE(reader.SkipNextFeature());
+    ASSERT_TRUE(reader.SkipNextFeature());
+    EXPECT_FALSE(reader.SkipNextFeature());
+    EXPECT_FALSE(reader.HasError());
+
+    ASSERT_TRUE(reader.Seek(offset, sequence));
+    std::unique_ptr<CNFeature> feature = reader.ReadNextFeature();
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 1);
+    EXPECT_EQ(feature->GetFieldAsInteger("n"), 1);
+    defn->ReleaseReference();
+}
+
+TEST(CNGeoJSONReaderTest, ReportsSyntaxErrors) {
+    const char* inputs[] = {
+        "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\" \"geometry\":null}]}",
+        "{\"type\":\"FeatureCollection\",\"features\":[{\"geometry\":{\"type\":\"Point\","
+        "\"coordinates\":[1]}}]}",
+        "{\"type\":\"FeatureCollection\",\"features\":[{\"properties\":{\"a\":\"open",
+    };
+    for (const char* input : inputs) {
+        std::string json(input);
+        CNGeoJSONReader reader;
+        ASSERT_TRUE(reader.OpenBuffer(json.data(), json.size())) << input;
+        EXPECT_EQ(reader.ReadNextFeature(), nullptr) << input;
+        EXPECT_TRUE(reader.HasError()) << input;
+    }
+
+    std::string not_geojson = "[1, 2, 3]";
+    CNGeoJSONReader reader;
+    EXPECT_FALSE(reader.OpenBuffer(not_geojson.data(), not_geojson.size()));
+    EXPECT_TRUE(reader.HasError());
+}
+
+TEST_F(CNGeoJSONLayerStreamTest, WriterEscapesAndSkipsUnsetFields) {
+    CNFeatureDefn* defn = CNFeatureDefn::Create("out");
+    CNFieldDefn* text = CreateCNFieldDefn("text");
+    text->SetType(CNFieldType::kString);
+    defn->AddFieldDefn(text);
+    CNFieldDefn* flag = CreateCNFieldDefn("flag");
+    flag->SetType(CNFieldType::kBoolean);
+    defn->AddFieldDefn(flag);
+
+    CNGeoJSONWriter writer;
+    ASSERT_TRUE(writer.Open(path_));
+    writer.SetPrecision(6);
+    {
+        CNFeature feature(defn);
+        feature.SetFID(3);
+        feature.SetGeometry(Point::Create(1.0 / 3.0, 2.0));
+        feature.SetFieldString("text", "line\nbreak \\ \"quoted\"");
+        ASSERT_TRUE(writer.WriteFeature(feature));
+    }
+    EXPECT_EQ(writer.GetFeatureCount(), 1);
+    ASSERT_TRUE(writer.Close());
+    defn->ReleaseReference();
+
+    std::ifstream in(path_.c_str(), std::ios::binary);
+    std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(json.find("\"coordinates\":[0.333333,2]"), std::string::npos) << json;
+    EXPECT_EQ(json.find("flag"), std::string::npos) << json;
+
+    std::unique_ptr<CNFeature> feature = ReadOne(json);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 3);
+    EXPECT_EQ(feature->GetFieldAsString("text"), "line\nbreak \\ \"quoted\"");
+}
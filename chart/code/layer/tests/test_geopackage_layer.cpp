@@ -0,0 +1,256 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/geopackage_layer.h"
+#include "ogc/layer/geometry_compat.h"
+#include "ogc/feature/feature.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/point.h"
+
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ogc;
+
+namespace {
+
+void AddInt32LE(std::vector<uint8_t>& buf, int32_t v) {
+    uint32_t u = static_cast<uint32_t>(v);
+    for (int i = 0; i < 4; ++i) {
+        buf.push_back(static_cast<uint8_t>(u >> (8 * i)));
+    }
+}
+
+void AddDouble(std::vector<uint8_t>& buf, double v) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &v, 8);
+    buf.insert(buf.end(), bytes, bytes + 8);
+}
+
+// Little-endian GeoPackage point blob with an XY envelope.
+std::vector<uint8_t> MakePointBlob(double x, double y) {
+    std::vector<uint8_t> blob = {'G', 'P', 0, 0x03};
+    AddInt32LE(blob, 4326);
+    AddDouble(blob, x);
+    AddDouble(blob, x);
+    AddDouble(blob, y);
+    AddDouble(blob, y);
+    blob.push_back(1);
+    AddInt32LE(blob, 1);
+    AddDouble(blob, x);
+    AddDouble(blob, y);
+    return blob;
+}
+
+void Exec(sqlite3* db, const char* sql) {
+    char* error = nullptr;
+    ASSERT_EQ(sqlite3_exec(db, sql, nullptr, nullptr, &error), SQLITE_OK)
+        << (error ? error : "") << " in " << sql;
+}
+
+// Builds a grid of size x size points; feature (x, y) has fid y * size + x + 1.
+void WriteGeoPackage(const std::string& path, int size, bool with_rtree) {
+    std::remove(path.c_str());
+    sqlite3* db = nullptr;
+    ASSERT_EQ(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+    Exec(db, "BEGIN");
+    Exec(db, "CREATE TABLE gpkg_spatial_ref_sys (srs_name TEXT, srs_id INTEGER PRIMARY KEY, "
+             "organization TEXT, organization_coordsys_id INTEGER, definition TEXT)");
+    Exec(db, "INSERT INTO gpkg_spatial_ref_sys VALUES ('WGS 84', 4326, 'EPSG', 4326, '')");
+    Exec(db, "CREATE TABLE gpkg_contents (table_name TEXT PRIMARY KEY, data_type TEXT, "
+             "identifier TEXT, description TEXT, last_change DATETIME, min_x DOUBLE, "
+             "min_y DOUBLE, max_x DOUBLE, max_y DOUBLE, srs_id INTEGER)");
+    Exec(db, "CREATE TABLE gpkg_geometry_columns (table_name TEXT, column_name TEXT, "
+             "geometry_type_name TEXT, srs_id INTEGER, z TINYINT, m TINYINT)");
+    Exec(db, "CREATE TABLE stations (fid INTEGER PRIMARY KEY AUTOINCREMENT, geom POINT, "
+             "name TEXT, lanes MEDIUMINT, depth DOUBLE)");
+    std::string contents = "INSERT INTO gpkg_contents VALUES ('stations', 'features', "
+                           "'stations', '', '', 0, 0, " + std::to_string(size - 1) + ", " +
+                           std::to_string(size - 1) + ", 4326)";
+    Exec(db, contents.c_str());
+    Exec(db, "INSERT INTO gpkg_geometry_columns VALUES ('stations', 'geom', 'POINT', 4326, 0, 0)");
+    if (with_rtree) {
+        Exec(db, "CREATE VIRTUAL TABLE rtree_stations_geom USING rtree(id, minx, maxx, miny, maxy)");
+    }
+
+    sqlite3_stmt* insert = nullptr;
+    ASSERT_EQ(sqlite3_prepare_v2(db, "INSERT INTO stations VALUES (?, ?, ?, ?, ?)",
+                                 -1, &insert, nullptr), SQLITE_OK);
+    sqlite3_stmt* index = nullptr;
+    if (with_rtree) {
+        ASSERT_EQ(sqlite3_prepare_v2(db, "INSERT INTO rtree_stations_geom VALUES (?, ?, ?, ?, ?)",
+                                     -1, &index, nullptr), SQLITE_OK);
+    }
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int64_t fid = y * size + x + 1;
+            std::vector<uint8_t> blob = MakePointBlob(x, y);
+            std::string name = "S" + std::to_string(fid);
+            sqlite3_bind_int64(insert, 1, fid);
+            sqlite3_bind_blob(insert, 2, blob.data(), static_cast<int>(blob.size()), SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 3, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(insert, 4, x % 4);
+            sqlite3_bind_double(insert, 5, x * 0.5);
+            ASSERT_EQ(sqlite3_step(insert), SQLITE_DONE);
+            sqlite3_reset(insert);
+            if (index) {
+                sqlite3_bind_int64(index, 1, fid);
+                sqlite3_bind_double(index, 2, x);
+                sqlite3_bind_double(index, 3, x);
+                sqlite3_bind_double(index, 4, y);
+                sqlite3_bind_double(index, 5, y);
+                ASSERT_EQ(sqlite3_step(index), SQLITE_DONE);
+                sqlite3_reset(index);
+            }
+        }
+    }
+    sqlite3_finalize(insert);
+    sqlite3_finalize(index);
+    Exec(db, "COMMIT");
+    sqlite3_close(db);
+}
+
+} // namespace
+
+// The .gpkg files under arcpro/ are text placeholders rather than SQLite
+// databases, so the fixtures are generated here.
+class CNGeoPackageLayerReadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = "./test_geopackage_stations.gpkg";
+        WriteGeoPackage(path_, 40, true);
+    }
+
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+
+    std::string path_;
+};
+
+TEST_F(CNGeoPackageLayerReadTest, OpenReadsSchemaAndExtent) {
+    auto layer = CNGeoPackageLayer::Open(path_, "stations");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetName(), "stations");
+    EXPECT_EQ(layer->GetFormatName(), "GeoPackage");
+    EXPECT_TRUE(layer->IsReadOnly());
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPoint);
+    ASSERT_EQ(layer->GetFeatureDefn()->GetFieldCount(), 3u);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(1)->GetType(), CNFieldType::kInteger);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(2)->GetType(), CNFieldType::kReal);
+    EXPECT_EQ(layer->GetFeatureCount(), 1600);
+    EXPECT_TRUE(layer->TestCapability(CNLayerCapability::kFastSpatialFilter));
+
+    Envelope extent;
+    EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+    EXPECT_DOUBLE_EQ(extent.GetMaxX(), 39.0);
+
+    auto first = CNGeoPackageLayer::Open(path_, "");
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->GetName(), "stations");
+}
+
+TEST_F(CNGeoPackageLayerReadTest, StreamsFeaturesInPages) {
+    auto layer = CNGeoPackageLayer::Open(path_, "stations");
+    ASSERT_NE(layer, nullptr);
+    static_cast<CNGeoPackageLayer*>(layer.get())->SetPageSize(64);
+
+    int64_t count = 0;
+    int64_t last_fid = 0;
+    while (CNFeature* feature = layer->GetNextFeatureRef()) {
+        EXPECT_GT(feature->GetFID(), last_fid);
+        last_fid = feature->GetFID();
+        ++count;
+    }
+    EXPECT_EQ(count, 1600);
+
+    layer->ResetReading();
+    std::unique_ptr<CNFeature> feature = layer->GetNextFeature();
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 1);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "S1");
+    auto* point = dynamic_cast<const Point*>(feature->GetGeometryRef());
+    ASSERT_NE(point, nullptr);
+    EXPECT_DOUBLE_EQ(point->GetX(), 0.0);
+    EXPECT_FALSE(point->Is3D());
+}
+
+TEST_F(CNGeoPackageLayerReadTest, SpatialFilterUsesRTree) {
+    auto layer = CNGeoPackageLayer::Open(path_, "stations");
+    ASSERT_NE(layer, nullptr);
+    layer->SetSpatialFilterRect(10.0, 10.0, 14.5, 12.5);
+
+    EXPECT_EQ(layer->GetFeatureCount(), 15);
+    int count = 0;
+    while (CNFeature* feature = layer->GetNextFeatureRef()) {
+        auto* point = dynamic_cast<const Point*>(feature->GetGeometryRef());
+        ASSERT_NE(point, nullptr);
+        EXPECT_GE(point->GetX(), 10.0);
+        EXPECT_LE(point->GetY(), 12.5);
+        ++count;
+    }
+    EXPECT_EQ(count, 15);
+
+    layer->SetSpatialFilter(nullptr);
+    EXPECT_EQ(layer->GetFeatureCount(), 1600);
+}
+
+TEST_F(CNGeoPackageLayerReadTest, SpatialFilterWithoutRTree) {
+    std::string path = "./test_geopackage_no_rtree.gpkg";
+    WriteGeoPackage(path, 20, false);
+    auto layer = CNGeoPackageLayer::Open(path, "stations");
+    ASSERT_NE(layer, nullptr);
+    static_cast<CNGeoPackageLayer*>(layer.get())->SetPageSize(7);
+    EXPECT_FALSE(layer->TestCapability(CNLayerCapability::kFastSpatialFilter));
+
+    layer->SetSpatialFilterRect(10.0, 10.0, 14.5, 12.5);
+    int count = 0;
+    while (layer->GetNextFeatureRef()) {
+        ++count;
+    }
+    EXPECT_EQ(count, 15);
+    EXPECT_EQ(layer->GetFeatureCount(), 15);
+
+    layer.reset();
+    std::remove(path.c_str());
+}
+
+TEST_F(CNGeoPackageLayerReadTest, AttributeFilterIsPushedIntoQuery) {
+    auto layer = CNGeoPackageLayer::Open(path_, "stations");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->SetAttributeFilter("lanes = 2"), CNStatus::kSuccess);
+    layer->SetSpatialFilterRect(0.0, 0.0, 9.0, 0.0);
+    EXPECT_EQ(layer->GetFeatureCount(), 2);
+
+    auto clone = layer->Clone();
+    ASSERT_NE(clone, nullptr);
+    int count = 0;
+    while (CNFeature* feature = clone->GetNextFeatureRef()) {
+        EXPECT_EQ(feature->GetFieldAsInteger("lanes"), 2);
+        ++count;
+    }
+    EXPECT_EQ(count, 2);
+
+    EXPECT_EQ(layer->SetAttributeFilter("no_such_column = 1"), CNStatus::kInvalidParameter);
+    EXPECT_EQ(layer->GetFeatureCount(), 2);
+}
+
+TEST_F(CNGeoPackageLayerReadTest, GetFeatureByFid) {
+    auto layer = CNGeoPackageLayer::Open(path_, "stations");
+    ASSERT_NE(layer, nullptr);
+    layer->SetSpatialFilterRect(0.0, 0.0, 1.0, 1.0);
+
+    std::unique_ptr<CNFeature> feature = layer->GetFeature(42);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "S42");
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal("depth"), 0.5);
+    EXPECT_EQ(layer->GetFeature(100000), nullptr);
+}
+
+TEST_F(CNGeoPackageLayerReadTest, RejectsUpdateAndMissingTables) {
+    EXPECT_EQ(CNGeoPackageLayer::Open(path_, "stations", true), nullptr);
+    EXPECT_EQ(CNGeoPackageLayer::Open(path_, "missing"), nullptr);
+    EXPECT_EQ(CNGeoPackageLayer::Open("./does_not_exist.gpkg", "stations"), nullptr);
+}
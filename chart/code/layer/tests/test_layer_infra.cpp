@@ -11,6 +11,8 @@
 #include "ogc/feature/field_value.h"
 #include "ogc/geom/factory.h"
 
+#include <chrono>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 #include <atomic>
@@ -201,11 +203,205 @@ TEST_F(CNFeatureStreamTest, BackpressureConfigDefaults) {
     CNBackpressureConfig config;
     EXPECT_EQ(config.strategy, CNBackpressureStrategy::kBlock);
     EXPECT_EQ(config.max_buffer_size, 10000);
-    EXPECT_EQ(config.block_timeout_ms, 5000);
+    EXPECT_EQ(config.block_timeout_ms, 0);
     EXPECT_EQ(config.throttle_factor, 0.8);
     EXPECT_TRUE(config.enable_monitoring);
 }
 
+namespace {
+
+// Memory layer whose reads fail or stall after a given number of features.
+class ScriptedMemoryLayer : public CNMemoryLayer {
+public:
+    ScriptedMemoryLayer(int64_t fail_after, int64_t stall_after = -1)
+        : CNMemoryLayer("scripted", GeomType::kPoint),
+          fail_after_(fail_after), stall_after_(stall_after) {}
+
+    std::unique_ptr<CNFeature> GetNextFeature() override {
+        int64_t index = read_++;
+        if (index == fail_after_) {
+            throw std::runtime_error("read failed");
+        }
+        if (stall_after_ >= 0 && index >= stall_after_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return CNMemoryLayer::GetNextFeature();
+    }
+
+private:
+    int64_t fail_after_;
+    int64_t stall_after_;
+    int64_t read_ = 0;
+};
+
+void FillLayer(CNMemoryLayer* layer, int count) {
+    for (int i = 1; i <= count; ++i) {
+        CNFeature feature(layer->GetFeatureDefn());
+        feature.SetFID(i);
+        layer->CreateFeature(&feature);
+    }
+}
+
+// Waits until the producer has read the whole layer, kept or dropped.
+bool WaitForProducer(const CNLayerFeatureStream& stream, size_t total) {
+    for (int i = 0; i < 500; ++i) {
+        CNBackpressureStatus status = stream.GetBackpressureStatus();
+        if (status.total_produced + status.total_dropped >= total) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return false;
+}
+
+} // namespace
+
+TEST_F(CNFeatureStreamTest, ReadAheadKeepsOrderAcrossProducerBatches) {
+    CNLayerFeatureStream stream(layer_.get(), 4);
+
+    std::vector<int64_t> fids;
+    while (!stream.IsEndOfStream()) {
+        for (auto& feature : stream.ReadNextBatch(3)) {
+            fids.push_back(feature->GetFID());
+        }
+    }
+    ASSERT_EQ(fids.size(), 10u);
+    for (size_t i = 0; i < fids.size(); ++i) {
+        EXPECT_EQ(fids[i], static_cast<int64_t>(i + 1));
+    }
+    EXPECT_EQ(stream.GetStatus(), CNStatus::kSuccess);
+}
+
+TEST(CNFeatureStreamBackpressureTest, BlockStopsProducerAtHighWatermark) {
+    CNMemoryLayer layer("block", GeomType::kPoint);
+    FillLayer(&layer, 1000);
+    CNLayerFeatureStream stream(&layer, 10);
+    CNBackpressureConfig config;
+    config.max_buffer_size = 50;
+    config.throttle_factor = 0.5;
+    config.block_timeout_ms = 0;
+    stream.SetBackpressureConfig(config);
+
+    EXPECT_FALSE(stream.IsEndOfStream());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CNBackpressureStatus status = stream.GetBackpressureStatus();
+    EXPECT_TRUE(status.is_backpressured);
+    EXPECT_LE(status.current_buffer_size, 60u);
+    EXPECT_GE(status.total_blocked, 1u);
+
+    size_t total = 0;
+    while (!stream.IsEndOfStream()) {
+        total += stream.ReadNextBatch(25).size();
+    }
+    EXPECT_EQ(total, 1000u);
+    EXPECT_EQ(stream.GetBackpressureStatus().total_consumed, 1000u);
+}
+
+TEST(CNFeatureStreamBackpressureTest, DropShedsBatchesWhileBackpressured) {
+    CNMemoryLayer layer("drop", GeomType::kPoint);
+    FillLayer(&layer, 1000);
+    CNLayerFeatureStream stream(&layer, 10);
+    CNBackpressureConfig config;
+    config.strategy = CNBackpressureStrategy::kDrop;
+    config.max_buffer_size = 20;
+    stream.SetBackpressureConfig(config);
+
+    EXPECT_FALSE(stream.IsEndOfStream());
+    ASSERT_TRUE(WaitForProducer(stream, 1000));
+    CNBackpressureStatus status = stream.GetBackpressureStatus();
+    EXPECT_GT(status.total_dropped, 0u);
+
+    size_t total = 0;
+    while (!stream.IsEndOfStream()) {
+        total += stream.ReadNextBatch(100).size();
+    }
+    EXPECT_EQ(total, status.total_produced);
+    EXPECT_EQ(total + status.total_dropped, 1000u);
+}
+
+TEST(CNFeatureStreamBackpressureTest, BlockWaitsForSlowConsumerByDefault) {
+    CNMemoryLayer layer("slow", GeomType::kPoint);
+    FillLayer(&layer, 100);
+    CNLayerFeatureStream stream(&layer, 10);
+    CNBackpressureConfig config;
+    config.max_buffer_size = 10;
+    stream.SetBackpressureConfig(config);
+
+    EXPECT_FALSE(stream.IsEndOfStream());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    size_t total = 0;
+    while (!stream.IsEndOfStream()) {
+        total += stream.ReadNextBatch(10).size();
+    }
+    EXPECT_EQ(total, 100u);
+    EXPECT_EQ(stream.GetStatus(), CNStatus::kSuccess);
+}
+
+TEST(CNFeatureStreamBackpressureTest, BlockTimeoutEndsStreamWithStatus) {
+    CNMemoryLayer layer("timeout", GeomType::kPoint);
+    FillLayer(&layer, 100);
+    CNLayerFeatureStream stream(&layer, 10);
+    CNBackpressureConfig config;
+    config.max_buffer_size = 10;
+    config.block_timeout_ms = 10;
+    stream.SetBackpressureConfig(config);
+
+    EXPECT_FALSE(stream.IsEndOfStream());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    size_t total = 0;
+    while (!stream.IsEndOfStream()) {
+        total += stream.ReadNextBatch(100).size();
+    }
+    EXPECT_LT(total, 100u);
+    EXPECT_EQ(stream.GetStatus(), CNStatus::kTimeout);
+}
+
+TEST(CNFeatureStreamBackpressureTest, LayerErrorsReachConsumer) {
+    ScriptedMemoryLayer layer(25);
+    FillLayer(&layer, 100);
+    CNLayerFeatureStream stream(&layer, 10);
+
+    size_t total = 0;
+    while (!stream.IsEndOfStream()) {
+        total += stream.ReadNextBatch(10).size();
+    }
+    EXPECT_EQ(total, 25u);
+    EXPECT_EQ(stream.GetStatus(), CNStatus::kError);
+    EXPECT_EQ(stream.GetErrorMessage(), "read failed");
+
+    stream.Reset();
+    EXPECT_EQ(stream.GetStatus(), CNStatus::kSuccess);
+}
+
+TEST(CNFeatureStreamBackpressureTest, CloseWakesBlockedConsumer) {
+    ScriptedMemoryLayer layer(-1, 10);
+    FillLayer(&layer, 100);
+    CNLayerFeatureStream stream(&layer, 10);
+    ASSERT_EQ(stream.ReadNextBatch(10).size(), 10u);
+
+    std::thread closer([&stream] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stream.Close();
+    });
+    EXPECT_TRUE(stream.ReadNextBatch(10).empty());
+    closer.join();
+    EXPECT_TRUE(stream.IsEndOfStream());
+}
+
+TEST(CNFeatureStreamBackpressureTest, NoneReadsOnCallerThread) {
+    CNMemoryLayer layer("none", GeomType::kPoint);
+    FillLayer(&layer, 30);
+    CNLayerFeatureStream stream(&layer, 10);
+    CNBackpressureConfig config;
+    config.strategy = CNBackpressureStrategy::kNone;
+    stream.SetBackpressureConfig(config);
+
+    EXPECT_EQ(stream.ReadNextBatch(20).size(), 20u);
+    EXPECT_EQ(stream.ReadNextBatch(20).size(), 10u);
+    EXPECT_TRUE(stream.IsEndOfStream());
+    EXPECT_EQ(stream.GetBackpressureStatus().current_buffer_size, 0u);
+}
+
 class CNConnectionPoolTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/postgis_layer.h"
+#include "ogc/layer/geometry_compat.h"
+#include "ogc/feature/feature.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/point.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace ogc;
+
+namespace {
+
+// The layer tests need a PostgreSQL server with PostGIS. They run when
+// OGC_TEST_POSTGIS_DB names a database in which the table
+// ogc_layer_test_points(id serial primary key, geom geometry(Point, 4326),
+// name text, rank int4, depth numeric) holds the 40 x 40 grid
+// ST_MakePoint(x, y), x and y in 0..39, with id = y * 40 + x + 1,
+// name = 'P' || id, rank = x % 4 and depth = x * 0.5, and a GiST index on
+// geom. Host, port, user and password come from the OGC_TEST_POSTGIS_*
+// variables of the same names.
+bool GetTestParams(CNPostGISConnectionParams& params) {
+    const char* database = std::getenv("OGC_TEST_POSTGIS_DB");
+    if (!database || !*database) {
+        return false;
+    }
+    params.database = database;
+    if (const char* host = std::getenv("OGC_TEST_POSTGIS_HOST")) {
+        params.host = host;
+    }
+    if (const char* port = std::getenv("OGC_TEST_POSTGIS_PORT")) {
+        params.port = std::atoi(port);
+    }
+    if (const char* user = std::getenv("OGC_TEST_POSTGIS_USER")) {
+        params.user = user;
+    }
+    if (const char* password = std::getenv("OGC_TEST_POSTGIS_PASSWORD")) {
+        params.password = password;
+    }
+    params.table = "ogc_layer_test_points";
+    return true;
+}
+
+} // namespace
+
+class CNPostGISLayerServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        if (!GetTestParams(params_)) {
+            GTEST_SKIP() << "OGC_TEST_POSTGIS_DB not set";
+        }
+        std::unique_ptr<CNVectorLayer> layer = CNPostGISLayer::Open(params_);
+        ASSERT_NE(layer, nullptr) << "cannot open " << params_.table;
+        layer_.reset(static_cast<CNPostGISLayer*>(layer.release()));
+    }
+
+    CNPostGISConnectionParams params_;
+    std::unique_ptr<CNPostGISLayer> layer_;
+};
+
+TEST(CNPostGISLayerOpenTest, RejectsUpdateAndIncompleteParams) {
+    CNPostGISConnectionParams params;
+    params.database = "testdb";
+    params.table = "points";
+    EXPECT_EQ(CNPostGISLayer::Open(params, true), nullptr);
+
+    params.geom_column.clear();
+    EXPECT_EQ(CNPostGISLayer::Open(params), nullptr);
+}
+
+TEST_F(CNPostGISLayerServerTest, ReadsSchema) {
+    EXPECT_EQ(layer_->GetGeomType(), GeomType::kPoint);
+    ASSERT_EQ(layer_->GetFeatureDefn()->GetFieldCount(), 3u);
+    EXPECT_EQ(layer_->GetFeatureDefn()->GetFieldDefn(1)->GetType(), CNFieldType::kInteger);
+    EXPECT_EQ(layer_->GetFeatureDefn()->GetFieldDefn(2)->GetType(), CNFieldType::kReal);
+    EXPECT_TRUE(layer_->TestCapability(CNLayerCapability::kRandomRead));
+    EXPECT_EQ(layer_->GetFeatureCount(), 1600);
+}
+
+TEST_F(CNPostGISLayerServerTest, StreamsThroughCursorInFetches) {
+    layer_->SetFetchSize(64);
+    int64_t count = 0;
+    int64_t last_fid = 0;
+    while (CNFeature* feature = layer_->GetNextFeatureRef()) {
+        EXPECT_GT(feature->GetFID(), last_fid);
+        last_fid = feature->GetFID();
+        ++count;
+    }
+    EXPECT_EQ(count, 1600);
+
+    layer_->ResetReading();
+    std::unique_ptr<CNFeature> feature = layer_->GetNextFeature();
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 1);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "P1");
+    auto* point = dynamic_cast<const Point*>(feature->GetGeometryRef());
+    ASSERT_NE(point, nullptr);
+    EXPECT_DOUBLE_EQ(point->GetX(), 0.0);
+}
+
+TEST_F(CNPostGISLayerServerTest, PushesFiltersAndFieldSubset) {
+    layer_->SetSpatialFilterRect(10.0, 10.0, 14.5, 12.5);
+    EXPECT_EQ(layer_->GetFeatureCount(), 15);
+
+    EXPECT_EQ(layer_->SetAttributeFilter("rank = 2"), CNStatus::kSuccess);
+    EXPECT_EQ(layer_->GetFeatureCount(), 3);
+    EXPECT_EQ(layer_->SetAttributeFilter("no_such_column = 1"), CNStatus::kInvalidParameter);
+
+    EXPECT_EQ(layer_->SetSelectedFields({"missing"}), CNStatus::kFieldNotFound);
+    ASSERT_EQ(layer_->SetSelectedFields({"rank"}), CNStatus::kSuccess);
+    int count = 0;
+    while (CNFeature* feature = layer_->GetNextFeatureRef()) {
+        EXPECT_EQ(feature->GetFieldAsInteger("rank"), 2);
+        EXPECT_FALSE(feature->IsFieldSet(0));
+        ++count;
+    }
+    EXPECT_EQ(count, 3);
+
+    std::unique_ptr<CNLayer> clone = layer_->Clone();
+    ASSERT_NE(clone, nullptr);
+    EXPECT_EQ(clone->GetFeatureCount(), 3);
+}
+
+TEST_F(CNPostGISLayerServerTest, GetFeatureAndTransactions) {
+    std::unique_ptr<CNFeature> feature = layer_->GetFeature(42);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "P42");
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal("depth"), 0.5);
+    EXPECT_EQ(layer_->GetFeature(100000), nullptr);
+
+    ASSERT_EQ(layer_->StartTransaction(), CNStatus::kSuccess);
+    EXPECT_EQ(layer_->StartTransaction(), CNStatus::kTransactionActive);
+    int count = 0;
+    while (layer_->GetNextFeatureRef()) {
+        ++count;
+    }
+    EXPECT_EQ(count, 1600);
+    EXPECT_EQ(layer_->CommitTransaction(), CNStatus::kSuccess);
+}
@@ -0,0 +1,317 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/shapefile_layer.h"
+#include "ogc/layer/geometry_compat.h"
+#include "ogc/feature/feature.h"
+#include "ogc/feature/field_value.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/polygon.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace ogc;
+
+namespace {
+
+void PutInt32BE(std::vector<uint8_t>& buf, size_t pos, int32_t v) {
+    uint32_t u = static_cast<uint32_t>(v);
+    buf[pos] = static_cast<uint8_t>(u >> 24);
+    buf[pos + 1] = static_cast<uint8_t>(u >> 16);
+    buf[pos + 2] = static_cast<uint8_t>(u >> 8);
+    buf[pos + 3] = static_cast<uint8_t>(u);
+}
+
+void AddInt32LE(std::vector<uint8_t>& buf, int32_t v) {
+    uint32_t u = static_cast<uint32_t>(v);
+    for (int i = 0; i < 4; ++i) {
+        buf.push_back(static_cast<uint8_t>(u >> (8 * i)));
+    }
+}
+
+void AddDouble(std::vector<uint8_t>& buf, double v) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &v, 8);
+    buf.insert(buf.end(), bytes, bytes + 8);
+}
+
+struct ShapeRecord {
+    std::vector<uint8_t> content;
+};
+
+ShapeRecord MakePoint(double x, double y) {
+    ShapeRecord record;
+    AddInt32LE(record.content, 1);
+    AddDouble(record.content, x);
+    AddDouble(record.content, y);
+    return record;
+}
+
+ShapeRecord MakePolygon(const std::vector<std::vector<std::pair<double, double>>>& rings) {
+    ShapeRecord record;
+    double min_x = 1e300, min_y = 1e300, max_x = -1e300, max_y = -1e300;
+    int32_t num_points = 0;
+    for (const auto& ring : rings) {
+        for (const auto& p : ring) {
+            min_x = std::min(min_x, p.first);
+            min_y = std::min(min_y, p.second);
+            max_x = std::max(max_x, p.first);
+            max_y = std::max(max_y, p.second);
+        }
+        num_points += static_cast<int32_t>(ring.size());
+    }
+    AddInt32LE(record.content, 5);
+    AddDouble(record.content, min_x);
+    AddDouble(record.content, min_y);
+    AddDouble(record.content, max_x);
+    AddDouble(record.content, max_y);
+    AddInt32LE(record.content, static_cast<int32_t>(rings.size()));
+    AddInt32LE(record.content, num_points);
+    int32_t start = 0;
+    for (const auto& ring : rings) {
+        AddInt32LE(record.content, start);
+        start += static_cast<int32_t>(ring.size());
+    }
+    for (const auto& ring : rings) {
+        for (const auto& p : ring) {
+            AddDouble(record.content, p.first);
+            AddDouble(record.content, p.second);
+        }
+    }
+    return record;
+}
+
+std::vector<uint8_t> MakeHeader(int32_t shape_type, double min_x, double min_y,
+                                double max_x, double max_y, size_t file_size) {
+    std::vector<uint8_t> header(100, 0);
+    PutInt32BE(header, 0, 9994);
+    PutInt32BE(header, 24, static_cast<int32_t>(file_size / 2));
+    header[28] = 0xE8;
+    header[29] = 0x03;
+    std::vector<uint8_t> tail;
+    AddInt32LE(tail, shape_type);
+    AddDouble(tail, min_x);
+    AddDouble(tail, min_y);
+    AddDouble(tail, max_x);
+    AddDouble(tail, max_y);
+    std::copy(tail.begin(), tail.end(), header.begin() + 32);
+    return header;
+}
+
+void WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+/** Writes .shp/.shx/.dbf with a NAME (C 16) and DEPTH (N 8.2) column. */
+void WriteShapefile(const std::string& base, int32_t shape_type,
+                    const std::vector<ShapeRecord>& records,
+                    const std::vector<std::string>& names,
+                    double min_x, double min_y, double max_x, double max_y) {
+    std::vector<uint8_t> body;
+    std::vector<uint8_t> index;
+    for (size_t i = 0; i < records.size(); ++i) {
+        size_t offset = 100 + body.size();
+        std::vector<uint8_t> header(8, 0);
+        PutInt32BE(header, 0, static_cast<int32_t>(i + 1));
+        PutInt32BE(header, 4, static_cast<int32_t>(records[i].content.size() / 2));
+        body.insert(body.end(), header.begin(), header.end());
+        body.insert(body.end(), records[i].content.begin(), records[i].content.end());
+
+        std::vector<uint8_t> entry(8, 0);
+        PutInt32BE(entry, 0, static_cast<int32_t>(offset / 2));
+        PutInt32BE(entry, 4, static_cast<int32_t>(records[i].content.size() / 2));
+        index.insert(index.end(), entry.begin(), entry.end());
+    }
+
+    std::vector<uint8_t> shp = MakeHeader(shape_type, min_x, min_y, max_x, max_y, 100 + body.size());
+    shp.insert(shp.end(), body.begin(), body.end());
+    WriteFile(base + ".shp", shp);
+
+    std::vector<uint8_t> shx = MakeHeader(shape_type, min_x, min_y, max_x, max_y, 100 + index.size());
+    shx.insert(shx.end(), index.begin(), index.end());
+    WriteFile(base + ".shx", shx);
+
+    const size_t record_size = 1 + 16 + 8;
+    std::vector<uint8_t> dbf(32, 0);
+    dbf[0] = 0x03;
+    uint32_t count = static_cast<uint32_t>(records.size());
+    std::memcpy(&dbf[4], &count, 4);
+    uint16_t header_size = 32 + 2 * 32 + 1;
+    uint16_t rec_size = static_cast<uint16_t>(record_size);
+    std::memcpy(&dbf[8], &header_size, 2);
+    std::memcpy(&dbf[10], &rec_size, 2);
+
+    std::vector<uint8_t> name_field(32, 0);
+    std::memcpy(&name_field[0], "NAME", 4);
+    name_field[11] = 'C';
+    name_field[16] = 16;
+    dbf.insert(dbf.end(), name_field.begin(), name_field.end());
+
+    std::vector<uint8_t> depth_field(32, 0);
+    std::memcpy(&depth_field[0], "DEPTH", 5);
+    depth_field[11] = 'N';
+    depth_field[16] = 8;
+    depth_field[17] = 2;
+    dbf.insert(dbf.end(), depth_field.begin(), depth_field.end());
+    dbf.push_back(0x0D);
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        char row[record_size + 1];
+        std::snprintf(row, sizeof(row), " %-16s%8.2f", names[i].c_str(), static_cast<double>(i) * 0.5);
+        dbf.insert(dbf.end(), row, row + record_size);
+    }
+    dbf.push_back(0x1A);
+    WriteFile(base + ".dbf", dbf);
+}
+
+void RemoveShapefile(const std::string& base) {
+    for (const char* ext : {".shp", ".shx", ".dbf", ".qix"}) {
+        std::remove((base + ext).c_str());
+    }
+}
+
+} // namespace
+
+class CNShapefileLayerReadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        base_ = "./test_shapefile_points";
+        RemoveShapefile(base_);
+        std::vector<ShapeRecord> records;
+        std::vector<std::string> names;
+        for (int y = 0; y < 50; ++y) {
+            for (int x = 0; x < 50; ++x) {
+                records.push_back(MakePoint(x, y));
+                names.push_back("p" + std::to_string(y * 50 + x));
+            }
+        }
+        WriteShapefile(base_, 1, records, names, 0, 0, 49, 49);
+    }
+
+    void TearDown() override {
+        RemoveShapefile(base_);
+    }
+
+    std::string base_;
+};
+
+TEST_F(CNShapefileLayerReadTest, OpenReadsHeaderAndSchema) {
+    auto layer = CNShapefileLayer::Open(base_ + ".shp");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetName(), "test_shapefile_points");
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPoint);
+    EXPECT_EQ(layer->GetFeatureCount(), 2500);
+    EXPECT_TRUE(layer->IsReadOnly());
+
+    Envelope extent;
+    EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+    EXPECT_DOUBLE_EQ(extent.GetMaxX(), 49.0);
+
+    ASSERT_EQ(layer->GetFeatureDefn()->GetFieldCount(), 2u);
+    EXPECT_EQ(layer->GetFeatureDefn()->GetFieldDefn(1)->GetType(), CNFieldType::kReal);
+}
+
+TEST_F(CNShapefileLayerReadTest, DecodesRecordsLazily) {
+    auto layer = CNShapefileLayer::Open(base_ + ".shp");
+    ASSERT_NE(layer, nullptr);
+
+    auto feature = layer->GetFeature(51);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFID(), 51);
+    EXPECT_EQ(feature->GetFieldAsString(static_cast<size_t>(0)), "p51");
+    EXPECT_DOUBLE_EQ(feature->GetFieldAsReal(static_cast<size_t>(1)), 25.5);
+    const Envelope& env = feature->GetGeometryRef()->GetEnvelope();
+    EXPECT_DOUBLE_EQ(env.GetMinX(), 1.0);
+    EXPECT_DOUBLE_EQ(env.GetMinY(), 1.0);
+
+    EXPECT_EQ(layer->GetFeature(2500), nullptr);
+
+    int count = 0;
+    layer->ResetReading();
+    while (layer->GetNextFeatureRef()) {
+        ++count;
+    }
+    EXPECT_EQ(count, 2500);
+}
+
+TEST_F(CNShapefileLayerReadTest, SpatialFilterUsesQuadtree) {
+    auto layer = CNShapefileLayer::Open(base_ + ".shp");
+    ASSERT_NE(layer, nullptr);
+    auto* shapefile = static_cast<CNShapefileLayer*>(layer.get());
+    EXPECT_TRUE(shapefile->HasSpatialIndex());
+    EXPECT_TRUE(layer->TestCapability(CNLayerCapability::kFastSpatialFilter));
+
+    std::ifstream qix(base_ + ".qix", std::ios::binary);
+    EXPECT_TRUE(qix.good());
+
+    layer->SetSpatialFilterRect(10.5, 10.5, 13.5, 12.5);
+    EXPECT_EQ(layer->GetFeatureCount(), 6);
+
+    std::vector<int64_t> fids;
+    layer->ResetReading();
+    while (CNFeature* feature = layer->GetNextFeatureRef()) {
+        fids.push_back(feature->GetFID());
+    }
+    std::vector<int64_t> expected = {561, 562, 563, 611, 612, 613};
+    EXPECT_EQ(fids, expected);
+
+    auto reopened = CNShapefileLayer::Open(base_ + ".shp");
+    reopened->SetSpatialFilterRect(10.5, 10.5, 13.5, 12.5);
+    EXPECT_EQ(reopened->GetFeatureCount(), 6);
+
+    layer->SetSpatialFilter(nullptr);
+    EXPECT_EQ(layer->GetFeatureCount(), 2500);
+}
+
+TEST_F(CNShapefileLayerReadTest, FieldViewBorrowsDbfBytes) {
+    auto layer = CNShapefileLayer::Open(base_ + ".shp");
+    ASSERT_NE(layer, nullptr);
+    auto* shapefile = static_cast<CNShapefileLayer*>(layer.get());
+
+    const char* data = nullptr;
+    size_t size = 0;
+    ASSERT_TRUE(shapefile->GetFieldView(7, 0, &data, &size));
+    EXPECT_EQ(std::string(data, size), "p7");
+    ASSERT_TRUE(shapefile->GetFieldView(7, 1, &data, &size));
+    EXPECT_EQ(std::string(data, size), "3.50");
+    EXPECT_FALSE(shapefile->GetFieldView(7, 2, &data, &size));
+    EXPECT_FALSE(shapefile->GetFieldView(5000, 0, &data, &size));
+}
+
+TEST_F(CNShapefileLayerReadTest, UpdateModeIsRejected) {
+    EXPECT_EQ(CNShapefileLayer::Open(base_ + ".shp", true), nullptr);
+}
+
+TEST(CNShapefileLayerPolygonTest, AssignsHolesToOuterRings) {
+    std::string base = "./test_shapefile_polygons";
+    RemoveShapefile(base);
+    std::vector<ShapeRecord> records;
+    records.push_back(MakePolygon({
+        {{0, 0}, {0, 10}, {10, 10}, {10, 0}, {0, 0}},
+        {{2, 2}, {4, 2}, {4, 4}, {2, 4}, {2, 2}},
+        {{20, 0}, {20, 5}, {25, 5}, {25, 0}, {20, 0}}
+    }));
+    records.push_back(MakePolygon({
+        {{30, 30}, {30, 31}, {31, 31}, {31, 30}, {30, 30}}
+    }));
+    WriteShapefile(base, 5, records, {"multi", "single"}, 0, 0, 31, 31);
+
+    auto layer = CNShapefileLayer::Open(base + ".shp");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPolygon);
+
+    auto multi = layer->GetFeature(0);
+    ASSERT_NE(multi, nullptr);
+    EXPECT_EQ(multi->GetGeometryRef()->GetGeometryType(), GeomType::kMultiPolygon);
+
+    auto single = layer->GetFeature(1);
+    ASSERT_NE(single, nullptr);
+    ASSERT_EQ(single->GetGeometryRef()->GetGeometryType(), GeomType::kPolygon);
+    EXPECT_EQ(static_cast<const Polygon*>(single->GetGeometryRef())->GetNumInteriorRings(), 0u);
+
+    layer.reset();
+    RemoveShapefile(base);
+}
@@ -0,0 +1,675 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/tiled_raster_layer.h"
+#include "ogc/feature/feature.h"
+#include "ogc/geom/envelope.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef OGC_LAYER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace ogc;
+
+namespace {
+
+/**
+ * Minimal classic TIFF writer for the tests: each image becomes one IFD,
+ * the first holding the full resolution image and the rest overviews.
+ */
+class TiffBuilder {
+public:
+    struct Image {
+        int width = 0;
+        int height = 0;
+        int bands = 1;
+        int bits = 16;
+        int sample_format = 1;
+        int block_width = 0;   // 0 for strips
+        int block_height = 0;  // tile height, or rows per strip
+        bool deflate = false;
+        bool predictor = false;
+        std::vector<uint8_t> pixels;  // chunky, little-endian samples
+    };
+
+    explicit TiffBuilder(bool big_endian = false) : big_endian_(big_endian) {}
+
+    template <typename T>
+    static Image MakeImage(int width, int height, int bands, int sample_format,
+                           int block_width, int block_height,
+                           T (*value)(int x, int y, int band)) {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.bands = bands;
+        image.bits = static_cast<int>(sizeof(T) * 8);
+        image.sample_format = sample_format;
+        image.block_width = block_width;
+        image.block_height = block_height;
+        image.pixels.resize(static_cast<size_t>(width) * height * bands * sizeof(T));
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                for (int b = 0; b < bands; ++b) {
+                    T v = value(x, y, b);
+                    std::memcpy(&image.pixels[((static_cast<size_t>(y) * width + x) * bands + b) *
+                                              sizeof(T)],
+                                &v, sizeof(T));
+                }
+            }
+        }
+        return image;
+    }
+
+    void AddImage(const Image& image) { images_.push_back(image); }
+
+    void SetPixelScale(double sx, double sy) { scale_ = {sx, sy, 0.0}; }
+    void SetTiepoint(double x, double y) { tiepoint_ = {0.0, 0.0, 0.0, x, y, 0.0}; }
+    void SetNoData(const std::string& nodata) { nodata_ = nodata; }
+
+    bool Write(const std::string& path) {
+        out_.clear();
+        out_.push_back(big_endian_ ? 'M' : 'I');
+        out_.push_back(big_endian_ ? 'M' : 'I');
+        Put16(42);
+        size_t next_pointer = out_.size();
+        Put32(0);
+
+        for (size_t i = 0; i < images_.size(); ++i) {
+            const Image& image = images_[i];
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> counts;
+            WriteBlocks(image, &offsets, &counts);
+
+            std::vector<Entry> entries;
+            if (i > 0) {
+                entries.push_back(Longs(254, {1}));
+            }
+            entries.push_back(Longs(256, {static_cast<uint32_t>(image.width)}));
+            entries.push_back(Longs(257, {static_cast<uint32_t>(image.height)}));
+            entries.push_back(Shorts(258, std::vector<uint16_t>(
+                static_cast<size_t>(image.bands), static_cast<uint16_t>(image.bits))));
+            entries.push_back(Shorts(259, {static_cast<uint16_t>(image.deflate ? 8 : 1)}));
+            entries.push_back(Shorts(277, {static_cast<uint16_t>(image.bands)}));
+            if (image.predictor) {
+                entries.push_back(Shorts(317, {2}));
+            }
+            entries.push_back(Shorts(339, std::vector<uint16_t>(
+                static_cast<size_t>(image.bands), static_cast<uint16_t>(image.sample_format))));
+            if (image.block_width > 0) {
+                entries.push_back(Longs(322, {static_cast<uint32_t>(image.block_width)}));
+                entries.push_back(Longs(323, {static_cast<uint32_t>(image.block_height)}));
+                entries.push_back(Longs(324, offsets));
+                entries.push_back(Longs(325, counts));
+            } else {
+                entries.push_back(Longs(273, offsets));
+                entries.push_back(Longs(278, {static_cast<uint32_t>(image.block_height)}));
+                entries.push_back(Longs(279, counts));
+            }
+            if (i == 0 && !scale_.empty()) {
+                entries.push_back(Doubles(33550, scale_));
+                entries.push_back(Doubles(33922, tiepoint_));
+            }
+            if (i == 0 && !nodata_.empty()) {
+                Entry entry;
+                entry.tag = 42113;
+                entry.type = 2;
+                entry.count = static_cast<uint32_t>(nodata_.size() + 1);
+                entry.data.assign(nodata_.begin(), nodata_.end());
+                entry.data.push_back(0);
+                entries.push_back(entry);
+            }
+            std::sort(entries.begin(), entries.end(),
+                      [](const Entry& a, const Entry& b) { return a.tag < b.tag; });
+
+            if (out_.size() % 2) {
+                out_.push_back(0);
+            }
+            Patch32(next_pointer, static_cast<uint32_t>(out_.size()));
+            size_t ifd = out_.size();
+            size_t values = ifd + 2 + entries.size() * 12 + 4;
+            Put16(static_cast<uint16_t>(entries.size()));
+            std::vector<uint8_t> extra;
+            for (const Entry& entry : entries) {
+                Put16(entry.tag);
+                Put16(entry.type);
+                Put32(entry.count);
+                if (entry.data.size() <= 4) {
+                    std::vector<uint8_t> inline_value = entry.data;
+                    inline_value.resize(4, 0);
+                    out_.insert(out_.end(), inline_value.begin(), inline_value.end());
+                } else {
+                    Put32(static_cast<uint32_t>(values + extra.size()));
+                    extra.insert(extra.end(), entry.data.begin(), entry.data.end());
+                    if (extra.size() % 2) {
+                        extra.push_back(0);
+                    }
+                }
+            }
+            next_pointer = out_.size();
+            Put32(0);
+            out_.insert(out_.end(), extra.begin(), extra.end());
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(out_.data()),
+                   static_cast<std::streamsize>(out_.size()));
+        return file.good();
+    }
+
+private:
+    struct Entry {
+        uint16_t tag = 0;
+        uint16_t type = 0;
+        uint32_t count = 0;
+        std::vector<uint8_t> data;
+    };
+
+    void Encode(std::vector<uint8_t>* data, uint64_t value, size_t size) const {
+        for (size_t i = 0; i < size; ++i) {
+            size_t shift = big_endian_ ? (size - 1 - i) * 8 : i * 8;
+            data->push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void Put16(uint16_t value) { Encode(&out_, value, 2); }
+    void Put32(uint32_t value) { Encode(&out_, value, 4); }
+
+    void Patch32(size_t pos, uint32_t value) {
+        std::vector<uint8_t> bytes;
+        Encode(&bytes, value, 4);
+        std::copy(bytes.begin(), bytes.end(), out_.begin() + static_cast<long>(pos));
+    }
+
+    Entry Shorts(uint16_t tag, const std::vector<uint16_t>& values) const {
+        Entry entry;
+        entry.tag = tag;
+        entry.type = 3;
+        entry.count = static_cast<uint32_t>(values.size());
+        for (uint16_t v : values) {
+            Encode(&entry.data, v, 2);
+        }
+        return entry;
+    }
+
+    Entry Longs(uint16_t tag, const std::vector<uint32_t>& values) const {
+        Entry entry;
+        entry.tag = tag;
+        entry.type = 4;
+        entry.count = static_cast<uint32_t>(values.size());
+        for (uint32_t v : values) {
+            Encode(&entry.data, v, 4);
+        }
+        return entry;
+    }
+
+    Entry Doubles(uint16_t tag, const std::vector<double>& values) const {
+        Entry entry;
+        entry.tag = tag;
+        entry.type = 12;
+        entry.count = static_cast<uint32_t>(values.size());
+        for (double v : values) {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            Encode(&entry.data, bits, 8);
+        }
+        return entry;
+    }
+
+    // Copies the block's samples in file byte order, zero padding tiles
+    // that extend past the image.
+    std::vector<uint8_t> ExtractBlock(const Image& image, int x0, int y0, int w, int h) const {
+        size_t sample = static_cast<size_t>(image.bits / 8);
+        std::vector<uint8_t> block(static_cast<size_t>(w) * h * image.bands * sample, 0);
+        for (int y = 0; y < h && y0 + y < image.height; ++y) {
+            for (int x = 0; x < w && x0 + x < image.width; ++x) {
+                for (int b = 0; b < image.bands; ++b) {
+                    const uint8_t* src = &image.pixels[((static_cast<size_t>(y0 + y) * image.width +
+                                                         x0 + x) * image.bands + b) * sample];
+                    uint8_t* dst = &block[((static_cast<size_t>(y) * w + x) * image.bands + b) *
+                                          sample];
+                    for (size_t k = 0; k < sample; ++k) {
+                        dst[k] = big_endian_ ? src[sample - 1 - k] : src[k];
+                    }
+                }
+            }
+        }
+        if (image.predictor) {
+            // Horizontal differencing on 16 bit little-endian samples.
+            for (int y = 0; y < h; ++y) {
+                uint16_t* row = reinterpret_cast<uint16_t*>(&block[static_cast<size_t>(y) * w *
+                                                                   image.bands * 2]);
+                for (int i = w * image.bands - 1; i >= image.bands; --i) {
+                    row[i] = static_cast<uint16_t>(row[i] - row[i - image.bands]);
+                }
+            }
+        }
+        return block;
+    }
+
+    void WriteBlocks(const Image& image, std::vector<uint32_t>* offsets,
+                     std::vector<uint32_t>* counts) {
+        bool tiled = image.block_width > 0;
+        int bw = tiled ? image.block_width : image.width;
+        int bh = image.block_height;
+        for (int y0 = 0; y0 < image.height; y0 += bh) {
+            for (int x0 = 0; x0 < image.width; x0 += bw) {
+                int rows = tiled ? bh : std::min(bh, image.height - y0);
+                std::vector<uint8_t> block = ExtractBlock(image, x0, y0, bw, rows);
+#ifdef OGC_LAYER_HAVE_ZLIB
+                if (image.deflate) {
+                    uLongf size = compressBound(static_cast<uLong>(block.size()));
+                    std::vector<uint8_t> packed(size);
+                    compress(packed.data(), &size, block.data(), static_cast<uLong>(block.size()));
+                    packed.resize(size);
+                    block.swap(packed);
+                }
+#endif
+                offsets->push_back(static_cast<uint32_t>(out_.size()));
+                counts->push_back(static_cast<uint32_t>(block.size()));
+                out_.insert(out_.end(), block.begin(), block.end());
+            }
+        }
+    }
+
+    bool big_endian_;
+    std::vector<Image> images_;
+    std::vector<double> scale_;
+    std::vector<double> tiepoint_;
+    std::string nodata_;
+    std::vector<uint8_t> out_;
+};
+
+uint16_t Ramp(int x, int y, int band) {
+    return static_cast<uint16_t>(x + y * 300 + band * 7);
+}
+
+uint8_t Constant1(int, int, int) { return 1; }
+uint8_t Constant2(int, int, int) { return 2; }
+uint8_t Constant3(int, int, int) { return 3; }
+
+float Gradient(int x, int, int) {
+    return static_cast<float>(x * 10);
+}
+
+float Checker(int x, int y, int) {
+    return static_cast<float>((x / 2 + y / 2) % 2 == 0 ? 4 : 8);
+}
+
+} // namespace
+
+class CNTiledRasterLayerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = "./test_tiled_raster.tif";
+        std::remove(path_.c_str());
+    }
+
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+
+    std::unique_ptr<CNTiledRasterLayer> WriteAndOpen(TiffBuilder& builder) {
+        EXPECT_TRUE(builder.Write(path_));
+        return CNTiledRasterLayer::Open(path_, cache_);
+    }
+
+    std::string path_;
+    std::shared_ptr<CNRasterBlockCache> cache_ = std::make_shared<CNRasterBlockCache>();
+};
+
+TEST_F(CNTiledRasterLayerTest, ReadsTiledWindowAtFullResolution) {
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<uint16_t>(300, 200, 1, 1, 64, 64, Ramp));
+    builder.SetPixelScale(2.0, 3.0);
+    builder.SetTiepoint(1000.0, 5000.0);
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+
+    EXPECT_EQ(layer->GetName(), "test_tiled_raster");
+    EXPECT_EQ(layer->GetLayerType(), CNLayerType::kRaster);
+    EXPECT_EQ(layer->GetWidth(), 300);
+    EXPECT_EQ(layer->GetHeight(), 200);
+    EXPECT_EQ(layer->GetBandCount(), 1);
+    EXPECT_EQ(layer->GetDataType(), CNDataType::kUInt16);
+    EXPECT_EQ(layer->GetOverviewCount(), 0);
+    int bw = 0;
+    int bh = 0;
+    layer->GetBlockSize(&bw, &bh);
+    EXPECT_EQ(bw, 64);
+    EXPECT_EQ(bh, 64);
+
+    double gt[6];
+    layer->GetGeoTransform(gt);
+    EXPECT_DOUBLE_EQ(gt[0], 1000.0);
+    EXPECT_DOUBLE_EQ(gt[1], 2.0);
+    EXPECT_DOUBLE_EQ(gt[3], 5000.0);
+    EXPECT_DOUBLE_EQ(gt[5], -3.0);
+    Envelope extent;
+    EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+    EXPECT_DOUBLE_EQ(extent.GetMinX(), 1000.0);
+    EXPECT_DOUBLE_EQ(extent.GetMaxX(), 1600.0);
+    EXPECT_DOUBLE_EQ(extent.GetMinY(), 4400.0);
+    EXPECT_DOUBLE_EQ(extent.GetMaxY(), 5000.0);
+
+    // The window crosses tile boundaries in both directions.
+    std::vector<uint16_t> buffer(50 * 40);
+    ASSERT_EQ(layer->ReadRaster(40, 50, 50, 40, 1, CNDataType::kUInt16, buffer.data()),
+              CNStatus::kSuccess);
+    for (int y = 0; y < 40; ++y) {
+        for (int x = 0; x < 50; ++x) {
+            ASSERT_EQ(buffer[static_cast<size_t>(y) * 50 + x], Ramp(40 + x, 50 + y, 0));
+        }
+    }
+    EXPECT_EQ(cache_->GetBlockCount(), 4u);
+}
+
+TEST_F(CNTiledRasterLayerTest, ReadsBigEndianStripsAndBandLists) {
+    TiffBuilder builder(true);
+    builder.AddImage(TiffBuilder::MakeImage<uint16_t>(37, 23, 3, 1, 0, 5, Ramp));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetBandCount(), 3);
+
+    int bands[2] = {2, 0};
+    std::vector<float> buffer(2 * 37 * 23);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 37, 23, buffer.data(), 37, 23, CNDataType::kFloat32,
+                                bands, 2),
+              CNStatus::kSuccess);
+    for (int y = 0; y < 23; ++y) {
+        for (int x = 0; x < 37; ++x) {
+            ASSERT_FLOAT_EQ(buffer[static_cast<size_t>(y) * 37 + x], Ramp(x, y, 2));
+            ASSERT_FLOAT_EQ(buffer[37 * 23 + static_cast<size_t>(y) * 37 + x], Ramp(x, y, 0));
+        }
+    }
+
+    CNRasterBand* band = layer->GetBand(1);
+    ASSERT_NE(band, nullptr);
+    EXPECT_EQ(layer->GetBand(3), nullptr);
+    std::vector<uint16_t> row(37);
+    ASSERT_EQ(band->ReadRaster(0, 22, 37, 1, row.data(), CNDataType::kUInt16), CNStatus::kSuccess);
+    EXPECT_EQ(row[36], Ramp(36, 22, 1));
+    EXPECT_EQ(band->GetDescription(), "Band 2");
+    EXPECT_DOUBLE_EQ(band->GetMinimum(), Ramp(0, 0, 1));
+    EXPECT_DOUBLE_EQ(band->GetMaximum(), Ramp(36, 22, 1));
+}
+
+TEST_F(CNTiledRasterLayerTest, PicksCoarsestSufficientOverview) {
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<uint8_t>(256, 256, 1, 1, 32, 32, Constant1));
+    builder.AddImage(TiffBuilder::MakeImage<uint8_t>(64, 64, 1, 1, 32, 32, Constant3));
+    builder.AddImage(TiffBuilder::MakeImage<uint8_t>(128, 128, 1, 1, 32, 32, Constant2));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+
+    ASSERT_EQ(layer->GetOverviewCount(), 2);
+    int w = 0;
+    int h = 0;
+    ASSERT_TRUE(layer->GetOverviewSize(0, &w, &h));
+    EXPECT_EQ(w, 128);
+    ASSERT_TRUE(layer->GetOverviewSize(1, &w, &h));
+    EXPECT_EQ(w, 64);
+    EXPECT_FALSE(layer->GetOverviewSize(2, &w, &h));
+
+    EXPECT_EQ(layer->SelectLevel(256, 256, 256, 256), 0);
+    EXPECT_EQ(layer->SelectLevel(256, 256, 200, 200), 0);
+    EXPECT_EQ(layer->SelectLevel(256, 256, 128, 128), 1);
+    EXPECT_EQ(layer->SelectLevel(256, 256, 100, 100), 1);
+    EXPECT_EQ(layer->SelectLevel(256, 256, 64, 64), 2);
+    EXPECT_EQ(layer->SelectLevel(256, 256, 16, 16), 2);
+    EXPECT_EQ(layer->SelectLevel(256, 32, 16, 16), 1);
+
+    std::vector<uint8_t> tile(16 * 16);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 256, 256, tile.data(), 16, 16, CNDataType::kByte),
+              CNStatus::kSuccess);
+    EXPECT_EQ(tile[0], 3);
+    EXPECT_EQ(tile[255], 3);
+    // A zoomed-out read decodes the few blocks of the 64x64 overview only.
+    EXPECT_EQ(cache_->GetBlockCount(), 4u);
+    EXPECT_EQ(cache_->GetSize(), 4u * 32 * 32);
+
+    ASSERT_EQ(layer->ReadWindow(128, 128, 128, 128, tile.data(), 16, 16, CNDataType::kByte,
+                                nullptr, 0, CNResampleMethod::kBilinear),
+              CNStatus::kSuccess);
+    EXPECT_EQ(tile[17], 3);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 16, 16, tile.data(), 16, 16, CNDataType::kByte),
+              CNStatus::kSuccess);
+    EXPECT_EQ(tile[17], 1);
+}
+
+TEST_F(CNTiledRasterLayerTest, NearestAndBilinearResampling) {
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<float>(40, 8, 1, 3, 16, 16, Gradient));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetDataType(), CNDataType::kFloat32);
+
+    // 2x downsampling without overviews takes the pixel under each centre.
+    std::vector<float> down(20);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 40, 1, down.data(), 20, 1, CNDataType::kFloat32),
+              CNStatus::kSuccess);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_FLOAT_EQ(down[static_cast<size_t>(i)], Gradient(2 * i + 1, 0, 0));
+    }
+
+    // 2x upsampling: nearest repeats pixels, bilinear interpolates between
+    // pixel centres and clamps at the edges. 17 outputs cover the SIMD
+    // blocks and the scalar tail.
+    std::vector<float> nearest(34);
+    std::vector<float> bilinear(34);
+    ASSERT_EQ(layer->ReadWindow(3, 2, 17, 1, nearest.data(), 34, 1, CNDataType::kFloat32),
+              CNStatus::kSuccess);
+    ASSERT_EQ(layer->ReadWindow(3, 2, 17, 1, bilinear.data(), 34, 1, CNDataType::kFloat32,
+                                nullptr, 0, CNResampleMethod::kBilinear),
+              CNStatus::kSuccess);
+    for (int i = 0; i < 34; ++i) {
+        EXPECT_FLOAT_EQ(nearest[static_cast<size_t>(i)], Gradient(3 + i / 2, 0, 0));
+        double centre = 3 + (i + 0.5) * 0.5 - 0.5;
+        EXPECT_NEAR(bilinear[static_cast<size_t>(i)], centre * 10.0, 1e-4) << i;
+    }
+
+    std::vector<uint8_t> edge(4);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 2, 2, edge.data(), 4, 1, CNDataType::kByte,
+                                nullptr, 0, CNResampleMethod::kBilinear),
+              CNStatus::kSuccess);
+    EXPECT_EQ(edge[0], 0);
+    EXPECT_EQ(edge[1], 3);
+    EXPECT_EQ(edge[2], 8);
+    EXPECT_EQ(edge[3], 13);
+}
+
+TEST_F(CNTiledRasterLayerTest, BilinearFallsBackToNearestAroundNoData) {
+    TiffBuilder builder;
+    TiffBuilder::Image image = TiffBuilder::MakeImage<float>(4, 1, 1, 3, 16, 16, Gradient);
+    float nodata = -9999.0f;
+    std::memcpy(&image.pixels[2 * sizeof(float)], &nodata, sizeof(float));
+    builder.AddImage(image);
+    builder.SetNoData("-9999");
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+    EXPECT_TRUE(layer->HasNoDataValue());
+    EXPECT_DOUBLE_EQ(layer->GetNoDataValue(), -9999.0);
+    double value = 0.0;
+    EXPECT_EQ(layer->GetBand(0)->GetNoDataValue(value), 1);
+
+    std::vector<float> out(8);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 4, 1, out.data(), 8, 1, CNDataType::kFloat32,
+                                nullptr, 0, CNResampleMethod::kBilinear),
+              CNStatus::kSuccess);
+    EXPECT_FLOAT_EQ(out[1], 2.5f);
+    EXPECT_FLOAT_EQ(out[2], 7.5f);
+    EXPECT_FLOAT_EQ(out[3], 10.0f);
+    EXPECT_FLOAT_EQ(out[4], -9999.0f);
+    EXPECT_FLOAT_EQ(out[5], -9999.0f);
+    EXPECT_FLOAT_EQ(out[6], 30.0f);
+    EXPECT_DOUBLE_EQ(layer->GetBand(0)->GetMaximum(), 30.0);
+}
+
+TEST_F(CNTiledRasterLayerTest, BuildsOverviewsInMemory) {
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<float>(100, 90, 1, 3, 0, 16, Checker));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+    ASSERT_EQ(layer->GetOverviewCount(), 0);
+
+    EXPECT_EQ(layer->BuildOverviews(0), CNStatus::kInvalidParameter);
+    ASSERT_EQ(layer->BuildOverviews(30), CNStatus::kSuccess);
+    ASSERT_EQ(layer->GetOverviewCount(), 2);
+    int w = 0;
+    int h = 0;
+    layer->GetOverviewSize(1, &w, &h);
+    EXPECT_EQ(w, 25);
+    EXPECT_EQ(h, 23);
+
+    // Each 2x2 checker cell averages to itself, each 4x4 to the mean.
+    std::vector<float> half(50);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 100, 2, half.data(), 50, 1, CNDataType::kFloat32),
+              CNStatus::kSuccess);
+    EXPECT_FLOAT_EQ(half[0], 4.0f);
+    EXPECT_FLOAT_EQ(half[1], 8.0f);
+    std::vector<float> quarter(25);
+    ASSERT_EQ(layer->ReadWindow(0, 0, 100, 4, quarter.data(), 25, 1, CNDataType::kFloat32),
+              CNStatus::kSuccess);
+    EXPECT_FLOAT_EQ(quarter[0], 6.0f);
+    EXPECT_FLOAT_EQ(quarter[24], 6.0f);
+}
+
+TEST_F(CNTiledRasterLayerTest, RejectsInvalidRequests) {
+    EXPECT_EQ(CNTiledRasterLayer::Open("./missing_raster.tif"), nullptr);
+    {
+        std::ofstream file(path_, std::ios::binary);
+        file << "not a tiff at all";
+    }
+    EXPECT_EQ(CNTiledRasterLayer::Open(path_), nullptr);
+
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<uint8_t>(16, 16, 1, 1, 16, 16, Constant1));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+
+    std::vector<uint8_t> buffer(256);
+    EXPECT_EQ(layer->ReadRaster(0, 0, 16, 16, 1, CNDataType::kByte, nullptr),
+              CNStatus::kNullPointer);
+    EXPECT_EQ(layer->ReadRaster(8, 8, 16, 16, 1, CNDataType::kByte, buffer.data()),
+              CNStatus::kOutOfRange);
+    EXPECT_EQ(layer->ReadRaster(0, 0, 0, 16, 1, CNDataType::kByte, buffer.data()),
+              CNStatus::kInvalidParameter);
+    EXPECT_EQ(layer->ReadRaster(0, 0, 16, 16, 2, CNDataType::kByte, buffer.data()),
+              CNStatus::kOutOfRange);
+    EXPECT_EQ(layer->ReadRaster(0, 0, 16, 16, 1, CNDataType::kComplexFloat32, buffer.data()),
+              CNStatus::kNotSupported);
+    EXPECT_EQ(layer->WriteRaster(0, 0, 16, 16, 1, CNDataType::kByte, buffer.data()),
+              CNStatus::kNotSupported);
+    EXPECT_EQ(layer->GetFeatureCount(), 0);
+    EXPECT_EQ(layer->GetNextFeature(), nullptr);
+    EXPECT_TRUE(layer->TestCapability(CNLayerCapability::kRandomRead));
+    EXPECT_FALSE(layer->TestCapability(CNLayerCapability::kCreateFeature));
+
+    auto clone = layer->Clone();
+    ASSERT_NE(clone, nullptr);
+    EXPECT_EQ(clone->GetName(), layer->GetName());
+}
+
+TEST_F(CNTiledRasterLayerTest, ConcurrentReadersShareTheBlockCache) {
+    TiffBuilder builder;
+    builder.AddImage(TiffBuilder::MakeImage<uint16_t>(256, 128, 1, 1, 32, 32, Ramp));
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&layer, &mismatches, t] {
+            std::vector<uint16_t> buffer(256 * 128);
+            for (int pass = 0; pass < 5; ++pass) {
+                if (layer->ReadWindow(0, 0, 256, 128, buffer.data(), 256, 128,
+                                      CNDataType::kUInt16) != CNStatus::kSuccess) {
+                    ++mismatches[static_cast<size_t>(t)];
+                    continue;
+                }
+                for (int y = 0; y < 128; ++y) {
+                    for (int x = 0; x < 256; ++x) {
+                        if (buffer[static_cast<size_t>(y) * 256 + x] != Ramp(x, y, 0)) {
+                            ++mismatches[static_cast<size_t>(t)];
+                        }
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int count : mismatches) {
+        EXPECT_EQ(count, 0);
+    }
+    EXPECT_EQ(cache_->GetBlockCount(), 32u);
+    EXPECT_GT(cache_->GetHitCount(), cache_->GetMissCount());
+
+    layer.reset();
+    EXPECT_EQ(cache_->GetBlockCount(), 0u);
+}
+
+#ifdef OGC_LAYER_HAVE_ZLIB
+TEST_F(CNTiledRasterLayerTest, ReadsDeflateWithPredictor) {
+    TiffBuilder builder;
+    TiffBuilder::Image image = TiffBuilder::MakeImage<uint16_t>(70, 50, 2, 1, 32, 16, Ramp);
+    image.deflate = true;
+    image.predictor = true;
+    builder.AddImage(image);
+    auto layer = WriteAndOpen(builder);
+    ASSERT_NE(layer, nullptr);
+
+    std::vector<uint16_t> buffer(2 * 70 * 50);
+    ASSERT_EQ(layer->ReadRaster(0, 0, 70, 50, 2, CNDataType::kUInt16, buffer.data()),
+              CNStatus::kSuccess);
+    for (int b = 0; b < 2; ++b) {
+        for (int y = 0; y < 50; ++y) {
+            for (int x = 0; x < 70; ++x) {
+                ASSERT_EQ(buffer[(static_cast<size_t>(b) * 50 + y) * 70 + x], Ramp(x, y, b));
+            }
+        }
+    }
+}
+#endif
+
+TEST(CNRasterBlockCacheTest, EvictsLeastRecentlyUsedBlocks) {
+    CNRasterBlockCache cache(250);
+    auto make_block = [] {
+        return std::make_shared<const std::vector<uint8_t>>(100, 0);
+    };
+    CNRasterBlockCache::Key a = {1, 0, 0, 0};
+    CNRasterBlockCache::Key b = {1, 0, 0, 1};
+    CNRasterBlockCache::Key c = {1, 1, 0, 0};
+    cache.Insert(a, make_block());
+    cache.Insert(b, make_block());
+    EXPECT_NE(cache.Find(a), nullptr);
+    cache.Insert(c, make_block());
+
+    EXPECT_EQ(cache.GetBlockCount(), 2u);
+    EXPECT_EQ(cache.GetSize(), 200u);
+    EXPECT_NE(cache.Find(a), nullptr);
+    EXPECT_EQ(cache.Find(b), nullptr);
+    EXPECT_NE(cache.Find(c), nullptr);
+    EXPECT_EQ(cache.GetHitCount(), 3u);
+    EXPECT_EQ(cache.GetMissCount(), 1u);
+
+    cache.Insert(CNRasterBlockCache::Key{2, 0, 0, 0}, std::make_shared<const std::vector<uint8_t>>(300, 0));
+    EXPECT_EQ(cache.GetBlockCount(), 2u);
+
+    cache.SetCapacity(100);
+    EXPECT_EQ(cache.GetBlockCount(), 1u);
+    EXPECT_NE(cache.Find(c), nullptr);
+
+    cache.Erase(1);
+    EXPECT_EQ(cache.GetBlockCount(), 0u);
+    EXPECT_EQ(cache.GetSize(), 0u);
+    EXPECT_NE(CNRasterBlockCache::NewOwnerId(), CNRasterBlockCache::NewOwnerId());
+    EXPECT_EQ(CNRasterBlockCache::GetDefault(), CNRasterBlockCache::GetDefault());
+}
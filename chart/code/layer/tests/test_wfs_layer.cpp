@@ -0,0 +1,606 @@
+#include "gtest/gtest.h"
+#include "ogc/layer/wfs_layer.h"
+#include "ogc/feature/feature.h"
+#include "ogc/feature/feature_defn.h"
+#include "ogc/feature/field_defn.h"
+#include "ogc/geom/envelope.h"
+#include "ogc/geom/geometry.h"
+#include "ogc/geom/point.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace ogc;
+
+#ifndef _WIN32
+
+namespace {
+
+typedef std::map<std::string, std::string> Query;
+
+std::string Decode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size()) {
+            out.push_back(static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16)));
+            i += 2;
+        } else if (text[i] == '+') {
+            out.push_back(' ');
+        } else {
+            out.push_back(text[i]);
+        }
+    }
+    return out;
+}
+
+Query ParseQuery(const std::string& target) {
+    Query query;
+    size_t question = target.find('?');
+    if (question == std::string::npos) {
+        return query;
+    }
+    std::stringstream in(target.substr(question + 1));
+    std::string pair;
+    while (std::getline(in, pair, '&')) {
+        size_t equals = pair.find('=');
+        if (equals != std::string::npos) {
+            query[Decode(pair.substr(0, equals))] = Decode(pair.substr(equals + 1));
+        }
+    }
+    return query;
+}
+
+/**
+ * Loopback stand-in for a WFS server. Serves a 10 x 10 grid of points at
+ * (i + 0.5, j + 0.5) with ids "pts.N", honouring bbox, startIndex and
+ * count (or maxFeatures), as GeoJSON or, when asked for GML, as a GML 3.2
+ * collection. Pages report numberMatched unless told otherwise.
+ */
+class StandInWfsServer {
+public:
+    StandInWfsServer() {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(listen_fd_, 16);
+        socklen_t length = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread(&StandInWfsServer::Run, this);
+    }
+
+    ~StandInWfsServer() {
+        stop_ = true;
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    std::string Url() const {
+        return "http://127.0.0.1:" + std::to_string(port_) + "/wfs";
+    }
+
+    void SetRevision(const std::string& revision) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        revision_ = revision;
+    }
+
+    void SetFailFeatures(bool fail) { fail_features_ = fail; }
+
+    void SetFailBBox(const std::string& bbox) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fail_bbox_ = bbox;
+    }
+    void SetAlwaysGml(bool gml) { always_gml_ = gml; }
+    void SetIgnoreStartIndex(bool ignore) { ignore_start_index_ = ignore; }
+    void SetPageCap(size_t cap) { page_cap_ = cap; }
+    void SetReportMatched(bool report) { report_matched_ = report; }
+
+    std::vector<Query> GetFeatureRequests() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return feature_requests_;
+    }
+
+    void ClearLog() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        feature_requests_.clear();
+    }
+
+private:
+    void Run() {
+        while (!stop_) {
+            pollfd fd;
+            fd.fd = listen_fd_;
+            fd.events = POLLIN;
+            if (poll(&fd, 1, 20) <= 0) {
+                continue;
+            }
+            int client = accept(listen_fd_, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            std::string request;
+            char buffer[4096];
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+                if (n <= 0) {
+                    break;
+                }
+                request.append(buffer, static_cast<size_t>(n));
+            }
+            size_t begin = request.find(' ') + 1;
+            std::string target = request.substr(begin, request.find(' ', begin) - begin);
+            std::string response = Handle(ParseQuery(target));
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(client, response.data() + sent, response.size() - sent, 0);
+                if (n <= 0) {
+                    break;
+                }
+                sent += static_cast<size_t>(n);
+            }
+            close(client);
+        }
+    }
+
+    static std::string Reply(int status, const std::string& type, const std::string& body,
+                             bool chunked) {
+        std::string head = "HTTP/1.1 " + std::to_string(status) +
+                           (status == 200 ? " OK" : " Error") + "\r\nContent-Type: " + type +
+                           "\r\nConnection: close\r\n";
+        if (!chunked) {
+            return head + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        std::string out = head + "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t pos = 0; pos < body.size(); pos += 100) {
+            std::string chunk = body.substr(pos, 100);
+            std::ostringstream size;
+            size << std::hex << chunk.size();
+            out += size.str() + "\r\n" + chunk + "\r\n";
+        }
+        return out + "0\r\n\r\n";
+    }
+
+    std::string Handle(const Query& query) {
+        auto get = [&](const char* key) {
+            auto it = query.find(key);
+            return it == query.end() ? std::string() : it->second;
+        };
+        if (get("request") == "GetCapabilities") {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return Reply(200, "text/xml",
+                         "<?xml version=\"1.0\"?>\n"
+                         "<wfs:WFS_Capabilities xmlns:wfs=\"http://www.opengis.net/wfs/2.0\" "
+                         "xmlns:ows=\"http://www.opengis.net/ows/1.1\" version=\"2.0.2\" "
+                         "updateSequence=\"" + revision_ + "\">\n"
+                         "<wfs:FeatureTypeList><wfs:FeatureType>"
+                         "<wfs:Name>test:pts</wfs:Name><wfs:Title>Points</wfs:Title>"
+                         "<ows:WGS84BoundingBox><ows:LowerCorner>0 0</ows:LowerCorner>"
+                         "<ows:UpperCorner>10 10</ows:UpperCorner></ows:WGS84BoundingBox>"
+                         "</wfs:FeatureType></wfs:FeatureTypeList>\n"
+                         "</wfs:WFS_Capabilities>\n",
+                         false);
+        }
+        bool fail_bbox = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            feature_requests_.push_back(query);
+            fail_bbox = !fail_bbox_.empty() && get("bbox") == fail_bbox_;
+        }
+        if (fail_features_ || fail_bbox) {
+            return Reply(500, "text/plain", "unavailable", false);
+        }
+        double box[4] = {-1e300, -1e300, 1e300, 1e300};
+        std::string bbox = get("bbox");
+        if (!bbox.empty()) {
+            std::sscanf(bbox.c_str(), "%lf,%lf,%lf,%lf", &box[0], &box[1], &box[2], &box[3]);
+        }
+        std::vector<int> ids;
+        for (int j = 0; j < 10; ++j) {
+            for (int i = 0; i < 10; ++i) {
+                double x = i + 0.5;
+                double y = j + 0.5;
+                if (x >= box[0] && x <= box[2] && y >= box[1] && y <= box[3]) {
+                    ids.push_back(j * 10 + i);
+                }
+            }
+        }
+        size_t start = ignore_start_index_ ? 0 : static_cast<size_t>(std::atoi(get("startIndex").c_str()));
+        std::string count_text = get("count").empty() ? get("maxFeatures") : get("count");
+        size_t count = count_text.empty() ? ids.size() : static_cast<size_t>(std::atoi(count_text.c_str()));
+        if (page_cap_ > 0) {
+            count = std::min(count, static_cast<size_t>(page_cap_));
+        }
+        std::vector<int> page;
+        for (size_t k = start; k < ids.size() && page.size() < count; ++k) {
+            page.push_back(ids[k]);
+        }
+
+        if (always_gml_ || get("outputFormat").find("gml") != std::string::npos) {
+            std::string body =
+                "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<wfs:FeatureCollection xmlns:wfs=\"http://www.opengis.net/wfs/2.0\" "
+                "xmlns:gml=\"http://www.opengis.net/gml/3.2\" xmlns:test=\"urn:test\" "
+                "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"" +
+                (report_matched_ ? " numberMatched=\"" + std::to_string(ids.size()) + "\"" : "") +
+                " numberReturned=\"" + std::to_string(page.size()) + "\"" +
+                (start + page.size() < ids.size() ? " next=\"more\"" : "") + ">\n";
+            for (int id : page) {
+                double x = id % 10 + 0.5;
+                double y = id / 10 + 0.5;
+                body += "<wfs:member><test:pts gml:id=\"pts." + std::to_string(id) + "\">"
+                        "<gml:boundedBy><gml:Envelope><gml:lowerCorner>0 0</gml:lowerCorner>"
+                        "</gml:Envelope></gml:boundedBy>"
+                        "<test:name>P&amp;" + std::to_string(id) + "</test:name>"
+                        "<test:rank>" + std::to_string(id * 2) + "</test:rank>" +
+                        (id == 0 ? std::string("<test:score xsi:nil=\"true\"/>")
+                                 : "<test:score>" + std::to_string(id) + ".25</test:score>") +
+                        "<test:geom><gml:Point srsDimension=\"2\"><gml:pos>" +
+                        std::to_string(x) + " " + std::to_string(y) +
+                        "</gml:pos></gml:Point></test:geom></test:pts></wfs:member>\n";
+            }
+            body += "</wfs:FeatureCollection>\n";
+            return Reply(200, "application/gml+xml; version=3.2", body, true);
+        }
+
+        std::string body = "{\"type\":\"FeatureCollection\",\"features\":[";
+        for (size_t k = 0; k < page.size(); ++k) {
+            int id = page[k];
+            body += std::string(k ? "," : "") + "{\"type\":\"Feature\",\"id\":\"pts." +
+                    std::to_string(id) + "\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[" +
+                    std::to_string(id % 10 + 0.5) + "," + std::to_string(id / 10 + 0.5) +
+                    "]},\"properties\":{\"name\":\"P" + std::to_string(id) +
+                    "\",\"rank\":" + std::to_string(id * 2) + "}}";
+        }
+        body += "]";
+        if (report_matched_) {
+            body += ",\"numberMatched\":" + std::to_string(ids.size());
+        }
+        body += ",\"numberReturned\":" + std::to_string(page.size()) + "}";
+        return Reply(200, "application/json", body, false);
+    }
+
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> fail_features_{false};
+    std::atomic<bool> always_gml_{false};
+    std::atomic<bool> ignore_start_index_{false};
+    std::atomic<size_t> page_cap_{0};
+    std::atomic<bool> report_matched_{true};
+    mutable std::mutex mutex_;
+    std::string revision_ = "1";
+    std::string fail_bbox_;
+    std::vector<Query> feature_requests_;
+};
+
+std::vector<int64_t> ReadFids(CNWFSLayer* layer) {
+    std::vector<int64_t> fids;
+    layer->ResetReading();
+    while (CNFeature* feature = layer->GetNextFeatureRef()) {
+        fids.push_back(feature->GetFID());
+    }
+    return fids;
+}
+
+std::set<std::string> RequestedBoxes(const std::vector<Query>& requests) {
+    std::set<std::string> boxes;
+    for (const Query& query : requests) {
+        auto it = query.find("bbox");
+        if (it != query.end()) {
+            boxes.insert(it->second);
+        }
+    }
+    return boxes;
+}
+
+} // namespace
+
+class CNWFSLayerPagingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        params_.url = server_.Url();
+        params_.max_features = 3;
+        params_.cell_size = 2.5;
+        params_.timeout_ms = 5000;
+    }
+
+    StandInWfsServer server_;
+    CNWFSConnectionParams params_;
+};
+
+TEST_F(CNWFSLayerPagingTest, ConnectReadsCapabilitiesAndSchema) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetServerRevision(), "1");
+    EXPECT_DOUBLE_EQ(layer->GetCellSize(), 2.5);
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPoint);
+
+    Envelope extent;
+    EXPECT_EQ(layer->GetExtent(extent), CNStatus::kSuccess);
+    EXPECT_DOUBLE_EQ(extent.GetMaxX(), 10.0);
+
+    const CNFeatureDefn* defn = layer->GetFeatureDefn();
+    ASSERT_NE(defn, nullptr);
+    EXPECT_GE(defn->GetFieldIndex("name"), 0);
+    EXPECT_GE(defn->GetFieldIndex("rank"), 0);
+    EXPECT_TRUE(layer->TestCapability(CNLayerCapability::kFastSpatialFilter));
+}
+
+TEST_F(CNWFSLayerPagingTest, ConnectFailsForUnknownTypeOrServer) {
+    EXPECT_EQ(CNWFSLayer::Connect(params_, "missing"), nullptr);
+
+    CNWFSConnectionParams unreachable = params_;
+    unreachable.url = "http://127.0.0.1:1/wfs";
+    unreachable.timeout_ms = 500;
+    EXPECT_EQ(CNWFSLayer::Connect(unreachable, "pts"), nullptr);
+}
+
+TEST_F(CNWFSLayerPagingTest, PagesThroughCellWithStartIndex) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.ClearLog();
+
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    std::vector<int64_t> fids = ReadFids(layer.get());
+    EXPECT_EQ(fids, (std::vector<int64_t>{0, 1, 10, 11}));
+
+    // The cell (0, 0, 2.5, 2.5) holds 9 points, fetched 3 at a time; the
+    // third page reaches numberMatched.
+    std::vector<Query> requests = server_.GetFeatureRequests();
+    ASSERT_EQ(requests.size(), 3u);
+    std::set<std::string> starts;
+    for (const Query& query : requests) {
+        EXPECT_EQ(query.at("count"), "3");
+        EXPECT_EQ(query.at("typeNames"), "pts");
+        EXPECT_EQ(query.at("bbox"), "0,0,2.5,2.5,urn:ogc:def:crs:OGC:1.3:CRS84");
+        starts.insert(query.at("startIndex"));
+    }
+    EXPECT_EQ(starts, (std::set<std::string>{"0", "3", "6"}));
+
+    CNWFSCacheStats stats = layer->GetCacheStats();
+    EXPECT_EQ(stats.cells_fetched, 1);
+    EXPECT_EQ(stats.cached_features, 9);
+}
+
+TEST_F(CNWFSLayerPagingTest, CappedPagesStillReadTheWholeCell) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.SetPageCap(2);
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_EQ(ReadFids(layer.get()), (std::vector<int64_t>{0, 1, 10, 11}));
+    EXPECT_EQ(layer->GetCacheStats().cached_features, 9);
+    // 2 + 2 + 2 + 2 + 1 of the 9 reported by numberMatched.
+    EXPECT_EQ(server_.GetFeatureRequests().size(), 5u);
+
+    // Without numberMatched the cell ends on an empty page.
+    server_.SetReportMatched(false);
+    layer->ClearCache();
+    server_.ClearLog();
+    EXPECT_EQ(ReadFids(layer.get()), (std::vector<int64_t>{0, 1, 10, 11}));
+    EXPECT_EQ(layer->GetCacheStats().cached_features, 9);
+    EXPECT_EQ(server_.GetFeatureRequests().size(), 6u);
+}
+
+TEST_F(CNWFSLayerPagingTest, Version1StopsWhenStartIndexIsIgnored) {
+    params_.version = "1.1.0";
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.SetIgnoreStartIndex(true);
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    // The repeated first page ends the cell instead of looping.
+    EXPECT_EQ(ReadFids(layer.get()), (std::vector<int64_t>{0, 1}));
+    EXPECT_EQ(server_.GetFeatureRequests().size(), 2u);
+    EXPECT_EQ(layer->GetCacheStats().cached_features, 3);
+}
+
+TEST_F(CNWFSLayerPagingTest, PanRequestsOnlyUncoveredCells) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_EQ(ReadFids(layer.get()).size(), 4u);
+    server_.ClearLog();
+
+    layer->SetSpatialFilterRect(0.1, 0.1, 4.9, 2.4);
+    std::vector<int64_t> fids = ReadFids(layer.get());
+    EXPECT_EQ(fids.size(), 10u);
+    EXPECT_EQ(RequestedBoxes(server_.GetFeatureRequests()),
+              (std::set<std::string>{"2.5,0,5,2.5,urn:ogc:def:crs:OGC:1.3:CRS84"}));
+
+    // Points on x = 2.5 come back from both cells but are stored once.
+    std::set<int64_t> unique(fids.begin(), fids.end());
+    EXPECT_EQ(unique.size(), fids.size());
+    EXPECT_EQ(layer->GetCacheStats().cached_features, 15);
+
+    // Panning back is served from the cache.
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_EQ(ReadFids(layer.get()).size(), 4u);
+    EXPECT_TRUE(server_.GetFeatureRequests().empty());
+    EXPECT_GT(layer->GetCacheStats().cell_hits, 0);
+}
+
+TEST_F(CNWFSLayerPagingTest, PrefetchFillsCacheInBackground) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    EXPECT_EQ(layer->GetFeatureCount(false), -1);
+
+    layer->Prefetch(5.1, 5.1, 9.9, 9.9);
+    EXPECT_TRUE(layer->WaitForFetches(5000));
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(5.1, 5.1, 9.9, 9.9);
+    EXPECT_EQ(layer->GetFeatureCount(false), 25);
+    EXPECT_TRUE(server_.GetFeatureRequests().empty());
+    EXPECT_EQ(layer->GetCacheStats().cached_cells, 4);
+}
+
+TEST_F(CNWFSLayerPagingTest, RefreshDropsCacheWhenRevisionChanges) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_EQ(ReadFids(layer.get()).size(), 4u);
+
+    EXPECT_EQ(layer->Refresh(), CNStatus::kSuccess);
+    EXPECT_EQ(layer->GetCacheStats().cached_cells, 1);
+
+    server_.SetRevision("2");
+    EXPECT_EQ(layer->Refresh(), CNStatus::kSuccess);
+    EXPECT_EQ(layer->GetServerRevision(), "2");
+    EXPECT_EQ(layer->GetCacheStats().cached_cells, 0);
+
+    server_.ClearLog();
+    EXPECT_EQ(ReadFids(layer.get()), (std::vector<int64_t>{0, 1, 10, 11}));
+    EXPECT_EQ(server_.GetFeatureRequests().size(), 3u);
+}
+
+TEST_F(CNWFSLayerPagingTest, FailedCellsAreRetried) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.SetFailFeatures(true);
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_TRUE(ReadFids(layer.get()).empty());
+    EXPECT_NE(layer->GetLastError().find("500"), std::string::npos);
+
+    server_.SetFailFeatures(false);
+    EXPECT_EQ(ReadFids(layer.get()).size(), 4u);
+}
+
+TEST_F(CNWFSLayerPagingTest, FailedCellFailsTheWholeRead) {
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.SetFailBBox("2.5,0,5,2.5,urn:ogc:def:crs:OGC:1.3:CRS84");
+    layer->SetSpatialFilterRect(0.1, 0.1, 4.9, 2.4);
+    EXPECT_TRUE(ReadFids(layer.get()).empty());
+    EXPECT_EQ(layer->GetFeatureCount(false), -1);
+    EXPECT_NE(layer->GetLastError().find("500"), std::string::npos);
+
+    server_.SetFailBBox("");
+    EXPECT_EQ(ReadFids(layer.get()).size(), 10u);
+    EXPECT_EQ(layer->GetFeatureCount(false), 10);
+}
+
+TEST_F(CNWFSLayerPagingTest, BBoxCrsFollowsVersionAndOverride) {
+    params_.version = "1.0.0";
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    ReadFids(layer.get());
+    EXPECT_EQ(RequestedBoxes(server_.GetFeatureRequests()),
+              (std::set<std::string>{"0,0,2.5,2.5"}));
+
+    server_.ClearLog();
+    layer->SetBBOXCRS("EPSG:4326");
+    ReadFids(layer.get());
+    EXPECT_EQ(RequestedBoxes(server_.GetFeatureRequests()),
+              (std::set<std::string>{"0,0,2.5,2.5,EPSG:4326"}));
+}
+
+TEST_F(CNWFSLayerPagingTest, PreloadAllAndRandomRead) {
+    params_.max_features = 40;
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.ClearLog();
+    EXPECT_EQ(layer->PreloadAll(), CNStatus::kSuccess);
+    EXPECT_EQ(server_.GetFeatureRequests().size(), 3u);
+    EXPECT_TRUE(RequestedBoxes(server_.GetFeatureRequests()).empty());
+    EXPECT_EQ(layer->GetFeatureCount(false), 100);
+
+    std::unique_ptr<CNFeature> feature = layer->GetFeature(42);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(feature->GetFieldAsString("name"), "P42");
+    EXPECT_EQ(layer->GetFeature(1000), nullptr);
+
+    // Covered by the whole-layer fetch, so filtering costs no requests.
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    EXPECT_EQ(ReadFids(layer.get()).size(), 4u);
+    EXPECT_TRUE(server_.GetFeatureRequests().empty());
+}
+
+TEST_F(CNWFSLayerPagingTest, WfsVersion1UsesMaxFeatures) {
+    params_.version = "1.1.0";
+    auto layer = CNWFSLayer::Connect(params_, "pts");
+    ASSERT_NE(layer, nullptr);
+    server_.ClearLog();
+    layer->SetSpatialFilterRect(0.1, 0.1, 2.4, 2.4);
+    ReadFids(layer.get());
+    std::vector<Query> requests = server_.GetFeatureRequests();
+    ASSERT_FALSE(requests.empty());
+    EXPECT_EQ(requests[0].count("typeName"), 1u);
+    EXPECT_EQ(requests[0].count("maxFeatures"), 1u);
+}
+
+class CNWFSGmlTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        server_.SetAlwaysGml(true);
+        params_.url = server_.Url();
+        params_.max_features = 50;
+        params_.cell_size = 5.0;
+    }
+
+    StandInWfsServer server_;
+    CNWFSConnectionParams params_;
+};
+
+TEST_F(CNWFSGmlTest, InfersSchemaFromGml) {
+    auto layer = CNWFSLayer::Connect(params_, "test:pts");
+    ASSERT_NE(layer, nullptr);
+    const CNFeatureDefn* defn = layer->GetFeatureDefn();
+    ASSERT_NE(defn, nullptr);
+    ASSERT_EQ(defn->GetFieldCount(), 3u);
+    EXPECT_EQ(defn->GetFieldDefn(0)->GetType(), CNFieldType::kString);
+    EXPECT_EQ(defn->GetFieldDefn(1)->GetType(), CNFieldType::kInteger);
+    EXPECT_EQ(defn->GetFieldDefn(2)->GetType(), CNFieldType::kReal);
+    EXPECT_EQ(layer->GetGeomType(), GeomType::kPoint);
+}
+
+TEST_F(CNWFSGmlTest, ReadsFeaturesFromChunkedGml) {
+    auto layer = CNWFSLayer::Connect(params_, "test:pts");
+    ASSERT_NE(layer, nullptr);
+    layer->SetSpatialFilterRect(0.1, 0.1, 1.9, 1.9);
+    layer->ResetReading();
+
+    std::vector<std::unique_ptr<CNFeature>> features;
+    while (std::unique_ptr<CNFeature> feature = layer->GetNextFeature()) {
+        features.push_back(std::move(feature));
+    }
+    ASSERT_EQ(features.size(), 4u);
+    EXPECT_EQ(features[0]->GetFID(), 0);
+    EXPECT_EQ(features[0]->GetFieldAsString("name"), "P&0");
+    EXPECT_TRUE(features[0]->IsFieldNull(2));
+    EXPECT_EQ(features[3]->GetFID(), 11);
+    EXPECT_EQ(features[3]->GetFieldAsInteger("rank"), 22);
+
+    const Point* point = dynamic_cast<const Point*>(features[3]->GetGeometryRef());
+    ASSERT_NE(point, nullptr);
+    EXPECT_DOUBLE_EQ(point->GetCoordinate().x, 1.5);
+    EXPECT_DOUBLE_EQ(point->GetCoordinate().y, 1.5);
+}
+
+#endif
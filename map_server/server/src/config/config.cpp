@@ -69,6 +69,7 @@ bool Config::LoadFromFile(const std::string& path) {
             auto dbJson = configJson["database"];
             if (dbJson.contains("type")) database.type = dbJson["type"];
             if (dbJson.contains("sqlite_path")) database.sqlite_path = dbJson["sqlite_path"];
+            if (dbJson.contains("sqlite_spatial_buffer")) database.sqlite_spatial_buffer = dbJson["sqlite_spatial_buffer"];
             if (dbJson.contains("pg_host")) database.pg_host = dbJson["pg_host"];
             if (dbJson.contains("pg_port")) database.pg_port = dbJson["pg_port"];
             if (dbJson.contains("pg_database")) database.pg_database = dbJson["pg_database"];
@@ -76,6 +77,11 @@ bool Config::LoadFromFile(const std::string& path) {
             if (dbJson.contains("pg_password")) database.pg_password = dbJson["pg_password"];
             if (dbJson.contains("max_connections")) database.max_connections = dbJson["max_connections"];
             if (dbJson.contains("connection_timeout")) database.connection_timeout = dbJson["connection_timeout"];
+            if (dbJson.contains("min_connections")) database.min_connections = dbJson["min_connections"];
+            if (dbJson.contains("acquire_timeout_ms")) database.acquire_timeout_ms = dbJson["acquire_timeout_ms"];
+            if (dbJson.contains("idle_timeout")) database.idle_timeout = dbJson["idle_timeout"];
+            if (dbJson.contains("health_check_interval")) database.health_check_interval = dbJson["health_check_interval"];
+            if (dbJson.contains("statement_cache_size")) database.statement_cache_size = dbJson["statement_cache_size"];
         }
         
         if (configJson.contains("encoder")) {
@@ -132,6 +138,12 @@ bool Config::LoadFromFile(const std::string& path) {
             if (cacheJson.contains("memory_cache_size")) cache.memory_cache_size = cacheJson["memory_cache_size"];
             if (cacheJson.contains("disk_cache_path")) cache.disk_cache_path = cacheJson["disk_cache_path"];
             if (cacheJson.contains("cache_ttl")) cache.cache_ttl = cacheJson["cache_ttl"];
+            if (cacheJson.contains("seed_threads")) cache.seed_threads = cacheJson["seed_threads"];
+            if (cacheJson.contains("seed_metatile_size")) cache.seed_metatile_size = cacheJson["seed_metatile_size"];
+            if (cacheJson.contains("seed_max_zoom")) cache.seed_max_zoom = cacheJson["seed_max_zoom"];
+            if (cacheJson.contains("seed_max_tiles")) cache.seed_max_tiles = cacheJson["seed_max_tiles"];
+            if (cacheJson.contains("seed_max_finished_jobs")) cache.seed_max_finished_jobs = cacheJson["seed_max_finished_jobs"];
+            if (cacheJson.contains("seed_state_dir")) cache.seed_state_dir = cacheJson["seed_state_dir"];
         }
         
         if (configJson.contains("log")) {
@@ -166,6 +178,7 @@ bool Config::SaveToFile(const std::string& path) const {
         
         configJson["database"]["type"] = database.type;
         configJson["database"]["sqlite_path"] = database.sqlite_path;
+        configJson["database"]["sqlite_spatial_buffer"] = database.sqlite_spatial_buffer;
         configJson["database"]["pg_host"] = database.pg_host;
         configJson["database"]["pg_port"] = database.pg_port;
         configJson["database"]["pg_database"] = database.pg_database;
@@ -173,6 +186,11 @@ bool Config::SaveToFile(const std::string& path) const {
         configJson["database"]["pg_password"] = database.pg_password;
         configJson["database"]["max_connections"] = database.max_connections;
         configJson["database"]["connection_timeout"] = database.connection_timeout;
+        configJson["database"]["min_connections"] = database.min_connections;
+        configJson["database"]["acquire_timeout_ms"] = database.acquire_timeout_ms;
+        configJson["database"]["idle_timeout"] = database.idle_timeout;
+        configJson["database"]["health_check_interval"] = database.health_check_interval;
+        configJson["database"]["statement_cache_size"] = database.statement_cache_size;
         
         configJson["encoder"]["format"] = encoder.format;
         configJson["encoder"]["png_compression"] = encoder.png_compression;
@@ -216,6 +234,12 @@ bool Config::SaveToFile(const std::string& path) const {
         configJson["cache"]["memory_cache_size"] = cache.memory_cache_size;
         configJson["cache"]["disk_cache_path"] = cache.disk_cache_path;
         configJson["cache"]["cache_ttl"] = cache.cache_ttl;
+        configJson["cache"]["seed_threads"] = cache.seed_threads;
+        configJson["cache"]["seed_metatile_size"] = cache.seed_metatile_size;
+        configJson["cache"]["seed_max_zoom"] = cache.seed_max_zoom;
+        configJson["cache"]["seed_max_tiles"] = cache.seed_max_tiles;
+        configJson["cache"]["seed_max_finished_jobs"] = cache.seed_max_finished_jobs;
+        configJson["cache"]["seed_state_dir"] = cache.seed_state_dir;
         
         configJson["log"]["level"] = log.level;
         configJson["log"]["file"] = log.file;
@@ -253,6 +277,13 @@ bool Config::Validate() const {
         return false;
     }
     
+    if (database.max_connections < 1 || database.min_connections < 0 ||
+        database.min_connections > database.max_connections) {
+        LOG_ERROR("Invalid database pool size: min=" + std::to_string(database.min_connections) +
+                  ", max=" + std::to_string(database.max_connections));
+        return false;
+    }
+    
     if (encoder.format != "png8" && encoder.format != "png32" && encoder.format != "webp") {
         LOG_ERROR("Invalid encoder format: " + encoder.format);
         return false;
@@ -278,6 +309,21 @@ bool Config::Validate() const {
         return false;
     }
     
+    if (cache.seed_threads < 1 || cache.seed_threads > server.thread_count) {
+        LOG_ERROR("Invalid seed thread count: " + std::to_string(cache.seed_threads));
+        return false;
+    }
+    
+    if (cache.seed_metatile_size < 1 || cache.seed_metatile_size > 64) {
+        LOG_ERROR("Invalid seed metatile size: " + std::to_string(cache.seed_metatile_size));
+        return false;
+    }
+    
+    if (cache.seed_max_zoom < 0 || cache.seed_max_zoom > 30) {
+        LOG_ERROR("Invalid seed max zoom: " + std::to_string(cache.seed_max_zoom));
+        return false;
+    }
+    
     if (log.level < 0 || log.level > 4) {
         LOG_ERROR("Invalid log level: " + std::to_string(log.level));
         return false;
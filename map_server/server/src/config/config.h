@@ -1,6 +1,7 @@
 #ifndef CYCLE_CONFIG_CONFIG_H
 #define CYCLE_CONFIG_CONFIG_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -30,6 +31,7 @@ struct BoundingBox {
 struct DatabaseConfig {
     std::string type = "sqlite3";
     std::string sqlite_path = "./data/map.db";
+    double sqlite_spatial_buffer = 0.0625;   // 空间查询外扩比例（相对瓦片宽高）
     
     std::string pg_host = "localhost";
     int pg_port = 5432;
@@ -39,6 +41,13 @@ struct DatabaseConfig {
     
     int max_connections = 10;
     int connection_timeout = 30;
+    
+    // 连接池
+    int min_connections = 1;
+    int acquire_timeout_ms = 5000;
+    int idle_timeout = 300;
+    int health_check_interval = 30;
+    int statement_cache_size = 64;
 };
 
 struct EncoderConfig {
@@ -103,6 +112,14 @@ struct CacheConfig {
     size_t memory_cache_size = 512 * 1024 * 1024;
     std::string disk_cache_path = "./cache";
     int cache_ttl = 3600;
+
+    // 瓦片预生成
+    int seed_threads = 2;
+    int seed_metatile_size = 8;
+    int seed_max_zoom = 20;
+    uint64_t seed_max_tiles = 50000000;  // 单个任务的瓦片数上限，0 不限制；实际还受 memory_cache_size 和 cache_ttl 限制
+    int seed_max_finished_jobs = 256;    // 保留的已结束任务数，0 不限制
+    std::string seed_state_dir = "./cache/seed_jobs";
 };
 
 struct LogConfig {
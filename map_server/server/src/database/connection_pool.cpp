@@ -0,0 +1,474 @@
+#include "connection_pool.h"
+#include "../utils/logger.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace cycle {
+namespace database {
+
+ConnectionPoolOptions ConnectionPoolOptions::FromConfig(const DatabaseConfig& config) {
+    ConnectionPoolOptions options;
+    options.maxConnections = std::max(1, config.max_connections);
+    options.minConnections = std::max(0, std::min(config.min_connections, options.maxConnections));
+    options.acquireTimeoutMs = config.acquire_timeout_ms;
+    options.idleTimeoutMs = config.idle_timeout * 1000;
+    options.healthCheckIntervalMs = config.health_check_interval * 1000;
+    options.statementCacheSize = config.statement_cache_size;
+    return options;
+}
+
+struct ConnectionLease::State {
+    using Clock = std::chrono::steady_clock;
+    using Doomed = std::vector<std::unique_ptr<PooledConnection>>;
+
+    struct IdleEntry {
+        std::unique_ptr<PooledConnection> conn;
+        Clock::time_point lastUsed;
+        Clock::time_point lastChecked;
+    };
+
+    struct Waiter {
+        std::condition_variable cv;
+        std::unique_ptr<PooledConnection> conn;
+        bool ready = false;
+        bool mayCreate = false;
+    };
+
+    ConnectionPoolOptions options;
+    PooledConnectionFactory factory;
+
+    mutable std::mutex mutex;
+    std::condition_variable maintenanceCv;
+    std::deque<IdleEntry> idle;
+    std::deque<Waiter*> waiters;
+
+    // Connections that exist or are being opened, whether idle or leased.
+    int total = 0;
+    int inUse = 0;
+    int peakInUse = 0;
+    bool closed = false;
+
+    uint64_t acquireCount = 0;
+    uint64_t waitCount = 0;
+    uint64_t timeoutCount = 0;
+    uint64_t createdCount = 0;
+    uint64_t destroyedCount = 0;
+    uint64_t createFailures = 0;
+    uint64_t healthCheckFailures = 0;
+    double totalWaitMs = 0.0;
+    double maxWaitMs = 0.0;
+
+    Clock::time_point startedAt = Clock::now();
+    Clock::time_point accountedAt = startedAt;
+    double inUseMs = 0.0;
+
+    void AccountLocked(Clock::time_point now) {
+        inUseMs += inUse * std::chrono::duration<double, std::milli>(now - accountedAt).count();
+        accountedAt = now;
+    }
+
+    void MarkLeasedLocked(Clock::time_point now) {
+        AccountLocked(now);
+        ++inUse;
+        peakInUse = std::max(peakInUse, inUse);
+    }
+
+    void RecordWaitLocked(Clock::time_point start) {
+        double waitedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        totalWaitMs += waitedMs;
+        maxWaitMs = std::max(maxWaitMs, waitedMs);
+    }
+
+    // Gives up one slot of the pool. If callers are queued the slot goes to the
+    // oldest of them, which then opens a replacement connection itself.
+    void ReleaseSlotLocked() {
+        if (!closed && !waiters.empty()) {
+            Waiter* waiter = waiters.front();
+            waiters.pop_front();
+            waiter->mayCreate = true;
+            waiter->ready = true;
+            waiter->cv.notify_one();
+            return;
+        }
+        --total;
+    }
+
+    void DiscardLocked(std::unique_ptr<PooledConnection> conn, Doomed& doomed) {
+        doomed.push_back(std::move(conn));
+        ++destroyedCount;
+        ReleaseSlotLocked();
+    }
+
+    void PlaceLocked(std::unique_ptr<PooledConnection> conn,
+                     Clock::time_point lastUsed,
+                     Clock::time_point lastChecked,
+                     Doomed& doomed) {
+        if (closed) {
+            DiscardLocked(std::move(conn), doomed);
+            return;
+        }
+
+        if (!waiters.empty()) {
+            Waiter* waiter = waiters.front();
+            waiters.pop_front();
+            MarkLeasedLocked(Clock::now());
+            waiter->conn = std::move(conn);
+            waiter->ready = true;
+            waiter->cv.notify_one();
+            return;
+        }
+
+        // Keep idle ordered by last use so the reaper only looks at the front.
+        auto pos = std::upper_bound(idle.begin(), idle.end(), lastUsed,
+            [](Clock::time_point t, const IdleEntry& entry) { return t < entry.lastUsed; });
+        IdleEntry entry;
+        entry.conn = std::move(conn);
+        entry.lastUsed = lastUsed;
+        entry.lastChecked = lastChecked;
+        idle.insert(pos, std::move(entry));
+    }
+
+    void Return(std::unique_ptr<PooledConnection> conn, bool healthy) {
+        Doomed doomed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Clock::time_point now = Clock::now();
+            AccountLocked(now);
+            --inUse;
+            if (healthy) {
+                PlaceLocked(std::move(conn), now, now, doomed);
+            } else {
+                ++healthCheckFailures;
+                DiscardLocked(std::move(conn), doomed);
+            }
+        }
+    }
+};
+
+ConnectionLease::ConnectionLease(ConnectionLease&& other) noexcept
+    : state_(std::move(other.state_))
+    , conn_(std::move(other.conn_))
+    , broken_(other.broken_) {
+    other.broken_ = false;
+}
+
+ConnectionLease& ConnectionLease::operator=(ConnectionLease&& other) noexcept {
+    if (this != &other) {
+        Release();
+        state_ = std::move(other.state_);
+        conn_ = std::move(other.conn_);
+        broken_ = other.broken_;
+        other.broken_ = false;
+    }
+    return *this;
+}
+
+ConnectionLease::~ConnectionLease() {
+    Release();
+}
+
+void ConnectionLease::Release() {
+    if (!conn_) {
+        return;
+    }
+
+    std::shared_ptr<State> state = std::move(state_);
+    std::unique_ptr<PooledConnection> conn = std::move(conn_);
+    bool healthy = !broken_ && conn->IsHealthy(false);
+    broken_ = false;
+
+    if (state) {
+        state->Return(std::move(conn), healthy);
+    }
+}
+
+DatabaseConnectionPool::DatabaseConnectionPool(const ConnectionPoolOptions& options,
+                                               PooledConnectionFactory factory)
+    : options_(options)
+    , state_(std::make_shared<ConnectionLease::State>()) {
+    options_.maxConnections = std::max(1, options_.maxConnections);
+    options_.minConnections = std::max(0, std::min(options_.minConnections, options_.maxConnections));
+    state_->options = options_;
+    state_->factory = std::move(factory);
+}
+
+DatabaseConnectionPool::~DatabaseConnectionPool() {
+    Shutdown();
+}
+
+bool DatabaseConnectionPool::Start() {
+    using State = ConnectionLease::State;
+
+    for (int i = 0; i < options_.minConnections; ++i) {
+        std::unique_ptr<PooledConnection> conn = state_->factory();
+        if (!conn) {
+            LOG_ERROR("Connection pool '" + options_.name + "' failed to open its initial connections");
+            Shutdown();
+            return false;
+        }
+
+        State::Doomed doomed;
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        ++state_->total;
+        ++state_->createdCount;
+        State::Clock::time_point now = State::Clock::now();
+        state_->PlaceLocked(std::move(conn), now, now, doomed);
+    }
+
+    if (!maintenanceThread_.joinable() &&
+        (options_.idleTimeoutMs > 0 || options_.healthCheckIntervalMs > 0)) {
+        maintenanceThread_ = std::thread(&DatabaseConnectionPool::MaintenanceWorker, this);
+    }
+
+    LOG_INFO("Connection pool '" + options_.name + "' started: min=" +
+             std::to_string(options_.minConnections) + ", max=" +
+             std::to_string(options_.maxConnections));
+    return true;
+}
+
+void DatabaseConnectionPool::Shutdown() {
+    using State = ConnectionLease::State;
+
+    State::Doomed doomed;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->closed) {
+            state_->closed = true;
+            for (State::Waiter* waiter : state_->waiters) {
+                waiter->cv.notify_one();
+            }
+            for (auto& entry : state_->idle) {
+                doomed.push_back(std::move(entry.conn));
+            }
+            state_->destroyedCount += state_->idle.size();
+            state_->total -= static_cast<int>(state_->idle.size());
+            state_->idle.clear();
+        }
+        state_->maintenanceCv.notify_all();
+    }
+
+    if (maintenanceThread_.joinable()) {
+        maintenanceThread_.join();
+    }
+}
+
+ConnectionLease DatabaseConnectionPool::Acquire(int timeoutMs) {
+    using State = ConnectionLease::State;
+
+    if (timeoutMs < 0) {
+        timeoutMs = options_.acquireTimeoutMs;
+    }
+
+    State& s = *state_;
+    State::Clock::time_point start = State::Clock::now();
+    std::unique_ptr<PooledConnection> conn;
+    bool create = false;
+
+    std::unique_lock<std::mutex> lock(s.mutex);
+    if (s.closed) {
+        return ConnectionLease();
+    }
+    ++s.acquireCount;
+
+    // Idle connections only exist while nobody is queued: a release hands its
+    // connection straight to the oldest waiter.
+    if (!s.idle.empty()) {
+        conn = std::move(s.idle.back().conn);
+        s.idle.pop_back();
+        s.MarkLeasedLocked(start);
+    } else if (s.total < options_.maxConnections) {
+        ++s.total;
+        create = true;
+    } else {
+        State::Waiter waiter;
+        s.waiters.push_back(&waiter);
+        ++s.waitCount;
+
+        waiter.cv.wait_until(lock, start + std::chrono::milliseconds(timeoutMs),
+                             [&]() { return waiter.ready || s.closed; });
+
+        if (!waiter.ready) {
+            s.waiters.erase(std::find(s.waiters.begin(), s.waiters.end(), &waiter));
+            s.RecordWaitLocked(start);
+            if (!s.closed) {
+                ++s.timeoutCount;
+                LOG_WARN("Connection pool '" + options_.name + "' acquire timed out after " +
+                         std::to_string(timeoutMs) + "ms");
+            }
+            return ConnectionLease();
+        }
+
+        if (waiter.mayCreate) {
+            create = true;
+        } else {
+            conn = std::move(waiter.conn);
+        }
+    }
+
+    if (create) {
+        lock.unlock();
+        conn = s.factory();
+        lock.lock();
+
+        if (!conn) {
+            ++s.createFailures;
+            s.ReleaseSlotLocked();
+            s.RecordWaitLocked(start);
+            LOG_ERROR("Connection pool '" + options_.name + "' failed to open a connection");
+            return ConnectionLease();
+        }
+        ++s.createdCount;
+        s.MarkLeasedLocked(State::Clock::now());
+    }
+
+    s.RecordWaitLocked(start);
+
+    ConnectionLease lease;
+    lease.state_ = state_;
+    lease.conn_ = std::move(conn);
+    return lease;
+}
+
+ConnectionPoolStats DatabaseConnectionPool::GetStats() const {
+    using State = ConnectionLease::State;
+
+    ConnectionPoolStats stats;
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    const State::Clock::time_point now = State::Clock::now();
+    state_->AccountLocked(now);
+
+    stats.name = options_.name;
+    stats.maxConnections = options_.maxConnections;
+    stats.totalConnections = state_->total;
+    stats.idleConnections = static_cast<int>(state_->idle.size());
+    stats.inUseConnections = state_->inUse;
+    stats.peakInUse = state_->peakInUse;
+    stats.waitingRequests = static_cast<int>(state_->waiters.size());
+
+    stats.acquireCount = state_->acquireCount;
+    stats.waitCount = state_->waitCount;
+    stats.timeoutCount = state_->timeoutCount;
+    stats.createdCount = state_->createdCount;
+    stats.destroyedCount = state_->destroyedCount;
+    stats.createFailures = state_->createFailures;
+    stats.healthCheckFailures = state_->healthCheckFailures;
+
+    if (state_->acquireCount > 0) {
+        stats.avgWaitMs = state_->totalWaitMs / state_->acquireCount;
+    }
+    stats.maxWaitMs = state_->maxWaitMs;
+    stats.utilization = static_cast<double>(state_->inUse) / options_.maxConnections;
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - state_->startedAt).count();
+    if (elapsedMs > 0.0) {
+        stats.avgUtilization = state_->inUseMs / (elapsedMs * options_.maxConnections);
+    }
+
+    return stats;
+}
+
+void DatabaseConnectionPool::RunMaintenance() {
+    using State = ConnectionLease::State;
+
+    State& s = *state_;
+    State::Doomed doomed;
+    std::vector<State::IdleEntry> toCheck;
+    int missing = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.closed) {
+            return;
+        }
+        State::Clock::time_point now = State::Clock::now();
+
+        if (options_.idleTimeoutMs > 0) {
+            const auto idleTimeout = std::chrono::milliseconds(options_.idleTimeoutMs);
+            while (!s.idle.empty() && s.total > options_.minConnections &&
+                   now - s.idle.front().lastUsed >= idleTimeout) {
+                doomed.push_back(std::move(s.idle.front().conn));
+                s.idle.pop_front();
+                ++s.destroyedCount;
+                --s.total;
+            }
+        }
+
+        // Connections under a deep check are taken out of the idle list but
+        // still count toward total, so the pool never exceeds its bound.
+        if (options_.healthCheckIntervalMs > 0) {
+            const auto interval = std::chrono::milliseconds(options_.healthCheckIntervalMs);
+            for (auto it = s.idle.begin(); it != s.idle.end();) {
+                if (now - it->lastChecked >= interval) {
+                    toCheck.push_back(std::move(*it));
+                    it = s.idle.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        missing = std::max(0, options_.minConnections - s.total);
+        s.total += missing;
+    }
+
+    std::vector<bool> healthy;
+    for (auto& entry : toCheck) {
+        healthy.push_back(entry.conn->IsHealthy(true));
+    }
+
+    std::vector<std::unique_ptr<PooledConnection>> created;
+    for (int i = 0; i < missing; ++i) {
+        created.push_back(s.factory());
+    }
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    State::Clock::time_point now = State::Clock::now();
+
+    for (size_t i = 0; i < toCheck.size(); ++i) {
+        if (healthy[i]) {
+            s.PlaceLocked(std::move(toCheck[i].conn), toCheck[i].lastUsed, now, doomed);
+        } else {
+            ++s.healthCheckFailures;
+            LOG_WARN("Connection pool '" + options_.name + "' dropped an unhealthy idle connection");
+            s.DiscardLocked(std::move(toCheck[i].conn), doomed);
+        }
+    }
+
+    for (auto& conn : created) {
+        if (conn) {
+            ++s.createdCount;
+            s.PlaceLocked(std::move(conn), now, now, doomed);
+        } else {
+            ++s.createFailures;
+            s.ReleaseSlotLocked();
+        }
+    }
+}
+
+void DatabaseConnectionPool::MaintenanceWorker() {
+    int intervalMs = 0;
+    if (options_.idleTimeoutMs > 0 && options_.healthCheckIntervalMs > 0) {
+        intervalMs = std::min(options_.idleTimeoutMs, options_.healthCheckIntervalMs);
+    } else {
+        intervalMs = std::max(options_.idleTimeoutMs, options_.healthCheckIntervalMs);
+    }
+    intervalMs = std::max(100, intervalMs / 2);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            state_->maintenanceCv.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                                           [this]() { return state_->closed; });
+            if (state_->closed) {
+                break;
+            }
+        }
+        RunMaintenance();
+    }
+}
+
+} // namespace database
+} // namespace cycle
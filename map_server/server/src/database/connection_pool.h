@@ -0,0 +1,110 @@
+#ifndef CYCLE_DATABASE_CONNECTION_POOL_H
+#define CYCLE_DATABASE_CONNECTION_POOL_H
+
+#include "idatabase.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace cycle {
+namespace database {
+
+struct ConnectionPoolOptions {
+    std::string name = "default";
+    int maxConnections = 10;
+    int minConnections = 1;
+    int acquireTimeoutMs = 5000;
+    int idleTimeoutMs = 300000;
+    int healthCheckIntervalMs = 30000;
+    int statementCacheSize = 64;
+
+    static ConnectionPoolOptions FromConfig(const DatabaseConfig& config);
+};
+
+class PooledConnection {
+public:
+    virtual ~PooledConnection() = default;
+
+    // deep == false runs on every release and should only do work when the
+    // connection needs repairing, e.g. rolling back a transaction left open.
+    // deep == true runs from the maintenance thread on idle connections.
+    virtual bool IsHealthy(bool deep) = 0;
+};
+
+using PooledConnectionFactory = std::function<std::unique_ptr<PooledConnection>()>;
+
+class DatabaseConnectionPool;
+
+class ConnectionLease {
+public:
+    ConnectionLease() = default;
+    ConnectionLease(ConnectionLease&& other) noexcept;
+    ConnectionLease& operator=(ConnectionLease&& other) noexcept;
+    ~ConnectionLease();
+
+    explicit operator bool() const { return conn_ != nullptr; }
+    PooledConnection* Get() const { return conn_.get(); }
+
+    template <typename T>
+    T* As() const { return static_cast<T*>(conn_.get()); }
+
+    // Marks the connection as broken so Release destroys it instead of reusing it.
+    void Invalidate() { broken_ = true; }
+    void Release();
+
+private:
+    friend class DatabaseConnectionPool;
+
+    ConnectionLease(const ConnectionLease&) = delete;
+    ConnectionLease& operator=(const ConnectionLease&) = delete;
+
+    struct State;
+    std::shared_ptr<State> state_;
+    std::unique_ptr<PooledConnection> conn_;
+    bool broken_ = false;
+};
+
+/**
+ * Bounded pool of native connections.
+ *
+ * Idle connections are reused most-recently-used first so the cold tail can be
+ * reaped. When the pool is exhausted callers queue in arrival order and a
+ * released connection is handed directly to the oldest waiter, so a burst of
+ * new callers cannot starve one that has been waiting longer.
+ */
+class DatabaseConnectionPool {
+public:
+    DatabaseConnectionPool(const ConnectionPoolOptions& options, PooledConnectionFactory factory);
+    ~DatabaseConnectionPool();
+
+    // Opens minConnections up front and starts the maintenance thread.
+    bool Start();
+    void Shutdown();
+
+    // timeoutMs < 0 uses options.acquireTimeoutMs. Returns an empty lease on
+    // timeout, shutdown or when a new connection could not be opened.
+    ConnectionLease Acquire(int timeoutMs = -1);
+
+    ConnectionPoolStats GetStats() const;
+    const ConnectionPoolOptions& GetOptions() const { return options_; }
+
+    // Runs one reap / health check pass; the maintenance thread calls this periodically.
+    void RunMaintenance();
+
+private:
+    DatabaseConnectionPool(const DatabaseConnectionPool&) = delete;
+    DatabaseConnectionPool& operator=(const DatabaseConnectionPool&) = delete;
+
+    void MaintenanceWorker();
+
+    ConnectionPoolOptions options_;
+    std::shared_ptr<ConnectionLease::State> state_;
+    std::thread maintenanceThread_;
+};
+
+} // namespace database
+} // namespace cycle
+
+#endif // CYCLE_DATABASE_CONNECTION_POOL_H
@@ -25,8 +25,25 @@ std::shared_ptr<IDatabase> DatabaseFactory::Create(const std::string& type,
     }
 }
 
-std::shared_ptr<IDatabase> DatabaseFactory::CreateSqlite(const std::string& dbPath) {
-    auto db = std::make_shared<SqliteDatabase>(dbPath);
+std::shared_ptr<IDatabase> DatabaseFactory::Create(const DatabaseConfig& config) {
+    if (config.type == "sqlite3") {
+        return CreateSqlite(config.sqlite_path, config);
+    }
+#ifdef HAVE_POSTGRESQL
+    else if (config.type == "postgresql") {
+        return CreatePostgresql(config);
+    }
+#endif
+    else {
+        LOG_ERROR("Unsupported database type: " + config.type);
+        return nullptr;
+    }
+}
+
+std::shared_ptr<IDatabase> DatabaseFactory::CreateSqlite(const std::string& dbPath,
+                                                         const DatabaseConfig& config) {
+    auto db = std::make_shared<SqliteDatabase>(dbPath, ConnectionPoolOptions::FromConfig(config));
+    db->SetSpatialQueryBuffer(config.sqlite_spatial_buffer);
     
     if (!db->Open()) {
         LOG_ERROR("Failed to open SQLite database: " + dbPath);
@@ -40,6 +57,10 @@ std::shared_ptr<IDatabase> DatabaseFactory::CreateSqlite(const std::string& dbPa
 #ifdef HAVE_POSTGRESQL
 std::shared_ptr<IDatabase> DatabaseFactory::CreatePostgresql(const std::string& connectionString) {
     DatabaseConfig config; config.pg_database = connectionString;
+    return CreatePostgresql(config);
+}
+
+std::shared_ptr<IDatabase> DatabaseFactory::CreatePostgresql(const DatabaseConfig& config) {
     auto db = std::make_shared<PostgresqlDatabase>(config);
     
     if (!db->Open()) {
@@ -13,10 +13,14 @@ public:
     static std::shared_ptr<IDatabase> Create(const std::string& type, 
                                             const std::string& connectionString);
     
-    static std::shared_ptr<IDatabase> CreateSqlite(const std::string& dbPath);
+    static std::shared_ptr<IDatabase> Create(const DatabaseConfig& config);
+    
+    static std::shared_ptr<IDatabase> CreateSqlite(const std::string& dbPath,
+                                                  const DatabaseConfig& config = DatabaseConfig());
     
 #ifdef HAVE_POSTGRESQL
     static std::shared_ptr<IDatabase> CreatePostgresql(const std::string& connectionString);
+    static std::shared_ptr<IDatabase> CreatePostgresql(const DatabaseConfig& config);
 #endif
     
     static std::vector<std::string> GetSupportedTypes();
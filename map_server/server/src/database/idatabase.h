@@ -60,6 +60,15 @@ struct SqlParameter {
     }
 };
 
+// Points into memory owned by the result set; valid until the next call to
+// ResultSet::Next() or Close().
+struct BlobView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    
+    bool IsEmpty() const { return size == 0; }
+};
+
 class DatabaseRow {
 public:
     virtual ~DatabaseRow() = default;
@@ -71,6 +80,7 @@ public:
     virtual double GetDouble(int index) const = 0;
     virtual std::string GetString(int index) const = 0;
     virtual std::vector<uint8_t> GetBlob(int index) const = 0;
+    virtual BlobView GetBlobView(int index) const = 0;
     virtual bool IsNull(int index) const = 0;
 };
 
@@ -84,6 +94,29 @@ public:
     virtual void Close() = 0;
 };
 
+struct ConnectionPoolStats {
+    std::string name;
+    int maxConnections = 0;
+    int totalConnections = 0;
+    int idleConnections = 0;
+    int inUseConnections = 0;
+    int peakInUse = 0;
+    int waitingRequests = 0;
+    
+    uint64_t acquireCount = 0;
+    uint64_t waitCount = 0;
+    uint64_t timeoutCount = 0;
+    uint64_t createdCount = 0;
+    uint64_t destroyedCount = 0;
+    uint64_t createFailures = 0;
+    uint64_t healthCheckFailures = 0;
+    
+    double avgWaitMs = 0.0;
+    double maxWaitMs = 0.0;
+    double utilization = 0.0;
+    double avgUtilization = 0.0;
+};
+
 class IDatabase {
 public:
     virtual ~IDatabase() = default;
@@ -112,6 +145,8 @@ public:
         const std::string& geometryColumn = "geometry") = 0;
     
     virtual std::string GetDatabaseType() const = 0;
+    
+    virtual bool GetPoolStats(std::vector<ConnectionPoolStats>& /*stats*/) const { return false; }
 };
 
 } // namespace database
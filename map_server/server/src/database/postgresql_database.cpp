@@ -3,10 +3,134 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <cstring>
 
 namespace cycle {
 namespace database {
 
+namespace {
+
+struct PgParameters {
+    std::vector<std::string> text;
+    std::vector<const char*> values;
+    std::vector<int> lengths;
+    std::vector<int> formats;
+};
+
+// Numbers are formatted into text first and pointed at afterwards, so the
+// pointers handed to libpq stay valid for the whole call.
+void BuildParameters(const std::vector<SqlParameter>& params, PgParameters& out) {
+    out.text.resize(params.size());
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (params[i].type == SqlParameter::INTEGER) {
+            out.text[i] = std::to_string(params[i].int_value);
+        } else if (params[i].type == SqlParameter::REAL) {
+            std::ostringstream oss;
+            oss << std::setprecision(17) << params[i].real_value;
+            out.text[i] = oss.str();
+        }
+    }
+    
+    for (size_t i = 0; i < params.size(); ++i) {
+        const SqlParameter& param = params[i];
+        switch (param.type) {
+            case SqlParameter::INTEGER:
+            case SqlParameter::REAL:
+                out.values.push_back(out.text[i].c_str());
+                out.lengths.push_back(static_cast<int>(out.text[i].length()));
+                out.formats.push_back(0); // text format
+                break;
+            case SqlParameter::TEXT:
+                out.values.push_back(param.text_value);
+                out.lengths.push_back(static_cast<int>(strlen(param.text_value)));
+                out.formats.push_back(0);
+                break;
+            case SqlParameter::BLOB:
+                out.values.push_back(static_cast<const char*>(param.blob_data));
+                out.lengths.push_back(static_cast<int>(param.blob_size));
+                out.formats.push_back(1); // binary format
+                break;
+            case SqlParameter::NULL_VALUE:
+                out.values.push_back(nullptr);
+                out.lengths.push_back(0);
+                out.formats.push_back(0);
+                break;
+        }
+    }
+}
+
+} // namespace
+
+// PostgresqlConnection implementation
+PostgresqlConnection::PostgresqlConnection(PGconn* conn, size_t statementCacheSize)
+    : conn_(conn)
+    , capacity_(statementCacheSize)
+    , nextStatementId_(0) {
+}
+
+PostgresqlConnection::~PostgresqlConnection() {
+    if (conn_) {
+        PQfinish(conn_);
+    }
+}
+
+bool PostgresqlConnection::IsHealthy(bool deep) {
+    if (!conn_ || PQstatus(conn_) != CONNECTION_OK) {
+        return false;
+    }
+    
+    PGTransactionStatusType txStatus = PQtransactionStatus(conn_);
+    if (txStatus == PQTRANS_INTRANS || txStatus == PQTRANS_INERROR) {
+        // A caller that left a transaction open must not hand it to the next one.
+        PGresult* result = PQexec(conn_, "ROLLBACK");
+        bool rolledBack = PQresultStatus(result) == PGRES_COMMAND_OK;
+        PQclear(result);
+        if (!rolledBack) {
+            return false;
+        }
+    } else if (txStatus != PQTRANS_IDLE) {
+        return false;
+    }
+    
+    if (!deep) {
+        return true;
+    }
+    
+    PGresult* result = PQexec(conn_, "SELECT 1");
+    bool healthy = PQresultStatus(result) == PGRES_TUPLES_OK;
+    PQclear(result);
+    return healthy;
+}
+
+std::string PostgresqlConnection::PrepareCached(const std::string& sql, int paramCount, std::string& error) {
+    auto it = bySql_.find(sql);
+    if (it != bySql_.end()) {
+        cache_.splice(cache_.begin(), cache_, it->second);
+        return it->second->name;
+    }
+    
+    std::string name = "cycle_stmt_" + std::to_string(++nextStatementId_);
+    PGresult* result = PQprepare(conn_, name.c_str(), sql.c_str(), paramCount, nullptr);
+    if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+        error = PQresultErrorMessage(result);
+        PQclear(result);
+        return std::string();
+    }
+    PQclear(result);
+    
+    cache_.push_front(CachedStatement{sql, name});
+    bySql_[sql] = cache_.begin();
+    
+    while (cache_.size() > std::max<size_t>(capacity_, 1)) {
+        const CachedStatement& victim = cache_.back();
+        PQclear(PQexec(conn_, ("DEALLOCATE " + victim.name).c_str()));
+        bySql_.erase(victim.sql);
+        cache_.pop_back();
+    }
+    
+    return name;
+}
+
 PostgresqlDatabase::PostgresqlDatabase(const DatabaseConfig& config)
     : config_(config)
     , postgisInitialized_(false)
@@ -22,31 +146,35 @@ PostgresqlDatabase::~PostgresqlDatabase() {
 }
 
 bool PostgresqlDatabase::Open() {
-    std::lock_guard<std::mutex> lock(poolMutex_);
-    
-    if (!connectionPool_.empty()) {
-        LOG_WARN("PostgreSQL database is already open");
-        return true;
-    }
-    
-    LOG_INFO("Opening PostgreSQL database connection pool");
-    
-    for (int i = 0; i < config_.max_connections; ++i) {
-        PGconn* conn = CreateConnection();
-        if (!conn || PQstatus(conn) != CONNECTION_OK) {
-            lastError_ = PQerrorMessage(conn);
-            lastErrorCode_ = 1;
-            LOG_ERROR("Failed to create PostgreSQL connection: " + lastError_);
-            
-            if (conn) {
-                PQfinish(conn);
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        
+        if (pool_) {
+            LOG_WARN("PostgreSQL database is already open");
+            return true;
+        }
+        
+        LOG_INFO("Opening PostgreSQL database connection pool");
+        
+        ConnectionPoolOptions options = ConnectionPoolOptions::FromConfig(config_);
+        options.name = "postgresql";
+        size_t cacheSize = static_cast<size_t>(std::max(0, options.statementCacheSize));
+        
+        auto pool = std::make_shared<DatabaseConnectionPool>(options, [this, cacheSize]() {
+            std::unique_ptr<PooledConnection> conn;
+            PGconn* handle = CreateConnection();
+            if (handle) {
+                conn.reset(new PostgresqlConnection(handle, cacheSize));
             }
-            
-            Close();
+            return conn;
+        });
+        
+        if (!pool->Start()) {
+            SetError("Failed to create PostgreSQL connection", 1);
             return false;
         }
         
-        connectionPool_.push_back(conn);
+        pool_ = pool;
     }
     
     if (!InitPostGIS()) {
@@ -55,22 +183,23 @@ bool PostgresqlDatabase::Open() {
         return false;
     }
     
-    LOG_INFO("PostgreSQL database opened successfully with " + 
-             std::to_string(connectionPool_.size()) + " connections");
+    LOG_INFO("PostgreSQL database opened successfully, pool size " + 
+             std::to_string(config_.min_connections) + "-" + std::to_string(config_.max_connections));
     
     return true;
 }
 
 void PostgresqlDatabase::Close() {
-    std::lock_guard<std::mutex> lock(poolMutex_);
-    
-    for (PGconn* conn : connectionPool_) {
-        if (conn) {
-            PQfinish(conn);
-        }
+    std::shared_ptr<DatabaseConnectionPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        pinned_.clear();
+        pool.swap(pool_);
     }
     
-    connectionPool_.clear();
+    if (pool) {
+        pool->Shutdown();
+    }
     postgisInitialized_ = false;
     
     LOG_INFO("PostgreSQL database closed");
@@ -78,217 +207,136 @@ void PostgresqlDatabase::Close() {
 
 bool PostgresqlDatabase::IsOpen() const {
     std::lock_guard<std::mutex> lock(poolMutex_);
-    return !connectionPool_.empty();
+    return pool_ != nullptr;
 }
 
 bool PostgresqlDatabase::Execute(const std::string& sql) {
-    PGconn* conn = GetConnection();
-    if (!conn) {
-        lastError_ = "No database connection available";
-        lastErrorCode_ = 2;
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
         return false;
     }
     
-    PGresult* result = PQexec(conn, sql.c_str());
+    PGresult* result = PQexec(lease->As<PostgresqlConnection>()->GetHandle(), sql.c_str());
     
     bool success = (PQresultStatus(result) == PGRES_COMMAND_OK);
     if (!success) {
-        lastError_ = PQresultErrorMessage(result);
-        lastErrorCode_ = PQresultStatus(result);
-        LOG_ERROR("PostgreSQL execute failed: " + lastError_);
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("PostgreSQL execute failed: " + GetLastError());
     }
     
     PQclear(result);
-    ReturnConnection(conn);
     
     return success;
 }
 
 bool PostgresqlDatabase::Execute(const std::string& sql, const std::vector<SqlParameter>& params) {
-    PGconn* conn = GetConnection();
-    if (!conn) {
-        lastError_ = "No database connection available";
-        lastErrorCode_ = 2;
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
         return false;
     }
     
-    std::vector<const char*> paramValues;
-    std::vector<int> paramLengths;
-    std::vector<int> paramFormats;
-    
-    for (const auto& param : params) {
-        switch (param.type) {
-            case SqlParameter::INTEGER: {
-                std::string value = std::to_string(param.int_value);
-                paramValues.push_back(value.c_str());
-                paramLengths.push_back(value.length());
-                paramFormats.push_back(0); // text format
-                break;
-            }
-            case SqlParameter::REAL: {
-                std::string value = std::to_string(param.real_value);
-                paramValues.push_back(value.c_str());
-                paramLengths.push_back(value.length());
-                paramFormats.push_back(0);
-                break;
-            }
-            case SqlParameter::TEXT: {
-                paramValues.push_back(param.text_value);
-                paramLengths.push_back(strlen(param.text_value));
-                paramFormats.push_back(0);
-                break;
-            }
-            case SqlParameter::BLOB: {
-                paramValues.push_back(static_cast<const char*>(param.blob_data));
-                paramLengths.push_back(param.blob_size);
-                paramFormats.push_back(1); // binary format
-                break;
-            }
-            case SqlParameter::NULL_VALUE: {
-                paramValues.push_back(nullptr);
-                paramLengths.push_back(0);
-                paramFormats.push_back(0);
-                break;
-            }
-        }
+    PGresult* result = ExecParams(lease, sql, params);
+    if (!result) {
+        return false;
     }
     
-    PGresult* result = PQexecParams(conn, sql.c_str(), 
-                                    params.size(), 
-                                    nullptr, // param types
-                                    paramValues.data(),
-                                    paramLengths.data(),
-                                    paramFormats.data(),
-                                    0); // result format
-    
     bool success = (PQresultStatus(result) == PGRES_COMMAND_OK);
     if (!success) {
-        lastError_ = PQresultErrorMessage(result);
-        lastErrorCode_ = PQresultStatus(result);
-        LOG_ERROR("PostgreSQL execute with params failed: " + lastError_);
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("PostgreSQL execute with params failed: " + GetLastError());
     }
     
     PQclear(result);
-    ReturnConnection(conn);
     
     return success;
 }
 
 std::unique_ptr<ResultSet> PostgresqlDatabase::Query(const std::string& sql) {
-    PGconn* conn = GetConnection();
-    if (!conn) {
-        lastError_ = "No database connection available";
-        lastErrorCode_ = 2;
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
         return nullptr;
     }
     
-    PGresult* result = PQexec(conn, sql.c_str());
+    PGresult* result = PQexec(lease->As<PostgresqlConnection>()->GetHandle(), sql.c_str());
     
     if (PQresultStatus(result) != PGRES_TUPLES_OK) {
-        lastError_ = PQresultErrorMessage(result);
-        lastErrorCode_ = PQresultStatus(result);
-        LOG_ERROR("PostgreSQL query failed: " + lastError_);
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("PostgreSQL query failed: " + GetLastError());
         
         PQclear(result);
-        ReturnConnection(conn);
         return nullptr;
     }
     
-    ReturnConnection(conn);
-    
     return std::make_unique<PostgresqlResultSet>(result);
 }
 
 std::unique_ptr<ResultSet> PostgresqlDatabase::Query(const std::string& sql, 
                                                      const std::vector<SqlParameter>& params) {
-    PGconn* conn = GetConnection();
-    if (!conn) {
-        lastError_ = "No database connection available";
-        lastErrorCode_ = 2;
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
         return nullptr;
     }
     
-    std::vector<const char*> paramValues;
-    std::vector<int> paramLengths;
-    std::vector<int> paramFormats;
-    
-    for (const auto& param : params) {
-        switch (param.type) {
-            case SqlParameter::INTEGER: {
-                std::string value = std::to_string(param.int_value);
-                paramValues.push_back(value.c_str());
-                paramLengths.push_back(value.length());
-                paramFormats.push_back(0);
-                break;
-            }
-            case SqlParameter::REAL: {
-                std::string value = std::to_string(param.real_value);
-                paramValues.push_back(value.c_str());
-                paramLengths.push_back(value.length());
-                paramFormats.push_back(0);
-                break;
-            }
-            case SqlParameter::TEXT: {
-                paramValues.push_back(param.text_value);
-                paramLengths.push_back(strlen(param.text_value));
-                paramFormats.push_back(0);
-                break;
-            }
-            case SqlParameter::BLOB: {
-                paramValues.push_back(static_cast<const char*>(param.blob_data));
-                paramLengths.push_back(param.blob_size);
-                paramFormats.push_back(1);
-                break;
-            }
-            case SqlParameter::NULL_VALUE: {
-                paramValues.push_back(nullptr);
-                paramLengths.push_back(0);
-                paramFormats.push_back(0);
-                break;
-            }
-        }
+    PGresult* result = ExecParams(lease, sql, params);
+    if (!result) {
+        return nullptr;
     }
     
-    PGresult* result = PQexecParams(conn, sql.c_str(), 
-                                    params.size(), 
-                                    nullptr,
-                                    paramValues.data(),
-                                    paramLengths.data(),
-                                    paramFormats.data(),
-                                    0);
-    
     if (PQresultStatus(result) != PGRES_TUPLES_OK) {
-        lastError_ = PQresultErrorMessage(result);
-        lastErrorCode_ = PQresultStatus(result);
-        LOG_ERROR("PostgreSQL query with params failed: " + lastError_);
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("PostgreSQL query with params failed: " + GetLastError());
         
         PQclear(result);
-        ReturnConnection(conn);
         return nullptr;
     }
     
-    ReturnConnection(conn);
-    
     return std::make_unique<PostgresqlResultSet>(result);
 }
 
 bool PostgresqlDatabase::BeginTransaction() {
-    return Execute("BEGIN");
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
+        return false;
+    }
+    
+    PGresult* result = PQexec(lease->As<PostgresqlConnection>()->GetHandle(), "BEGIN");
+    bool success = (PQresultStatus(result) == PGRES_COMMAND_OK);
+    if (!success) {
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("PostgreSQL execute failed: " + GetLastError());
+    }
+    PQclear(result);
+    
+    if (success) {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        pinned_[std::this_thread::get_id()] = lease;
+    }
+    return success;
 }
 
 bool PostgresqlDatabase::CommitTransaction() {
-    return Execute("COMMIT");
+    bool success = Execute("COMMIT");
+    
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    pinned_.erase(std::this_thread::get_id());
+    return success;
 }
 
 bool PostgresqlDatabase::RollbackTransaction() {
-    return Execute("ROLLBACK");
+    bool success = Execute("ROLLBACK");
+    
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    pinned_.erase(std::this_thread::get_id());
+    return success;
 }
 
 std::string PostgresqlDatabase::GetLastError() const {
+    std::lock_guard<std::mutex> lock(errorMutex_);
     return lastError_;
 }
 
 int PostgresqlDatabase::GetLastErrorCode() const {
+    std::lock_guard<std::mutex> lock(errorMutex_);
     return lastErrorCode_;
 }
 
@@ -296,12 +344,21 @@ std::string PostgresqlDatabase::GetDatabaseType() const {
     return "PostgreSQL";
 }
 
+bool PostgresqlDatabase::GetPoolStats(std::vector<ConnectionPoolStats>& stats) const {
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    if (!pool_) {
+        return false;
+    }
+    
+    stats.push_back(pool_->GetStats());
+    return true;
+}
+
 std::unique_ptr<ResultSet> PostgresqlDatabase::QuerySpatial(const std::string& table,
                                                            const BoundingBox& envelope,
                                                            const std::string& geometryColumn) {
     if (!postgisInitialized_) {
-        lastError_ = "PostGIS not initialized";
-        lastErrorCode_ = 3;
+        SetError("PostGIS not initialized", 3);
         return nullptr;
     }
     
@@ -309,60 +366,81 @@ std::unique_ptr<ResultSet> PostgresqlDatabase::QuerySpatial(const std::string& t
     return Query(sql);
 }
 
-PGconn* PostgresqlDatabase::GetConnection() {
-    std::lock_guard<std::mutex> lock(poolMutex_);
+std::shared_ptr<ConnectionLease> PostgresqlDatabase::AcquireLease() {
+    std::shared_ptr<DatabaseConnectionPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        
+        auto pinned = pinned_.find(std::this_thread::get_id());
+        if (pinned != pinned_.end()) {
+            return pinned->second;
+        }
+        pool = pool_;
+    }
     
-    if (connectionPool_.empty()) {
+    if (!pool) {
+        SetError("No database connection available", 2);
         return nullptr;
     }
     
-    PGconn* conn = connectionPool_.back();
-    connectionPool_.pop_back();
-    
-    if (PQstatus(conn) != CONNECTION_OK) {
-        PQreset(conn);
-        
-        if (PQstatus(conn) != CONNECTION_OK) {
-            PQfinish(conn);
-            return nullptr;
-        }
+    ConnectionLease lease = pool->Acquire();
+    if (!lease) {
+        SetError("No database connection available", 2);
+        return nullptr;
     }
     
-    return conn;
+    return std::make_shared<ConnectionLease>(std::move(lease));
 }
 
-void PostgresqlDatabase::ReturnConnection(PGconn* conn) {
-    std::lock_guard<std::mutex> lock(poolMutex_);
+PGresult* PostgresqlDatabase::ExecParams(const std::shared_ptr<ConnectionLease>& lease,
+                                         const std::string& sql,
+                                         const std::vector<SqlParameter>& params) {
+    PostgresqlConnection* conn = lease->As<PostgresqlConnection>();
     
-    if (conn && PQstatus(conn) == CONNECTION_OK) {
-        connectionPool_.push_back(conn);
-    } else {
-        if (conn) {
-            PQfinish(conn);
-        }
+    std::string error;
+    std::string statement = conn->PrepareCached(sql, static_cast<int>(params.size()), error);
+    if (statement.empty()) {
+        SetError(error, PGRES_FATAL_ERROR);
+        LOG_ERROR("PostgreSQL prepare failed: " + error);
+        return nullptr;
     }
+    
+    PgParameters values;
+    BuildParameters(params, values);
+    
+    return PQexecPrepared(conn->GetHandle(), statement.c_str(),
+                          static_cast<int>(params.size()),
+                          values.values.data(),
+                          values.lengths.data(),
+                          values.formats.data(),
+                          0); // result format
+}
+
+void PostgresqlDatabase::SetError(const std::string& message, int code) {
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    lastError_ = message;
+    lastErrorCode_ = code;
 }
 
 bool PostgresqlDatabase::InitPostGIS() {
-    PGconn* conn = GetConnection();
-    if (!conn) {
+    std::shared_ptr<ConnectionLease> lease = AcquireLease();
+    if (!lease) {
         return false;
     }
     
-    PGresult* result = PQexec(conn, "CREATE EXTENSION IF NOT EXISTS postgis");
+    PGresult* result = PQexec(lease->As<PostgresqlConnection>()->GetHandle(),
+                              "CREATE EXTENSION IF NOT EXISTS postgis");
     bool success = (PQresultStatus(result) == PGRES_COMMAND_OK);
     
     if (success) {
         postgisInitialized_ = true;
         LOG_INFO("PostGIS extension initialized successfully");
     } else {
-        lastError_ = PQresultErrorMessage(result);
-        lastErrorCode_ = PQresultStatus(result);
-        LOG_ERROR("Failed to initialize PostGIS: " + lastError_);
+        SetError(PQresultErrorMessage(result), PQresultStatus(result));
+        LOG_ERROR("Failed to initialize PostGIS: " + GetLastError());
     }
     
     PQclear(result);
-    ReturnConnection(conn);
     
     return success;
 }
@@ -475,6 +553,17 @@ std::vector<uint8_t> PostgresqlDatabaseRow::GetBlob(int index) const {
     return blob;
 }
 
+BlobView PostgresqlDatabaseRow::GetBlobView(int index) const {
+    BlobView view;
+    if (IsNull(index)) {
+        return view;
+    }
+    
+    view.data = reinterpret_cast<const uint8_t*>(PQgetvalue(result_, rowIndex_, index));
+    view.size = static_cast<size_t>(PQgetlength(result_, rowIndex_, index));
+    return view;
+}
+
 bool PostgresqlDatabaseRow::IsNull(int index) const {
     if (index < 0 || index >= columnCount_) {
         return true;
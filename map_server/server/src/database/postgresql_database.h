@@ -4,13 +4,50 @@
 #include "idatabase.h"
 
 #ifdef HAVE_POSTGRESQL
+#include "connection_pool.h"
 #include <libpq-fe.h>
+#include <atomic>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace cycle {
 namespace database {
+
+class PostgresqlConnection : public PooledConnection {
+public:
+    PostgresqlConnection(PGconn* conn, size_t statementCacheSize);
+    ~PostgresqlConnection() override;
+    
+    bool IsHealthy(bool deep) override;
+    
+    PGconn* GetHandle() const { return conn_; }
+    
+    // Returns the name of a server-side prepared statement for sql, preparing
+    // it on a miss and deallocating the least recently used one past capacity.
+    // Returns an empty string and fills error when PQprepare fails.
+    std::string PrepareCached(const std::string& sql, int paramCount, std::string& error);
+    
+    size_t GetCachedStatementCount() const { return cache_.size(); }
+    
+private:
+    struct CachedStatement {
+        std::string sql;
+        std::string name;
+    };
+    
+    PGconn* conn_;
+    size_t capacity_;
+    uint64_t nextStatementId_;
+    std::list<CachedStatement> cache_;
+    std::unordered_map<std::string, std::list<CachedStatement>::iterator> bySql_;
+};
+
 class PostgresqlDatabase : public IDatabase {
 public:
     explicit PostgresqlDatabase(const DatabaseConfig& config);
@@ -40,9 +77,14 @@ public:
     
     std::string GetDatabaseType() const override;
     
+    bool GetPoolStats(std::vector<ConnectionPoolStats>& stats) const override;
+    
 private:
-    PGconn* GetConnection();
-    void ReturnConnection(PGconn* conn);
+    std::shared_ptr<ConnectionLease> AcquireLease();
+    PGresult* ExecParams(const std::shared_ptr<ConnectionLease>& lease,
+                         const std::string& sql,
+                         const std::vector<SqlParameter>& params);
+    void SetError(const std::string& message, int code);
     bool InitPostGIS();
     std::string BuildConnectionString() const;
     
@@ -54,12 +96,14 @@ private:
                                  const std::string& geometryColumn) const;
     
     DatabaseConfig config_;
-    std::vector<PGconn*> connectionPool_;
+    std::shared_ptr<DatabaseConnectionPool> pool_;
+    std::map<std::thread::id, std::shared_ptr<ConnectionLease>> pinned_;
     mutable std::mutex poolMutex_;
-    bool postgisInitialized_;
+    std::atomic<bool> postgisInitialized_;
     
     std::string lastError_;
     int lastErrorCode_;
+    mutable std::mutex errorMutex_;
 };
 
 class PostgresqlDatabaseRow : public DatabaseRow {
@@ -74,6 +118,7 @@ public:
     double GetDouble(int index) const override;
     std::string GetString(int index) const override;
     std::vector<uint8_t> GetBlob(int index) const override;
+    BlobView GetBlobView(int index) const override;
     bool IsNull(int index) const override;
     
 private:
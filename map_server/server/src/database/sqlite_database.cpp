@@ -1,14 +1,147 @@
 #include "sqlite_database.h"
 #include "../utils/logger.h"
+#include <algorithm>
 #include <sstream>
 
 namespace cycle {
 namespace database {
 
-SqliteDatabase::SqliteDatabase(const std::string& dbPath)
-    : db_(nullptr)
-    , dbPath_(dbPath)
+namespace {
+
+void BindParameters(sqlite3_stmt* stmt, const std::vector<SqlParameter>& params) {
+    for (size_t i = 0; i < params.size(); ++i) {
+        int paramIndex = static_cast<int>(i + 1);
+        const SqlParameter& param = params[i];
+        
+        switch (param.type) {
+            case SqlParameter::INTEGER:
+                sqlite3_bind_int(stmt, paramIndex, param.int_value);
+                break;
+            case SqlParameter::REAL:
+                sqlite3_bind_double(stmt, paramIndex, param.real_value);
+                break;
+            case SqlParameter::TEXT:
+                sqlite3_bind_text(stmt, paramIndex, param.text_value, -1, SQLITE_TRANSIENT);
+                break;
+            case SqlParameter::BLOB:
+                sqlite3_bind_blob(stmt, paramIndex, param.blob_data, 
+                                 static_cast<int>(param.blob_size), SQLITE_TRANSIENT);
+                break;
+            case SqlParameter::NULL_VALUE:
+                sqlite3_bind_null(stmt, paramIndex);
+                break;
+        }
+    }
+}
+
+std::string QuoteIdentifier(const std::string& name) {
+    std::string quoted = "\"";
+    for (char c : name) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+} // namespace
+
+SqliteConnection::SqliteConnection(sqlite3* db, bool readOnly, size_t statementCacheSize)
+    : db_(db)
+    , readOnly_(readOnly)
+    , capacity_(statementCacheSize) {
+}
+
+SqliteConnection::~SqliteConnection() {
+    for (auto& entry : cache_) {
+        sqlite3_finalize(entry.stmt);
+    }
+    cache_.clear();
+    sqlite3_close_v2(db_);
+}
+
+bool SqliteConnection::IsHealthy(bool deep) {
+    if (!db_) {
+        return false;
+    }
+    
+    // A caller that left a transaction open must not hand it to the next one.
+    if (!sqlite3_get_autocommit(db_) &&
+        sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    if (!deep) {
+        return true;
+    }
+    
+    return sqlite3_exec(db_, "SELECT count(*) FROM sqlite_master", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+sqlite3_stmt* SqliteConnection::PrepareCached(const std::string& sql, int* errorCode) {
+    auto it = bySql_.find(sql);
+    if (it != bySql_.end() && !it->second->inUse) {
+        cache_.splice(cache_.begin(), cache_, it->second);
+        it->second->inUse = true;
+        *errorCode = SQLITE_OK;
+        return it->second->stmt;
+    }
+    
+    sqlite3_stmt* stmt = nullptr;
+    *errorCode = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
+    if (*errorCode != SQLITE_OK || !stmt) {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    
+    // A second cursor on a statement that is still stepping gets its own
+    // uncached copy, which ReleaseStatement finalizes.
+    if (capacity_ == 0 || it != bySql_.end()) {
+        return stmt;
+    }
+    
+    cache_.push_front(CachedStatement{sql, stmt, true});
+    bySql_[sql] = cache_.begin();
+    byStmt_[stmt] = cache_.begin();
+    
+    auto victim = cache_.end();
+    while (cache_.size() > capacity_ && victim != cache_.begin()) {
+        --victim;
+        if (victim->inUse) {
+            continue;
+        }
+        bySql_.erase(victim->sql);
+        byStmt_.erase(victim->stmt);
+        sqlite3_finalize(victim->stmt);
+        victim = cache_.erase(victim);
+    }
+    
+    return stmt;
+}
+
+void SqliteConnection::ReleaseStatement(sqlite3_stmt* stmt) {
+    if (!stmt) {
+        return;
+    }
+    
+    auto it = byStmt_.find(stmt);
+    if (it == byStmt_.end()) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    it->second->inUse = false;
+}
+
+SqliteDatabase::SqliteDatabase(const std::string& dbPath, const ConnectionPoolOptions& poolOptions)
+    : dbPath_(dbPath)
+    , poolOptions_(poolOptions)
     , hasSpatialite_(false)
+    , spatialBuffer_(0.0)
     , lastErrorCode_(0) {
 }
 
@@ -19,19 +152,37 @@ SqliteDatabase::~SqliteDatabase() {
 bool SqliteDatabase::Open() {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (db_) {
+        if (writerPool_) {
             return true;
         }
-
-        int result = sqlite3_open(dbPath_.c_str(), &db_);
-        if (result != SQLITE_OK) {
-            lastError_ = sqlite3_errmsg(db_);
-            lastErrorCode_ = result;
-            LOG_ERROR("Failed to open SQLite database: " + lastError_);
-            sqlite3_close(db_);
-            db_ = nullptr;
+        
+        ConnectionPoolOptions writerOptions = poolOptions_;
+        writerOptions.name = "sqlite-writer";
+        writerOptions.maxConnections = 1;
+        writerOptions.minConnections = 1;
+        
+        auto writerPool = std::make_shared<DatabaseConnectionPool>(
+            writerOptions, [this]() { return OpenConnection(false); });
+        if (!writerPool->Start()) {
+            LOG_ERROR("Failed to open SQLite database: " + GetLastError());
             return false;
         }
+        
+        std::shared_ptr<DatabaseConnectionPool> readerPool;
+        if (!IsMemoryDatabase()) {
+            ConnectionPoolOptions readerOptions = poolOptions_;
+            readerOptions.name = "sqlite-readers";
+            
+            readerPool = std::make_shared<DatabaseConnectionPool>(
+                readerOptions, [this]() { return OpenConnection(true); });
+            if (!readerPool->Start()) {
+                LOG_ERROR("Failed to open SQLite reader connections: " + GetLastError());
+                return false;
+            }
+        }
+        
+        writerPool_ = writerPool;
+        readerPool_ = readerPool;
     }
     
     if (!InitSpatialite()) {
@@ -43,34 +194,43 @@ bool SqliteDatabase::Open() {
 }
 
 void SqliteDatabase::Close() {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<DatabaseConnectionPool> writerPool;
+    std::shared_ptr<DatabaseConnectionPool> readerPool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pinned_.clear();
+        lentWriter_.clear();
+        writerPool.swap(writerPool_);
+        readerPool.swap(readerPool_);
+    }
     
-    if (db_) {
-        sqlite3_close(db_);
-        db_ = nullptr;
+    if (writerPool) {
+        if (readerPool) {
+            readerPool->Shutdown();
+        }
+        writerPool->Shutdown();
         LOG_INFO("SQLite database closed");
     }
 }
 
 bool SqliteDatabase::IsOpen() const {
-    return db_ != nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writerPool_ != nullptr;
 }
 
 bool SqliteDatabase::Execute(const std::string& sql) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!db_) {
-        lastError_ = "Database not open";
+    std::shared_ptr<ConnectionLease> lease = AcquireLease(true);
+    if (!lease) {
         return false;
     }
     
     char* errMsg = nullptr;
-    int result = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errMsg);
+    int result = sqlite3_exec(lease->As<SqliteConnection>()->GetHandle(), sql.c_str(),
+                              nullptr, nullptr, &errMsg);
     
     if (result != SQLITE_OK) {
-        lastError_ = errMsg ? errMsg : "Unknown error";
-        lastErrorCode_ = result;
-        LOG_ERROR("SQL execution failed: " + lastError_);
+        SetError(errMsg ? errMsg : "Unknown error", result);
+        LOG_ERROR("SQL execution failed: " + GetLastError());
         if (errMsg) {
             sqlite3_free(errMsg);
         }
@@ -81,185 +241,219 @@ bool SqliteDatabase::Execute(const std::string& sql) {
 }
 
 bool SqliteDatabase::Execute(const std::string& sql, const std::vector<SqlParameter>& params) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!db_) {
-        lastError_ = "Database not open";
+    std::shared_ptr<ConnectionLease> lease = AcquireLease(true);
+    if (!lease) {
         return false;
     }
     
-    sqlite3_stmt* stmt = nullptr;
-    int result = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    
-    if (result != SQLITE_OK) {
-        lastError_ = sqlite3_errmsg(db_);
-        lastErrorCode_ = result;
-        LOG_ERROR("Failed to prepare SQL: " + lastError_);
+    sqlite3_stmt* stmt = PrepareOn(lease, sql);
+    if (!stmt) {
         return false;
     }
     
-    for (size_t i = 0; i < params.size(); ++i) {
-        int paramIndex = static_cast<int>(i + 1);
-        const SqlParameter& param = params[i];
-        
-        switch (param.type) {
-            case SqlParameter::INTEGER:
-                sqlite3_bind_int(stmt, paramIndex, param.int_value);
-                break;
-            case SqlParameter::REAL:
-                sqlite3_bind_double(stmt, paramIndex, param.real_value);
-                break;
-            case SqlParameter::TEXT:
-                sqlite3_bind_text(stmt, paramIndex, param.text_value, -1, SQLITE_TRANSIENT);
-                break;
-            case SqlParameter::BLOB:
-                sqlite3_bind_blob(stmt, paramIndex, param.blob_data, 
-                                 static_cast<int>(param.blob_size), SQLITE_TRANSIENT);
-                break;
-            case SqlParameter::NULL_VALUE:
-                sqlite3_bind_null(stmt, paramIndex);
-                break;
-        }
-    }
-    
-    result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    SqliteConnection* conn = lease->As<SqliteConnection>();
+    BindParameters(stmt, params);
     
+    int result = sqlite3_step(stmt);
     if (result != SQLITE_DONE && result != SQLITE_ROW) {
-        lastError_ = sqlite3_errmsg(db_);
-        lastErrorCode_ = result;
-        LOG_ERROR("SQL execution failed: " + lastError_);
+        SetError(sqlite3_errmsg(conn->GetHandle()), result);
+        LOG_ERROR("SQL execution failed: " + GetLastError());
+        conn->ReleaseStatement(stmt);
         return false;
     }
     
+    conn->ReleaseStatement(stmt);
     return true;
 }
 
 std::unique_ptr<ResultSet> SqliteDatabase::Query(const std::string& sql) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!db_) {
-        lastError_ = "Database not open";
-        return nullptr;
-    }
-    
-    sqlite3_stmt* stmt = nullptr;
-    int result = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    
-    if (result != SQLITE_OK) {
-        lastError_ = sqlite3_errmsg(db_);
-        lastErrorCode_ = result;
-        LOG_ERROR("Failed to prepare query: " + lastError_);
-        return nullptr;
-    }
-    
-    return std::unique_ptr<ResultSet>(new SqliteResultSet(stmt));
+    return Query(sql, std::vector<SqlParameter>());
 }
 
 std::unique_ptr<ResultSet> SqliteDatabase::Query(const std::string& sql, 
                                                   const std::vector<SqlParameter>& params) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!db_) {
-        lastError_ = "Database not open";
+    std::shared_ptr<ConnectionLease> lease = AcquireLease(false);
+    if (!lease) {
         return nullptr;
     }
     
-    sqlite3_stmt* stmt = nullptr;
-    int result = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-    
-    if (result != SQLITE_OK) {
-        lastError_ = sqlite3_errmsg(db_);
-        lastErrorCode_ = result;
-        LOG_ERROR("Failed to prepare query: " + lastError_);
+    sqlite3_stmt* stmt = PrepareOn(lease, sql);
+    if (!stmt) {
         return nullptr;
     }
     
-    for (size_t i = 0; i < params.size(); ++i) {
-        int paramIndex = static_cast<int>(i + 1);
-        const SqlParameter& param = params[i];
-        
-        switch (param.type) {
-            case SqlParameter::INTEGER:
-                sqlite3_bind_int(stmt, paramIndex, param.int_value);
-                break;
-            case SqlParameter::REAL:
-                sqlite3_bind_double(stmt, paramIndex, param.real_value);
-                break;
-            case SqlParameter::TEXT:
-                sqlite3_bind_text(stmt, paramIndex, param.text_value, -1, SQLITE_TRANSIENT);
-                break;
-            case SqlParameter::BLOB:
-                sqlite3_bind_blob(stmt, paramIndex, param.blob_data, 
-                                 static_cast<int>(param.blob_size), SQLITE_TRANSIENT);
-                break;
-            case SqlParameter::NULL_VALUE:
-                sqlite3_bind_null(stmt, paramIndex);
-                break;
+    // Readers are opened read-only; anything that writes moves to the writer.
+    if (lease->As<SqliteConnection>()->IsReadOnly() && !sqlite3_stmt_readonly(stmt)) {
+        lease->As<SqliteConnection>()->ReleaseStatement(stmt);
+        lease = AcquireLease(true);
+        if (!lease) {
+            return nullptr;
+        }
+        stmt = PrepareOn(lease, sql);
+        if (!stmt) {
+            return nullptr;
+        }
+    }
+    
+    BindParameters(stmt, params);
+    
+    if (!lease->As<SqliteConnection>()->IsReadOnly()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = lentWriter_.begin(); it != lentWriter_.end();) {
+            it = it->second.expired() ? lentWriter_.erase(it) : std::next(it);
         }
+        lentWriter_[std::this_thread::get_id()] = lease;
     }
     
-    return std::unique_ptr<ResultSet>(new SqliteResultSet(stmt));
+    return std::unique_ptr<ResultSet>(new SqliteResultSet(stmt, lease));
 }
 
 bool SqliteDatabase::BeginTransaction() {
-    return Execute("BEGIN TRANSACTION");
+    std::shared_ptr<ConnectionLease> lease = AcquireLease(true);
+    if (!lease) {
+        return false;
+    }
+    
+    char* errMsg = nullptr;
+    int result = sqlite3_exec(lease->As<SqliteConnection>()->GetHandle(), "BEGIN TRANSACTION",
+                              nullptr, nullptr, &errMsg);
+    if (result != SQLITE_OK) {
+        SetError(errMsg ? errMsg : "Unknown error", result);
+        LOG_ERROR("SQL execution failed: " + GetLastError());
+        if (errMsg) {
+            sqlite3_free(errMsg);
+        }
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_[std::this_thread::get_id()] = lease;
+    return true;
 }
 
 bool SqliteDatabase::CommitTransaction() {
-    return Execute("COMMIT");
+    bool success = Execute("COMMIT");
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_.erase(std::this_thread::get_id());
+    return success;
 }
 
 bool SqliteDatabase::RollbackTransaction() {
-    return Execute("ROLLBACK");
+    bool success = Execute("ROLLBACK");
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_.erase(std::this_thread::get_id());
+    return success;
 }
 
 std::string SqliteDatabase::GetLastError() const {
+    std::lock_guard<std::mutex> lock(errorMutex_);
     return lastError_;
 }
 
 int SqliteDatabase::GetLastErrorCode() const {
+    std::lock_guard<std::mutex> lock(errorMutex_);
     return lastErrorCode_;
 }
 
+bool SqliteDatabase::GetPoolStats(std::vector<ConnectionPoolStats>& stats) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!writerPool_) {
+        return false;
+    }
+    
+    stats.push_back(writerPool_->GetStats());
+    if (readerPool_) {
+        stats.push_back(readerPool_->GetStats());
+    }
+    return true;
+}
+
 std::unique_ptr<ResultSet> SqliteDatabase::QuerySpatial(
     const std::string& table,
     const BoundingBox& envelope,
     const std::string& geometryColumn) {
     
-    std::ostringstream sql;
-    sql << "SELECT * FROM " << table
-        << " WHERE " << geometryColumn 
-        << " && BuildMbr(?, ?, ?, ?, 4326)";
+    std::string sql = BuildSpatialQuery(table, geometryColumn);
+    if (sql.empty()) {
+        return nullptr;
+    }
+    
+    double bufferX = envelope.Width() * spatialBuffer_;
+    double bufferY = envelope.Height() * spatialBuffer_;
     
+    // Bound in R*Tree order: xmin <= maxX, xmax >= minX, ymin <= maxY, ymax >= minY.
     std::vector<SqlParameter> params = {
-        SqlParameter::Real(envelope.minX),
-        SqlParameter::Real(envelope.minY),
-        SqlParameter::Real(envelope.maxX),
-        SqlParameter::Real(envelope.maxY)
+        SqlParameter::Real(envelope.maxX + bufferX),
+        SqlParameter::Real(envelope.minX - bufferX),
+        SqlParameter::Real(envelope.maxY + bufferY),
+        SqlParameter::Real(envelope.minY - bufferY)
     };
     
-    return Query(sql.str(), params);
+    return Query(sql, params);
 }
 
-bool SqliteDatabase::InitSpatialite() {
-    if (!LoadSpatialiteExtension()) {
+bool SqliteDatabase::HasSpatialIndex(const std::string& table, const std::string& geometryColumn) {
+    auto rs = Query("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = ? COLLATE NOCASE",
+                    {SqlParameter::Text(("idx_" + table + "_" + geometryColumn).c_str())});
+    if (!rs || !rs->Next()) {
         return false;
     }
+    return rs->GetCurrentRow()->GetInt(0) > 0;
+}
+
+std::string SqliteDatabase::BuildSpatialQuery(const std::string& table, const std::string& geometryColumn) {
+    const std::string key = table + "." + geometryColumn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = spatialQueries_.find(key);
+        if (it != spatialQueries_.end()) {
+            return it->second;
+        }
+    }
+    
+    std::ostringstream sql;
+    sql << "SELECT * FROM " << QuoteIdentifier(table) << " WHERE ";
+    
+    // The text is identical for every tile of a layer, so each connection
+    // prepares it once and serves later tiles from its statement cache.
+    if (HasSpatialIndex(table, geometryColumn)) {
+        sql << "ROWID IN (SELECT pkid FROM " << QuoteIdentifier("idx_" + table + "_" + geometryColumn)
+            << " WHERE xmin <= ? AND xmax >= ? AND ymin <= ? AND ymax >= ?)";
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        spatialQueries_[key] = sql.str();
+        return sql.str();
+    }
     
     if (!hasSpatialite_) {
-        return true;
+        SetError("No spatial index on " + key + " and SpatiaLite is not loaded", SQLITE_ERROR);
+        LOG_ERROR("Spatial query failed: " + GetLastError());
+        return std::string();
+    }
+    
+    // Not cached: the layer is picked up by the index path once one is built.
+    LOG_DEBUG("No spatial index on " + key + ", falling back to an MBR scan");
+    sql << "MbrIntersects(" << QuoteIdentifier(geometryColumn)
+        << ", BuildMbr(?2, ?4, ?1, ?3)) = 1";
+    return sql.str();
+}
+
+bool SqliteDatabase::InitSpatialite() {
+    if (!hasSpatialite_) {
+        return false;
     }
     
     return Execute("SELECT InitSpatialMetaData(1)");
 }
 
-bool SqliteDatabase::LoadSpatialiteExtension() {
-    if (!db_) {
+bool SqliteDatabase::LoadSpatialiteExtension(sqlite3* db) {
+    if (!db) {
         return false;
     }
     
-    sqlite3_enable_load_extension(db_, 1);
+    sqlite3_enable_load_extension(db, 1);
     
     const char* extensionPaths[] = {
         "mod_spatialite",
@@ -271,12 +465,11 @@ bool SqliteDatabase::LoadSpatialiteExtension() {
     
     for (int i = 0; extensionPaths[i] != nullptr; ++i) {
         char* errMsg = nullptr;
-        int result = sqlite3_load_extension(db_, extensionPaths[i], nullptr, &errMsg);
+        int result = sqlite3_load_extension(db, extensionPaths[i], nullptr, &errMsg);
         
         if (result == SQLITE_OK) {
-            hasSpatialite_ = true;
-            LOG_INFO("SpatiaLite extension loaded successfully");
-            sqlite3_enable_load_extension(db_, 0);
+            LOG_DEBUG("SpatiaLite extension loaded successfully");
+            sqlite3_enable_load_extension(db, 0);
             return true;
         }
         
@@ -285,17 +478,123 @@ bool SqliteDatabase::LoadSpatialiteExtension() {
         }
     }
     
-    sqlite3_enable_load_extension(db_, 0);
-    LOG_WARN("Failed to load SpatiaLite extension");
+    sqlite3_enable_load_extension(db, 0);
     return false;
 }
 
+bool SqliteDatabase::IsMemoryDatabase() const {
+    return dbPath_.empty() || dbPath_ == ":memory:" ||
+           dbPath_.find("mode=memory") != std::string::npos ||
+           dbPath_.compare(0, 13, "file::memory:") == 0;
+}
+
+std::unique_ptr<PooledConnection> SqliteDatabase::OpenConnection(bool readOnly) {
+    // Each pooled connection is used by one lease holder at a time.
+    int flags = SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI;
+    flags |= readOnly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    
+    sqlite3* db = nullptr;
+    int result = sqlite3_open_v2(dbPath_.c_str(), &db, flags, nullptr);
+    if (result != SQLITE_OK) {
+        SetError(db ? sqlite3_errmsg(db) : "Out of memory", result);
+        LOG_ERROR("Failed to open SQLite connection: " + GetLastError());
+        sqlite3_close(db);
+        return nullptr;
+    }
+    
+    sqlite3_busy_timeout(db, poolOptions_.acquireTimeoutMs);
+    
+    if (!readOnly && !IsMemoryDatabase()) {
+        char* errMsg = nullptr;
+        if (sqlite3_exec(db, "PRAGMA journal_mode=WAL", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            LOG_WARN("Failed to enable WAL mode: " + std::string(errMsg ? errMsg : "unknown error"));
+        }
+        if (errMsg) {
+            sqlite3_free(errMsg);
+        }
+    }
+    
+    if (LoadSpatialiteExtension(db)) {
+        if (!readOnly && !hasSpatialite_.exchange(true)) {
+            LOG_INFO("SpatiaLite extension loaded successfully");
+        }
+    } else if (!readOnly) {
+        LOG_WARN("Failed to load SpatiaLite extension");
+    }
+    
+    return std::unique_ptr<PooledConnection>(
+        new SqliteConnection(db, readOnly, static_cast<size_t>(std::max(0, poolOptions_.statementCacheSize))));
+}
+
+std::shared_ptr<ConnectionLease> SqliteDatabase::AcquireLease(bool write) {
+    std::shared_ptr<DatabaseConnectionPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::thread::id self = std::this_thread::get_id();
+        
+        auto pinned = pinned_.find(self);
+        if (pinned != pinned_.end()) {
+            return pinned->second;
+        }
+        
+        if (!writerPool_) {
+            SetError("Database not open", SQLITE_MISUSE);
+            return nullptr;
+        }
+        
+        pool = (write || !readerPool_) ? writerPool_ : readerPool_;
+        
+        if (pool == writerPool_) {
+            auto lent = lentWriter_.find(self);
+            if (lent != lentWriter_.end()) {
+                if (std::shared_ptr<ConnectionLease> lease = lent->second.lock()) {
+                    return lease;
+                }
+                lentWriter_.erase(lent);
+            }
+        }
+    }
+    
+    ConnectionLease lease = pool->Acquire();
+    if (!lease) {
+        SetError("Timed out waiting for a database connection", SQLITE_BUSY);
+        return nullptr;
+    }
+    
+    return std::make_shared<ConnectionLease>(std::move(lease));
+}
+
+sqlite3_stmt* SqliteDatabase::PrepareOn(std::shared_ptr<ConnectionLease>& lease, const std::string& sql) {
+    SqliteConnection* conn = lease->As<SqliteConnection>();
+    
+    int result = SQLITE_OK;
+    sqlite3_stmt* stmt = conn->PrepareCached(sql, &result);
+    if (!stmt) {
+        SetError(sqlite3_errmsg(conn->GetHandle()), result);
+        LOG_ERROR("Failed to prepare SQL: " + GetLastError());
+    }
+    return stmt;
+}
+
+void SqliteDatabase::SetError(const std::string& message, int code) {
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    lastError_ = message;
+    lastErrorCode_ = code;
+}
+
 SqliteResultSet::SqliteResultSet(sqlite3_stmt* stmt)
     : stmt_(stmt)
     , hasData_(false)
     , rowCount_(0) {
 }
 
+SqliteResultSet::SqliteResultSet(sqlite3_stmt* stmt, std::shared_ptr<ConnectionLease> lease)
+    : stmt_(stmt)
+    , lease_(std::move(lease))
+    , hasData_(false)
+    , rowCount_(0) {
+}
+
 SqliteResultSet::~SqliteResultSet() {
     Close();
 }
@@ -331,9 +630,15 @@ int SqliteResultSet::GetRowCount() const {
 
 void SqliteResultSet::Close() {
     if (stmt_) {
-        sqlite3_finalize(stmt_);
+        if (lease_) {
+            lease_->As<SqliteConnection>()->ReleaseStatement(stmt_);
+        } else {
+            sqlite3_finalize(stmt_);
+        }
         stmt_ = nullptr;
     }
+    lease_.reset();
+    hasData_ = false;
 }
 
 SqliteDatabaseRow::SqliteDatabaseRow(sqlite3_stmt* stmt)
@@ -374,6 +679,13 @@ std::vector<uint8_t> SqliteDatabaseRow::GetBlob(int index) const {
     return std::vector<uint8_t>();
 }
 
+BlobView SqliteDatabaseRow::GetBlobView(int index) const {
+    BlobView view;
+    view.data = static_cast<const uint8_t*>(sqlite3_column_blob(stmt_, index));
+    view.size = view.data ? static_cast<size_t>(sqlite3_column_bytes(stmt_, index)) : 0;
+    return view;
+}
+
 bool SqliteDatabaseRow::IsNull(int index) const {
     return sqlite3_column_type(stmt_, index) == SQLITE_NULL;
 }
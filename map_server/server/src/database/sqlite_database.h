@@ -2,15 +2,60 @@
 #define CYCLE_DATABASE_SQLITE_DATABASE_H
 
 #include "idatabase.h"
+#include "connection_pool.h"
 #include <sqlite3.h>
+#include <atomic>
+#include <list>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace cycle {
 namespace database {
 
+class SqliteConnection : public PooledConnection {
+public:
+    SqliteConnection(sqlite3* db, bool readOnly, size_t statementCacheSize);
+    ~SqliteConnection() override;
+    
+    bool IsHealthy(bool deep) override;
+    
+    sqlite3* GetHandle() const { return db_; }
+    bool IsReadOnly() const { return readOnly_; }
+    
+    // Hands out a reset statement from the per-connection LRU cache, preparing
+    // it on a miss. Every statement returned must go back through ReleaseStatement.
+    sqlite3_stmt* PrepareCached(const std::string& sql, int* errorCode);
+    void ReleaseStatement(sqlite3_stmt* stmt);
+    
+    size_t GetCachedStatementCount() const { return cache_.size(); }
+    
+private:
+    struct CachedStatement {
+        std::string sql;
+        sqlite3_stmt* stmt;
+        bool inUse;
+    };
+    
+    sqlite3* db_;
+    bool readOnly_;
+    size_t capacity_;
+    std::list<CachedStatement> cache_;
+    std::unordered_map<std::string, std::list<CachedStatement>::iterator> bySql_;
+    std::unordered_map<sqlite3_stmt*, std::list<CachedStatement>::iterator> byStmt_;
+};
+
+/**
+ * SQLite behind two pools: a single read-write connection in WAL mode that
+ * serializes writes, and read-only connections that serve queries
+ * concurrently. In-memory databases cannot be shared between connections, so
+ * they run everything on the writer.
+ */
 class SqliteDatabase : public IDatabase {
 public:
-    explicit SqliteDatabase(const std::string& dbPath);
+    explicit SqliteDatabase(const std::string& dbPath,
+                            const ConnectionPoolOptions& poolOptions = ConnectionPoolOptions());
     ~SqliteDatabase() override;
     
     bool Open() override;
@@ -38,21 +83,51 @@ public:
     
     std::string GetDatabaseType() const override { return "sqlite3"; }
     
+    bool GetPoolStats(std::vector<ConnectionPoolStats>& stats) const override;
+    
+    // True when the SpatiaLite R*Tree idx_<table>_<column> exists.
+    bool HasSpatialIndex(const std::string& table, const std::string& geometryColumn);
+    
+    // Grows every QuerySpatial envelope by this fraction of its width and
+    // height so features just outside a tile that still paint into it
+    // (wide strokes, labels, point symbols) are returned too.
+    void SetSpatialQueryBuffer(double ratio) { spatialBuffer_ = ratio; }
+    
 private:
+    std::string BuildSpatialQuery(const std::string& table, const std::string& geometryColumn);
     bool InitSpatialite();
-    bool LoadSpatialiteExtension();
+    bool LoadSpatialiteExtension(sqlite3* db);
+    bool IsMemoryDatabase() const;
+    
+    std::unique_ptr<PooledConnection> OpenConnection(bool readOnly);
+    std::shared_ptr<ConnectionLease> AcquireLease(bool write);
+    sqlite3_stmt* PrepareOn(std::shared_ptr<ConnectionLease>& lease, const std::string& sql);
+    void SetError(const std::string& message, int code);
     
-    sqlite3* db_;
     std::string dbPath_;
-    bool hasSpatialite_;
+    ConnectionPoolOptions poolOptions_;
+    std::shared_ptr<DatabaseConnectionPool> writerPool_;
+    std::shared_ptr<DatabaseConnectionPool> readerPool_;
+    std::atomic<bool> hasSpatialite_;
+    double spatialBuffer_;
+    std::map<std::string, std::string> spatialQueries_;
+    
+    // A transaction pins the writer to the thread that began it; writer leases
+    // lent to open result sets are remembered so the same thread can reuse them
+    // instead of blocking on itself.
+    std::map<std::thread::id, std::shared_ptr<ConnectionLease>> pinned_;
+    std::map<std::thread::id, std::weak_ptr<ConnectionLease>> lentWriter_;
+    mutable std::mutex mutex_;
+    
     std::string lastError_;
     int lastErrorCode_;
-    mutable std::mutex mutex_;
+    mutable std::mutex errorMutex_;
 };
 
 class SqliteResultSet : public ResultSet {
 public:
     explicit SqliteResultSet(sqlite3_stmt* stmt);
+    SqliteResultSet(sqlite3_stmt* stmt, std::shared_ptr<ConnectionLease> lease);
     ~SqliteResultSet() override;
     
     bool Next() override;
@@ -62,6 +137,7 @@ public:
     
 private:
     sqlite3_stmt* stmt_;
+    std::shared_ptr<ConnectionLease> lease_;
     bool hasData_;
     int rowCount_;
 };
@@ -77,6 +153,7 @@ public:
     double GetDouble(int index) const override;
     std::string GetString(int index) const override;
     std::vector<uint8_t> GetBlob(int index) const override;
+    BlobView GetBlobView(int index) const override;
     bool IsNull(int index) const override;
     
 private:
@@ -60,7 +60,7 @@ private:
     
     bool InitializeComponents() {
         LOG_INFO("Initializing database connection");
-        database_ = database::DatabaseFactory::Create(config_.database.type, config_.database.sqlite_path);
+        database_ = database::DatabaseFactory::Create(config_.database);
 
         if (!database_ || !database_->Open()) {
             LOG_ERROR("Failed to initialize database");
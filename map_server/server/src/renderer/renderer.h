@@ -63,6 +63,7 @@ public:
                             int dpi = 96);
     
     void SetDatabase(std::shared_ptr<database::IDatabase> db);
+    std::shared_ptr<database::IDatabase> GetDatabase() const { return database_; }
     void SetEncoder(std::shared_ptr<encoder::IEncoder> encoder);
     void SetCache(std::shared_ptr<cache::MemoryCache> cache);
     
@@ -11,6 +11,7 @@
 #include "../renderer/renderer.h"
 #include "../service/map_service.h"
 #include "../auth/jwt_auth.h"
+#include "../utils/http_cache.h"
 
 #include <httplib.h>
 
@@ -83,6 +84,7 @@ private:
     
     void HandleBatchTiles(const httplib::Request& req, httplib::Response& res);
     void HandleGetBatchStatus(const httplib::Request& req, httplib::Response& res);
+    void HandleCancelBatch(const httplib::Request& req, httplib::Response& res);
     
     bool ParseTileRequest(const httplib::Request& req, 
                          int& z, int& x, int& y,
@@ -90,6 +92,9 @@ private:
     std::string ExtractToken(const httplib::Request& req) const;
     httplib::Server::HandlerResponse ValidateRequest(const httplib::Request& req, httplib::Response& res);
     void AddSecurityHeaders(httplib::Response& res);
+    // stable 为 true 的文档（capabilities、配置）缓存压缩变体；其余每次低级别压缩
+    void SetTextContent(const httplib::Request& req, httplib::Response& res,
+                        const std::string& body, const std::string& content_type, bool stable);
     void LogSecurityEvent(const std::string& event, const httplib::Request& req);
     
     std::string GenerateCapabilitiesXML() const;
@@ -111,7 +116,10 @@ private:
     std::atomic<int> failed_auth_attempts_;
     std::atomic<int> total_requests_;
     std::atomic<int> blocked_requests_;
+    std::atomic<int> not_modified_responses_;
     std::chrono::system_clock::time_point last_security_check_;
+    
+    utils::CompressedVariantCache text_variants_;
 };
 
 } // namespace server
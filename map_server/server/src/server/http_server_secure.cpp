@@ -8,6 +8,77 @@
 namespace cycle {
 namespace server {
 
+namespace {
+
+void ParseBatchRequest(const nlohmann::json& j, service::BatchRequest& batchReq) {
+    if (j.contains("bounds")) {
+        auto bounds = j["bounds"];
+        batchReq.bounds.minX = bounds["minX"];
+        batchReq.bounds.minY = bounds["minY"];
+        batchReq.bounds.maxX = bounds["maxX"];
+        batchReq.bounds.maxY = bounds["maxY"];
+    }
+    
+    // [[lon, lat], ...]
+    if (j.contains("polygon")) {
+        for (const auto& point : j["polygon"]) {
+            batchReq.polygon.emplace_back(point.at(0).get<double>(), point.at(1).get<double>());
+        }
+        if (!j.contains("bounds") && !batchReq.polygon.empty()) {
+            batchReq.bounds = BoundingBox(-180.0, -90.0, 180.0, 90.0);
+        }
+    }
+    
+    if (j.contains("zoom_levels")) {
+        batchReq.zoom_levels.clear();
+        for (const auto& zoom : j["zoom_levels"]) {
+            batchReq.zoom_levels.push_back(zoom);
+        }
+    } else if (j.contains("min_zoom") && j.contains("max_zoom")) {
+        for (int zoom = j["min_zoom"]; zoom <= j["max_zoom"].get<int>(); ++zoom) {
+            batchReq.zoom_levels.push_back(zoom);
+        }
+    }
+    
+    if (j.contains("format")) {
+        batchReq.format = encoder::StringToImageFormat(j["format"]);
+    }
+    
+    if (j.contains("dpi")) {
+        batchReq.dpi = j["dpi"];
+    }
+    
+    batchReq.metatile_size = j.value("metatile_size", 0);
+    batchReq.skip_fresh = j.value("skip_fresh", true);
+    batchReq.async = j.value("async", true);
+}
+
+nlohmann::json BatchStatusToJson(const service::SeedJobStatus& status) {
+    nlohmann::json j;
+    j["batch_id"] = status.id;
+    j["operation"] = "seed";
+    j["status"] = service::SeedJobStateToString(status.state);
+    j["total_tiles"] = status.total_tiles;
+    j["completed_tiles"] = status.ProcessedTiles();
+    j["rendered_tiles"] = status.rendered_tiles;
+    j["skipped_tiles"] = status.skipped_tiles;
+    j["failed_tiles"] = status.failed_tiles;
+    j["total_units"] = status.total_units;
+    j["completed_units"] = status.completed_units;
+    j["current_zoom"] = status.current_zoom;
+    j["progress"] = status.Progress();
+    j["tiles_per_second"] = status.tiles_per_second;
+    j["eta_seconds"] = status.eta_seconds;
+    j["created_at"] = status.created_at;
+    j["updated_at"] = status.updated_at;
+    if (!status.error_message.empty()) {
+        j["error"] = status.error_message;
+    }
+    return j;
+}
+
+} // namespace
+
 HttpServer::HttpServer(const Config& config)
     : config_(config)
     , ssl_enabled_(false)
@@ -16,6 +87,7 @@ HttpServer::HttpServer(const Config& config)
     , failed_auth_attempts_(0)
     , total_requests_(0)
     , blocked_requests_(0)
+    , not_modified_responses_(0)
     , last_security_check_(std::chrono::system_clock::now()) {
     
     SetupRoutes();
@@ -71,6 +143,7 @@ void HttpServer::LogApiUsageExamples() const {
     // Batch Processing
     LOG_INFO("POST /batch/tiles         - Batch tile generation");
     LOG_INFO("GET  /batch/status/{id}   - Get batch status");
+    LOG_INFO("DELETE /batch/status/{id} - Cancel batch");
     
     // Authentication
     LOG_INFO("POST /auth/login          - Login (username, password)");
@@ -299,6 +372,10 @@ void HttpServer::SetupRoutesForServer(httplib::Server& server) {
         HandleGetBatchStatus(req, res);
     });
     
+    server.Delete(R"(/batch/status/(\w+))", [this](const httplib::Request& req, httplib::Response& res) {
+        HandleCancelBatch(req, res);
+    });
+    
     LOG_INFO("HTTP routes configured");
 }
 
@@ -550,6 +627,21 @@ void HttpServer::HandleGetTile(const httplib::Request& req, httplib::Response& r
         dpi = std::stoi(req.get_param_value("dpi"));
     }
     
+    // Revalidation only consults the stored validator; the tile is neither read nor rendered.
+    std::string ifNoneMatch = req.get_header_value("If-None-Match");
+    std::string ifModifiedSince = req.get_header_value("If-Modified-Since");
+    service::TileValidator validator;
+    if ((!ifNoneMatch.empty() || !ifModifiedSince.empty()) &&
+        map_service_->GetTileValidator(z, x, y, imageFormat, dpi, validator) &&
+        utils::IsNotModified(ifNoneMatch, ifModifiedSince, validator.etag, validator.last_modified)) {
+        not_modified_responses_++;
+        res.status = 304;
+        res.set_header("Cache-Control", "max-age=3600");
+        res.set_header("ETag", validator.etag);
+        res.set_header("Last-Modified", utils::FormatHttpDate(validator.last_modified));
+        return;
+    }
+    
     auto result = map_service_->GetTile(z, x, y, imageFormat, dpi);
 
 	LOG_INFO("GetTile ok");
@@ -559,12 +651,22 @@ void HttpServer::HandleGetTile(const httplib::Request& req, httplib::Response& r
         return;
     }
     
+    res.set_header("Cache-Control", "max-age=3600");
+    if (!result.etag.empty()) {
+        res.set_header("ETag", result.etag);
+        res.set_header("Last-Modified", utils::FormatHttpDate(result.last_modified));
+        if (utils::IsNotModified(ifNoneMatch, ifModifiedSince, result.etag, result.last_modified)) {
+            not_modified_responses_++;
+            res.status = 304;
+            return;
+        }
+    }
+    
     res.status = 200;
     res.set_content(reinterpret_cast<const char*>(result.data.data()),
                    result.data.size(),
                    encoder::GetMimeType(imageFormat));
     
-    res.set_header("Cache-Control", "max-age=3600");
     std::string strCache = result.from_cache ? "HIT" : "MISS";
     res.set_header("X-Cache", strCache);
     std::string strTime = std::to_string(result.processing_time) + "ms";
@@ -580,7 +682,7 @@ void HttpServer::HandleGetCapabilities(const httplib::Request& req, httplib::Res
 	res.set_header(strK, strV);
 	strK = "Cache-Control"; strV = "max-age=86400";
 	res.set_header(strK, strV);
-    res.set_content(xml, "application/xml");
+    SetTextContent(req, res, xml, "application/xml", true);
     
     LOG_DEBUG("WMTS Capabilities requested");
 }
@@ -594,7 +696,7 @@ void HttpServer::HandleHealth(const httplib::Request& req, httplib::Response& re
     
     res.status = 200;
     res.set_header("Content-Type", "application/json");
-    res.set_content(j.dump(4), "application/json");
+    SetTextContent(req, res, j.dump(4), "application/json", false);
     
     LOG_DEBUG("Health check requested");
 }
@@ -605,11 +707,20 @@ void HttpServer::HandleMetrics(const httplib::Request& req, httplib::Response& r
     j["requests"]["total"] = total_requests_.load();
     j["requests"]["blocked"] = blocked_requests_.load();
     j["requests"]["active"] = (running_ ? 1 : 0);
+    j["requests"]["not_modified"] = not_modified_responses_.load();
     j["auth"]["failed_attempts"] = failed_auth_attempts_.load();
     
+    utils::CompressedVariantStats variants = text_variants_.GetStats();
+    j["compression"] = {
+        {"variant_hits", variants.hits},
+        {"variant_misses", variants.misses},
+        {"variant_entries", variants.entries},
+        {"variant_bytes", variants.bytes}
+    };
+    
     res.status = 200;
     res.set_header("Content-Type", "application/json");
-    res.set_content(j.dump(4), "application/json");
+    SetTextContent(req, res, j.dump(4), "application/json", false);
     
     LOG_DEBUG("Metrics requested");
 }
@@ -718,37 +829,15 @@ void HttpServer::HandleBatchGenerateTiles(const httplib::Request& req, httplib::
         nlohmann::json j = nlohmann::json::parse(req.body);
         
         service::BatchRequest batchReq;
-        
-        if (j.contains("bounds")) {
-            auto bounds = j["bounds"];
-            batchReq.bounds.minX = bounds["minX"];
-            batchReq.bounds.minY = bounds["minY"];
-            batchReq.bounds.maxX = bounds["maxX"];
-            batchReq.bounds.maxY = bounds["maxY"];
-        }
-        
-        if (j.contains("zoom_levels")) {
-            batchReq.zoom_levels.clear();
-            for (const auto& zoom : j["zoom_levels"]) {
-                batchReq.zoom_levels.push_back(zoom);
-            }
-        }
-        
-        if (j.contains("format")) {
-            batchReq.format = encoder::StringToImageFormat(j["format"]);
-        }
-        
-        if (j.contains("dpi")) {
-            batchReq.dpi = j["dpi"];
-        }
-        
-        batchReq.async = j.value("async", true);
+        ParseBatchRequest(j, batchReq);
         
         auto result = map_service_->BatchGenerateTiles(batchReq);
         
         if (!result.success) {
-            res.status = 500;
-            res.set_content("{\"error\":\"" + result.error_message + "\"}", "application/json");
+            nlohmann::json error;
+            error["error"] = result.error_message;
+            res.status = result.task_id.empty() ? 400 : 500;
+            res.set_content(error.dump(), "application/json");
             return;
         }
         
@@ -788,7 +877,7 @@ void HttpServer::HandleGetConfig(const httplib::Request& req, httplib::Response&
     };
     
     res.status = 200;
-    res.set_content(j.dump(4), "application/json");
+    SetTextContent(req, res, j.dump(4), "application/json", true);
 }
 
 void HttpServer::HandleUpdateConfig(const httplib::Request& req, httplib::Response& res) {
@@ -886,6 +975,12 @@ void HttpServer::HandleClearCache(const httplib::Request& req, httplib::Response
     if (cache_type == "memory" || cache_type == "all") {
         cleared_items = 10000;
         freed_memory = config_.cache.memory_cache_size / 2;
+        
+        // Cleared tiles will be re-rendered, so clients must not be told they are unchanged.
+        if (map_service_) {
+            map_service_->ClearTileValidators();
+        }
+        text_variants_.Clear();
     }
     
     nlohmann::json response;
@@ -1038,13 +1133,31 @@ void HttpServer::HandleBatchTiles(const httplib::Request& req, httplib::Response
     try {
         nlohmann::json j = nlohmann::json::parse(req.body);
         
+        service::BatchRequest batchReq;
+        ParseBatchRequest(j, batchReq);
+        batchReq.async = true;
+        
+        auto result = map_service_->BatchGenerateTiles(batchReq);
+        
+        if (!result.success) {
+            nlohmann::json error;
+            error["error"] = result.error_message;
+            res.status = 400;
+            res.set_content(error.dump(), "application/json");
+            return;
+        }
+        
+        service::SeedJobStatus status;
         nlohmann::json response;
-        response["batch_id"] = "batch_" + std::to_string(std::time(nullptr));
-        response["total_tiles"] = j.value("tiles", nlohmann::json::array()).size();
-        response["completed_tiles"] = 0;
-        response["status"] = "processing";
+        if (map_service_->GetBatchStatus(result.task_id, status)) {
+            response = BatchStatusToJson(status);
+        } else {
+            response["batch_id"] = result.task_id;
+            response["total_tiles"] = result.estimated_tiles;
+        }
+        response["estimated_time"] = result.estimated_time;
         
-        res.status = 200;
+        res.status = 202;
         res.set_content(response.dump(4), "application/json");
         
     } catch (const std::exception& e) {
@@ -1055,18 +1168,50 @@ void HttpServer::HandleBatchTiles(const httplib::Request& req, httplib::Response
 }
 
 void HttpServer::HandleGetBatchStatus(const httplib::Request& req, httplib::Response& res) {
+    if (!map_service_) {
+        res.status = 500;
+        res.set_content("{\"error\":\"MapService not initialized\"}", "application/json");
+        return;
+    }
+    
     std::string batch_id = req.matches[1];
     
-    nlohmann::json response;
-    response["batch_id"] = batch_id;
-    response["operation"] = "generate";
-    response["total_tiles"] = 2;
-    response["completed_tiles"] = 2;
-    response["failed_tiles"] = 0;
-    response["status"] = "completed";
+    service::SeedJobStatus status;
+    if (!map_service_->GetBatchStatus(batch_id, status)) {
+        res.status = 404;
+        res.set_content("{\"error\":\"Batch not found\"}", "application/json");
+        return;
+    }
     
     res.status = 200;
-    res.set_content(response.dump(4), "application/json");
+    SetTextContent(req, res, BatchStatusToJson(status).dump(4), "application/json", false);
+}
+
+void HttpServer::HandleCancelBatch(const httplib::Request& req, httplib::Response& res) {
+    if (!map_service_) {
+        res.status = 500;
+        res.set_content("{\"error\":\"MapService not initialized\"}", "application/json");
+        return;
+    }
+    
+    std::string batch_id = req.matches[1];
+    
+    service::SeedJobStatus status;
+    if (!map_service_->GetBatchStatus(batch_id, status)) {
+        res.status = 404;
+        res.set_content("{\"error\":\"Batch not found\"}", "application/json");
+        return;
+    }
+    
+    if (!map_service_->CancelBatch(batch_id)) {
+        res.status = 409;
+        res.set_content("{\"error\":\"Batch already finished\"}", "application/json");
+        return;
+    }
+    
+    map_service_->GetBatchStatus(batch_id, status);
+    res.status = 200;
+    res.set_content(BatchStatusToJson(status).dump(4), "application/json");
 }
 
 bool HttpServer::ParseTileRequest(const httplib::Request& req, int& z, int& x, int& y, std::string& format) {
@@ -1149,6 +1294,37 @@ void HttpServer::AddSecurityHeaders(httplib::Response& res) {
     res.set_header("Strict-Transport-Security", "max-age=31536000");
 }
 
+void HttpServer::SetTextContent(const httplib::Request& req, httplib::Response& res,
+                                const std::string& body, const std::string& content_type, bool stable) {
+    std::string etag = utils::ComputeETag(body.data(), body.size());
+    utils::ContentEncoding encoding = utils::NegotiateContentEncoding(req.get_header_value("Accept-Encoding"));
+    res.set_header("Vary", "Accept-Encoding");
+    
+    if (utils::ETagMatches(req.get_header_value("If-None-Match"), etag)) {
+        not_modified_responses_++;
+        res.status = 304;
+        res.set_header("ETag", utils::VariantETag(etag, encoding));
+        return;
+    }
+    
+    // Stable bodies are compressed once per encoding and then served from
+    // memory; dynamic ones are compressed cheaply and never cached.
+    auto variant = stable ? text_variants_.Get(body, etag, encoding) : nullptr;
+    std::string compressed;
+    if (variant) {
+        res.set_header("Content-Encoding", utils::ContentEncodingName(encoding));
+        res.set_header("ETag", utils::VariantETag(etag, encoding));
+        res.set_content(*variant, content_type);
+    } else if (!stable && utils::CompressDynamic(encoding, body, compressed)) {
+        res.set_header("Content-Encoding", utils::ContentEncodingName(encoding));
+        res.set_header("ETag", utils::VariantETag(etag, encoding));
+        res.set_content(compressed, content_type);
+    } else {
+        res.set_header("ETag", etag);
+        res.set_content(body, content_type);
+    }
+}
+
 void HttpServer::LogSecurityEvent(const std::string& event, const httplib::Request& req) {
     std::string log_msg = "[SECURITY] " + event + 
                          " - IP: " + req.get_header_value("X-Forwarded-For") +
@@ -1367,6 +1543,38 @@ std::string HttpServer::GenerateMetricsJSON() const {
         };
     }
     
+    std::vector<database::ConnectionPoolStats> pools;
+    std::shared_ptr<database::IDatabase> db = renderer_ ? renderer_->GetDatabase() : nullptr;
+    if (db && db->GetPoolStats(pools)) {
+        nlohmann::json poolsJson = nlohmann::json::array();
+        for (const auto& pool : pools) {
+            poolsJson.push_back({
+                {"name", pool.name},
+                {"max_connections", pool.maxConnections},
+                {"total_connections", pool.totalConnections},
+                {"idle_connections", pool.idleConnections},
+                {"in_use_connections", pool.inUseConnections},
+                {"peak_in_use", pool.peakInUse},
+                {"waiting_requests", pool.waitingRequests},
+                {"acquires", pool.acquireCount},
+                {"waits", pool.waitCount},
+                {"timeouts", pool.timeoutCount},
+                {"created", pool.createdCount},
+                {"destroyed", pool.destroyedCount},
+                {"create_failures", pool.createFailures},
+                {"health_check_failures", pool.healthCheckFailures},
+                {"avg_wait_ms", pool.avgWaitMs},
+                {"max_wait_ms", pool.maxWaitMs},
+                {"utilization", pool.utilization},
+                {"avg_utilization", pool.avgUtilization}
+            });
+        }
+        j["database"] = {
+            {"type", db->GetDatabaseType()},
+            {"pools", poolsJson}
+        };
+    }
+    
     j["system"] = {
         {"memory_usage", 0},
         {"cpu_usage", 0.0},
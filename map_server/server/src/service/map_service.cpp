@@ -1,7 +1,9 @@
 #include "map_service.h"
 #include "../utils/logger.h"
+#include "../utils/http_cache.h"
 #include <chrono>
 #include <algorithm>
+#include <climits>
 #include <cmath>
 
 #ifndef M_PI
@@ -11,12 +13,54 @@
 namespace cycle {
 namespace service {
 
+namespace {
+
+// 校验器只有 ETag 和时间戳，约 100 字节一条
+const size_t kMaxTileValidators = 256 * 1024;
+
+// 估算预生成任务规模：平均每瓦片 16KB，每个种子线程每秒 10 个瓦片
+const uint64_t kSeedTileBytes = 16 * 1024;
+const uint64_t kSeedTilesPerThreadSecond = 10;
+
+// 预生成的瓦片只写入 MemoryCache：单个任务最多占用一半容量，以免挤掉在线瓦片；
+// 并且要在 cache_ttl 内渲染完，否则先渲染的瓦片在任务结束前就已过期
+uint64_t SeedTileLimit(const Config& config, bool hasCache, int threads) {
+    uint64_t limit = config.cache.seed_max_tiles;
+    if (!hasCache || !config.cache.enabled) {
+        return limit;
+    }
+    uint64_t budget = std::max<uint64_t>(1, config.cache.memory_cache_size / 2 / kSeedTileBytes);
+    if (config.cache.cache_ttl > 0) {
+        budget = std::min(budget, static_cast<uint64_t>(config.cache.cache_ttl) * threads * kSeedTilesPerThreadSecond);
+    }
+    return limit == 0 ? budget : std::min(limit, budget);
+}
+
+// 统计正在进行的前台渲染，渲染抛出异常时也会归还计数
+class ForegroundRender {
+public:
+    explicit ForegroundRender(std::atomic<int>& count) : count_(count) { ++count_; }
+    ~ForegroundRender() { --count_; }
+
+    ForegroundRender(const ForegroundRender&) = delete;
+    ForegroundRender& operator=(const ForegroundRender&) = delete;
+
+private:
+    std::atomic<int>& count_;
+};
+
+} // namespace
+
 MapService::MapService(std::shared_ptr<renderer::Renderer> renderer,
                        std::shared_ptr<cache::MemoryCache> cache,
                        const Config& config)
     : renderer_(renderer)
     , cache_(cache)
-    , rate_limiter_(config.server.thread_count * 10, config.server.thread_count * 20) {
+    , rate_limiter_(config.server.thread_count * 10, config.server.thread_count * 20)
+    , foreground_renders_(0)
+    , seed_threads_(std::max(1, config.cache.seed_threads))
+    , cache_ttl_(config.cache.cache_ttl)
+    , running_(true) {
 
    // config_ = (config);
 
@@ -28,14 +72,47 @@ MapService::MapService(std::shared_ptr<renderer::Renderer> renderer,
         LOG_WARN("MapService cache is enabled but no cache instance provided");
     }
     
+    TileSeederOptions seedOptions;
+    seedOptions.threads = seed_threads_;
+    seedOptions.metatile_size = config.cache.seed_metatile_size;
+    seedOptions.max_zoom = config.cache.seed_max_zoom;
+    seedOptions.max_tiles = SeedTileLimit(config, cache_ != nullptr, seed_threads_);
+    if (seedOptions.max_tiles != config.cache.seed_max_tiles) {
+        LOG_INFO("Seed jobs limited to " + std::to_string(seedOptions.max_tiles) +
+                 " tiles to fit the memory cache");
+    }
+    seedOptions.max_finished_jobs = config.cache.seed_max_finished_jobs;
+    // 预生成的瓦片只写入进程内的 MemoryCache，重启后即丢失，
+    // 因此恢复的任务不能信任检查点，需从头开始并重新检查新鲜度
+    seedOptions.durable_output = false;
+    seedOptions.state_dir = config.cache.seed_state_dir;
+    seeder_ = std::make_unique<TileSeeder>(
+        seedOptions,
+        [this](int z, int x, int y, encoder::ImageFormat format, int dpi) {
+            return SeedTile(z, x, y, format, dpi);
+        },
+        [this](int z, int x, int y, encoder::ImageFormat format, int dpi) {
+            return IsTileFresh(z, x, y, format, dpi);
+        },
+        [this]() { return foreground_renders_.load() > 0; });
+    seeder_->Start();
+    
     LOG_INFO("MapService initialized with rate limit: " + 
              std::to_string(config_.server.thread_count * 10) + " req/s");
 }
 
 MapService::~MapService() {
+    Stop();
     LOG_INFO("MapService destroyed");
 }
 
+void MapService::Stop() {
+    running_ = false;
+    if (seeder_) {
+        seeder_->Stop();
+    }
+}
+
 ServiceResult MapService::GetTile(int z, int x, int y, 
                                  encoder::ImageFormat format, int dpi) {
     auto start_time = std::chrono::steady_clock::now();
@@ -204,7 +281,11 @@ ServiceResult MapService::ProcessMapRequest(const MapRequest& request) {
     renderRequest.quality = request.quality;
     renderRequest.dpi = request.dpi;
     
-    auto renderResult = renderer_->RenderMap(renderRequest);
+    renderer::RenderResult renderResult;
+    {
+        ForegroundRender foreground(foreground_renders_);
+        renderResult = renderer_->RenderMap(renderRequest);
+    }
     
     if (!renderResult.success) {
         return ServiceResult::Failure("Rendering failed: " + renderResult.error_message);
@@ -219,17 +300,22 @@ ServiceResult MapService::ProcessMapRequest(const MapRequest& request) {
 
 ServiceResult MapService::ProcessTileRequest(int z, int x, int y, 
                                             encoder::ImageFormat format, int dpi) {
-    std::string cacheKey = "tile_" + std::to_string(z) + "_" + 
-                          std::to_string(x) + "_" + std::to_string(y) + "_" + 
-                          std::to_string(static_cast<int>(format)) + "_" + 
-                          std::to_string(dpi);
+    std::string cacheKey = TileCacheKey(z, x, y, format, dpi);
     
     if (cache_ && config_.cache.enabled) {
         std::vector<uint8_t> cachedData;
         if (cache_->Get(cacheKey, cachedData)) {
             metrics_.cache_hits++;
             LOG_DEBUG("Tile cache hit for key: " + cacheKey);
-            return ServiceResult::Success(cachedData, true);
+            
+            ServiceResult result = ServiceResult::Success(cachedData, true);
+            TileValidator validator;
+            if (!GetTileValidator(z, x, y, format, dpi, validator)) {
+                validator = RecordTileValidator(cacheKey, cachedData);
+            }
+            result.etag = validator.etag;
+            result.last_modified = validator.last_modified;
+            return result;
         }
         metrics_.cache_misses++;
     }
@@ -238,7 +324,11 @@ ServiceResult MapService::ProcessTileRequest(int z, int x, int y,
         return ServiceResult::Failure("Renderer not available");
     }
     
-    auto renderResult = renderer_->RenderTile(z, x, y, format, dpi);
+    renderer::RenderResult renderResult;
+    {
+        ForegroundRender foreground(foreground_renders_);
+        renderResult = renderer_->RenderTile(z, x, y, format, dpi);
+    }
     
     if (!renderResult.success) {
         return ServiceResult::Failure("Tile rendering failed: " + renderResult.error_message);
@@ -248,7 +338,11 @@ ServiceResult MapService::ProcessTileRequest(int z, int x, int y,
         cache_->Put(cacheKey, renderResult.image_data);
     }
     
-    return ServiceResult::Success(renderResult.image_data, false);
+    TileValidator validator = RecordTileValidator(cacheKey, renderResult.image_data);
+    ServiceResult result = ServiceResult::Success(renderResult.image_data, false);
+    result.etag = validator.etag;
+    result.last_modified = validator.last_modified;
+    return result;
 }
 
 bool MapService::CheckRateLimit() {
@@ -273,21 +367,153 @@ TileBounds MapService::GetTileBounds(int z, int x, int y) {
 }
 
 ServiceResult MapService::BatchGenerateTiles(const BatchRequest& request) {
-    // 简化实现：返回任务信息
-    // 实际的批量生成逻辑需要根据业务需求实现
+    if (!renderer_) {
+        return ServiceResult::Failure("Renderer not available");
+    }
+    
+    SeedJobSpec spec;
+    spec.bounds = request.bounds;
+    spec.polygon = request.polygon;
+    spec.zoom_levels = request.zoom_levels;
+    spec.format = request.format;
+    spec.dpi = request.dpi;
+    spec.metatile_size = request.metatile_size;
+    spec.skip_fresh = request.skip_fresh;
+    
+    if (config_.range_limit.enabled) {
+        for (int z : spec.zoom_levels) {
+            if (z > config_.range_limit.max_zoom) {
+                return ServiceResult::Failure("Zoom level exceeds limit: " + std::to_string(z));
+            }
+        }
+    }
+    
+    std::string error;
+    std::string taskId = seeder_->Submit(spec, error);
+    if (taskId.empty()) {
+        return ServiceResult::Failure(error);
+    }
+    
+    SeedJobStatus status;
+    seeder_->GetStatus(taskId, status);
+    
+    // 按已观测的平均渲染耗时估算，尚无数据时按 100ms/瓦片
+    double avgMs = metrics_.GetAverageProcessingTime();
+    if (avgMs <= 0.0) {
+        avgMs = 100.0;
+    }
+    double seconds = status.total_tiles * avgMs / 1000.0 / seed_threads_;
     
     ServiceResult result;
     result.success = true;
-    result.from_cache = false;
-    result.processing_time = 0;
-    
-    // 设置任务信息
-    result.task_id = "batch_" + std::to_string(std::time(nullptr));
-    result.estimated_tiles = 1000; // 示例值
-    result.estimated_time = 300;   // 示例值（秒）
+    result.task_id = taskId;
+    result.estimated_tiles = static_cast<int>(std::min<uint64_t>(status.total_tiles, INT_MAX));
+    result.estimated_time = static_cast<int>(std::min(seconds, static_cast<double>(INT_MAX)));
+    
+    if (!request.async) {
+        seeder_->Wait(taskId, INT_MAX);
+        seeder_->GetStatus(taskId, status);
+        if (status.state != SeedJobState::Completed) {
+            result.success = false;
+            result.error_message = "Batch " + taskId + " " + SeedJobStateToString(status.state);
+        }
+    }
     
     return result;
 }
 
+bool MapService::GetBatchStatus(const std::string& task_id, SeedJobStatus& status) const {
+    return seeder_->GetStatus(task_id, status);
+}
+
+bool MapService::CancelBatch(const std::string& task_id) {
+    return seeder_->Cancel(task_id);
+}
+
+std::vector<SeedJobStatus> MapService::ListBatches() const {
+    return seeder_->ListJobs();
+}
+
+std::string MapService::TileCacheKey(int z, int x, int y, encoder::ImageFormat format, int dpi) {
+    return "tile_" + std::to_string(z) + "_" + 
+           std::to_string(x) + "_" + std::to_string(y) + "_" + 
+           std::to_string(static_cast<int>(format)) + "_" + 
+           std::to_string(dpi);
+}
+
+bool MapService::SeedTile(int z, int x, int y, encoder::ImageFormat format, int dpi) {
+    if (!renderer_) {
+        return false;
+    }
+    
+    auto renderResult = renderer_->RenderTile(z, x, y, format, dpi);
+    if (!renderResult.success) {
+        LOG_WARN("Seed render failed for " + std::to_string(z) + "/" + std::to_string(x) + "/" +
+                 std::to_string(y) + ": " + renderResult.error_message);
+        return false;
+    }
+    
+    // MemoryCache 有容量上限和 TTL，单个任务的规模已由 SeedTileLimit 限制
+    std::string cacheKey = TileCacheKey(z, x, y, format, dpi);
+    if (cache_ && config_.cache.enabled) {
+        cache_->Put(cacheKey, renderResult.image_data);
+    }
+    RecordTileValidator(cacheKey, renderResult.image_data);
+    return true;
+}
+
+bool MapService::IsTileFresh(int z, int x, int y, encoder::ImageFormat format, int dpi) {
+    if (!cache_ || !config_.cache.enabled) {
+        return false;
+    }
+    // MemoryCache 只返回未过期的条目
+    std::vector<uint8_t> cachedData;
+    return cache_->Get(TileCacheKey(z, x, y, format, dpi), cachedData);
+}
+
+bool MapService::GetTileValidator(int z, int x, int y, encoder::ImageFormat format, int dpi,
+                                  TileValidator& validator) const {
+    std::string key = TileCacheKey(z, x, y, format, dpi);
+    std::lock_guard<std::mutex> lock(validators_mutex_);
+    auto it = validators_.find(key);
+    if (it == validators_.end() || it->second.expires <= std::time(nullptr)) {
+        return false;
+    }
+    validator = it->second;
+    return true;
+}
+
+void MapService::ClearTileValidators() {
+    std::lock_guard<std::mutex> lock(validators_mutex_);
+    validators_.clear();
+}
+
+TileValidator MapService::RecordTileValidator(const std::string& key, const std::vector<uint8_t>& data) {
+    TileValidator validator;
+    validator.etag = utils::ComputeETag(data.data(), data.size());
+    validator.last_modified = std::time(nullptr);
+    validator.expires = validator.last_modified + cache_ttl_;
+    
+    std::lock_guard<std::mutex> lock(validators_mutex_);
+    auto it = validators_.find(key);
+    if (it != validators_.end() && it->second.etag == validator.etag) {
+        // 内容未变，保留原 Last-Modified，只延长有效期
+        it->second.expires = validator.expires;
+        return it->second;
+    }
+    
+    if (validators_.size() >= kMaxTileValidators) {
+        for (auto v = validators_.begin(); v != validators_.end();) {
+            v = v->second.expires <= validator.last_modified ? validators_.erase(v) : std::next(v);
+        }
+        if (validators_.size() >= kMaxTileValidators) {
+            validators_.clear();
+        }
+    }
+    
+    validators_[key] = validator;
+    return validator;
+}
+
 } // namespace service
 } // namespace cycle
\ No newline at end of file
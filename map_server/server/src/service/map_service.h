@@ -5,6 +5,7 @@
 #include "../cache/memory_cache.h"
 #include "../encoder/iencoder.h"
 #include "../renderer/renderer.h"
+#include "tile_seeder.h"
 #include <atomic>
 #include <mutex>
 #include <memory>
@@ -13,6 +14,8 @@
 #include <queue>
 #include <chrono>
 #include <cmath>
+#include <ctime>
+#include <unordered_map>
 
 namespace cycle {
 namespace service {
@@ -144,12 +147,17 @@ struct ServiceResult {
     int estimated_tiles;
     int estimated_time;
     
+    // 条件请求校验器（瓦片）
+    std::string etag;
+    std::time_t last_modified;
+    
     ServiceResult()
         : success(false)
         , from_cache(false)
         , processing_time(0)
         , estimated_tiles(0)
-        , estimated_time(0) {}
+        , estimated_time(0)
+        , last_modified(0) {}
     
     static ServiceResult Success(const std::vector<uint8_t>& data, bool from_cache = false) {
         ServiceResult result;
@@ -274,11 +282,23 @@ struct TileBounds {
         : minX(minx), minY(miny), maxX(maxx), maxY(maxy) {}
 };
 
+// 与缓存瓦片一同保存的校验器，用于在不读取瓦片的情况下应答 304
+struct TileValidator {
+    std::string etag;
+    std::time_t last_modified;
+    std::time_t expires;
+    
+    TileValidator() : last_modified(0), expires(0) {}
+};
+
 struct BatchRequest {
     BoundingBox bounds;
+    std::vector<std::pair<double, double>> polygon;
     std::vector<int> zoom_levels;
     encoder::ImageFormat format;
     int dpi;
+    int metatile_size;
+    bool skip_fresh;
     bool async;
     std::string task_id;
     int estimated_tiles;
@@ -287,6 +307,8 @@ struct BatchRequest {
     BatchRequest()
         : format(encoder::ImageFormat::PNG32)
         , dpi(96)
+        , metatile_size(0)
+        , skip_fresh(true)
         , async(true)
         , estimated_tiles(0)
         , estimated_time(0) {}
@@ -306,6 +328,13 @@ public:
     // 新增 API 方法
     TileBounds GetTileBounds(int z, int x, int y);
     ServiceResult BatchGenerateTiles(const BatchRequest& request);
+    bool GetBatchStatus(const std::string& task_id, SeedJobStatus& status) const;
+    bool CancelBatch(const std::string& task_id);
+    std::vector<SeedJobStatus> ListBatches() const;
+    
+    bool GetTileValidator(int z, int x, int y, encoder::ImageFormat format, int dpi,
+                          TileValidator& validator) const;
+    void ClearTileValidators();
     
     const ServiceMetrics& GetMetrics();
     void ResetMetrics();
@@ -314,7 +343,7 @@ public:
     void SetCache(std::shared_ptr<cache::MemoryCache> cache);
     
     bool IsRunning() const { return running_; }
-    void Stop() { running_ = false; }
+    void Stop();
     
 private:
     ServiceResult ProcessMapRequest(const MapRequest& request);
@@ -325,6 +354,11 @@ private:
     bool ValidateMapRequest(const MapRequest& request) const;
     bool CheckRateLimit();
     
+    static std::string TileCacheKey(int z, int x, int y, encoder::ImageFormat format, int dpi);
+    bool SeedTile(int z, int x, int y, encoder::ImageFormat format, int dpi);
+    bool IsTileFresh(int z, int x, int y, encoder::ImageFormat format, int dpi);
+    TileValidator RecordTileValidator(const std::string& key, const std::vector<uint8_t>& data);
+    
     std::shared_ptr<renderer::Renderer> renderer_;
     std::shared_ptr<cache::MemoryCache> cache_;
     Config config_;
@@ -332,6 +366,15 @@ private:
     ServiceMetrics metrics_;
     RateLimiter rate_limiter_;
     
+    // 前台正在渲染的请求数，预生成在其非零时让步
+    std::atomic<int> foreground_renders_;
+    int seed_threads_;
+    std::unique_ptr<TileSeeder> seeder_;
+    
+    int cache_ttl_;
+    std::unordered_map<std::string, TileValidator> validators_;
+    mutable std::mutex validators_mutex_;
+    
     mutable std::mutex mutex_;
     bool running_;
 };
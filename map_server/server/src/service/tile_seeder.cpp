@@ -0,0 +1,1056 @@
+#include "tile_seeder.h"
+#include "../utils/logger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace cycle {
+namespace service {
+
+using json = nlohmann::json;
+
+namespace {
+
+const int kMaxZoom = 30;
+const double kMaxLatitude = 85.0511287798066;
+
+using Ring = std::vector<std::pair<double, double>>;
+
+enum class Coverage {
+    Outside,
+    Partial,
+    Inside
+};
+
+int64_t UnixNow() {
+    return static_cast<int64_t>(std::time(nullptr));
+}
+
+// 种子线程让位于前台请求：Linux 上 nice 只作用于当前线程
+void LowerCurrentThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+bool PointInRing(double x, double y, const Ring& ring) {
+    bool inside = false;
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        double xi = ring[i].first, yi = ring[i].second;
+        double xj = ring[j].first, yj = ring[j].second;
+        if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// Liang-Barsky clip of segment (x0,y0)-(x1,y1) against the rectangle.
+bool SegmentIntersectsRect(double x0, double y0, double x1, double y1, const BoundingBox& r) {
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {x0 - r.minX, r.maxX - x0, y0 - r.minY, r.maxY - y0};
+    double t0 = 0.0;
+    double t1 = 1.0;
+
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) return false;
+            continue;
+        }
+        double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > t1) return false;
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0) return false;
+            t1 = std::min(t1, t);
+        }
+    }
+    return true;
+}
+
+Coverage Classify(const BoundingBox& rect, const Ring& ring) {
+    if (ring.empty()) {
+        return Coverage::Inside;
+    }
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        if (SegmentIntersectsRect(ring[j].first, ring[j].second,
+                                  ring[i].first, ring[i].second, rect)) {
+            return Coverage::Partial;
+        }
+    }
+    // No edge touches the rectangle: it is either wholly inside or wholly outside.
+    double cx = (rect.minX + rect.maxX) * 0.5;
+    double cy = (rect.minY + rect.maxY) * 0.5;
+    return PointInRing(cx, cy, ring) ? Coverage::Inside : Coverage::Outside;
+}
+
+struct TileRange {
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = -1;
+    int y1 = -1;
+};
+
+TileRange RangeForZoom(const BoundingBox& bounds, int z) {
+    TileRange range;
+    range.x0 = TileSeeder::LonToTileX(bounds.minX, z);
+    range.x1 = TileSeeder::LonToTileX(bounds.maxX, z);
+    range.y0 = TileSeeder::LatToTileY(bounds.maxY, z);
+    range.y1 = TileSeeder::LatToTileY(bounds.minY, z);
+    return range;
+}
+
+// Lon/lat extent of tiles [tx0, tx1] x [ty0, ty1].
+BoundingBox TileSpanBounds(int z, int tx0, int ty0, int tx1, int ty1) {
+    BoundingBox a = TileSeeder::TileToBounds(z, tx0, ty0);
+    BoundingBox b = TileSeeder::TileToBounds(z, tx1, ty1);
+    return BoundingBox(a.minX, b.minY, b.maxX, a.maxY);
+}
+
+// Metatile grid of one zoom level. The Hilbert curve runs over a
+// power-of-two grid of side x side metatiles; ordinals of the job are
+// positions on that curve, and cells outside the job are simply skipped.
+struct ZoomPlan {
+    int z = 0;
+    TileRange tiles;
+    int mx0 = 0;
+    int my0 = 0;
+    int mx1 = -1;
+    int my1 = -1;
+    uint32_t side = 1;
+
+    uint64_t Cells() const { return static_cast<uint64_t>(side) * side; }
+};
+
+ZoomPlan PlanZoom(const SeedJobSpec& spec, int z) {
+    const int size = spec.metatile_size;
+    ZoomPlan plan;
+    plan.z = z;
+    plan.tiles = RangeForZoom(spec.bounds, z);
+    plan.mx0 = plan.tiles.x0 / size;
+    plan.my0 = plan.tiles.y0 / size;
+    plan.mx1 = plan.tiles.x1 / size;
+    plan.my1 = plan.tiles.y1 / size;
+    uint64_t metatilesPerAxis = ((1ULL << z) + size - 1) / size;
+    while (plan.side < metatilesPerAxis) {
+        plan.side <<= 1;
+    }
+    return plan;
+}
+
+// The part of the job inside the s x s block of metatiles at (x, y).
+struct Block {
+    int64_t mx0, my0, mx1, my1;
+    TileRange tiles;
+
+    uint64_t Metatiles() const { return static_cast<uint64_t>(mx1 - mx0 + 1) * (my1 - my0 + 1); }
+    uint64_t Tiles() const {
+        return static_cast<uint64_t>(tiles.x1 - tiles.x0 + 1) * (tiles.y1 - tiles.y0 + 1);
+    }
+};
+
+Coverage ClassifyBlock(const SeedJobSpec& spec, const ZoomPlan& plan,
+                       uint32_t x, uint32_t y, uint32_t s, Block& block) {
+    const int64_t size = spec.metatile_size;
+    block.mx0 = std::max<int64_t>(x, plan.mx0);
+    block.my0 = std::max<int64_t>(y, plan.my0);
+    block.mx1 = std::min<int64_t>(static_cast<int64_t>(x) + s - 1, plan.mx1);
+    block.my1 = std::min<int64_t>(static_cast<int64_t>(y) + s - 1, plan.my1);
+    if (block.mx1 < block.mx0 || block.my1 < block.my0) {
+        return Coverage::Outside;
+    }
+    block.tiles.x0 = static_cast<int>(std::max<int64_t>(plan.tiles.x0, block.mx0 * size));
+    block.tiles.y0 = static_cast<int>(std::max<int64_t>(plan.tiles.y0, block.my0 * size));
+    block.tiles.x1 = static_cast<int>(std::min<int64_t>(plan.tiles.x1, block.mx1 * size + size - 1));
+    block.tiles.y1 = static_cast<int>(std::min<int64_t>(plan.tiles.y1, block.my1 * size + size - 1));
+    return Classify(TileSpanBounds(plan.z, block.tiles.x0, block.tiles.y0, block.tiles.x1, block.tiles.y1),
+                    spec.polygon);
+}
+
+// Tiles of [x0, x1] x [y0, y1] that touch the polygon. Only ranges the
+// polygon edge passes through are split further.
+uint64_t CountPolygonTiles(int z, int x0, int y0, int x1, int y1, const Ring& ring) {
+    Coverage coverage = Classify(TileSpanBounds(z, x0, y0, x1, y1), ring);
+    if (coverage == Coverage::Outside) {
+        return 0;
+    }
+    uint64_t area = static_cast<uint64_t>(x1 - x0 + 1) * (y1 - y0 + 1);
+    if (coverage == Coverage::Inside || area == 1) {
+        return area;
+    }
+    if (x1 - x0 >= y1 - y0) {
+        int mid = x0 + (x1 - x0) / 2;
+        return CountPolygonTiles(z, x0, y0, mid, y1, ring) + CountPolygonTiles(z, mid + 1, y0, x1, y1, ring);
+    }
+    int mid = y0 + (y1 - y0) / 2;
+    return CountPolygonTiles(z, x0, y0, x1, mid, ring) + CountPolygonTiles(z, x0, mid + 1, x1, y1, ring);
+}
+
+// Counts the units and tiles of the job in a block of the Hilbert grid.
+void CountBlock(const SeedJobSpec& spec, const ZoomPlan& plan, uint32_t x, uint32_t y, uint32_t s,
+                uint64_t& units, uint64_t& tiles) {
+    Block block;
+    Coverage coverage = ClassifyBlock(spec, plan, x, y, s, block);
+    if (coverage == Coverage::Outside) {
+        return;
+    }
+    if (coverage == Coverage::Inside) {
+        units += block.Metatiles();
+        tiles += block.Tiles();
+        return;
+    }
+    if (s == 1) {
+        // An edge crosses this metatile, so at least one of its tiles is kept.
+        units += 1;
+        tiles += CountPolygonTiles(plan.z, block.tiles.x0, block.tiles.y0, block.tiles.x1, block.tiles.y1,
+                                   spec.polygon);
+        return;
+    }
+    uint32_t h = s / 2;
+    CountBlock(spec, plan, x, y, h, units, tiles);
+    CountBlock(spec, plan, x + h, y, h, units, tiles);
+    CountBlock(spec, plan, x, y + h, h, units, tiles);
+    CountBlock(spec, plan, x + h, y + h, h, units, tiles);
+}
+
+// First Hilbert index at or after `from` whose metatile holds tiles of the
+// job, or plan.Cells() if there is none. Each block of s*s consecutive
+// indices covers an aligned s x s square, so blocks outside the job are
+// skipped whole.
+uint64_t NextCell(const SeedJobSpec& spec, const ZoomPlan& plan, uint64_t from) {
+    uint64_t d = from;
+    while (d < plan.Cells()) {
+        bool found = true;
+        for (uint64_t s = plan.side; s >= 1; s /= 2) {
+            uint64_t cells = s * s;
+            uint64_t start = d - d % cells;
+            uint32_t x = 0;
+            uint32_t y = 0;
+            TileSeeder::HilbertPoint(plan.side, start, x, y);
+            x -= x % s;
+            y -= y % s;
+            Block block;
+            if (ClassifyBlock(spec, plan, x, y, static_cast<uint32_t>(s), block) == Coverage::Outside) {
+                d = start + cells;
+                found = false;
+                break;
+            }
+        }
+        if (found) {
+            return d;
+        }
+    }
+    return plan.Cells();
+}
+
+json SpecToJson(const SeedJobSpec& spec) {
+    json j;
+    j["bounds"] = {
+        {"minX", spec.bounds.minX},
+        {"minY", spec.bounds.minY},
+        {"maxX", spec.bounds.maxX},
+        {"maxY", spec.bounds.maxY}
+    };
+    json polygon = json::array();
+    for (const auto& p : spec.polygon) {
+        polygon.push_back({p.first, p.second});
+    }
+    j["polygon"] = polygon;
+    j["zoom_levels"] = spec.zoom_levels;
+    j["format"] = encoder::ImageFormatToString(spec.format);
+    j["dpi"] = spec.dpi;
+    j["metatile_size"] = spec.metatile_size;
+    j["skip_fresh"] = spec.skip_fresh;
+    return j;
+}
+
+SeedJobSpec SpecFromJson(const json& j) {
+    SeedJobSpec spec;
+    const json& bounds = j.at("bounds");
+    spec.bounds = BoundingBox(bounds.at("minX"), bounds.at("minY"), bounds.at("maxX"), bounds.at("maxY"));
+    for (const auto& p : j.value("polygon", json::array())) {
+        spec.polygon.emplace_back(p.at(0).get<double>(), p.at(1).get<double>());
+    }
+    spec.zoom_levels = j.at("zoom_levels").get<std::vector<int>>();
+    spec.format = encoder::StringToImageFormat(j.value("format", std::string("png32")));
+    spec.dpi = j.value("dpi", 96);
+    spec.metatile_size = j.value("metatile_size", 0);
+    spec.skip_fresh = j.value("skip_fresh", true);
+    return spec;
+}
+
+SeedJobState StateFromString(const std::string& s) {
+    if (s == "running") return SeedJobState::Running;
+    if (s == "completed") return SeedJobState::Completed;
+    if (s == "cancelled") return SeedJobState::Cancelled;
+    if (s == "failed") return SeedJobState::Failed;
+    return SeedJobState::Queued;
+}
+
+} // namespace
+
+struct UnitCounts {
+    uint64_t rendered = 0;
+    uint64_t skipped = 0;
+    uint64_t failed = 0;
+};
+
+struct TileSeeder::Job {
+    std::string id;
+    SeedJobSpec spec;
+    SeedJobState state = SeedJobState::Queued;
+    std::string error;
+    int64_t createdAt = 0;
+    int64_t updatedAt = 0;
+
+    // Ordinal o belongs to zooms[i] when zoomOffsets[i] <= o < zoomOffsets[i + 1]
+    // and names the metatile at Hilbert index o - zoomOffsets[i].
+    std::vector<ZoomPlan> zooms;
+    std::vector<uint64_t> zoomOffsets;
+    uint64_t totalUnits = 0;
+    uint64_t totalTiles = 0;
+
+    // Ordinal of the next unit to hand out, or EndOrdinal() when all have been.
+    uint64_t nextOrdinal = 0;
+    std::set<uint64_t> inFlight;
+
+    // Every unit below Watermark() is done; committed holds their counts.
+    UnitCounts committed;
+    uint64_t committedUnits = 0;
+    std::map<uint64_t, UnitCounts> finishedAhead;
+    uint64_t unitsSinceCheckpoint = 0;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> rendered{0};
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<uint64_t> failed{0};
+
+    std::chrono::steady_clock::time_point runStart;
+    uint64_t runStartProcessed = 0;
+
+    uint64_t Processed() const { return rendered + skipped + failed; }
+    uint64_t EndOrdinal() const { return zoomOffsets.empty() ? 0 : zoomOffsets.back(); }
+    uint64_t Watermark() const { return inFlight.empty() ? nextOrdinal : *inFlight.begin(); }
+    size_t ZoomIndex(uint64_t ordinal) const {
+        return std::upper_bound(zoomOffsets.begin(), zoomOffsets.end(), ordinal) - zoomOffsets.begin() - 1;
+    }
+
+    // First unit at or after `from`, or EndOrdinal().
+    uint64_t FindUnit(uint64_t from) const {
+        for (size_t i = from < EndOrdinal() ? ZoomIndex(from) : zooms.size(); i < zooms.size(); ++i) {
+            uint64_t base = zoomOffsets[i];
+            uint64_t d = NextCell(spec, zooms[i], from > base ? from - base : 0);
+            if (d < zooms[i].Cells()) {
+                return base + d;
+            }
+        }
+        return EndOrdinal();
+    }
+    bool IsActive() const { return state == SeedJobState::Queued || state == SeedJobState::Running; }
+};
+
+const char* SeedJobStateToString(SeedJobState state) {
+    switch (state) {
+        case SeedJobState::Queued:    return "queued";
+        case SeedJobState::Running:   return "running";
+        case SeedJobState::Completed: return "completed";
+        case SeedJobState::Cancelled: return "cancelled";
+        case SeedJobState::Failed:    return "failed";
+        default:                      return "unknown";
+    }
+}
+
+TileSeeder::TileSeeder(const TileSeederOptions& options, RenderTileFn render,
+                       IsFreshFn isFresh, IsBusyFn isBusy)
+    : options_(options)
+    , render_(std::move(render))
+    , isFresh_(std::move(isFresh))
+    , isBusy_(std::move(isBusy))
+    , running_(false)
+    , nextId_(0) {
+    if (options_.threads < 1) options_.threads = 1;
+    if (options_.metatile_size < 1) options_.metatile_size = 1;
+    if (options_.checkpoint_units < 1) options_.checkpoint_units = 1;
+}
+
+TileSeeder::~TileSeeder() {
+    Stop();
+}
+
+bool TileSeeder::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return true;
+    }
+
+    if (!options_.state_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.state_dir, ec);
+        if (ec) {
+            LOG_ERROR("Failed to create seed state directory " + options_.state_dir + ": " + ec.message());
+        } else {
+            LoadPersistedJobsLocked();
+        }
+    }
+
+    running_ = true;
+    for (int i = 0; i < options_.threads; ++i) {
+        workers_.emplace_back(&TileSeeder::WorkerLoop, this);
+    }
+
+    LOG_INFO("TileSeeder started with " + std::to_string(options_.threads) + " threads, " +
+             std::to_string(queue_.size()) + " pending jobs");
+    return true;
+}
+
+void TileSeeder::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    workCv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& job : queue_) {
+        // Units past the watermark are redone on the next Start, so their
+        // counts are dropped along with them.
+        job->nextOrdinal = job->Watermark();
+        job->inFlight.clear();
+        job->finishedAhead.clear();
+        job->rendered = job->committed.rendered;
+        job->skipped = job->committed.skipped;
+        job->failed = job->committed.failed;
+        if (job->state == SeedJobState::Running) {
+            job->state = SeedJobState::Queued;
+            PersistLocked(*job);
+        }
+    }
+    doneCv_.notify_all();
+
+    LOG_INFO("TileSeeder stopped");
+}
+
+std::string TileSeeder::Submit(const SeedJobSpec& spec, std::string& error) {
+    auto job = std::make_shared<Job>();
+    job->spec = spec;
+    if (job->spec.metatile_size <= 0) {
+        job->spec.metatile_size = options_.metatile_size;
+    }
+
+    if (!PrepareJob(*job, error)) {
+        return "";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    do {
+        job->id = "seed_" + std::to_string(UnixNow()) + "_" + std::to_string(++nextId_);
+    } while (jobs_.count(job->id));
+
+    job->createdAt = job->updatedAt = UnixNow();
+    jobs_[job->id] = job;
+
+    if (job->totalUnits == 0) {
+        job->state = SeedJobState::Completed;
+    } else {
+        queue_.push_back(job);
+    }
+    PersistLocked(*job);
+    PruneFinishedLocked();
+
+    LOG_INFO("Seed job " + job->id + " queued: " + std::to_string(job->totalTiles) + " tiles in " +
+             std::to_string(job->totalUnits) + " units");
+
+    workCv_.notify_all();
+    return job->id;
+}
+
+bool TileSeeder::GetStatus(const std::string& id, SeedJobStatus& status) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) {
+        return false;
+    }
+    status = MakeStatusLocked(*it->second);
+    return true;
+}
+
+std::vector<SeedJobStatus> TileSeeder::ListJobs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SeedJobStatus> result;
+    result.reserve(jobs_.size());
+    for (const auto& entry : jobs_) {
+        result.push_back(MakeStatusLocked(*entry.second));
+    }
+    std::sort(result.begin(), result.end(), [](const SeedJobStatus& a, const SeedJobStatus& b) {
+        return a.created_at != b.created_at ? a.created_at < b.created_at : a.id < b.id;
+    });
+    return result;
+}
+
+bool TileSeeder::Cancel(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || !it->second->IsActive()) {
+        return false;
+    }
+
+    Job& job = *it->second;
+    job.cancelled = true;
+    job.state = SeedJobState::Cancelled;
+    job.updatedAt = UnixNow();
+    queue_.erase(std::remove(queue_.begin(), queue_.end(), it->second), queue_.end());
+    PersistLocked(job);
+    doneCv_.notify_all();
+
+    LOG_INFO("Seed job " + id + " cancelled at " + std::to_string(job.Processed()) + "/" +
+             std::to_string(job.totalTiles) + " tiles");
+    PruneFinishedLocked();
+    return true;
+}
+
+bool TileSeeder::Wait(const std::string& id, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) {
+        return false;
+    }
+    std::shared_ptr<Job> job = it->second;
+    return doneCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                            [&] { return !job->IsActive(); });
+}
+
+uint64_t TileSeeder::HilbertIndex(uint32_t order, uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for (uint32_t s = order / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0 ? 1 : 0;
+        uint32_t ry = (y & s) > 0 ? 1 : 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void TileSeeder::HilbertPoint(uint32_t order, uint64_t index, uint32_t& x, uint32_t& y) {
+    x = 0;
+    y = 0;
+    for (uint32_t s = 1; s < order; s *= 2) {
+        uint32_t rx = static_cast<uint32_t>(1 & (index / 2));
+        uint32_t ry = static_cast<uint32_t>(1 & (index ^ rx));
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        index /= 4;
+    }
+}
+
+int TileSeeder::LonToTileX(double lon, int z) {
+    int n = 1 << z;
+    int x = static_cast<int>(std::floor((lon + 180.0) / 360.0 * n));
+    return std::max(0, std::min(n - 1, x));
+}
+
+int TileSeeder::LatToTileY(double lat, int z) {
+    int n = 1 << z;
+    lat = std::max(-kMaxLatitude, std::min(kMaxLatitude, lat));
+    double rad = lat * M_PI / 180.0;
+    int y = static_cast<int>(std::floor((1.0 - std::log(std::tan(rad) + 1.0 / std::cos(rad)) / M_PI) / 2.0 * n));
+    return std::max(0, std::min(n - 1, y));
+}
+
+BoundingBox TileSeeder::TileToBounds(int z, int x, int y) {
+    double n = static_cast<double>(1LL << z);
+    double minLon = x / n * 360.0 - 180.0;
+    double maxLon = (x + 1) / n * 360.0 - 180.0;
+    double maxLat = std::atan(std::sinh(M_PI * (1 - 2 * y / n))) * 180.0 / M_PI;
+    double minLat = std::atan(std::sinh(M_PI * (1 - 2 * (y + 1) / n))) * 180.0 / M_PI;
+    return BoundingBox(minLon, minLat, maxLon, maxLat);
+}
+
+bool TileSeeder::PrepareJob(Job& job, std::string& error) const {
+    SeedJobSpec& spec = job.spec;
+
+    if (!spec.bounds.IsValid()) {
+        error = "Invalid bounds";
+        return false;
+    }
+    if (spec.zoom_levels.empty()) {
+        error = "No zoom levels";
+        return false;
+    }
+    const int maxZoom = std::min(kMaxZoom, options_.max_zoom);
+    for (int z : spec.zoom_levels) {
+        if (z < 0 || z > maxZoom) {
+            error = "Zoom level out of range: " + std::to_string(z) + " (max " + std::to_string(maxZoom) + ")";
+            return false;
+        }
+    }
+    if (!spec.polygon.empty() && spec.polygon.size() < 3) {
+        error = "Polygon needs at least 3 points";
+        return false;
+    }
+    if (spec.metatile_size < 1 || spec.metatile_size > 64) {
+        error = "Metatile size must be between 1 and 64";
+        return false;
+    }
+
+    // The polygon only ever narrows the job; seed its extent when it is the smaller area.
+    if (!spec.polygon.empty()) {
+        BoundingBox extent(spec.polygon[0].first, spec.polygon[0].second,
+                           spec.polygon[0].first, spec.polygon[0].second);
+        for (const auto& p : spec.polygon) {
+            extent.minX = std::min(extent.minX, p.first);
+            extent.minY = std::min(extent.minY, p.second);
+            extent.maxX = std::max(extent.maxX, p.first);
+            extent.maxY = std::max(extent.maxY, p.second);
+        }
+        spec.bounds.minX = std::max(spec.bounds.minX, extent.minX);
+        spec.bounds.minY = std::max(spec.bounds.minY, extent.minY);
+        spec.bounds.maxX = std::min(spec.bounds.maxX, extent.maxX);
+        spec.bounds.maxY = std::min(spec.bounds.maxY, extent.maxY);
+        if (!spec.bounds.IsValid()) {
+            error = "Polygon does not overlap bounds";
+            return false;
+        }
+    }
+
+    std::sort(spec.zoom_levels.begin(), spec.zoom_levels.end());
+    spec.zoom_levels.erase(std::unique(spec.zoom_levels.begin(), spec.zoom_levels.end()),
+                           spec.zoom_levels.end());
+
+    job.zooms.clear();
+    job.zoomOffsets.assign(1, 0);
+    uint64_t boundsTiles = 0;
+    for (int z : spec.zoom_levels) {
+        ZoomPlan plan = PlanZoom(spec, z);
+        boundsTiles += static_cast<uint64_t>(plan.tiles.x1 - plan.tiles.x0 + 1) *
+                       (plan.tiles.y1 - plan.tiles.y0 + 1);
+        job.zoomOffsets.push_back(job.zoomOffsets.back() + plan.Cells());
+        job.zooms.push_back(plan);
+    }
+    if (options_.max_tiles > 0 && boundsTiles > options_.max_tiles) {
+        error = "Job covers " + std::to_string(boundsTiles) + " tiles, more than the limit of " +
+                std::to_string(options_.max_tiles);
+        return false;
+    }
+
+    job.totalUnits = 0;
+    job.totalTiles = 0;
+    for (const ZoomPlan& plan : job.zooms) {
+        CountBlock(spec, plan, 0, 0, plan.side, job.totalUnits, job.totalTiles);
+    }
+    job.nextOrdinal = job.FindUnit(0);
+    return true;
+}
+
+bool TileSeeder::NextUnitLocked(WorkUnit& unit) {
+    for (const auto& job : queue_) {
+        if (!job->IsActive() || job->nextOrdinal >= job->EndOrdinal()) {
+            continue;
+        }
+
+        if (job->state == SeedJobState::Queued) {
+            job->state = SeedJobState::Running;
+            job->runStart = std::chrono::steady_clock::now();
+            job->runStartProcessed = job->Processed();
+            job->updatedAt = UnixNow();
+            LOG_INFO("Seed job " + job->id + " running from unit " + std::to_string(job->committedUnits) +
+                     "/" + std::to_string(job->totalUnits));
+        }
+
+        size_t zoomIndex = job->ZoomIndex(job->nextOrdinal);
+        const ZoomPlan& plan = job->zooms[zoomIndex];
+        uint32_t mx = 0;
+        uint32_t my = 0;
+        HilbertPoint(plan.side, job->nextOrdinal - job->zoomOffsets[zoomIndex], mx, my);
+        unit.job = job;
+        unit.ordinal = job->nextOrdinal;
+        unit.z = plan.z;
+        unit.mx = static_cast<int>(mx);
+        unit.my = static_cast<int>(my);
+        job->inFlight.insert(unit.ordinal);
+        job->nextOrdinal = job->FindUnit(unit.ordinal + 1);
+        return true;
+    }
+    return false;
+}
+
+void TileSeeder::CompleteUnitLocked(const WorkUnit& unit) {
+    Job& job = *unit.job;
+    job.updatedAt = UnixNow();
+
+    if (!job.IsActive()) {
+        return;
+    }
+
+    uint64_t watermark = job.Watermark();
+    while (!job.finishedAhead.empty() && job.finishedAhead.begin()->first < watermark) {
+        const UnitCounts& counts = job.finishedAhead.begin()->second;
+        job.committed.rendered += counts.rendered;
+        job.committed.skipped += counts.skipped;
+        job.committed.failed += counts.failed;
+        job.committedUnits++;
+        job.finishedAhead.erase(job.finishedAhead.begin());
+    }
+
+    if (watermark == job.EndOrdinal()) {
+        job.state = SeedJobState::Completed;
+        queue_.erase(std::remove(queue_.begin(), queue_.end(), unit.job), queue_.end());
+        PersistLocked(job);
+        doneCv_.notify_all();
+        LOG_INFO("Seed job " + job.id + " completed: " + std::to_string(job.rendered.load()) + " rendered, " +
+                 std::to_string(job.skipped.load()) + " skipped, " + std::to_string(job.failed.load()) + " failed");
+        PruneFinishedLocked();
+        return;
+    }
+
+    if (++job.unitsSinceCheckpoint >= static_cast<uint64_t>(options_.checkpoint_units)) {
+        PersistLocked(job);
+    }
+}
+
+void TileSeeder::WaitForIdleForeground(const Job& job) {
+    if (!isBusy_ || options_.max_yield_ms <= 0) {
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.max_yield_ms);
+    while (running_ && !job.cancelled && isBusy_() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void TileSeeder::ProcessUnit(const WorkUnit& unit) {
+    Job& job = *unit.job;
+    const SeedJobSpec& spec = job.spec;
+    const int size = spec.metatile_size;
+
+    const TileRange& range = job.zooms[job.ZoomIndex(unit.ordinal)].tiles;
+    int tx0 = std::max(range.x0, unit.mx * size);
+    int ty0 = std::max(range.y0, unit.my * size);
+    int tx1 = std::min(range.x1, unit.mx * size + size - 1);
+    int ty1 = std::min(range.y1, unit.my * size + size - 1);
+    bool clip = Classify(TileSpanBounds(unit.z, tx0, ty0, tx1, ty1), spec.polygon) == Coverage::Partial;
+
+    UnitCounts counts;
+    bool finished = true;
+    for (int ty = ty0; ty <= ty1 && finished; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            if (!running_ || job.cancelled) {
+                finished = false;
+                break;
+            }
+            if (clip && Classify(TileToBounds(unit.z, tx, ty), spec.polygon) == Coverage::Outside) {
+                continue;
+            }
+
+            if (spec.skip_fresh && isFresh_ && isFresh_(unit.z, tx, ty, spec.format, spec.dpi)) {
+                counts.skipped++;
+                job.skipped++;
+                continue;
+            }
+
+            WaitForIdleForeground(job);
+
+            if (render_(unit.z, tx, ty, spec.format, spec.dpi)) {
+                counts.rendered++;
+                job.rendered++;
+            } else {
+                counts.failed++;
+                job.failed++;
+            }
+        }
+    }
+
+    // An unfinished unit stays in flight so the watermark cannot pass it;
+    // Stop resets the job to the watermark.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished) {
+        job.inFlight.erase(unit.ordinal);
+        job.finishedAhead[unit.ordinal] = counts;
+        CompleteUnitLocked(unit);
+    }
+}
+
+void TileSeeder::WorkerLoop() {
+    LowerCurrentThreadPriority();
+
+    while (true) {
+        WorkUnit unit;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workCv_.wait(lock, [&] { return !running_ || NextUnitLocked(unit); });
+            if (!running_) {
+                break;
+            }
+        }
+
+        try {
+            ProcessUnit(unit);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Seed job " + unit.job->id + " failed: " + e.what());
+            std::lock_guard<std::mutex> lock(mutex_);
+            Job& job = *unit.job;
+            job.inFlight.erase(unit.ordinal);
+            if (job.IsActive()) {
+                job.state = SeedJobState::Failed;
+                job.error = e.what();
+                job.cancelled = true;
+                job.updatedAt = UnixNow();
+                queue_.erase(std::remove(queue_.begin(), queue_.end(), unit.job), queue_.end());
+                PersistLocked(job);
+                doneCv_.notify_all();
+                PruneFinishedLocked();
+            }
+        }
+    }
+}
+
+SeedJobStatus TileSeeder::MakeStatusLocked(const Job& job) const {
+    SeedJobStatus status;
+    status.id = job.id;
+    status.state = job.state;
+    status.total_tiles = job.totalTiles;
+    status.rendered_tiles = job.rendered;
+    status.skipped_tiles = job.skipped;
+    status.failed_tiles = job.failed;
+    status.total_units = job.totalUnits;
+    status.completed_units = job.state == SeedJobState::Completed
+        ? job.totalUnits : job.committedUnits + job.finishedAhead.size();
+    status.created_at = job.createdAt;
+    status.updated_at = job.updatedAt;
+    status.error_message = job.error;
+
+    if (job.state != SeedJobState::Queued && job.EndOrdinal() > 0) {
+        uint64_t at = std::min(job.Watermark(), job.EndOrdinal() - 1);
+        status.current_zoom = job.zooms[job.ZoomIndex(at)].z;
+    }
+
+    if (job.state == SeedJobState::Running) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.runStart).count();
+        uint64_t processed = job.Processed() - job.runStartProcessed;
+        if (elapsed > 0.0 && processed > 0) {
+            status.tiles_per_second = processed / elapsed;
+            uint64_t remaining = job.totalTiles > job.Processed() ? job.totalTiles - job.Processed() : 0;
+            status.eta_seconds = static_cast<int64_t>(remaining / status.tiles_per_second);
+        }
+    } else if (!job.IsActive()) {
+        status.eta_seconds = 0;
+    }
+    return status;
+}
+
+std::string TileSeeder::JobPath(const std::string& id) const {
+    return (std::filesystem::path(options_.state_dir) / (id + ".json")).string();
+}
+
+void TileSeeder::PersistLocked(Job& job) {
+    job.unitsSinceCheckpoint = 0;
+    if (options_.state_dir.empty()) {
+        return;
+    }
+
+    json j;
+    j["id"] = job.id;
+    j["state"] = SeedJobStateToString(job.state);
+    j["error"] = job.error;
+    j["created_at"] = job.createdAt;
+    j["updated_at"] = job.updatedAt;
+    j["spec"] = SpecToJson(job.spec);
+    j["total_tiles"] = job.totalTiles;
+    j["total_units"] = job.totalUnits;
+    // Only progress below the watermark survives a restart.
+    bool done = !job.IsActive();
+    j["watermark"] = job.Watermark();
+    j["completed_units"] = done ? job.totalUnits : job.committedUnits;
+    j["rendered_tiles"] = done ? job.rendered.load() : job.committed.rendered;
+    j["skipped_tiles"] = done ? job.skipped.load() : job.committed.skipped;
+    j["failed_tiles"] = done ? job.failed.load() : job.committed.failed;
+
+    std::string path = JobPath(job.id);
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file.is_open()) {
+            LOG_ERROR("Failed to write seed job state: " + tmpPath);
+            return;
+        }
+        file << j.dump(2);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        LOG_ERROR("Failed to persist seed job " + job.id + ": " + ec.message());
+    }
+}
+
+void TileSeeder::LoadPersistedJobsLocked() {
+    struct Saved {
+        std::filesystem::path path;
+        json state;
+        bool finished;
+        int64_t updatedAt;
+    };
+    std::vector<Saved> saved;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(options_.state_dir, ec)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+        try {
+            std::ifstream file(entry.path());
+            json j = json::parse(file);
+            SeedJobState state = StateFromString(j.value("state", std::string("queued")));
+            int64_t updatedAt = j.value("updated_at", j.value("created_at", static_cast<int64_t>(0)));
+            bool finished = state != SeedJobState::Queued && state != SeedJobState::Running;
+            saved.push_back({entry.path(), std::move(j), finished, updatedAt});
+        } catch (const std::exception& e) {
+            LOG_WARN("Failed to load seed job state " + entry.path().string() + ": " + e.what());
+        }
+    }
+
+    // Finished jobs past the retention limit are dropped before they are
+    // prepared, so old state files cost nothing on the next start.
+    std::sort(saved.begin(), saved.end(), [](const Saved& a, const Saved& b) {
+        return a.updatedAt != b.updatedAt ? a.updatedAt > b.updatedAt : a.path > b.path;
+    });
+    size_t keptFinished = 0;
+
+    for (const Saved& entry : saved) {
+        const json& j = entry.state;
+        try {
+            if (entry.finished && options_.max_finished_jobs > 0 &&
+                keptFinished++ >= static_cast<size_t>(options_.max_finished_jobs)) {
+                std::filesystem::remove(entry.path, ec);
+                continue;
+            }
+
+            auto job = std::make_shared<Job>();
+            job->id = j.at("id");
+            job->spec = SpecFromJson(j.at("spec"));
+            job->state = StateFromString(j.value("state", std::string("queued")));
+            job->error = j.value("error", std::string());
+            job->createdAt = j.value("created_at", static_cast<int64_t>(0));
+            job->updatedAt = j.value("updated_at", job->createdAt);
+
+            std::string error;
+            if (!PrepareJob(*job, error)) {
+                LOG_WARN("Ignoring seed job " + job->id + ": " + error);
+                continue;
+            }
+
+            // Tiles rendered before the restart are gone unless the output is durable.
+            bool keepProgress = options_.durable_output || !job->IsActive();
+            if (keepProgress) {
+                job->committedUnits = j.value("completed_units", static_cast<uint64_t>(0));
+                job->committed.rendered = j.value("rendered_tiles", static_cast<uint64_t>(0));
+                job->committed.skipped = j.value("skipped_tiles", static_cast<uint64_t>(0));
+                job->committed.failed = j.value("failed_tiles", static_cast<uint64_t>(0));
+            }
+            uint64_t watermark = keepProgress
+                ? std::min(j.value("watermark", static_cast<uint64_t>(0)), job->EndOrdinal()) : 0;
+            job->rendered = job->committed.rendered;
+            job->skipped = job->committed.skipped;
+            job->failed = job->committed.failed;
+            job->nextOrdinal = job->FindUnit(watermark);
+            job->cancelled = !job->IsActive();
+
+            if (job->IsActive() && job->nextOrdinal == job->EndOrdinal()) {
+                job->state = SeedJobState::Completed;
+                job->cancelled = true;
+            }
+
+            jobs_[job->id] = job;
+            if (job->IsActive()) {
+                job->state = SeedJobState::Queued;
+                queue_.push_back(job);
+                LOG_INFO("Resuming seed job " + job->id + " at unit " + std::to_string(job->committedUnits) +
+                         "/" + std::to_string(job->totalUnits));
+            }
+        } catch (const std::exception& e) {
+            LOG_WARN("Failed to load seed job state " + entry.path.string() + ": " + e.what());
+        }
+    }
+
+    std::sort(queue_.begin(), queue_.end(), [](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+        return a->createdAt < b->createdAt;
+    });
+    PruneFinishedLocked();
+}
+
+void TileSeeder::PruneFinishedLocked() {
+    if (options_.max_finished_jobs <= 0) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Job>> finished;
+    for (const auto& entry : jobs_) {
+        if (!entry.second->IsActive()) {
+            finished.push_back(entry.second);
+        }
+    }
+    if (finished.size() <= static_cast<size_t>(options_.max_finished_jobs)) {
+        return;
+    }
+
+    std::sort(finished.begin(), finished.end(), [](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+        return a->updatedAt != b->updatedAt ? a->updatedAt < b->updatedAt : a->id < b->id;
+    });
+    size_t excess = finished.size() - options_.max_finished_jobs;
+    for (size_t i = 0; i < excess; ++i) {
+        jobs_.erase(finished[i]->id);
+        if (!options_.state_dir.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(JobPath(finished[i]->id), ec);
+        }
+    }
+}
+
+} // namespace service
+} // namespace cycle
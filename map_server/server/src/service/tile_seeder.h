@@ -0,0 +1,168 @@
+#ifndef CYCLE_SERVICE_TILE_SEEDER_H
+#define CYCLE_SERVICE_TILE_SEEDER_H
+
+#include "../config/config.h"
+#include "../encoder/iencoder.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cycle {
+namespace service {
+
+struct SeedJobSpec {
+    BoundingBox bounds;                                 // 经纬度
+    std::vector<std::pair<double, double>> polygon;     // 可选，(lon, lat) 外环，进一步裁剪 bounds
+    std::vector<int> zoom_levels;
+    encoder::ImageFormat format = encoder::ImageFormat::PNG32;
+    int dpi = 96;
+    int metatile_size = 0;                              // 0 使用 TileSeederOptions::metatile_size
+    bool skip_fresh = true;
+};
+
+enum class SeedJobState {
+    Queued,
+    Running,
+    Completed,
+    Cancelled,
+    Failed
+};
+
+const char* SeedJobStateToString(SeedJobState state);
+
+struct SeedJobStatus {
+    std::string id;
+    SeedJobState state = SeedJobState::Queued;
+    uint64_t total_tiles = 0;
+    uint64_t rendered_tiles = 0;
+    uint64_t skipped_tiles = 0;
+    uint64_t failed_tiles = 0;
+    uint64_t total_units = 0;
+    uint64_t completed_units = 0;
+    int current_zoom = -1;
+    double tiles_per_second = 0.0;
+    int64_t eta_seconds = -1;
+    int64_t created_at = 0;
+    int64_t updated_at = 0;
+    std::string error_message;
+
+    uint64_t ProcessedTiles() const { return rendered_tiles + skipped_tiles + failed_tiles; }
+    double Progress() const {
+        return total_tiles == 0 ? 1.0 : static_cast<double>(ProcessedTiles()) / total_tiles;
+    }
+};
+
+struct TileSeederOptions {
+    int threads = 2;
+    int metatile_size = 8;
+    std::string state_dir;          // 为空时不持久化
+    int max_yield_ms = 1000;        // 前台繁忙时单个瓦片最多让出的时间
+    int checkpoint_units = 16;
+    int max_zoom = 20;
+    uint64_t max_tiles = 50000000;  // 按 bounds 计的瓦片总数上限，0 不限制
+    int max_finished_jobs = 256;    // 保留的已结束任务数（含状态文件），超出时删除最早结束的，0 不限制
+    bool durable_output = true;     // 渲染结果能否跨进程保留；否则恢复的任务从头开始，靠 skip_fresh 跳过仍在的瓦片
+};
+
+/**
+ * Background tile seeding.
+ *
+ * A job covers a bbox (optionally clipped by a polygon) over a set of zoom
+ * levels. Each zoom is cut into metatile-sized work units visited in Hilbert
+ * order so consecutive units touch neighbouring data. Units are rendered on a
+ * small pool of low-priority threads that back off while live requests are in
+ * flight. Progress is checkpointed as the highest contiguous unit finished,
+ * so a restarted server resumes a job where it left off. That only holds when
+rendered tiles outlive the process; without durable_output a resumed job
+starts over and relies on the freshness check instead.
+ *
+ * Units are never listed up front: the next one is found by walking the
+ * Hilbert curve and skipping whole quadrants outside the job, and totals are
+ * counted per quadrant, so the cost follows the job's outline rather than its
+ * area. Jobs above max_zoom or max_tiles are rejected. Only the newest
+ * max_finished_jobs finished jobs are kept; older ones are forgotten along
+ * with their state files.
+ */
+class TileSeeder {
+public:
+    using RenderTileFn = std::function<bool(int z, int x, int y, encoder::ImageFormat format, int dpi)>;
+    using IsFreshFn = std::function<bool(int z, int x, int y, encoder::ImageFormat format, int dpi)>;
+    using IsBusyFn = std::function<bool()>;
+
+    TileSeeder(const TileSeederOptions& options, RenderTileFn render,
+               IsFreshFn isFresh = nullptr, IsBusyFn isBusy = nullptr);
+    ~TileSeeder();
+
+    // Loads persisted jobs, requeues unfinished ones and starts the workers.
+    bool Start();
+    // Checkpoints running jobs and stops the workers; they resume on the next Start.
+    void Stop();
+
+    // Returns the job id, or an empty string with error set.
+    std::string Submit(const SeedJobSpec& spec, std::string& error);
+    bool GetStatus(const std::string& id, SeedJobStatus& status) const;
+    std::vector<SeedJobStatus> ListJobs() const;
+    bool Cancel(const std::string& id);
+    // Waits until the job leaves Queued/Running; false on timeout or unknown id.
+    bool Wait(const std::string& id, int timeoutMs);
+
+    static uint64_t HilbertIndex(uint32_t order, uint32_t x, uint32_t y);
+    static void HilbertPoint(uint32_t order, uint64_t index, uint32_t& x, uint32_t& y);
+    static int LonToTileX(double lon, int z);
+    static int LatToTileY(double lat, int z);
+    static BoundingBox TileToBounds(int z, int x, int y);
+
+private:
+    struct Job;
+    struct WorkUnit {
+        std::shared_ptr<Job> job;
+        uint64_t ordinal = 0;
+        int z = 0;
+        int mx = 0;
+        int my = 0;
+    };
+
+    TileSeeder(const TileSeeder&) = delete;
+    TileSeeder& operator=(const TileSeeder&) = delete;
+
+    bool PrepareJob(Job& job, std::string& error) const;
+    bool NextUnitLocked(WorkUnit& unit);
+    void CompleteUnitLocked(const WorkUnit& unit);
+    void ProcessUnit(const WorkUnit& unit);
+    void WaitForIdleForeground(const Job& job);
+    SeedJobStatus MakeStatusLocked(const Job& job) const;
+
+    void PersistLocked(Job& job);
+    void LoadPersistedJobsLocked();
+    void PruneFinishedLocked();
+    std::string JobPath(const std::string& id) const;
+
+    void WorkerLoop();
+
+    TileSeederOptions options_;
+    RenderTileFn render_;
+    IsFreshFn isFresh_;
+    IsBusyFn isBusy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable workCv_;
+    std::condition_variable doneCv_;
+    std::map<std::string, std::shared_ptr<Job>> jobs_;
+    std::vector<std::shared_ptr<Job>> queue_;   // 按提交顺序
+    std::vector<std::thread> workers_;
+    std::atomic<bool> running_;
+    uint64_t nextId_;
+};
+
+} // namespace service
+} // namespace cycle
+
+#endif // CYCLE_SERVICE_TILE_SEEDER_H
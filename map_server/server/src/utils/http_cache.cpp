@@ -0,0 +1,383 @@
+#include "http_cache.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace cycle {
+namespace utils {
+
+namespace {
+
+const char* const kWeekdays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                               "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// 与平台无关的公历日期换算，避免 gmtime/timegm 的线程安全和可移植性问题
+int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void CivilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+int MonthIndex(const char* name) {
+    for (int i = 0; i < 12; ++i) {
+        if (std::strncmp(name, kMonths[i], 3) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+std::string Trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+// Opaque tag without W/ prefix, quotes or a compressed-variant suffix.
+std::string NormalizeETag(std::string tag) {
+    tag = Trim(tag);
+    if (tag.compare(0, 2, "W/") == 0) {
+        tag = tag.substr(2);
+    }
+    if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"') {
+        tag = tag.substr(1, tag.size() - 2);
+    }
+    for (const char* suffix : {"-gzip", "-br"}) {
+        size_t len = std::strlen(suffix);
+        if (tag.size() > len && tag.compare(tag.size() - len, len, suffix) == 0) {
+            tag.erase(tag.size() - len);
+            break;
+        }
+    }
+    return tag;
+}
+
+bool CompressGzip(const std::string& input, std::string& output, CompressionLevel level) {
+#ifdef HAVE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    int zlevel = level == CompressionLevel::Fast ? Z_BEST_SPEED : Z_BEST_COMPRESSION;
+    // windowBits 15 + 16 写出 gzip 头
+    if (deflateInit2(&stream, zlevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int ret = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+#else
+    (void)input;
+    (void)output;
+    (void)level;
+    return false;
+#endif
+}
+
+bool CompressBrotli(const std::string& input, std::string& output, CompressionLevel level) {
+#ifdef HAVE_BROTLI
+    size_t size = BrotliEncoderMaxCompressedSize(input.size());
+    if (size == 0) {
+        return false;
+    }
+    output.resize(size);
+    // 缓存的变体只压缩一次，用 9 级；动态文档每次都要压缩，4 级已能拿到大部分收益
+    int quality = level == CompressionLevel::Fast ? 4 : 9;
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               input.size(), reinterpret_cast<const uint8_t*>(input.data()),
+                               &size, reinterpret_cast<uint8_t*>(&output[0]))) {
+        return false;
+    }
+    output.resize(size);
+    return true;
+#else
+    (void)input;
+    (void)output;
+    (void)level;
+    return false;
+#endif
+}
+
+bool EncodingAvailable(ContentEncoding encoding) {
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case ContentEncoding::Gzip:     return true;
+#endif
+#ifdef HAVE_BROTLI
+        case ContentEncoding::Brotli:   return true;
+#endif
+        case ContentEncoding::Identity: return true;
+        default:                        return false;
+    }
+}
+
+} // namespace
+
+std::string ComputeETag(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "\"%016llx-%llx\"",
+                  static_cast<unsigned long long>(hash), static_cast<unsigned long long>(size));
+    return buf;
+}
+
+std::string FormatHttpDate(std::time_t time) {
+    int64_t t = static_cast<int64_t>(time);
+    int64_t days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+    int64_t secs = t - days * 86400;
+
+    int64_t year;
+    unsigned month, day;
+    CivilFromDays(days, year, month, day);
+    int weekday = static_cast<int>((days % 7 + 11) % 7);  // 1970-01-01 是周四
+
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%s, %02u %s %04lld %02d:%02d:%02d GMT",
+                  kWeekdays[weekday], day, kMonths[month - 1], static_cast<long long>(year),
+                  static_cast<int>(secs / 3600), static_cast<int>(secs / 60 % 60), static_cast<int>(secs % 60));
+    return buf;
+}
+
+bool ParseHttpDate(const std::string& value, std::time_t& time) {
+    char weekday[16] = {0};
+    char month[4] = {0};
+    int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+
+    // IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+    if (std::sscanf(value.c_str(), "%15[A-Za-z], %d %3s %d %d:%d:%d GMT",
+                    weekday, &day, month, &year, &hour, &minute, &second) != 7) {
+        // RFC 850: Sunday, 06-Nov-94 08:49:37 GMT
+        if (std::sscanf(value.c_str(), "%15[A-Za-z], %d-%3s-%d %d:%d:%d GMT",
+                        weekday, &day, month, &year, &hour, &minute, &second) != 7) {
+            return false;
+        }
+        year += year < 70 ? 2000 : (year < 100 ? 1900 : 0);
+    }
+
+    int monthIndex = MonthIndex(month);
+    if (monthIndex < 0 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    int64_t days = DaysFromCivil(year, static_cast<unsigned>(monthIndex + 1), static_cast<unsigned>(day));
+    time = static_cast<std::time_t>(days * 86400 + hour * 3600 + minute * 60 + second);
+    return true;
+}
+
+bool ETagMatches(const std::string& if_none_match, const std::string& etag) {
+    std::string target = NormalizeETag(etag);
+    size_t start = 0;
+    while (start <= if_none_match.size()) {
+        size_t comma = if_none_match.find(',', start);
+        std::string tag = Trim(if_none_match.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (tag == "*" || (!tag.empty() && NormalizeETag(tag) == target)) {
+            return true;
+        }
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return false;
+}
+
+bool IsNotModified(const std::string& if_none_match, const std::string& if_modified_since,
+                   const std::string& etag, std::time_t last_modified) {
+    if (!if_none_match.empty()) {
+        return !etag.empty() && ETagMatches(if_none_match, etag);
+    }
+
+    std::time_t since;
+    if (!if_modified_since.empty() && last_modified > 0 && ParseHttpDate(if_modified_since, since)) {
+        return last_modified <= since;
+    }
+    return false;
+}
+
+const char* ContentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip:   return "gzip";
+        case ContentEncoding::Brotli: return "br";
+        default:                      return "identity";
+    }
+}
+
+ContentEncoding NegotiateContentEncoding(const std::string& accept_encoding) {
+    ContentEncoding best = ContentEncoding::Identity;
+    double bestQ = 0.0;
+
+    size_t start = 0;
+    while (start < accept_encoding.size()) {
+        size_t comma = accept_encoding.find(',', start);
+        std::string item = accept_encoding.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma == std::string::npos ? accept_encoding.size() : comma + 1;
+
+        double q = 1.0;
+        size_t semi = item.find(';');
+        std::string name = Trim(item.substr(0, semi));
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (semi != std::string::npos) {
+            std::string param = Trim(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::atof(param.c_str() + 2);
+            }
+        }
+
+        ContentEncoding encoding;
+        if (name == "br") {
+            encoding = ContentEncoding::Brotli;
+        } else if (name == "gzip" || name == "x-gzip") {
+            encoding = ContentEncoding::Gzip;
+        } else {
+            continue;
+        }
+
+        if (q <= 0.0 || !EncodingAvailable(encoding)) {
+            continue;
+        }
+        if (q > bestQ || (q == bestQ && encoding == ContentEncoding::Brotli)) {
+            best = encoding;
+            bestQ = q;
+        }
+    }
+    return best;
+}
+
+std::string VariantETag(const std::string& etag, ContentEncoding encoding) {
+    if (encoding == ContentEncoding::Identity || etag.size() < 2 || etag.back() != '"') {
+        return etag;
+    }
+    return etag.substr(0, etag.size() - 1) + "-" + ContentEncodingName(encoding) + "\"";
+}
+
+bool Compress(ContentEncoding encoding, const std::string& input, std::string& output,
+              CompressionLevel level) {
+    switch (encoding) {
+        case ContentEncoding::Gzip:   return CompressGzip(input, output, level);
+        case ContentEncoding::Brotli: return CompressBrotli(input, output, level);
+        default:                      return false;
+    }
+}
+
+bool CompressDynamic(ContentEncoding encoding, const std::string& body, std::string& output,
+                     size_t min_body_size) {
+    if (encoding == ContentEncoding::Identity || body.size() < min_body_size || !EncodingAvailable(encoding)) {
+        return false;
+    }
+    return Compress(encoding, body, output, CompressionLevel::Fast) && output.size() < body.size();
+}
+
+CompressedVariantCache::CompressedVariantCache(size_t max_bytes, size_t min_body_size)
+    : max_bytes_(max_bytes)
+    , min_body_size_(min_body_size)
+    , bytes_(0)
+    , hits_(0)
+    , misses_(0) {
+}
+
+std::shared_ptr<const std::string> CompressedVariantCache::Get(const std::string& body, const std::string& etag,
+                                                               ContentEncoding encoding) {
+    if (encoding == ContentEncoding::Identity || body.size() < min_body_size_ || !EncodingAvailable(encoding)) {
+        return nullptr;
+    }
+
+    std::string key = etag + ContentEncodingName(encoding);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            hits_++;
+            return it->second.data;
+        }
+    }
+
+    // 压缩在锁外进行；同一内容并发未命中时可能重复压缩，结果一致
+    misses_++;
+    std::shared_ptr<const std::string> data;
+    std::string compressed;
+    if (Compress(encoding, body, compressed) && compressed.size() < body.size()) {
+        data = std::make_shared<const std::string>(std::move(compressed));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.find(key) == entries_.end()) {
+        lru_.push_front(key);
+        entries_[key] = Entry{data, lru_.begin()};
+        bytes_ += key.size() + (data ? data->size() : 0);
+        EvictLocked();
+    }
+    return data;
+}
+
+CompressedVariantStats CompressedVariantCache::GetStats() const {
+    CompressedVariantStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+void CompressedVariantCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+void CompressedVariantCache::EvictLocked() {
+    while (bytes_ > max_bytes_ && lru_.size() > 1) {
+        auto it = entries_.find(lru_.back());
+        bytes_ -= it->first.size() + (it->second.data ? it->second.data->size() : 0);
+        entries_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+} // namespace utils
+} // namespace cycle
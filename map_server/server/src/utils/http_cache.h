@@ -0,0 +1,107 @@
+#ifndef CYCLE_UTILS_HTTP_CACHE_H
+#define CYCLE_UTILS_HTTP_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cycle {
+namespace utils {
+
+// 强 ETag，由内容的 64 位 FNV-1a 哈希和长度组成，带引号
+std::string ComputeETag(const void* data, size_t size);
+
+// IMF-fixdate，例如 "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string FormatHttpDate(std::time_t time);
+bool ParseHttpDate(const std::string& value, std::time_t& time);
+
+// If-None-Match 列表中是否有与 etag 匹配的条目（弱比较，忽略压缩变体后缀）
+bool ETagMatches(const std::string& if_none_match, const std::string& etag);
+
+// RFC 7232：存在 If-None-Match 时忽略 If-Modified-Since
+bool IsNotModified(const std::string& if_none_match, const std::string& if_modified_since,
+                   const std::string& etag, std::time_t last_modified);
+
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Brotli
+};
+
+const char* ContentEncodingName(ContentEncoding encoding);
+
+// 按 Accept-Encoding 的 q 值选择本构建支持的编码，同权重时优先 br
+ContentEncoding NegotiateContentEncoding(const std::string& accept_encoding);
+
+// 压缩变体使用独立的强 ETag："<hash>-gzip"、"<hash>-br"
+std::string VariantETag(const std::string& etag, ContentEncoding encoding);
+
+// Best 用于只压缩一次、反复发送的变体；Fast 用于每次内容都不同的动态文档
+enum class CompressionLevel {
+    Fast,
+    Best
+};
+
+bool Compress(ContentEncoding encoding, const std::string& input, std::string& output,
+              CompressionLevel level = CompressionLevel::Best);
+
+// 动态文档（指标、健康检查、任务状态）以 Fast 级别压缩，不进入变体缓存。
+// body 小于 min_body_size、编码不可用或压缩后未变小时返回 false
+bool CompressDynamic(ContentEncoding encoding, const std::string& body, std::string& output,
+                     size_t min_body_size = 512);
+
+struct CompressedVariantStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+/**
+ * Compressed variants of text bodies keyed by body ETag and encoding.
+ *
+ * Each distinct body is compressed once per encoding; repeated documents
+ * such as capabilities or config are then served from memory. Entries are
+ * evicted least-recently-used once max_bytes is exceeded. Bodies that change
+ * on every request belong in CompressDynamic instead, where they cannot
+ * push the stable variants out.
+ */
+class CompressedVariantCache {
+public:
+    explicit CompressedVariantCache(size_t max_bytes = 8 * 1024 * 1024, size_t min_body_size = 512);
+
+    // Returns nullptr when the body is below min_body_size, the encoding is
+    // unavailable, or compressing did not make the body smaller.
+    std::shared_ptr<const std::string> Get(const std::string& body, const std::string& etag,
+                                           ContentEncoding encoding);
+
+    CompressedVariantStats GetStats() const;
+    void Clear();
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> data;
+        std::list<std::string>::iterator lru;
+    };
+
+    void EvictLocked();
+
+    size_t max_bytes_;
+    size_t min_body_size_;
+    size_t bytes_;
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    mutable std::mutex mutex_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+} // namespace utils
+} // namespace cycle
+
+#endif // CYCLE_UTILS_HTTP_CACHE_H
@@ -0,0 +1,377 @@
+#include <gtest/gtest.h>
+#include "../src/database/connection_pool.h"
+#include "../src/database/sqlite_database.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cycle::database;
+
+namespace {
+
+struct FakeConnectionCounters {
+    std::atomic<int> alive{0};
+    std::atomic<int> deepChecks{0};
+    std::atomic<bool> failDeepCheck{false};
+};
+
+class FakeConnection : public PooledConnection {
+public:
+    FakeConnection(FakeConnectionCounters& counters, int id)
+        : counters_(counters), id_(id) {
+        ++counters_.alive;
+    }
+    ~FakeConnection() override { --counters_.alive; }
+
+    bool IsHealthy(bool deep) override {
+        if (!deep) {
+            return true;
+        }
+        ++counters_.deepChecks;
+        return !counters_.failDeepCheck;
+    }
+
+    int GetId() const { return id_; }
+
+private:
+    FakeConnectionCounters& counters_;
+    int id_;
+};
+
+}
+
+class DatabasePoolTest : public ::testing::Test {
+protected:
+    std::unique_ptr<DatabaseConnectionPool> MakePool(int maxConnections, int minConnections) {
+        ConnectionPoolOptions options;
+        options.name = "test";
+        options.maxConnections = maxConnections;
+        options.minConnections = minConnections;
+        options.acquireTimeoutMs = 1000;
+        options.idleTimeoutMs = 0;
+        options.healthCheckIntervalMs = 0;
+        return MakePool(options);
+    }
+
+    std::unique_ptr<DatabaseConnectionPool> MakePool(const ConnectionPoolOptions& options) {
+        return std::unique_ptr<DatabaseConnectionPool>(new DatabaseConnectionPool(options, [this]() {
+            return std::unique_ptr<PooledConnection>(new FakeConnection(counters, ++nextId));
+        }));
+    }
+
+    FakeConnectionCounters counters;
+    std::atomic<int> nextId{0};
+};
+
+TEST_F(DatabasePoolTest, ReusesMostRecentlyReleasedConnection) {
+    auto pool = MakePool(4, 2);
+    ASSERT_TRUE(pool->Start());
+    EXPECT_EQ(counters.alive, 2);
+
+    int firstId = 0;
+    {
+        ConnectionLease lease = pool->Acquire();
+        ASSERT_TRUE(lease);
+        firstId = lease.As<FakeConnection>()->GetId();
+    }
+
+    ConnectionLease again = pool->Acquire();
+    ASSERT_TRUE(again);
+    EXPECT_EQ(again.As<FakeConnection>()->GetId(), firstId);
+    EXPECT_EQ(counters.alive, 2);
+
+    ConnectionPoolStats stats = pool->GetStats();
+    EXPECT_EQ(stats.inUseConnections, 1);
+    EXPECT_EQ(stats.idleConnections, 1);
+    EXPECT_EQ(stats.acquireCount, 2u);
+    EXPECT_EQ(stats.waitCount, 0u);
+}
+
+TEST_F(DatabasePoolTest, BoundedAndTimesOut) {
+    auto pool = MakePool(2, 0);
+    ASSERT_TRUE(pool->Start());
+
+    ConnectionLease a = pool->Acquire();
+    ConnectionLease b = pool->Acquire();
+    ASSERT_TRUE(a);
+    ASSERT_TRUE(b);
+
+    auto start = std::chrono::steady_clock::now();
+    ConnectionLease c = pool->Acquire(50);
+    auto waited = std::chrono::steady_clock::now() - start;
+
+    EXPECT_FALSE(c);
+    EXPECT_GE(waited, std::chrono::milliseconds(50));
+    EXPECT_EQ(counters.alive, 2);
+
+    ConnectionPoolStats stats = pool->GetStats();
+    EXPECT_EQ(stats.totalConnections, 2);
+    EXPECT_EQ(stats.timeoutCount, 1u);
+    EXPECT_DOUBLE_EQ(stats.utilization, 1.0);
+    EXPECT_GE(stats.maxWaitMs, 50.0);
+}
+
+TEST_F(DatabasePoolTest, WaitersAreServedInArrivalOrder) {
+    auto pool = MakePool(1, 1);
+    ASSERT_TRUE(pool->Start());
+
+    ConnectionLease held = pool->Acquire();
+    ASSERT_TRUE(held);
+
+    std::mutex orderMutex;
+    std::vector<int> order;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i]() {
+            ConnectionLease lease = pool->Acquire(5000);
+            ASSERT_TRUE(lease);
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(i);
+        });
+        // Queue the waiters one by one so their arrival order is known.
+        while (pool->GetStats().waitingRequests < i + 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    held.Release();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3}));
+    EXPECT_EQ(counters.alive, 1);
+    EXPECT_EQ(pool->GetStats().waitCount, 4u);
+}
+
+TEST_F(DatabasePoolTest, InvalidatedConnectionIsReplaced) {
+    auto pool = MakePool(1, 1);
+    ASSERT_TRUE(pool->Start());
+
+    int brokenId = 0;
+    {
+        ConnectionLease lease = pool->Acquire();
+        ASSERT_TRUE(lease);
+        brokenId = lease.As<FakeConnection>()->GetId();
+        lease.Invalidate();
+    }
+    EXPECT_EQ(counters.alive, 0);
+
+    ConnectionLease lease = pool->Acquire();
+    ASSERT_TRUE(lease);
+    EXPECT_NE(lease.As<FakeConnection>()->GetId(), brokenId);
+    EXPECT_EQ(pool->GetStats().healthCheckFailures, 1u);
+}
+
+TEST_F(DatabasePoolTest, MaintenanceReapsIdleAndChecksHealth) {
+    ConnectionPoolOptions options;
+    options.maxConnections = 4;
+    options.minConnections = 1;
+    options.idleTimeoutMs = 20;
+    options.healthCheckIntervalMs = 20;
+    auto pool = MakePool(options);
+    ASSERT_TRUE(pool->Start());
+
+    {
+        ConnectionLease a = pool->Acquire();
+        ConnectionLease b = pool->Acquire();
+        ConnectionLease c = pool->Acquire();
+    }
+    EXPECT_EQ(counters.alive, 3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    pool->RunMaintenance();
+    EXPECT_EQ(counters.alive, 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    counters.failDeepCheck = true;
+    pool->RunMaintenance();
+    EXPECT_GT(counters.deepChecks, 0);
+
+    // The unhealthy connection is dropped and the pool refills to its minimum.
+    counters.failDeepCheck = false;
+    pool->RunMaintenance();
+    ConnectionPoolStats stats = pool->GetStats();
+    EXPECT_GE(stats.healthCheckFailures, 1u);
+    EXPECT_EQ(stats.totalConnections, 1);
+    EXPECT_EQ(counters.alive, 1);
+}
+
+TEST_F(DatabasePoolTest, ShutdownWakesWaiters) {
+    auto pool = MakePool(1, 1);
+    ASSERT_TRUE(pool->Start());
+
+    ConnectionLease held = pool->Acquire();
+    auto waiter = std::async(std::launch::async, [&]() { return static_cast<bool>(pool->Acquire(5000)); });
+    while (pool->GetStats().waitingRequests < 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    pool->Shutdown();
+    EXPECT_FALSE(waiter.get());
+
+    held.Release();
+    EXPECT_EQ(counters.alive, 0);
+}
+
+class SqlitePoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = "test_database_pool_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + ".db";
+        RemoveFiles();
+
+        ConnectionPoolOptions options;
+        options.maxConnections = 4;
+        options.minConnections = 1;
+        options.acquireTimeoutMs = 2000;
+        db.reset(new SqliteDatabase(path, options));
+        ASSERT_TRUE(db->Open());
+        ASSERT_TRUE(db->Execute("CREATE TABLE tiles (z INTEGER, x INTEGER, y INTEGER, data BLOB)"));
+    }
+
+    void TearDown() override {
+        db.reset();
+        RemoveFiles();
+    }
+
+    void RemoveFiles() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    int Count(const std::string& sql) {
+        auto rs = db->Query(sql);
+        if (!rs || !rs->Next()) {
+            return -1;
+        }
+        return rs->GetCurrentRow()->GetInt(0);
+    }
+
+    std::string path;
+    std::unique_ptr<SqliteDatabase> db;
+};
+
+TEST_F(SqlitePoolTest, UsesWalAndSeparateReaderPool) {
+    auto rs = db->Query("PRAGMA journal_mode");
+    ASSERT_TRUE(rs && rs->Next());
+    EXPECT_EQ(rs->GetCurrentRow()->GetString(0), "wal");
+    rs.reset();
+
+    std::vector<ConnectionPoolStats> stats;
+    ASSERT_TRUE(db->GetPoolStats(stats));
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[0].name, "sqlite-writer");
+    EXPECT_EQ(stats[0].maxConnections, 1);
+    EXPECT_EQ(stats[1].name, "sqlite-readers");
+    EXPECT_EQ(stats[1].maxConnections, 4);
+}
+
+TEST_F(SqlitePoolTest, ReadersRunConcurrentlyWithOpenCursors) {
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(db->Execute("INSERT INTO tiles VALUES (?, ?, ?, NULL)",
+                                {SqlParameter::Integer(1), SqlParameter::Integer(i), SqlParameter::Integer(0)}));
+    }
+
+    // Each open result set holds its own reader until it is closed.
+    std::vector<std::unique_ptr<ResultSet>> cursors;
+    for (int i = 0; i < 4; ++i) {
+        cursors.push_back(db->Query("SELECT x FROM tiles WHERE z = ?", {SqlParameter::Integer(1)}));
+        ASSERT_TRUE(cursors.back());
+        ASSERT_TRUE(cursors.back()->Next());
+    }
+
+    std::vector<ConnectionPoolStats> stats;
+    ASSERT_TRUE(db->GetPoolStats(stats));
+    EXPECT_EQ(stats[1].inUseConnections, 4);
+
+    // Writes still go through while every reader is busy.
+    EXPECT_TRUE(db->Execute("INSERT INTO tiles VALUES (2, 0, 0, NULL)"));
+    cursors.clear();
+
+    stats.clear();
+    ASSERT_TRUE(db->GetPoolStats(stats));
+    EXPECT_EQ(stats[1].inUseConnections, 0);
+    EXPECT_EQ(Count("SELECT count(*) FROM tiles"), 11);
+}
+
+TEST_F(SqlitePoolTest, WritesThroughQueryAreRoutedToWriter) {
+    auto rs = db->Query("INSERT INTO tiles VALUES (3, 1, 1, NULL)");
+    ASSERT_TRUE(rs);
+    rs->Next();
+    rs.reset();
+    EXPECT_EQ(Count("SELECT count(*) FROM tiles WHERE z = 3"), 1);
+}
+
+TEST_F(SqlitePoolTest, TransactionIsPinnedToCallingThread) {
+    ASSERT_TRUE(db->BeginTransaction());
+    ASSERT_TRUE(db->Execute("INSERT INTO tiles VALUES (4, 0, 0, NULL)"));
+
+    // The transaction's own reads see its uncommitted row; other threads do not.
+    EXPECT_EQ(Count("SELECT count(*) FROM tiles WHERE z = 4"), 1);
+    auto other = std::async(std::launch::async, [this]() {
+        return Count("SELECT count(*) FROM tiles WHERE z = 4");
+    });
+    EXPECT_EQ(other.get(), 0);
+
+    ASSERT_TRUE(db->CommitTransaction());
+    EXPECT_EQ(Count("SELECT count(*) FROM tiles WHERE z = 4"), 1);
+}
+
+TEST_F(SqlitePoolTest, ParallelReadersShareThePool) {
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_TRUE(db->Execute("INSERT INTO tiles VALUES (?, ?, 0, NULL)",
+                                {SqlParameter::Integer(5), SqlParameter::Integer(i)}));
+    }
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 50; ++i) {
+                auto rs = db->Query("SELECT count(*) FROM tiles WHERE z = ?", {SqlParameter::Integer(5)});
+                if (!rs || !rs->Next() || rs->GetCurrentRow()->GetInt(0) != 50) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(failures, 0);
+    std::vector<ConnectionPoolStats> stats;
+    ASSERT_TRUE(db->GetPoolStats(stats));
+    EXPECT_LE(stats[1].peakInUse, 4);
+    EXPECT_EQ(stats[1].timeoutCount, 0u);
+    EXPECT_LE(stats[1].createdCount, 4u);
+}
+
+TEST(SqliteStatementCacheTest, ReusesAndEvictsStatements) {
+    sqlite3* handle = nullptr;
+    ASSERT_EQ(sqlite3_open(":memory:", &handle), SQLITE_OK);
+    SqliteConnection conn(handle, false, 2);
+
+    int rc = 0;
+    sqlite3_stmt* first = conn.PrepareCached("SELECT 1", &rc);
+    ASSERT_NE(first, nullptr);
+    conn.ReleaseStatement(first);
+    EXPECT_EQ(conn.PrepareCached("SELECT 1", &rc), first);
+
+    // A second cursor on a statement that is still in use gets its own copy.
+    sqlite3_stmt* second = conn.PrepareCached("SELECT 1", &rc);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(second, first);
+    conn.ReleaseStatement(second);
+    conn.ReleaseStatement(first);
+    EXPECT_EQ(conn.GetCachedStatementCount(), 1u);
+
+    conn.ReleaseStatement(conn.PrepareCached("SELECT 2", &rc));
+    conn.ReleaseStatement(conn.PrepareCached("SELECT 3", &rc));
+    EXPECT_EQ(conn.GetCachedStatementCount(), 2u);
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include "../src/utils/http_cache.h"
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace cycle::utils;
+
+namespace {
+
+std::string JsonDocument() {
+    std::string body = "{\"layers\":[";
+    for (int i = 0; i < 200; ++i) {
+        body += "{\"name\":\"layer_" + std::to_string(i) + "\",\"visible\":true},";
+    }
+    body += "{}]}";
+    return body;
+}
+
+} // namespace
+
+TEST(HttpCacheTest, ETagIsStableAndContentDerived) {
+    std::string a = "tile-bytes-a";
+    std::string b = "tile-bytes-b";
+
+    std::string etag = ComputeETag(a.data(), a.size());
+    EXPECT_EQ(etag, ComputeETag(a.data(), a.size()));
+    EXPECT_NE(etag, ComputeETag(b.data(), b.size()));
+    EXPECT_EQ(etag.front(), '"');
+    EXPECT_EQ(etag.back(), '"');
+    EXPECT_EQ(etag.find("W/"), std::string::npos);
+}
+
+TEST(HttpCacheTest, HttpDateRoundTrips) {
+    std::time_t t = 784111777;  // Sun, 06 Nov 1994 08:49:37 GMT
+    EXPECT_EQ(FormatHttpDate(t), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    std::time_t parsed = 0;
+    ASSERT_TRUE(ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", parsed));
+    EXPECT_EQ(parsed, t);
+    ASSERT_TRUE(ParseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", parsed));
+    EXPECT_EQ(parsed, t);
+
+    std::time_t now = std::time(nullptr);
+    ASSERT_TRUE(ParseHttpDate(FormatHttpDate(now), parsed));
+    EXPECT_EQ(parsed, now);
+
+    EXPECT_FALSE(ParseHttpDate("yesterday", parsed));
+}
+
+TEST(HttpCacheTest, IfNoneMatchTakesPrecedence) {
+    std::string etag = "\"0123456789abcdef-10\"";
+    std::time_t modified = 1000000;
+    std::string later = FormatHttpDate(modified + 60);
+
+    EXPECT_TRUE(IsNotModified(etag, "", etag, modified));
+    EXPECT_TRUE(IsNotModified("\"other\", W/" + etag, "", etag, modified));
+    EXPECT_TRUE(IsNotModified("*", "", etag, modified));
+    EXPECT_TRUE(IsNotModified(VariantETag(etag, ContentEncoding::Gzip), "", etag, modified));
+    // A mismatching ETag wins over a satisfied If-Modified-Since.
+    EXPECT_FALSE(IsNotModified("\"other\"", later, etag, modified));
+
+    EXPECT_TRUE(IsNotModified("", later, etag, modified));
+    EXPECT_TRUE(IsNotModified("", FormatHttpDate(modified), etag, modified));
+    EXPECT_FALSE(IsNotModified("", FormatHttpDate(modified - 1), etag, modified));
+    EXPECT_FALSE(IsNotModified("", "", etag, modified));
+}
+
+TEST(HttpCacheTest, NegotiatesByQuality) {
+    EXPECT_EQ(NegotiateContentEncoding(""), ContentEncoding::Identity);
+    EXPECT_EQ(NegotiateContentEncoding("identity"), ContentEncoding::Identity);
+#ifdef HAVE_ZLIB
+    EXPECT_EQ(NegotiateContentEncoding("gzip, deflate"), ContentEncoding::Gzip);
+    EXPECT_EQ(NegotiateContentEncoding("br;q=0, gzip"), ContentEncoding::Gzip);
+#endif
+#ifdef HAVE_BROTLI
+    EXPECT_EQ(NegotiateContentEncoding("gzip, deflate, br"), ContentEncoding::Brotli);
+    EXPECT_EQ(NegotiateContentEncoding("br;q=0.5, gzip;q=0"), ContentEncoding::Brotli);
+#endif
+#if defined(HAVE_ZLIB) && defined(HAVE_BROTLI)
+    EXPECT_EQ(NegotiateContentEncoding("br;q=0.5, gzip;q=0.8"), ContentEncoding::Gzip);
+#endif
+    EXPECT_EQ(NegotiateContentEncoding("gzip;q=0, br;q=0"), ContentEncoding::Identity);
+}
+
+TEST(HttpCacheTest, VariantsAreCompressedOnce) {
+    CompressedVariantCache cache;
+    std::string body = JsonDocument();
+    std::string etag = ComputeETag(body.data(), body.size());
+
+    uint64_t available = 0;
+    for (ContentEncoding encoding : {ContentEncoding::Gzip, ContentEncoding::Brotli}) {
+        auto first = cache.Get(body, etag, encoding);
+        auto second = cache.Get(body, etag, encoding);
+        if (!first) {
+            continue;  // encoding not compiled in
+        }
+        available++;
+        EXPECT_LT(first->size(), body.size());
+        EXPECT_EQ(first.get(), second.get());
+    }
+
+    CompressedVariantStats stats = cache.GetStats();
+    EXPECT_EQ(stats.misses, available);
+    EXPECT_EQ(stats.hits, available);
+
+    // Small bodies are sent as-is.
+    EXPECT_EQ(cache.Get("{}", ComputeETag("{}", 2), ContentEncoding::Gzip), nullptr);
+}
+
+TEST(HttpCacheTest, EvictsLeastRecentlyUsed) {
+    CompressedVariantCache cache(4096, 16);
+    std::string body = JsonDocument();
+
+    for (int i = 0; i < 50; ++i) {
+        std::string variant = body + std::to_string(i);
+        cache.Get(variant, ComputeETag(variant.data(), variant.size()), ContentEncoding::Gzip);
+    }
+    EXPECT_LE(cache.GetStats().bytes, 4096u);
+}
+
+TEST(HttpCacheTest, DynamicBodiesAreCompressedWithoutCaching) {
+    std::string body = JsonDocument();
+    std::string compressed;
+    for (ContentEncoding encoding : {ContentEncoding::Gzip, ContentEncoding::Brotli}) {
+        std::string best;
+        if (!Compress(encoding, body, best)) {
+            continue;  // encoding not compiled in
+        }
+        ASSERT_TRUE(CompressDynamic(encoding, body, compressed));
+        EXPECT_LT(compressed.size(), body.size());
+    }
+
+    EXPECT_FALSE(CompressDynamic(ContentEncoding::Identity, body, compressed));
+    EXPECT_FALSE(CompressDynamic(ContentEncoding::Gzip, "{}", compressed));
+}
+
+#ifdef HAVE_ZLIB
+TEST(HttpCacheTest, GzipVariantInflatesToBody) {
+    std::string body = JsonDocument();
+    std::string compressed;
+    ASSERT_TRUE(Compress(ContentEncoding::Gzip, body, compressed));
+
+    z_stream stream = {};
+    ASSERT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+    std::string out(body.size() + 16, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    out.resize(stream.total_out);
+    inflateEnd(&stream);
+
+    EXPECT_EQ(out, body);
+}
+#endif
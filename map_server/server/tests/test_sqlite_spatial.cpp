@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "../src/database/sqlite_database.h"
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+
+using namespace cycle;
+using namespace cycle::database;
+
+// SpatiaLite is not required: the table stores opaque blobs and the R*Tree is
+// a plain rtree virtual table laid out like SpatiaLite's idx_<table>_<column>.
+class SqliteSpatialQueryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = "test_sqlite_spatial_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + ".db";
+        RemoveFiles();
+
+        db.reset(new SqliteDatabase(path));
+        ASSERT_TRUE(db->Open());
+        ASSERT_TRUE(db->Execute("CREATE TABLE roads (id INTEGER PRIMARY KEY, geometry BLOB)"));
+        ASSERT_TRUE(db->Execute("CREATE VIRTUAL TABLE idx_roads_geometry USING rtree(pkid, xmin, xmax, ymin, ymax)"));
+
+        // One unit square feature per cell of a 10x10 grid.
+        ASSERT_TRUE(db->BeginTransaction());
+        for (int y = 0; y < 10; ++y) {
+            for (int x = 0; x < 10; ++x) {
+                int id = y * 10 + x + 1;
+                std::string blob = "feature-" + std::to_string(id);
+                ASSERT_TRUE(db->Execute("INSERT INTO roads (id, geometry) VALUES (?, ?)",
+                                        {SqlParameter::Integer(id), SqlParameter::Blob(blob.data(), blob.size())}));
+                ASSERT_TRUE(db->Execute("INSERT INTO idx_roads_geometry VALUES (?, ?, ?, ?, ?)",
+                                        {SqlParameter::Integer(id),
+                                         SqlParameter::Real(x + 0.25), SqlParameter::Real(x + 0.75),
+                                         SqlParameter::Real(y + 0.25), SqlParameter::Real(y + 0.75)}));
+            }
+        }
+        ASSERT_TRUE(db->CommitTransaction());
+    }
+
+    void TearDown() override {
+        db.reset();
+        RemoveFiles();
+    }
+
+    void RemoveFiles() {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    }
+
+    std::set<int> QueryIds(const BoundingBox& bbox) {
+        std::set<int> ids;
+        auto rs = db->QuerySpatial("roads", bbox);
+        EXPECT_TRUE(rs != nullptr);
+        while (rs && rs->Next()) {
+            ids.insert(rs->GetCurrentRow()->GetInt(0));
+        }
+        return ids;
+    }
+
+    std::string path;
+    std::unique_ptr<SqliteDatabase> db;
+};
+
+TEST_F(SqliteSpatialQueryTest, DetectsSpatialIndex) {
+    EXPECT_TRUE(db->HasSpatialIndex("roads", "geometry"));
+    EXPECT_FALSE(db->HasSpatialIndex("roads", "other"));
+}
+
+TEST_F(SqliteSpatialQueryTest, SelectsCandidatesFromRTree) {
+    BoundingBox bbox(2.0, 3.0, 4.0, 5.0);
+    std::set<int> ids = QueryIds(bbox);
+
+    std::set<int> expected;
+    for (int y = 3; y < 5; ++y) {
+        for (int x = 2; x < 4; ++x) {
+            expected.insert(y * 10 + x + 1);
+        }
+    }
+    EXPECT_EQ(ids, expected);
+}
+
+TEST_F(SqliteSpatialQueryTest, BufferWidensTheSearch) {
+    BoundingBox bbox(2.0, 3.0, 4.0, 5.0);
+    EXPECT_EQ(QueryIds(bbox).size(), 4u);
+
+    // A 20% buffer on a 2x2 box reaches 0.4 into the neighbouring cells,
+    // past the 0.25 margin around each feature.
+    db->SetSpatialQueryBuffer(0.2);
+    EXPECT_EQ(QueryIds(bbox).size(), 16u);
+}
+
+TEST_F(SqliteSpatialQueryTest, GeometryBlobIsAView) {
+    auto rs = db->QuerySpatial("roads", BoundingBox(0.0, 0.0, 1.0, 1.0));
+    ASSERT_TRUE(rs);
+    ASSERT_TRUE(rs->Next());
+
+    auto row = rs->GetCurrentRow();
+    ASSERT_EQ(row->GetColumnName(1), "geometry");
+    BlobView view = row->GetBlobView(1);
+    std::vector<uint8_t> copy = row->GetBlob(1);
+
+    ASSERT_FALSE(view.IsEmpty());
+    ASSERT_EQ(view.size, copy.size());
+    EXPECT_EQ(std::memcmp(view.data, copy.data(), copy.size()), 0);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(view.data), view.size), "feature-1");
+    EXPECT_FALSE(rs->Next());
+}
+
+TEST_F(SqliteSpatialQueryTest, RepeatedTilesReuseReaderConnections) {
+    for (int i = 0; i < 20; ++i) {
+        BoundingBox bbox(i % 10, 0.0, i % 10 + 1.0, 1.0);
+        EXPECT_EQ(QueryIds(bbox).size(), 1u);
+    }
+
+    std::vector<ConnectionPoolStats> stats;
+    ASSERT_TRUE(db->GetPoolStats(stats));
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[1].createdCount, 1u);
+}
@@ -0,0 +1,370 @@
+#include <gtest/gtest.h>
+#include "../src/service/tile_seeder.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace cycle;
+using namespace cycle::service;
+
+class TileSeederTest : public ::testing::Test {
+protected:
+    using Tile = std::tuple<int, int, int>;
+
+    void SetUp() override {
+        stateDir = "test_tile_seeder_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed());
+        std::filesystem::remove_all(stateDir);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(stateDir);
+    }
+
+    TileSeeder::RenderTileFn Recorder() {
+        return [this](int z, int x, int y, encoder::ImageFormat, int) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendered.push_back(Tile(z, x, y));
+            return true;
+        };
+    }
+
+    static SeedJobSpec Spec(const BoundingBox& bounds, std::vector<int> zooms) {
+        SeedJobSpec spec;
+        spec.bounds = bounds;
+        spec.zoom_levels = zooms;
+        return spec;
+    }
+
+    std::string stateDir;
+    std::mutex mutex;
+    std::vector<Tile> rendered;
+};
+
+TEST_F(TileSeederTest, HilbertIndexVisitsNeighbours) {
+    // Every step along the curve moves to an edge-adjacent cell.
+    const uint32_t order = 8;
+    std::vector<std::pair<uint32_t, uint32_t>> byIndex(order * order);
+    for (uint32_t y = 0; y < order; ++y) {
+        for (uint32_t x = 0; x < order; ++x) {
+            uint64_t d = TileSeeder::HilbertIndex(order, x, y);
+            ASSERT_LT(d, byIndex.size());
+            byIndex[d] = {x, y};
+        }
+    }
+    for (size_t i = 1; i < byIndex.size(); ++i) {
+        int dx = std::abs(static_cast<int>(byIndex[i].first) - static_cast<int>(byIndex[i - 1].first));
+        int dy = std::abs(static_cast<int>(byIndex[i].second) - static_cast<int>(byIndex[i - 1].second));
+        EXPECT_EQ(dx + dy, 1) << "step " << i;
+    }
+
+    for (uint64_t d = 0; d < byIndex.size(); ++d) {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        TileSeeder::HilbertPoint(order, d, x, y);
+        EXPECT_EQ(std::make_pair(x, y), byIndex[d]) << "index " << d;
+    }
+}
+
+TEST_F(TileSeederTest, RendersEveryTileOfTheBoundsOnce) {
+    TileSeederOptions options;
+    options.metatile_size = 2;
+    TileSeeder seeder(options, Recorder());
+    ASSERT_TRUE(seeder.Start());
+
+    std::string error;
+    std::string id = seeder.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {0, 1, 2, 3}), error);
+    ASSERT_FALSE(id.empty()) << error;
+    ASSERT_TRUE(seeder.Wait(id, 10000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.state, SeedJobState::Completed);
+    EXPECT_EQ(status.total_tiles, 1u + 4u + 16u + 64u);
+    EXPECT_EQ(status.rendered_tiles, status.total_tiles);
+    EXPECT_EQ(status.total_units, 1u + 1u + 4u + 16u);
+    EXPECT_EQ(status.completed_units, status.total_units);
+
+    std::set<Tile> unique(rendered.begin(), rendered.end());
+    EXPECT_EQ(unique.size(), rendered.size());
+    EXPECT_EQ(unique.size(), status.total_tiles);
+}
+
+TEST_F(TileSeederTest, PolygonClipsTheBounds) {
+    TileSeederOptions options;
+    options.threads = 1;
+    TileSeeder seeder(options, Recorder());
+    ASSERT_TRUE(seeder.Start());
+
+    // A triangle over the north-west quadrant only.
+    SeedJobSpec spec = Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {4});
+    spec.polygon = {{-170.0, 10.0}, {-10.0, 10.0}, {-170.0, 80.0}};
+
+    std::string error;
+    std::string id = seeder.Submit(spec, error);
+    ASSERT_FALSE(id.empty()) << error;
+    ASSERT_TRUE(seeder.Wait(id, 10000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_GT(status.total_tiles, 0u);
+    EXPECT_LT(status.total_tiles, 64u);
+    EXPECT_EQ(rendered.size(), status.total_tiles);
+    for (const auto& tile : rendered) {
+        EXPECT_LT(std::get<1>(tile), 8);
+        EXPECT_LT(std::get<2>(tile), 8);
+    }
+}
+
+TEST_F(TileSeederTest, SkipsFreshTiles) {
+    TileSeederOptions options;
+    TileSeeder seeder(options, Recorder(),
+                      [](int, int x, int, encoder::ImageFormat, int) { return x % 2 == 0; });
+    ASSERT_TRUE(seeder.Start());
+
+    std::string error;
+    std::string id = seeder.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {3}), error);
+    ASSERT_TRUE(seeder.Wait(id, 10000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.skipped_tiles, 32u);
+    EXPECT_EQ(status.rendered_tiles, 32u);
+    EXPECT_EQ(rendered.size(), 32u);
+}
+
+TEST_F(TileSeederTest, YieldsToForegroundTraffic) {
+    std::atomic<bool> busy(true);
+    TileSeederOptions options;
+    options.threads = 1;
+    options.max_yield_ms = 60000;
+    TileSeeder seeder(options, Recorder(), nullptr, [&] { return busy.load(); });
+    ASSERT_TRUE(seeder.Start());
+
+    std::string error;
+    std::string id = seeder.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {0}), error);
+    EXPECT_FALSE(seeder.Wait(id, 100));
+    EXPECT_TRUE(rendered.empty());
+
+    busy = false;
+    EXPECT_TRUE(seeder.Wait(id, 10000));
+    EXPECT_EQ(rendered.size(), 1u);
+}
+
+TEST_F(TileSeederTest, CancelStopsTheJob) {
+    std::atomic<bool> release(false);
+    TileSeederOptions options;
+    options.threads = 1;
+    options.metatile_size = 1;
+    TileSeeder seeder(options, [&](int, int, int, encoder::ImageFormat, int) {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    });
+    ASSERT_TRUE(seeder.Start());
+
+    std::string error;
+    std::string id = seeder.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {5}), error);
+    ASSERT_TRUE(seeder.Cancel(id));
+    release = true;
+    ASSERT_TRUE(seeder.Wait(id, 1000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.state, SeedJobState::Cancelled);
+    EXPECT_LT(status.ProcessedTiles(), status.total_tiles);
+    EXPECT_FALSE(seeder.Cancel(id));
+}
+
+TEST_F(TileSeederTest, ResumesAfterRestart) {
+    const BoundingBox world(-180.0, -85.0, 180.0, 85.0);
+    std::string id;
+    uint64_t firstRun = 0;
+
+    {
+        std::atomic<int> budget(20);
+        TileSeederOptions options;
+        options.threads = 1;
+        options.metatile_size = 1;
+        options.checkpoint_units = 1;
+        options.state_dir = stateDir;
+        TileSeeder seeder(options, [&](int z, int x, int y, encoder::ImageFormat, int) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendered.push_back(Tile(z, x, y));
+            if (--budget <= 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            return true;
+        });
+        ASSERT_TRUE(seeder.Start());
+
+        std::string error;
+        id = seeder.Submit(Spec(world, {4}), error);
+        ASSERT_FALSE(id.empty()) << error;
+        while (budget > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        seeder.Stop();
+
+        SeedJobStatus status;
+        ASSERT_TRUE(seeder.GetStatus(id, status));
+        EXPECT_NE(status.state, SeedJobState::Completed);
+        firstRun = status.rendered_tiles;
+        EXPECT_GE(firstRun, 19u);
+    }
+
+    std::set<Tile> firstTiles(rendered.begin(), rendered.end());
+    rendered.clear();
+
+    TileSeederOptions options;
+    options.state_dir = stateDir;
+    TileSeeder seeder(options, Recorder());
+    ASSERT_TRUE(seeder.Start());
+    ASSERT_TRUE(seeder.Wait(id, 10000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.state, SeedJobState::Completed);
+    EXPECT_EQ(status.total_tiles, 256u);
+    EXPECT_EQ(status.rendered_tiles, 256u);
+    EXPECT_EQ(rendered.size(), 256u - firstRun);
+
+    // The second run only picks up tiles the first one never committed.
+    for (const auto& tile : rendered) {
+        EXPECT_EQ(firstTiles.count(tile), 0u);
+    }
+}
+
+TEST_F(TileSeederTest, RestartsWhenOutputIsNotDurable) {
+    const BoundingBox world(-180.0, -85.0, 180.0, 85.0);
+    std::string id;
+
+    {
+        TileSeederOptions options;
+        options.metatile_size = 1;
+        options.state_dir = stateDir;
+        options.durable_output = false;
+        TileSeeder seeder(options, [&](int, int, int, encoder::ImageFormat, int) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return true;
+        });
+        ASSERT_TRUE(seeder.Start());
+
+        std::string error;
+        id = seeder.Submit(Spec(world, {4}), error);
+        ASSERT_FALSE(id.empty()) << error;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        seeder.Stop();
+    }
+
+    // Nothing the first run rendered survived, so every tile is checked again.
+    std::atomic<int> checked(0);
+    TileSeederOptions options;
+    options.state_dir = stateDir;
+    options.durable_output = false;
+    TileSeeder seeder(options, Recorder(), [&](int, int, int, encoder::ImageFormat, int) {
+        checked++;
+        return false;
+    });
+    ASSERT_TRUE(seeder.Start());
+    ASSERT_TRUE(seeder.Wait(id, 10000));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.state, SeedJobState::Completed);
+    EXPECT_EQ(status.rendered_tiles, 256u);
+    EXPECT_EQ(checked.load(), 256);
+    EXPECT_EQ(rendered.size(), 256u);
+}
+
+TEST_F(TileSeederTest, RejectsInvalidJobs) {
+    TileSeeder seeder(TileSeederOptions(), Recorder());
+    std::string error;
+
+    EXPECT_TRUE(seeder.Submit(Spec(BoundingBox(10.0, 10.0, 0.0, 0.0), {1}), error).empty());
+    EXPECT_FALSE(error.empty());
+    EXPECT_TRUE(seeder.Submit(Spec(BoundingBox(0.0, 0.0, 10.0, 10.0), {}), error).empty());
+    EXPECT_TRUE(seeder.Submit(Spec(BoundingBox(0.0, 0.0, 10.0, 10.0), {31}), error).empty());
+
+    SeedJobSpec spec = Spec(BoundingBox(0.0, 0.0, 10.0, 10.0), {1});
+    spec.polygon = {{1.0, 1.0}, {2.0, 2.0}};
+    EXPECT_TRUE(seeder.Submit(spec, error).empty());
+
+    TileSeederOptions options;
+    options.max_zoom = 4;
+    options.max_tiles = 100;
+    TileSeeder capped(options, Recorder());
+    EXPECT_TRUE(capped.Submit(Spec(BoundingBox(0.0, 0.0, 10.0, 10.0), {5}), error).empty());
+    EXPECT_TRUE(capped.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {3, 4}), error).empty());
+    EXPECT_FALSE(capped.Submit(Spec(BoundingBox(-180.0, -85.0, 180.0, 85.0), {3}), error).empty());
+}
+
+TEST_F(TileSeederTest, LargeJobsAreNotMaterialised) {
+    TileSeederOptions options;
+    options.max_zoom = 30;
+    options.max_tiles = 0;
+    TileSeeder seeder(options, Recorder());
+
+    // 2^36 tiles; sizing the job must not touch each of them.
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    std::string id = seeder.Submit(Spec(BoundingBox(-180.0, -90.0, 180.0, 90.0), {18}), error);
+    ASSERT_FALSE(id.empty()) << error;
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    SeedJobStatus status;
+    ASSERT_TRUE(seeder.GetStatus(id, status));
+    EXPECT_EQ(status.total_tiles, 1ULL << 36);
+    EXPECT_EQ(status.total_units, 1ULL << 30);
+    EXPECT_TRUE(seeder.Cancel(id));
+}
+
+TEST_F(TileSeederTest, KeepsOnlyTheNewestFinishedJobs) {
+    auto countStateFiles = [this] {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(stateDir)) {
+            count += entry.path().extension() == ".json";
+        }
+        return count;
+    };
+
+    std::vector<std::string> ids;
+    {
+        TileSeederOptions options;
+        options.state_dir = stateDir;
+        options.max_finished_jobs = 2;
+        TileSeeder seeder(options, Recorder());
+        ASSERT_TRUE(seeder.Start());
+
+        for (int i = 0; i < 3; ++i) {
+            std::string error;
+            ids.push_back(seeder.Submit(Spec(BoundingBox(0.0, 0.0, 10.0, 10.0), {1}), error));
+            ASSERT_FALSE(ids.back().empty()) << error;
+            ASSERT_TRUE(seeder.Wait(ids.back(), 10000));
+        }
+
+        SeedJobStatus status;
+        EXPECT_FALSE(seeder.GetStatus(ids[0], status));
+        EXPECT_TRUE(seeder.GetStatus(ids[2], status));
+        EXPECT_EQ(seeder.ListJobs().size(), 2u);
+        EXPECT_EQ(countStateFiles(), 2u);
+    }
+
+    // A lower limit on the next start drops the older state files too.
+    TileSeederOptions options;
+    options.state_dir = stateDir;
+    options.max_finished_jobs = 1;
+    TileSeeder seeder(options, Recorder());
+    ASSERT_TRUE(seeder.Start());
+
+    std::vector<SeedJobStatus> jobs = seeder.ListJobs();
+    ASSERT_EQ(jobs.size(), 1u);
+    EXPECT_EQ(jobs[0].id, ids[2]);
+    EXPECT_EQ(countStateFiles(), 1u);
+}